@@ -9,6 +9,7 @@
  */
 /// Direct3D9 ϱ  
 #include <d3d9.h>
+#include "Platform.h"
 
 
 
@@ -100,66 +101,30 @@ VOID Render()
 
 
 /**-----------------------------------------------------------------------------
- *  ν
+ * ʱȭ
+ * ÷ (Platform.h) â  ڿ θ. â  ϸ window NULL̴.
  *------------------------------------------------------------------------------
  */
-LRESULT WINAPI MsgProc( HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam )
+bool InitApp( PlatformWindow window )
 {
-    switch( msg )
-    {
-        case WM_DESTROY:
-            Cleanup();
-            PostQuitMessage( 0 );
-            return 0;
-
-        case WM_PAINT:
-            Render();
-            ValidateRect( hWnd, NULL );
-            return 0;
-    }
-
-    return DefWindowProc( hWnd, msg, wParam, lParam );
+    /// Direct3D ʱȭ
+    return SUCCEEDED( InitD3D( (HWND)window ) );
 }
 
 
 
 
 /**-----------------------------------------------------------------------------
- *  α׷ 
+ * α׷ 
+ * WinMain()() main()() ÷  ְ,  Ѱ  Լ θ.
  *------------------------------------------------------------------------------
  */
-INT WINAPI WinMain( HINSTANCE hInst, HINSTANCE, LPSTR, INT )
+INT PlatformMain( const char* cmdLine )
 {
-    ///  Ŭ 
-    WNDCLASSEX wc = { sizeof(WNDCLASSEX), CS_CLASSDC, MsgProc, 0L, 0L, 
-                      GetModuleHandle(NULL), NULL, NULL, NULL, NULL,
-                      "D3D Tutorial", NULL };
-    RegisterClassEx( &wc );
-
-    ///  
-    HWND hWnd = CreateWindow( "D3D Tutorial", "D3D Tutorial 01: CreateDevice", 
-                              WS_OVERLAPPEDWINDOW, 100, 100, 300, 300,
-                              GetDesktopWindow(), NULL, wc.hInstance, NULL );
-
-    /// Direct3D ʱȭ
-    if( SUCCEEDED( InitD3D( hWnd ) ) )
-    { 
-        ///  
-        ShowWindow( hWnd, SW_SHOWDEFAULT );
-        UpdateWindow( hWnd );
-
-        /// ޽ 
-        MSG msg; 
-        while( GetMessage( &msg, NULL, 0, 0 ) )
-        {
-            TranslateMessage( &msg );
-            DispatchMessage( &msg );
-        }
-    }
-
-    /// ϵ Ŭ Ұ
-    UnregisterClass( "D3D Tutorial", wc.hInstance );
-    return 0;
+    /// â  ޽ óϴ  ÷  Ѵ. ȭ ٽ ׷  (WM_PAINT) Render() θ.
+    /// "-headless -frames N" ϸ â  ʰ N ׸  ɸ ð ϰ .
+    PlatformApp app = { "D3D Tutorial 01: CreateDevice", 300, 300, InitApp, Render, Cleanup, NULL, true };
+    return PlatformRun( app );
 }
 
 
@@ -12,6 +12,15 @@
 #include <d3d9.h>
 #include <dxerr.h>
 #include "Vertex.h"
+#include "Resources.h"
+#include "AssetLoaders.h"
+#include "AssetPack.h"
+#include "EffectCache.h"
+#include "StateCache.h"
+#include "DeviceCapture.h"
+#include "Profiler.h"
+#include "FrameStats.h"
+#include "Platform.h"
 
 
 
@@ -55,9 +64,9 @@ IDirect3DDevice9*       g_pd3dDevice = nullptr; /// 
 D3DDEVTYPE              g_devType = D3DDEVTYPE_HAL;
 DWORD                   g_requestedVP = D3DCREATE_SOFTWARE_VERTEXPROCESSING;
 D3DPRESENT_PARAMETERS   g_d3dPP;
-IDirect3DVertexBuffer9* g_pVB = nullptr; ///   
-IDirect3DIndexBuffer9*  g_pIV = nullptr;
-ID3DXEffect*            g_pFx = nullptr;
+VertexBufferHandle      g_hVB;           ///   
+IndexBufferHandle       g_hIV;
+EffectHandle            g_hFx;
 D3DXHANDLE              ghTech;
 
 
@@ -67,6 +76,8 @@ D3DXHANDLE              ghTech;
  */
 HRESULT InitD3D( HWND hWnd )
 {
+    PROFILE_FUNCTION();
+
     /// ̽ ϱ D3Dü 
     if (NULL == (g_pD3D = Direct3DCreate9(D3D_SDK_VERSION)))
         return E_FAIL;
@@ -91,7 +102,8 @@ HRESULT InitD3D( HWND hWnd )
         return E_FAIL;
     }
 
-    /// ̽  óҰ ⿡ Ѵ.
+    /// ̽ ´  ĳø ļ Ѵ.  ٲ  Set* ̹  ʴ´.
+    g_stateCache.Attach( g_pd3dDevice );
 
     return S_OK;
 
@@ -165,15 +177,30 @@ HRESULT InitD3D( HWND hWnd )
 
 HRESULT InitEffect()
 {
+    PROFILE_FUNCTION();
+
     ID3DXBuffer* errors = 0;
-    HR(D3DXCreateEffectFromFile(g_pd3dDevice, "vertex.fx",
-        0, 0, D3DXSHADER_DEBUG, 0, &g_pFx, &errors));
+    ID3DXEffect* pFx = 0;
+
+    /// assets.pak  ѿ,  vertex.fx Ͽ д´.
+    /// ϵ Ʈ shadercache ǰ, ҽ ״θ     д´.
+    g_assets.Mount("assets.pak");
+    HR(g_effectCache.CreateEffect(g_pd3dDevice, "vertex.fx",
+        0, D3DXSHADER_DEBUG, 0, &pFx, &errors));
 
     if (errors)
         MessageBox(0, (char*)errors->GetBufferPointer(), 0, 0);
 
+    if (pFx == nullptr)
+        return E_FAIL;
+
+    g_hFx = g_resources.RegisterEffect(pFx, "vertex.fx");
+
+    /// н    ĳø ġ Ѵ.
+    pFx->SetStateManager(&g_stateCache);
+
     // Obtain handles.
-    ghTech = g_pFx->GetTechniqueByName("VertexTech");
+    ghTech = pFx->GetTechniqueByName("VertexTech");
 
     return S_OK;
 }
@@ -194,6 +221,8 @@ HRESULT InitEffect()
  */
 HRESULT InitVB()
 {
+    PROFILE_FUNCTION();
+
     /// ﰢ ϱ   
     VertexPosColor vertices[] =
     {
@@ -202,11 +231,14 @@ HRESULT InitVB()
         VertexPosColor(  1.0f, -1.0f, 0.5f, 0xff00ffff ),
     };
 
+    IDirect3DVertexBuffer9* pVB = nullptr;
+    IDirect3DIndexBuffer9*  pIV = nullptr;
+
     ///  
     /// 3   ޸𸮸 ҴѴ.
     /// FVF Ͽ    Ѵ.
     if (FAILED(g_pd3dDevice->CreateVertexBuffer(3 * sizeof(VertexPosColor)
-        , D3DUSAGE_WRITEONLY, 0, D3DPOOL_MANAGED, &g_pVB, NULL)))
+        , D3DUSAGE_WRITEONLY, 0, D3DPOOL_MANAGED, &pVB, NULL)))
     {
         return E_FAIL;
     }
@@ -214,27 +246,35 @@ HRESULT InitVB()
     /// ۸  ä. 
     ///  Lock()Լ ȣϿ ͸ ´.
     VertexPosColor* pVertices = nullptr;
-    if( FAILED( g_pVB->Lock( 0, sizeof(vertices), (void**)&pVertices, 0 ) ) )
+    if( FAILED( pVB->Lock( 0, sizeof(vertices), (void**)&pVertices, 0 ) ) )
         return E_FAIL;
     CopyMemory( pVertices, vertices, sizeof(vertices) );
-    g_pVB->Unlock();
+    g_capture.BufferData( pVB, 0, pVertices, sizeof(vertices) );
+    g_frameStats.Lock( sizeof(vertices) );
+    pVB->Unlock();
+
+    g_hVB = g_resources.RegisterVertexBuffer(pVB, "Vertices.Triangle");
 
 
 
     // Obtain a pointer to a new index buffer.
     HR(g_pd3dDevice->CreateIndexBuffer(3 * sizeof(WORD), D3DUSAGE_WRITEONLY,
-        D3DFMT_INDEX16, D3DPOOL_MANAGED, &g_pIV, 0));
+        D3DFMT_INDEX16, D3DPOOL_MANAGED, &pIV, 0));
 
     // Now lock it to obtain a pointer to its internal data, and write the
 
     WORD* k = 0;
 
-    HR(g_pIV->Lock(0, 0, (void**)&k, 0));
+    HR(pIV->Lock(0, 0, (void**)&k, 0));
 
     // Front face.
     k[0] = 0; k[1] = 1; k[2] = 2;
 
-    HR(g_pIV->Unlock());
+    g_capture.BufferData(pIV, 0, k, 3 * sizeof(WORD));
+    g_frameStats.Lock(3 * sizeof(WORD));
+    HR(pIV->Unlock());
+
+    g_hIV = g_resources.RegisterIndexBuffer(pIV, "Vertices.Triangle");
 
 
 
@@ -255,17 +295,25 @@ HRESULT InitVB()
  */
 VOID Cleanup()
 {
-    if (g_pVB != nullptr)
-        g_pVB->Release();
-
-    if (g_pIV != nullptr)
-        g_pIV->Release();
+    g_resources.Release(g_hVB);
+    g_resources.Release(g_hIV);
+    g_resources.Release(g_hFx);
 
-    if (g_pFx != nullptr)
-        g_pFx->Release();
+    g_effectCache.ReportStats();
 
     DestroyAllVertexDeclarations();
 
+    g_capture.End();
+
+    g_profiler.Report( "Vertices" );
+
+    g_frameStats.ReportStats( "Vertices" );
+    g_stateCache.ReportStats( "Vertices" );
+    g_stateCache.Detach();
+
+    ///  Ұ ҽ  ϰ, ȯ  ڵ Ѵ.
+    g_resources.Shutdown();
+
 
 
     if (g_pd3dDevice != nullptr)
@@ -284,8 +332,12 @@ VOID Cleanup()
  */
 VOID Render()
 {
+    PROFILE_FUNCTION();
+
+    g_resources.BeginFrame();
+
     /// ĸ۸ Ķ(0,0,255) .
-    HR(g_pd3dDevice->Clear(0, 0, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER, 0xff000000, 1.0f, 0));
+    HR(g_stateCache.Clear(0, 0, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER, 0xff000000, 1.0f, 0));
     //HR(g_pd3dDevice->Clear(0, 0, D3DCLEAR_TARGET, 0xff000000, 1.0f, 0));
 
     ///  
@@ -293,30 +345,33 @@ VOID Render()
     {
         ///  ﰢ ׸.
         /// 1.  ִ ۸  Ʈ ҴѴ.
-        HR(g_pd3dDevice->SetStreamSource(0, g_pVB, 0, sizeof(VertexPosColor)));
+        HR(g_stateCache.SetStreamSource(0, g_resources.GetVertexBuffer(g_hVB), 0, sizeof(VertexPosColor)));
+
+        HR(g_stateCache.SetIndices(g_resources.GetIndexBuffer(g_hIV)));
 
-        HR(g_pd3dDevice->SetIndices(g_pIV));
+        ID3DXEffect* pFx = g_resources.GetEffect(g_hFx);
 
-        HR(g_pd3dDevice->SetVertexDeclaration(VertexPosColor::Decl))
+        HR(g_stateCache.SetVertexDeclaration(VertexPosColor::Decl));
 
-        HR(g_pFx->SetTechnique(ghTech))
+        HR(pFx->SetTechnique(ghTech))
 
         // Begin passes.
         UINT numPasses = 0;
 
-        HR(g_pFx->Begin(&numPasses, 0));
+        /// ¸ /ϸ   ĳø ȸϹǷ  ʴ´.
+        HR(pFx->Begin(&numPasses, D3DXFX_DONOTSAVESTATE));
 
         for (UINT i = 0; i < numPasses; ++i)
         {
-            HR(g_pFx->BeginPass(i));
+            HR(pFx->BeginPass(i));
 
             /// 3.   ϱ  DrawPrimitive()Լ ȣ
             //HR(g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLELIST, 0, 1));
-            HR(g_pd3dDevice->DrawIndexedPrimitive(D3DPT_TRIANGLELIST, 0, 0, 3, 0, 1));
+            HR(g_stateCache.DrawIndexedPrimitive(D3DPT_TRIANGLELIST, 0, 0, 3, 0, 1));
 
-            HR(g_pFx->EndPass());
+            HR(pFx->EndPass());
         }
-        HR(g_pFx->End());
+        HR(pFx->End());
 
         ///  
         HR(g_pd3dDevice->EndScene());
@@ -324,26 +379,32 @@ VOID Render()
 
     /// ĸ۸ ̴ ȭ!
     g_pd3dDevice->Present( NULL, NULL, NULL, NULL );
+    g_capture.EndFrame();
+    g_frameStats.EndFrame( g_stateCache.Stats() );
+
+    g_resources.EndFrame();
 }
 
 
 
 
 /**-----------------------------------------------------------------------------
- *  ν
+ * ʱȭ
+ * ÷ (Platform.h) â  ڿ θ. â  ϸ window NULL̴.
  *------------------------------------------------------------------------------
  */
-LRESULT WINAPI MsgProc( HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam )
+bool InitApp( PlatformWindow window )
 {
-    switch( msg )
-    {
-        case WM_DESTROY:
-            Cleanup();
-            PostQuitMessage( 0 );
-            return 0;
-    }
+    /// Direct3D ʱȭ
+    if( FAILED( InitD3D( (HWND)window ) ) )
+        return false;
+
+    /// ̴ ʱȭ
+    if( FAILED( InitEffect() ) )
+        return false;
 
-    return DefWindowProc( hWnd, msg, wParam, lParam );
+    ///  ʱȭ
+    return SUCCEEDED( InitVB() );
 }
 
 
@@ -351,54 +412,23 @@ LRESULT WINAPI MsgProc( HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam )
 
 /**-----------------------------------------------------------------------------
  * α׷ 
+ * WinMain()() main()() ÷  ְ,  Ѱ  Լ θ.
  *------------------------------------------------------------------------------
  */
-int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE prevInstance,
-    PSTR cmdLine, int showCmd)
+INT PlatformMain( const char* cmdLine )
 {
-    ///  Ŭ 
-    WNDCLASSEX wc = { sizeof(WNDCLASSEX), CS_CLASSDC, MsgProc, 0L, 0L,
-                      GetModuleHandle(NULL), NULL, NULL, NULL, NULL,
-                      "D3D Tutorial", NULL };
-    RegisterClassEx( &wc );
+    /// "-capture ̸ [-captureframes N]" ϸ ̽  ȣ Ͽ Ѵ.
+    /// (Tools/CaptureReplay ) ̽   ؾ  ° ϵȴ.
+    g_capture.BeginFromCommandLine( cmdLine );
 
-    ///  
-    HWND hWnd = CreateWindow( "D3D Tutorial", "D3D Tutorial 02: Vertices",
-                              WS_OVERLAPPEDWINDOW, 100, 100, 300, 300,
-                              GetDesktopWindow(), NULL, wc.hInstance, NULL );
+    /// "-profile ̸" ϸ    ð Chrome trace (chrome://tracing) Ѵ.
+    g_profiler.ParseCommandLine( cmdLine );
 
+    /// "-stats ̸.csv(.json)" ϸ Ӻ ο ȣ,   Ƚ     پ Ͽ δ.
+    g_frameStats.ParseCommandLine( cmdLine );
 
-    ///  
-    ShowWindow(hWnd, SW_SHOWDEFAULT);
-    UpdateWindow(hWnd);
-
-
-    if (SUCCEEDED(InitD3D(hWnd)))
-    {
-        if (SUCCEEDED(InitEffect()))
-        {
-            if (SUCCEEDED(InitVB()))
-            {
-                /// ޽ 
-                MSG msg;
-                ZeroMemory(&msg, sizeof(msg));
-                while (msg.message != WM_QUIT)
-                {
-                    /// ޽ť ޽  ޽ ó
-                    if (PeekMessage(&msg, NULL, 0U, 0U, PM_REMOVE))
-                    {
-                        TranslateMessage(&msg);
-                        DispatchMessage(&msg);
-                    }
-                    else
-                        /// ó ޽  Render()Լ ȣ
-                        Render();
-                }
-            }
-        }
-    }
-
-	/// ϵ Ŭ Ұ
-    UnregisterClass( "D3D Tutorial", wc.hInstance );
-    return 0;
+    /// â  ޽ óϴ  ÷  Ѵ. ó ޽  Render() θ.
+    /// "-headless -frames N" ϸ â  ʰ N ׸  ɸ ð ϰ .
+    PlatformApp app = { "D3D Tutorial 02: Vertices", 300, 300, InitApp, Render, Cleanup, NULL, false };
+    return PlatformRun( app );
 }
@@ -20,10 +20,23 @@
  **-----------------------------------------------------------------------------
  */
 #include <Windows.h>
-#include <mmsystem.h>	/// TimeGetTime()Լ ϱ ؼ ϴ 
 #include <d3dx9.h>
 #include <dxerr.h>
 #include "Vertex.h"
+#include "HotReload.h"
+#include "AssetLoaders.h"
+#include "AssetPack.h"
+#include "EffectConstants.h"
+#include "EffectCache.h"
+#include "ShaderPermutations.h"
+#include "Math3D.h"
+#include "Transform.h"
+#include "StateCache.h"
+#include "DeviceCapture.h"
+#include "Profiler.h"
+#include "FrameStats.h"
+#include "GameClock.h"
+#include "Platform.h"
 
 
 
@@ -67,14 +80,21 @@ IDirect3DDevice9*       g_pd3dDevice = nullptr; /// 
 D3DDEVTYPE              g_devType = D3DDEVTYPE_HAL;
 DWORD                   g_requestedVP = D3DCREATE_SOFTWARE_VERTEXPROCESSING;
 D3DPRESENT_PARAMETERS   g_d3dPP;
-IDirect3DVertexBuffer9* g_pVB = nullptr; ///   
-IDirect3DIndexBuffer9*  g_pIV = nullptr;
-ID3DXEffect*            g_pFx = nullptr;
+VertexBufferHandle      g_hVB;           ///   
+IndexBufferHandle       g_hIV;
+ShaderPermutations      g_shaders;       /// vertex.fx  պ 
+unsigned                g_features = SHADER_VERTEX_COLOR;   ///   (ġ+)   ִ   Ȱ̴.
 D3DXHANDLE              g_hTech;
-D3DXHANDLE              g_hWVP;
-D3DXMATRIXA16           g_matWorld;
-D3DXMATRIXA16           g_matView;
-D3DXMATRIXA16           g_matProj;
+EffectConstantBuffer    g_constants;     /// Ʈ  CPU 纻. ٲ  εѴ.
+int                     g_iWVP = -1;
+int                     g_iFogStart = -1;
+int                     g_iFogRange = -1;
+int                     g_iFogColor = -1;
+TransformHierarchy      g_transforms;    /// ü  TRS . ٲ ( ڽ) ٽ Ѵ.
+Camera                  g_camera;        /// / .  ٲ  ٽ Ѵ.
+int                     g_nodeTriangle = -1;
+std::vector<unsigned>   g_visibleNodes;  /// ̹ ӿ ׸ 
+std::vector<Mat4>       g_wvps;          /// g_visibleNodes  **
 
 
 
@@ -85,6 +105,8 @@ D3DXMATRIXA16           g_matProj;
  */
 HRESULT InitD3D( HWND hWnd )
 {
+    PROFILE_FUNCTION();
+
     /// ̽ ϱ D3Dü 
     if( NULL == ( g_pD3D = Direct3DCreate9( D3D_SDK_VERSION ) ) )
         return E_FAIL;
@@ -104,28 +126,65 @@ HRESULT InitD3D( HWND hWnd )
         return E_FAIL;
     }
 
+    /// ̽ ´  ĳø ļ Ѵ.  ٲ  Set* ̹  ʴ´.
+    g_stateCache.Attach( g_pd3dDevice );
+
     /// ø . ﰢ ո, ޸  Ѵ.
-    g_pd3dDevice->SetRenderState( D3DRS_CULLMODE, D3DCULL_NONE );
+    g_stateCache.SetRenderState( D3DRS_CULLMODE, D3DCULL_NONE );
 
     ///   Ƿ,  .
-    g_pd3dDevice->SetRenderState( D3DRS_LIGHTING, FALSE );
+    g_stateCache.SetRenderState( D3DRS_LIGHTING, FALSE );
 
     return S_OK;
 }
 
 
+/**-----------------------------------------------------------------------------
+ * Ʈ ũа Ķ ڵ ´.
+ * ٸ  ٲų vertex.fx Ǿ ٽ ϵǸ ڵ鵵 ٽ  Ѵ.
+ *------------------------------------------------------------------------------
+ */
+VOID ObtainEffectHandles(ID3DXEffect* pFx)
+{
+    g_hTech = pFx->GetTechniqueByName("VertexTech");
+
+    ///  ۸  Ʈ ٽ Ѵ.   ǰ  Flush() ö󰣴.
+    ///    -1 ǰ,   Set* õȴ.
+    g_constants.Bind(pFx);
+    g_iWVP      = g_constants.Find("gWVP");
+    g_iFogStart = g_constants.Find("gFogStart");
+    g_iFogRange = g_constants.Find("gFogRange");
+    g_iFogColor = g_constants.Find("gFogColor");
+
+    /// н    ĳø ġ Ѵ.
+    pFx->SetStateManager(&g_stateCache);
+}
+
+
 HRESULT InitEffect()
 {
-    ID3DXBuffer* errors = 0;
-    HR(D3DXCreateEffectFromFile(g_pd3dDevice, "vertex.fx",
-        0, 0, D3DXSHADER_DEBUG, 0, &g_pFx, &errors));
+    PROFILE_FUNCTION();
+
+    /// assets.pak  ѿ,  vertex.fx Ͽ д´.
+    ///  ó   ϵǾ shadercache ǰ, ҽ ״θ     д´.
+    /// vertex.fx ϸ   ׶忡 ٽ ؼ üѴ.
+    g_assets.Mount("assets.pak");
+    g_shaders.Init("vertex.fx", D3DXSHADER_DEBUG, &g_hotReload);
+
+    /// Ű ٲ  ִ  ̸  д.
+    const unsigned variants[] =
+    {
+        SHADER_VERTEX_COLOR, SHADER_VERTEX_COLOR | SHADER_FOG, 0, SHADER_FOG,
+    };
+    if (g_shaders.Warm(g_pd3dDevice, variants, 4) == 0)
+    {
+        MessageBox(0, "vertex.fx could not be compiled", 0, 0);
+        return E_FAIL;
+    }
 
-    if (errors)
-        MessageBox(0, (char*)errors->GetBufferPointer(), 0, 0);
+    ObtainEffectHandles(g_shaders.Get(g_pd3dDevice, g_features));
 
-    // Obtain handles.
-    g_hTech = g_pFx->GetTechniqueByName("VertexTech");
-    g_hWVP = g_pFx->GetParameterByName(0, "gWVP");
+    g_hotReload.Start();
 
     return S_OK;
 }
@@ -139,6 +198,8 @@ HRESULT InitEffect()
  */
 HRESULT InitGeometry()
 {
+    PROFILE_FUNCTION();
+
     /// ﰢ ϱ   
     VertexPosColor vertices[] =
     {
@@ -147,11 +208,14 @@ HRESULT InitGeometry()
         VertexPosColor(  1.0f, -1.0f, 0.0f, 0xff00ffff ),
     };
 
+    IDirect3DVertexBuffer9* pVB = nullptr;
+    IDirect3DIndexBuffer9*  pIV = nullptr;
+
     ///  
     /// 3   ޸𸮸 ҴѴ.
     /// FVF Ͽ    Ѵ.
     if (FAILED(g_pd3dDevice->CreateVertexBuffer(3 * sizeof(VertexPosColor)
-        , D3DUSAGE_WRITEONLY, 0, D3DPOOL_MANAGED, &g_pVB, NULL)))
+        , D3DUSAGE_WRITEONLY, 0, D3DPOOL_MANAGED, &pVB, NULL)))
     {
         return E_FAIL;
     }
@@ -159,27 +223,35 @@ HRESULT InitGeometry()
     /// ۸  ä. 
     ///  Lock()Լ ȣϿ ͸ ´.
     VertexPosColor* pVertices = nullptr;
-    if( FAILED( g_pVB->Lock( 0, sizeof(vertices), (void**)&pVertices, 0 ) ) )
+    if( FAILED( pVB->Lock( 0, sizeof(vertices), (void**)&pVertices, 0 ) ) )
         return E_FAIL;
     CopyMemory( pVertices, vertices, sizeof(vertices) );
-    g_pVB->Unlock();
+    g_capture.BufferData( pVB, 0, pVertices, sizeof(vertices) );
+    g_frameStats.Lock( sizeof(vertices) );
+    pVB->Unlock();
+
+    g_hVB = g_resources.RegisterVertexBuffer(pVB, "Matrices.Triangle");
 
 
 
     // Obtain a pointer to a new index buffer.
     HR(g_pd3dDevice->CreateIndexBuffer(3 * sizeof(WORD), D3DUSAGE_WRITEONLY,
-        D3DFMT_INDEX16, D3DPOOL_MANAGED, &g_pIV, 0));
+        D3DFMT_INDEX16, D3DPOOL_MANAGED, &pIV, 0));
 
     // Now lock it to obtain a pointer to its internal data, and write the
 
     WORD* k = 0;
 
-    HR(g_pIV->Lock(0, 0, (void**)&k, 0));
+    HR(pIV->Lock(0, 0, (void**)&k, 0));
 
     // Front face.
     k[0] = 0; k[1] = 1; k[2] = 2;
 
-    HR(g_pIV->Unlock());
+    g_capture.BufferData(pIV, 0, k, 3 * sizeof(WORD));
+    g_frameStats.Lock(3 * sizeof(WORD));
+    HR(pIV->Unlock());
+
+    g_hIV = g_resources.RegisterIndexBuffer(pIV, "Matrices.Triangle");
 
 
 
@@ -201,17 +273,29 @@ HRESULT InitGeometry()
  */
 VOID Cleanup()
 {
-    if (g_pVB != nullptr)
-        g_pVB->Release();
+    g_hotReload.Stop();
 
-    if (g_pIV != nullptr)
-        g_pIV->Release();
+    g_constants.ReportStats("vertex.fx");
+    g_effectCache.ReportStats();
+    g_constants.Unbind();
 
-    if (g_pFx != nullptr)
-        g_pFx->Release();
+    g_resources.Release(g_hVB);
+    g_resources.Release(g_hIV);
+    g_shaders.Release();
 
     DestroyAllVertexDeclarations();
 
+    g_capture.End();
+
+    g_profiler.Report( "Matrices" );
+
+    g_frameStats.ReportStats( "Matrices" );
+    g_stateCache.ReportStats("Matrices");
+    g_stateCache.Detach();
+
+    ///  Ұ ҽ  ϰ, ȯ  ڵ Ѵ.
+    g_resources.Shutdown();
+
 
 
     if (g_pd3dDevice != nullptr)
@@ -230,36 +314,37 @@ VOID Cleanup()
  */
 VOID SetupMatrices()
 {
+    PROFILE_FUNCTION();
+
 	/// 
-    D3DXMATRIXA16 matWorld;
+	///  Լ D3DX  Math3D.h(SSE2/NEON) . Ծ(޼ ǥ,  ) D3DX .
+    if (g_nodeTriangle < 0)
+        g_nodeTriangle = g_transforms.CreateNode();
 
-    
-    UINT  iTime  = timeGetTime() % 1000;					/// float е ؼ 1000  Ѵ.
-    FLOAT fAngle = iTime * (2.0f * D3DX_PI) / 1000.0f;		/// 1000иʸ ѹ(2 * pi) ȸ ִϸ̼  .
-    D3DXMatrixRotationY( &matWorld, fAngle );				/// Y ȸ 
-    //g_pd3dDevice->SetTransform( D3DTS_WORLD, &matWorld );	///  ȸ ķ ̽ 
-    g_matWorld = matWorld;
+    g_clock.Tick();											/// Ӹ    ð Ѵ.   ִϸ̼   ð .
+    FLOAT fTime  = (FLOAT)fmod( g_clock.Seconds(), 1.0 );	/// float е ؼ 1ʷ  Ѵ.
+    FLOAT fAngle = fTime * (2.0f * MATH_PI);				/// 1ʸ ѹ(2 * pi) ȸ ִϸ̼  .
+    g_transforms.SetRotation( g_nodeTriangle, QuatRotationAxis( Vec3( 0.0f, 1.0f, 0.0f ), fAngle ) );	/// Y ȸ
 
     ///  ϱ ؼ  ʿϴ.    
-    D3DXVECTOR3 vEyePt( 0.0f, 3.0f,-5.0f );							/// 1.  ġ( 0, 3.0, -5)
-    D3DXVECTOR3 vLookatPt( 0.0f, 0.0f, 0.0f );						/// 2.  ٶ󺸴 ġ( 0, 0, 0 )
-    D3DXVECTOR3 vUpVec( 0.0f, 1.0f, 0.0f );							/// 3. õ Ÿ 溤( 0, 1, 0 )
-    D3DXMATRIXA16 matView;
-    D3DXMatrixLookAtLH( &matView, &vEyePt, &vLookatPt, &vUpVec );	/// 1,2,3   
-    //g_pd3dDevice->SetTransform( D3DTS_VIEW, &matView );				///   ̽ 
-    g_matView = matView;
+    Vec3 vEyePt( 0.0f, 3.0f,-5.0f );								/// 1.  ġ( 0, 3.0, -5)
+    Vec3 vLookatPt( 0.0f, 0.0f, 0.0f );								/// 2.  ٶ󺸴 ġ( 0, 0, 0 )
+    Vec3 vUpVec( 0.0f, 1.0f, 0.0f );								/// 3. õ Ÿ 溤( 0, 1, 0 )
+    g_camera.SetLookAt( vEyePt, vLookatPt, vUpVec );				/// 1,2,3   .   ٽ  ʴ´.
 
     ///   ϱ ؼ þ߰(FOV=Field Of View) Ⱦ(aspect ratio), Ŭ   ʿϴ.
-    D3DXMATRIXA16 matProj;
-    /// matProj   :   
-    /// D3DX_PI/4 : FOV(D3DX_PI/4 = 45)
+    /// MATH_PI/4 : FOV(MATH_PI/4 = 45)
     /// 1.0f      : Ⱦ
     /// 1.0f      :  Ŭ (near clipping plane)
     /// 100.0f    : Ÿ Ŭ (far clipping plane)
-    D3DXMatrixPerspectiveFovLH( &matProj, D3DX_PI/4, 1.0f, 1.0f, 100.0f );
+    g_camera.SetPerspective( MATH_PI/4, 1.0f, 1.0f, 100.0f );
+
+    /// ٲ   ϰ, ̴ ü ** Ѳ Ѵ.
+    g_transforms.Update();
 
-    g_matProj = matProj;
-    //g_pd3dDevice->SetTransform(D3DTS_PROJECTION, &g_matProj);		///    ̽ 
+    g_visibleNodes.assign( 1, (unsigned)g_nodeTriangle );
+    g_wvps.resize( g_visibleNodes.size() );
+    g_transforms.ComputeWorldViewProj( g_camera, &g_visibleNodes[0], g_visibleNodes.size(), &g_wvps[0] );
 }
 
 
@@ -270,8 +355,15 @@ VOID SetupMatrices()
  */
 VOID Render()
 {
+    PROFILE_FUNCTION();
+
+    g_resources.BeginFrame();
+
+    /// ׶忡 ٽ  Ʈ   迡 üѴ.
+    g_hotReload.ApplyPending(g_pd3dDevice);
+
     /// ĸ۸ Ķ(0,0,255) .
-    g_pd3dDevice->Clear( 0, NULL, D3DCLEAR_TARGET, D3DCOLOR_XRGB(0,0,0), 1.0f, 0 );
+    g_stateCache.Clear( 0, NULL, D3DCLEAR_TARGET, D3DCOLOR_XRGB(0,0,0), 1.0f, 0 );
 
     ///  
     HR(g_pd3dDevice->BeginScene());
@@ -281,32 +373,50 @@ VOID Render()
 
         ///  ﰢ ׸.
         /// 1.  ִ ۸  Ʈ ҴѴ.
-        HR(g_pd3dDevice->SetStreamSource(0, g_pVB, 0, sizeof(VertexPosColor)));
+        HR(g_stateCache.SetStreamSource(0, g_resources.GetVertexBuffer(g_hVB), 0, sizeof(VertexPosColor)));
+
+        HR(g_stateCache.SetIndices(g_resources.GetIndexBuffer(g_hIV)));
 
-        HR(g_pd3dDevice->SetIndices(g_pIV));
+        ///  ɿ ´  .  ٲų ٽ ϵǾ ڵ ٽ ´.
+        ID3DXEffect* pFx = g_shaders.Get(g_pd3dDevice, g_features);
+        if (pFx == nullptr)
+            pFx = g_shaders.Get(g_pd3dDevice, SHADER_VERTEX_COLOR);
+        if (pFx != g_constants.Effect())
+            ObtainEffectHandles(pFx);
 
-        HR(g_pd3dDevice->SetVertexDeclaration(VertexPosColor::Decl));
+        HR(g_stateCache.SetVertexDeclaration(VertexPosColor::Decl));
 
-        HR(g_pFx->SetTechnique(g_hTech));
+        HR(pFx->SetTechnique(g_hTech));
 
-        HR(g_pFx->SetMatrix(g_hWVP, &(g_matWorld * g_matView * g_matProj)));
+        ///  ٲ ʾ Ʈ ޵ ʴ´.
+        g_constants.SetMatrix(g_iWVP, g_wvps[0]);
+
+        /// Ȱ     ̹Ƿ ó   εȴ.
+        D3DXVECTOR4 fogColor(0.5f, 0.5f, 0.5f, 1.0f);
+        g_constants.SetFloat(g_iFogStart, 5.0f);
+        g_constants.SetFloat(g_iFogRange, 2.0f);
+        g_constants.SetVector(g_iFogColor, &fogColor);
 
         // Begin passes.
         UINT numPasses = 0;
 
-        HR(g_pFx->Begin(&numPasses, 0));
+        /// ¸ /ϸ   ĳø ȸϹǷ  ʴ´.
+        HR(pFx->Begin(&numPasses, D3DXFX_DONOTSAVESTATE));
 
         for (UINT i = 0; i < numPasses; ++i)
         {
-            HR(g_pFx->BeginPass(i));
+            /// ٲ  BeginPass()  Ʈ ø.
+            g_constants.Flush();
+
+            HR(pFx->BeginPass(i));
 
             /// 3.   ϱ  DrawPrimitive()Լ ȣ
             //HR(g_pd3dDevice->DrawPrimitive(D3DPT_TRIANGLELIST, 0, 1));
-            HR(g_pd3dDevice->DrawIndexedPrimitive(D3DPT_TRIANGLELIST, 0, 0, 3, 0, 1));
+            HR(g_stateCache.DrawIndexedPrimitive(D3DPT_TRIANGLELIST, 0, 0, 3, 0, 1));
 
-            HR(g_pFx->EndPass());
+            HR(pFx->EndPass());
         }
-        HR(g_pFx->End());
+        HR(pFx->End());
 
         ///  
         HR(g_pd3dDevice->EndScene());
@@ -316,80 +426,84 @@ VOID Render()
 
     /// ĸ۸ ̴ ȭ!
     g_pd3dDevice->Present( NULL, NULL, NULL, NULL );
+    g_capture.EndFrame();
+    g_frameStats.EndFrame( g_stateCache.Stats() );
+
+    g_resources.EndFrame();
 }
 
 
 
 
 /**-----------------------------------------------------------------------------
- *  ν
+ * ʱȭ
+ * ÷ (Platform.h) â  ڿ θ. â  ϸ window NULL̴.
  *------------------------------------------------------------------------------
  */
-LRESULT WINAPI MsgProc( HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam )
+bool InitApp( PlatformWindow window )
 {
-    switch( msg )
-    {
-        case WM_DESTROY:
-            Cleanup();
-            PostQuitMessage( 0 );
-            return 0;
-    }
+    /// Direct3D ʱȭ
+    if( FAILED( InitD3D( (HWND)window ) ) )
+        return false;
+
+    /// ̴ ʱȭ
+    if( FAILED( InitEffect() ) )
+        return false;
 
-    return DefWindowProc( hWnd, msg, wParam, lParam );
+    ///  ʱȭ
+    return SUCCEEDED( InitGeometry() );
 }
 
 
 
 
 /**-----------------------------------------------------------------------------
- * α׷ 
+ * Է ó
  *------------------------------------------------------------------------------
  */
-INT WINAPI WinMain( HINSTANCE hInst, HINSTANCE, LPSTR, INT )
+void OnEvent( const PlatformEvent& e )
 {
-    ///  Ŭ 
-    WNDCLASSEX wc = { sizeof(WNDCLASSEX), CS_CLASSDC, MsgProc, 0L, 0L,
-                      GetModuleHandle(NULL), NULL, NULL, NULL, NULL,
-                      "D3D Tutorial", NULL };
-    RegisterClassEx( &wc );
-
-    ///  
-    HWND hWnd = CreateWindow( "D3D Tutorial", "D3D Tutorial 03: Matrices",
-                              WS_OVERLAPPEDWINDOW, 100, 100, 300, 300,
-                              GetDesktopWindow(), NULL, wc.hInstance, NULL );
+    if( e.type != PLATFORM_KEY_DOWN )
+        return;
+
+    /// 'C':  Ѱ .
+    if( e.key == 'C' )
+        g_features ^= SHADER_VERTEX_COLOR;
+    /// 'F': Ȱ Ѱ .
+    else if( e.key == 'F' )
+        g_features ^= SHADER_FOG;
+    /// 'P': ִϸ̼ ߰ ٽ δ.
+    else if( e.key == 'P' )
+        g_clock.SetPaused( !g_clock.Paused() );
+}
 
 
-    ///  
-    ShowWindow(hWnd, SW_SHOWDEFAULT);
-    UpdateWindow(hWnd);
 
-    if (SUCCEEDED(InitD3D(hWnd)))
-    {
-        if (SUCCEEDED(InitEffect()))
-        {
-            if (SUCCEEDED(InitGeometry()))
-            {
-                /// ޽ 
-                MSG msg;
-                ZeroMemory(&msg, sizeof(msg));
-                while (msg.message != WM_QUIT)
-                {
-                    /// ޽ť ޽  ޽ ó
-                    if (PeekMessage(&msg, NULL, 0U, 0U, PM_REMOVE))
-                    {
-                        TranslateMessage(&msg);
-                        DispatchMessage(&msg);
-                    }
-                    else
-                        /// ó ޽  Render()Լ ȣ
-                        Render();
-                }
-            }
-        }
-    }
 
-    UnregisterClass( "D3D Tutorial", wc.hInstance );
-    return 0;
+/**-----------------------------------------------------------------------------
+ * α׷ 
+ * WinMain()() main()() ÷  ְ,  Ѱ  Լ θ.
+ *------------------------------------------------------------------------------
+ */
+INT PlatformMain( const char* cmdLine )
+{
+    /// "-capture ̸ [-captureframes N]" ϸ ̽  ȣ Ͽ Ѵ.
+    /// (Tools/CaptureReplay ) ̽   ؾ  ° ϵȴ.
+    g_capture.BeginFromCommandLine( cmdLine );
+
+    /// "-profile ̸" ϸ    ð Chrome trace (chrome://tracing) Ѵ.
+    g_profiler.ParseCommandLine( cmdLine );
+
+    /// "-stats ̸.csv(.json)" ϸ Ӻ ο ȣ,   Ƚ     پ Ͽ δ.
+    g_frameStats.ParseCommandLine( cmdLine );
+    /// "-fixedstep 60" ϸ ɸ ð  Ӹ 1/60ʾ ִϸ̼ Ѵ.     ׷.
+    /// "-timescale 0.5" ϸ  ӵ δ.
+    g_clock.ParseCommandLine( cmdLine );
+
+    /// â  ޽ óϴ  ÷  Ѵ. ó ޽  Render() θ.
+    /// "-headless -frames N" ϸ â  ʰ N ׸  ɸ ð ϰ .
+    PlatformApp app = { "D3D Tutorial 03: Matrices", 300, 300, InitApp, Render, Cleanup, OnEvent, false };
+    return PlatformRun( app );
 }
 
 
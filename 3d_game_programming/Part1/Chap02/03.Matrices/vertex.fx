@@ -3,33 +3,142 @@
 //
 // Basic FX that simply transforms geometry from local space to 
 // homogeneous clip space, and draws the geometry in solid color.
+//
+// Permutations (see Common/ShaderPermutations.h): VERTEX_COLOR, DIRLIGHT,
+// TEXTURE and FOG are defined to 0 or 1 by the application, and each
+// combination compiles to its own minimal shader.  Compiled without any
+// of them, this is the plain vertex color effect.
 //=============================================================================
 
+#if !defined(VERTEX_COLOR) && !defined(DIRLIGHT) && !defined(TEXTURE) && !defined(FOG)
+#define VERTEX_COLOR 1
+#endif
+#ifndef VERTEX_COLOR
+#define VERTEX_COLOR 0
+#endif
+#ifndef DIRLIGHT
+#define DIRLIGHT 0
+#endif
+#ifndef TEXTURE
+#define TEXTURE 0
+#endif
+#ifndef FOG
+#define FOG 0
+#endif
+
 uniform extern float4x4 gWVP;
 
+#if DIRLIGHT
+uniform extern float4x4 gWorld;         // rotation/uniform scale only
+uniform extern float3   gLightDir;      // direction the light travels, world space
+uniform extern float4   gLightColor;
+uniform extern float4   gAmbient;
+#endif
+
+#if TEXTURE
+uniform extern texture  gTex;
+
+sampler TexS = sampler_state
+{
+    Texture   = <gTex>;
+    MinFilter = LINEAR;
+    MagFilter = LINEAR;
+    MipFilter = LINEAR;
+    AddressU  = WRAP;
+    AddressV  = WRAP;
+};
+#endif
+
+#if FOG
+uniform extern float    gFogStart;      // view distance where fog begins
+uniform extern float    gFogRange;      // and over which it becomes opaque
+uniform extern float4   gFogColor;
+#endif
+
+struct InputVS
+{
+    float3 posL    : POSITION0;
+#if DIRLIGHT
+    float3 normalL : NORMAL0;
+#endif
+#if VERTEX_COLOR
+    float4 color   : COLOR0;
+#endif
+#if TEXTURE
+    float2 tex0    : TEXCOORD0;
+#endif
+};
+
 struct OutputVS
 {
     float4 posH  : POSITION0;
     float4 color : COLOR0;
+#if TEXTURE
+    float2 tex0  : TEXCOORD0;
+#endif
+#if FOG
+    float  fog   : TEXCOORD1;
+#endif
 };
 
+// ps_2_0 cannot read POSITION, so the pixel shader gets the rest.
+struct InputPS
+{
+    float4 color : COLOR0;
+#if TEXTURE
+    float2 tex0  : TEXCOORD0;
+#endif
+#if FOG
+    float  fog   : TEXCOORD1;
+#endif
+};
 
-OutputVS ColorVS(float3 posL : POSITION0, float4 c : COLOR0)
+
+OutputVS ColorVS(InputVS input)
 {
     // Zero out our output.
 	OutputVS outVS = (OutputVS)0;
 	
-    outVS.posH = mul(float4(posL, 1.0f), gWVP);
+    outVS.posH = mul(float4(input.posL, 1.0f), gWVP);
 
+#if VERTEX_COLOR
 	// Just pass the vertex color into the pixel shader.
-	outVS.color = c;
+	outVS.color = input.color;
+#else
+    outVS.color = float4(1.0f, 1.0f, 1.0f, 1.0f);
+#endif
+
+#if DIRLIGHT
+    float3 normalW = normalize(mul(input.normalL, (float3x3)gWorld));
+    float  diffuse = saturate(dot(normalW, -gLightDir));
+    outVS.color.rgb *= gAmbient.rgb + diffuse * gLightColor.rgb;
+#endif
+
+#if TEXTURE
+    outVS.tex0 = input.tex0;
+#endif
+
+#if FOG
+    // For a perspective projection w is the view space depth.
+    outVS.fog = saturate((outVS.posH.w - gFogStart) / gFogRange);
+#endif
 	 
 	// Done--return the output.
     return outVS;
 }
 
-float4 ColorPS(float4 c : COLOR0) : COLOR
+float4 ColorPS(InputPS input) : COLOR
 {
+    float4 c = input.color;
+
+#if TEXTURE
+    c *= tex2D(TexS, input.tex0);
+#endif
+
+#if FOG
+    c.rgb = lerp(c.rgb, gFogColor.rgb, input.fog);
+#endif
+
     return c;
 }
 
@@ -9,8 +9,16 @@
  *------------------------------------------------------------------------------
  */
 #include <Windows.h>
-#include <mmsystem.h>
 #include <d3dx9.h>
+#include "Resources.h"
+#include "StateCache.h"
+#include "DeviceCapture.h"
+#include "Profiler.h"
+#include "FrameStats.h"
+#include "GameClock.h"
+#include "Platform.h"
+#include "JobSystem.h"
+#include "FramePipeline.h"
 
 
 
@@ -21,7 +29,23 @@
  */
 LPDIRECT3D9             g_pD3D       = NULL; /// D3D ̽  D3Dü
 LPDIRECT3DDEVICE9       g_pd3dDevice = NULL; ///   D3D̽
-LPDIRECT3DVERTEXBUFFER9 g_pVB        = NULL; ///   
+VertexBufferHandle      g_hVB;               ///   
+
+///   ׸µ ʿ  . ۾ 尡    ä 
+///      ׸.
+struct LightsSnapshot
+{
+    D3DXMATRIXA16 world;    /// 
+    D3DMATERIAL9  material; /// 
+    D3DLIGHT9     light;    /// 0 
+};
+
+///   ռ . 0̸ Ű ׸⸦ ʷ Ѵ.
+/// ϳ   ȭ鿡 ̴   Ӿ ʾ.
+const unsigned                 PIPELINE_DEPTH = 1;
+FramePipeline<LightsSnapshot>  g_pipeline;
+
+void SimulateFrame( LightsSnapshot& s, unsigned frame, double time, void* pUser );
 
 ///    ü
 ///  ϱ⶧ ֺͰ ־ Ѵٴ  .
@@ -43,6 +67,8 @@ struct CUSTOMVERTEX
  */
 HRESULT InitD3D( HWND hWnd )
 {
+    PROFILE_FUNCTION();
+
     /// ̽ ϱ D3Dü 
     if( NULL == ( g_pD3D = Direct3DCreate9( D3D_SDK_VERSION ) ) )
         return E_FAIL;
@@ -65,11 +91,18 @@ HRESULT InitD3D( HWND hWnd )
         return E_FAIL;
     }
 
+    /// ̽ ´  ĳø ļ Ѵ.  ٲ  Set* ̹  ʴ´.
+    g_stateCache.Attach( g_pd3dDevice );
+
     /// ø .
-    g_pd3dDevice->SetRenderState( D3DRS_CULLMODE, D3DCULL_NONE );
+    g_stateCache.SetRenderState( D3DRS_CULLMODE, D3DCULL_NONE );
 
     /// Z۱ Ҵ.
-    g_pd3dDevice->SetRenderState( D3DRS_ZENABLE, TRUE );
+    g_stateCache.SetRenderState( D3DRS_ZENABLE, TRUE );
+
+    /// İ   ۾ 忡   ׸  Ѵ.
+    g_jobs.Start();
+    g_pipeline.Start( SimulateFrame, NULL, PIPELINE_DEPTH );
 
     return S_OK;
 }
@@ -83,17 +116,23 @@ HRESULT InitD3D( HWND hWnd )
  */
 HRESULT InitGeometry()
 {
+    PROFILE_FUNCTION();
+
     ///  
+    LPDIRECT3DVERTEXBUFFER9 pVB = NULL;
     if( FAILED( g_pd3dDevice->CreateVertexBuffer( 50*2*sizeof(CUSTOMVERTEX),
                                                   0, D3DFVF_CUSTOMVERTEX,
-                                                  D3DPOOL_DEFAULT, &g_pVB, NULL ) ) )
+                                                  D3DPOOL_DEFAULT, &pVB, NULL ) ) )
     {
         return E_FAIL;
     }
 
     /// ˰ ؼ Ǹ( Ʒ  ) .
+    /// ۴ ҽ Ǯ ϰ ڵθ Ѵ.
+    g_hVB = g_resources.RegisterVertexBuffer( pVB, "Lights.Cylinder" );
+
     CUSTOMVERTEX* pVertices;
-    if( FAILED( g_pVB->Lock( 0, 0, (void**)&pVertices, 0 ) ) )
+    if( FAILED( pVB->Lock( 0, 0, (void**)&pVertices, 0 ) ) )
         return E_FAIL;
     for( DWORD i=0; i<50; i++ )
     {
@@ -103,7 +142,9 @@ HRESULT InitGeometry()
         pVertices[2*i+1].position = D3DXVECTOR3( sinf(theta), 1.0f, cosf(theta) );	/// Ǹ   ǥ
         pVertices[2*i+1].normal   = D3DXVECTOR3( sinf(theta), 0.0f, cosf(theta) );	/// Ǹ   
     }
-    g_pVB->Unlock();
+    g_capture.BufferData( pVB, 0, pVertices, 50*2*sizeof(CUSTOMVERTEX) );
+    g_frameStats.Lock( 50*2*sizeof(CUSTOMVERTEX) );
+    pVB->Unlock();
 
     return S_OK;
 }
@@ -117,8 +158,24 @@ HRESULT InitGeometry()
  */
 VOID Cleanup()
 {
-    if( g_pVB != NULL )
-        g_pVB->Release();
+    g_resources.Release( g_hVB );
+
+    ///  Ұ ҽ  ϰ, ȯ  ڵ Ѵ.
+    g_resources.Shutdown();
+
+    g_pipeline.Stop();
+    g_pipeline.ReportStats( "Lights" );
+    g_jobs.ReportStats( "Lights" );
+    g_jobs.Stop();
+
+    /// ۾ 尡  ڿ  ð Ѵ.
+    g_profiler.Report( "Lights" );
+
+    g_capture.End();
+
+    g_frameStats.ReportStats( "Lights" );
+    g_stateCache.ReportStats( "Lights" );
+    g_stateCache.Detach();
 
     if( g_pd3dDevice != NULL )
         g_pd3dDevice->Release();
@@ -133,13 +190,12 @@ VOID Cleanup()
  *  
  *------------------------------------------------------------------------------
  */
-VOID SetupMatrices()
+VOID SetupMatrices( const LightsSnapshot& s )
 {
-	/// 
-    D3DXMATRIXA16 matWorld;
-    D3DXMatrixIdentity( &matWorld );							///   
-    D3DXMatrixRotationX( &matWorld, timeGetTime()/500.0f );		/// X ߽ ȸ 
-    g_pd3dDevice->SetTransform( D3DTS_WORLD, &matWorld );		/// ̽  
+    PROFILE_FUNCTION();
+
+	///  SimulateFrame()    .
+    g_stateCache.SetTransform( D3DTS_WORLD, &s.world );			/// ̽  
 
     ///  
     D3DXVECTOR3 vEyePt( 0.0f, 3.0f,-5.0f );
@@ -147,51 +203,73 @@ VOID SetupMatrices()
     D3DXVECTOR3 vUpVec( 0.0f, 1.0f, 0.0f );
     D3DXMATRIXA16 matView;
     D3DXMatrixLookAtLH( &matView, &vEyePt, &vLookatPt, &vUpVec );
-    g_pd3dDevice->SetTransform( D3DTS_VIEW, &matView );
+    g_stateCache.SetTransform( D3DTS_VIEW, &matView );
 
     ///   
     D3DXMATRIXA16 matProj;
     D3DXMatrixPerspectiveFovLH( &matProj, D3DX_PI/4, 1.0f, 1.0f, 100.0f );
-    g_pd3dDevice->SetTransform( D3DTS_PROJECTION, &matProj );
+    g_stateCache.SetTransform( D3DTS_PROJECTION, &matProj );
 }
 
 
 
 
 /**-----------------------------------------------------------------------------
- *  
+ *  
+ * ۾ 忡 Ҹ. ̽ ǵ帮 ʰ s , ,  ä.
  *------------------------------------------------------------------------------
  */
-VOID SetupLights()
+void SimulateFrame( LightsSnapshot& s, unsigned frame, double time, void* pUser )
 {
+    /// time    ð()̴. g_pipeline  ñ  g_clock о Ѱ ش.
+
+    /// 
+    D3DXMatrixIdentity( &s.world );								///   
+    D3DXMatrixRotationX( &s.world, (FLOAT)( time/0.5 ) );		/// X ߽ ȸ 
+
     /// (material)
     ///  ̽  ϳ   ִ.
-    D3DMATERIAL9 mtrl;
+    D3DMATERIAL9& mtrl = s.material;
     ZeroMemory( &mtrl, sizeof(D3DMATERIAL9) );
     mtrl.Diffuse.r = mtrl.Ambient.r = 1.0f;
     mtrl.Diffuse.g = mtrl.Ambient.g = 1.0f;
     mtrl.Diffuse.b = mtrl.Ambient.b = 0.0f;
     mtrl.Diffuse.a = mtrl.Ambient.a = 1.0f;
-    g_pd3dDevice->SetMaterial( &mtrl );
 
     ///  
     D3DXVECTOR3 vecDir;									/// ⼺ (directional light)   
-    D3DLIGHT9 light;									///  ü
+    D3DLIGHT9& light = s.light;							///  ü
     ZeroMemory( &light, sizeof(D3DLIGHT9) );			/// ü 0 .
     light.Type       = D3DLIGHT_DIRECTIONAL;			///  ( ,⼺ ,ƮƮ)
     light.Diffuse.r  = 1.0f;							///   
     light.Diffuse.g  = 1.0f;
     light.Diffuse.b  = 1.0f;
-    vecDir = D3DXVECTOR3(cosf(timeGetTime()/350.0f),	///  
+    vecDir = D3DXVECTOR3(cosf( (FLOAT)( time/0.35 ) ),		///  
                          1.0f,
-                         sinf(timeGetTime()/350.0f) );
+                         sinf( (FLOAT)( time/0.35 ) ) );
     D3DXVec3Normalize( (D3DXVECTOR3*)&light.Direction, &vecDir );	///   ͷ .
     light.Range       = 1000.0f;									///  ٴٸ ִ ִŸ
-    g_pd3dDevice->SetLight( 0, &light );							/// ̽ 0  ġ
-    g_pd3dDevice->LightEnable( 0, TRUE );							/// 0  Ҵ
-    g_pd3dDevice->SetRenderState( D3DRS_LIGHTING, TRUE );			///  Ҵ
+}
 
-    g_pd3dDevice->SetRenderState( D3DRS_AMBIENT, 0x00202020 );		/// ȯ汤(ambient light)  
+
+
+
+/**-----------------------------------------------------------------------------
+ *  
+ * SimulateFrame()     ̽ Ѵ.
+ *------------------------------------------------------------------------------
+ */
+VOID SetupLights( const LightsSnapshot& s )
+{
+    PROFILE_FUNCTION();
+
+    ///    ¸ ٽ , ٲ    ѱ  ĳð ɷ.
+    g_stateCache.SetMaterial( &s.material );
+    g_stateCache.SetLight( 0, &s.light );							/// ̽ 0  ġ
+    g_stateCache.LightEnable( 0, TRUE );							/// 0  Ҵ
+    g_stateCache.SetRenderState( D3DRS_LIGHTING, TRUE );			///  Ҵ
+
+    g_stateCache.SetRenderState( D3DRS_AMBIENT, 0x00202020 );		/// ȯ汤(ambient light)  
 }
 
 
@@ -203,23 +281,30 @@ VOID SetupLights()
  */
 VOID Render()
 {
+    PROFILE_FUNCTION();
+
+    g_resources.BeginFrame();
+
     /// ĸۿ Z۸ .
-    g_pd3dDevice->Clear( 0, NULL, D3DCLEAR_TARGET|D3DCLEAR_ZBUFFER,
-                         D3DCOLOR_XRGB(0,0,255), 1.0f, 0 );
+    g_stateCache.Clear( 0, NULL, D3DCLEAR_TARGET|D3DCLEAR_ZBUFFER,
+                        D3DCOLOR_XRGB(0,0,255), 1.0f, 0 );
 
     ///  
     if( SUCCEEDED( g_pd3dDevice->BeginScene() ) )
     {
-        ///   
-        SetupLights();
+        /// ̹ ׸   . ׵ ۾    Ѵ.
+        const LightsSnapshot& s = g_pipeline.BeginFrame();
 
         /// ,,  Ѵ.
-        SetupMatrices();
+        SetupMatrices( s );
+
+        ///   
+        SetupLights( s );
 
         ///   ׸.
-        g_pd3dDevice->SetStreamSource( 0, g_pVB, 0, sizeof(CUSTOMVERTEX) );
-        g_pd3dDevice->SetFVF( D3DFVF_CUSTOMVERTEX );
-        g_pd3dDevice->DrawPrimitive( D3DPT_TRIANGLESTRIP, 0, 2*50-2 );
+        g_stateCache.SetStreamSource( 0, g_resources.GetVertexBuffer( g_hVB ), 0, sizeof(CUSTOMVERTEX) );
+        g_stateCache.SetFVF( D3DFVF_CUSTOMVERTEX );
+        g_stateCache.DrawPrimitive( D3DPT_TRIANGLESTRIP, 0, 2*50-2 );
 
         ///  
         g_pd3dDevice->EndScene();
@@ -227,76 +312,75 @@ VOID Render()
 
     /// ĸ۸ ̴ ȭ!
     g_pd3dDevice->Present( NULL, NULL, NULL, NULL );
+    g_capture.EndFrame();
+    g_frameStats.EndFrame( g_stateCache.Stats() );
+
+    g_pipeline.EndFrame();
+    g_resources.EndFrame();
 }
 
 
 
 
 /**-----------------------------------------------------------------------------
- *  ν
+ * ʱȭ
+ * ÷ (Platform.h) â  ڿ θ. â  ϸ window NULL̴.
  *------------------------------------------------------------------------------
  */
-LRESULT WINAPI MsgProc( HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam )
+bool InitApp( PlatformWindow window )
 {
-    switch( msg )
-    {
-        case WM_DESTROY:
-            Cleanup();
-            PostQuitMessage( 0 );
-            return 0;
-    }
+    /// Direct3D ʱȭ
+    if( FAILED( InitD3D( (HWND)window ) ) )
+        return false;
 
-    return DefWindowProc( hWnd, msg, wParam, lParam );
+    ///  ʱȭ
+    return SUCCEEDED( InitGeometry() );
 }
 
 
 
 
 /**-----------------------------------------------------------------------------
- * α׷ 
+ * Է ó
  *------------------------------------------------------------------------------
  */
-INT WINAPI WinMain( HINSTANCE hInst, HINSTANCE, LPSTR, INT )
+void OnEvent( const PlatformEvent& e )
 {
-    ///  Ŭ 
-    WNDCLASSEX wc = { sizeof(WNDCLASSEX), CS_CLASSDC, MsgProc, 0L, 0L,
-                      GetModuleHandle(NULL), NULL, NULL, NULL, NULL,
-                      "D3D Tutorial", NULL };
-    RegisterClassEx( &wc );
+    if( e.type != PLATFORM_KEY_DOWN )
+        return;
+
+    /// 'P': ִϸ̼ ߰ ٽ δ.
+    if( e.key == 'P' )
+        g_clock.SetPaused( !g_clock.Paused() );
+}
 
-    ///  
-    HWND hWnd = CreateWindow( "D3D Tutorial", "D3D Tutorial 04: Lights",
-                              WS_OVERLAPPEDWINDOW, 100, 100, 300, 300,
-                              GetDesktopWindow(), NULL, wc.hInstance, NULL );
 
-    /// Direct3D ʱȭ
-    if( SUCCEEDED( InitD3D( hWnd ) ) )
-    {
-        ///  ʱȭ
-        if( SUCCEEDED( InitGeometry() ) )
-        {
-        	///  
-            ShowWindow( hWnd, SW_SHOWDEFAULT );
-            UpdateWindow( hWnd );
-
-        	/// ޽ 
-            MSG msg;
-            ZeroMemory( &msg, sizeof(msg) );
-            while( msg.message!=WM_QUIT )
-            {
-                if( PeekMessage( &msg, NULL, 0U, 0U, PM_REMOVE ) )
-                {
-                    TranslateMessage( &msg );
-                    DispatchMessage( &msg );
-                }
-                else
-                    Render();
-            }
-        }
-    }
 
-    UnregisterClass( "D3D Tutorial", wc.hInstance );
-    return 0;
+
+/**-----------------------------------------------------------------------------
+ * α׷ 
+ * WinMain()() main()() ÷  ְ,  Ѱ  Լ θ.
+ *------------------------------------------------------------------------------
+ */
+INT PlatformMain( const char* cmdLine )
+{
+    /// "-capture ̸ [-captureframes N]" ϸ ̽  ȣ Ͽ Ѵ.
+    /// (Tools/CaptureReplay ) ̽   ؾ  ° ϵȴ.
+    g_capture.BeginFromCommandLine( cmdLine );
+
+    /// "-profile ̸" ϸ    ð Chrome trace (chrome://tracing) Ѵ.
+    g_profiler.ParseCommandLine( cmdLine );
+
+    /// "-stats ̸.csv(.json)" ϸ Ӻ ο ȣ,   Ƚ     پ Ͽ δ.
+    g_frameStats.ParseCommandLine( cmdLine );
+    /// "-fixedstep 60" ϸ ɸ ð  Ӹ 1/60ʾ ִϸ̼ Ѵ.     ׷.
+    /// "-timescale 0.5" ϸ  ӵ δ.
+    g_clock.ParseCommandLine( cmdLine );
+
+    /// â  ޽ óϴ  ÷  Ѵ. ó ޽  Render() θ.
+    /// "-headless -frames N" ϸ â  ʰ N ׸  ɸ ð ϰ .
+    PlatformApp app = { "D3D Tutorial 04: Lights", 300, 300, InitApp, Render, Cleanup, OnEvent, false };
+    return PlatformRun( app );
 }
 
 
@@ -17,8 +17,15 @@
  *------------------------------------------------------------------------------
  */
 #include <Windows.h>
-#include <mmsystem.h>
 #include <d3dx9.h>
+#include "TextureCache.h"
+#include "AssetPack.h"
+#include "StateCache.h"
+#include "DeviceCapture.h"
+#include "Profiler.h"
+#include "FrameStats.h"
+#include "GameClock.h"
+#include "Platform.h"
 
 /// SHOW_HOW_TO_USE_TCI ȰͰ     ݵ  .
 /// #define SHOW_HOW_TO_USE_TCI
@@ -29,8 +36,8 @@
  */
 LPDIRECT3D9             g_pD3D       = NULL; /// D3D ̽  D3Dü
 LPDIRECT3DDEVICE9       g_pd3dDevice = NULL; ///   D3D̽
-LPDIRECT3DVERTEXBUFFER9 g_pVB        = NULL; ///   
-LPDIRECT3DTEXTURE9      g_pTexture   = NULL; /// ؽ 
+VertexBufferHandle      g_hVB;               ///   
+TextureHandle           g_hTexture;          /// ؽ 
 
 ///    ü
 /// ؽ ǥ ߰Ǿٴ  ˼ ִ.
@@ -58,6 +65,8 @@ struct CUSTOMVERTEX
  */
 HRESULT InitD3D( HWND hWnd )
 {
+    PROFILE_FUNCTION();
+
     /// ̽ ϱ D3Dü 
     if( NULL == ( g_pD3D = Direct3DCreate9( D3D_SDK_VERSION ) ) )
         return E_FAIL;
@@ -80,14 +89,17 @@ HRESULT InitD3D( HWND hWnd )
         return E_FAIL;
     }
 
+    /// ̽ ´  ĳø ļ Ѵ.  ٲ  Set* ̹  ʴ´.
+    g_stateCache.Attach( g_pd3dDevice );
+
     /// ø .
-    g_pd3dDevice->SetRenderState( D3DRS_CULLMODE, D3DCULL_NONE );
+    g_stateCache.SetRenderState( D3DRS_CULLMODE, D3DCULL_NONE );
 
     ///  .
-    g_pd3dDevice->SetRenderState( D3DRS_LIGHTING, FALSE );
+    g_stateCache.SetRenderState( D3DRS_LIGHTING, FALSE );
 
     /// Z۱ Ҵ.
-    g_pd3dDevice->SetRenderState( D3DRS_ZENABLE, TRUE );
+    g_stateCache.SetRenderState( D3DRS_ZENABLE, TRUE );
 
     return S_OK;
 }
@@ -102,30 +114,35 @@ HRESULT InitD3D( HWND hWnd )
  */
 HRESULT InitGeometry()
 {
-    /// D3DX迭 Լ ؼ Ϸκ ؽ (banana.bmp)
-    if( FAILED( D3DXCreateTextureFromFile( g_pd3dDevice, "banana.bmp", &g_pTexture ) ) )
+    PROFILE_FUNCTION();
+
+    /// assets.pak  ؽ ĳð ѿ  ã´.
+    g_assets.Mount( "assets.pak" );
+
+    /// ؽ ĳø  Ϸκ ؽ (banana.bmp)
+    ///    ĳð  ˻Ѵ.
+    g_hTexture = g_textureCache.Acquire( g_pd3dDevice, "banana.bmp" );
+    if( g_hTexture.IsNull() )
     {
-        ///     ˻
-        if( FAILED( D3DXCreateTextureFromFile( g_pd3dDevice, "..\\banana.bmp", &g_pTexture ) ) )
-        {
-        	/// ؽ  
-            MessageBox(NULL, "Could not find banana.bmp", "Textures.exe", MB_OK);
-            return E_FAIL;
-        }
+        /// ؽ  
+        MessageBox(NULL, "Could not find banana.bmp", "Textures.exe", MB_OK);
+        return E_FAIL;
     }
 
     ///  
+    LPDIRECT3DVERTEXBUFFER9 pVB = NULL;
     if( FAILED( g_pd3dDevice->CreateVertexBuffer( 50*2*sizeof(CUSTOMVERTEX),
                                                   0, D3DFVF_CUSTOMVERTEX,
-                                                  D3DPOOL_DEFAULT, &g_pVB, NULL ) ) )
+                                                  D3DPOOL_DEFAULT, &pVB, NULL ) ) )
     {
         return E_FAIL;
     }
+    g_hVB = g_resources.RegisterVertexBuffer( pVB, "Textures.Cylinder" );
 
     /// ۸  ä.
     /// ؽ u,vǥ 0.0 ~ 1.0   äְ ִ.
     CUSTOMVERTEX* pVertices;
-    if( FAILED( g_pVB->Lock( 0, 0, (void**)&pVertices, 0 ) ) )
+    if( FAILED( pVB->Lock( 0, 0, (void**)&pVertices, 0 ) ) )
         return E_FAIL;
     for( DWORD i=0; i<50; i++ )
     {
@@ -145,7 +162,9 @@ HRESULT InitGeometry()
         pVertices[2*i+1].tv       = 0.0f;				/// ؽ vǥ 0.0
 #endif
     }
-    g_pVB->Unlock();
+    g_capture.BufferData( pVB, 0, pVertices, 50*2*sizeof(CUSTOMVERTEX) );
+    g_frameStats.Lock( 50*2*sizeof(CUSTOMVERTEX) );
+    pVB->Unlock();
 
     return S_OK;
 }
@@ -159,11 +178,19 @@ HRESULT InitGeometry()
  */
 VOID Cleanup()
 {
-    if( g_pTexture != NULL )
-        g_pTexture->Release();
+    g_textureCache.Release( g_hTexture );
+    g_resources.Release( g_hVB );
+
+    ///  Ұ ҽ  ϰ, ȯ  ڵ Ѵ.
+    g_resources.Shutdown();
+
+    g_capture.End();
 
-    if( g_pVB != NULL )
-        g_pVB->Release();
+    g_profiler.Report( "Textures" );
+
+    g_frameStats.ReportStats( "Textures" );
+    g_stateCache.ReportStats( "Textures" );
+    g_stateCache.Detach();
 
     if( g_pd3dDevice != NULL )
         g_pd3dDevice->Release();
@@ -180,11 +207,14 @@ VOID Cleanup()
  */
 VOID SetupMatrices()
 {
+    PROFILE_FUNCTION();
+
 	/// 
     D3DXMATRIXA16 matWorld;
+    g_clock.Tick();								/// Ӹ    ð Ѵ.   ִϸ̼   ð .
     D3DXMatrixIdentity( &matWorld );
-    D3DXMatrixRotationX( &matWorld, timeGetTime()/1000.0f );
-    g_pd3dDevice->SetTransform( D3DTS_WORLD, &matWorld );
+    D3DXMatrixRotationX( &matWorld, (FLOAT)g_clock.Seconds() );
+    g_stateCache.SetTransform( D3DTS_WORLD, &matWorld );
 
     ///  
     D3DXVECTOR3 vEyePt( 0.0f, 3.0f,-5.0f );
@@ -192,12 +222,12 @@ VOID SetupMatrices()
     D3DXVECTOR3 vUpVec( 0.0f, 1.0f, 0.0f );
     D3DXMATRIXA16 matView;
     D3DXMatrixLookAtLH( &matView, &vEyePt, &vLookatPt, &vUpVec );
-    g_pd3dDevice->SetTransform( D3DTS_VIEW, &matView );
+    g_stateCache.SetTransform( D3DTS_VIEW, &matView );
 
     ///   
     D3DXMATRIXA16 matProj;
     D3DXMatrixPerspectiveFovLH( &matProj, D3DX_PI/4, 1.0f, 1.0f, 100.0f );
-    g_pd3dDevice->SetTransform( D3DTS_PROJECTION, &matProj );
+    g_stateCache.SetTransform( D3DTS_PROJECTION, &matProj );
 }
 
 
@@ -209,9 +239,13 @@ VOID SetupMatrices()
  */
 VOID Render()
 {
+    PROFILE_FUNCTION();
+
+    g_resources.BeginFrame();
+
     /// ĸۿ Z۸ .
-    g_pd3dDevice->Clear( 0, NULL, D3DCLEAR_TARGET|D3DCLEAR_ZBUFFER,
-                         D3DCOLOR_XRGB(0,0,255), 1.0f, 0 );
+    g_stateCache.Clear( 0, NULL, D3DCLEAR_TARGET|D3DCLEAR_ZBUFFER,
+                        D3DCOLOR_XRGB(0,0,255), 1.0f, 0 );
 
     ///  
     if( SUCCEEDED( g_pd3dDevice->BeginScene() ) )
@@ -222,11 +256,11 @@ VOID Render()
         ///  ؽĸ 0 ؽ  ø.
         /// ؽ   ؽĿ   Ҷ ȴ.
         /// ⼭ ؽ    modulate  Ѵ.
-        g_pd3dDevice->SetTexture( 0, g_pTexture );									/// 0 ؽ  ؽ 
-        g_pd3dDevice->SetTextureStageState( 0, D3DTSS_COLOROP,   D3DTOP_MODULATE );	/// MODULATE  
-        g_pd3dDevice->SetTextureStageState( 0, D3DTSS_COLORARG1, D3DTA_TEXTURE );	/// ù°  ؽ 
-        g_pd3dDevice->SetTextureStageState( 0, D3DTSS_COLORARG2, D3DTA_DIFFUSE );	/// ι°   
-        g_pd3dDevice->SetTextureStageState( 0, D3DTSS_ALPHAOP,   D3DTOP_DISABLE );	/// alpha  
+        g_stateCache.SetTexture( 0, g_resources.GetTexture( g_hTexture ) );		/// 0 ؽ  ؽ 
+        g_stateCache.SetTextureStageState( 0, D3DTSS_COLOROP,   D3DTOP_MODULATE );	/// MODULATE  
+        g_stateCache.SetTextureStageState( 0, D3DTSS_COLORARG1, D3DTA_TEXTURE );	/// ù°  ؽ 
+        g_stateCache.SetTextureStageState( 0, D3DTSS_COLORARG2, D3DTA_DIFFUSE );	/// ι°   
+        g_stateCache.SetTextureStageState( 0, D3DTSS_ALPHAOP,   D3DTOP_DISABLE );	/// alpha  
 
     #ifdef SHOW_HOW_TO_USE_TCI
     	/// D3D ؽ ǥ   ϴ  ش.
@@ -244,15 +278,15 @@ VOID Render()
         mat._31 = 0.00f; mat._32 = 0.00f; mat._33 = 1.00f; mat._34 = 0.00f;
         mat._41 = 0.50f; mat._42 = 0.50f; mat._43 = 0.00f; mat._44 = 1.00f;
 
-        g_pd3dDevice->SetTransform( D3DTS_TEXTURE0, &mat );												/// ؽ ȯ
-        g_pd3dDevice->SetTextureStageState( 0, D3DTSS_TEXTURETRANSFORMFLAGS, D3DTTFF_COUNT2 );			/// 2 ؽ 
-        g_pd3dDevice->SetTextureStageState( 0, D3DTSS_TEXCOORDINDEX, D3DTSS_TCI_CAMERASPACEPOSITION );	/// ī޶ ǥ ȯ
+        g_stateCache.SetTransform( D3DTS_TEXTURE0, &mat );												/// ؽ ȯ
+        g_stateCache.SetTextureStageState( 0, D3DTSS_TEXTURETRANSFORMFLAGS, D3DTTFF_COUNT2 );			/// 2 ؽ 
+        g_stateCache.SetTextureStageState( 0, D3DTSS_TEXCOORDINDEX, D3DTSS_TCI_CAMERASPACEPOSITION );	/// ī޶ ǥ ȯ
     #endif
 
         ///   ׸.
-        g_pd3dDevice->SetStreamSource( 0, g_pVB, 0, sizeof(CUSTOMVERTEX) );
-        g_pd3dDevice->SetFVF( D3DFVF_CUSTOMVERTEX );
-        g_pd3dDevice->DrawPrimitive( D3DPT_TRIANGLESTRIP, 0, 2*50-2 );
+        g_stateCache.SetStreamSource( 0, g_resources.GetVertexBuffer( g_hVB ), 0, sizeof(CUSTOMVERTEX) );
+        g_stateCache.SetFVF( D3DFVF_CUSTOMVERTEX );
+        g_stateCache.DrawPrimitive( D3DPT_TRIANGLESTRIP, 0, 2*50-2 );
 
         ///  
         g_pd3dDevice->EndScene();
@@ -260,76 +294,74 @@ VOID Render()
 
     /// ĸ۸ ̴ ȭ!
     g_pd3dDevice->Present( NULL, NULL, NULL, NULL );
+    g_capture.EndFrame();
+    g_frameStats.EndFrame( g_stateCache.Stats() );
+
+    g_resources.EndFrame();
 }
 
 
 
 
 /**-----------------------------------------------------------------------------
- *  ν
+ * ʱȭ
+ * ÷ (Platform.h) â  ڿ θ. â  ϸ window NULL̴.
  *------------------------------------------------------------------------------
  */
-LRESULT WINAPI MsgProc( HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam )
+bool InitApp( PlatformWindow window )
 {
-    switch( msg )
-    {
-        case WM_DESTROY:
-            Cleanup();
-            PostQuitMessage( 0 );
-            return 0;
-    }
+    /// Direct3D ʱȭ
+    if( FAILED( InitD3D( (HWND)window ) ) )
+        return false;
 
-    return DefWindowProc( hWnd, msg, wParam, lParam );
+    ///  ʱȭ
+    return SUCCEEDED( InitGeometry() );
 }
 
 
 
 
 /**-----------------------------------------------------------------------------
- * α׷ 
+ * Է ó
  *------------------------------------------------------------------------------
  */
-INT WINAPI WinMain( HINSTANCE hInst, HINSTANCE, LPSTR, INT )
+void OnEvent( const PlatformEvent& e )
 {
-    ///  Ŭ 
-    WNDCLASSEX wc = { sizeof(WNDCLASSEX), CS_CLASSDC, MsgProc, 0L, 0L,
-                      GetModuleHandle(NULL), NULL, NULL, NULL, NULL,
-                      "D3D Tutorial", NULL };
-    RegisterClassEx( &wc );
+    if( e.type != PLATFORM_KEY_DOWN )
+        return;
+
+    /// 'P': ִϸ̼ ߰ ٽ δ.
+    if( e.key == 'P' )
+        g_clock.SetPaused( !g_clock.Paused() );
+}
 
-    ///  
-    HWND hWnd = CreateWindow( "D3D Tutorial", "D3D Tutorial 05: Textures",
-                              WS_OVERLAPPEDWINDOW, 100, 100, 300, 300,
-                              GetDesktopWindow(), NULL, wc.hInstance, NULL );
 
-    /// Direct3D ʱȭ
-    if( SUCCEEDED( InitD3D( hWnd ) ) )
-    {
-        ///  ʱȭ
-        if( SUCCEEDED( InitGeometry() ) )
-        {
-        	///  
-            ShowWindow( hWnd, SW_SHOWDEFAULT );
-            UpdateWindow( hWnd );
-
-        	/// ޽ 
-            MSG msg;
-            ZeroMemory( &msg, sizeof(msg) );
-            while( msg.message!=WM_QUIT )
-            {
-                if( PeekMessage( &msg, NULL, 0U, 0U, PM_REMOVE ) )
-                {
-                    TranslateMessage( &msg );
-                    DispatchMessage( &msg );
-                }
-                else
-                    Render();
-            }
-        }
-    }
 
-    UnregisterClass( "D3D Tutorial", wc.hInstance );
-    return 0;
+
+/**-----------------------------------------------------------------------------
+ * α׷ 
+ * WinMain()() main()() ÷  ְ,  Ѱ  Լ θ.
+ *------------------------------------------------------------------------------
+ */
+INT PlatformMain( const char* cmdLine )
+{
+    /// "-capture ̸ [-captureframes N]" ϸ ̽  ȣ Ͽ Ѵ.
+    /// (Tools/CaptureReplay ) ̽   ؾ  ° ϵȴ.
+    g_capture.BeginFromCommandLine( cmdLine );
+
+    /// "-profile ̸" ϸ    ð Chrome trace (chrome://tracing) Ѵ.
+    g_profiler.ParseCommandLine( cmdLine );
+
+    /// "-stats ̸.csv(.json)" ϸ Ӻ ο ȣ,   Ƚ     پ Ͽ δ.
+    g_frameStats.ParseCommandLine( cmdLine );
+    /// "-fixedstep 60" ϸ ɸ ð  Ӹ 1/60ʾ ִϸ̼ Ѵ.     ׷.
+    /// "-timescale 0.5" ϸ  ӵ δ.
+    g_clock.ParseCommandLine( cmdLine );
+
+    /// â  ޽ óϴ  ÷  Ѵ. ó ޽  Render() θ.
+    /// "-headless -frames N" ϸ â  ʰ N ׸  ɸ ð ϰ .
+    PlatformApp app = { "D3D Tutorial 05: Textures", 300, 300, InitApp, Render, Cleanup, OnEvent, false };
+    return PlatformRun( app );
 }
 
 
@@ -15,8 +15,28 @@
  *------------------------------------------------------------------------------
  */
 #include <Windows.h>
-#include <mmsystem.h>
 #include <d3dx9.h>
+#include "TextureCache.h"
+#include "HotReload.h"
+#include "AssetLoaders.h"
+#include "AssetPack.h"
+#include "Math3D.h"
+#include "Transform.h"
+#include "Culling.h"
+#include "MeshBounds.h"
+#include "OcclusionBuffer.h"
+#include "StateCache.h"
+#include "DeviceCapture.h"
+#include "Profiler.h"
+#include "FrameStats.h"
+#include "GameClock.h"
+#include "Platform.h"
+#include "CommandBuffer.h"
+#include "JobSystem.h"
+#include "FrameArena.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
 
 
 
@@ -28,11 +48,46 @@
 LPDIRECT3D9             g_pD3D       = NULL; /// D3D ̽  D3Dü
 LPDIRECT3DDEVICE9       g_pd3dDevice = NULL; ///   D3D̽
 
-LPD3DXMESH              g_pMesh          = NULL; // ޽ ü
+MeshHandle              g_hMesh;                 // ޽ ü ڵ
 D3DMATERIAL9*           g_pMeshMaterials = NULL; // ޽ÿ  
-LPDIRECT3DTEXTURE9*     g_pMeshTextures  = NULL; // ޽ÿ  ؽ
+TextureHandle*          g_hMeshTextures  = NULL; // ޽ÿ  ؽ ڵ
 DWORD                   g_dwNumMaterials = 0L;   // ޽ÿ   
 
+MeshBounds              g_meshBounds;            // ޽ø   ڿ 豸(ü )
+Camera                  g_camera;                // / 
+Frustum                 g_frustum;               // * Ŀ  ü ( )
+unsigned                g_frustumVersion = ~0u;  // g_frustum  ī޶ 
+CullBounds              g_cullBounds;            // ü   (SoA)
+std::vector<Mat4>       g_instanceWorlds;        // ü 
+std::vector<Aabb>       g_instanceBoxes;         // ü   
+std::vector<unsigned>   g_visible;               // ̹ ӿ ̴ ü
+std::vector< std::vector<unsigned> > g_chunkVisible;  // ø ۾  ̴ ü
+const unsigned          CULL_CHUNK = 256;        // ø ۾ ϳ ˻ ü (8 )
+Mat4                    g_instanceRotation;      // ̹ ӿ  ü ϴ ȸ
+JobCounter              g_transformJobs;         //   ۾
+JobCounter              g_cullJobs;              // ü ø ۾( ۾  Ѵ)
+int                     g_gridSize = 1;          // 'G'Ű: ȣ 1 <-> GRID_SIZE x GRID_SIZE 
+const int               GRID_SIZE    = 32;
+const float             GRID_SPACING = 3.0f;
+
+OcclusionBuffer         g_occlusion;             //  ü  ü ã ػ CPU  
+std::vector<Vec3>       g_occluderPositions;     //  ü ׸ ȣ ﰢ(ü )
+std::vector<unsigned>   g_occluderIndices;
+bool                    g_bOcclusion = true;     // 'O'Ű:  ø ѱ/
+const unsigned          MAX_OCCLUDERS = 8;       //   ü   ü .
+unsigned long long      g_totalOcclusionTested = 0;
+unsigned long long      g_totalOccluded = 0;
+double                  g_totalOcclusionMs = 0.0;
+
+CommandRecorder         g_recorder;              // ׸   忡  Ѵ.
+ID3DXMesh*              g_pFrameMesh = NULL;     // ̹ ӿ  ޽ÿ ؽ(ڵ ̸ Ǯ д)
+IDirect3DTexture9**     g_frameTextures = NULL;  //  ޸𸮿    ޴´.
+
+unsigned                g_frameCount  = 0;
+unsigned long long      g_totalTested = 0;       //    
+unsigned long long      g_totalCulled = 0;
+double                  g_totalCullMs = 0.0;
+
 
 
 
@@ -42,6 +97,8 @@ DWORD                   g_dwNumMaterials = 0L;   // 
  */
 HRESULT InitD3D( HWND hWnd )
 {
+    PROFILE_FUNCTION();
+
     /// ̽ ϱ D3Dü 
     if( NULL == ( g_pD3D = Direct3DCreate9( D3D_SDK_VERSION ) ) )
         return E_FAIL;
@@ -64,11 +121,19 @@ HRESULT InitD3D( HWND hWnd )
         return E_FAIL;
     }
 
+    /// ̽ ´  ĳø ļ Ѵ.  ٲ  Set* ̹  ʴ´.
+    /// DrawSubset() , ε, FVF  ϹǷ  µ ĳø ġ ʴ´.
+    g_stateCache.Attach( g_pd3dDevice );
+
+    ///  , ø, ׸     ۾ 带 .
+    ///  ϱ(g_recorder)  带  ʰ  ۾ 鿡  ñ.
+    g_jobs.Start();
+
     /// Z۱ Ҵ.
-    g_pd3dDevice->SetRenderState( D3DRS_ZENABLE, TRUE );
+    g_stateCache.SetRenderState( D3DRS_ZENABLE, TRUE );
 
     /// ֺ ִ
-    g_pd3dDevice->SetRenderState( D3DRS_AMBIENT, 0xffffffff );
+    g_stateCache.SetRenderState( D3DRS_AMBIENT, 0xffffffff );
 
     return S_OK;
 }
@@ -77,36 +142,18 @@ HRESULT InitD3D( HWND hWnd )
 
 
 /**-----------------------------------------------------------------------------
- *  ʱȭ
- * ޽б,  ؽ 迭 
+ *  ؽ 迭 
+ * ޽ø ó  tiger.x Ǿ ٽ   ȴ.
  *------------------------------------------------------------------------------
  */
-HRESULT InitGeometry()
+VOID InitMaterials( LPD3DXBUFFER pD3DXMtrlBuffer, DWORD dwNumMaterials )
 {
-	///  ӽ÷  ۼ
-    LPD3DXBUFFER pD3DXMtrlBuffer;
-
-    /// Tiger.x ޽÷ оδ. ̶  Բ д´.
-    if( FAILED( D3DXLoadMeshFromX( "Tiger.x", D3DXMESH_SYSTEMMEM, 
-                                   g_pd3dDevice, NULL, 
-                                   &pD3DXMtrlBuffer, NULL, &g_dwNumMaterials, 
-                                   &g_pMesh ) ) )
-    {
-        ///      ˻
-        if( FAILED( D3DXLoadMeshFromX( "..\\Tiger.x", D3DXMESH_SYSTEMMEM, 
-                                    g_pd3dDevice, NULL, 
-                                    &pD3DXMtrlBuffer, NULL, &g_dwNumMaterials, 
-                                    &g_pMesh ) ) )
-        {
-            MessageBox(NULL, "Could not find tiger.x", "Meshes.exe", MB_OK);
-            return E_FAIL;
-        }
-    }
+    g_dwNumMaterials = dwNumMaterials;
 
     ///  ؽ   ̾Ƴ.
     D3DXMATERIAL* d3dxMaterials = (D3DXMATERIAL*)pD3DXMtrlBuffer->GetBufferPointer();
     g_pMeshMaterials = new D3DMATERIAL9[g_dwNumMaterials];			/// ŭ ü 迭 
-    g_pMeshTextures  = new LPDIRECT3DTEXTURE9[g_dwNumMaterials];	/// ŭ ؽ 迭 
+    g_hMeshTextures  = new TextureHandle[g_dwNumMaterials];		/// ŭ ؽ ڵ 迭 
 
     for( DWORD i=0; i<g_dwNumMaterials; i++ )
     {
@@ -116,30 +163,110 @@ HRESULT InitGeometry()
         /// ֺ Diffuse
         g_pMeshMaterials[i].Ambient = g_pMeshMaterials[i].Diffuse;
 
-        g_pMeshTextures[i] = NULL;
         if( d3dxMaterials[i].pTextureFilename != NULL && 
             lstrlen(d3dxMaterials[i].pTextureFilename) > 0 )
         {
-            /// ؽĸ Ͽ εѴ
-            if( FAILED( D3DXCreateTextureFromFile( g_pd3dDevice, 
-                                                d3dxMaterials[i].pTextureFilename, 
-                                                &g_pMeshTextures[i] ) ) )
+            /// ؽĴ ĳø  д´.     Ű 
+            /// ѹ εǰ  ؽĸ Ѵ.
+            ///     ĳð  ˻Ѵ.
+            g_hMeshTextures[i] = g_textureCache.Acquire( g_pd3dDevice, d3dxMaterials[i].pTextureFilename );
+            if( g_hMeshTextures[i].IsNull() )
             {
-                /// ؽİ     ˻
-                const TCHAR* strPrefix = TEXT("..\\");
-                const int lenPrefix = lstrlen( strPrefix );
-                TCHAR strTexture[MAX_PATH];
-                lstrcpyn( strTexture, strPrefix, MAX_PATH );
-                lstrcpyn( strTexture + lenPrefix, d3dxMaterials[i].pTextureFilename, MAX_PATH - lenPrefix );
-                if( FAILED( D3DXCreateTextureFromFile( g_pd3dDevice, 
-                                                    strTexture, 
-                                                    &g_pMeshTextures[i] ) ) )
-                {
-                    MessageBox(NULL, "Could not find texture map", "Meshes.exe", MB_OK);
-                }
+                MessageBox(NULL, "Could not find texture map", "Meshes.exe", MB_OK);
             }
         }
     }
+}
+
+
+
+
+/**-----------------------------------------------------------------------------
+ *  ؽ 迭 Ұ
+ *------------------------------------------------------------------------------
+ */
+VOID CleanupMaterials()
+{
+    if( g_pMeshMaterials != NULL ) 
+        delete[] g_pMeshMaterials;
+    g_pMeshMaterials = NULL;
+
+    if( g_hMeshTextures )
+    {
+        for( DWORD i = 0; i < g_dwNumMaterials; i++ )
+            g_textureCache.Release( g_hMeshTextures[i] );
+        delete[] g_hMeshTextures;
+    }
+    g_hMeshTextures  = NULL;
+    g_dwNumMaterials = 0;
+}
+
+
+
+
+/**-----------------------------------------------------------------------------
+ * tiger.x Ǿ ٽ  ȣȴ.
+ * ޽ô ̹ ڵ ڿ üǾǷ  ٽ .
+ *------------------------------------------------------------------------------
+ */
+VOID OnMeshReloaded( ID3DXMesh* pMesh, ID3DXBuffer* pD3DXMtrlBuffer, DWORD dwNumMaterials )
+{
+    CleanupMaterials();
+    InitMaterials( pD3DXMtrlBuffer, dwNumMaterials );
+
+    ///  ٲ  Ƿ   ü ﰢ ٽ .
+    ComputeMeshBounds( pMesh, dwNumMaterials, &g_meshBounds );
+    ReadMeshTriangles( pMesh, g_occluderPositions, g_occluderIndices );
+}
+
+
+
+
+/**-----------------------------------------------------------------------------
+ *  ʱȭ
+ * ޽б,  ؽ 迭 
+ *------------------------------------------------------------------------------
+ */
+HRESULT InitGeometry()
+{
+    PROFILE_FUNCTION();
+
+	///  ӽ÷  ۼ
+    LPD3DXBUFFER pD3DXMtrlBuffer;
+    LPD3DXMESH   pMesh = NULL;
+    DWORD        dwNumMaterials = 0;
+    std::string  strMeshFile;
+
+    /// assets.pak  ޽ÿ ؽĸ ѿ д´.
+    ///  ѹ  ޸𸮸ϹǷ ϸ  ˻ϴ  .
+    g_assets.Mount( "assets.pak" );
+
+    /// Tiger.x ޽÷ оδ. ̶  Բ д´.
+    ///      ˻Ѵ.
+    if( FAILED( LoadMeshFromAsset( "Tiger.x", D3DXMESH_SYSTEMMEM, 
+                                   g_pd3dDevice, NULL, 
+                                   &pD3DXMtrlBuffer, NULL, &dwNumMaterials, 
+                                   &pMesh ) ) )
+    {
+        MessageBox(NULL, "Could not find tiger.x", "Meshes.exe", MB_OK);
+        return E_FAIL;
+    }
+
+    /// ޽ô ҽ Ǯ ϰ ڵθ Ѵ.
+    g_hMesh = g_resources.RegisterMesh( pMesh, "tiger.x" );
+
+    /// ޽, ؽ  Ǹ α׷ ٽ  ʾƵ 
+    /// ش ϸ ٽ о  Ӻ Ѵ.
+    g_hotReload.WatchTextureCache( g_textureCache );
+    if( g_assets.ResolveLoose( "Tiger.x", strMeshFile ) )
+        g_hotReload.WatchMesh( g_hMesh, strMeshFile.c_str(), D3DXMESH_SYSTEMMEM, OnMeshReloaded );
+    g_hotReload.Start();
+
+    InitMaterials( pD3DXMtrlBuffer, dwNumMaterials );
+
+    /// ø  ڿ 豸,  ü ﰢ  ѹ .
+    ComputeMeshBounds( pMesh, dwNumMaterials, &g_meshBounds );
+    ReadMeshTriangles( pMesh, g_occluderPositions, g_occluderIndices );
 
     /// ӽ÷   Ұ
     pD3DXMtrlBuffer->Release();
@@ -151,26 +278,66 @@ HRESULT InitGeometry()
 
 
 /**-----------------------------------------------------------------------------
- * ʱȭ ü Ұ
+ * ø  
  *------------------------------------------------------------------------------
  */
-VOID Cleanup()
+VOID ReportCullStats()
 {
-    if( g_pMeshMaterials != NULL ) 
-        delete[] g_pMeshMaterials;
+    if( g_frameCount == 0 )
+        return;
 
-    if( g_pMeshTextures )
+    char msg[256];
+    _snprintf( msg, sizeof(msg), "[Culling] %u frames: %.1f objects tested, %.1f culled per frame, %.4f ms per frame\n",
+               g_frameCount, (double)g_totalTested / g_frameCount, (double)g_totalCulled / g_frameCount,
+               g_totalCullMs / g_frameCount );
+    OutputDebugStringA( msg );
+
+    if( g_totalOcclusionTested > 0 )
     {
-        for( DWORD i = 0; i < g_dwNumMaterials; i++ )
-        {
-            if( g_pMeshTextures[i] )
-                g_pMeshTextures[i]->Release();
-        }
-        delete[] g_pMeshTextures;
+        _snprintf( msg, sizeof(msg), "[Occlusion] %.1f%% of draws culled (%.1f per frame), %.4f ms per frame\n",
+                   100.0 * g_totalOccluded / g_totalOcclusionTested, (double)g_totalOccluded / g_frameCount,
+                   g_totalOcclusionMs / g_frameCount );
+        OutputDebugStringA( msg );
     }
-    if( g_pMesh != NULL )
-        g_pMesh->Release();
-    
+}
+
+
+
+
+/**-----------------------------------------------------------------------------
+ * ʱȭ ü Ұ
+ *------------------------------------------------------------------------------
+ */
+VOID Cleanup()
+{
+    g_hotReload.Stop();
+
+    CleanupMaterials();
+    ReportCullStats();
+    g_textureCache.ReportStats();
+    g_assets.ReportStats();
+    g_resources.Release( g_hMesh );
+
+    ///  Ұ ҽ  ϰ, ȯ  ڵ Ѵ.
+    g_resources.Shutdown();
+
+    g_recorder.ReportStats( "Meshes" );
+    g_recorder.Clear();
+
+    g_frameArena.ReportStats( "Meshes" );
+
+    g_jobs.ReportStats( "Meshes" );
+    g_jobs.Stop();
+
+    /// ۾ 尡  ڿ  ð Ѵ.
+    g_profiler.Report( "Meshes" );
+
+    g_capture.End();
+
+    g_frameStats.ReportStats( "Meshes" );
+    g_stateCache.ReportStats( "Meshes" );
+    g_stateCache.Detach();
+
     if( g_pd3dDevice != NULL )
         g_pd3dDevice->Release();
 
@@ -184,25 +351,200 @@ VOID Cleanup()
  *  
  *------------------------------------------------------------------------------
  */
+/// ü [begin, end) İ   ڸ Ѵ. ۾ 忡 Ҹ.
+void UpdateInstances( void* pData, unsigned begin, unsigned end )
+{
+    for( unsigned i = begin; i < end; i++ )
+    {
+        float x = ( (int)(i % g_gridSize) - g_gridSize / 2 ) * GRID_SPACING;
+        float z = ( (int)(i / g_gridSize) - g_gridSize / 2 ) * GRID_SPACING;
+        g_instanceWorlds[i] = g_instanceRotation * Mat4Translation( x, 0.0f, z );
+        g_instanceBoxes[i] = TransformAabb( g_meshBounds.box, g_instanceWorlds[i] );
+        g_cullBounds.Set( i, g_instanceBoxes[i] );
+    }
+}
+
 VOID SetupMatrices()
 {
-	/// 
-    D3DXMATRIXA16 matWorld;
-    D3DXMatrixRotationY( &matWorld, timeGetTime()/1000.0f );
-    g_pd3dDevice->SetTransform( D3DTS_WORLD, &matWorld );
+    PROFILE_FUNCTION();
+
+	/// . ü  ȸ  ġŭ ̵Ѵ.
+    ///   ڴ ü  ڸ ķ ȯؼ ´.
+    /// 迭 ũ ⼭ ߰,  ۾ 忡 ñ ä ī޶ Ѵ.
+    g_clock.Tick();								/// Ӹ    ð Ѵ.
+    g_instanceRotation = Mat4RotationY( (FLOAT)g_clock.Seconds() );
+    unsigned numInstances = (unsigned)(g_gridSize * g_gridSize);
+    g_instanceWorlds.resize( numInstances );
+    g_instanceBoxes.resize( numInstances );
+    g_cullBounds.Resize( numInstances );
+    g_jobs.ParallelFor( numInstances, 64, UpdateInstances, NULL, &g_transformJobs );
 
     ///  
-    D3DXVECTOR3 vEyePt( 0.0f, 3.0f,-5.0f );
-    D3DXVECTOR3 vLookatPt( 0.0f, 0.0f, 0.0f );
-    D3DXVECTOR3 vUpVec( 0.0f, 1.0f, 0.0f );
-    D3DXMATRIXA16 matView;
-    D3DXMatrixLookAtLH( &matView, &vEyePt, &vLookatPt, &vUpVec );
-    g_pd3dDevice->SetTransform( D3DTS_VIEW, &matView );
+    g_camera.SetLookAt( Vec3( 0.0f, 3.0f,-5.0f ), Vec3( 0.0f, 0.0f, 0.0f ), Vec3( 0.0f, 1.0f, 0.0f ) );
+    g_stateCache.SetTransform( D3DTS_VIEW, (const D3DMATRIX*)g_camera.View().Data() );
 
     ///   
-    D3DXMATRIXA16 matProj;
-    D3DXMatrixPerspectiveFovLH( &matProj, D3DX_PI/4, 1.0f, 1.0f, 100.0f );
-    g_pd3dDevice->SetTransform( D3DTS_PROJECTION, &matProj );
+    g_camera.SetPerspective( MATH_PI/4, 1.0f, 1.0f, 100.0f );
+    g_stateCache.SetTransform( D3DTS_PROJECTION, (const D3DMATRIX*)g_camera.Proj().Data() );
+
+    /// ī޶ ٲ  ü  ٽ ̴´.
+    if( g_frustumVersion != g_camera.Version() )
+    {
+        g_frustum.Extract( g_camera.ViewProj() );
+        g_frustumVersion = g_camera.Version();
+    }
+}
+
+
+
+/**-----------------------------------------------------------------------------
+ *  ø
+ * ī޶   ü  ػ  ۿ ׸ ,  ü
+ * ڰ  ڿ   ׸ ʴ´.
+ *------------------------------------------------------------------------------
+ */
+bool CloserToCamera( unsigned a, unsigned b )
+{
+    Vec3 eye = g_camera.Eye();
+    Vec3 da  = Vec3( g_instanceWorlds[a].m[3][0], g_instanceWorlds[a].m[3][1], g_instanceWorlds[a].m[3][2] ) - eye;
+    Vec3 db  = Vec3( g_instanceWorlds[b].m[3][0], g_instanceWorlds[b].m[3][1], g_instanceWorlds[b].m[3][2] ) - eye;
+    return Vec3Dot( da, da ) < Vec3Dot( db, db );
+}
+
+VOID OccludeObjects()
+{
+    PROFILE_FUNCTION();
+
+    g_occlusion.Clear();
+    if( g_visible.size() <= 1 || g_occluderIndices.empty() )
+        return;
+
+    ///   MAX_OCCLUDERS   ü ׸.
+    unsigned numOccluders = std::min( MAX_OCCLUDERS, (unsigned)g_visible.size() );
+    std::partial_sort( g_visible.begin(), g_visible.begin() + numOccluders, g_visible.end(), CloserToCamera );
+
+    const Mat4& matViewProj = g_camera.ViewProj();
+    for( unsigned i = 0; i < numOccluders; i++ )
+    {
+        g_occlusion.RenderOccluder( &g_occluderPositions[0], (unsigned)g_occluderPositions.size(),
+                                    &g_occluderIndices[0], (unsigned)g_occluderIndices.size() / 3,
+                                    g_instanceWorlds[g_visible[i]] * matViewProj );
+    }
+
+    ///   ü .
+    size_t keep = 0;
+    for( size_t i = 0; i < g_visible.size(); i++ )
+    {
+        if( g_occlusion.TestAabb( g_instanceBoxes[g_visible[i]], matViewProj ) )
+            g_visible[keep++] = g_visible[i];
+    }
+    g_visible.resize( keep );
+
+    const OcclusionStats& s = g_occlusion.Stats();
+    g_totalOcclusionTested += s.tested;
+    g_totalOccluded        += s.occluded;
+    g_totalOcclusionMs     += s.rasterMs + s.testMs;
+}
+
+
+
+/**-----------------------------------------------------------------------------
+ * ü ø
+ * ڸ SIMD 4(AVX 8) ü  ˻ؼ ̴ ü .
+ *------------------------------------------------------------------------------
+ */
+/// ø  [begin, end) ˻Ѵ. ۾ 忡 Ҹ.
+void CullChunks( void* pData, unsigned begin, unsigned end )
+{
+    for( unsigned c = begin; c < end; c++ )
+    {
+        g_chunkVisible[c].clear();
+        g_cullBounds.CullBoxes( g_frustum, c * CULL_CHUNK, (c + 1) * CULL_CHUNK, g_chunkVisible[c] );
+    }
+}
+
+VOID CullObjects()
+{
+    PROFILE_FUNCTION();
+
+    /// ü CULL_CHUNK  ۾ ˻Ѵ.  ۾   ϰ,
+    ///   ̾ ٿ   ˻ Ͱ   Ѵ.
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    unsigned numChunks = ( g_cullBounds.Size() + CULL_CHUNK - 1 ) / CULL_CHUNK;
+    if( g_chunkVisible.size() < numChunks )
+        g_chunkVisible.resize( numChunks );
+    g_jobs.ParallelFor( numChunks, 1, CullChunks, NULL, &g_cullJobs, &g_transformJobs );
+    g_jobs.Wait( &g_cullJobs );
+    g_jobs.Wait( &g_transformJobs );
+
+    g_visible.clear();
+    for( unsigned c = 0; c < numChunks; c++ )
+        g_visible.insert( g_visible.end(), g_chunkVisible[c].begin(), g_chunkVisible[c].end() );
+
+    CullStats s;
+    s.tested  = g_cullBounds.Size();
+    s.visible = (unsigned)g_visible.size();
+    s.culled  = s.tested - s.visible;
+    s.ms      = std::chrono::duration<double, std::milli>( std::chrono::high_resolution_clock::now() - start ).count();
+    g_totalTested += s.tested;
+    g_totalCulled += s.culled;
+    g_totalCullMs += s.ms;
+
+    /// ü ȿ  ü    .
+    if( g_bOcclusion )
+        OccludeObjects();
+    else
+        g_occlusion.Clear();
+
+    /// Ӻ ̴/ø  ٿ ǥѴ. (  Ƿ 30Ӹ)
+    if( g_frameCount % 30 == 0 )
+    {
+        const OcclusionStats& o = g_occlusion.Stats();
+        char title[192];
+        _snprintf( title, sizeof(title),
+                   "D3D Tutorial 06: Meshes - visible %u, frustum culled %u (%.3f ms), occluded %u of %u (%.3f ms)",
+                   (unsigned)g_visible.size(), s.culled, s.ms, o.occluded, o.tested, o.rasterMs + o.testMs );
+        PlatformSetWindowTitle( title );
+    }
+    g_frameCount++;
+}
+
+
+
+
+/**-----------------------------------------------------------------------------
+ * ׸  
+ * ̴ ü  [begin, end)   cb Ѵ.  忡 ÿ
+ * ҸǷ  б⸸ Ѵ.
+ *------------------------------------------------------------------------------
+ */
+VOID RecordObjects( CommandBuffer& cb, unsigned begin, unsigned end )
+{
+    PROFILE_FUNCTION();
+
+    /// ޽ô  ٸ ޽ú κ ̷ ִ.
+    /// ̵  ؼ  ׷ش.
+    for( unsigned v=begin; v<end; v++ )
+    {
+        const Mat4& matWorld = g_instanceWorlds[g_visible[v]];
+        cb.SetTransform( D3DTS_WORLD, (const D3DMATRIX*)matWorld.Data() );
+
+        for( DWORD i=0; i<g_dwNumMaterials; i++ )
+        {
+            /// κ  κպ ڵ ˻Ѵ.
+            if( g_dwNumMaterials > 1 && i < g_meshBounds.subsets.size() &&
+                ( g_meshBounds.subsets[i].IsEmpty() ||
+                  !g_frustum.TestAabb( TransformAabb( g_meshBounds.subsets[i], matWorld ) ) ) )
+                continue;
+
+            /// κ ޽  ؽ 
+            cb.SetMaterial( &g_pMeshMaterials[i] );
+            cb.SetTexture( 0, g_frameTextures[i] );
+
+            /// κ ޽ 
+            cb.DrawSubset( g_pFrameMesh, i );
+        }
+    }
 }
 
 
@@ -214,9 +556,20 @@ VOID SetupMatrices()
  */
 VOID Render()
 {
+    PROFILE_FUNCTION();
+
+    g_resources.BeginFrame();
+
+    ///  ȸ  ޸𸮴 g_frameArena ޴´.     ޸𸮰
+    /// ⼭ Ѳ ȯȴ.
+    g_frameArena.BeginFrame();
+
+    /// ׶忡 ٽ  ҽ   迡 üѴ.
+    g_hotReload.ApplyPending( g_pd3dDevice );
+
     /// ĸۿ Z۸ .
-    g_pd3dDevice->Clear( 0, NULL, D3DCLEAR_TARGET|D3DCLEAR_ZBUFFER, 
-                         D3DCOLOR_XRGB(0,0,255), 1.0f, 0 );
+    g_stateCache.Clear( 0, NULL, D3DCLEAR_TARGET|D3DCLEAR_ZBUFFER, 
+                        D3DCOLOR_XRGB(0,0,255), 1.0f, 0 );
     
     ///  
     if( SUCCEEDED( g_pd3dDevice->BeginScene() ) )
@@ -224,17 +577,19 @@ VOID Render()
         /// ,,  Ѵ.
         SetupMatrices();
 
-        /// ޽ô  ٸ ޽ú κ ̷ ִ.
-        /// ̵  ؼ  ׷ش.
+        /// ȭ  ü ׸ ʴ´.
+        CullObjects();
+
+        /// ҽ ڵ  忡 Ǯ ʵ ⼭ ѹ Ǭ.
+        g_pFrameMesh = g_resources.GetMesh( g_hMesh );
+        g_frameTextures = g_frameArena.Allocate<IDirect3DTexture9*>( g_dwNumMaterials );
         for( DWORD i=0; i<g_dwNumMaterials; i++ )
-        {
-            /// κ ޽  ؽ 
-            g_pd3dDevice->SetMaterial( &g_pMeshMaterials[i] );
-            g_pd3dDevice->SetTexture( 0, g_pMeshTextures[i] );
-        
-            /// κ ޽ 
-            g_pMesh->DrawSubset( i );
-        }
+            g_frameTextures[i] = g_resources.GetTexture( g_hMeshTextures[i] );
+
+        /// ̴ ü  ŭ  ׸   ,
+        /// ü  ״ ̽ . ´  ĳø ģ.
+        g_recorder.Record( (unsigned)g_visible.size(), RecordObjects );
+        g_recorder.Execute( g_pd3dDevice, &g_stateCache );
 
         ///  
         g_pd3dDevice->EndScene();
@@ -242,76 +597,80 @@ VOID Render()
 
     /// ĸ۸ ̴ ȭ!
     g_pd3dDevice->Present( NULL, NULL, NULL, NULL );
+    g_capture.EndFrame();
+    g_frameStats.EndFrame( g_stateCache.Stats() );
+
+    g_resources.EndFrame();
 }
 
 
 
 
 /**-----------------------------------------------------------------------------
- *  ν
+ * ʱȭ
+ * ÷ (Platform.h) â  ڿ θ. â  ϸ window NULL̴.
  *------------------------------------------------------------------------------
  */
-LRESULT WINAPI MsgProc( HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam )
+bool InitApp( PlatformWindow window )
 {
-    switch( msg )
-    {
-        case WM_DESTROY:
-            Cleanup();
-            PostQuitMessage( 0 );
-            return 0;
-    }
+    /// Direct3D ʱȭ
+    if( FAILED( InitD3D( (HWND)window ) ) )
+        return false;
 
-    return DefWindowProc( hWnd, msg, wParam, lParam );
+    ///  ʱȭ
+    return SUCCEEDED( InitGeometry() );
 }
 
 
 
 
 /**-----------------------------------------------------------------------------
- * α׷ 
+ * Է ó
  *------------------------------------------------------------------------------
  */
-INT WINAPI WinMain( HINSTANCE hInst, HINSTANCE, LPSTR, INT )
+void OnEvent( const PlatformEvent& e )
 {
-    ///  Ŭ 
-    WNDCLASSEX wc = { sizeof(WNDCLASSEX), CS_CLASSDC, MsgProc, 0L, 0L, 
-                      GetModuleHandle(NULL), NULL, NULL, NULL, NULL,
-                      "D3D Tutorial", NULL };
-    RegisterClassEx( &wc );
+    if( e.type != PLATFORM_KEY_DOWN )
+        return;
+
+    /// 'G': ȣ ڸ Ѱ . κ ȭ ۿ ־ ø ȿ   ִ.
+    if( e.key == 'G' )
+        g_gridSize = ( g_gridSize == 1 ) ? GRID_SIZE : 1;
+    /// 'O':  ø Ѱ .
+    else if( e.key == 'O' )
+        g_bOcclusion = !g_bOcclusion;
+    /// 'P': ִϸ̼ ߰ ٽ δ.
+    else if( e.key == 'P' )
+        g_clock.SetPaused( !g_clock.Paused() );
+}
+
 
-    ///  
-    HWND hWnd = CreateWindow( "D3D Tutorial", "D3D Tutorial 06: Meshes", 
-                              WS_OVERLAPPEDWINDOW, 100, 100, 300, 300,
-                              GetDesktopWindow(), NULL, wc.hInstance, NULL );
 
-    /// Direct3D ʱȭ
-    if( SUCCEEDED( InitD3D( hWnd ) ) )
-    { 
-        ///  ʱȭ
-        if( SUCCEEDED( InitGeometry() ) )
-        {
-        	///  
-            ShowWindow( hWnd, SW_SHOWDEFAULT );
-            UpdateWindow( hWnd );
-
-        	/// ޽ 
-            MSG msg; 
-            ZeroMemory( &msg, sizeof(msg) );
-            while( msg.message!=WM_QUIT )
-            {
-                if( PeekMessage( &msg, NULL, 0U, 0U, PM_REMOVE ) )
-                {
-                    TranslateMessage( &msg );
-                    DispatchMessage( &msg );
-                }
-                else
-                    Render();
-            }
-        }
-    }
 
-    UnregisterClass( "D3D Tutorial", wc.hInstance );
-    return 0;
+/**-----------------------------------------------------------------------------
+ * α׷ 
+ * WinMain()() main()() ÷  ְ,  Ѱ  Լ θ.
+ *------------------------------------------------------------------------------
+ */
+INT PlatformMain( const char* cmdLine )
+{
+    /// "-capture ̸ [-captureframes N]" ϸ ̽  ȣ Ͽ Ѵ.
+    /// (Tools/CaptureReplay ) ̽   ؾ  ° ϵȴ.
+    g_capture.BeginFromCommandLine( cmdLine );
+
+    /// "-profile ̸" ϸ    ð Chrome trace (chrome://tracing) Ѵ.
+    g_profiler.ParseCommandLine( cmdLine );
+
+    /// "-stats ̸.csv(.json)" ϸ Ӻ ο ȣ,   Ƚ     پ Ͽ δ.
+    g_frameStats.ParseCommandLine( cmdLine );
+    /// "-fixedstep 60" ϸ ɸ ð  Ӹ 1/60ʾ ִϸ̼ Ѵ.     ׷.
+    /// "-timescale 0.5" ϸ  ӵ δ.
+    g_clock.ParseCommandLine( cmdLine );
+
+    /// â  ޽ óϴ  ÷  Ѵ. ó ޽  Render() θ.
+    /// "-headless -frames N" ϸ â  ʰ N ׸  ɸ ð ϰ .
+    PlatformApp app = { "D3D Tutorial 06: Meshes", 300, 300, InitApp, Render, Cleanup, OnEvent, false };
+    return PlatformRun( app );
 }
 
 
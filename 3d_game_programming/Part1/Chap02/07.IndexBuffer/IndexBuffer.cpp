@@ -9,6 +9,13 @@
  */
 #include <d3d9.h>
 #include <d3dx9.h>
+#include "Resources.h"
+#include "StateCache.h"
+#include "DeviceCapture.h"
+#include "Profiler.h"
+#include "FrameStats.h"
+#include "GameClock.h"
+#include "Platform.h"
 
 
 
@@ -18,8 +25,8 @@
  */
 LPDIRECT3D9             g_pD3D       = NULL; /// D3D ̽  D3Dü
 LPDIRECT3DDEVICE9       g_pd3dDevice = NULL; ///   D3D̽
-LPDIRECT3DVERTEXBUFFER9 g_pVB        = NULL; ///   
-LPDIRECT3DINDEXBUFFER9	g_pIB        = NULL; /// ε  ε
+VertexBufferHandle      g_hVB;               ///   
+IndexBufferHandle       g_hIB;               /// ε  ε
 
 ///    ü
 struct CUSTOMVERTEX
@@ -44,6 +51,8 @@ struct MYINDEX
  */
 HRESULT InitD3D( HWND hWnd )
 {
+    PROFILE_FUNCTION();
+
     /// ̽ ϱ D3Dü 
     if( NULL == ( g_pD3D = Direct3DCreate9( D3D_SDK_VERSION ) ) )
         return E_FAIL;
@@ -66,14 +75,17 @@ HRESULT InitD3D( HWND hWnd )
         return E_FAIL;
     }
 
+    /// ̽ ´  ĳø ļ Ѵ.  ٲ  Set* ̹  ʴ´.
+    g_stateCache.Attach( g_pd3dDevice );
+
     /// ø .
-    g_pd3dDevice->SetRenderState( D3DRS_CULLMODE, D3DCULL_CCW );
+    g_stateCache.SetRenderState( D3DRS_CULLMODE, D3DCULL_CCW );
 
     /// Z۱ Ҵ.
-    g_pd3dDevice->SetRenderState( D3DRS_ZENABLE, TRUE );
+    g_stateCache.SetRenderState( D3DRS_ZENABLE, TRUE );
 
     ///   Ƿ,  .
-    g_pd3dDevice->SetRenderState( D3DRS_LIGHTING, FALSE );
+    g_stateCache.SetRenderState( D3DRS_LIGHTING, FALSE );
 
     return S_OK;
 }
@@ -94,6 +106,8 @@ HRESULT InitD3D( HWND hWnd )
  */
 HRESULT InitVB()
 {
+    PROFILE_FUNCTION();
+
     /// (cube) ϱ 8  
     CUSTOMVERTEX vertices[] =
     {
@@ -111,20 +125,24 @@ HRESULT InitVB()
     ///  
     /// 8   ޸𸮸 ҴѴ.
     /// FVF Ͽ    Ѵ.
+    LPDIRECT3DVERTEXBUFFER9 pVB = NULL;
     if( FAILED( g_pd3dDevice->CreateVertexBuffer( 8*sizeof(CUSTOMVERTEX),
                                                   0, D3DFVF_CUSTOMVERTEX,
-                                                  D3DPOOL_DEFAULT, &g_pVB, NULL ) ) )
+                                                  D3DPOOL_DEFAULT, &pVB, NULL ) ) )
     {
         return E_FAIL;
     }
+    g_hVB = g_resources.RegisterVertexBuffer( pVB, "IndexBuffer.Cube" );
 
     /// ۸  ä. 
     ///  Lock()Լ ȣϿ ͸ ´.
     VOID* pVertices;
-    if( FAILED( g_pVB->Lock( 0, sizeof(vertices), (void**)&pVertices, 0 ) ) )
+    if( FAILED( pVB->Lock( 0, sizeof(vertices), (void**)&pVertices, 0 ) ) )
         return E_FAIL;
     memcpy( pVertices, vertices, sizeof(vertices) );
-    g_pVB->Unlock();
+    g_capture.BufferData( pVB, 0, pVertices, sizeof(vertices) );
+    g_frameStats.Lock( sizeof(vertices) );
+    pVB->Unlock();
 
     return S_OK;
 }
@@ -132,6 +150,8 @@ HRESULT InitVB()
 
 HRESULT InitIB()
 {
+    PROFILE_FUNCTION();
+
     /// (cube) ϱ 12  
     MYINDEX	indices[] =
     {
@@ -146,18 +166,22 @@ HRESULT InitIB()
     /// ε 
 	/// D3DFMT_INDEX16 ε  16Ʈ  ̴.
 	/// 츮 MYINDEX ü WORD Ƿ D3DFMT_INDEX16 Ѵ.
-    if( FAILED( g_pd3dDevice->CreateIndexBuffer( 12 * sizeof(MYINDEX), 0, D3DFMT_INDEX16, D3DPOOL_DEFAULT, &g_pIB, NULL ) ) )
+    LPDIRECT3DINDEXBUFFER9 pIB = NULL;
+    if( FAILED( g_pd3dDevice->CreateIndexBuffer( 12 * sizeof(MYINDEX), 0, D3DFMT_INDEX16, D3DPOOL_DEFAULT, &pIB, NULL ) ) )
     {
         return E_FAIL;
     }
+    g_hIB = g_resources.RegisterIndexBuffer( pIB, "IndexBuffer.Cube" );
 
     /// ε۸  ä. 
     /// ε Lock()Լ ȣϿ ͸ ´.
     VOID* pIndices;
-    if( FAILED( g_pIB->Lock( 0, sizeof(indices), (void**)&pIndices, 0 ) ) )
+    if( FAILED( pIB->Lock( 0, sizeof(indices), (void**)&pIndices, 0 ) ) )
         return E_FAIL;
     memcpy( pIndices, indices, sizeof(indices) );
-    g_pIB->Unlock();
+    g_capture.BufferData( pIB, 0, pIndices, sizeof(indices) );
+    g_frameStats.Lock( sizeof(indices) );
+    pIB->Unlock();
 
     return S_OK;
 }
@@ -168,11 +192,14 @@ HRESULT InitIB()
  */
 VOID SetupMatrices()
 {
+    PROFILE_FUNCTION();
+
 	/// 
     D3DXMATRIXA16 matWorld;
+    g_clock.Tick();												/// Ӹ    ð Ѵ.
     D3DXMatrixIdentity( &matWorld );							///   
-    D3DXMatrixRotationY( &matWorld, GetTickCount()/500.0f );	/// Y ߽ ȸ 
-    g_pd3dDevice->SetTransform( D3DTS_WORLD, &matWorld );		/// ̽  
+    D3DXMatrixRotationY( &matWorld, (FLOAT)( g_clock.Seconds()/0.5 ) );	/// Y ߽ ȸ 
+    g_stateCache.SetTransform( D3DTS_WORLD, &matWorld );		/// ̽  
 
     ///  
     D3DXVECTOR3 vEyePt( 0.0f, 3.0f,-5.0f );
@@ -180,12 +207,12 @@ VOID SetupMatrices()
     D3DXVECTOR3 vUpVec( 0.0f, 1.0f, 0.0f );
     D3DXMATRIXA16 matView;
     D3DXMatrixLookAtLH( &matView, &vEyePt, &vLookatPt, &vUpVec );
-    g_pd3dDevice->SetTransform( D3DTS_VIEW, &matView );
+    g_stateCache.SetTransform( D3DTS_VIEW, &matView );
 
     ///   
     D3DXMATRIXA16 matProj;
     D3DXMatrixPerspectiveFovLH( &matProj, D3DX_PI/4, 1.0f, 1.0f, 100.0f );
-    g_pd3dDevice->SetTransform( D3DTS_PROJECTION, &matProj );
+    g_stateCache.SetTransform( D3DTS_PROJECTION, &matProj );
 }
 
 
@@ -196,11 +223,19 @@ VOID SetupMatrices()
  */
 VOID Cleanup()
 {
-    if( g_pIB != NULL )        
-        g_pIB->Release();
+    g_resources.Release( g_hIB );
+    g_resources.Release( g_hVB );
+
+    ///  Ұ ҽ  ϰ, ȯ  ڵ Ѵ.
+    g_resources.Shutdown();
+
+    g_capture.End();
 
-    if( g_pVB != NULL )        
-        g_pVB->Release();
+    g_profiler.Report( "IndexBuffer" );
+
+    g_frameStats.ReportStats( "IndexBuffer" );
+    g_stateCache.ReportStats( "IndexBuffer" );
+    g_stateCache.Detach();
 
     if( g_pd3dDevice != NULL ) 
         g_pd3dDevice->Release();
@@ -218,8 +253,12 @@ VOID Cleanup()
  */
 VOID Render()
 {
+    PROFILE_FUNCTION();
+
+    g_resources.BeginFrame();
+
     /// ĸۿ Z ʱȭ
-    g_pd3dDevice->Clear( 0, NULL, D3DCLEAR_TARGET|D3DCLEAR_ZBUFFER, D3DCOLOR_XRGB(0,0,255), 1.0f, 0 );
+    g_stateCache.Clear( 0, NULL, D3DCLEAR_TARGET|D3DCLEAR_ZBUFFER, D3DCOLOR_XRGB(0,0,255), 1.0f, 0 );
 
 	// ļ
 	SetupMatrices();
@@ -229,13 +268,13 @@ VOID Render()
     {
         ///  ﰢ ׸.
         /// 1.  ִ ۸  Ʈ ҴѴ.
-        g_pd3dDevice->SetStreamSource( 0, g_pVB, 0, sizeof(CUSTOMVERTEX) );
+        g_stateCache.SetStreamSource( 0, g_resources.GetVertexBuffer( g_hVB ), 0, sizeof(CUSTOMVERTEX) );
         /// 2. D3D ̴  Ѵ. κ 쿡 FVF Ѵ.
-        g_pd3dDevice->SetFVF( D3DFVF_CUSTOMVERTEX );
+        g_stateCache.SetFVF( D3DFVF_CUSTOMVERTEX );
         /// 3. ε۸ Ѵ.
-        g_pd3dDevice->SetIndices( g_pIB );
+        g_stateCache.SetIndices( g_resources.GetIndexBuffer( g_hIB ) );
 		/// 4. DrawIndexedPrimitive() ȣѴ.
-		g_pd3dDevice->DrawIndexedPrimitive( D3DPT_TRIANGLELIST, 0, 0, 8, 0, 12 );
+		g_stateCache.DrawIndexedPrimitive( D3DPT_TRIANGLELIST, 0, 0, 8, 0, 12 );
 
         ///  
         g_pd3dDevice->EndScene();
@@ -243,81 +282,76 @@ VOID Render()
 
     /// ĸ۸ ̴ ȭ!
     g_pd3dDevice->Present( NULL, NULL, NULL, NULL );
+    g_capture.EndFrame();
+    g_frameStats.EndFrame( g_stateCache.Stats() );
+
+    g_resources.EndFrame();
 }
 
 
 
 
 /**-----------------------------------------------------------------------------
- *  ν
+ * ʱȭ
+ * ÷ (Platform.h) â  ڿ θ. â  ϸ window NULL̴.
  *------------------------------------------------------------------------------
  */
-LRESULT WINAPI MsgProc( HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam )
+bool InitApp( PlatformWindow window )
 {
-    switch( msg )
-    {
-        case WM_DESTROY:
-            Cleanup();
-            PostQuitMessage( 0 );
-            return 0;
-    }
+    /// Direct3D ʱȭ
+    if( FAILED( InitD3D( (HWND)window ) ) )
+        return false;
 
-    return DefWindowProc( hWnd, msg, wParam, lParam );
+    ///  ʱȭ
+    if( FAILED( InitVB() ) )
+        return false;
+
+    /// ε ʱȭ
+    return SUCCEEDED( InitIB() );
 }
 
 
 
 
 /**-----------------------------------------------------------------------------
- * α׷ 
+ * Է ó
  *------------------------------------------------------------------------------
  */
-INT WINAPI WinMain( HINSTANCE hInst, HINSTANCE, LPSTR, INT )
+void OnEvent( const PlatformEvent& e )
 {
-    ///  Ŭ 
-    WNDCLASSEX wc = { sizeof(WNDCLASSEX), CS_CLASSDC, MsgProc, 0L, 0L,
-                      GetModuleHandle(NULL), NULL, NULL, NULL, NULL,
-                      "D3D Tutorial", NULL };
-    RegisterClassEx( &wc );
+    if( e.type != PLATFORM_KEY_DOWN )
+        return;
+
+    /// 'P': ִϸ̼ ߰ ٽ δ.
+    if( e.key == 'P' )
+        g_clock.SetPaused( !g_clock.Paused() );
+}
 
-    ///  
-    HWND hWnd = CreateWindow( "D3D Tutorial", "D3D Tutorial 07: IndexBuffer",
-                              WS_OVERLAPPEDWINDOW, 100, 100, 300, 300,
-                              GetDesktopWindow(), NULL, wc.hInstance, NULL );
 
-    /// Direct3D ʱȭ
-    if( SUCCEEDED( InitD3D( hWnd ) ) )
-    {
-    	///  ʱȭ
-        if( SUCCEEDED( InitVB() ) )
-        {
-			/// ε ʱȭ
-			if( SUCCEEDED( InitIB() ) )
-			{
-        		///  
-				ShowWindow( hWnd, SW_SHOWDEFAULT );
-				UpdateWindow( hWnd );
-
-        		/// ޽ 
-				MSG msg;
-				ZeroMemory( &msg, sizeof(msg) );
-				while( msg.message!=WM_QUIT )
-				{
-            		/// ޽ť ޽  ޽ ó
-					if( PeekMessage( &msg, NULL, 0U, 0U, PM_REMOVE ) )
-					{
-						TranslateMessage( &msg );
-						DispatchMessage( &msg );
-					}
-					else
-					/// ó ޽  Render()Լ ȣ
-						Render();
-				}
-			}
-		}
-    }
 
-	/// ϵ Ŭ Ұ
-    UnregisterClass( "D3D Tutorial", wc.hInstance );
-    return 0;
+
+/**-----------------------------------------------------------------------------
+ * α׷ 
+ * WinMain()() main()() ÷  ְ,  Ѱ  Լ θ.
+ *------------------------------------------------------------------------------
+ */
+INT PlatformMain( const char* cmdLine )
+{
+    /// "-capture ̸ [-captureframes N]" ϸ ̽  ȣ Ͽ Ѵ.
+    /// (Tools/CaptureReplay ) ̽   ؾ  ° ϵȴ.
+    g_capture.BeginFromCommandLine( cmdLine );
+
+    /// "-profile ̸" ϸ    ð Chrome trace (chrome://tracing) Ѵ.
+    g_profiler.ParseCommandLine( cmdLine );
+
+    /// "-stats ̸.csv(.json)" ϸ Ӻ ο ȣ,   Ƚ     پ Ͽ δ.
+    g_frameStats.ParseCommandLine( cmdLine );
+    /// "-fixedstep 60" ϸ ɸ ð  Ӹ 1/60ʾ ִϸ̼ Ѵ.     ׷.
+    /// "-timescale 0.5" ϸ  ӵ δ.
+    g_clock.ParseCommandLine( cmdLine );
+
+    /// â  ޽ óϴ  ÷  Ѵ. ó ޽  Render() θ.
+    /// "-headless -frames N" ϸ â  ʰ N ׸  ɸ ð ϰ .
+    PlatformApp app = { "D3D Tutorial 07: IndexBuffer", 300, 300, InitApp, Render, Cleanup, OnEvent, false };
+    return PlatformRun( app );
 }
@@ -0,0 +1,73 @@
+//=============================================================================
+// AssetLoaders.cpp
+//=============================================================================
+
+#include "AssetLoaders.h"
+#include "AssetPack.h"
+
+
+HRESULT CreateEffectFromAsset(IDirect3DDevice9* pDevice, const char* name,
+                              const D3DXMACRO* pDefines, DWORD flags,
+                              ID3DXEffectPool* pPool, ID3DXEffect** ppEffect,
+                              ID3DXBuffer** ppErrors)
+{
+    AssetData data;
+    if (!g_assets.Load(name, data))
+        return D3DXERR_INVALIDDATA;
+
+    AssetInclude include;
+    return D3DXCreateEffect(pDevice, data.Data(), (UINT)data.Size(), pDefines,
+                            &include, flags, pPool, ppEffect, ppErrors);
+}
+
+HRESULT LoadMeshFromAsset(const char* name, DWORD options, IDirect3DDevice9* pDevice,
+                          ID3DXBuffer** ppAdjacency, ID3DXBuffer** ppMaterials,
+                          ID3DXBuffer** ppEffectInstances, DWORD* pNumMaterials,
+                          ID3DXMesh** ppMesh)
+{
+    AssetData data;
+    if (!g_assets.Load(name, data))
+        return D3DXERR_INVALIDDATA;
+
+    return D3DXLoadMeshFromXInMemory(data.Data(), (DWORD)data.Size(), options, pDevice,
+                                     ppAdjacency, ppMaterials, ppEffectInstances,
+                                     pNumMaterials, ppMesh);
+}
+
+
+//===============================================================
+// D3DX keeps the returned pointer until Close(), so each open
+// include keeps its AssetData alive; a mapped entry is not copied.
+
+AssetInclude::~AssetInclude()
+{
+    for (std::map<LPCVOID, AssetData*>::iterator it = m_open.begin(); it != m_open.end(); ++it)
+        delete it->second;
+}
+
+HRESULT AssetInclude::Open(D3DXINCLUDE_TYPE, LPCSTR pFileName, LPCVOID,
+                           LPCVOID* ppData, UINT* pBytes)
+{
+    AssetData* pData = new AssetData;
+    if (!g_assets.Load(pFileName, *pData))
+    {
+        delete pData;
+        return E_FAIL;
+    }
+
+    *ppData = pData->Data();
+    *pBytes = (UINT)pData->Size();
+    m_open[*ppData] = pData;
+    return S_OK;
+}
+
+HRESULT AssetInclude::Close(LPCVOID pData)
+{
+    std::map<LPCVOID, AssetData*>::iterator it = m_open.find(pData);
+    if (it == m_open.end())
+        return E_FAIL;
+
+    delete it->second;
+    m_open.erase(it);
+    return S_OK;
+}
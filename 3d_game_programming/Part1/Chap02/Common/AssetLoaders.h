@@ -0,0 +1,48 @@
+//=============================================================================
+// AssetLoaders.h
+//
+// D3DX loaders that read through g_assets (AssetPack.h) instead of opening
+// files themselves, so a sample gets its assets from a mounted pack when
+// there is one and from loose files otherwise.  The signatures follow the
+// D3DX functions they replace.
+//=============================================================================
+
+#ifndef ASSET_LOADERS_H
+#define ASSET_LOADERS_H
+
+#include <d3dx9.h>
+#include <map>
+
+class AssetData;
+
+
+// D3DXCreateEffectFromFile; #include directives are resolved by g_assets too.
+HRESULT CreateEffectFromAsset(IDirect3DDevice9* pDevice, const char* name,
+                              const D3DXMACRO* pDefines, DWORD flags,
+                              ID3DXEffectPool* pPool, ID3DXEffect** ppEffect,
+                              ID3DXBuffer** ppErrors);
+
+// D3DXLoadMeshFromX
+HRESULT LoadMeshFromAsset(const char* name, DWORD options, IDirect3DDevice9* pDevice,
+                          ID3DXBuffer** ppAdjacency, ID3DXBuffer** ppMaterials,
+                          ID3DXBuffer** ppEffectInstances, DWORD* pNumMaterials,
+                          ID3DXMesh** ppMesh);
+
+
+//===============================================================
+// Serves effect #include files from g_assets.
+
+class AssetInclude : public ID3DXInclude
+{
+public:
+    ~AssetInclude();
+
+    STDMETHOD(Open)(D3DXINCLUDE_TYPE type, LPCSTR pFileName, LPCVOID pParentData,
+                    LPCVOID* ppData, UINT* pBytes);
+    STDMETHOD(Close)(LPCVOID pData);
+
+private:
+    std::map<LPCVOID, AssetData*> m_open;
+};
+
+#endif // ASSET_LOADERS_H
@@ -0,0 +1,413 @@
+//=============================================================================
+// AssetPack.cpp
+//=============================================================================
+
+#include "AssetPack.h"
+#include "FileUtil.h"
+#include "Lz4.h"
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define snprintf _snprintf
+#endif
+
+
+AssetFileSystem g_assets;
+
+
+std::string NormaliseAssetName(const char* name)
+{
+    std::string out;
+    if (name == NULL)
+        return out;
+
+    for (const char* p = name; *p; ++p)
+        out += *p == '\\' ? '/' : *p;
+    FoldCase(out);
+
+    // Strip leading "./" and "../" (the samples' fallback search prefix).
+    size_t start = 0;
+    for (;;)
+    {
+        if (out.compare(start, 2, "./") == 0)
+            start += 2;
+        else if (out.compare(start, 3, "../") == 0)
+            start += 3;
+        else if (out.compare(start, 1, "/") == 0)
+            start += 1;
+        else
+            break;
+    }
+    return out.substr(start);
+}
+
+
+//===============================================================
+// AssetData
+
+void AssetData::SetView(const void* pData, size_t size, const std::string& source)
+{
+    m_owned.clear();
+    m_pData  = pData;
+    m_size   = size;
+    m_source = source;
+}
+
+std::vector<char>& AssetData::Own(const std::string& source)
+{
+    m_source = source;
+    m_pData  = NULL;
+    m_size   = 0;
+    return m_owned;
+}
+
+void AssetData::UseOwned()
+{
+    m_pData = m_owned.empty() ? "" : &m_owned[0];
+    m_size  = m_owned.size();
+}
+
+void AssetData::Clear()
+{
+    std::vector<char>().swap(m_owned);
+    m_pData = NULL;
+    m_size  = 0;
+    m_source.clear();
+}
+
+
+//===============================================================
+// AssetPack
+
+AssetPack::AssetPack()
+    : m_pBase(NULL), m_size(0), m_pHeader(NULL), m_pEntries(NULL), m_pNames(NULL)
+#ifdef _WIN32
+    , m_hFile(INVALID_HANDLE_VALUE), m_hMapping(NULL)
+#endif
+{
+}
+
+AssetPack::~AssetPack()
+{
+    Close();
+}
+
+bool AssetPack::Open(const char* path)
+{
+    Close();
+
+#ifdef _WIN32
+    m_hFile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                          FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, NULL);
+    if (m_hFile == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_hFile, &size) || size.QuadPart == 0 ||
+        (unsigned long long)size.QuadPart > (size_t)-1)
+    {
+        Close();
+        return false;
+    }
+
+    m_hMapping = CreateFileMappingA(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (m_hMapping == NULL)
+    {
+        Close();
+        return false;
+    }
+
+    m_pBase = (const char*)MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0);
+    m_size  = (size_t)size.QuadPart;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    void* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);          // the mapping keeps the file alive
+    if (p == MAP_FAILED)
+        return false;
+
+    m_pBase = (const char*)p;
+    m_size  = (size_t)st.st_size;
+#endif
+
+    if (m_pBase == NULL || !Validate(m_size))
+    {
+        Close();
+        return false;
+    }
+
+    m_path = path;
+    return true;
+}
+
+void AssetPack::Close()
+{
+#ifdef _WIN32
+    if (m_pBase)
+        UnmapViewOfFile(m_pBase);
+    if (m_hMapping)
+        CloseHandle(m_hMapping);
+    if (m_hFile != INVALID_HANDLE_VALUE)
+        CloseHandle(m_hFile);
+    m_hMapping = NULL;
+    m_hFile    = INVALID_HANDLE_VALUE;
+#else
+    if (m_pBase)
+        munmap((void*)m_pBase, m_size);
+#endif
+
+    m_pBase    = NULL;
+    m_size     = 0;
+    m_pHeader  = NULL;
+    m_pEntries = NULL;
+    m_pNames   = NULL;
+    m_path.clear();
+}
+
+//===============================================================
+// The pack may be truncated or from another tool; check every
+// offset once here so lookups and reads need no further checks.
+
+bool AssetPack::Validate(size_t fileSize)
+{
+    if (fileSize < sizeof(PackHeader))
+        return false;
+
+    const PackHeader* h = (const PackHeader*)m_pBase;
+    if (h->magic != PACK_MAGIC || h->version != PACK_VERSION || h->fileSize != fileSize)
+        return false;
+
+    unsigned long long tocEnd = sizeof(PackHeader) + (unsigned long long)h->numEntries * sizeof(PackEntry);
+    if (tocEnd > h->namesOffset ||
+        (unsigned long long)h->namesOffset + h->namesSize > fileSize ||
+        (h->namesSize && m_pBase[h->namesOffset + h->namesSize - 1] != '\0'))
+        return false;
+
+    const PackEntry* entries = (const PackEntry*)(m_pBase + sizeof(PackHeader));
+    const char*      names   = m_pBase + h->namesOffset;
+    for (unsigned i = 0; i < h->numEntries; ++i)
+    {
+        const PackEntry& e = entries[i];
+        if (e.nameOffset >= h->namesSize ||
+            e.offset > fileSize || e.storedSize > fileSize - e.offset ||
+            (!(e.flags & PACK_ENTRY_LZ4) && e.storedSize != e.size))
+            return false;
+
+        if (i > 0 && strcmp(names + entries[i - 1].nameOffset, names + e.nameOffset) >= 0)
+            return false;
+    }
+
+    m_pHeader  = h;
+    m_pEntries = entries;
+    m_pNames   = names;
+    return true;
+}
+
+const PackEntry* AssetPack::Find(const std::string& normalisedName) const
+{
+    if (m_pHeader == NULL)
+        return NULL;
+
+    unsigned lo = 0, hi = m_pHeader->numEntries;
+    while (lo < hi)
+    {
+        unsigned mid = lo + (hi - lo) / 2;
+        int c = strcmp(m_pNames + m_pEntries[mid].nameOffset, normalisedName.c_str());
+        if (c == 0)
+            return &m_pEntries[mid];
+        if (c < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return NULL;
+}
+
+bool AssetPack::Read(const PackEntry* pEntry, AssetData& data) const
+{
+    std::string source = "pack:";
+    source += EntryName(pEntry);
+
+    if (!(pEntry->flags & PACK_ENTRY_LZ4))
+    {
+        data.SetView(m_pBase + pEntry->offset, (size_t)pEntry->size, source);
+        return true;
+    }
+
+    std::vector<char>& bytes = data.Own(source);
+    bytes.resize((size_t)pEntry->size);
+    if (pEntry->size && Lz4Decompress(m_pBase + pEntry->offset, (size_t)pEntry->storedSize,
+                                      &bytes[0], bytes.size()) != bytes.size())
+    {
+        data.Clear();
+        return false;
+    }
+    data.UseOwned();
+    return true;
+}
+
+
+//===============================================================
+// AssetFileSystem
+
+AssetFileSystem::AssetFileSystem()
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    m_searchPaths.push_back("");
+#ifdef _WIN32
+    m_searchPaths.push_back("..\\");
+#else
+    m_searchPaths.push_back("../");
+#endif
+}
+
+AssetFileSystem::~AssetFileSystem()
+{
+    UnmountAll();
+}
+
+bool AssetFileSystem::Mount(const char* packName)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (size_t i = 0; i < m_searchPaths.size(); ++i)
+    {
+        std::string candidate = m_searchPaths[i] + packName;
+        AssetPack* pPack = new AssetPack;
+        if (pPack->Open(candidate.c_str()))
+        {
+            m_packs.insert(m_packs.begin(), pPack);
+            return true;
+        }
+        delete pPack;
+    }
+    return false;
+}
+
+void AssetFileSystem::UnmountAll()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (size_t i = 0; i < m_packs.size(); ++i)
+        delete m_packs[i];
+    m_packs.clear();
+}
+
+void AssetFileSystem::AddSearchPath(const char* prefix)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_searchPaths.push_back(prefix);
+}
+
+bool AssetFileSystem::InPack(const char* name)
+{
+    std::string key = NormaliseAssetName(name);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t i = 0; i < m_packs.size(); ++i)
+    {
+        if (m_packs[i]->Find(key))
+            return true;
+    }
+    return false;
+}
+
+bool AssetFileSystem::Load(const char* name, AssetData& data)
+{
+    std::string key = NormaliseAssetName(name);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (size_t i = 0; i < m_packs.size(); ++i)
+    {
+        const PackEntry* pEntry = m_packs[i]->Find(key);
+        if (pEntry == NULL)
+            continue;
+
+        if (!m_packs[i]->Read(pEntry, data))
+            break;
+
+        ++m_stats.packHits;
+        if (pEntry->flags & PACK_ENTRY_LZ4)
+            m_stats.bytesDecompressed += pEntry->size;
+        else
+            m_stats.bytesMapped += pEntry->size;
+        return true;
+    }
+
+    for (size_t i = 0; i < m_searchPaths.size(); ++i)
+    {
+        std::string candidate = m_searchPaths[i] + name;
+        std::vector<char>& bytes = data.Own(candidate);
+        if (!ReadFileBytes(candidate.c_str(), bytes))
+            continue;
+
+        data.UseOwned();
+        ++m_stats.looseHits;
+        m_stats.bytesRead += bytes.size();
+        return true;
+    }
+
+    data.Clear();
+    ++m_stats.misses;
+    return false;
+}
+
+bool AssetFileSystem::ResolveLoose(const char* name, std::string& path)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (size_t i = 0; i < m_searchPaths.size(); ++i)
+    {
+        std::string candidate = m_searchPaths[i] + name;
+        if (FileExists(candidate.c_str()))
+        {
+            path = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+AssetStats AssetFileSystem::GetStats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void AssetFileSystem::ReportStats()
+{
+    AssetStats s = GetStats();
+
+    char msg[256];
+    snprintf(msg, sizeof(msg),
+             "[Assets] pack hits %u, loose files %u, misses %u; mapped %u KB, decompressed %u KB, read %u KB\n",
+             s.packHits, s.looseHits, s.misses, (unsigned)(s.bytesMapped / 1024),
+             (unsigned)(s.bytesDecompressed / 1024), (unsigned)(s.bytesRead / 1024));
+#ifdef _WIN32
+    OutputDebugStringA(msg);
+#endif
+    fputs(msg, stderr);
+}
@@ -0,0 +1,205 @@
+//=============================================================================
+// AssetPack.h
+//
+// Single-file asset archive.  A pack is opened once and memory mapped; all
+// lookups after that are a binary search over an in-memory table of
+// contents instead of an open/stat per file and search path.
+//
+// File layout (all integers little endian):
+//
+//     PackHeader
+//     PackEntry[numEntries]     sorted by name (byte order)
+//     name strings              NUL terminated, normalised (see below)
+//     entry data                each entry starts on a multiple of
+//                               header.alignment
+//
+// Names are stored normalised: lower case, '/' separators, without any
+// leading "./" or "../".  Lookups normalise the same way, so the samples'
+// "..\Tiger.x" and "tiger.x" find the same entry.
+//
+// An entry is either stored as-is (it can be used straight from the
+// mapping, no copy) or LZ4 block compressed (see Lz4.h).
+//
+// AssetFileSystem layers mounted packs over loose files: the mesh, texture
+// and effect loaders ask it for a file's bytes and do not care where they
+// came from.  Loose files are only searched when no pack has the name.
+//=============================================================================
+
+#ifndef ASSET_PACK_H
+#define ASSET_PACK_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstddef>
+
+
+const unsigned PACK_MAGIC             = 0x4b415041;     // "APAK"
+const unsigned PACK_VERSION           = 1;
+const unsigned PACK_DEFAULT_ALIGNMENT = 16;
+
+const unsigned PACK_ENTRY_LZ4         = 1 << 0;
+
+
+#pragma pack(push, 4)
+
+struct PackHeader
+{
+    unsigned           magic;
+    unsigned           version;
+    unsigned           numEntries;
+    unsigned           alignment;
+    unsigned           namesOffset;     // from start of file
+    unsigned           namesSize;
+    unsigned long long dataOffset;      // first entry's data
+    unsigned long long fileSize;
+};
+
+struct PackEntry
+{
+    unsigned           nameOffset;      // into the name block
+    unsigned           flags;           // PACK_ENTRY_*
+    unsigned long long offset;          // from start of file
+    unsigned long long size;            // uncompressed
+    unsigned long long storedSize;      // bytes in the pack
+};
+
+#pragma pack(pop)
+
+
+// Lower case, '/' separated, no leading "./" or "../" components.
+std::string NormaliseAssetName(const char* name);
+
+
+//===============================================================
+// Bytes of one asset: either a view into a pack mapping or an owned
+// buffer (decompressed pack entry, or a loose file).
+
+class AssetData
+{
+public:
+    AssetData() : m_pData(NULL), m_size(0) {}
+
+    const void* Data() const   { return m_pData; }
+    size_t      Size() const   { return m_size; }
+    bool        Empty() const  { return m_pData == NULL; }
+
+    // Where the bytes came from, for logs ("pack:tiger.x" or a path).
+    const std::string& Source() const { return m_source; }
+
+    // Points at memory owned by someone else (a pack mapping).
+    void SetView(const void* pData, size_t size, const std::string& source);
+
+    // Returns the internal buffer to fill; UseOwned() then exposes it.
+    std::vector<char>& Own(const std::string& source);
+    void UseOwned();
+
+    void Clear();
+
+private:
+    AssetData(const AssetData&);
+    AssetData& operator=(const AssetData&);
+
+    const void*       m_pData;
+    size_t            m_size;
+    std::vector<char> m_owned;
+    std::string       m_source;
+};
+
+
+//===============================================================
+// One read-only, memory-mapped pack file.
+
+class AssetPack
+{
+public:
+    AssetPack();
+    ~AssetPack();
+
+    bool Open(const char* path);
+    void Close();
+    bool IsOpen() const { return m_pBase != NULL; }
+
+    // Binary search; name must already be normalised.
+    const PackEntry* Find(const std::string& normalisedName) const;
+
+    // Fills data with a view of a stored entry, or decompresses an LZ4 one.
+    bool Read(const PackEntry* pEntry, AssetData& data) const;
+
+    unsigned         NumEntries() const { return m_pHeader ? m_pHeader->numEntries : 0; }
+    const PackEntry* Entry(unsigned i) const { return &m_pEntries[i]; }
+    const char*      EntryName(const PackEntry* pEntry) const { return m_pNames + pEntry->nameOffset; }
+    const std::string& Path() const { return m_path; }
+
+private:
+    AssetPack(const AssetPack&);
+    AssetPack& operator=(const AssetPack&);
+
+    bool Validate(size_t fileSize);
+
+    std::string       m_path;
+    const char*       m_pBase;
+    size_t            m_size;
+    const PackHeader* m_pHeader;
+    const PackEntry*  m_pEntries;
+    const char*       m_pNames;
+
+#ifdef _WIN32
+    void*             m_hFile;
+    void*             m_hMapping;
+#endif
+};
+
+
+//===============================================================
+// Packs first, loose files second.
+
+struct AssetStats
+{
+    unsigned           packHits;
+    unsigned           looseHits;
+    unsigned           misses;
+    unsigned long long bytesMapped;      // served without a copy
+    unsigned long long bytesDecompressed;
+    unsigned long long bytesRead;        // from loose files
+};
+
+class AssetFileSystem
+{
+public:
+    AssetFileSystem();
+    ~AssetFileSystem();
+
+    // Opens a pack, trying the loose-file search paths.  Later mounts
+    // take priority over earlier ones.  A missing pack is not an error:
+    // the samples keep working from loose files.
+    bool Mount(const char* packName);
+    void UnmountAll();
+
+    void AddSearchPath(const char* prefix);
+
+    // True if some mounted pack contains name.
+    bool InPack(const char* name);
+
+    // Loads the bytes of name.  The data stays valid until it is cleared
+    // or the pack it points into is unmounted.
+    bool Load(const char* name, AssetData& data);
+
+    // Disk path of a loose file, for tools that need a real file (the hot
+    // reloader).  Fails for names only found in a pack.
+    bool ResolveLoose(const char* name, std::string& path);
+
+    AssetStats GetStats();
+    void ReportStats();
+
+private:
+    std::mutex               m_mutex;
+    std::vector<AssetPack*>  m_packs;
+    std::vector<std::string> m_searchPaths;
+    AssetStats               m_stats;
+};
+
+
+extern AssetFileSystem g_assets;
+
+#endif // ASSET_PACK_H
@@ -0,0 +1,516 @@
+//=============================================================================
+// Bvh.cpp
+//=============================================================================
+
+#include "Bvh.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+
+namespace
+{
+    const unsigned NUM_BINS        = 16;
+    const unsigned PARALLEL_MIN    = 4096;     // smallest subtree worth a thread
+    const unsigned NO_NODE         = ~0u;
+    const unsigned ALL_PLANES      = (1u << Frustum::NUM_PLANES) - 1;
+    const unsigned MASK_SHIFT      = 26;       // frustum stack entries: node | mask << 26
+    const float    TRAVERSAL_COST  = 1.0f;     // relative to one box test
+
+    float HalfArea(const Aabb& b)
+    {
+        Vec3 d = b.max - b.min;
+        return d.x * d.y + d.y * d.z + d.z * d.x;
+    }
+
+    bool SameBox(const Aabb& a, const Aabb& b)
+    {
+        return memcmp(&a, &b, sizeof(Aabb)) == 0;
+    }
+
+    float Axis(const Vec3& v, int axis)
+    {
+        return (&v.x)[axis];
+    }
+
+    double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    // Slab test; returns the entry distance or a negative value on a miss.
+    inline float IntersectRay(const Aabb& b, const Vec3& origin, const Vec3& invDir, float maxT)
+    {
+        float t0 = (b.min.x - origin.x) * invDir.x, t1 = (b.max.x - origin.x) * invDir.x;
+        float tmin = std::min(t0, t1), tmax = std::max(t0, t1);
+        t0 = (b.min.y - origin.y) * invDir.y; t1 = (b.max.y - origin.y) * invDir.y;
+        tmin = std::max(tmin, std::min(t0, t1)); tmax = std::min(tmax, std::max(t0, t1));
+        t0 = (b.min.z - origin.z) * invDir.z; t1 = (b.max.z - origin.z) * invDir.z;
+        tmin = std::max(tmin, std::min(t0, t1)); tmax = std::min(tmax, std::max(t0, t1));
+
+        tmin = std::max(tmin, 0.0f);
+        return (tmin <= tmax && tmin <= maxT) ? tmin : -1.0f;
+    }
+
+    Vec3 InverseDirection(const Vec3& dir)
+    {
+        // 1e30 instead of infinity keeps 0 * inv from producing NaN.
+        return Vec3(dir.x != 0.0f ? 1.0f / dir.x : 1e30f,
+                    dir.y != 0.0f ? 1.0f / dir.y : 1e30f,
+                    dir.z != 0.0f ? 1.0f / dir.z : 1e30f);
+    }
+
+    // Outside test against the planes in mask; clears the bits of planes
+    // the box is entirely inside.  Returns false if the box is outside.
+    inline bool ClassifyBox(const Frustum& frustum, const Aabb& box, unsigned& mask)
+    {
+        Vec3 c = box.Center(), e = box.Extents();
+        for (int i = 0; i < Frustum::NUM_PLANES; ++i)
+        {
+            if (!(mask & (1u << i)))
+                continue;
+
+            const Plane& p = frustum.GetPlane(i);
+            float d = p.a * c.x + p.b * c.y + p.c * c.z + p.d;
+            float r = fabsf(p.a) * e.x + fabsf(p.b) * e.y + fabsf(p.c) * e.z;
+            if (d + r < 0.0f)
+                return false;
+            if (d - r >= 0.0f)
+                mask &= ~(1u << i);
+        }
+        return true;
+    }
+}
+
+
+struct Bvh::BuildContext
+{
+    std::vector<Vec3>     centroids;
+    std::atomic<unsigned> nextNode;
+};
+
+
+Bvh::Bvh()
+    : m_empty(Vec3(0, 0, 0), Vec3(0, 0, 0))
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void Bvh::Clear()
+{
+    m_boxes.clear();
+    m_nodes.clear();
+    m_items.clear();
+    m_parents.clear();
+    m_objectLeaf.clear();
+    m_dirtyLeaves.clear();
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+
+//===============================================================
+// Build
+
+void Bvh::Build(const Aabb* pBoxes, unsigned count, unsigned numThreads)
+{
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    Clear();
+    if (count == 0)
+        return;
+
+    m_boxes.assign(pBoxes, pBoxes + count);
+    m_items.resize(count);
+    for (unsigned i = 0; i < count; ++i)
+        m_items[i] = i;
+
+    BuildContext ctx;
+    ctx.centroids.resize(count);
+    for (unsigned i = 0; i < count; ++i)
+        ctx.centroids[i] = m_boxes[i].Center();
+    ctx.nextNode = 1;
+
+    m_nodes.resize(2 * count - 1);
+    m_parents.resize(2 * count - 1);
+    m_parents[0] = NO_NODE;
+
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned threadDepth = 0;
+    while ((1u << threadDepth) < numThreads)
+        ++threadDepth;
+
+    BuildRange(ctx, 0, 0, count, 0, threadDepth);
+
+    m_nodes.resize(ctx.nextNode);
+    m_parents.resize(ctx.nextNode);
+
+    m_objectLeaf.resize(count);
+    for (unsigned n = 0; n < m_nodes.size(); ++n)
+    {
+        for (unsigned i = 0; i < m_nodes[n].count; ++i)
+            m_objectLeaf[m_items[m_nodes[n].first + i]] = n;
+    }
+
+    FinishStats();
+    m_stats.buildMs = MillisecondsSince(start);
+}
+
+void Bvh::BuildRange(BuildContext& ctx, unsigned node, unsigned begin, unsigned end, unsigned depth,
+                     unsigned threadDepth)
+{
+    Aabb box = Aabb::Empty(), centroidBox = Aabb::Empty();
+    for (unsigned i = begin; i < end; ++i)
+    {
+        box.Grow(m_boxes[m_items[i]]);
+        centroidBox.Grow(ctx.centroids[m_items[i]]);
+    }
+
+    BvhNode& n     = m_nodes[node];
+    unsigned count = end - begin;
+    n.box = box;
+
+    if (count <= 1)
+    {
+        n.first = begin;
+        n.count = count;
+        return;
+    }
+
+    // Bin the centroids along each axis and take the cheapest split.
+    int   bestAxis = -1;
+    unsigned bestBin = 0;
+    float bestCost = 1e30f;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        float lo = Axis(centroidBox.min, axis), extent = Axis(centroidBox.max, axis) - lo;
+        if (extent <= 0.0f)
+            continue;
+
+        Aabb     binBox[NUM_BINS];
+        unsigned binCount[NUM_BINS] = { 0 };
+        for (unsigned b = 0; b < NUM_BINS; ++b)
+            binBox[b] = Aabb::Empty();
+
+        float scale = NUM_BINS / extent;
+        for (unsigned i = begin; i < end; ++i)
+        {
+            unsigned b = std::min(NUM_BINS - 1, (unsigned)((Axis(ctx.centroids[m_items[i]], axis) - lo) * scale));
+            binBox[b].Grow(m_boxes[m_items[i]]);
+            ++binCount[b];
+        }
+
+        // Sweep from the right, then from the left.
+        float    rightArea[NUM_BINS];
+        unsigned rightCount[NUM_BINS];
+        Aabb     acc = Aabb::Empty();
+        unsigned sum = 0;
+        for (unsigned b = NUM_BINS - 1; b > 0; --b)
+        {
+            acc.Grow(binBox[b]);
+            sum += binCount[b];
+            rightArea[b]  = sum ? HalfArea(acc) : 0.0f;
+            rightCount[b] = sum;
+        }
+
+        acc = Aabb::Empty();
+        sum = 0;
+        for (unsigned b = 0; b < NUM_BINS - 1; ++b)
+        {
+            acc.Grow(binBox[b]);
+            sum += binCount[b];
+            if (sum == 0 || rightCount[b + 1] == 0)
+                continue;
+
+            float cost = sum * HalfArea(acc) + rightCount[b + 1] * rightArea[b + 1];
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin  = b;
+            }
+        }
+    }
+
+    float leafCost  = count * HalfArea(box);
+    float splitCost = TRAVERSAL_COST * HalfArea(box) + bestCost;
+    if (count <= MAX_LEAF_SIZE && (bestAxis < 0 || leafCost <= splitCost))
+    {
+        n.first = begin;
+        n.count = count;
+        return;
+    }
+
+    unsigned mid = begin;
+    if (bestAxis >= 0)
+    {
+        float lo    = Axis(centroidBox.min, bestAxis);
+        float scale = NUM_BINS / (Axis(centroidBox.max, bestAxis) - lo);
+        const std::vector<Vec3>& centroids = ctx.centroids;
+        mid = (unsigned)(std::partition(m_items.begin() + begin, m_items.begin() + end,
+                                        [&](unsigned item)
+                                        {
+                                            return std::min(NUM_BINS - 1, (unsigned)((Axis(centroids[item], bestAxis) - lo) * scale)) <= bestBin;
+                                        }) - m_items.begin());
+    }
+    if (mid == begin || mid == end)
+    {
+        // All centroids coincide: split the list in half.
+        mid = begin + count / 2;
+    }
+
+    unsigned left = ctx.nextNode.fetch_add(2);
+    n.first = left;
+    n.count = 0;
+    m_parents[left]     = node;
+    m_parents[left + 1] = node;
+
+    if (threadDepth > 0 && count >= PARALLEL_MIN)
+    {
+        std::thread worker(&Bvh::BuildRange, this, std::ref(ctx), left, begin, mid, depth + 1, threadDepth - 1);
+        BuildRange(ctx, left + 1, mid, end, depth + 1, threadDepth - 1);
+        worker.join();
+    }
+    else
+    {
+        BuildRange(ctx, left, begin, mid, depth + 1, 0);
+        BuildRange(ctx, left + 1, mid, end, depth + 1, 0);
+    }
+}
+
+void Bvh::FinishStats()
+{
+    m_stats.nodes  = (unsigned)m_nodes.size();
+    m_stats.leaves = 0;
+    m_stats.depth  = 0;
+
+    // Children always follow their parent, so one forward pass gives depths.
+    std::vector<unsigned> depth(m_nodes.size(), 0);
+    for (unsigned n = 0; n < m_nodes.size(); ++n)
+    {
+        if (n > 0)
+            depth[n] = depth[m_parents[n]] + 1;
+        m_stats.depth = std::max(m_stats.depth, depth[n] + 1);
+        if (m_nodes[n].count > 0)
+            ++m_stats.leaves;
+    }
+}
+
+float Bvh::SahCost() const
+{
+    if (m_nodes.empty())
+        return 0.0f;
+
+    float root = HalfArea(m_nodes[0].box), cost = 0.0f;
+    if (root <= 0.0f)
+        return 0.0f;
+
+    for (size_t n = 0; n < m_nodes.size(); ++n)
+    {
+        float area = HalfArea(m_nodes[n].box) / root;
+        cost += m_nodes[n].count ? area * m_nodes[n].count : area * TRAVERSAL_COST;
+    }
+    return cost;
+}
+
+
+//===============================================================
+// Refit
+
+void Bvh::SetBox(unsigned object, const Aabb& box)
+{
+    m_boxes[object] = box;
+    m_dirtyLeaves.push_back(m_objectLeaf[object]);
+}
+
+void Bvh::Refit()
+{
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    std::sort(m_dirtyLeaves.begin(), m_dirtyLeaves.end());
+    m_dirtyLeaves.erase(std::unique(m_dirtyLeaves.begin(), m_dirtyLeaves.end()), m_dirtyLeaves.end());
+
+    unsigned refitted = 0;
+    for (size_t d = 0; d < m_dirtyLeaves.size(); ++d)
+    {
+        unsigned node = m_dirtyLeaves[d];
+        BvhNode& leaf = m_nodes[node];
+
+        Aabb box = Aabb::Empty();
+        for (unsigned i = 0; i < leaf.count; ++i)
+            box.Grow(m_boxes[m_items[leaf.first + i]]);
+        if (SameBox(box, leaf.box))
+            continue;
+        leaf.box = box;
+        ++refitted;
+
+        // Each parent is recomputed from both children, so the order in
+        // which leaves are processed does not matter.
+        for (unsigned p = m_parents[node]; p != NO_NODE; p = m_parents[p])
+        {
+            Aabb merged = m_nodes[m_nodes[p].first].box;
+            merged.Grow(m_nodes[m_nodes[p].first + 1].box);
+            if (SameBox(merged, m_nodes[p].box))
+                break;
+            m_nodes[p].box = merged;
+            ++refitted;
+        }
+    }
+    m_dirtyLeaves.clear();
+
+    m_stats.refitNodes = refitted;
+    m_stats.refitMs    = MillisecondsSince(start);
+}
+
+
+//===============================================================
+// Queries
+
+void Bvh::EmitSubtree(unsigned node, std::vector<unsigned>& objects)
+{
+    // Leaves of a subtree own a contiguous run of items, from the
+    // leftmost leaf to the rightmost one.
+    unsigned lo = node, hi = node;
+    while (m_nodes[lo].count == 0)
+        lo = m_nodes[lo].first;
+    while (m_nodes[hi].count == 0)
+        hi = m_nodes[hi].first + 1;
+
+    objects.insert(objects.end(), m_items.begin() + m_nodes[lo].first,
+                   m_items.begin() + m_nodes[hi].first + m_nodes[hi].count);
+}
+
+void Bvh::QueryFrustum(const Frustum& frustum, std::vector<unsigned>& objects)
+{
+    m_stats.visitedNodes = 0;
+    if (m_nodes.empty())
+        return;
+
+    m_stack.clear();
+    m_stack.push_back(0 | (ALL_PLANES << MASK_SHIFT));
+    while (!m_stack.empty())
+    {
+        unsigned entry = m_stack.back();
+        m_stack.pop_back();
+
+        unsigned node = entry & ((1u << MASK_SHIFT) - 1), mask = entry >> MASK_SHIFT;
+        const BvhNode& n = m_nodes[node];
+        ++m_stats.visitedNodes;
+
+        if (!ClassifyBox(frustum, n.box, mask))
+            continue;
+
+        if (mask == 0)
+        {
+            EmitSubtree(node, objects);
+        }
+        else if (n.count > 0)
+        {
+            for (unsigned i = 0; i < n.count; ++i)
+            {
+                unsigned object = m_items[n.first + i], objectMask = mask;
+                if (ClassifyBox(frustum, m_boxes[object], objectMask))
+                    objects.push_back(object);
+            }
+        }
+        else
+        {
+            m_stack.push_back((n.first + 1) | (mask << MASK_SHIFT));
+            m_stack.push_back(n.first | (mask << MASK_SHIFT));
+        }
+    }
+}
+
+void Bvh::QueryRay(const Vec3& origin, const Vec3& dir, float maxT, std::vector<unsigned>& objects)
+{
+    m_stats.visitedNodes = 0;
+    if (m_nodes.empty())
+        return;
+
+    Vec3 invDir = InverseDirection(dir);
+    m_stack.clear();
+    m_stack.push_back(0);
+    while (!m_stack.empty())
+    {
+        const BvhNode& n = m_nodes[m_stack.back()];
+        m_stack.pop_back();
+        ++m_stats.visitedNodes;
+
+        if (IntersectRay(n.box, origin, invDir, maxT) < 0.0f)
+            continue;
+
+        if (n.count > 0)
+        {
+            for (unsigned i = 0; i < n.count; ++i)
+            {
+                unsigned object = m_items[n.first + i];
+                if (IntersectRay(m_boxes[object], origin, invDir, maxT) >= 0.0f)
+                    objects.push_back(object);
+            }
+        }
+        else
+        {
+            m_stack.push_back(n.first + 1);
+            m_stack.push_back(n.first);
+        }
+    }
+}
+
+bool Bvh::Raycast(const Vec3& origin, const Vec3& dir, float maxT, RayHit* pHit)
+{
+    m_stats.visitedNodes = 0;
+    if (m_nodes.empty())
+        return false;
+
+    Vec3  invDir = InverseDirection(dir);
+    float best   = maxT;
+    bool  found  = false;
+
+    m_stack.clear();
+    if (IntersectRay(m_nodes[0].box, origin, invDir, best) >= 0.0f)
+        m_stack.push_back(0);
+
+    while (!m_stack.empty())
+    {
+        const BvhNode& n = m_nodes[m_stack.back()];
+        m_stack.pop_back();
+        ++m_stats.visitedNodes;
+
+        if (n.count > 0)
+        {
+            for (unsigned i = 0; i < n.count; ++i)
+            {
+                unsigned object = m_items[n.first + i];
+                float    t      = IntersectRay(m_boxes[object], origin, invDir, best);
+                if (t >= 0.0f && (!found || t < best))
+                {
+                    best  = t;
+                    found = true;
+                    if (pHit)
+                    {
+                        pHit->object = object;
+                        pHit->t      = t;
+                    }
+                }
+            }
+            continue;
+        }
+
+        // Visit the nearer child first; skip children beyond the best hit.
+        unsigned a = n.first, b = n.first + 1;
+        float ta = IntersectRay(m_nodes[a].box, origin, invDir, best);
+        float tb = IntersectRay(m_nodes[b].box, origin, invDir, best);
+        if (ta >= 0.0f && tb >= 0.0f && tb < ta)
+        {
+            std::swap(a, b);
+            std::swap(ta, tb);
+        }
+        if (tb >= 0.0f)
+            m_stack.push_back(b);
+        if (ta >= 0.0f)
+            m_stack.push_back(a);
+    }
+    return found;
+}
@@ -0,0 +1,107 @@
+//=============================================================================
+// Bvh.h
+//
+// Bounding volume hierarchy over object bounding boxes, for scenes where a
+// linear culling pass (CullBounds in Culling.h) no longer scales.
+//
+// Build() splits with the surface area heuristic evaluated over 16 bins per
+// axis.  Subtrees larger than a few thousand objects are built on their own
+// threads; node slots are handed out with an atomic counter, so a child
+// always has a higher index than its parent whatever the thread timing.
+//
+// Moving objects do not need a rebuild: SetBox() stores the new box and
+// Refit() grows/shrinks only the leaves that hold changed objects and their
+// ancestors, stopping as soon as a node's box comes out unchanged.  The
+// tree quality drops as objects drift far from where they were built;
+// rebuild when SahCost() has grown noticeably.
+//
+// Queries return object indices (the order the boxes were passed to
+// Build()).  Subtrees entirely inside the frustum are emitted without
+// further tests.
+//=============================================================================
+
+#ifndef BVH_H
+#define BVH_H
+
+#include "Culling.h"
+#include <vector>
+
+
+struct BvhNode
+{
+    Aabb     box;
+    unsigned first;     // leaf: first slot in the item list; inner: left child (right is first + 1)
+    unsigned count;     // objects in a leaf, 0 for an inner node
+};
+
+struct BvhStats
+{
+    unsigned nodes;
+    unsigned leaves;
+    unsigned depth;
+    double   buildMs;
+    double   refitMs;
+    unsigned refitNodes;        // node boxes recomputed by the last Refit()
+    unsigned visitedNodes;      // by the last query
+};
+
+struct RayHit
+{
+    unsigned object;
+    float    t;                 // entry distance along the ray (in units of dir)
+};
+
+class Bvh
+{
+public:
+    static const unsigned MAX_LEAF_SIZE = 4;
+
+    Bvh();
+
+    // numThreads 0 uses every hardware thread, 1 builds serially.
+    void Build(const Aabb* pBoxes, unsigned count, unsigned numThreads = 0);
+    void Clear();
+
+    unsigned    NumObjects() const    { return (unsigned)m_boxes.size(); }
+    const Aabb& Box(unsigned object) const { return m_boxes[object]; }
+    const Aabb& Bounds() const        { return m_nodes.empty() ? m_empty : m_nodes[0].box; }
+
+    // Moves an object; takes effect in queries after Refit().
+    void SetBox(unsigned object, const Aabb& box);
+    void Refit();
+
+    // Appends every object whose box is at least partly inside.
+    void QueryFrustum(const Frustum& frustum, std::vector<unsigned>& objects);
+
+    // Appends every object whose box the ray crosses within [0, maxT].
+    void QueryRay(const Vec3& origin, const Vec3& dir, float maxT, std::vector<unsigned>& objects);
+
+    // Nearest box along the ray; false if none within [0, maxT].
+    bool Raycast(const Vec3& origin, const Vec3& dir, float maxT, RayHit* pHit);
+
+    // Surface area heuristic cost of the current tree, relative to its root.
+    float SahCost() const;
+
+    const BvhStats& Stats() const { return m_stats; }
+    const std::vector<BvhNode>& Nodes() const { return m_nodes; }
+
+private:
+    struct BuildContext;
+
+    void BuildRange(BuildContext& ctx, unsigned node, unsigned begin, unsigned end, unsigned depth,
+                    unsigned threadDepth);
+    void EmitSubtree(unsigned node, std::vector<unsigned>& objects);
+    void FinishStats();
+
+    std::vector<Aabb>     m_boxes;
+    std::vector<BvhNode>  m_nodes;
+    std::vector<unsigned> m_items;          // object indices, grouped by leaf
+    std::vector<unsigned> m_parents;        // per node, ~0u for the root
+    std::vector<unsigned> m_objectLeaf;     // per object
+    std::vector<unsigned> m_dirtyLeaves;
+    std::vector<unsigned> m_stack;
+    Aabb                  m_empty;
+    BvhStats              m_stats;
+};
+
+#endif // BVH_H
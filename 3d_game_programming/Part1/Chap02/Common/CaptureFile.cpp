@@ -0,0 +1,187 @@
+//=============================================================================
+// CaptureFile.cpp
+//=============================================================================
+
+#include "CaptureFile.h"
+#include "FileUtil.h"
+#include "Lz4.h"
+#include <cstring>
+
+
+// True if a payload of have bytes holds a fixed part plus count items of
+// each bytes, without overflowing.
+static bool Fits(size_t have, size_t fixed, size_t count, size_t each)
+{
+    return have >= fixed && count <= (have - fixed) / each;
+}
+
+static bool CheckRecord(unsigned type, const char* d, size_t bytes)
+{
+    switch (type)
+    {
+    case CAPTURE_FRAME:                  return bytes >= sizeof(CaptureFrame);
+    case CAPTURE_VERTEX_BUFFER:          return bytes >= sizeof(CaptureVertexBuffer);
+    case CAPTURE_INDEX_BUFFER:           return bytes >= sizeof(CaptureIndexBuffer);
+    case CAPTURE_BUFFER_DATA:
+        return bytes >= sizeof(CaptureBufferData) &&
+               Fits(bytes, sizeof(CaptureBufferData), reinterpret_cast<const CaptureBufferData*>(d)->bytes, 1);
+    case CAPTURE_SHADER:
+        return bytes >= sizeof(CaptureShader) &&
+               reinterpret_cast<const CaptureShader*>(d)->bytes % 4 == 0 &&
+               Fits(bytes, sizeof(CaptureShader), reinterpret_cast<const CaptureShader*>(d)->bytes, 1);
+    case CAPTURE_DECLARATION:
+        return bytes >= sizeof(CaptureDeclaration) &&
+               Fits(bytes, sizeof(CaptureDeclaration), reinterpret_cast<const CaptureDeclaration*>(d)->count,
+                    sizeof(CaptureVertexElement));
+    case CAPTURE_MESH:
+        return bytes >= sizeof(CaptureMesh) &&
+               Fits(bytes, sizeof(CaptureMesh), reinterpret_cast<const CaptureMesh*>(d)->numRanges,
+                    sizeof(CaptureAttributeRange));
+    case CAPTURE_CLEAR:                  return bytes >= sizeof(CaptureClear);
+    case CAPTURE_SET_RENDER_STATE:
+    case CAPTURE_SET_FVF:
+    case CAPTURE_LIGHT_ENABLE:           return bytes >= sizeof(CaptureState);
+    case CAPTURE_SET_TEXTURE:            return bytes >= sizeof(CaptureSetTexture);
+    case CAPTURE_SET_STREAM_SOURCE:      return bytes >= sizeof(CaptureStreamSource);
+    case CAPTURE_SET_INDICES:
+    case CAPTURE_SET_VERTEX_DECLARATION:
+    case CAPTURE_SET_VERTEX_SHADER:
+    case CAPTURE_SET_PIXEL_SHADER:       return bytes >= sizeof(CaptureObject);
+    case CAPTURE_SET_VERTEX_SHADER_CONSTANT_F:
+    case CAPTURE_SET_PIXEL_SHADER_CONSTANT_F:
+        return bytes >= sizeof(CaptureConstants) &&
+               Fits(bytes, sizeof(CaptureConstants), reinterpret_cast<const CaptureConstants*>(d)->count,
+                    4 * sizeof(float));
+    case CAPTURE_SET_TRANSFORM:          return bytes >= sizeof(CaptureTransform);
+    case CAPTURE_SET_MATERIAL:           return bytes >= sizeof(CaptureMaterial);
+    case CAPTURE_SET_LIGHT:              return bytes >= sizeof(CaptureSetLight);
+    case CAPTURE_SET_MATRIX:
+    {
+        if (bytes < sizeof(CaptureSetMatrix))
+            return false;
+        const CaptureSetMatrix* c = reinterpret_cast<const CaptureSetMatrix*>(d);
+        if (!Fits(bytes, sizeof(CaptureSetMatrix), c->count, 16 * sizeof(float)))
+            return false;
+        size_t nameAt = sizeof(CaptureSetMatrix) + (size_t)c->count * 16 * sizeof(float);
+        return c->nameBytes > 0 && Fits(bytes, nameAt, c->nameBytes, 1) && d[nameAt + c->nameBytes - 1] == '\0';
+    }
+    case CAPTURE_DRAW_PRIMITIVE:         return bytes >= sizeof(CaptureDrawPrimitive);
+    case CAPTURE_DRAW_INDEXED_PRIMITIVE: return bytes >= sizeof(CaptureDrawIndexed);
+    case CAPTURE_DRAW_SUBSET:            return bytes >= sizeof(CaptureDrawSubset);
+    case CAPTURE_SET_SAMPLER_STATE:
+    case CAPTURE_SET_TEXTURE_STAGE_STATE: return bytes >= sizeof(CaptureStageState);
+    case CAPTURE_SET_VIEWPORT:           return bytes >= sizeof(CaptureViewport);
+    case CAPTURE_SET_SCISSOR_RECT:       return bytes >= sizeof(CaptureRect);
+    case CAPTURE_SET_CLIP_PLANE:         return bytes >= sizeof(CaptureClipPlane);
+    case CAPTURE_SET_STREAM_SOURCE_FREQ: return bytes >= sizeof(CaptureState);
+    }
+    return false;
+}
+
+
+CaptureFile::CaptureFile()
+{
+    Clear();
+}
+
+void CaptureFile::Clear()
+{
+    m_stream.clear();
+    m_frames    = 0;
+    m_records   = 0;
+    m_fileBytes = 0;
+    memset(m_recordsByType, 0, sizeof(m_recordsByType));
+}
+
+bool CaptureFile::Load(const char* path, std::string* pError)
+{
+    Clear();
+
+    std::string error;
+    std::vector<char> file;
+    if (!ReadFileBytes(path, file))
+        error = "cannot read file";
+    else if (file.size() < sizeof(CaptureFileHeader))
+        error = "too short";
+
+    CaptureFileHeader header;
+    if (error.empty())
+    {
+        memcpy(&header, &file[0], sizeof(header));
+        if (memcmp(header.magic, "D9CP", 4) != 0)
+            error = "not a capture";
+        else if (header.version == 0 || header.version > CAPTURE_VERSION)
+            error = "unsupported version";
+        else if (header.rawBytes % 4 != 0 || header.rawBytes / 255 > file.size())
+            error = "bad header";
+    }
+
+    // Chunks.
+    if (error.empty())
+    {
+        m_stream.resize(header.rawBytes / 4);
+        char*  pOut   = m_stream.empty() ? NULL : reinterpret_cast<char*>(&m_stream[0]);
+        size_t at     = sizeof(CaptureFileHeader);
+        size_t filled = 0;
+        while (error.empty() && at < file.size())
+        {
+            CaptureChunkHeader chunk;
+            if (file.size() - at < sizeof(chunk))
+            {
+                error = "truncated chunk";
+                break;
+            }
+            memcpy(&chunk, &file[at], sizeof(chunk));
+            at += sizeof(chunk);
+
+            if (chunk.packedBytes > file.size() - at || chunk.rawBytes > header.rawBytes - filled ||
+                chunk.packedBytes > chunk.rawBytes)
+                error = "bad chunk";
+            else if (chunk.packedBytes == chunk.rawBytes)
+                memcpy(pOut + filled, &file[at], chunk.rawBytes);
+            else if (Lz4Decompress(&file[at], chunk.packedBytes, pOut + filled, chunk.rawBytes) != chunk.rawBytes)
+                error = "corrupt chunk";
+            at     += chunk.packedBytes;
+            filled += chunk.rawBytes;
+        }
+        if (error.empty() && filled != header.rawBytes)
+            error = "truncated";
+    }
+
+    // Records.
+    if (error.empty() && !m_stream.empty())
+    {
+        const char* p   = reinterpret_cast<const char*>(&m_stream[0]);
+        const char* end = p + header.rawBytes;
+        while (p < end)
+        {
+            const CaptureRecordHeader* h = reinterpret_cast<const CaptureRecordHeader*>(p);
+            if ((size_t)(end - p) < sizeof(CaptureRecordHeader) ||
+                h->bytes > (size_t)(end - p) - sizeof(CaptureRecordHeader) ||
+                CaptureRecordBytes(h->bytes) > (size_t)(end - p))
+            {
+                error = "truncated record";
+                break;
+            }
+            if (h->type >= NUM_CAPTURE_RECORD_TYPES || !CheckRecord(h->type, p + sizeof(CaptureRecordHeader), h->bytes))
+            {
+                error = "bad record";
+                break;
+            }
+            ++m_records;
+            ++m_recordsByType[h->type];
+            p += CaptureRecordBytes(h->bytes);
+        }
+        m_frames = m_recordsByType[CAPTURE_FRAME];
+    }
+
+    if (!error.empty())
+    {
+        Clear();
+        if (pError)
+            *pError = std::string(path) + ": " + error;
+        return false;
+    }
+    m_fileBytes = file.size();
+    return true;
+}
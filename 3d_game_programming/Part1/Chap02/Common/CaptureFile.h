@@ -0,0 +1,262 @@
+//=============================================================================
+// CaptureFile.h
+//
+// Reads a device capture (CaptureFormat.h) into memory and plays it back.
+// Load() unpacks the whole record stream and checks every record against
+// the size its type needs, so Replay() can run through it without further
+// checks and without touching the file system:
+//
+//     CaptureFile capture;
+//     if (capture.Load("lights.d9c", &error))
+//         capture.Replay(target);
+//
+// Like CommandBuffer::Replay, the target is anything with the methods
+// below; objects are passed by capture id instead of by pointer, and the
+// creation records come before the first use of an id:
+//
+//     CreateVertexBuffer(id, bytes, fvf)      CreateIndexBuffer(id, bytes, indexSize)
+//     BufferData(id, offset, pData, bytes, lockFlags)
+//     CreateShader(id, pixelShader, pTokens, bytes)
+//     CreateDeclaration(id, pElements, count)
+//     CreateMesh(mesh, pRanges)
+//     Clear(flags, color, z, stencil)         SetRenderState(state, value)
+//     SetTexture(sampler, texture)            SetStreamSource(stream, buffer, offset, stride)
+//     SetStreamSourceFreq(stream, setting)
+//     SetSamplerState(sampler, state, value)  SetTextureStageState(stage, state, value)
+//     SetIndices(buffer)                      SetFVF(fvf)
+//     SetVertexDeclaration(declaration)       SetVertexShader(shader)  SetPixelShader(shader)
+//     SetVertexShaderConstantF(first, pData, count)
+//     SetPixelShaderConstantF(first, pData, count)
+//     SetTransform(state, pMatrix)            SetMaterial(material)
+//     SetLight(index, light)                  LightEnable(index, enable)
+//     SetViewport(viewport)                   SetScissorRect(rect)
+//     SetClipPlane(index, pPlane)
+//     SetMatrix(effect, name, pMatrices, count)
+//     DrawPrimitive(type, startVertex, primCount)
+//     DrawIndexedPrimitive(type, baseVertex, minIndex, numVertices, startIndex, primCount)
+//     DrawSubset(mesh, attribute)             EndFrame(frame)
+//
+// No DirectX headers are needed, so captures replay on any platform.
+//=============================================================================
+
+#ifndef CAPTURE_FILE_H
+#define CAPTURE_FILE_H
+
+#include "CaptureFormat.h"
+#include <string>
+#include <vector>
+
+
+class CaptureFile
+{
+public:
+    CaptureFile();
+
+    bool Load(const char* path, std::string* pError = NULL);
+    void Clear();
+
+    unsigned NumFrames() const      { return m_frames; }
+    unsigned NumRecords() const     { return m_records; }
+    unsigned NumRecords(CaptureRecordType type) const { return m_recordsByType[type]; }
+    size_t   RawBytes() const       { return m_stream.size(); }
+    size_t   FileBytes() const      { return m_fileBytes; }
+
+    template<typename Target>
+    void Replay(Target& target) const;
+
+private:
+    std::vector<unsigned> m_stream;     // records; 4-byte aligned
+    unsigned              m_frames;
+    unsigned              m_records;
+    unsigned              m_recordsByType[NUM_CAPTURE_RECORD_TYPES];
+    size_t                m_fileBytes;
+};
+
+
+template<typename Target>
+void CaptureFile::Replay(Target& target) const
+{
+    if (m_stream.empty())
+        return;
+
+    const char* p   = reinterpret_cast<const char*>(&m_stream[0]);
+    const char* end = p + m_stream.size() * sizeof(unsigned);
+    while (p < end)
+    {
+        const CaptureRecordHeader* h = reinterpret_cast<const CaptureRecordHeader*>(p);
+        const char* d = p + sizeof(CaptureRecordHeader);
+        switch (h->type)
+        {
+        case CAPTURE_FRAME:
+            target.EndFrame(reinterpret_cast<const CaptureFrame*>(d)->frame);
+            break;
+        case CAPTURE_VERTEX_BUFFER:
+        {
+            const CaptureVertexBuffer* c = reinterpret_cast<const CaptureVertexBuffer*>(d);
+            target.CreateVertexBuffer(c->id, c->bytes, c->fvf);
+            break;
+        }
+        case CAPTURE_INDEX_BUFFER:
+        {
+            const CaptureIndexBuffer* c = reinterpret_cast<const CaptureIndexBuffer*>(d);
+            target.CreateIndexBuffer(c->id, c->bytes, c->indexSize);
+            break;
+        }
+        case CAPTURE_BUFFER_DATA:
+        {
+            const CaptureBufferData* c = reinterpret_cast<const CaptureBufferData*>(d);
+            target.BufferData(c->id, c->offset, c + 1, c->bytes, c->lockFlags);
+            break;
+        }
+        case CAPTURE_SHADER:
+        {
+            const CaptureShader* c = reinterpret_cast<const CaptureShader*>(d);
+            target.CreateShader(c->id, c->pixelShader != 0, reinterpret_cast<const unsigned*>(c + 1), c->bytes);
+            break;
+        }
+        case CAPTURE_DECLARATION:
+        {
+            const CaptureDeclaration* c = reinterpret_cast<const CaptureDeclaration*>(d);
+            target.CreateDeclaration(c->id, reinterpret_cast<const CaptureVertexElement*>(c + 1), c->count);
+            break;
+        }
+        case CAPTURE_MESH:
+        {
+            const CaptureMesh* c = reinterpret_cast<const CaptureMesh*>(d);
+            target.CreateMesh(*c, reinterpret_cast<const CaptureAttributeRange*>(c + 1));
+            break;
+        }
+        case CAPTURE_CLEAR:
+        {
+            const CaptureClear* c = reinterpret_cast<const CaptureClear*>(d);
+            target.Clear(c->flags, c->color, c->z, c->stencil);
+            break;
+        }
+        case CAPTURE_SET_RENDER_STATE:
+        {
+            const CaptureState* c = reinterpret_cast<const CaptureState*>(d);
+            target.SetRenderState(c->state, c->value);
+            break;
+        }
+        case CAPTURE_SET_TEXTURE:
+        {
+            const CaptureSetTexture* c = reinterpret_cast<const CaptureSetTexture*>(d);
+            target.SetTexture(c->sampler, c->texture);
+            break;
+        }
+        case CAPTURE_SET_SAMPLER_STATE:
+        {
+            const CaptureStageState* c = reinterpret_cast<const CaptureStageState*>(d);
+            target.SetSamplerState(c->stage, c->state, c->value);
+            break;
+        }
+        case CAPTURE_SET_TEXTURE_STAGE_STATE:
+        {
+            const CaptureStageState* c = reinterpret_cast<const CaptureStageState*>(d);
+            target.SetTextureStageState(c->stage, c->state, c->value);
+            break;
+        }
+        case CAPTURE_SET_STREAM_SOURCE:
+        {
+            const CaptureStreamSource* c = reinterpret_cast<const CaptureStreamSource*>(d);
+            target.SetStreamSource(c->stream, c->buffer, c->offset, c->stride);
+            break;
+        }
+        case CAPTURE_SET_STREAM_SOURCE_FREQ:
+        {
+            const CaptureState* c = reinterpret_cast<const CaptureState*>(d);
+            target.SetStreamSourceFreq(c->state, c->value);
+            break;
+        }
+        case CAPTURE_SET_INDICES:
+            target.SetIndices(reinterpret_cast<const CaptureObject*>(d)->id);
+            break;
+        case CAPTURE_SET_FVF:
+            target.SetFVF(reinterpret_cast<const CaptureState*>(d)->value);
+            break;
+        case CAPTURE_SET_VERTEX_DECLARATION:
+            target.SetVertexDeclaration(reinterpret_cast<const CaptureObject*>(d)->id);
+            break;
+        case CAPTURE_SET_VERTEX_SHADER:
+            target.SetVertexShader(reinterpret_cast<const CaptureObject*>(d)->id);
+            break;
+        case CAPTURE_SET_PIXEL_SHADER:
+            target.SetPixelShader(reinterpret_cast<const CaptureObject*>(d)->id);
+            break;
+        case CAPTURE_SET_VERTEX_SHADER_CONSTANT_F:
+        {
+            const CaptureConstants* c = reinterpret_cast<const CaptureConstants*>(d);
+            target.SetVertexShaderConstantF(c->first, reinterpret_cast<const float*>(c + 1), c->count);
+            break;
+        }
+        case CAPTURE_SET_PIXEL_SHADER_CONSTANT_F:
+        {
+            const CaptureConstants* c = reinterpret_cast<const CaptureConstants*>(d);
+            target.SetPixelShaderConstantF(c->first, reinterpret_cast<const float*>(c + 1), c->count);
+            break;
+        }
+        case CAPTURE_SET_TRANSFORM:
+        {
+            const CaptureTransform* c = reinterpret_cast<const CaptureTransform*>(d);
+            target.SetTransform(c->state, c->m);
+            break;
+        }
+        case CAPTURE_SET_MATERIAL:
+            target.SetMaterial(*reinterpret_cast<const CaptureMaterial*>(d));
+            break;
+        case CAPTURE_SET_LIGHT:
+        {
+            const CaptureSetLight* c = reinterpret_cast<const CaptureSetLight*>(d);
+            target.SetLight(c->index, c->light);
+            break;
+        }
+        case CAPTURE_LIGHT_ENABLE:
+        {
+            const CaptureState* c = reinterpret_cast<const CaptureState*>(d);
+            target.LightEnable(c->state, c->value != 0);
+            break;
+        }
+        case CAPTURE_SET_VIEWPORT:
+            target.SetViewport(*reinterpret_cast<const CaptureViewport*>(d));
+            break;
+        case CAPTURE_SET_SCISSOR_RECT:
+            target.SetScissorRect(*reinterpret_cast<const CaptureRect*>(d));
+            break;
+        case CAPTURE_SET_CLIP_PLANE:
+        {
+            const CaptureClipPlane* c = reinterpret_cast<const CaptureClipPlane*>(d);
+            target.SetClipPlane(c->index, c->plane);
+            break;
+        }
+        case CAPTURE_SET_MATRIX:
+        {
+            const CaptureSetMatrix* c = reinterpret_cast<const CaptureSetMatrix*>(d);
+            const float* pMatrices = reinterpret_cast<const float*>(c + 1);
+            target.SetMatrix(c->effect, reinterpret_cast<const char*>(pMatrices + 16 * c->count), pMatrices, c->count);
+            break;
+        }
+        case CAPTURE_DRAW_PRIMITIVE:
+        {
+            const CaptureDrawPrimitive* c = reinterpret_cast<const CaptureDrawPrimitive*>(d);
+            target.DrawPrimitive(c->type, c->startVertex, c->primCount);
+            break;
+        }
+        case CAPTURE_DRAW_INDEXED_PRIMITIVE:
+        {
+            const CaptureDrawIndexed* c = reinterpret_cast<const CaptureDrawIndexed*>(d);
+            target.DrawIndexedPrimitive(c->type, c->baseVertex, c->minIndex, c->numVertices,
+                                        c->startIndex, c->primCount);
+            break;
+        }
+        case CAPTURE_DRAW_SUBSET:
+        {
+            const CaptureDrawSubset* c = reinterpret_cast<const CaptureDrawSubset*>(d);
+            target.DrawSubset(c->mesh, c->attribute);
+            break;
+        }
+        }
+        p += CaptureRecordBytes(h->bytes);
+    }
+}
+
+#endif // CAPTURE_FILE_H
@@ -0,0 +1,240 @@
+//=============================================================================
+// CaptureFormat.h
+//
+// Layout of a device capture file (.d9c), shared by the writer
+// (DeviceCapture.h, Windows) and the readers (CaptureFile.h, SoftReplay.h),
+// which do not depend on the DirectX SDK.
+//
+//     CaptureFileHeader
+//     chunk*          CaptureChunkHeader, then packedBytes of LZ4 block
+//                     (or rawBytes stored as is when LZ4 did not help)
+//
+// Unpacked and concatenated, the chunks are a stream of records: a
+// CaptureRecordHeader followed by the payload of its type, padded to a
+// multiple of 4 bytes.  Objects (buffers, shaders, declarations, meshes,
+// textures, effects) are named by ids handed out in capture order; 0 is
+// NULL.  A buffer, shader, declaration or mesh is described by its own
+// record before the first record that uses its id.
+//
+// All values are the D3D9 ones (D3DRENDERSTATETYPE, D3DPRIMITIVETYPE, FVF
+// bits, ...); the few a reader needs are repeated below with a CAPTURE_
+// prefix.  Matrices are row-major D3DMATRIX.
+//=============================================================================
+
+#ifndef CAPTURE_FORMAT_H
+#define CAPTURE_FORMAT_H
+
+
+// 2: sampler, texture stage, viewport, scissor and clip plane records.
+// 3: stream source frequency records.
+// Readers accept every version up to their own.
+const unsigned CAPTURE_VERSION = 3;
+
+struct CaptureFileHeader
+{
+    char     magic[4];          // "D9CP"
+    unsigned version;
+    unsigned frames;            // CAPTURE_FRAME records
+    unsigned records;
+    unsigned rawBytes;          // record stream, unpacked
+};
+
+struct CaptureChunkHeader
+{
+    unsigned rawBytes;
+    unsigned packedBytes;       // == rawBytes: stored
+};
+
+enum CaptureRecordType
+{
+    CAPTURE_FRAME,                          // Present()
+    CAPTURE_VERTEX_BUFFER,                  // first use of a buffer
+    CAPTURE_INDEX_BUFFER,
+    CAPTURE_BUFFER_DATA,                    // what Lock()/Unlock() wrote
+    CAPTURE_SHADER,                         // first use of a shader
+    CAPTURE_DECLARATION,                    // first use of a vertex declaration
+    CAPTURE_MESH,                           // first DrawSubset() of a mesh
+    CAPTURE_CLEAR,
+    CAPTURE_SET_RENDER_STATE,
+    CAPTURE_SET_TEXTURE,
+    CAPTURE_SET_STREAM_SOURCE,
+    CAPTURE_SET_INDICES,
+    CAPTURE_SET_FVF,
+    CAPTURE_SET_VERTEX_DECLARATION,
+    CAPTURE_SET_VERTEX_SHADER,
+    CAPTURE_SET_PIXEL_SHADER,
+    CAPTURE_SET_VERTEX_SHADER_CONSTANT_F,
+    CAPTURE_SET_PIXEL_SHADER_CONSTANT_F,
+    CAPTURE_SET_TRANSFORM,
+    CAPTURE_SET_MATERIAL,
+    CAPTURE_SET_LIGHT,
+    CAPTURE_LIGHT_ENABLE,
+    CAPTURE_SET_MATRIX,                     // ID3DXEffect::SetMatrix / SetMatrixArray
+    CAPTURE_DRAW_PRIMITIVE,
+    CAPTURE_DRAW_INDEXED_PRIMITIVE,
+    CAPTURE_DRAW_SUBSET,
+    CAPTURE_SET_SAMPLER_STATE,              // version 2
+    CAPTURE_SET_TEXTURE_STAGE_STATE,
+    CAPTURE_SET_VIEWPORT,
+    CAPTURE_SET_SCISSOR_RECT,
+    CAPTURE_SET_CLIP_PLANE,
+    CAPTURE_SET_STREAM_SOURCE_FREQ,         // version 3
+    NUM_CAPTURE_RECORD_TYPES
+};
+
+struct CaptureRecordHeader
+{
+    unsigned type;
+    unsigned bytes;             // payload, before padding
+};
+
+// Record header plus padded payload, in bytes.
+inline unsigned CaptureRecordBytes(unsigned payloadBytes)
+{
+    return (unsigned)sizeof(CaptureRecordHeader) + ((payloadBytes + 3) & ~3u);
+}
+
+
+//===============================================================
+// Payloads
+
+struct CaptureFrame            { unsigned frame; };
+struct CaptureVertexBuffer     { unsigned id; unsigned bytes; unsigned fvf; };
+struct CaptureIndexBuffer      { unsigned id; unsigned bytes; unsigned indexSize; };   // 2 or 4
+struct CaptureBufferData       { unsigned id; unsigned offset; unsigned bytes; unsigned lockFlags; };  // + bytes
+struct CaptureShader           { unsigned id; unsigned pixelShader; unsigned bytes; };                 // + tokens
+struct CaptureDeclaration      { unsigned id; unsigned count; };                       // + count elements
+
+// D3DVERTEXELEMENT9
+struct CaptureVertexElement
+{
+    unsigned short stream;
+    unsigned short offset;
+    unsigned char  type;
+    unsigned char  method;
+    unsigned char  usage;
+    unsigned char  usageIndex;
+};
+
+// D3DXATTRIBUTERANGE
+struct CaptureAttributeRange
+{
+    unsigned attribute;
+    unsigned faceStart;
+    unsigned faceCount;
+    unsigned vertexStart;
+    unsigned vertexCount;
+};
+
+// The mesh's vertices and indices are ordinary buffers, captured with
+// their own records just before this one.  + numRanges ranges.
+struct CaptureMesh
+{
+    unsigned id;
+    unsigned vertexBuffer;
+    unsigned indexBuffer;
+    unsigned fvf;
+    unsigned stride;
+    unsigned numRanges;
+};
+
+struct CaptureClear            { unsigned flags; unsigned color; float z; unsigned stencil; };
+struct CaptureState            { unsigned state; unsigned value; };                    // render state, FVF, LightEnable, stream frequency
+struct CaptureSetTexture       { unsigned sampler; unsigned texture; };
+struct CaptureStreamSource     { unsigned stream; unsigned buffer; unsigned offset; unsigned stride; };
+struct CaptureObject           { unsigned id; };                                       // indices, declaration, shaders
+struct CaptureConstants        { unsigned first; unsigned count; };                    // + count float4s
+struct CaptureTransform        { unsigned state; float m[16]; };
+struct CaptureStageState       { unsigned stage; unsigned state; unsigned value; };    // sampler or texture stage
+struct CaptureViewport         { unsigned x; unsigned y; unsigned width; unsigned height; float minZ; float maxZ; };
+struct CaptureRect             { int left; int top; int right; int bottom; };
+struct CaptureClipPlane        { unsigned index; float plane[4]; };
+
+// D3DMATERIAL9
+struct CaptureMaterial
+{
+    float diffuse[4];
+    float ambient[4];
+    float specular[4];
+    float emissive[4];
+    float power;
+};
+
+// D3DLIGHT9
+struct CaptureLight
+{
+    unsigned type;
+    float    diffuse[4];
+    float    specular[4];
+    float    ambient[4];
+    float    position[3];
+    float    direction[3];
+    float    range;
+    float    falloff;
+    float    attenuation[3];
+    float    theta;
+    float    phi;
+};
+
+struct CaptureSetLight         { unsigned index; CaptureLight light; };
+
+// + count matrices, then nameBytes of parameter name (with its NUL).
+struct CaptureSetMatrix        { unsigned effect; unsigned count; unsigned nameBytes; };
+
+struct CaptureDrawPrimitive    { unsigned type; unsigned startVertex; unsigned primCount; };
+struct CaptureDrawIndexed      { unsigned type; int baseVertex; unsigned minIndex; unsigned numVertices;
+                                 unsigned startIndex; unsigned primCount; };
+struct CaptureDrawSubset       { unsigned mesh; unsigned attribute; };
+
+
+//===============================================================
+// D3D9 values a reader needs
+
+enum
+{
+    CAPTURE_PT_POINTLIST = 1, CAPTURE_PT_LINELIST, CAPTURE_PT_LINESTRIP,
+    CAPTURE_PT_TRIANGLELIST, CAPTURE_PT_TRIANGLESTRIP, CAPTURE_PT_TRIANGLEFAN
+};
+
+enum
+{
+    CAPTURE_FVF_XYZ            = 0x002,
+    CAPTURE_FVF_XYZRHW         = 0x004,
+    CAPTURE_FVF_POSITION_MASK  = 0x400e,
+    CAPTURE_FVF_NORMAL         = 0x010,
+    CAPTURE_FVF_PSIZE          = 0x020,
+    CAPTURE_FVF_DIFFUSE        = 0x040,
+    CAPTURE_FVF_SPECULAR       = 0x080,
+    CAPTURE_FVF_TEXCOUNT_MASK  = 0xf00,
+    CAPTURE_FVF_TEXCOUNT_SHIFT = 8
+};
+
+enum
+{
+    CAPTURE_RS_ZENABLE      = 7,
+    CAPTURE_RS_ZWRITEENABLE = 14,
+    CAPTURE_RS_CULLMODE     = 22,
+    CAPTURE_RS_LIGHTING     = 137,
+    CAPTURE_RS_AMBIENT      = 139
+};
+
+enum
+{
+    CAPTURE_TS_VIEW       = 2,
+    CAPTURE_TS_PROJECTION = 3,
+    CAPTURE_TS_WORLD      = 256
+};
+
+enum
+{
+    CAPTURE_CLEAR_TARGET  = 1,
+    CAPTURE_CLEAR_ZBUFFER = 2
+};
+
+enum
+{
+    CAPTURE_DECL_USAGE_POSITIONT = 9,
+    CAPTURE_DECL_UNUSED          = 17       // D3DDECLTYPE_UNUSED, ends a declaration
+};
+
+#endif // CAPTURE_FORMAT_H
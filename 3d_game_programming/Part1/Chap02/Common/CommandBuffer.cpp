@@ -0,0 +1,395 @@
+//=============================================================================
+// CommandBuffer.cpp
+//=============================================================================
+
+#include "CommandBuffer.h"
+#include "StateCache.h"
+#include "JobSystem.h"
+#include <chrono>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define snprintf _snprintf
+#endif
+
+using namespace command_detail;
+
+
+namespace
+{
+    double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    // Replay target for Execute(): state and draws through the cache when
+    // there is one (so a device capture sees them), else to the device.
+    class DeviceTarget
+    {
+    public:
+        DeviceTarget(IDirect3DDevice9* pDevice, StateCache* pCache)
+            : m_pDevice(pDevice), m_pCache(pCache), m_result(D3D_OK) {}
+
+        HRESULT Result() const { return m_result; }
+
+        void SetRenderState(D3DRENDERSTATETYPE s, DWORD v)                 { Check(m_pCache ? m_pCache->SetRenderState(s, v) : m_pDevice->SetRenderState(s, v)); }
+        void SetSamplerState(DWORD i, D3DSAMPLERSTATETYPE s, DWORD v)      { Check(m_pCache ? m_pCache->SetSamplerState(i, s, v) : m_pDevice->SetSamplerState(i, s, v)); }
+        void SetTextureStageState(DWORD i, D3DTEXTURESTAGESTATETYPE s, DWORD v) { Check(m_pCache ? m_pCache->SetTextureStageState(i, s, v) : m_pDevice->SetTextureStageState(i, s, v)); }
+        void SetTexture(DWORD i, IDirect3DBaseTexture9* p)                 { Check(m_pCache ? m_pCache->SetTexture(i, p) : m_pDevice->SetTexture(i, p)); }
+        void SetStreamSource(UINT i, IDirect3DVertexBuffer9* p, UINT o, UINT s) { Check(m_pCache ? m_pCache->SetStreamSource(i, p, o, s) : m_pDevice->SetStreamSource(i, p, o, s)); }
+        void SetIndices(IDirect3DIndexBuffer9* p)                          { Check(m_pCache ? m_pCache->SetIndices(p) : m_pDevice->SetIndices(p)); }
+        void SetFVF(DWORD fvf)                                             { Check(m_pCache ? m_pCache->SetFVF(fvf) : m_pDevice->SetFVF(fvf)); }
+        void SetVertexDeclaration(IDirect3DVertexDeclaration9* p)          { Check(m_pCache ? m_pCache->SetVertexDeclaration(p) : m_pDevice->SetVertexDeclaration(p)); }
+        void SetVertexShader(IDirect3DVertexShader9* p)                    { Check(m_pCache ? m_pCache->SetVertexShader(p) : m_pDevice->SetVertexShader(p)); }
+        void SetPixelShader(IDirect3DPixelShader9* p)                      { Check(m_pCache ? m_pCache->SetPixelShader(p) : m_pDevice->SetPixelShader(p)); }
+        void SetVertexShaderConstantF(UINT r, const float* p, UINT n)      { Check(m_pCache ? m_pCache->SetVertexShaderConstantF(r, p, n) : m_pDevice->SetVertexShaderConstantF(r, p, n)); }
+        void SetPixelShaderConstantF(UINT r, const float* p, UINT n)       { Check(m_pCache ? m_pCache->SetPixelShaderConstantF(r, p, n) : m_pDevice->SetPixelShaderConstantF(r, p, n)); }
+        void SetTransform(D3DTRANSFORMSTATETYPE s, const D3DMATRIX* p)     { Check(m_pCache ? m_pCache->SetTransform(s, p) : m_pDevice->SetTransform(s, p)); }
+        void SetMaterial(const D3DMATERIAL9* p)                            { Check(m_pCache ? m_pCache->SetMaterial(p) : m_pDevice->SetMaterial(p)); }
+        void SetLight(DWORD i, const D3DLIGHT9* p)                         { Check(m_pCache ? m_pCache->SetLight(i, p) : m_pDevice->SetLight(i, p)); }
+        void LightEnable(DWORD i, BOOL b)                                  { Check(m_pCache ? m_pCache->LightEnable(i, b) : m_pDevice->LightEnable(i, b)); }
+
+        void DrawPrimitive(D3DPRIMITIVETYPE t, UINT start, UINT n)
+        {
+            Check(m_pCache ? m_pCache->DrawPrimitive(t, start, n) : m_pDevice->DrawPrimitive(t, start, n));
+        }
+
+        void DrawIndexedPrimitive(D3DPRIMITIVETYPE t, INT base, UINT minIndex, UINT numVertices,
+                                  UINT startIndex, UINT n)
+        {
+            Check(m_pCache ? m_pCache->DrawIndexedPrimitive(t, base, minIndex, numVertices, startIndex, n)
+                           : m_pDevice->DrawIndexedPrimitive(t, base, minIndex, numVertices, startIndex, n));
+        }
+
+        void DrawSubset(ID3DXMesh* pMesh, DWORD attribute)
+        {
+            // The mesh sets its own buffers and vertex format on the device;
+            // the cache forgets its shadow of them.
+            Check(m_pCache ? m_pCache->DrawSubset(pMesh, attribute) : pMesh->DrawSubset(attribute));
+        }
+
+    private:
+        void Check(HRESULT hr)
+        {
+            if (FAILED(hr) && SUCCEEDED(m_result))
+                m_result = hr;
+        }
+
+        IDirect3DDevice9* m_pDevice;
+        StateCache*       m_pCache;
+        HRESULT           m_result;
+    };
+}
+
+
+//===============================================================
+// CommandBuffer
+
+CommandBuffer::CommandBuffer(size_t pageBytes)
+    : m_memory(pageBytes),
+      m_numCommands(0),
+      m_numDraws(0),
+      m_outOfMemory(false)
+{
+}
+
+void CommandBuffer::Reset()
+{
+    m_memory.Reset();
+    m_numCommands = 0;
+    m_numDraws    = 0;
+    m_outOfMemory = false;
+}
+
+void CommandBuffer::SetRenderState(D3DRENDERSTATETYPE state, DWORD value)
+{
+    if (StateCmd* c = Add<StateCmd>(SET_RENDER_STATE))
+    {
+        c->stage = 0;
+        c->state = (DWORD)state;
+        c->value = value;
+    }
+}
+
+void CommandBuffer::SetSamplerState(DWORD sampler, D3DSAMPLERSTATETYPE type, DWORD value)
+{
+    if (StateCmd* c = Add<StateCmd>(SET_SAMPLER_STATE))
+    {
+        c->stage = sampler;
+        c->state = (DWORD)type;
+        c->value = value;
+    }
+}
+
+void CommandBuffer::SetTextureStageState(DWORD stage, D3DTEXTURESTAGESTATETYPE type, DWORD value)
+{
+    if (StateCmd* c = Add<StateCmd>(SET_TEXTURE_STAGE_STATE))
+    {
+        c->stage = stage;
+        c->state = (DWORD)type;
+        c->value = value;
+    }
+}
+
+void CommandBuffer::SetTexture(DWORD sampler, IDirect3DBaseTexture9* pTexture)
+{
+    if (TextureCmd* c = Add<TextureCmd>(SET_TEXTURE))
+    {
+        c->sampler  = sampler;
+        c->pTexture = pTexture;
+    }
+}
+
+void CommandBuffer::SetStreamSource(UINT stream, IDirect3DVertexBuffer9* pVB, UINT offset, UINT stride)
+{
+    if (StreamCmd* c = Add<StreamCmd>(SET_STREAM_SOURCE))
+    {
+        c->stream = stream;
+        c->offset = offset;
+        c->stride = stride;
+        c->pVB    = pVB;
+    }
+}
+
+void CommandBuffer::SetIndices(IDirect3DIndexBuffer9* pIB)
+{
+    if (IndicesCmd* c = Add<IndicesCmd>(SET_INDICES))
+        c->pIB = pIB;
+}
+
+void CommandBuffer::SetFVF(DWORD fvf)
+{
+    if (FvfCmd* c = Add<FvfCmd>(SET_FVF))
+        c->fvf = fvf;
+}
+
+void CommandBuffer::SetVertexDeclaration(IDirect3DVertexDeclaration9* pDecl)
+{
+    if (PointerCmd* c = Add<PointerCmd>(SET_VERTEX_DECLARATION))
+        c->p = pDecl;
+}
+
+void CommandBuffer::SetVertexShader(IDirect3DVertexShader9* pShader)
+{
+    if (PointerCmd* c = Add<PointerCmd>(SET_VERTEX_SHADER))
+        c->p = pShader;
+}
+
+void CommandBuffer::SetPixelShader(IDirect3DPixelShader9* pShader)
+{
+    if (PointerCmd* c = Add<PointerCmd>(SET_PIXEL_SHADER))
+        c->p = pShader;
+}
+
+void CommandBuffer::SetVertexShaderConstantF(UINT first, const float* pData, UINT count)
+{
+    if (ConstantsCmd* c = Add<ConstantsCmd>(SET_VERTEX_SHADER_CONSTANT_F, count * 4 * sizeof(float)))
+    {
+        c->first = first;
+        c->count = count;
+        memcpy(c + 1, pData, count * 4 * sizeof(float));
+    }
+}
+
+void CommandBuffer::SetPixelShaderConstantF(UINT first, const float* pData, UINT count)
+{
+    if (ConstantsCmd* c = Add<ConstantsCmd>(SET_PIXEL_SHADER_CONSTANT_F, count * 4 * sizeof(float)))
+    {
+        c->first = first;
+        c->count = count;
+        memcpy(c + 1, pData, count * 4 * sizeof(float));
+    }
+}
+
+void CommandBuffer::SetTransform(D3DTRANSFORMSTATETYPE state, const D3DMATRIX* pMatrix)
+{
+    if (TransformCmd* c = Add<TransformCmd>(SET_TRANSFORM))
+    {
+        c->state  = state;
+        c->matrix = *pMatrix;
+    }
+}
+
+void CommandBuffer::SetMaterial(const D3DMATERIAL9* pMaterial)
+{
+    if (MaterialCmd* c = Add<MaterialCmd>(SET_MATERIAL))
+        c->material = *pMaterial;
+}
+
+void CommandBuffer::SetLight(DWORD index, const D3DLIGHT9* pLight)
+{
+    if (LightCmd* c = Add<LightCmd>(SET_LIGHT))
+    {
+        c->index = index;
+        c->light = *pLight;
+    }
+}
+
+void CommandBuffer::LightEnable(DWORD index, BOOL enable)
+{
+    if (LightEnableCmd* c = Add<LightEnableCmd>(LIGHT_ENABLE))
+    {
+        c->index  = index;
+        c->enable = enable;
+    }
+}
+
+void CommandBuffer::DrawPrimitive(D3DPRIMITIVETYPE type, UINT startVertex, UINT primCount)
+{
+    if (DrawCmd* c = Add<DrawCmd>(DRAW_PRIMITIVE))
+    {
+        c->type        = type;
+        c->startVertex = startVertex;
+        c->primCount   = primCount;
+        ++m_numDraws;
+    }
+}
+
+void CommandBuffer::DrawIndexedPrimitive(D3DPRIMITIVETYPE type, INT baseVertex, UINT minIndex,
+                                         UINT numVertices, UINT startIndex, UINT primCount)
+{
+    if (DrawIndexedCmd* c = Add<DrawIndexedCmd>(DRAW_INDEXED_PRIMITIVE))
+    {
+        c->type        = type;
+        c->baseVertex  = baseVertex;
+        c->minIndex    = minIndex;
+        c->numVertices = numVertices;
+        c->startIndex  = startIndex;
+        c->primCount   = primCount;
+        ++m_numDraws;
+    }
+}
+
+void CommandBuffer::DrawSubset(ID3DXMesh* pMesh, DWORD attribute)
+{
+    if (DrawSubsetCmd* c = Add<DrawSubsetCmd>(DRAW_SUBSET))
+    {
+        c->attribute = attribute;
+        c->pMesh     = pMesh;
+        ++m_numDraws;
+    }
+}
+
+HRESULT CommandBuffer::Execute(IDirect3DDevice9* pDevice, StateCache* pCache) const
+{
+    DeviceTarget target(pDevice, pCache);
+    Replay(target);
+    return target.Result();
+}
+
+
+//===============================================================
+// CommandRecorder
+
+CommandRecorder::CommandRecorder()
+    : m_pFunction(NULL),
+      m_count(0)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+CommandRecorder::~CommandRecorder()
+{
+    Clear();
+}
+
+void CommandRecorder::SetNumRanges(unsigned numRanges)
+{
+    Clear();
+
+    if (numRanges == 0)
+        numRanges = g_jobs.NumThreads() ? g_jobs.NumThreads() : 1;
+
+    for (unsigned i = 0; i < numRanges; ++i)
+        m_buffers.push_back(new CommandBuffer());
+
+    m_stats.ranges = numRanges;
+}
+
+void CommandRecorder::Clear()
+{
+    for (size_t i = 0; i < m_buffers.size(); ++i)
+        delete m_buffers[i];
+    m_buffers.clear();
+}
+
+void CommandRecorder::RecordJob(void* pData, unsigned begin, unsigned end)
+{
+    CommandRecorder* pRecorder = static_cast<CommandRecorder*>(pData);
+    for (unsigned i = begin; i < end; ++i)
+        pRecorder->RecordRange(i);
+}
+
+void CommandRecorder::RecordRange(unsigned index)
+{
+    CommandBuffer& buffer = *m_buffers[index];
+    buffer.Reset();
+
+    unsigned n     = (unsigned)m_buffers.size();
+    unsigned begin = (unsigned)((unsigned long long)m_count * index / n);
+    unsigned end   = (unsigned)((unsigned long long)m_count * (index + 1) / n);
+    if (begin < end)
+        (*m_pFunction)(buffer, begin, end);
+}
+
+void CommandRecorder::Record(unsigned count, const RecordFunction& fn)
+{
+    if (m_buffers.empty())
+        SetNumRanges();
+
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    m_pFunction = &fn;
+    m_count     = count;
+
+    // One job per range; the caller works on them too while it waits.
+    JobCounter recorded;
+    g_jobs.ParallelFor((unsigned)m_buffers.size(), 1, RecordJob, this, &recorded);
+    g_jobs.Wait(&recorded);
+
+    m_pFunction = NULL;
+
+    m_stats.commands = 0;
+    m_stats.draws    = 0;
+    m_stats.bytes    = 0;
+    for (size_t i = 0; i < m_buffers.size(); ++i)
+    {
+        m_stats.commands += m_buffers[i]->NumCommands();
+        m_stats.draws    += m_buffers[i]->NumDraws();
+        m_stats.bytes    += m_buffers[i]->BytesUsed();
+    }
+    m_stats.recordMs = MillisecondsSince(start);
+}
+
+HRESULT CommandRecorder::Execute(IDirect3DDevice9* pDevice, StateCache* pCache)
+{
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    HRESULT result = D3D_OK;
+    for (size_t i = 0; i < m_buffers.size(); ++i)
+    {
+        HRESULT hr = m_buffers[i]->Execute(pDevice, pCache);
+        if (FAILED(hr) && SUCCEEDED(result))
+            result = hr;
+    }
+
+    m_stats.executeMs = MillisecondsSince(start);
+    return result;
+}
+
+void CommandRecorder::ReportStats(const char* name) const
+{
+    char msg[256];
+    snprintf(msg, sizeof(msg),
+             "[Commands] %s: %u ranges, last frame %u commands (%u draws, %u bytes), record %.3f ms, execute %.3f ms\n",
+             name, m_stats.ranges, m_stats.commands, m_stats.draws, (unsigned)m_stats.bytes,
+             m_stats.recordMs, m_stats.executeMs);
+#ifdef _WIN32
+    OutputDebugStringA(msg);
+#endif
+    fputs(msg, stderr);
+}
@@ -0,0 +1,350 @@
+//=============================================================================
+// CommandBuffer.h
+//
+// Deferred device commands.  D3D9 lets one thread at a time talk to the
+// device, so instead of calling it from Render() directly, any number of
+// threads record what they would have called into CommandBuffers and the
+// render thread replays them afterwards, in a fixed order.
+//
+// A CommandBuffer mirrors the device calls the samples make (state, shader
+// constants, transforms, material and lights, DrawPrimitive,
+// DrawIndexedPrimitive and ID3DXMesh::DrawSubset).  Commands are packed
+// back to back in the buffer's own LinearAllocator, so recording never
+// locks and, once the pages have grown to a frame's worth, never allocates.
+// Matrices, materials, lights and constants are copied; resources are kept
+// as raw pointers and must outlive the replay (ResourceManager keeps
+// released resources alive for FRAMES_IN_FLIGHT frames).
+//
+// CommandRecorder spreads the recording over the job system (JobSystem.h):
+// Record() splits [0, count) into contiguous ranges, one per job system
+// thread by default, runs one g_jobs job per range that records it into the
+// range's own buffer, and waits for them.  Execute() replays the buffers
+// in range order, so the device sees exactly what a serial loop over
+// [0, count) would have issued, whichever thread recorded which range.
+//=============================================================================
+
+#ifndef COMMAND_BUFFER_H
+#define COMMAND_BUFFER_H
+
+#include <d3dx9.h>
+#include "LinearAllocator.h"
+#include <vector>
+#include <functional>
+#include <cstring>
+
+class StateCache;
+
+
+namespace command_detail
+{
+    enum Type
+    {
+        SET_RENDER_STATE,
+        SET_SAMPLER_STATE,
+        SET_TEXTURE_STAGE_STATE,
+        SET_TEXTURE,
+        SET_STREAM_SOURCE,
+        SET_INDICES,
+        SET_FVF,
+        SET_VERTEX_DECLARATION,
+        SET_VERTEX_SHADER,
+        SET_PIXEL_SHADER,
+        SET_VERTEX_SHADER_CONSTANT_F,
+        SET_PIXEL_SHADER_CONSTANT_F,
+        SET_TRANSFORM,
+        SET_MATERIAL,
+        SET_LIGHT,
+        LIGHT_ENABLE,
+        DRAW_PRIMITIVE,
+        DRAW_INDEXED_PRIMITIVE,
+        DRAW_SUBSET
+    };
+
+    // Every command starts with a header and is a multiple of ALIGNMENT
+    // bytes long, so commands follow each other without padding.
+    const size_t ALIGNMENT = 8;
+
+    struct Header
+    {
+        unsigned type;
+        unsigned bytes;     // including the header and any trailing data
+    };
+
+    struct StateCmd        { Header h; DWORD stage; DWORD state; DWORD value; };
+    struct TextureCmd      { Header h; DWORD sampler; IDirect3DBaseTexture9* pTexture; };
+    struct StreamCmd       { Header h; UINT stream; UINT offset; UINT stride; IDirect3DVertexBuffer9* pVB; };
+    struct IndicesCmd      { Header h; IDirect3DIndexBuffer9* pIB; };
+    struct FvfCmd          { Header h; DWORD fvf; };
+    struct PointerCmd      { Header h; void* p; };
+    struct ConstantsCmd    { Header h; UINT first; UINT count; };      // followed by count float4s
+    struct TransformCmd    { Header h; D3DTRANSFORMSTATETYPE state; D3DMATRIX matrix; };
+    struct MaterialCmd     { Header h; D3DMATERIAL9 material; };
+    struct LightCmd        { Header h; DWORD index; D3DLIGHT9 light; };
+    struct LightEnableCmd  { Header h; DWORD index; BOOL enable; };
+    struct DrawCmd         { Header h; D3DPRIMITIVETYPE type; UINT startVertex; UINT primCount; };
+    struct DrawIndexedCmd  { Header h; D3DPRIMITIVETYPE type; INT baseVertex; UINT minIndex;
+                             UINT numVertices; UINT startIndex; UINT primCount; };
+    struct DrawSubsetCmd   { Header h; DWORD attribute; ID3DXMesh* pMesh; };
+
+    inline size_t RoundUp(size_t bytes) { return (bytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1); }
+}
+
+
+class CommandBuffer
+{
+public:
+    explicit CommandBuffer(size_t pageBytes = LinearAllocator::DEFAULT_PAGE_BYTES);
+
+    // Drops the recorded commands and keeps the memory.
+    void Reset();
+
+    // Recording; the signatures follow IDirect3DDevice9.
+    void SetRenderState(D3DRENDERSTATETYPE state, DWORD value);
+    void SetSamplerState(DWORD sampler, D3DSAMPLERSTATETYPE type, DWORD value);
+    void SetTextureStageState(DWORD stage, D3DTEXTURESTAGESTATETYPE type, DWORD value);
+    void SetTexture(DWORD sampler, IDirect3DBaseTexture9* pTexture);
+    void SetStreamSource(UINT stream, IDirect3DVertexBuffer9* pVB, UINT offset, UINT stride);
+    void SetIndices(IDirect3DIndexBuffer9* pIB);
+    void SetFVF(DWORD fvf);
+    void SetVertexDeclaration(IDirect3DVertexDeclaration9* pDecl);
+    void SetVertexShader(IDirect3DVertexShader9* pShader);
+    void SetPixelShader(IDirect3DPixelShader9* pShader);
+    void SetVertexShaderConstantF(UINT first, const float* pData, UINT count);
+    void SetPixelShaderConstantF(UINT first, const float* pData, UINT count);
+    void SetTransform(D3DTRANSFORMSTATETYPE state, const D3DMATRIX* pMatrix);
+    void SetMaterial(const D3DMATERIAL9* pMaterial);
+    void SetLight(DWORD index, const D3DLIGHT9* pLight);
+    void LightEnable(DWORD index, BOOL enable);
+    void DrawPrimitive(D3DPRIMITIVETYPE type, UINT startVertex, UINT primCount);
+    void DrawIndexedPrimitive(D3DPRIMITIVETYPE type, INT baseVertex, UINT minIndex,
+                              UINT numVertices, UINT startIndex, UINT primCount);
+    void DrawSubset(ID3DXMesh* pMesh, DWORD attribute);
+
+    unsigned NumCommands() const    { return m_numCommands; }
+    unsigned NumDraws() const       { return m_numDraws; }
+    size_t   BytesUsed() const      { return m_memory.BytesUsed(); }
+    bool     OutOfMemory() const    { return m_outOfMemory; }
+
+    // Plays the commands back in recording order.  State goes through pCache
+    // when there is one (draws always go to the device).  Returns the first
+    // failure, but keeps going after it.
+    HRESULT Execute(IDirect3DDevice9* pDevice, StateCache* pCache) const;
+
+    // Plays the commands back into anything that has the recording methods
+    // with the device signatures (DrawSubset takes the mesh first).
+    template<typename Target>
+    void Replay(Target& target) const;
+
+private:
+    CommandBuffer(const CommandBuffer&);
+    CommandBuffer& operator=(const CommandBuffer&);
+
+    template<typename T>
+    T* Add(command_detail::Type type, size_t extraBytes = 0)
+    {
+        size_t bytes = command_detail::RoundUp(sizeof(T) + extraBytes);
+        T* pCmd = static_cast<T*>(m_memory.Allocate(bytes, command_detail::ALIGNMENT));
+        if (pCmd == NULL)
+        {
+            m_outOfMemory = true;
+            return NULL;
+        }
+        pCmd->h.type  = type;
+        pCmd->h.bytes = (unsigned)bytes;
+        ++m_numCommands;
+        return pCmd;
+    }
+
+    LinearAllocator m_memory;
+    unsigned        m_numCommands;
+    unsigned        m_numDraws;
+    bool            m_outOfMemory;
+};
+
+
+template<typename Target>
+void CommandBuffer::Replay(Target& target) const
+{
+    using namespace command_detail;
+
+    for (unsigned page = 0; page < m_memory.NumPages(); ++page)
+    {
+        const char* p   = m_memory.PageData(page);
+        const char* end = p + m_memory.PageUsed(page);
+        while (p < end)
+        {
+            const Header* h = reinterpret_cast<const Header*>(p);
+            switch (h->type)
+            {
+            case SET_RENDER_STATE:
+            {
+                const StateCmd* c = reinterpret_cast<const StateCmd*>(h);
+                target.SetRenderState((D3DRENDERSTATETYPE)c->state, c->value);
+                break;
+            }
+            case SET_SAMPLER_STATE:
+            {
+                const StateCmd* c = reinterpret_cast<const StateCmd*>(h);
+                target.SetSamplerState(c->stage, (D3DSAMPLERSTATETYPE)c->state, c->value);
+                break;
+            }
+            case SET_TEXTURE_STAGE_STATE:
+            {
+                const StateCmd* c = reinterpret_cast<const StateCmd*>(h);
+                target.SetTextureStageState(c->stage, (D3DTEXTURESTAGESTATETYPE)c->state, c->value);
+                break;
+            }
+            case SET_TEXTURE:
+            {
+                const TextureCmd* c = reinterpret_cast<const TextureCmd*>(h);
+                target.SetTexture(c->sampler, c->pTexture);
+                break;
+            }
+            case SET_STREAM_SOURCE:
+            {
+                const StreamCmd* c = reinterpret_cast<const StreamCmd*>(h);
+                target.SetStreamSource(c->stream, c->pVB, c->offset, c->stride);
+                break;
+            }
+            case SET_INDICES:
+                target.SetIndices(reinterpret_cast<const IndicesCmd*>(h)->pIB);
+                break;
+            case SET_FVF:
+                target.SetFVF(reinterpret_cast<const FvfCmd*>(h)->fvf);
+                break;
+            case SET_VERTEX_DECLARATION:
+                target.SetVertexDeclaration(static_cast<IDirect3DVertexDeclaration9*>(reinterpret_cast<const PointerCmd*>(h)->p));
+                break;
+            case SET_VERTEX_SHADER:
+                target.SetVertexShader(static_cast<IDirect3DVertexShader9*>(reinterpret_cast<const PointerCmd*>(h)->p));
+                break;
+            case SET_PIXEL_SHADER:
+                target.SetPixelShader(static_cast<IDirect3DPixelShader9*>(reinterpret_cast<const PointerCmd*>(h)->p));
+                break;
+            case SET_VERTEX_SHADER_CONSTANT_F:
+            {
+                const ConstantsCmd* c = reinterpret_cast<const ConstantsCmd*>(h);
+                target.SetVertexShaderConstantF(c->first, reinterpret_cast<const float*>(c + 1), c->count);
+                break;
+            }
+            case SET_PIXEL_SHADER_CONSTANT_F:
+            {
+                const ConstantsCmd* c = reinterpret_cast<const ConstantsCmd*>(h);
+                target.SetPixelShaderConstantF(c->first, reinterpret_cast<const float*>(c + 1), c->count);
+                break;
+            }
+            case SET_TRANSFORM:
+            {
+                const TransformCmd* c = reinterpret_cast<const TransformCmd*>(h);
+                target.SetTransform(c->state, &c->matrix);
+                break;
+            }
+            case SET_MATERIAL:
+                target.SetMaterial(&reinterpret_cast<const MaterialCmd*>(h)->material);
+                break;
+            case SET_LIGHT:
+            {
+                const LightCmd* c = reinterpret_cast<const LightCmd*>(h);
+                target.SetLight(c->index, &c->light);
+                break;
+            }
+            case LIGHT_ENABLE:
+            {
+                const LightEnableCmd* c = reinterpret_cast<const LightEnableCmd*>(h);
+                target.LightEnable(c->index, c->enable);
+                break;
+            }
+            case DRAW_PRIMITIVE:
+            {
+                const DrawCmd* c = reinterpret_cast<const DrawCmd*>(h);
+                target.DrawPrimitive(c->type, c->startVertex, c->primCount);
+                break;
+            }
+            case DRAW_INDEXED_PRIMITIVE:
+            {
+                const DrawIndexedCmd* c = reinterpret_cast<const DrawIndexedCmd*>(h);
+                target.DrawIndexedPrimitive(c->type, c->baseVertex, c->minIndex,
+                                            c->numVertices, c->startIndex, c->primCount);
+                break;
+            }
+            case DRAW_SUBSET:
+            {
+                const DrawSubsetCmd* c = reinterpret_cast<const DrawSubsetCmd*>(h);
+                target.DrawSubset(c->pMesh, c->attribute);
+                break;
+            }
+            }
+            p += h->bytes;
+        }
+    }
+}
+
+
+//===============================================================
+// Records on a pool of threads, replays in order.
+
+struct CommandRecorderStats
+{
+    unsigned ranges;
+    unsigned commands;
+    unsigned draws;
+    size_t   bytes;
+    double   recordMs;      // Record(), wall clock
+    double   executeMs;     // Execute()
+};
+
+class CommandRecorder
+{
+public:
+    // Records items [begin, end) into buffer.
+    typedef std::function<void(CommandBuffer& buffer, unsigned begin, unsigned end)> RecordFunction;
+
+    CommandRecorder();
+    ~CommandRecorder();
+
+    // Number of ranges (and buffers) Record() splits the items into; 0
+    // uses one per g_jobs thread.  1 records serially on the caller.
+    // Record() calls SetNumRanges(0) if it has not been called.
+    void SetNumRanges(unsigned numRanges = 0);
+    unsigned NumRanges() const { return (unsigned)m_buffers.size(); }
+
+    // Frees the buffers.
+    void Clear();
+
+    // Resets the buffers and records [0, count) split into NumRanges()
+    // contiguous ranges, one g_jobs job each.  Must be called from a thread
+    // that may wait on g_jobs; returns when every range has been recorded.
+    void Record(unsigned count, const RecordFunction& fn);
+
+    // Replays the buffers of the last Record() in range order.
+    HRESULT Execute(IDirect3DDevice9* pDevice, StateCache* pCache);
+
+    template<typename Target>
+    void Replay(Target& target) const
+    {
+        for (size_t i = 0; i < m_buffers.size(); ++i)
+            m_buffers[i]->Replay(target);
+    }
+
+    const CommandBuffer& Buffer(unsigned i) const { return *m_buffers[i]; }
+
+    const CommandRecorderStats& Stats() const { return m_stats; }
+    void ReportStats(const char* name) const;
+
+private:
+    CommandRecorder(const CommandRecorder&);
+    CommandRecorder& operator=(const CommandRecorder&);
+
+    // JobFunction: records ranges [begin, end) of the recorder in pData.
+    static void RecordJob(void* pData, unsigned begin, unsigned end);
+    void RecordRange(unsigned index);
+
+    std::vector<CommandBuffer*> m_buffers;      // one per range
+
+    const RecordFunction*       m_pFunction;
+    unsigned                    m_count;
+
+    CommandRecorderStats        m_stats;
+};
+
+#endif // COMMAND_BUFFER_H
@@ -0,0 +1,282 @@
+//=============================================================================
+// Culling.cpp
+//=============================================================================
+
+#include "Culling.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <chrono>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+
+
+//===============================================================
+// Bounds
+
+void ComputeBounds(const void* pPositions, size_t stride, size_t count,
+                   Aabb* pBox, BoundingSphere* pSphere)
+{
+    Aabb box = Aabb::Empty();
+    const char* p = (const char*)pPositions;
+    for (size_t i = 0; i < count; ++i)
+        box.Grow(*(const Vec3*)(p + i * stride));
+
+    if (count == 0)
+        box = Aabb(Vec3(0, 0, 0), Vec3(0, 0, 0));
+
+    if (pBox)
+        *pBox = box;
+
+    if (pSphere)
+    {
+        Vec3  c = box.Center();
+        float r2 = 0.0f;
+        for (size_t i = 0; i < count; ++i)
+        {
+            Vec3  d  = *(const Vec3*)(p + i * stride) - c;
+            float d2 = Vec3Dot(d, d);
+            if (d2 > r2)
+                r2 = d2;
+        }
+        pSphere->center = c;
+        pSphere->radius = sqrtf(r2);
+    }
+}
+
+Aabb TransformAabb(const Aabb& b, const Mat4& m)
+{
+    // Centre transforms as a point, half-extents by |M| (Arvo).
+    Vec3 c = b.Center(), e = b.Extents();
+    Vec3 center(c.x * m.m[0][0] + c.y * m.m[1][0] + c.z * m.m[2][0] + m.m[3][0],
+                c.x * m.m[0][1] + c.y * m.m[1][1] + c.z * m.m[2][1] + m.m[3][1],
+                c.x * m.m[0][2] + c.y * m.m[1][2] + c.z * m.m[2][2] + m.m[3][2]);
+    Vec3 extents(e.x * fabsf(m.m[0][0]) + e.y * fabsf(m.m[1][0]) + e.z * fabsf(m.m[2][0]),
+                 e.x * fabsf(m.m[0][1]) + e.y * fabsf(m.m[1][1]) + e.z * fabsf(m.m[2][1]),
+                 e.x * fabsf(m.m[0][2]) + e.y * fabsf(m.m[1][2]) + e.z * fabsf(m.m[2][2]));
+    return Aabb(center - extents, center + extents);
+}
+
+
+//===============================================================
+// Frustum
+
+void Frustum::Extract(const Mat4& m)
+{
+    // Clip = v * M, so clip.x is v dotted with column 0, etc.
+    // Inside: -w <= x <= w, -w <= y <= w, 0 <= z <= w.
+    for (int j = 0; j < 4; ++j)
+    {
+        float x = m.m[j][0], y = m.m[j][1], z = m.m[j][2], w = m.m[j][3];
+        (&m_planes[LEFT].a)[j]       = w + x;
+        (&m_planes[RIGHT].a)[j]      = w - x;
+        (&m_planes[BOTTOM].a)[j]     = w + y;
+        (&m_planes[TOP].a)[j]        = w - y;
+        (&m_planes[NEAR_PLANE].a)[j] = z;
+        (&m_planes[FAR_PLANE].a)[j]  = w - z;
+    }
+
+    for (int i = 0; i < NUM_PLANES; ++i)
+    {
+        Plane& p   = m_planes[i];
+        float  len = sqrtf(p.a * p.a + p.b * p.b + p.c * p.c);
+        if (len > 0.0f)
+        {
+            float inv = 1.0f / len;
+            p.a *= inv; p.b *= inv; p.c *= inv; p.d *= inv;
+        }
+    }
+}
+
+bool Frustum::TestSphere(const Vec3& center, float radius) const
+{
+    for (int i = 0; i < NUM_PLANES; ++i)
+    {
+        const Plane& p = m_planes[i];
+        if (p.a * center.x + p.b * center.y + p.c * center.z + p.d < -radius)
+            return false;
+    }
+    return true;
+}
+
+bool Frustum::TestAabb(const Aabb& box) const
+{
+    Vec3 c = box.Center(), e = box.Extents();
+    for (int i = 0; i < NUM_PLANES; ++i)
+    {
+        const Plane& p = m_planes[i];
+        float r = fabsf(p.a) * e.x + fabsf(p.b) * e.y + fabsf(p.c) * e.z;
+        if (p.a * c.x + p.b * c.y + p.c * c.z + p.d < -r)
+            return false;
+    }
+    return true;
+}
+
+
+//===============================================================
+// CullBounds
+
+void CullBounds::Resize(unsigned count)
+{
+    size_t padded = (count + 7) & ~7u;
+    m_cx.resize(padded, 0.0f);
+    m_cy.resize(padded, 0.0f);
+    m_cz.resize(padded, 0.0f);
+    m_ex.resize(padded, 0.0f);
+    m_ey.resize(padded, 0.0f);
+    m_ez.resize(padded, 0.0f);
+    m_radius.resize(padded, 0.0f);
+    m_count = count;
+}
+
+unsigned CullBounds::Add(const Aabb& box)
+{
+    unsigned i = m_count;
+    Resize(m_count + 1);
+    Set(i, box);
+    return i;
+}
+
+void CullBounds::Set(unsigned i, const Aabb& box)
+{
+    Vec3 c = box.Center(), e = box.Extents();
+    m_cx[i] = c.x; m_cy[i] = c.y; m_cz[i] = c.z;
+    m_ex[i] = e.x; m_ey[i] = e.y; m_ez[i] = e.z;
+    m_radius[i] = Vec3Length(e);
+}
+
+void CullBounds::Set(unsigned i, const BoundingSphere& sphere)
+{
+    m_cx[i] = sphere.center.x; m_cy[i] = sphere.center.y; m_cz[i] = sphere.center.z;
+    m_ex[i] = m_ey[i] = m_ez[i] = sphere.radius;
+    m_radius[i] = sphere.radius;
+}
+
+unsigned CullBounds::CullBoxes(const Frustum& frustum, std::vector<unsigned>& visible)
+{
+    return Cull(frustum, true, visible);
+}
+
+unsigned CullBounds::CullSpheres(const Frustum& frustum, std::vector<unsigned>& visible)
+{
+    return Cull(frustum, false, visible);
+}
+
+unsigned CullBounds::CullBoxes(const Frustum& frustum, unsigned begin, unsigned end, std::vector<unsigned>& visible) const
+{
+    return CullRange(frustum, true, begin, end, visible);
+}
+
+unsigned CullBounds::CullSpheres(const Frustum& frustum, unsigned begin, unsigned end, std::vector<unsigned>& visible) const
+{
+    return CullRange(frustum, false, begin, end, visible);
+}
+
+namespace
+{
+    // Appends base + i for every clear bit i of the outside mask below end.
+    inline void EmitVisible(unsigned outside, unsigned lanes, unsigned base, unsigned end,
+                            std::vector<unsigned>& visible)
+    {
+        unsigned inside = ~outside & ((1u << lanes) - 1);
+        for (unsigned i = 0; inside != 0; ++i, inside >>= 1)
+        {
+            if ((inside & 1) && base + i < end)
+                visible.push_back(base + i);
+        }
+    }
+}
+
+unsigned CullBounds::Cull(const Frustum& frustum, bool boxes, std::vector<unsigned>& visible)
+{
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    visible.clear();
+    visible.reserve(m_count);
+    CullRange(frustum, boxes, 0, m_count, visible);
+
+    m_stats.tested  = m_count;
+    m_stats.visible = (unsigned)visible.size();
+    m_stats.culled  = m_count - m_stats.visible;
+    m_stats.ms      = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    return m_stats.visible;
+}
+
+unsigned CullBounds::CullRange(const Frustum& frustum, bool boxes, unsigned begin, unsigned end,
+                               std::vector<unsigned>& visible) const
+{
+    assert(begin % 8 == 0);
+    end = std::min(end, m_count);
+    size_t first = visible.size();
+
+    // Plane normals' absolute values turn the box test into a sphere test
+    // with a per-plane radius; spheres use the same loop with r fixed.
+    float pa[Frustum::NUM_PLANES], pb[Frustum::NUM_PLANES], pc[Frustum::NUM_PLANES], pd[Frustum::NUM_PLANES];
+    float aa[Frustum::NUM_PLANES], ab[Frustum::NUM_PLANES], ac[Frustum::NUM_PLANES];
+    for (int p = 0; p < Frustum::NUM_PLANES; ++p)
+    {
+        const Plane& pl = frustum.GetPlane(p);
+        pa[p] = pl.a; pb[p] = pl.b; pc[p] = pl.c; pd[p] = pl.d;
+        aa[p] = fabsf(pl.a); ab[p] = fabsf(pl.b); ac[p] = fabsf(pl.c);
+    }
+
+    unsigned i = begin;
+
+#if defined(__AVX__)
+    for (; i < end; i += 8)
+    {
+        __m256 cx = _mm256_loadu_ps(&m_cx[i]), cy = _mm256_loadu_ps(&m_cy[i]), cz = _mm256_loadu_ps(&m_cz[i]);
+        __m256 ex = _mm256_loadu_ps(&m_ex[i]), ey = _mm256_loadu_ps(&m_ey[i]), ez = _mm256_loadu_ps(&m_ez[i]);
+        __m256 rs = _mm256_loadu_ps(&m_radius[i]);
+        __m256 out = _mm256_setzero_ps();
+        for (int p = 0; p < Frustum::NUM_PLANES; ++p)
+        {
+            __m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(cx, _mm256_set1_ps(pa[p])),
+                                                   _mm256_mul_ps(cy, _mm256_set1_ps(pb[p]))),
+                                     _mm256_add_ps(_mm256_mul_ps(cz, _mm256_set1_ps(pc[p])),
+                                                   _mm256_set1_ps(pd[p])));
+            __m256 r = boxes ? _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ex, _mm256_set1_ps(aa[p])),
+                                                           _mm256_mul_ps(ey, _mm256_set1_ps(ab[p]))),
+                                             _mm256_mul_ps(ez, _mm256_set1_ps(ac[p])))
+                             : rs;
+            out = _mm256_or_ps(out, _mm256_cmp_ps(_mm256_add_ps(d, r), _mm256_setzero_ps(), _CMP_LT_OQ));
+        }
+        EmitVisible((unsigned)_mm256_movemask_ps(out), 8, i, end, visible);
+    }
+#elif defined(MATH3D_SSE)
+    for (; i < end; i += 4)
+    {
+        __m128 cx = _mm_loadu_ps(&m_cx[i]), cy = _mm_loadu_ps(&m_cy[i]), cz = _mm_loadu_ps(&m_cz[i]);
+        __m128 ex = _mm_loadu_ps(&m_ex[i]), ey = _mm_loadu_ps(&m_ey[i]), ez = _mm_loadu_ps(&m_ez[i]);
+        __m128 rs = _mm_loadu_ps(&m_radius[i]);
+        __m128 out = _mm_setzero_ps();
+        for (int p = 0; p < Frustum::NUM_PLANES; ++p)
+        {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(cx, _mm_set1_ps(pa[p])), _mm_mul_ps(cy, _mm_set1_ps(pb[p]))),
+                                  _mm_add_ps(_mm_mul_ps(cz, _mm_set1_ps(pc[p])), _mm_set1_ps(pd[p])));
+            __m128 r = boxes ? _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(aa[p])), _mm_mul_ps(ey, _mm_set1_ps(ab[p]))),
+                                          _mm_mul_ps(ez, _mm_set1_ps(ac[p])))
+                             : rs;
+            out = _mm_or_ps(out, _mm_cmplt_ps(_mm_add_ps(d, r), _mm_setzero_ps()));
+        }
+        EmitVisible((unsigned)_mm_movemask_ps(out), 4, i, end, visible);
+    }
+#else
+    for (; i < end; ++i)
+    {
+        bool outside = false;
+        for (int p = 0; p < Frustum::NUM_PLANES && !outside; ++p)
+        {
+            float d = m_cx[i] * pa[p] + m_cy[i] * pb[p] + m_cz[i] * pc[p] + pd[p];
+            float r = boxes ? m_ex[i] * aa[p] + m_ey[i] * ab[p] + m_ez[i] * ac[p] : m_radius[i];
+            outside = d + r < 0.0f;
+        }
+        if (!outside)
+            visible.push_back(i);
+    }
+#endif
+
+    return (unsigned)(visible.size() - first);
+}
@@ -0,0 +1,137 @@
+//=============================================================================
+// Culling.h
+//
+// Bounding volumes and view-frustum culling.
+//
+// Frustum extracts the six planes straight from a view-projection matrix
+// (D3D clip space, 0 <= z <= w), so it works for any camera and projection.
+// CullBounds keeps boxes as centre/half-extent and spheres as centre/radius
+// in structure-of-arrays form and tests them against the planes 4 at a time
+// with SSE2, or 8 at a time when compiled with AVX (/arch:AVX, -mavx).
+// Bounds that straddle a plane count as visible.
+//=============================================================================
+
+#ifndef CULLING_H
+#define CULLING_H
+
+#include "Math3D.h"
+#include <vector>
+
+
+struct Aabb
+{
+    Vec3 min, max;
+
+    Aabb() {}
+    Aabb(const Vec3& min_, const Vec3& max_) : min(min_), max(max_) {}
+
+    Vec3 Center() const  { return (min + max) * 0.5f; }
+    Vec3 Extents() const { return (max - min) * 0.5f; }
+    bool IsEmpty() const { return min.x > max.x; }
+
+    // An empty box that any Grow() replaces.
+    static Aabb Empty()
+    {
+        return Aabb(Vec3(1e30f, 1e30f, 1e30f), Vec3(-1e30f, -1e30f, -1e30f));
+    }
+
+    void Grow(const Vec3& p)    { min = Vec3Min(min, p); max = Vec3Max(max, p); }
+    void Grow(const Aabb& b)    { min = Vec3Min(min, b.min); max = Vec3Max(max, b.max); }
+};
+
+struct BoundingSphere
+{
+    Vec3  center;
+    float radius;
+};
+
+// Box and sphere around count positions read with the given byte stride.
+// The sphere is centred on the box and just encloses every point.
+void ComputeBounds(const void* pPositions, size_t stride, size_t count,
+                   Aabb* pBox, BoundingSphere* pSphere);
+
+// Box around the box b transformed by m (exact for the corners' hull).
+Aabb TransformAabb(const Aabb& b, const Mat4& m);
+
+
+//===============================================================
+// Frustum
+
+struct Plane
+{
+    float a, b, c, d;   // inside when a*x + b*y + c*z + d >= 0
+};
+
+class Frustum
+{
+public:
+    enum { LEFT, RIGHT, BOTTOM, TOP, NEAR_PLANE, FAR_PLANE, NUM_PLANES };
+
+    Frustum() {}
+    explicit Frustum(const Mat4& viewProj) { Extract(viewProj); }
+
+    // Planes in the space the matrix maps from: world space for
+    // view * proj, object space for world * view * proj.
+    void Extract(const Mat4& viewProj);
+
+    const Plane& GetPlane(int i) const { return m_planes[i]; }
+
+    bool TestSphere(const Vec3& center, float radius) const;
+    bool TestAabb(const Aabb& box) const;
+
+private:
+    Plane m_planes[NUM_PLANES];
+};
+
+
+//===============================================================
+// Batched culling
+
+struct CullStats
+{
+    unsigned tested;
+    unsigned visible;
+    unsigned culled;
+    double   ms;            // time spent in the last Cull*() call
+};
+
+class CullBounds
+{
+public:
+    CullBounds() : m_count(0) {}
+
+    void     Clear()       { m_count = 0; }
+    unsigned Size() const  { return m_count; }
+    void     Resize(unsigned count);
+
+    unsigned Add(const Aabb& box);
+    void     Set(unsigned i, const Aabb& box);
+    void     Set(unsigned i, const BoundingSphere& sphere);
+
+    // Appends the indices of the bounds at least partly inside the frustum
+    // to visible (which is cleared first) and returns how many there are.
+    unsigned CullBoxes(const Frustum& frustum, std::vector<unsigned>& visible);
+    unsigned CullSpheres(const Frustum& frustum, std::vector<unsigned>& visible);
+
+    // Range forms for splitting the work across threads: test [begin, end)
+    // only, append to visible without clearing it and leave Stats() alone.
+    // begin must be a multiple of 8.
+    unsigned CullBoxes(const Frustum& frustum, unsigned begin, unsigned end, std::vector<unsigned>& visible) const;
+    unsigned CullSpheres(const Frustum& frustum, unsigned begin, unsigned end, std::vector<unsigned>& visible) const;
+
+    const CullStats& Stats() const { return m_stats; }
+
+private:
+    unsigned Cull(const Frustum& frustum, bool boxes, std::vector<unsigned>& visible);
+    unsigned CullRange(const Frustum& frustum, bool boxes, unsigned begin, unsigned end,
+                       std::vector<unsigned>& visible) const;
+
+    // Padded to a multiple of 8 so the SIMD loops never need a tail.
+    std::vector<float> m_cx, m_cy, m_cz;
+    std::vector<float> m_ex, m_ey, m_ez;
+    std::vector<float> m_radius;
+    unsigned           m_count;
+    CullStats          m_stats;
+};
+
+#endif // CULLING_H
@@ -0,0 +1,572 @@
+//=============================================================================
+// DeviceCapture.cpp
+//=============================================================================
+
+#include "DeviceCapture.h"
+#include "Lz4.h"
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define snprintf _snprintf
+#endif
+
+
+// The format repeats these D3D9 structures field for field.
+static_assert(sizeof(D3DMATRIX) == 16 * sizeof(float), "D3DMATRIX layout");
+static_assert(sizeof(D3DMATERIAL9) == sizeof(CaptureMaterial), "D3DMATERIAL9 layout");
+static_assert(sizeof(D3DLIGHT9) == sizeof(CaptureLight), "D3DLIGHT9 layout");
+static_assert(sizeof(D3DVERTEXELEMENT9) == sizeof(CaptureVertexElement), "D3DVERTEXELEMENT9 layout");
+static_assert(sizeof(D3DXATTRIBUTERANGE) == sizeof(CaptureAttributeRange), "D3DXATTRIBUTERANGE layout");
+
+// Records are packed into chunks of about this size.
+static const size_t CHUNK_BYTES = 256 * 1024;
+
+DeviceCapture g_capture;
+
+
+DeviceCapture::DeviceCapture()
+    : m_pFile(NULL), m_maxFrames(0), m_pendingBytes(0), m_nextId(1)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+DeviceCapture::~DeviceCapture()
+{
+    End();
+}
+
+bool DeviceCapture::Begin(const char* path, unsigned maxFrames)
+{
+    End();
+
+    m_pFile = fopen(path, "wb");
+    if (m_pFile == NULL)
+        return false;
+
+    // Rewritten with the totals by End().
+    CaptureFileHeader header;
+    memset(&header, 0, sizeof(header));
+    fwrite(&header, sizeof(header), 1, m_pFile);
+
+    m_path         = path;
+    m_maxFrames    = maxFrames;
+    m_pendingBytes = 0;
+    m_ids.clear();
+    m_nextId       = 1;
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_stats.fileBytes = sizeof(header);
+    return true;
+}
+
+bool DeviceCapture::BeginFromCommandLine(const char* cmdLine)
+{
+    const char* p = cmdLine ? strstr(cmdLine, "-capture ") : NULL;
+    if (p == NULL)
+        return false;
+
+    // The file name runs to the next space, or to the closing quote.
+    p += strlen("-capture ");
+    while (*p == ' ')
+        ++p;
+    std::string path;
+    if (*p == '"')
+    {
+        const char* end = strchr(p + 1, '"');
+        path.assign(p + 1, end ? end : p + strlen(p));
+    }
+    else
+    {
+        const char* end = strchr(p, ' ');
+        path.assign(p, end ? end : p + strlen(p));
+    }
+
+    unsigned frames = 0;
+    if (const char* f = strstr(cmdLine, "-captureframes "))
+        frames = (unsigned)atoi(f + strlen("-captureframes "));
+
+    return !path.empty() && Begin(path.c_str(), frames);
+}
+
+void DeviceCapture::End()
+{
+    if (m_pFile == NULL)
+        return;
+
+    FlushChunk();
+
+    CaptureFileHeader header;
+    memcpy(header.magic, "D9CP", 4);
+    header.version  = CAPTURE_VERSION;
+    header.frames   = m_stats.frames;
+    header.records  = m_stats.records;
+    header.rawBytes = (unsigned)m_stats.rawBytes;
+    fseek(m_pFile, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, m_pFile);
+    fclose(m_pFile);
+    m_pFile = NULL;
+
+    ReportStats();
+
+    m_ids.clear();
+    m_pending.clear();
+    m_packed.clear();
+}
+
+
+//===============================================================
+// Records
+
+void* DeviceCapture::Add(CaptureRecordType type, size_t bytes)
+{
+    // Chunks end between records, so a record never straddles two.
+    if (m_pendingBytes >= CHUNK_BYTES)
+        FlushChunk();
+
+    size_t total = CaptureRecordBytes((unsigned)bytes);
+    m_pending.resize((m_pendingBytes + total) / 4);
+    char* p = reinterpret_cast<char*>(&m_pending[0]) + m_pendingBytes;
+    memset(p + total - 4, 0, 4);        // padding
+
+    CaptureRecordHeader* h = reinterpret_cast<CaptureRecordHeader*>(p);
+    h->type  = type;
+    h->bytes = (unsigned)bytes;
+
+    m_pendingBytes   += total;
+    m_stats.rawBytes += total;
+    ++m_stats.records;
+    return h + 1;
+}
+
+void DeviceCapture::Write(CaptureRecordType type, const void* pPayload, size_t bytes)
+{
+    memcpy(Add(type, bytes), pPayload, bytes);
+}
+
+void DeviceCapture::FlushChunk()
+{
+    if (m_pFile == NULL || m_pendingBytes == 0)
+        return;
+
+    const char* pRaw = reinterpret_cast<const char*>(&m_pending[0]);
+    m_packed.resize(Lz4CompressBound(m_pendingBytes));
+    size_t packed = Lz4Compress(pRaw, m_pendingBytes, &m_packed[0], m_packed.size());
+
+    CaptureChunkHeader chunk;
+    chunk.rawBytes = (unsigned)m_pendingBytes;
+    if (packed == 0 || packed >= m_pendingBytes)
+    {
+        chunk.packedBytes = chunk.rawBytes;
+        fwrite(&chunk, sizeof(chunk), 1, m_pFile);
+        fwrite(pRaw, 1, m_pendingBytes, m_pFile);
+    }
+    else
+    {
+        chunk.packedBytes = (unsigned)packed;
+        fwrite(&chunk, sizeof(chunk), 1, m_pFile);
+        fwrite(&m_packed[0], 1, packed, m_pFile);
+    }
+    m_stats.fileBytes += sizeof(chunk) + chunk.packedBytes;
+    m_pendingBytes = 0;
+}
+
+unsigned DeviceCapture::Id(const void* p, bool* pNew)
+{
+    if (pNew)
+        *pNew = false;
+    if (p == NULL)
+        return 0;
+
+    std::map<const void*, unsigned>::iterator it = m_ids.find(p);
+    if (it != m_ids.end())
+        return it->second;
+
+    if (pNew)
+        *pNew = true;
+    return m_ids[p] = m_nextId++;
+}
+
+
+//===============================================================
+// Objects, described on first use
+
+unsigned DeviceCapture::VertexBufferId(IDirect3DVertexBuffer9* pVB)
+{
+    bool isNew;
+    unsigned id = Id(pVB, &isNew);
+    if (isNew)
+    {
+        D3DVERTEXBUFFER_DESC desc;
+        memset(&desc, 0, sizeof(desc));
+        pVB->GetDesc(&desc);
+        CaptureVertexBuffer c = { id, desc.Size, desc.FVF };
+        Write(CAPTURE_VERTEX_BUFFER, &c, sizeof(c));
+    }
+    return id;
+}
+
+unsigned DeviceCapture::IndexBufferId(IDirect3DIndexBuffer9* pIB)
+{
+    bool isNew;
+    unsigned id = Id(pIB, &isNew);
+    if (isNew)
+    {
+        D3DINDEXBUFFER_DESC desc;
+        memset(&desc, 0, sizeof(desc));
+        pIB->GetDesc(&desc);
+        CaptureIndexBuffer c = { id, desc.Size, desc.Format == D3DFMT_INDEX32 ? 4u : 2u };
+        Write(CAPTURE_INDEX_BUFFER, &c, sizeof(c));
+    }
+    return id;
+}
+
+void DeviceCapture::BufferData(IDirect3DVertexBuffer9* pVB, UINT offset, const void* pData, UINT bytes, DWORD lockFlags)
+{
+    if (m_pFile == NULL || pVB == NULL)
+        return;
+
+    unsigned id = VertexBufferId(pVB);
+    CaptureBufferData* c = static_cast<CaptureBufferData*>(Add(CAPTURE_BUFFER_DATA, sizeof(CaptureBufferData) + bytes));
+    c->id        = id;
+    c->offset    = offset;
+    c->bytes     = bytes;
+    c->lockFlags = lockFlags;
+    memcpy(c + 1, pData, bytes);
+    m_stats.bufferBytes += bytes;
+}
+
+void DeviceCapture::BufferData(IDirect3DIndexBuffer9* pIB, UINT offset, const void* pData, UINT bytes, DWORD lockFlags)
+{
+    if (m_pFile == NULL || pIB == NULL)
+        return;
+
+    unsigned id = IndexBufferId(pIB);
+    CaptureBufferData* c = static_cast<CaptureBufferData*>(Add(CAPTURE_BUFFER_DATA, sizeof(CaptureBufferData) + bytes));
+    c->id        = id;
+    c->offset    = offset;
+    c->bytes     = bytes;
+    c->lockFlags = lockFlags;
+    memcpy(c + 1, pData, bytes);
+    m_stats.bufferBytes += bytes;
+}
+
+
+//===============================================================
+// Device calls
+
+void DeviceCapture::Clear(DWORD flags, D3DCOLOR color, float z, DWORD stencil)
+{
+    CaptureClear c = { flags, color, z, stencil };
+    Write(CAPTURE_CLEAR, &c, sizeof(c));
+}
+
+void DeviceCapture::SetRenderState(D3DRENDERSTATETYPE state, DWORD value)
+{
+    CaptureState c = { (unsigned)state, value };
+    Write(CAPTURE_SET_RENDER_STATE, &c, sizeof(c));
+}
+
+void DeviceCapture::SetSamplerState(DWORD sampler, D3DSAMPLERSTATETYPE type, DWORD value)
+{
+    CaptureStageState c = { sampler, (unsigned)type, value };
+    Write(CAPTURE_SET_SAMPLER_STATE, &c, sizeof(c));
+}
+
+void DeviceCapture::SetTextureStageState(DWORD stage, D3DTEXTURESTAGESTATETYPE type, DWORD value)
+{
+    CaptureStageState c = { stage, (unsigned)type, value };
+    Write(CAPTURE_SET_TEXTURE_STAGE_STATE, &c, sizeof(c));
+}
+
+void DeviceCapture::SetTexture(DWORD sampler, IDirect3DBaseTexture9* pTexture)
+{
+    CaptureSetTexture c = { sampler, Id(pTexture) };
+    Write(CAPTURE_SET_TEXTURE, &c, sizeof(c));
+}
+
+void DeviceCapture::SetStreamSource(UINT stream, IDirect3DVertexBuffer9* pVB, UINT offset, UINT stride)
+{
+    CaptureStreamSource c = { stream, pVB ? VertexBufferId(pVB) : 0, offset, stride };
+    Write(CAPTURE_SET_STREAM_SOURCE, &c, sizeof(c));
+}
+
+void DeviceCapture::SetStreamSourceFreq(UINT stream, UINT setting)
+{
+    CaptureState c = { stream, setting };
+    Write(CAPTURE_SET_STREAM_SOURCE_FREQ, &c, sizeof(c));
+}
+
+void DeviceCapture::SetIndices(IDirect3DIndexBuffer9* pIB)
+{
+    CaptureObject c = { pIB ? IndexBufferId(pIB) : 0 };
+    Write(CAPTURE_SET_INDICES, &c, sizeof(c));
+}
+
+void DeviceCapture::SetFVF(DWORD fvf)
+{
+    CaptureState c = { 0, fvf };
+    Write(CAPTURE_SET_FVF, &c, sizeof(c));
+}
+
+void DeviceCapture::SetVertexDeclaration(IDirect3DVertexDeclaration9* pDecl)
+{
+    bool isNew;
+    CaptureObject c = { Id(pDecl, &isNew) };
+    if (isNew)
+    {
+        UINT count = 0;
+        pDecl->GetDeclaration(NULL, &count);
+        std::vector<D3DVERTEXELEMENT9> elements(count ? count : 1);
+        pDecl->GetDeclaration(&elements[0], &count);
+
+        CaptureDeclaration* d = static_cast<CaptureDeclaration*>(
+            Add(CAPTURE_DECLARATION, sizeof(CaptureDeclaration) + count * sizeof(CaptureVertexElement)));
+        d->id    = c.id;
+        d->count = count;
+        memcpy(d + 1, &elements[0], count * sizeof(CaptureVertexElement));
+    }
+    Write(CAPTURE_SET_VERTEX_DECLARATION, &c, sizeof(c));
+}
+
+// The bytecode of a shader, the first time it is bound.
+template<typename TShader>
+static void GetShaderFunction(TShader* pShader, std::vector<char>& tokens)
+{
+    UINT bytes = 0;
+    pShader->GetFunction(NULL, &bytes);
+    tokens.resize(bytes & ~3u);
+    if (!tokens.empty())
+        pShader->GetFunction(&tokens[0], &bytes);
+}
+
+void DeviceCapture::SetVertexShader(IDirect3DVertexShader9* pShader)
+{
+    bool isNew;
+    CaptureObject c = { Id(pShader, &isNew) };
+    if (isNew)
+    {
+        std::vector<char> tokens;
+        GetShaderFunction(pShader, tokens);
+        CaptureShader* s = static_cast<CaptureShader*>(Add(CAPTURE_SHADER, sizeof(CaptureShader) + tokens.size()));
+        s->id          = c.id;
+        s->pixelShader = 0;
+        s->bytes       = (unsigned)tokens.size();
+        if (!tokens.empty())
+            memcpy(s + 1, &tokens[0], tokens.size());
+    }
+    Write(CAPTURE_SET_VERTEX_SHADER, &c, sizeof(c));
+}
+
+void DeviceCapture::SetPixelShader(IDirect3DPixelShader9* pShader)
+{
+    bool isNew;
+    CaptureObject c = { Id(pShader, &isNew) };
+    if (isNew)
+    {
+        std::vector<char> tokens;
+        GetShaderFunction(pShader, tokens);
+        CaptureShader* s = static_cast<CaptureShader*>(Add(CAPTURE_SHADER, sizeof(CaptureShader) + tokens.size()));
+        s->id          = c.id;
+        s->pixelShader = 1;
+        s->bytes       = (unsigned)tokens.size();
+        if (!tokens.empty())
+            memcpy(s + 1, &tokens[0], tokens.size());
+    }
+    Write(CAPTURE_SET_PIXEL_SHADER, &c, sizeof(c));
+}
+
+void DeviceCapture::SetVertexShaderConstantF(UINT first, const float* pData, UINT count)
+{
+    CaptureConstants* c = static_cast<CaptureConstants*>(
+        Add(CAPTURE_SET_VERTEX_SHADER_CONSTANT_F, sizeof(CaptureConstants) + count * 4 * sizeof(float)));
+    c->first = first;
+    c->count = count;
+    memcpy(c + 1, pData, count * 4 * sizeof(float));
+}
+
+void DeviceCapture::SetPixelShaderConstantF(UINT first, const float* pData, UINT count)
+{
+    CaptureConstants* c = static_cast<CaptureConstants*>(
+        Add(CAPTURE_SET_PIXEL_SHADER_CONSTANT_F, sizeof(CaptureConstants) + count * 4 * sizeof(float)));
+    c->first = first;
+    c->count = count;
+    memcpy(c + 1, pData, count * 4 * sizeof(float));
+}
+
+void DeviceCapture::SetTransform(D3DTRANSFORMSTATETYPE state, const D3DMATRIX* pMatrix)
+{
+    CaptureTransform c;
+    c.state = (unsigned)state;
+    memcpy(c.m, pMatrix, sizeof(c.m));
+    Write(CAPTURE_SET_TRANSFORM, &c, sizeof(c));
+}
+
+void DeviceCapture::SetMaterial(const D3DMATERIAL9* pMaterial)
+{
+    Write(CAPTURE_SET_MATERIAL, pMaterial, sizeof(CaptureMaterial));
+}
+
+void DeviceCapture::SetLight(DWORD index, const D3DLIGHT9* pLight)
+{
+    CaptureSetLight c;
+    c.index = index;
+    memcpy(&c.light, pLight, sizeof(c.light));
+    Write(CAPTURE_SET_LIGHT, &c, sizeof(c));
+}
+
+void DeviceCapture::LightEnable(DWORD index, BOOL enable)
+{
+    CaptureState c = { index, enable ? 1u : 0u };
+    Write(CAPTURE_LIGHT_ENABLE, &c, sizeof(c));
+}
+
+void DeviceCapture::SetViewport(const D3DVIEWPORT9* pViewport)
+{
+    CaptureViewport c = { pViewport->X, pViewport->Y, pViewport->Width, pViewport->Height,
+                          pViewport->MinZ, pViewport->MaxZ };
+    Write(CAPTURE_SET_VIEWPORT, &c, sizeof(c));
+}
+
+void DeviceCapture::SetScissorRect(const RECT* pRect)
+{
+    CaptureRect c = { (int)pRect->left, (int)pRect->top, (int)pRect->right, (int)pRect->bottom };
+    Write(CAPTURE_SET_SCISSOR_RECT, &c, sizeof(c));
+}
+
+void DeviceCapture::SetClipPlane(DWORD index, const float* pPlane)
+{
+    CaptureClipPlane c;
+    c.index = index;
+    memcpy(c.plane, pPlane, sizeof(c.plane));
+    Write(CAPTURE_SET_CLIP_PLANE, &c, sizeof(c));
+}
+
+void DeviceCapture::SetMatrix(ID3DXEffect* pEffect, D3DXHANDLE hParameter, const D3DXMATRIX* pMatrices, UINT count)
+{
+    if (m_pFile == NULL)
+        return;
+
+    D3DXPARAMETER_DESC desc;
+    const char* name = SUCCEEDED(pEffect->GetParameterDesc(hParameter, &desc)) && desc.Name ? desc.Name : "";
+    size_t nameBytes = strlen(name) + 1;
+    size_t matrixBytes = count * 16 * sizeof(float);
+
+    CaptureSetMatrix* c = static_cast<CaptureSetMatrix*>(
+        Add(CAPTURE_SET_MATRIX, sizeof(CaptureSetMatrix) + matrixBytes + nameBytes));
+    c->effect    = Id(pEffect);
+    c->count     = count;
+    c->nameBytes = (unsigned)nameBytes;
+    memcpy(c + 1, pMatrices, matrixBytes);
+    memcpy(reinterpret_cast<char*>(c + 1) + matrixBytes, name, nameBytes);
+}
+
+void DeviceCapture::DrawPrimitive(D3DPRIMITIVETYPE type, UINT startVertex, UINT primCount)
+{
+    CaptureDrawPrimitive c = { (unsigned)type, startVertex, primCount };
+    Write(CAPTURE_DRAW_PRIMITIVE, &c, sizeof(c));
+    ++m_stats.draws;
+}
+
+void DeviceCapture::DrawIndexedPrimitive(D3DPRIMITIVETYPE type, INT baseVertex, UINT minIndex,
+                                         UINT numVertices, UINT startIndex, UINT primCount)
+{
+    CaptureDrawIndexed c = { (unsigned)type, baseVertex, minIndex, numVertices, startIndex, primCount };
+    Write(CAPTURE_DRAW_INDEXED_PRIMITIVE, &c, sizeof(c));
+    ++m_stats.draws;
+}
+
+void DeviceCapture::DrawSubset(ID3DXMesh* pMesh, DWORD attribute)
+{
+    bool isNew;
+    CaptureDrawSubset c = { Id(pMesh, &isNew), attribute };
+    if (isNew)
+    {
+        // The mesh's own buffers are not reachable through the state the
+        // samples set, so they get ids of their own here.
+        CaptureMesh m;
+        m.id           = c.mesh;
+        m.vertexBuffer = m_nextId++;
+        m.indexBuffer  = m_nextId++;
+        m.fvf          = pMesh->GetFVF();
+        m.stride       = pMesh->GetNumBytesPerVertex();
+
+        unsigned vertexBytes = pMesh->GetNumVertices() * m.stride;
+        unsigned indexSize   = (pMesh->GetOptions() & D3DXMESH_32BIT) ? 4 : 2;
+        unsigned indexBytes  = pMesh->GetNumFaces() * 3 * indexSize;
+
+        CaptureVertexBuffer vb = { m.vertexBuffer, vertexBytes, m.fvf };
+        CaptureIndexBuffer  ib = { m.indexBuffer, indexBytes, indexSize };
+        Write(CAPTURE_VERTEX_BUFFER, &vb, sizeof(vb));
+        Write(CAPTURE_INDEX_BUFFER, &ib, sizeof(ib));
+
+        void* pData = NULL;
+        if (SUCCEEDED(pMesh->LockVertexBuffer(D3DLOCK_READONLY, &pData)))
+        {
+            CaptureBufferData* d = static_cast<CaptureBufferData*>(Add(CAPTURE_BUFFER_DATA, sizeof(CaptureBufferData) + vertexBytes));
+            d->id = m.vertexBuffer; d->offset = 0; d->bytes = vertexBytes; d->lockFlags = 0;
+            memcpy(d + 1, pData, vertexBytes);
+            pMesh->UnlockVertexBuffer();
+            m_stats.bufferBytes += vertexBytes;
+        }
+        if (SUCCEEDED(pMesh->LockIndexBuffer(D3DLOCK_READONLY, &pData)))
+        {
+            CaptureBufferData* d = static_cast<CaptureBufferData*>(Add(CAPTURE_BUFFER_DATA, sizeof(CaptureBufferData) + indexBytes));
+            d->id = m.indexBuffer; d->offset = 0; d->bytes = indexBytes; d->lockFlags = 0;
+            memcpy(d + 1, pData, indexBytes);
+            pMesh->UnlockIndexBuffer();
+            m_stats.bufferBytes += indexBytes;
+        }
+
+        // Meshes loaded from .x files come with an attribute table; one
+        // without gets a single range over the whole mesh.
+        DWORD numRanges = 0;
+        pMesh->GetAttributeTable(NULL, &numRanges);
+        std::vector<D3DXATTRIBUTERANGE> ranges(numRanges ? numRanges : 1);
+        if (numRanges == 0)
+        {
+            D3DXATTRIBUTERANGE all = { 0, 0, pMesh->GetNumFaces(), 0, pMesh->GetNumVertices() };
+            ranges[0] = all;
+        }
+        else
+            pMesh->GetAttributeTable(&ranges[0], &numRanges);
+
+        m.numRanges = (unsigned)ranges.size();
+        CaptureMesh* pm = static_cast<CaptureMesh*>(Add(CAPTURE_MESH, sizeof(CaptureMesh) + ranges.size() * sizeof(CaptureAttributeRange)));
+        *pm = m;
+        memcpy(pm + 1, &ranges[0], ranges.size() * sizeof(CaptureAttributeRange));
+    }
+    Write(CAPTURE_DRAW_SUBSET, &c, sizeof(c));
+    ++m_stats.draws;
+}
+
+void DeviceCapture::EndFrame()
+{
+    if (m_pFile == NULL)
+        return;
+
+    CaptureFrame c = { m_stats.frames };
+    Write(CAPTURE_FRAME, &c, sizeof(c));
+    ++m_stats.frames;
+
+    if (m_maxFrames != 0 && m_stats.frames >= m_maxFrames)
+        End();
+}
+
+
+void DeviceCapture::ReportStats() const
+{
+    char msg[512];
+    snprintf(msg, sizeof(msg),
+             "[Capture] %s: %u frames, %u records, %u draws, %.1f KB of buffer data, "
+             "%.1f KB written (%.1f KB unpacked)\n",
+             m_path.c_str(), m_stats.frames, m_stats.records, m_stats.draws, m_stats.bufferBytes / 1024.0,
+             m_stats.fileBytes / 1024.0, m_stats.rawBytes / 1024.0);
+#ifdef _WIN32
+    OutputDebugStringA(msg);
+#endif
+    fputs(msg, stderr);
+}
@@ -0,0 +1,143 @@
+//=============================================================================
+// DeviceCapture.h
+//
+// Records what the samples send to the device into a capture file
+// (CaptureFormat.h), so a frame sequence can be replayed later without the
+// sample: as a benchmark, for a regression test, or to look at what was
+// actually drawn (Tools/CaptureReplay).
+//
+// The calls come from the places every sample already goes through:
+//
+//     StateCache          state that reaches the device, Clear and draws;
+//                         effects reach it as their state manager, so
+//                         their shaders and constants are captured too
+//     EffectConstantBuffer  SetMatrix/SetMatrixArray on the effect
+//     DynamicBuffer       Lock()/Unlock() contents
+//
+// plus BufferData() next to the samples' own Lock()/Unlock() of static
+// buffers and EndFrame() after Present().  Buffers, shaders, vertex
+// declarations and meshes are written out the first time they are used;
+// textures are recorded by id only.  Everything the state cache forwards
+// is recorded except the N-patch mode, which no reader can draw.
+//
+// A sample captures when started with "-capture file.d9c" (and optionally
+// "-captureframes N"):
+//
+//     g_capture.BeginFromCommandLine( GetCommandLineA() );
+//
+// Start before the device is created (the state cache forwards everything
+// after Attach()), so the capture sees the full state.  Recording is not
+// thread safe; it happens on the render thread, like the device calls.
+//=============================================================================
+
+#ifndef DEVICE_CAPTURE_H
+#define DEVICE_CAPTURE_H
+
+#include <d3dx9.h>
+#include "CaptureFormat.h"
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+
+struct DeviceCaptureStats
+{
+    unsigned           frames;
+    unsigned           records;
+    unsigned           draws;
+    unsigned long long rawBytes;        // record stream
+    unsigned long long fileBytes;       // after compression
+    unsigned long long bufferBytes;     // buffer contents recorded
+};
+
+
+class DeviceCapture
+{
+public:
+    DeviceCapture();
+    ~DeviceCapture();
+
+    // Starts writing to path.  maxFrames 0 records until End().
+    bool Begin(const char* path, unsigned maxFrames = 0);
+
+    // Begin() with the arguments of "-capture file [-captureframes N]" in
+    // cmdLine; false if there is no -capture or the file cannot be created.
+    bool BeginFromCommandLine(const char* cmdLine);
+
+    // Writes what is left and closes the file.
+    void End();
+
+    bool IsRecording() const { return m_pFile != NULL; }
+
+    // Device calls, with the device signatures.
+    void Clear(DWORD flags, D3DCOLOR color, float z, DWORD stencil);
+    void SetRenderState(D3DRENDERSTATETYPE state, DWORD value);
+    void SetSamplerState(DWORD sampler, D3DSAMPLERSTATETYPE type, DWORD value);
+    void SetTextureStageState(DWORD stage, D3DTEXTURESTAGESTATETYPE type, DWORD value);
+    void SetTexture(DWORD sampler, IDirect3DBaseTexture9* pTexture);
+    void SetStreamSource(UINT stream, IDirect3DVertexBuffer9* pVB, UINT offset, UINT stride);
+    void SetStreamSourceFreq(UINT stream, UINT setting);
+    void SetIndices(IDirect3DIndexBuffer9* pIB);
+    void SetFVF(DWORD fvf);
+    void SetVertexDeclaration(IDirect3DVertexDeclaration9* pDecl);
+    void SetVertexShader(IDirect3DVertexShader9* pShader);
+    void SetPixelShader(IDirect3DPixelShader9* pShader);
+    void SetVertexShaderConstantF(UINT first, const float* pData, UINT count);
+    void SetPixelShaderConstantF(UINT first, const float* pData, UINT count);
+    void SetTransform(D3DTRANSFORMSTATETYPE state, const D3DMATRIX* pMatrix);
+    void SetMaterial(const D3DMATERIAL9* pMaterial);
+    void SetLight(DWORD index, const D3DLIGHT9* pLight);
+    void LightEnable(DWORD index, BOOL enable);
+    void SetViewport(const D3DVIEWPORT9* pViewport);
+    void SetScissorRect(const RECT* pRect);
+    void SetClipPlane(DWORD index, const float* pPlane);
+    void DrawPrimitive(D3DPRIMITIVETYPE type, UINT startVertex, UINT primCount);
+    void DrawIndexedPrimitive(D3DPRIMITIVETYPE type, INT baseVertex, UINT minIndex,
+                              UINT numVertices, UINT startIndex, UINT primCount);
+    void DrawSubset(ID3DXMesh* pMesh, DWORD attribute);
+
+    // ID3DXEffect::SetMatrix (count 1) and SetMatrixArray.
+    void SetMatrix(ID3DXEffect* pEffect, D3DXHANDLE hParameter, const D3DXMATRIX* pMatrices, UINT count = 1);
+
+    // What was written between Lock() and Unlock(); call before Unlock().
+    void BufferData(IDirect3DVertexBuffer9* pVB, UINT offset, const void* pData, UINT bytes, DWORD lockFlags = 0);
+    void BufferData(IDirect3DIndexBuffer9* pIB, UINT offset, const void* pData, UINT bytes, DWORD lockFlags = 0);
+
+    // After Present().  Ends the capture once maxFrames have been recorded.
+    void EndFrame();
+
+    const DeviceCaptureStats& Stats() const { return m_stats; }
+    void ReportStats() const;
+
+private:
+    DeviceCapture(const DeviceCapture&);
+    DeviceCapture& operator=(const DeviceCapture&);
+
+    // Id of an object; sets *pNew the first time the object is seen.
+    unsigned Id(const void* p, bool* pNew = NULL);
+
+    // Buffers, shaders and declarations on first use; return their ids.
+    unsigned VertexBufferId(IDirect3DVertexBuffer9* pVB);
+    unsigned IndexBufferId(IDirect3DIndexBuffer9* pIB);
+
+    void* Add(CaptureRecordType type, size_t bytes);
+    void  Write(CaptureRecordType type, const void* pPayload, size_t bytes);
+    void  FlushChunk();
+
+    FILE*                          m_pFile;
+    std::string                    m_path;
+    unsigned                       m_maxFrames;
+    std::vector<unsigned>          m_pending;      // records not yet written
+    size_t                         m_pendingBytes;
+    std::vector<char>              m_packed;
+    std::map<const void*, unsigned> m_ids;
+    unsigned                       m_nextId;
+    DeviceCaptureStats             m_stats;
+};
+
+
+// One capture shared by the whole program (defined in DeviceCapture.cpp).
+extern DeviceCapture g_capture;
+
+#endif // DEVICE_CAPTURE_H
@@ -0,0 +1,77 @@
+//=============================================================================
+// DynamicBuffer.cpp
+//=============================================================================
+
+#include "DynamicBuffer.h"
+#include <cstdio>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define snprintf _snprintf
+#endif
+
+
+bool DynamicRing::Reserve(UINT bytes, UINT alignment, UINT* pOffset, DWORD* pLockFlags)
+{
+    if (bytes == 0 || bytes > m_capacity)
+        return false;
+
+    UINT offset = (m_position + alignment - 1) / alignment * alignment;
+    if (m_discard || offset > m_capacity || bytes > m_capacity - offset)
+    {
+        // Wrap: the driver renames the buffer, the GPU keeps the old one.
+        offset      = 0;
+        *pLockFlags = D3DLOCK_DISCARD;
+        m_discard   = false;
+    }
+    else
+    {
+        *pLockFlags = D3DLOCK_NOOVERWRITE;
+    }
+
+    m_position = offset + bytes;
+    *pOffset   = offset;
+    return true;
+}
+
+
+HRESULT DynamicVertexBuffer::Create(IDirect3DDevice9* pDevice, UINT bytes)
+{
+    IDirect3DVertexBuffer9* pVB = NULL;
+    HRESULT hr = pDevice->CreateVertexBuffer(bytes, D3DUSAGE_DYNAMIC | D3DUSAGE_WRITEONLY, 0,
+                                             D3DPOOL_DEFAULT, &pVB, NULL);
+    if (FAILED(hr))
+        return hr;
+
+    Attach(pVB, bytes);
+    return S_OK;
+}
+
+HRESULT DynamicIndexBuffer::Create(IDirect3DDevice9* pDevice, UINT bytes, D3DFORMAT format)
+{
+    IDirect3DIndexBuffer9* pIB = NULL;
+    HRESULT hr = pDevice->CreateIndexBuffer(bytes, D3DUSAGE_DYNAMIC | D3DUSAGE_WRITEONLY, format,
+                                            D3DPOOL_DEFAULT, &pIB, NULL);
+    if (FAILED(hr))
+        return hr;
+
+    Attach(pIB, bytes);
+    m_format = format;
+    return S_OK;
+}
+
+
+void ReportDynamicBufferStats(const char* name, const DynamicBufferStats& stats)
+{
+    char msg[256];
+    snprintf(msg, sizeof(msg),
+             "[DynamicBuffer] %s: %u locks (%u discards), %.1f MB written, %.3f ms in Lock, %u failed\n",
+             name, stats.locks, stats.discards, stats.bytes / (1024.0 * 1024.0), stats.lockMs, stats.failed);
+#ifdef _WIN32
+    OutputDebugStringA(msg);
+#endif
+    fputs(msg, stderr);
+}
@@ -0,0 +1,227 @@
+//=============================================================================
+// DynamicBuffer.h
+//
+// Ring allocators for geometry that is rewritten every frame.  The samples
+// create their buffers once in D3DPOOL_DEFAULT and fill them with
+// Lock(0, ...); doing that every frame makes the CPU wait until the GPU has
+// finished drawing from the buffer.  A DynamicVertexBuffer or
+// DynamicIndexBuffer is instead one large D3DUSAGE_DYNAMIC|WRITEONLY buffer
+// handed out piece by piece:
+//
+//  - each Lock() appends after the previous one with D3DLOCK_NOOVERWRITE,
+//    promising the driver that nothing the GPU may still read is touched,
+//    so the lock returns at once;
+//  - when a request does not fit in the rest of the buffer, it starts over
+//    at offset 0 with D3DLOCK_DISCARD and the driver hands out fresh memory
+//    while the GPU finishes with the old contents.
+//
+// Lock() returns the index of the first element it reserved, which is what
+// the draw call needs, so the buffer stays bound at offset 0 and the state
+// cache filters the repeated SetStreamSource/SetIndices:
+//
+//     UINT firstVertex, firstIndex;
+//     Vertex* pV = (Vertex*)g_dynamicVB.Lock( numVertices, sizeof(Vertex), &firstVertex );
+//     WORD*   pI = (WORD*)g_dynamicIB.Lock( numIndices, &firstIndex );
+//     ... write ...
+//     g_dynamicVB.Unlock();
+//     g_dynamicIB.Unlock();
+//     g_stateCache.SetStreamSource( 0, g_dynamicVB.Buffer(), 0, sizeof(Vertex) );
+//     g_stateCache.SetIndices( g_dynamicIB.Buffer() );
+//     g_stateCache.DrawIndexedPrimitive( D3DPT_TRIANGLELIST, firstVertex, 0, numVertices,
+//                                        firstIndex, numIndices / 3 );
+//
+// Every allocation starts at a multiple of its element size, so one vertex
+// buffer can hold vertices of different strides.  Only one Lock() may be
+// outstanding per buffer.  The buffers are D3DPOOL_DEFAULT: Release()
+// them before IDirect3DDevice9::Reset() and Create() them again after.
+//=============================================================================
+
+#ifndef DYNAMIC_BUFFER_H
+#define DYNAMIC_BUFFER_H
+
+#include <d3d9.h>
+#include "DeviceCapture.h"
+#include "FrameStats.h"
+#include <chrono>
+#include <cstring>
+
+
+struct DynamicBufferStats
+{
+    unsigned           locks;       // successful Lock() calls
+    unsigned           discards;    // of those, D3DLOCK_DISCARD (first use and wraps)
+    unsigned           failed;      // requests larger than the buffer, Lock() errors
+    unsigned long long bytes;       // handed out, without alignment padding
+    double             lockMs;      // spent inside the buffer's Lock()
+};
+
+// Prints stats as "[DynamicBuffer] name: ..." (defined in DynamicBuffer.cpp).
+void ReportDynamicBufferStats(const char* name, const DynamicBufferStats& stats);
+
+
+//===============================================================
+// Ring bookkeeping, independent of the buffer type
+
+class DynamicRing
+{
+public:
+    DynamicRing() : m_capacity(0), m_position(0), m_discard(true) {}
+
+    // Forgets every allocation; the next Reserve() discards.
+    void Reset(UINT capacity) { m_capacity = capacity; m_position = 0; m_discard = true; }
+    void Discard()            { m_discard = true; }
+
+    UINT Capacity() const     { return m_capacity; }
+    UINT Position() const     { return m_position; }
+
+    // Places bytes at the next multiple of alignment after the previous
+    // allocation, or at 0 if they do not fit, and returns the lock flag that
+    // goes with it.  False if bytes is 0 or larger than the whole ring.
+    bool Reserve(UINT bytes, UINT alignment, UINT* pOffset, DWORD* pLockFlags);
+
+private:
+    UINT m_capacity;
+    UINT m_position;
+    bool m_discard;
+};
+
+
+//===============================================================
+// DynamicBuffer<IDirect3DVertexBuffer9 / IDirect3DIndexBuffer9>
+
+template<typename TBuffer>
+class DynamicBuffer
+{
+public:
+    DynamicBuffer() : m_pBuffer(NULL), m_pLocked(NULL) { ResetStats(); }
+    ~DynamicBuffer() { Release(); }
+
+    void Release()
+    {
+        if (m_pBuffer != NULL)
+            m_pBuffer->Release();
+        m_pBuffer = NULL;
+        m_ring.Reset(0);
+    }
+
+    TBuffer* Buffer() const   { return m_pBuffer; }
+    UINT     Capacity() const { return m_ring.Capacity(); }
+
+    // Makes the next Lock() discard, e.g. once per frame to keep each
+    // frame's data contiguous.  Not needed for correctness.
+    void Discard() { m_ring.Discard(); }
+
+    // Reserves count elements of elementSize bytes and locks them.
+    // *pFirst receives the index of the first one (BaseVertexIndex or
+    // StartVertex for vertices, StartIndex for indices).  NULL on failure.
+    void* Lock(UINT count, UINT elementSize, UINT* pFirst)
+    {
+        UINT  offset = 0;
+        DWORD flags  = 0;
+        if (m_pBuffer == NULL || elementSize == 0 || count > m_ring.Capacity() / elementSize ||
+            !m_ring.Reserve(count * elementSize, elementSize, &offset, &flags))
+        {
+            ++m_stats.failed;
+            return NULL;
+        }
+
+        UINT bytes = count * elementSize;
+        std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+        void* pData = NULL;
+        HRESULT hr = m_pBuffer->Lock(offset, bytes, &pData, flags);
+        m_stats.lockMs += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        if (FAILED(hr))
+        {
+            ++m_stats.failed;
+            m_ring.Discard();
+            return NULL;
+        }
+
+        ++m_stats.locks;
+        if (flags & D3DLOCK_DISCARD)
+            ++m_stats.discards;
+        m_stats.bytes += bytes;
+        g_frameStats.Lock(bytes);
+        *pFirst = offset / elementSize;
+
+        m_pLocked    = pData;
+        m_lockOffset = offset;
+        m_lockBytes  = bytes;
+        m_lockFlags  = flags;
+        return pData;
+    }
+
+    HRESULT Unlock()
+    {
+        // A running capture gets what was written, read back before the
+        // range goes to the GPU.  Slow on write-combined memory, but only
+        // while capturing.
+        if (m_pLocked != NULL && g_capture.IsRecording())
+            g_capture.BufferData(m_pBuffer, m_lockOffset, m_pLocked, m_lockBytes, m_lockFlags);
+        m_pLocked = NULL;
+        return m_pBuffer->Unlock();
+    }
+
+    // Lock(), copy count elements from pData, Unlock().
+    bool Write(const void* pData, UINT count, UINT elementSize, UINT* pFirst)
+    {
+        void* pDest = Lock(count, elementSize, pFirst);
+        if (pDest == NULL)
+            return false;
+        memcpy(pDest, pData, count * elementSize);
+        Unlock();
+        return true;
+    }
+
+    const DynamicBufferStats& Stats() const { return m_stats; }
+    void ResetStats()                       { memset(&m_stats, 0, sizeof(m_stats)); }
+    void ReportStats(const char* name) const { ReportDynamicBufferStats(name, m_stats); }
+
+protected:
+    void Attach(TBuffer* pBuffer, UINT bytes)
+    {
+        Release();
+        m_pBuffer = pBuffer;
+        m_ring.Reset(bytes);
+    }
+
+private:
+    DynamicBuffer(const DynamicBuffer&);
+    DynamicBuffer& operator=(const DynamicBuffer&);
+
+    TBuffer*           m_pBuffer;
+    DynamicRing        m_ring;
+    void*              m_pLocked;       // the open Lock(), for the capture
+    UINT               m_lockOffset;
+    UINT               m_lockBytes;
+    DWORD              m_lockFlags;
+    DynamicBufferStats m_stats;
+};
+
+
+class DynamicVertexBuffer : public DynamicBuffer<IDirect3DVertexBuffer9>
+{
+public:
+    // bytes: room for a frame or more of vertices (a few MB).
+    HRESULT Create(IDirect3DDevice9* pDevice, UINT bytes);
+};
+
+class DynamicIndexBuffer : public DynamicBuffer<IDirect3DIndexBuffer9>
+{
+public:
+    DynamicIndexBuffer() : m_format(D3DFMT_INDEX16) {}
+
+    HRESULT Create(IDirect3DDevice9* pDevice, UINT bytes, D3DFORMAT format = D3DFMT_INDEX16);
+
+    D3DFORMAT Format() const    { return m_format; }
+    UINT      IndexSize() const { return m_format == D3DFMT_INDEX32 ? 4 : 2; }
+
+    // Lock()/Write() in indices of IndexSize() bytes.
+    void* Lock(UINT count, UINT* pFirst)                   { return DynamicBuffer<IDirect3DIndexBuffer9>::Lock(count, IndexSize(), pFirst); }
+    bool  Write(const void* pData, UINT count, UINT* pFirst) { return DynamicBuffer<IDirect3DIndexBuffer9>::Write(pData, count, IndexSize(), pFirst); }
+
+private:
+    D3DFORMAT m_format;
+};
+
+#endif // DYNAMIC_BUFFER_H
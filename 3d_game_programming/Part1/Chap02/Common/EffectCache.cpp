@@ -0,0 +1,323 @@
+//=============================================================================
+// EffectCache.cpp
+//=============================================================================
+
+#include "EffectCache.h"
+#include "AssetLoaders.h"
+#include "AssetPack.h"
+#include "FileUtil.h"
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define snprintf _snprintf
+#endif
+
+
+EffectCache g_effectCache;
+
+
+unsigned long long HashBytes(const void* pData, size_t size, unsigned long long seed)
+{
+    const unsigned char* p = (const unsigned char*)pData;
+    unsigned long long   h = seed;
+    for (size_t i = 0; i < size; ++i)
+    {
+        h ^= p[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+
+namespace
+{
+    struct Dependency
+    {
+        std::string        name;
+        unsigned long long hash;
+    };
+
+    // Remembers every file the compiler includes, with a hash of what
+    // it was given.
+    class RecordingInclude : public AssetInclude
+    {
+    public:
+        STDMETHOD(Open)(D3DXINCLUDE_TYPE type, LPCSTR pFileName, LPCVOID pParentData,
+                        LPCVOID* ppData, UINT* pBytes)
+        {
+            HRESULT hr = AssetInclude::Open(type, pFileName, pParentData, ppData, pBytes);
+            if (FAILED(hr))
+                return hr;
+
+            for (size_t i = 0; i < m_deps.size(); ++i)
+            {
+                if (m_deps[i].name == pFileName)
+                    return hr;
+            }
+            Dependency d;
+            d.name = pFileName;
+            d.hash = HashBytes(*ppData, *pBytes);
+            m_deps.push_back(d);
+            return hr;
+        }
+
+        const std::vector<Dependency>& Dependencies() const { return m_deps; }
+
+    private:
+        std::vector<Dependency> m_deps;
+    };
+
+    double MillisecondsSince(std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    void DebugPrint(const char* msg)
+    {
+#ifdef _WIN32
+        OutputDebugStringA(msg);
+#endif
+        fputs(msg, stderr);
+    }
+}
+
+
+EffectCache::EffectCache()
+    : m_dir("shadercache")
+{
+    ResetStats();
+}
+
+void EffectCache::ResetStats()
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+bool EffectCache::ComputeKey(const char* name, const D3DXMACRO* pDefines, DWORD flags,
+                             unsigned long long& key, std::string& path, std::vector<char>& source)
+{
+    AssetData data;
+    if (!g_assets.Load(name, data))
+        return false;
+
+    source.assign((const char*)data.Data(), (const char*)data.Data() + data.Size());
+
+    unsigned inputs[3] = { EFFECT_CACHE_VERSION, D3DX_SDK_VERSION, flags };
+    key = HashBytes(inputs, sizeof(inputs));
+    key = HashBytes(source.empty() ? NULL : &source[0], source.size(), key);
+    for (const D3DXMACRO* m = pDefines; m && m->Name; ++m)
+    {
+        // The terminators keep ("AB","") and ("A","B") apart.
+        key = HashBytes(m->Name, strlen(m->Name) + 1, key);
+        const char* def = m->Definition ? m->Definition : "";
+        key = HashBytes(def, strlen(def) + 1, key);
+    }
+
+    std::string base = FileNameOf(name);
+    size_t dot = base.find_last_of('.');
+    if (dot != std::string::npos)
+        base.erase(dot);
+
+    char file[64];
+    snprintf(file, sizeof(file), "-%016llx.fxo", key);
+    path = m_dir + PATH_SEPARATOR + base + file;
+    return true;
+}
+
+std::string EffectCache::BlobPath(const char* name, const D3DXMACRO* pDefines, DWORD flags)
+{
+    unsigned long long key;
+    std::string        path;
+    std::vector<char>  source;
+    return ComputeKey(name, pDefines, flags, key, path, source) ? path : std::string();
+}
+
+bool EffectCache::LoadBlob(const std::string& path, unsigned long long key, std::vector<char>& code)
+{
+    std::vector<char> bytes;
+    if (!ReadFileBytes(path.c_str(), bytes) || bytes.size() < sizeof(EffectCacheHeader))
+        return false;
+
+    EffectCacheHeader header;
+    memcpy(&header, &bytes[0], sizeof(header));
+    if (memcmp(header.magic, EFFECT_CACHE_MAGIC, 4) != 0 || header.version != EFFECT_CACHE_VERSION ||
+        header.key != key || header.codeSize == 0 ||
+        (unsigned long long)sizeof(header) + header.dependencyBytes + header.codeSize != bytes.size())
+        return false;
+
+    // Every include must still have the contents the blob was built from.
+    const char* p   = &bytes[sizeof(header)];
+    const char* end = p + header.dependencyBytes;
+    for (unsigned i = 0; i < header.numDependencies; ++i)
+    {
+        unsigned long long hash;
+        unsigned           length;
+        if (end - p < (ptrdiff_t)(sizeof(hash) + sizeof(length)))
+            return false;
+        memcpy(&hash, p, sizeof(hash));
+        memcpy(&length, p + sizeof(hash), sizeof(length));
+        p += sizeof(hash) + sizeof(length);
+        if ((size_t)(end - p) < length)
+            return false;
+
+        std::string name(p, length);
+        p += length;
+
+        AssetData data;
+        if (!g_assets.Load(name.c_str(), data) || HashBytes(data.Data(), data.Size()) != hash)
+        {
+            ++m_stats.stale;
+            return false;
+        }
+    }
+    if (p != end)
+        return false;
+
+    code.assign(end, end + header.codeSize);
+    return true;
+}
+
+bool EffectCache::Compile(const std::vector<char>& source, const D3DXMACRO* pDefines, DWORD flags,
+                          unsigned long long key, const std::string& path,
+                          std::vector<char>& code, std::string* pErrors)
+{
+    RecordingInclude     include;
+    ID3DXEffectCompiler* pCompiler = NULL;
+    ID3DXBuffer*         pErrorBuf = NULL;
+    ID3DXBuffer*         pCompiled = NULL;
+
+    HRESULT hr = D3DXCreateEffectCompiler(source.empty() ? "" : &source[0], (UINT)source.size(),
+                                          pDefines, &include, flags, &pCompiler, &pErrorBuf);
+    if (SUCCEEDED(hr))
+    {
+        if (pErrorBuf)
+        {
+            pErrorBuf->Release();
+            pErrorBuf = NULL;
+        }
+        hr = pCompiler->CompileEffect(flags, &pCompiled, &pErrorBuf);
+        pCompiler->Release();
+    }
+
+    if (pErrorBuf)
+    {
+        if (pErrors)
+            *pErrors = (const char*)pErrorBuf->GetBufferPointer();
+        pErrorBuf->Release();
+    }
+    if (FAILED(hr) || pCompiled == NULL)
+    {
+        if (pCompiled)
+            pCompiled->Release();
+        return false;
+    }
+
+    const char* pCode = (const char*)pCompiled->GetBufferPointer();
+    code.assign(pCode, pCode + pCompiled->GetBufferSize());
+    pCompiled->Release();
+
+    // Store: header, dependency table, code.
+    std::vector<char> table;
+    const std::vector<Dependency>& deps = include.Dependencies();
+    for (size_t i = 0; i < deps.size(); ++i)
+    {
+        unsigned length = (unsigned)deps[i].name.size();
+        table.insert(table.end(), (const char*)&deps[i].hash, (const char*)&deps[i].hash + sizeof(deps[i].hash));
+        table.insert(table.end(), (const char*)&length, (const char*)&length + sizeof(length));
+        table.insert(table.end(), deps[i].name.begin(), deps[i].name.end());
+    }
+
+    EffectCacheHeader header;
+    memcpy(header.magic, EFFECT_CACHE_MAGIC, 4);
+    header.version         = EFFECT_CACHE_VERSION;
+    header.key             = key;
+    header.numDependencies = (unsigned)deps.size();
+    header.dependencyBytes = (unsigned)table.size();
+    header.codeSize        = (unsigned)code.size();
+
+    std::vector<char> blob((const char*)&header, (const char*)&header + sizeof(header));
+    blob.insert(blob.end(), table.begin(), table.end());
+    blob.insert(blob.end(), code.begin(), code.end());
+
+    // A cache that cannot be written only costs the next run a compile.
+    if (!MakeDirectory(m_dir.c_str()) || !WriteFileBytes(path.c_str(), &blob[0], blob.size()))
+    {
+        char msg[512];
+        snprintf(msg, sizeof(msg), "[EffectCache] cannot write %s\n", path.c_str());
+        DebugPrint(msg);
+    }
+    return true;
+}
+
+bool EffectCache::GetCode(const char* name, const D3DXMACRO* pDefines, DWORD flags,
+                          std::vector<char>& code, std::string* pErrors)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    unsigned long long key;
+    std::string        path;
+    std::vector<char>  source;
+    if (!ComputeKey(name, pDefines, flags, key, path, source))
+    {
+        if (pErrors)
+            *pErrors = std::string("cannot load ") + name;
+        ++m_stats.failures;
+        return false;
+    }
+
+    unsigned stale = m_stats.stale;
+    if (LoadBlob(path, key, code))
+    {
+        ++m_stats.hits;
+        m_stats.loadMs += MillisecondsSince(start);
+        return true;
+    }
+    if (m_stats.stale == stale)
+        ++m_stats.misses;
+
+    bool ok = Compile(source, pDefines, flags, key, path, code, pErrors);
+    m_stats.compileMs += MillisecondsSince(start);
+    if (!ok)
+        ++m_stats.failures;
+    return ok;
+}
+
+HRESULT EffectCache::CreateEffect(IDirect3DDevice9* pDevice, const char* name,
+                                  const D3DXMACRO* pDefines, DWORD flags,
+                                  ID3DXEffectPool* pPool, ID3DXEffect** ppEffect,
+                                  ID3DXBuffer** ppErrors)
+{
+    std::vector<char> code;
+    std::string       errors;
+    if (!GetCode(name, pDefines, flags, code, &errors))
+    {
+        // Hand the messages back the way D3DXCreateEffect would.
+        if (ppErrors && !errors.empty() &&
+            SUCCEEDED(D3DXCreateBuffer((DWORD)errors.size() + 1, ppErrors)))
+            memcpy((*ppErrors)->GetBufferPointer(), errors.c_str(), errors.size() + 1);
+        return D3DXERR_INVALIDDATA;
+    }
+
+    // The binary has no #includes or macros left to resolve.
+    return D3DXCreateEffect(pDevice, &code[0], (UINT)code.size(), NULL, NULL,
+                            flags, pPool, ppEffect, ppErrors);
+}
+
+bool EffectCache::Cook(const char* name, const D3DXMACRO* pDefines, DWORD flags,
+                       std::string* pErrors)
+{
+    std::vector<char> code;
+    return GetCode(name, pDefines, flags, code, pErrors);
+}
+
+void EffectCache::ReportStats() const
+{
+    char msg[256];
+    snprintf(msg, sizeof(msg),
+             "[EffectCache] %u hits (%.1f ms), %u misses + %u stale (%.1f ms compiling), %u failed\n",
+             m_stats.hits, m_stats.loadMs, m_stats.misses, m_stats.stale, m_stats.compileMs,
+             m_stats.failures);
+    DebugPrint(msg);
+}
@@ -0,0 +1,106 @@
+//=============================================================================
+// EffectCache.h
+//
+// On-disk cache of compiled effects.  An effect is compiled once with
+// ID3DXEffectCompiler and the binary is stored under a key made from the
+// source text, the macros, the compile flags and the D3DX version.  Later
+// runs load the binary with D3DXCreateEffect instead of compiling again.
+//
+// Files pulled in with #include are not part of the key, since they are
+// only known after compiling; instead each cached blob records the
+// includes it was built from with a hash of their contents, and a blob
+// whose includes have changed is treated as a miss and rebuilt.
+//
+// Sources and includes are read through g_assets (AssetPack.h), so the
+// cache works the same for loose files and packed ones.  The cache
+// directory is written next to the executable's working directory;
+// deleting it is always safe.
+//=============================================================================
+
+#ifndef EFFECT_CACHE_H
+#define EFFECT_CACHE_H
+
+#include <d3dx9.h>
+#include <string>
+#include <vector>
+
+
+const char     EFFECT_CACHE_MAGIC[4]  = { 'F', 'X', 'C', 'B' };
+const unsigned EFFECT_CACHE_VERSION   = 1;
+
+#pragma pack(push, 4)
+struct EffectCacheHeader
+{
+    char               magic[4];
+    unsigned           version;
+    unsigned long long key;
+    unsigned           numDependencies;
+    unsigned           dependencyBytes;     // size of the dependency table
+    unsigned           codeSize;            // compiled effect, after the table
+};
+#pragma pack(pop)
+
+// Dependency table entry: hash, name length, then the name (no NUL).
+
+
+struct EffectCacheStats
+{
+    unsigned hits;
+    unsigned misses;            // no blob, or a different key
+    unsigned stale;             // blob found but an include changed
+    unsigned failures;          // compile errors
+    double   compileMs;         // spent compiling on misses
+    double   loadMs;            // spent reading and validating hits
+};
+
+class EffectCache
+{
+public:
+    EffectCache();
+
+    // Directory for the blobs ("shadercache" by default).  Created on
+    // the first store.
+    void SetDirectory(const char* dir)      { m_dir = dir; }
+    const std::string& Directory() const    { return m_dir; }
+
+    // D3DXCreateEffect from the cached binary, compiling and storing it
+    // first on a miss.  Arguments follow CreateEffectFromAsset.
+    HRESULT CreateEffect(IDirect3DDevice9* pDevice, const char* name,
+                         const D3DXMACRO* pDefines, DWORD flags,
+                         ID3DXEffectPool* pPool, ID3DXEffect** ppEffect,
+                         ID3DXBuffer** ppErrors);
+
+    // Makes sure an up-to-date blob exists, without a device.  Used by
+    // the cook tool.  Returns false and fills pErrors on a compile error.
+    bool Cook(const char* name, const D3DXMACRO* pDefines, DWORD flags,
+              std::string* pErrors = NULL);
+
+    // Path of the blob for these inputs ("" if the source is missing).
+    std::string BlobPath(const char* name, const D3DXMACRO* pDefines, DWORD flags);
+
+    const EffectCacheStats& Stats() const { return m_stats; }
+    void ResetStats();
+    void ReportStats() const;
+
+private:
+    // Compiled binary for these inputs, from disk or freshly compiled.
+    bool GetCode(const char* name, const D3DXMACRO* pDefines, DWORD flags,
+                 std::vector<char>& code, std::string* pErrors);
+    bool ComputeKey(const char* name, const D3DXMACRO* pDefines, DWORD flags,
+                    unsigned long long& key, std::string& path, std::vector<char>& source);
+    bool LoadBlob(const std::string& path, unsigned long long key, std::vector<char>& code);
+    bool Compile(const std::vector<char>& source, const D3DXMACRO* pDefines, DWORD flags,
+                 unsigned long long key, const std::string& path,
+                 std::vector<char>& code, std::string* pErrors);
+
+    std::string      m_dir;
+    EffectCacheStats m_stats;
+};
+
+extern EffectCache g_effectCache;
+
+// FNV-1a, 64 bit.
+unsigned long long HashBytes(const void* pData, size_t size,
+                             unsigned long long seed = 14695981039346656037ULL);
+
+#endif // EFFECT_CACHE_H
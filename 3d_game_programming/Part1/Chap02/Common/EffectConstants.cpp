@@ -0,0 +1,228 @@
+//=============================================================================
+// EffectConstants.cpp
+//=============================================================================
+
+#include "EffectConstants.h"
+#include "DeviceCapture.h"
+#include <cstdio>
+#include <cstring>
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define snprintf _snprintf
+#endif
+
+
+namespace
+{
+    const UINT REGISTER_BYTES = 16;
+
+    bool IsShadowed(const D3DXPARAMETER_DESC& desc)
+    {
+        bool numeric = desc.Type == D3DXPT_FLOAT || desc.Type == D3DXPT_INT || desc.Type == D3DXPT_BOOL;
+        bool shaped  = desc.Class == D3DXPC_SCALAR || desc.Class == D3DXPC_VECTOR ||
+                       desc.Class == D3DXPC_MATRIX_ROWS || desc.Class == D3DXPC_MATRIX_COLUMNS;
+        return numeric && shaped && desc.Bytes > 0;
+    }
+}
+
+
+EffectConstantBuffer::EffectConstantBuffer()
+    : m_pEffect(NULL)
+{
+    ResetStats();
+}
+
+void EffectConstantBuffer::ResetStats()
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void EffectConstantBuffer::Bind(ID3DXEffect* pFx)
+{
+    std::vector<Parameter> oldParams;
+    std::vector<char>      oldShadow;
+    oldParams.swap(m_params);
+    oldShadow.swap(m_shadow);
+    m_dirty.clear();
+
+    m_pEffect = pFx;
+    if (pFx == NULL)
+        return;
+
+    D3DXEFFECT_DESC fxDesc;
+    if (FAILED(pFx->GetDesc(&fxDesc)))
+        return;
+
+    UINT offset = 0;
+    for (UINT i = 0; i < fxDesc.Parameters; ++i)
+    {
+        D3DXHANDLE h = pFx->GetParameter(NULL, i);
+        D3DXPARAMETER_DESC desc;
+        if (h == NULL || FAILED(pFx->GetParameterDesc(h, &desc)) || !IsShadowed(desc))
+            continue;
+
+        Parameter p;
+        p.name       = desc.Name ? desc.Name : "";
+        p.handle     = h;
+        p.offset     = offset;
+        p.matrices   = 0;
+        p.bytes      = desc.Bytes;
+        p.dirtyBegin = p.dirtyEnd = 0;
+
+        // SetRawValue offsets are in register layout, which matches the
+        // packed shadow only when every element fills a float4 register.
+        p.rawAllowed = desc.Type == D3DXPT_FLOAT && desc.Class == D3DXPC_VECTOR &&
+                       desc.Columns == 4 && desc.Elements > 0;
+
+        // Matrices are shadowed as D3DXMATRIX and go through SetMatrixArray,
+        // so D3DX keeps handling row/column packing and smaller shapes.
+        if (desc.Class == D3DXPC_MATRIX_ROWS || desc.Class == D3DXPC_MATRIX_COLUMNS)
+        {
+            p.matrices   = desc.Elements > 0 ? desc.Elements : 1;
+            p.bytes      = p.matrices * sizeof(D3DXMATRIX);
+        }
+        m_params.push_back(p);
+
+        offset += (p.bytes + REGISTER_BYTES - 1) & ~(REGISTER_BYTES - 1);
+    }
+
+    // The shadow starts out as the effect's own defaults, so a Set* with
+    // the default value is skipped like any other unchanged value.
+    m_shadow.assign(offset, 0);
+    for (size_t i = 0; i < m_params.size(); ++i)
+    {
+        const Parameter& p = m_params[i];
+        if (p.matrices)
+            pFx->GetMatrixArray(p.handle, (D3DXMATRIX*)&m_shadow[p.offset], p.matrices);
+        else
+            pFx->GetValue(p.handle, &m_shadow[p.offset], p.bytes);
+    }
+
+    // Values set on the previous effect (hot reload) carry over and are
+    // uploaded where they differ from the new defaults.
+    for (size_t i = 0; i < m_params.size(); ++i)
+    {
+        Parameter& p = m_params[i];
+        for (size_t j = 0; j < oldParams.size(); ++j)
+        {
+            const Parameter& o = oldParams[j];
+            if (o.name != p.name || o.bytes != p.bytes || o.matrices != p.matrices)
+                continue;
+
+            if (memcmp(&m_shadow[p.offset], &oldShadow[o.offset], p.bytes) != 0)
+            {
+                memcpy(&m_shadow[p.offset], &oldShadow[o.offset], p.bytes);
+                MarkDirty(p, 0, p.bytes);
+            }
+            break;
+        }
+    }
+}
+
+void EffectConstantBuffer::Unbind()
+{
+    m_pEffect = NULL;
+    m_params.clear();
+    m_dirty.clear();
+    m_shadow.clear();
+}
+
+int EffectConstantBuffer::Find(const char* name) const
+{
+    for (size_t i = 0; i < m_params.size(); ++i)
+    {
+        if (m_params[i].name == name)
+            return (int)i;
+    }
+    return -1;
+}
+
+void EffectConstantBuffer::MarkDirty(Parameter& p, UINT begin, UINT end)
+{
+    if (p.dirtyBegin == p.dirtyEnd)
+    {
+        m_dirty.push_back((int)(&p - &m_params[0]));
+        p.dirtyBegin = begin;
+        p.dirtyEnd   = end;
+        return;
+    }
+    if (begin < p.dirtyBegin) p.dirtyBegin = begin;
+    if (end > p.dirtyEnd)     p.dirtyEnd   = end;
+}
+
+bool EffectConstantBuffer::SetValue(int param, const void* pData, UINT bytes)
+{
+    if (param < 0 || (size_t)param >= m_params.size() || bytes > m_params[param].bytes)
+        return false;
+
+    ++m_stats.sets;
+
+    Parameter& p      = m_params[param];
+    char*      shadow = &m_shadow[p.offset];
+    if (memcmp(shadow, pData, bytes) == 0)
+    {
+        ++m_stats.setsSkipped;
+        m_stats.bytesSkipped += bytes;
+        return true;
+    }
+
+    memcpy(shadow, pData, bytes);
+    MarkDirty(p, 0, p.rawAllowed ? bytes : p.bytes);
+    return true;
+}
+
+UINT EffectConstantBuffer::Flush()
+{
+    if (m_pEffect == NULL)
+        return 0;
+
+    UINT uploaded = 0;
+    for (size_t i = 0; i < m_dirty.size(); ++i)
+    {
+        Parameter& p = m_params[m_dirty[i]];
+        UINT begin = p.dirtyBegin, bytes = p.dirtyEnd - p.dirtyBegin;
+        if (p.matrices)
+        {
+            const D3DXMATRIX* pMatrices = (const D3DXMATRIX*)&m_shadow[p.offset];
+            if (g_capture.IsRecording())
+                g_capture.SetMatrix(m_pEffect, p.handle, pMatrices, p.matrices);
+            m_pEffect->SetMatrixArray(p.handle, pMatrices, p.matrices);
+        }
+        else if (bytes == p.bytes)
+            m_pEffect->SetValue(p.handle, &m_shadow[p.offset], bytes);
+        else
+            m_pEffect->SetRawValue(p.handle, &m_shadow[p.offset + begin], begin, bytes);
+
+        p.dirtyBegin = p.dirtyEnd = 0;
+        uploaded += bytes;
+        ++m_stats.uploads;
+    }
+    m_dirty.clear();
+
+    m_stats.bytesUploaded += uploaded;
+    return uploaded;
+}
+
+HRESULT EffectConstantBuffer::Commit()
+{
+    if (m_pEffect == NULL)
+        return E_FAIL;
+
+    // CommitChanges() also picks up textures and states set directly on
+    // the effect, so it is needed even when no shadowed constant changed.
+    Flush();
+    return m_pEffect->CommitChanges();
+}
+
+void EffectConstantBuffer::ReportStats(const char* name) const
+{
+    char msg[256];
+    snprintf(msg, sizeof(msg),
+             "[Constants] %s: %u sets (%u unchanged), %u uploads, %llu bytes uploaded, %llu bytes skipped\n",
+             name, m_stats.sets, m_stats.setsSkipped, m_stats.uploads,
+             m_stats.bytesUploaded, m_stats.bytesSkipped);
+#ifdef _WIN32
+    OutputDebugStringA(msg);
+#endif
+    fputs(msg, stderr);
+}
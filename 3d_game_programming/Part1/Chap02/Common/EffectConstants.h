@@ -0,0 +1,93 @@
+//=============================================================================
+// EffectConstants.h
+//
+// CPU-side constant buffer over the numeric parameters of an ID3DXEffect.
+//
+// Every Set* call writes into a shadow copy and compares it with what was
+// there; an unchanged value costs a memcmp and never reaches D3DX.  Changed
+// parameters are remembered, and Flush() hands them to the effect.  A set
+// that covers only the leading elements of a float4 array uploads just
+// those registers.
+// Call Flush() after Begin() and before BeginPass(), and use Commit()
+// instead of CommitChanges() inside a pass.
+//
+// Only float, int and bool scalars, vectors, matrices and arrays of them
+// are shadowed.  Textures, samplers and structs are still set directly on
+// the effect.
+//=============================================================================
+
+#ifndef EFFECT_CONSTANTS_H
+#define EFFECT_CONSTANTS_H
+
+#include <d3dx9.h>
+#include "Math3D.h"
+#include <string>
+#include <vector>
+
+
+struct EffectConstantStats
+{
+    unsigned           sets;            // Set* calls
+    unsigned           setsSkipped;     // value was unchanged
+    unsigned           uploads;         // SetValue/SetRawValue calls made by Flush
+    unsigned long long bytesUploaded;
+    unsigned long long bytesSkipped;    // set but not uploaded
+};
+
+class EffectConstantBuffer
+{
+public:
+    EffectConstantBuffer();
+
+    // Lays out the shadow copy for pFx's parameters.  Values set before a
+    // rebind (hot reload) are kept for parameters whose name and size did
+    // not change, and are uploaded to the new effect on the next Flush().
+    void Bind(ID3DXEffect* pFx);
+    void Unbind();
+
+    ID3DXEffect* Effect() const { return m_pEffect; }
+
+    // Index of a shadowed parameter, or -1.  Indices stay valid until the
+    // next Bind().
+    int Find(const char* name) const;
+
+    // Set* fail only for an invalid index or a size mismatch.
+    bool SetValue(int param, const void* pData, UINT bytes);
+    bool SetMatrix(int param, const D3DXMATRIX* pMatrix)  { return SetValue(param, pMatrix, sizeof(D3DXMATRIX)); }
+    bool SetMatrix(int param, const Mat4& matrix)         { return SetValue(param, matrix.Data(), sizeof(Mat4)); }
+    bool SetVector(int param, const D3DXVECTOR4* pVector) { return SetValue(param, pVector, sizeof(D3DXVECTOR4)); }
+    bool SetFloat(int param, float f)                     { return SetValue(param, &f, sizeof(float)); }
+
+    // Uploads the dirty ranges.  Returns the number of bytes uploaded.
+    UINT Flush();
+
+    // Flush() followed by CommitChanges(), for changes inside a pass.
+    HRESULT Commit();
+
+    const EffectConstantStats& Stats() const { return m_stats; }
+    void ResetStats();
+    void ReportStats(const char* name) const;
+
+private:
+    struct Parameter
+    {
+        std::string name;
+        D3DXHANDLE  handle;
+        UINT        offset;         // into m_shadow, bytes
+        UINT        bytes;
+        UINT        matrices;       // matrix parameters: element count
+        bool        rawAllowed;     // float4 array: partial uploads with SetRawValue
+        UINT        dirtyBegin;     // bytes, relative to offset
+        UINT        dirtyEnd;       // dirtyBegin == dirtyEnd: clean
+    };
+
+    void MarkDirty(Parameter& p, UINT begin, UINT end);
+
+    ID3DXEffect*           m_pEffect;
+    std::vector<Parameter> m_params;
+    std::vector<int>       m_dirty;     // indices into m_params
+    std::vector<char>      m_shadow;
+    EffectConstantStats    m_stats;
+};
+
+#endif // EFFECT_CONSTANTS_H
@@ -0,0 +1,140 @@
+//=============================================================================
+// FileUtil.cpp
+//=============================================================================
+
+#include "FileUtil.h"
+#include <cstdio>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <stdlib.h>
+#include <limits.h>
+#include <sys/stat.h>
+#endif
+
+
+bool FileExists(const char* path)
+{
+#ifdef _WIN32
+    DWORD attr = GetFileAttributesA(path);
+    return attr != INVALID_FILE_ATTRIBUTES && !(attr & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat st;
+    return stat(path, &st) == 0 && S_ISREG(st.st_mode);
+#endif
+}
+
+bool CanonicalPath(const char* path, std::string& out)
+{
+#ifdef _WIN32
+    char full[MAX_PATH];
+    DWORD len = GetFullPathNameA(path, MAX_PATH, full, NULL);
+    if (len == 0 || len >= MAX_PATH)
+        return false;
+
+    // '/' is never a trail byte, so this is safe on multibyte paths.
+    for (DWORD c = 0; c < len; ++c)
+    {
+        if (full[c] == '/')
+            full[c] = '\\';
+    }
+    out.assign(full, len);
+    return true;
+#else
+    char full[PATH_MAX];
+    if (realpath(path, full) == NULL)
+        return false;
+    out = full;
+    return true;
+#endif
+}
+
+void FoldCase(std::string& s)
+{
+    if (s.empty())
+        return;
+#ifdef _WIN32
+    // Per-byte tolower would rewrite DBCS trail bytes (CP949 uses 0x41-0x5A).
+    CharLowerBuffA(&s[0], (DWORD)s.size());
+#else
+    for (size_t i = 0; i < s.size(); ++i)
+    {
+        if (s[i] >= 'A' && s[i] <= 'Z')
+            s[i] = (char)(s[i] - 'A' + 'a');
+    }
+#endif
+}
+
+std::string PathKey(const std::string& path)
+{
+    std::string key = path;
+#ifdef _WIN32
+    FoldCase(key);
+#endif
+    return key;
+}
+
+std::string DirectoryOf(const std::string& path)
+{
+    size_t slash = path.find_last_of("\\/");
+    return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+std::string FileNameOf(const std::string& path)
+{
+    size_t slash = path.find_last_of("\\/");
+    return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+bool ReadFileBytes(const char* path, std::vector<char>& bytes)
+{
+    FILE* fp = fopen(path, "rb");
+    if (fp == NULL)
+        return false;
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fseek(fp, 0, SEEK_SET);
+
+    bool ok = size >= 0;
+    if (ok)
+    {
+        bytes.resize((size_t)size);
+        ok = size == 0 || fread(&bytes[0], 1, (size_t)size, fp) == (size_t)size;
+    }
+    fclose(fp);
+    return ok;
+}
+
+bool WriteFileBytes(const char* path, const void* pData, size_t size)
+{
+    std::string temp = std::string(path) + ".tmp";
+    FILE* fp = fopen(temp.c_str(), "wb");
+    if (fp == NULL)
+        return false;
+
+    bool ok = size == 0 || fwrite(pData, 1, size, fp) == size;
+    ok = fclose(fp) == 0 && ok;
+
+#ifdef _WIN32
+    ok = ok && MoveFileExA(temp.c_str(), path, MOVEFILE_REPLACE_EXISTING);
+    if (!ok)
+        DeleteFileA(temp.c_str());
+#else
+    ok = ok && rename(temp.c_str(), path) == 0;
+    if (!ok)
+        remove(temp.c_str());
+#endif
+    return ok;
+}
+
+bool MakeDirectory(const char* path)
+{
+#ifdef _WIN32
+    return CreateDirectoryA(path, NULL) || GetLastError() == ERROR_ALREADY_EXISTS;
+#else
+    struct stat st;
+    return mkdir(path, 0777) == 0 || (stat(path, &st) == 0 && S_ISDIR(st.st_mode));
+#endif
+}
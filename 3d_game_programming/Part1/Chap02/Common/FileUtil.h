@@ -0,0 +1,54 @@
+//=============================================================================
+// FileUtil.h
+//
+// Small file helpers shared by the asset loaders.  Paths are plain narrow
+// strings, like the rest of the samples (MultiByte character set).
+//=============================================================================
+
+#ifndef FILE_UTIL_H
+#define FILE_UTIL_H
+
+#include <string>
+#include <vector>
+
+
+#ifdef _WIN32
+const char PATH_SEPARATOR = '\\';
+#else
+const char PATH_SEPARATOR = '/';
+#endif
+
+
+// True if path names an existing regular file.
+bool FileExists(const char* path);
+
+// Absolute, normalised form of an existing file's path, with backslashes
+// on Windows.  Its case is left alone so it can still be opened; compare
+// or key paths by PathKey().
+bool CanonicalPath(const char* path, std::string& out);
+
+// Lower-cases s in place without touching multibyte characters: through
+// the ANSI code page on Windows, ASCII only elsewhere (safe for UTF-8).
+void FoldCase(std::string& s);
+
+// A path as the file system compares it: case-folded on Windows, where
+// NTFS ignores case, unchanged elsewhere.  Only for keys, never for I/O.
+std::string PathKey(const std::string& path);
+
+// Directory part of a path including the trailing separator ("" if none).
+std::string DirectoryOf(const std::string& path);
+
+// File name part of a path.
+std::string FileNameOf(const std::string& path);
+
+// Reads a whole file into memory.
+bool ReadFileBytes(const char* path, std::vector<char>& bytes);
+
+// Writes a whole file.  The data goes to a temporary file that then
+// replaces path, so a reader never sees a half-written file.
+bool WriteFileBytes(const char* path, const void* pData, size_t size);
+
+// Creates a directory (one level).  True if it exists afterwards.
+bool MakeDirectory(const char* path);
+
+#endif // FILE_UTIL_H
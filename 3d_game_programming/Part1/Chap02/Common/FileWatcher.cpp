@@ -0,0 +1,316 @@
+//=============================================================================
+// FileWatcher.cpp
+//=============================================================================
+
+#include "FileWatcher.h"
+#include "FileUtil.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#endif
+
+
+#ifdef _WIN32
+
+//===============================================================
+// Win32: one overlapped ReadDirectoryChangesW per directory.
+
+struct FileWatcher::Directory
+{
+    std::string path;
+    HANDLE      handle;
+    OVERLAPPED  overlapped;
+    DWORD       buffer[4096];   // DWORD aligned as the API requires
+
+    bool Arm()
+    {
+        ZeroMemory(&overlapped.Internal, sizeof(overlapped) - sizeof(overlapped.hEvent));
+        return ReadDirectoryChangesW(handle, buffer, sizeof(buffer), FALSE,
+                                     FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME,
+                                     NULL, &overlapped, NULL) != 0;
+    }
+};
+
+FileWatcher::FileWatcher()
+{
+    m_wakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+}
+
+FileWatcher::~FileWatcher()
+{
+    for (std::map<std::string, Directory*>::iterator it = m_directories.begin(); it != m_directories.end(); ++it)
+    {
+        CancelIo(it->second->handle);
+        CloseHandle(it->second->handle);
+        CloseHandle(it->second->overlapped.hEvent);
+        delete it->second;
+    }
+    CloseHandle((HANDLE)m_wakeEvent);
+}
+
+FileWatcher::Directory* FileWatcher::FindOrAddDirectory(const std::string& dir)
+{
+    std::map<std::string, Directory*>::iterator it = m_directories.find(PathKey(dir));
+    if (it != m_directories.end())
+        return it->second;
+
+    // WaitForMultipleObjects limit, one slot is the wake event.
+    if (m_directories.size() >= MAXIMUM_WAIT_OBJECTS - 1)
+        return NULL;
+
+    HANDLE h = CreateFileA(dir.c_str(), FILE_LIST_DIRECTORY,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                           OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL);
+    if (h == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    Directory* d = new Directory;
+    d->path   = dir;
+    d->handle = h;
+    ZeroMemory(&d->overlapped, sizeof(d->overlapped));
+    d->overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if (!d->Arm())
+    {
+        CloseHandle(d->overlapped.hEvent);
+        CloseHandle(h);
+        delete d;
+        return NULL;
+    }
+
+    m_directories[PathKey(dir)] = d;
+    return d;
+}
+
+bool FileWatcher::Wait(std::vector<std::string>& changed, unsigned timeoutMs)
+{
+    std::vector<Directory*> dirs;
+    std::vector<HANDLE>     events;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (std::map<std::string, Directory*>::iterator it = m_directories.begin(); it != m_directories.end(); ++it)
+        {
+            dirs.push_back(it->second);
+            events.push_back(it->second->overlapped.hEvent);
+        }
+    }
+    events.push_back((HANDLE)m_wakeEvent);
+
+    DWORD r = WaitForMultipleObjects((DWORD)events.size(), &events[0], FALSE, timeoutMs);
+    if (r == WAIT_TIMEOUT || r == WAIT_OBJECT_0 + dirs.size())
+        return true;
+    if (r == WAIT_FAILED)
+        return false;
+
+    std::set<std::string> out;
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (size_t i = 0; i < dirs.size(); ++i)
+    {
+        Directory* d = dirs[i];
+        DWORD bytes = 0;
+        if (!GetOverlappedResult(d->handle, &d->overlapped, &bytes, FALSE))
+            continue;
+
+        if (bytes > 0)
+        {
+            const BYTE* p = (const BYTE*)d->buffer;
+            for (;;)
+            {
+                const FILE_NOTIFY_INFORMATION* info = (const FILE_NOTIFY_INFORMATION*)p;
+                if (info->Action == FILE_ACTION_MODIFIED || info->Action == FILE_ACTION_ADDED ||
+                    info->Action == FILE_ACTION_RENAMED_NEW_NAME)
+                {
+                    char name[MAX_PATH];
+                    int len = WideCharToMultiByte(CP_ACP, 0, info->FileName,
+                                                  (int)(info->FileNameLength / sizeof(WCHAR)),
+                                                  name, MAX_PATH - 1, NULL, NULL);
+                    Notify(d, std::string(name, len), out);
+                }
+                if (info->NextEntryOffset == 0)
+                    break;
+                p += info->NextEntryOffset;
+            }
+        }
+        ResetEvent(d->overlapped.hEvent);
+        d->Arm();
+    }
+
+    changed.insert(changed.end(), out.begin(), out.end());
+    return true;
+}
+
+void FileWatcher::Wake()
+{
+    SetEvent((HANDLE)m_wakeEvent);
+}
+
+#else
+
+//===============================================================
+// Linux: a single inotify instance, one watch descriptor per directory.
+// A pipe lets Wake() interrupt poll().
+
+struct FileWatcher::Directory
+{
+    std::string path;
+    int         wd;
+};
+
+FileWatcher::FileWatcher()
+{
+    m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (pipe(m_wakePipe) != 0)
+        m_wakePipe[0] = m_wakePipe[1] = -1;
+    else
+        fcntl(m_wakePipe[0], F_SETFL, O_NONBLOCK);
+}
+
+FileWatcher::~FileWatcher()
+{
+    for (std::map<std::string, Directory*>::iterator it = m_directories.begin(); it != m_directories.end(); ++it)
+        delete it->second;
+
+    if (m_inotify >= 0)
+        close(m_inotify);
+    if (m_wakePipe[0] >= 0)
+    {
+        close(m_wakePipe[0]);
+        close(m_wakePipe[1]);
+    }
+}
+
+FileWatcher::Directory* FileWatcher::FindOrAddDirectory(const std::string& dir)
+{
+    std::map<std::string, Directory*>::iterator it = m_directories.find(PathKey(dir));
+    if (it != m_directories.end())
+        return it->second;
+
+    if (m_inotify < 0)
+        return NULL;
+
+    // IN_CLOSE_WRITE rather than IN_MODIFY: reload once the writer is done.
+    int wd = inotify_add_watch(m_inotify, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+    if (wd < 0)
+        return NULL;
+
+    Directory* d = new Directory;
+    d->path = dir;
+    d->wd   = wd;
+    m_directories[PathKey(dir)] = d;
+    return d;
+}
+
+bool FileWatcher::Wait(std::vector<std::string>& changed, unsigned timeoutMs)
+{
+    if (m_inotify < 0)
+        return false;
+
+    pollfd fds[2];
+    fds[0].fd = m_inotify;    fds[0].events = POLLIN; fds[0].revents = 0;
+    fds[1].fd = m_wakePipe[0]; fds[1].events = POLLIN; fds[1].revents = 0;
+
+    int r = poll(fds, m_wakePipe[0] >= 0 ? 2 : 1, (int)timeoutMs);
+    if (r < 0)
+        return errno == EINTR;
+
+    if (fds[1].revents & POLLIN)
+    {
+        char drain[64];
+        while (read(m_wakePipe[0], drain, sizeof(drain)) > 0) {}
+    }
+    if (!(fds[0].revents & POLLIN))
+        return true;
+
+    std::set<std::string> out;
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Aligned as inotify_event requires.
+    char buffer[16 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+    for (;;)
+    {
+        ssize_t len = read(m_inotify, buffer, sizeof(buffer));
+        if (len <= 0)
+            break;
+
+        for (char* p = buffer; p < buffer + len; )
+        {
+            const inotify_event* ev = (const inotify_event*)p;
+            p += sizeof(inotify_event) + ev->len;
+
+            if (ev->len == 0)
+                continue;
+
+            for (std::map<std::string, Directory*>::iterator it = m_directories.begin(); it != m_directories.end(); ++it)
+            {
+                if (it->second->wd == ev->wd)
+                {
+                    Notify(it->second, ev->name, out);
+                    break;
+                }
+            }
+        }
+    }
+
+    changed.insert(changed.end(), out.begin(), out.end());
+    return true;
+}
+
+void FileWatcher::Wake()
+{
+    if (m_wakePipe[1] >= 0)
+    {
+        char c = 0;
+        ssize_t ignored = write(m_wakePipe[1], &c, 1);
+        (void)ignored;
+    }
+}
+
+#endif
+
+
+//===============================================================
+// Shared part
+
+bool FileWatcher::Watch(const char* path, std::string* canonicalOut)
+{
+    std::string canonical;
+    if (!CanonicalPath(path, canonical))
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Directory paths are stored without the trailing separator.
+    std::string dir = DirectoryOf(canonical);
+    if (dir.size() > 1)
+        dir.erase(dir.size() - 1);
+
+    if (FindOrAddDirectory(dir) == NULL)
+        return false;
+
+    // The first spelling of a file wins, so callers can compare paths.
+    std::string& stored = m_files[PathKey(canonical)];
+    if (stored.empty())
+        stored = canonical;
+    if (canonicalOut)
+        *canonicalOut = stored;
+    return true;
+}
+
+void FileWatcher::Unwatch(const std::string& canonicalPath)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_files.erase(PathKey(canonicalPath));
+}
+
+void FileWatcher::Notify(Directory* d, const std::string& fileName, std::set<std::string>& out)
+{
+    std::map<std::string, std::string>::const_iterator it = m_files.find(PathKey(d->path + PATH_SEPARATOR + fileName));
+    if (it != m_files.end())
+        out.insert(it->second);
+}
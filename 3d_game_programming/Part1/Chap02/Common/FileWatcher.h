@@ -0,0 +1,61 @@
+//=============================================================================
+// FileWatcher.h
+//
+// Reports modifications of individual files.  Watches are placed on the
+// containing directories (inotify on Linux, ReadDirectoryChangesW on
+// Windows) so that editors which save through a temporary file and a
+// rename are caught as well.
+//
+// The watcher has no thread of its own; Wait() blocks the caller, which in
+// practice is the HotReloader's background thread.
+//=============================================================================
+
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <mutex>
+
+
+class FileWatcher
+{
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    // path must exist; it is stored in canonical form (see CanonicalPath).
+    // Watching the same file again, in any case, returns the first form,
+    // which is also what Wait() reports.
+    bool Watch(const char* path, std::string* canonicalOut = NULL);
+    void Unwatch(const std::string& canonicalPath);
+
+    // Blocks for up to timeoutMs and appends every watched file that was
+    // written or replaced to 'changed' (each file at most once per call).
+    // Returns false if the watcher could not be initialised.
+    bool Wait(std::vector<std::string>& changed, unsigned timeoutMs);
+
+    // Makes a blocked Wait() return early (used on shutdown).
+    void Wake();
+
+private:
+    struct Directory;
+
+    Directory* FindOrAddDirectory(const std::string& dir);
+    void       Notify(Directory* d, const std::string& fileName, std::set<std::string>& out);
+
+    std::mutex                         m_mutex;
+    std::map<std::string, std::string> m_files;        // PathKey -> canonical path
+    std::map<std::string, Directory*>  m_directories;  // PathKey of dir -> watch
+
+#ifdef _WIN32
+    void* m_wakeEvent;
+#else
+    int   m_inotify;
+    int   m_wakePipe[2];
+#endif
+};
+
+#endif // FILE_WATCHER_H
@@ -0,0 +1,87 @@
+//=============================================================================
+// FrameArena.cpp
+//=============================================================================
+
+#include "FrameArena.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define snprintf _snprintf
+#endif
+
+
+FrameArena g_frameArena;
+
+
+FrameArena::FrameArena(unsigned numFrames, size_t pageBytes)
+    : m_numFrames(std::min(std::max(numFrames, 1u), MAX_FRAMES)),
+      m_current(0)
+{
+    for (unsigned i = 0; i < MAX_FRAMES; ++i)
+        m_allocators[i] = i < m_numFrames ? new LinearAllocator(pageBytes) : NULL;
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+FrameArena::~FrameArena()
+{
+    for (unsigned i = 0; i < MAX_FRAMES; ++i)
+        delete m_allocators[i];
+}
+
+void FrameArena::BeginFrame()
+{
+    m_stats.peakBytes         = std::max(m_stats.peakBytes, m_allocators[m_current]->BytesUsed());
+    m_stats.totalAllocations += m_stats.allocations;
+    m_stats.allocations       = 0;
+    ++m_stats.frames;
+
+    // The allocator being reused was last filled NumFrames() frames ago.
+    m_current = (m_current + 1) % m_numFrames;
+    m_allocators[m_current]->Reset();
+}
+
+const char* FrameArena::CopyString(const char* s)
+{
+    size_t length = strlen(s);
+    char* copy = static_cast<char*>(Allocate(length + 1, 1));
+    if (copy != NULL)
+        memcpy(copy, s, length + 1);
+    return copy;
+}
+
+void FrameArena::Release()
+{
+    for (unsigned i = 0; i < m_numFrames; ++i)
+        m_allocators[i]->Release();
+}
+
+const FrameArenaStats& FrameArena::Stats() const
+{
+    m_stats.bytes         = m_allocators[m_current]->BytesUsed();
+    m_stats.reservedBytes = 0;
+    for (unsigned i = 0; i < m_numFrames; ++i)
+        m_stats.reservedBytes += m_allocators[i]->BytesReserved();
+    return m_stats;
+}
+
+void FrameArena::ReportStats(const char* name) const
+{
+    const FrameArenaStats& s = Stats();
+    unsigned frames = std::max(s.frames, 1u);
+
+    char msg[256];
+    snprintf(msg, sizeof(msg),
+             "[FrameArena] %s: %u frames x %u buffers, %.1f allocations per frame, peak %u KB per frame, %u KB reserved\n",
+             name, s.frames, m_numFrames, (double)s.totalAllocations / frames,
+             (unsigned)(std::max(s.peakBytes, s.bytes) / 1024), (unsigned)(s.reservedBytes / 1024));
+#ifdef _WIN32
+    OutputDebugStringA(msg);
+#endif
+    fputs(msg, stderr);
+}
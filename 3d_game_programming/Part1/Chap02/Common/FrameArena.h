@@ -0,0 +1,170 @@
+//=============================================================================
+// FrameArena.h
+//
+// Frame-scoped memory for data that only lives for a frame or two: visible
+// lists, per-object matrices and constants, resolved resource pointers,
+// formatted strings.  Building such data with new[], std::vector or
+// std::string costs a heap call per object per frame; the arena hands it
+// out from a LinearAllocator instead and frees all of it at once.
+//
+// The arena keeps NumFrames() allocators (default 3) and uses them in turn.
+// BeginFrame() moves to the next one and rewinds it, so what was allocated
+// during frame N stays valid until BeginFrame() of frame N + NumFrames() and
+// can be handed to work that finishes a frame or two later (a render
+// thread, commands waiting for the GPU):
+//
+//     g_frameArena.BeginFrame();
+//     IDirect3DTexture9** ppTextures = g_frameArena.Allocate<IDirect3DTexture9*>( numMaterials );
+//     FrameVector<unsigned>::Type visible( g_frameArena );
+//     visible.reserve( numObjects );
+//
+// Memory is never freed individually and no destructors run, so only put
+// objects in it whose destructors would only have freed memory.
+// FrameAllocator<T> lets standard containers allocate from it; their
+// deallocate() does nothing, so reserve() up front instead of letting a
+// container grow.  The arena is not thread safe; threads recording in
+// parallel use their own LinearAllocators (see CommandBuffer.h).
+//=============================================================================
+
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include "LinearAllocator.h"
+#include <cstddef>
+#include <new>
+#include <string>
+#include <vector>
+
+
+struct FrameArenaStats
+{
+    unsigned           allocations;         // Allocate() calls in the current frame
+    size_t             bytes;               // used in the current frame, with padding
+    size_t             peakBytes;           // largest frame so far
+    size_t             reservedBytes;       // held in pages by all frames
+    unsigned           frames;              // BeginFrame() calls
+    unsigned long long totalAllocations;    // Allocate() calls over all frames
+};
+
+
+class FrameArena
+{
+public:
+    static const unsigned MAX_FRAMES         = 4;
+    static const size_t   DEFAULT_PAGE_BYTES = 256 * 1024;
+
+    // numFrames: how many frames an allocation stays valid, counting the
+    // one it was made in (2 double, 3 triple buffers); at most MAX_FRAMES.
+    explicit FrameArena(unsigned numFrames = 3, size_t pageBytes = DEFAULT_PAGE_BYTES);
+    ~FrameArena();
+
+    // Starts a new frame and frees the allocations made NumFrames() ago.
+    void BeginFrame();
+
+    unsigned NumFrames() const { return m_numFrames; }
+
+    void* Allocate(size_t bytes, size_t alignment = 16)
+    {
+        ++m_stats.allocations;
+        return m_allocators[m_current]->Allocate(bytes, alignment);
+    }
+
+    // Uninitialised storage for count Ts.
+    template<typename T>
+    T* Allocate(size_t count = 1) { return static_cast<T*>(Allocate(count * sizeof(T), __alignof(T))); }
+
+    // count default-constructed Ts.
+    template<typename T>
+    T* New(size_t count = 1)
+    {
+        T* p = Allocate<T>(count);
+        for (size_t i = 0; p != NULL && i < count; ++i)
+            new (p + i) T();
+        return p;
+    }
+
+    // Copy of a NUL-terminated string.
+    const char* CopyString(const char* s);
+
+    // Frees every page of every frame.
+    void Release();
+
+    const FrameArenaStats& Stats() const;
+    void ReportStats(const char* name) const;
+
+private:
+    FrameArena(const FrameArena&);
+    FrameArena& operator=(const FrameArena&);
+
+    LinearAllocator*        m_allocators[MAX_FRAMES];
+    unsigned                m_numFrames;
+    unsigned                m_current;
+    mutable FrameArenaStats m_stats;
+};
+
+
+// One arena shared by the whole program (defined in FrameArena.cpp).
+extern FrameArena g_frameArena;
+
+
+//===============================================================
+// STL adapter
+
+template<typename T>
+class FrameAllocator
+{
+public:
+    typedef T              value_type;
+    typedef T*             pointer;
+    typedef const T*       const_pointer;
+    typedef T&             reference;
+    typedef const T&       const_reference;
+    typedef size_t         size_type;
+    typedef ptrdiff_t      difference_type;
+
+    template<typename U>
+    struct rebind { typedef FrameAllocator<U> other; };
+
+    FrameAllocator(FrameArena& arena = g_frameArena) : m_pArena(&arena) {}
+
+    template<typename U>
+    FrameAllocator(const FrameAllocator<U>& other) : m_pArena(other.Arena()) {}
+
+    FrameArena* Arena() const { return m_pArena; }
+
+    T* allocate(size_t count, const void* = NULL)
+    {
+        T* p = m_pArena->Allocate<T>(count);
+        if (p == NULL)
+            throw std::bad_alloc();
+        return p;
+    }
+
+    // Freed with the frame.
+    void deallocate(T*, size_t) {}
+
+    size_t max_size() const { return ~(size_t)0 / sizeof(T); }
+
+    T*       address(T& r) const       { return &r; }
+    const T* address(const T& r) const { return &r; }
+
+    void construct(T* p, const T& value) { new (p) T(value); }
+    void destroy(T* p)                   { p->~T(); }
+
+private:
+    FrameArena* m_pArena;
+};
+
+template<typename T, typename U>
+bool operator==(const FrameAllocator<T>& a, const FrameAllocator<U>& b) { return a.Arena() == b.Arena(); }
+
+template<typename T, typename U>
+bool operator!=(const FrameAllocator<T>& a, const FrameAllocator<U>& b) { return a.Arena() != b.Arena(); }
+
+// Containers over the arena: FrameVector<T>::Type v( g_frameArena );
+template<typename T>
+struct FrameVector { typedef std::vector< T, FrameAllocator<T> > Type; };
+
+typedef std::basic_string< char, std::char_traits<char>, FrameAllocator<char> > FrameString;
+
+#endif // FRAME_ARENA_H
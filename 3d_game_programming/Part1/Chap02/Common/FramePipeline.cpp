@@ -0,0 +1,32 @@
+//=============================================================================
+// FramePipeline.cpp
+//=============================================================================
+
+#include "FramePipeline.h"
+#include <cstdio>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define snprintf _snprintf
+#endif
+
+
+void ReportFramePipelineStats(const char* name, unsigned depth, const FramePipelineStats& stats)
+{
+    if (stats.frames == 0)
+        return;
+
+    char msg[256];
+    snprintf(msg, sizeof(msg),
+             "[Pipeline] %s: depth %u, %u frames, simulate %.3f ms, render thread waited %.3f ms, "
+             "latency %.3f ms (max %.3f) per frame\n",
+             name, depth, stats.frames, stats.simulateMs / stats.frames, stats.waitMs / stats.frames,
+             stats.latencyMs / stats.frames, stats.maxLatencyMs);
+#ifdef _WIN32
+    OutputDebugStringA(msg);
+#endif
+    fputs(msg, stderr);
+}
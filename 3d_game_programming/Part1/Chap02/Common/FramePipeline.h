@@ -0,0 +1,173 @@
+//=============================================================================
+// FramePipeline.h
+//
+// Overlaps a frame's simulation with the submission of the previous one.
+// Render() used to update everything (matrices, lights, culling) and then
+// issue the draw calls, so a frame cost the sum of both.  With a pipeline
+// the update runs as a job on the job system (JobSystem.h) and writes a
+// snapshot of everything the draw calls need, while the render thread is
+// still submitting an older snapshot:
+//
+//     depth 0   simulate N, submit N                     (serial)
+//     depth 1   simulate N+1 while submitting N          (double buffered)
+//     depth 2   simulate N+1, N+2 while submitting N     (triple buffered)
+//
+// The snapshot type is the sample's own struct; the pipeline keeps
+// depth + 1 of them, so simulation never writes a snapshot that is being
+// drawn.  Each frame:
+//
+//     const LightsSnapshot& s = g_pipeline.BeginFrame();   // waits for it if needed
+//     ... set s.world, s.light, s.material and draw ...
+//     g_pipeline.EndFrame();                               // after Present()
+//
+// The price is latency: what is drawn was simulated up to depth frames
+// earlier.  The pipeline measures it (simulation start to EndFrame()) next
+// to the time the render thread spent waiting for simulation.
+//
+// The simulate function runs on a worker thread (or inline, if the job
+// system has not been started).  It may use g_jobs itself, but must not
+// touch the device or anything the render thread writes, g_clock included:
+// BeginFrame() ticks g_clock (GameClock.h) once for every frame it queues
+// and hands the frame its game time.
+//=============================================================================
+
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include "JobSystem.h"
+#include "GameClock.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+
+struct FramePipelineStats
+{
+    unsigned frames;
+    double   waitMs;            // render thread blocked in BeginFrame(), total
+    double   simulateMs;        // inside the simulate function, total
+    double   latencyMs;         // simulation start to EndFrame(), total
+    double   maxLatencyMs;
+};
+
+// Prints stats as "[Pipeline] name: ..." (defined in FramePipeline.cpp).
+void ReportFramePipelineStats(const char* name, unsigned depth, const FramePipelineStats& stats);
+
+
+template<typename TSnapshot>
+class FramePipeline
+{
+public:
+    static const unsigned MAX_DEPTH = 3;
+
+    // Fills snapshot for the given frame number (0, 1, 2, ...) at game
+    // time seconds.
+    typedef void (*SimulateFunction)(TSnapshot& snapshot, unsigned frame, double time, void* pUser);
+
+    FramePipeline() : m_simulate(NULL), m_pUser(NULL), m_depth(0), m_nextSimulate(0), m_nextDraw(0)
+    {
+        ResetStats();
+    }
+
+    ~FramePipeline() { Stop(); }
+
+    void Start(SimulateFunction simulate, void* pUser, unsigned depth = 1)
+    {
+        Stop();
+        m_simulate     = simulate;
+        m_pUser        = pUser;
+        m_depth        = std::min(depth, MAX_DEPTH);
+        m_nextSimulate = 0;
+        m_nextDraw     = 0;
+        for (unsigned i = 0; i <= MAX_DEPTH; ++i)
+            m_slots[i].pOwner = this;
+        ResetStats();
+    }
+
+    // Waits for simulation still in flight.
+    void Stop()
+    {
+        for (unsigned i = 0; i <= MAX_DEPTH; ++i)
+            g_jobs.Wait(&m_slots[i].counter);
+        m_simulate = NULL;
+    }
+
+    unsigned Depth() const { return m_depth; }
+
+    // Queues simulation up to depth frames ahead and returns the snapshot of
+    // the oldest one, waiting for it to be simulated if necessary.  Valid
+    // until EndFrame().
+    const TSnapshot& BeginFrame()
+    {
+        while (m_nextSimulate <= m_nextDraw + m_depth)
+        {
+            Slot& slot = m_slots[m_nextSimulate % (m_depth + 1)];
+            slot.frame = m_nextSimulate++;
+            g_clock.Tick();
+            slot.time = g_clock.Seconds();
+            g_jobs.Run(SimulateJob, &slot, 0, 1, &slot.counter);
+        }
+
+        Slot& slot = m_slots[m_nextDraw % (m_depth + 1)];
+        double start = NowMs();
+        g_jobs.Wait(&slot.counter);
+        m_stats.waitMs += NowMs() - start;
+        return slot.snapshot;
+    }
+
+    // Frees the snapshot returned by BeginFrame().
+    void EndFrame()
+    {
+        Slot& slot = m_slots[m_nextDraw % (m_depth + 1)];
+        double latency = NowMs() - slot.startMs;
+        m_stats.simulateMs  += slot.simulateMs;
+        m_stats.latencyMs   += latency;
+        m_stats.maxLatencyMs = std::max(m_stats.maxLatencyMs, latency);
+        ++m_stats.frames;
+        ++m_nextDraw;
+    }
+
+    const FramePipelineStats& Stats() const { return m_stats; }
+    void ResetStats()                       { memset(&m_stats, 0, sizeof(m_stats)); }
+    void ReportStats(const char* name) const { ReportFramePipelineStats(name, m_depth, m_stats); }
+
+private:
+    struct Slot
+    {
+        Slot() : pOwner(NULL), frame(0), time(0.0), startMs(0.0), simulateMs(0.0) {}
+
+        FramePipeline* pOwner;
+        TSnapshot      snapshot;
+        JobCounter     counter;
+        unsigned       frame;
+        double         time;               // game seconds
+        double         startMs;
+        double         simulateMs;
+    };
+
+    FramePipeline(const FramePipeline&);
+    FramePipeline& operator=(const FramePipeline&);
+
+    static double NowMs()
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+    }
+
+    static void SimulateJob(void* pData, unsigned, unsigned)
+    {
+        Slot& slot = *static_cast<Slot*>(pData);
+        slot.startMs = NowMs();
+        slot.pOwner->m_simulate(slot.snapshot, slot.frame, slot.time, slot.pOwner->m_pUser);
+        slot.simulateMs = NowMs() - slot.startMs;
+    }
+
+    Slot               m_slots[MAX_DEPTH + 1];
+    SimulateFunction   m_simulate;
+    void*              m_pUser;
+    unsigned           m_depth;
+    unsigned           m_nextSimulate;     // next frame to queue for simulation
+    unsigned           m_nextDraw;         // frame BeginFrame() returns
+    FramePipelineStats m_stats;
+};
+
+#endif // FRAME_PIPELINE_H
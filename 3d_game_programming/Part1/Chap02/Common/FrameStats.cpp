@@ -0,0 +1,337 @@
+//=============================================================================
+// FrameStats.cpp
+//=============================================================================
+
+#include "FrameStats.h"
+#include <cstdio>
+#include <cstring>
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define snprintf _snprintf
+#endif
+
+
+FrameStats g_frameStats;
+
+
+namespace
+{
+    // Vertices (or indices) primCount primitives of type read.
+    unsigned long long VertexCount(D3DPRIMITIVETYPE type, UINT primCount)
+    {
+        if (primCount == 0)
+            return 0;
+        switch (type)
+        {
+        case D3DPT_POINTLIST:       return primCount;
+        case D3DPT_LINELIST:        return 2ull * primCount;
+        case D3DPT_LINESTRIP:       return primCount + 1ull;
+        case D3DPT_TRIANGLELIST:    return 3ull * primCount;
+        case D3DPT_TRIANGLESTRIP:
+        case D3DPT_TRIANGLEFAN:     return primCount + 2ull;
+        default:                    return 0;
+        }
+    }
+
+    bool EndsWith(const std::string& s, const char* suffix)
+    {
+        size_t n = strlen(suffix);
+        return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+    }
+
+    void WriteCsvHeader(FILE* pFile)
+    {
+        fputs("frame,ms,draws,clears,primitives,vertices,locks,lockBytes,textureBinds", pFile);
+        for (int k = 0; k < NUM_STATE_KINDS; ++k)
+            fprintf(pFile, ",%s", StateKindName(k));
+        for (int k = 0; k < NUM_STATE_KINDS; ++k)
+            fprintf(pFile, ",%sRedundant", StateKindName(k));
+        fputc('\n', pFile);
+    }
+
+    void WriteCsvRow(FILE* pFile, const FrameStatsRecord& f)
+    {
+        fprintf(pFile, "%u,%.3f,%u,%u,%llu,%llu,%u,%llu,%u", f.frame, f.ms, f.draws, f.clears,
+                f.primitives, f.vertices, f.locks, f.lockBytes, f.textureBinds);
+        for (int k = 0; k < NUM_STATE_KINDS; ++k)
+            fprintf(pFile, ",%u", f.stateChanges[k]);
+        for (int k = 0; k < NUM_STATE_KINDS; ++k)
+            fprintf(pFile, ",%u", f.redundant[k]);
+        fputc('\n', pFile);
+    }
+
+    // One object, without the separator or line break.
+    void WriteJsonObject(FILE* pFile, const FrameStatsRecord& f)
+    {
+        fprintf(pFile, "{\"frame\":%u,\"ms\":%.3f,\"draws\":%u,\"clears\":%u,\"primitives\":%llu,\"vertices\":%llu,"
+                       "\"locks\":%u,\"lockBytes\":%llu,\"textureBinds\":%u,\"stateChanges\":{",
+                f.frame, f.ms, f.draws, f.clears, f.primitives, f.vertices, f.locks, f.lockBytes, f.textureBinds);
+        for (int k = 0; k < NUM_STATE_KINDS; ++k)
+            fprintf(pFile, "%s\"%s\":%u", k ? "," : "", StateKindName(k), f.stateChanges[k]);
+        fputs("},\"redundant\":{", pFile);
+        for (int k = 0; k < NUM_STATE_KINDS; ++k)
+            fprintf(pFile, "%s\"%s\":%u", k ? "," : "", StateKindName(k), f.redundant[k]);
+        fputs("}}", pFile);
+    }
+}
+
+
+FrameStats::FrameStats()
+    : m_history(HISTORY)
+    , m_next(0)
+    , m_count(0)
+    , m_lastEnd(std::chrono::steady_clock::now())
+    , m_pLog(NULL)
+    , m_logJson(false)
+    , m_logOpened(false)
+    , m_logFailed(false)
+    , m_logRows(0)
+{
+    memset(&m_lastStates, 0, sizeof(m_lastStates));
+    memset(&m_current, 0, sizeof(m_current));
+}
+
+FrameStats::~FrameStats()
+{
+    CloseLog();
+}
+
+void FrameStats::ResetCurrent()
+{
+    unsigned frame = m_current.frame;
+    memset(&m_current, 0, sizeof(m_current));
+    m_current.frame = frame;
+}
+
+void FrameStats::Draw(D3DPRIMITIVETYPE type, UINT primCount)
+{
+    ++m_current.draws;
+    m_current.primitives += primCount;
+    m_current.vertices   += VertexCount(type, primCount);
+}
+
+void FrameStats::DrawSubset(ID3DXMesh* pMesh, DWORD attribute)
+{
+    // Subsets are indexed triangle lists; their size is in the attribute
+    // table.  A mesh without one is drawn whole.
+    DWORD       numFaces = pMesh->GetNumFaces();
+    MeshRanges& m        = m_meshRanges[pMesh];
+    if (m.numFaces != numFaces)
+    {
+        DWORD numRanges = 0;
+        pMesh->GetAttributeTable(NULL, &numRanges);
+        m.numFaces = numFaces;
+        m.ranges.resize(numRanges);
+        if (numRanges > 0)
+            pMesh->GetAttributeTable(&m.ranges[0], &numRanges);
+        m.ranges.resize(numRanges);
+    }
+
+    if (m.ranges.empty())
+    {
+        Draw(D3DPT_TRIANGLELIST, numFaces);
+        return;
+    }
+
+    UINT faces = 0;
+    for (size_t i = 0; i < m.ranges.size(); ++i)
+    {
+        if (m.ranges[i].AttribId == attribute)
+            faces += m.ranges[i].FaceCount;
+    }
+    Draw(D3DPT_TRIANGLELIST, faces);
+}
+
+void FrameStats::EndFrame(const StateCacheStats& states)
+{
+    // The cache's counters only grow, unless someone reset them.
+    for (int k = 0; k < NUM_STATE_KINDS; ++k)
+    {
+        unsigned forwarded = states.forwarded[k], filtered = states.filtered[k];
+        m_current.stateChanges[k] = forwarded - (forwarded >= m_lastStates.forwarded[k] ? m_lastStates.forwarded[k] : 0);
+        m_current.redundant[k]    = filtered  - (filtered  >= m_lastStates.filtered[k]  ? m_lastStates.filtered[k]  : 0);
+    }
+    m_current.textureBinds = m_current.stateChanges[STATE_TEXTURE];
+    m_lastStates = states;
+
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    m_current.ms = std::chrono::duration<double, std::milli>(now - m_lastEnd).count();
+    m_lastEnd = now;
+
+    m_history[m_next] = m_current;
+    m_next = (m_next + 1) % HISTORY;
+    if (m_count < HISTORY)
+        ++m_count;
+
+    if (!m_logPath.empty())
+        AppendLog(m_current);
+
+    ++m_current.frame;
+    ResetCurrent();
+}
+
+const FrameStatsRecord& FrameStats::Frame(unsigned i) const
+{
+    return m_history[(m_next + HISTORY - m_count + i) % HISTORY];
+}
+
+bool FrameStats::ParseCommandLine(const char* cmdLine)
+{
+    const char* p = cmdLine ? strstr(cmdLine, "-stats ") : NULL;
+    if (p == NULL)
+        return false;
+
+    // The file name runs to the next space, or to the closing quote.
+    p += strlen("-stats ");
+    while (*p == ' ')
+        ++p;
+    if (*p == '"')
+    {
+        const char* end = strchr(p + 1, '"');
+        SetLogPath(std::string(p + 1, end ? end : p + strlen(p)).c_str());
+    }
+    else
+    {
+        const char* end = strchr(p, ' ');
+        SetLogPath(std::string(p, end ? end : p + strlen(p)).c_str());
+    }
+    return !m_logPath.empty();
+}
+
+void FrameStats::SetLogPath(const char* path)
+{
+    CloseLog();
+    m_logPath   = path ? path : "";
+    m_logOpened = false;
+    m_logFailed = false;
+}
+
+
+//===============================================================
+// Logs
+
+void FrameStats::AppendLog(const FrameStatsRecord& f)
+{
+    if (m_pLog == NULL)
+    {
+        // Once per path: reopening would truncate it.
+        if (m_logOpened || m_logFailed)
+            return;
+        m_pLog = fopen(m_logPath.c_str(), "w");
+        if (m_pLog == NULL)
+        {
+            m_logFailed = true;
+            return;
+        }
+        m_logOpened = true;
+        m_logJson   = EndsWith(m_logPath, ".json");
+        m_logRows = 0;
+        if (m_logJson)
+            fputs("[\n", m_pLog);
+        else
+            WriteCsvHeader(m_pLog);
+    }
+
+    if (m_logJson)
+    {
+        if (m_logRows)
+            fputs(",\n", m_pLog);
+        WriteJsonObject(m_pLog, f);
+    }
+    else
+        WriteCsvRow(m_pLog, f);
+
+    if (++m_logRows % FLUSH_INTERVAL == 0)
+        fflush(m_pLog);
+}
+
+bool FrameStats::CloseLog()
+{
+    if (m_pLog == NULL)
+        return !m_logFailed;
+
+    if (m_logJson)
+        fputs(m_logRows ? "\n]\n" : "]\n", m_pLog);
+    bool ok = !ferror(m_pLog);
+    ok = fclose(m_pLog) == 0 && ok;
+    m_pLog = NULL;
+    if (!ok)
+        m_logFailed = true;
+    return ok;
+}
+
+bool FrameStats::WriteCsv(const char* path) const
+{
+    FILE* pFile = fopen(path, "w");
+    if (pFile == NULL)
+        return false;
+
+    WriteCsvHeader(pFile);
+    for (unsigned i = 0; i < m_count; ++i)
+        WriteCsvRow(pFile, Frame(i));
+    return fclose(pFile) == 0;
+}
+
+bool FrameStats::WriteJson(const char* path) const
+{
+    FILE* pFile = fopen(path, "w");
+    if (pFile == NULL)
+        return false;
+
+    fputs("[\n", pFile);
+    for (unsigned i = 0; i < m_count; ++i)
+    {
+        WriteJsonObject(pFile, Frame(i));
+        fputs(i + 1 < m_count ? ",\n" : "\n", pFile);
+    }
+    fputs("]\n", pFile);
+    return fclose(pFile) == 0;
+}
+
+void FrameStats::ReportStats(const char* name)
+{
+    char msg[512];
+    if (m_count != 0)
+    {
+        double ms = 0.0, draws = 0.0, primitives = 0.0, vertices = 0.0, changes = 0.0, redundant = 0.0;
+        double lockBytes = 0.0, textureBinds = 0.0;
+        for (unsigned i = 0; i < m_count; ++i)
+        {
+            const FrameStatsRecord& f = Frame(i);
+            ms           += f.ms;
+            draws        += f.draws;
+            primitives   += (double)f.primitives;
+            vertices     += (double)f.vertices;
+            lockBytes    += (double)f.lockBytes;
+            textureBinds += f.textureBinds;
+            for (int k = 0; k < NUM_STATE_KINDS; ++k)
+            {
+                changes   += f.stateChanges[k];
+                redundant += f.redundant[k];
+            }
+        }
+        double n = m_count;
+        snprintf(msg, sizeof(msg),
+                 "[FrameStats] %s: last %u frames, per frame %.3f ms, %.1f draws, %.0f primitives, %.0f vertices, "
+                 "%.1f state changes (+%.1f redundant), %.1f texture binds, %.0f bytes locked\n",
+                 name, m_count, ms / n, draws / n, primitives / n, vertices / n, changes / n, redundant / n,
+                 textureBinds / n, lockBytes / n);
+#ifdef _WIN32
+        OutputDebugStringA(msg);
+#endif
+        fputs(msg, stderr);
+    }
+
+    if (!m_logPath.empty())
+    {
+        unsigned rows = m_logRows;
+        if (CloseLog())
+            snprintf(msg, sizeof(msg), "[FrameStats] %s: %u frames logged to %s\n", name, rows, m_logPath.c_str());
+        else
+            snprintf(msg, sizeof(msg), "[FrameStats] %s: cannot write %s\n", name, m_logPath.c_str());
+#ifdef _WIN32
+        OutputDebugStringA(msg);
+#endif
+        fputs(msg, stderr);
+    }
+}
@@ -0,0 +1,131 @@
+//=============================================================================
+// FrameStats.h
+//
+// Per-frame rendering statistics: draws, primitives, vertices, state
+// changes by kind, buffer locks and texture binds, plus the time between
+// frames.  The counters are fed by the calls the samples already make:
+//
+//     StateCache          Clear() and the draw calls
+//     DynamicBuffer       Lock()
+//     the samples         Lock() of their static buffers
+//
+// and state changes are taken from the state cache's counters once per
+// frame, after Present():
+//
+//     g_frameStats.EndFrame( g_stateCache.Stats() );
+//
+// The last HISTORY frames are kept for ReportStats().  Started with
+// "-stats file.csv" (or .json) a sample also appends every frame to that
+// file as EndFrame() closes it: one row, through stdio's buffer, flushed
+// every FLUSH_INTERVAL frames so a crash loses no more than that.  The
+// file is never rewritten; it holds the whole run and is closed by
+// ReportStats().
+//=============================================================================
+
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include "StateCache.h"
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+
+struct FrameStatsRecord
+{
+    unsigned           frame;
+    double             ms;                      // since the previous EndFrame()
+    unsigned           draws;                   // DrawPrimitive, DrawIndexedPrimitive, DrawSubset
+    unsigned           clears;
+    unsigned long long primitives;
+    unsigned long long vertices;                // vertices (or indices) the draws read
+    unsigned           stateChanges[NUM_STATE_KINDS];  // reached the device
+    unsigned           redundant[NUM_STATE_KINDS];     // filtered by the state cache
+    unsigned           locks;
+    unsigned long long lockBytes;
+    unsigned           textureBinds;            // stateChanges[STATE_TEXTURE]
+};
+
+
+class FrameStats
+{
+public:
+    static const unsigned HISTORY      = 600;
+    static const unsigned FLUSH_INTERVAL = 60;
+
+    FrameStats();
+    ~FrameStats();
+
+    // Counters of the frame being drawn.
+    void Clear()                                   { ++m_current.clears; }
+    void Draw(D3DPRIMITIVETYPE type, UINT primCount);
+    void DrawSubset(ID3DXMesh* pMesh, DWORD attribute);     // reads the mesh's attribute table once
+    void Lock(UINT bytes)                          { ++m_current.locks; m_current.lockBytes += bytes; }
+
+    // Closes the frame.  states are the state cache's running counters;
+    // the frame gets the difference to the previous call.
+    void EndFrame(const StateCacheStats& states);
+
+    const FrameStatsRecord& Current() const { return m_current; }
+
+    // Kept frames, oldest first; Frame(NumFrames() - 1) is the last one.
+    unsigned NumFrames() const { return m_count; }
+    const FrameStatsRecord& Frame(unsigned i) const;
+
+    // Sets the log from "-stats path" in cmdLine; false if absent.  The
+    // log is JSON if the path ends in ".json", CSV otherwise, and is
+    // created by the next EndFrame().  Setting a new path closes the old
+    // log.
+    bool ParseCommandLine(const char* cmdLine);
+    void SetLogPath(const char* path);
+
+    // Finishes the log (the JSON array's closing bracket) and closes it
+    // for good; later frames are not logged.  False if it could not be
+    // written.
+    bool CloseLog();
+
+    // The kept frames as CSV (one row per frame) or JSON (an array of
+    // objects), for a snapshot besides the log.
+    bool WriteCsv(const char* path) const;
+    bool WriteJson(const char* path) const;
+
+    // Averages of the kept frames; also closes the log.
+    void ReportStats(const char* name);
+
+private:
+    FrameStats(const FrameStats&);
+    FrameStats& operator=(const FrameStats&);
+
+    // A mesh's attribute table, kept from its first DrawSubset().  Read
+    // again if the face count changes (the pointer was reused).
+    struct MeshRanges
+    {
+        DWORD                           numFaces;
+        std::vector<D3DXATTRIBUTERANGE> ranges;
+    };
+
+    void ResetCurrent();
+    void AppendLog(const FrameStatsRecord& f);
+
+    std::vector<FrameStatsRecord>         m_history;   // ring of HISTORY
+    unsigned                              m_next;      // slot of the next frame
+    unsigned                              m_count;
+    FrameStatsRecord                      m_current;
+    StateCacheStats                       m_lastStates;
+    std::chrono::steady_clock::time_point m_lastEnd;
+    std::string                           m_logPath;
+    FILE*                                 m_pLog;
+    bool                                  m_logJson;
+    bool                                  m_logOpened; // m_logPath was created
+    bool                                  m_logFailed; // don't retry every frame
+    unsigned                              m_logRows;
+    std::map<ID3DXMesh*, MeshRanges>      m_meshRanges;
+};
+
+
+// One collector shared by the whole program (defined in FrameStats.cpp).
+extern FrameStats g_frameStats;
+
+#endif // FRAME_STATS_H
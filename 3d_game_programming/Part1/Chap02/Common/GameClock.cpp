@@ -0,0 +1,115 @@
+//=============================================================================
+// GameClock.cpp
+//=============================================================================
+
+#include "GameClock.h"
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <chrono>
+#endif
+
+
+GameClock g_clock;
+
+
+unsigned long long ClockNanoseconds()
+{
+#ifdef _WIN32
+    // VS2013's steady_clock is only as fine as the system tick, so ask the
+    // performance counter directly.  Split the conversion so that counter *
+    // 1e9 cannot overflow.
+    static LARGE_INTEGER s_frequency = { 0 };
+    if (s_frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&s_frequency);
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    unsigned long long ticks = (unsigned long long)counter.QuadPart;
+    unsigned long long freq  = (unsigned long long)s_frequency.QuadPart;
+    return ticks / freq * 1000000000ull + ticks % freq * 1000000000ull / freq;
+#else
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+
+GameClock::GameClock()
+    : m_fixedStepNs(0)
+    , m_scale(1.0)
+    , m_paused(false)
+{
+    Reset();
+}
+
+void GameClock::Reset()
+{
+    m_lastRealNs = 0;
+    m_timeNs     = 0;
+    m_deltaNs    = 0;
+    m_carryNs    = 0.0;
+    m_frame      = 0;
+}
+
+void GameClock::Tick()
+{
+    unsigned long long now = ClockNanoseconds();
+
+    // The first frame is at game time 0.
+    unsigned long long step = 0;
+    if (m_frame != 0)
+    {
+        if (m_fixedStepNs)
+            step = m_fixedStepNs;
+        else
+        {
+            step = now - m_lastRealNs;
+            if (step > MAX_STEP)
+                step = MAX_STEP;
+        }
+    }
+    m_lastRealNs = now;
+    ++m_frame;
+
+    if (m_paused)
+        step = 0;
+
+    double scaled = step * m_scale + m_carryNs;
+    m_deltaNs = (unsigned long long)scaled;
+    m_carryNs = scaled - (double)m_deltaNs;
+    m_timeNs += m_deltaNs;
+}
+
+void GameClock::SetFixedStep(double stepsPerSecond)
+{
+    m_fixedStepNs = stepsPerSecond > 0.0 ? (unsigned long long)(1e9 / stepsPerSecond + 0.5) : 0;
+}
+
+double GameClock::FixedStep() const
+{
+    return m_fixedStepNs ? 1e9 / m_fixedStepNs : 0.0;
+}
+
+bool GameClock::ParseCommandLine(const char* cmdLine)
+{
+    if (cmdLine == NULL)
+        return false;
+
+    bool found = false;
+    const char* p = strstr(cmdLine, "-fixedstep ");
+    if (p)
+    {
+        SetFixedStep(atof(p + strlen("-fixedstep ")));
+        found = true;
+    }
+    p = strstr(cmdLine, "-timescale ");
+    if (p)
+    {
+        SetScale(atof(p + strlen("-timescale ")));
+        found = true;
+    }
+    return found;
+}
@@ -0,0 +1,90 @@
+//=============================================================================
+// GameClock.h
+//
+// Time source for animation.  The samples used to read timeGetTime() or
+// GetTickCount() wherever they animated something, which ties the motion to
+// a 1 ms (or 10-16 ms) timer and makes every frame sample a slightly
+// different instant.  Instead the clock is advanced once per frame:
+//
+//     g_clock.Tick();
+//     D3DXMatrixRotationY( &matWorld, (FLOAT)g_clock.Seconds() );
+//
+// and everything drawn in that frame sees the same game time.
+//
+// Real time comes from ClockNanoseconds(): QueryPerformanceCounter on
+// Windows, std::chrono::steady_clock elsewhere.  Game time follows it,
+// multiplied by the time scale, and stands still while paused.  A single
+// step is capped at MAX_STEP, so a breakpoint or a dragged window does not
+// make the animation jump.
+//
+// In fixed-step mode every Tick() advances game time by exactly the step,
+// however long the frame took, so runs are frame-for-frame reproducible
+// (captures, benchmarks).  Started with "-fixedstep 60" a sample animates
+// at 60 steps per second of game time; "-timescale 0.25" slows it down.
+//
+// Game time is kept in integer nanoseconds and starts at 0 on the first
+// Tick().  Only the thread that calls Tick() may read the clock; frames
+// simulated on other threads get their time from FramePipeline.
+//=============================================================================
+
+#ifndef GAME_CLOCK_H
+#define GAME_CLOCK_H
+
+
+// Monotonic real time in nanoseconds since an arbitrary point.
+unsigned long long ClockNanoseconds();
+
+
+class GameClock
+{
+public:
+    // Longest step a single Tick() takes in real-time mode.
+    static const unsigned long long MAX_STEP = 250000000ull;    // 250 ms
+
+    GameClock();
+
+    // Starts over: game time 0 at the next Tick().
+    void Reset();
+
+    // Advances game time to the current frame; call once per frame.
+    void Tick();
+
+    // Game time of the current frame and the step that led to it.
+    unsigned long long Nanoseconds() const { return m_timeNs; }
+    double             Seconds() const     { return m_timeNs * 1e-9; }
+    double             DeltaSeconds() const { return m_deltaNs * 1e-9; }
+
+    // Number of Tick() calls.
+    unsigned           Frame() const       { return m_frame; }
+
+    void   SetPaused(bool paused)          { m_paused = paused; }
+    bool   Paused() const                  { return m_paused; }
+
+    // Game seconds per real second (or per fixed step); negative is 0.
+    void   SetScale(double scale)          { m_scale = scale > 0.0 ? scale : 0.0; }
+    double Scale() const                   { return m_scale; }
+
+    // Steps per second of game time, or 0 to follow real time.
+    void   SetFixedStep(double stepsPerSecond);
+    double FixedStep() const;
+
+    // Reads "-fixedstep hz" and "-timescale s" from cmdLine; false if
+    // neither is present.
+    bool ParseCommandLine(const char* cmdLine);
+
+private:
+    unsigned long long m_lastRealNs;    // at the previous Tick()
+    unsigned long long m_timeNs;
+    unsigned long long m_deltaNs;
+    unsigned long long m_fixedStepNs;   // 0: real time
+    double             m_scale;
+    double             m_carryNs;       // fraction of a nanosecond left by scaling
+    unsigned           m_frame;
+    bool               m_paused;
+};
+
+
+// One clock shared by the whole program (defined in GameClock.cpp).
+extern GameClock g_clock;
+
+#endif // GAME_CLOCK_H
@@ -0,0 +1,438 @@
+//=============================================================================
+// HotReload.cpp
+//=============================================================================
+
+#include "HotReload.h"
+#include "AssetLoaders.h"
+#include "AssetPack.h"
+#include "FileUtil.h"
+#include <algorithm>
+#include <cstdio>
+
+
+HotReloader g_hotReload;
+
+
+namespace
+{
+    // AssetInclude that remembers the names the compiler asked for.
+    class IncludeRecorder : public AssetInclude
+    {
+    public:
+        STDMETHOD(Open)(D3DXINCLUDE_TYPE type, LPCSTR pFileName, LPCVOID pParentData,
+                        LPCVOID* ppData, UINT* pBytes)
+        {
+            HRESULT hr = AssetInclude::Open(type, pFileName, pParentData, ppData, pBytes);
+            if (SUCCEEDED(hr) && std::find(m_names.begin(), m_names.end(), pFileName) == m_names.end())
+                m_names.push_back(pFileName);
+            return hr;
+        }
+
+        const std::vector<std::string>& Names() const { return m_names; }
+
+    private:
+        std::vector<std::string> m_names;
+    };
+
+    // defines (name, value, ...) as the NULL-terminated array D3DX takes.
+    void MakeMacros(const std::vector<std::string>& defines, std::vector<D3DXMACRO>& macros)
+    {
+        for (size_t i = 0; i + 1 < defines.size(); i += 2)
+        {
+            D3DXMACRO m = { defines[i].c_str(), defines[i + 1].c_str() };
+            macros.push_back(m);
+        }
+        D3DXMACRO end = { NULL, NULL };
+        macros.push_back(end);
+    }
+}
+
+
+HotReloader::HotReloader()
+    : m_quit(false)
+{
+}
+
+HotReloader::~HotReloader()
+{
+    Stop();
+}
+
+void HotReloader::Start()
+{
+    if (m_thread.joinable())
+        return;
+
+    m_quit = false;
+    m_thread = std::thread(&HotReloader::ThreadMain, this);
+}
+
+void HotReloader::Stop()
+{
+    if (!m_thread.joinable())
+        return;
+
+    m_quit = true;
+    m_watcher.Wake();
+    m_thread.join();
+
+    // Drop work that was never swapped in.
+    for (size_t i = 0; i < m_ready.size(); ++i)
+    {
+        if (m_ready[i].pCompiled)
+            m_ready[i].pCompiled->Release();
+    }
+    m_ready.clear();
+}
+
+bool HotReloader::WatchEffect(EffectHandle h, const char* path, DWORD compileFlags,
+                              EffectReloadedCallback onReloaded, const D3DXMACRO* pDefines)
+{
+    Asset a;
+    a.type     = ASSET_EFFECT;
+    a.effect   = h;
+    a.flags    = compileFlags;
+    a.onEffect = onReloaded;
+    for (const D3DXMACRO* m = pDefines; m && m->Name; ++m)
+    {
+        a.defines.push_back(m->Name);
+        a.defines.push_back(m->Definition ? m->Definition : "");
+    }
+
+    // Which files it includes is only known from the source; preprocessing
+    // finds them without compiling.
+    std::vector<char> source;
+    if (ReadFileBytes(path, source) && !source.empty())
+    {
+        std::vector<D3DXMACRO> macros;
+        MakeMacros(a.defines, macros);
+        IncludeRecorder include;
+        ID3DXBuffer*    pText   = NULL;
+        ID3DXBuffer*    pErrors = NULL;
+        if (SUCCEEDED(D3DXPreprocessShader(&source[0], (UINT)source.size(), &macros[0], &include,
+                                           &pText, &pErrors)))
+            WatchIncludes(include.Names(), a.includes);
+        if (pText)
+            pText->Release();
+        if (pErrors)
+            pErrors->Release();
+    }
+    return AddAsset(a, path);
+}
+
+bool HotReloader::WatchMesh(MeshHandle h, const char* path, DWORD meshOptions,
+                            MeshReloadedCallback onReloaded)
+{
+    Asset a;
+    a.type   = ASSET_MESH;
+    a.mesh   = h;
+    a.flags  = meshOptions;
+    a.onMesh = onReloaded;
+    return AddAsset(a, path);
+}
+
+bool HotReloader::WatchTexture(TextureHandle h, const char* path, const TextureLoadOptions& options)
+{
+    Asset a;
+    a.type       = ASSET_TEXTURE;
+    a.texture    = h;
+    a.texOptions = options;
+    return AddAsset(a, path);
+}
+
+void HotReloader::WatchTextureCache(TextureCache& cache)
+{
+    cache.SetLoadedCallback(&HotReloader::OnTextureLoaded);
+}
+
+void HotReloader::OnTextureLoaded(TextureHandle h, const char* canonicalPath,
+                                  const TextureLoadOptions& options)
+{
+    g_hotReload.WatchTexture(h, canonicalPath, options);
+}
+
+bool HotReloader::AddAsset(Asset& a, const char* path)
+{
+    if (a.type != ASSET_TEXTURE)
+        a.texOptions = TextureLoadOptions::Default();
+    if (a.type != ASSET_EFFECT)
+        a.onEffect = NULL;
+    if (a.type != ASSET_MESH)
+        a.onMesh = NULL;
+    if (a.type == ASSET_TEXTURE)
+        a.flags = 0;
+
+    if (!m_watcher.Watch(path, &a.path))
+        return false;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_assets.push_back(a);
+    return true;
+}
+
+// Includes only found in a pack cannot change and are not watched.
+void HotReloader::WatchIncludes(const std::vector<std::string>& names, std::vector<std::string>& canonical)
+{
+    canonical.clear();
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        std::string loose, path;
+        if (g_assets.ResolveLoose(names[i].c_str(), loose) && m_watcher.Watch(loose.c_str(), &path))
+            canonical.push_back(path);
+    }
+}
+
+// A recompile may have added or dropped includes.  Files no longer included
+// stay watched; a change to one only costs a needless recompile.
+void HotReloader::SetIncludes(const Asset& a, const std::vector<std::string>& names)
+{
+    std::vector<std::string> includes;
+    WatchIncludes(names, includes);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (size_t i = 0; i < m_assets.size(); ++i)
+    {
+        Asset& other = m_assets[i];
+        if (other.type == ASSET_EFFECT && other.effect == a.effect && other.path == a.path)
+            other.includes = includes;
+    }
+}
+
+//===============================================================
+// Background thread: wait for changes, then load and compile.
+
+void HotReloader::ThreadMain()
+{
+    while (!m_quit)
+    {
+        std::vector<std::string> changed;
+        if (!m_watcher.Wait(changed, 500))
+            return;
+        if (changed.empty())
+            continue;
+
+        // Editors often write a file in several steps; let it settle and
+        // merge whatever else arrives in the meantime.
+        m_watcher.Wait(changed, 50);
+
+        std::vector<Asset> work;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (size_t i = 0; i < m_assets.size(); ++i)
+            {
+                const std::vector<std::string>& includes = m_assets[i].includes;
+                for (size_t c = 0; c < changed.size(); ++c)
+                {
+                    if (m_assets[i].path == changed[c] ||
+                        std::find(includes.begin(), includes.end(), changed[c]) != includes.end())
+                    {
+                        work.push_back(m_assets[i]);
+                        break;
+                    }
+                }
+            }
+        }
+
+        for (size_t i = 0; i < work.size() && !m_quit; ++i)
+        {
+            Pending p;
+            p.pCompiled = NULL;
+            if (!Prepare(work[i], p))
+                continue;
+            if (work[i].type == ASSET_EFFECT)
+                SetIncludes(work[i], p.includes);
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_ready.push_back(p);
+        }
+    }
+}
+
+bool HotReloader::Prepare(const Asset& a, Pending& p)
+{
+    p.asset = a;
+
+    if (!ReadFileBytes(a.path.c_str(), p.bytes) || p.bytes.empty())
+    {
+        Log("could not read", a.path, NULL);
+        return false;
+    }
+
+    switch (a.type)
+    {
+    case ASSET_EFFECT:
+    {
+        // Compilation does not need the device, so it is done here.  The
+        // includes are resolved through g_assets, as on the first load.
+        std::vector<D3DXMACRO> defines;
+        MakeMacros(a.defines, defines);
+
+        IncludeRecorder      include;
+        ID3DXEffectCompiler* pCompiler = NULL;
+        ID3DXBuffer*         pErrors   = NULL;
+        if (FAILED(D3DXCreateEffectCompiler(&p.bytes[0], (UINT)p.bytes.size(), &defines[0], &include,
+                                            a.flags, &pCompiler, &pErrors)))
+        {
+            Log("effect parse failed", a.path, pErrors);
+            return false;
+        }
+
+        HRESULT hr = pCompiler->CompileEffect(a.flags, &p.pCompiled, &pErrors);
+        pCompiler->Release();
+        if (FAILED(hr))
+        {
+            Log("effect compile failed", a.path, pErrors);
+            return false;
+        }
+        if (pErrors)
+            pErrors->Release();
+        p.bytes.clear();
+        p.includes = include.Names();
+        return true;
+    }
+
+    case ASSET_TEXTURE:
+    {
+        // Reject files caught half written before the render thread sees them.
+        D3DXIMAGE_INFO info;
+        if (FAILED(D3DXGetImageInfoFromFileInMemory(&p.bytes[0], (UINT)p.bytes.size(), &info)))
+        {
+            Log("unrecognised image", a.path, NULL);
+            return false;
+        }
+        return true;
+    }
+
+    case ASSET_MESH:
+        return true;
+    }
+    return false;
+}
+
+//===============================================================
+// Render thread: create device objects and swap them in.
+
+unsigned HotReloader::ApplyPending(IDirect3DDevice9* pDevice)
+{
+    std::vector<Pending> ready;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_ready.empty())
+            return 0;
+        ready.swap(m_ready);
+    }
+
+    unsigned applied = 0;
+    for (size_t i = 0; i < ready.size(); ++i)
+    {
+        Pending&     p = ready[i];
+        const Asset& a = p.asset;
+        unsigned     before = applied;
+
+        switch (a.type)
+        {
+        case ASSET_EFFECT:
+        {
+            ID3DXEffect* pFx     = NULL;
+            ID3DXBuffer* pErrors = NULL;
+            HRESULT hr = D3DXCreateEffect(pDevice, p.pCompiled->GetBufferPointer(),
+                                          p.pCompiled->GetBufferSize(), NULL, NULL,
+                                          a.flags, NULL, &pFx, &pErrors);
+            p.pCompiled->Release();
+            if (FAILED(hr))
+            {
+                Log("effect creation failed", a.path, pErrors);
+                break;
+            }
+            if (pErrors)
+                pErrors->Release();
+
+            if (!g_resources.ReplaceEffect(a.effect, pFx))
+            {
+                pFx->Release();
+                break;
+            }
+            if (a.onEffect)
+                a.onEffect(pFx);
+            ++applied;
+            break;
+        }
+
+        case ASSET_MESH:
+        {
+            ID3DXMesh*   pMesh      = NULL;
+            ID3DXBuffer* pMaterials = NULL;
+            DWORD        numMaterials = 0;
+            if (FAILED(D3DXLoadMeshFromXInMemory(&p.bytes[0], (DWORD)p.bytes.size(), a.flags,
+                                                 pDevice, NULL, &pMaterials, NULL,
+                                                 &numMaterials, &pMesh)))
+            {
+                Log("mesh load failed", a.path, NULL);
+                break;
+            }
+
+            if (g_resources.ReplaceMesh(a.mesh, pMesh))
+            {
+                if (a.onMesh)
+                    a.onMesh(pMesh, pMaterials, numMaterials);
+                ++applied;
+            }
+            else
+            {
+                pMesh->Release();
+            }
+            if (pMaterials)
+                pMaterials->Release();
+            break;
+        }
+
+        case ASSET_TEXTURE:
+        {
+            const TextureLoadOptions& o = a.texOptions;
+            IDirect3DTexture9* pTex = NULL;
+            if (FAILED(D3DXCreateTextureFromFileInMemoryEx(pDevice, &p.bytes[0], (UINT)p.bytes.size(),
+                                                           o.width, o.height, o.mipLevels, o.usage,
+                                                           o.format, o.pool, o.filter, o.mipFilter,
+                                                           o.colorKey, NULL, NULL, &pTex)))
+            {
+                Log("texture decode failed", a.path, NULL);
+                break;
+            }
+
+            if (g_resources.ReplaceTexture(a.texture, pTex))
+                ++applied;
+            else
+                pTex->Release();
+            break;
+        }
+        }
+
+        if (applied != before)
+        {
+            char msg[512];
+            snprintf(msg, sizeof(msg), "[HotReload] reloaded %s\n", a.path.c_str());
+#ifdef _WIN32
+            OutputDebugStringA(msg);
+#endif
+            fputs(msg, stderr);
+        }
+    }
+    return applied;
+}
+
+void HotReloader::Log(const char* what, const std::string& path, ID3DXBuffer* pErrors)
+{
+    char msg[512];
+    snprintf(msg, sizeof(msg), "[HotReload] %s: %s\n", what, path.c_str());
+#ifdef _WIN32
+    OutputDebugStringA(msg);
+    if (pErrors)
+        OutputDebugStringA((const char*)pErrors->GetBufferPointer());
+#endif
+    fputs(msg, stderr);
+    if (pErrors)
+    {
+        fputs((const char*)pErrors->GetBufferPointer(), stderr);
+        pErrors->Release();
+    }
+}
@@ -0,0 +1,115 @@
+//=============================================================================
+// HotReload.h
+//
+// Reloads effects, meshes and textures when their source files change on
+// disk, without restarting the sample.
+//
+// A background thread waits on a FileWatcher.  When a watched file changes
+// it reads the new contents and does all the device independent work there
+// (the effect is compiled, image headers are validated).  The results are
+// queued, and ApplyPending(), called by the render loop between frames,
+// creates the device objects and swaps them in behind the existing resource
+// handles.  Objects being replaced are retired through g_resources, so a
+// frame still in flight never loses its resources.
+//
+// Only the asset that changed is reloaded.  A load or compile error leaves
+// the previous version in place and is printed to the debug output.
+//
+// Effects are compiled with the include handler the normal load path uses
+// (AssetInclude), and the files they #include are watched too: editing one
+// recompiles every effect that includes it.  The include list is found by
+// preprocessing when the effect is registered and refreshed by each
+// successful recompile.
+//=============================================================================
+
+#ifndef HOT_RELOAD_H
+#define HOT_RELOAD_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include "Resources.h"
+#include "TextureCache.h"
+#include "FileWatcher.h"
+
+
+// Called on the render thread after a reload has been swapped in.  Effect
+// users re-fetch their technique/parameter handles here; mesh users rebuild
+// their material tables (pMaterials is released after the call returns).
+typedef void (*EffectReloadedCallback)(ID3DXEffect* pFx);
+typedef void (*MeshReloadedCallback)(ID3DXMesh* pMesh, ID3DXBuffer* pMaterials, DWORD numMaterials);
+
+
+class HotReloader
+{
+public:
+    HotReloader();
+    ~HotReloader();
+
+    void Start();
+    void Stop();
+
+    // pDefines (optional) is copied; the effect is recompiled with it.
+    bool WatchEffect(EffectHandle h, const char* path, DWORD compileFlags,
+                     EffectReloadedCallback onReloaded, const D3DXMACRO* pDefines = NULL);
+    bool WatchMesh(MeshHandle h, const char* path, DWORD meshOptions,
+                   MeshReloadedCallback onReloaded);
+    bool WatchTexture(TextureHandle h, const char* path, const TextureLoadOptions& options);
+
+    // Watches every texture the cache loads from now on.
+    void WatchTextureCache(TextureCache& cache);
+
+    // Call between frames on the device thread.  Returns the number of
+    // assets that were swapped in.
+    unsigned ApplyPending(IDirect3DDevice9* pDevice);
+
+private:
+    enum AssetType { ASSET_EFFECT, ASSET_MESH, ASSET_TEXTURE };
+
+    struct Asset
+    {
+        AssetType                type;
+        std::string              path;      // canonical
+        EffectHandle             effect;
+        MeshHandle               mesh;
+        TextureHandle            texture;
+        DWORD                    flags;     // compile flags or mesh options
+        std::vector<std::string> defines;   // effect macros: name, value, ...
+        std::vector<std::string> includes;  // effect #includes, canonical
+        TextureLoadOptions       texOptions;
+        EffectReloadedCallback   onEffect;
+        MeshReloadedCallback     onMesh;
+    };
+
+    struct Pending
+    {
+        Asset                    asset;
+        std::vector<char>        bytes;     // file contents (mesh, texture)
+        ID3DXBuffer*             pCompiled; // compiled effect
+        std::vector<std::string> includes;  // asset names it #included
+    };
+
+    bool AddAsset(Asset& a, const char* path);
+    void WatchIncludes(const std::vector<std::string>& names, std::vector<std::string>& canonical);
+    void SetIncludes(const Asset& a, const std::vector<std::string>& names);
+    void ThreadMain();
+    bool Prepare(const Asset& a, Pending& p);
+
+    static void OnTextureLoaded(TextureHandle h, const char* canonicalPath,
+                                const TextureLoadOptions& options);
+    static void Log(const char* what, const std::string& path, ID3DXBuffer* pErrors);
+
+    FileWatcher          m_watcher;
+    std::thread          m_thread;
+    std::atomic<bool>    m_quit;
+    std::mutex           m_mutex;
+    std::vector<Asset>   m_assets;
+    std::vector<Pending> m_ready;
+};
+
+
+extern HotReloader g_hotReload;
+
+#endif // HOT_RELOAD_H
@@ -0,0 +1,435 @@
+//=============================================================================
+// JobSystem.cpp
+//=============================================================================
+
+#include "JobSystem.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define snprintf _snprintf
+#endif
+
+// VS2013 has no thread_local; both compilers support a POD in TLS.
+#if defined(_MSC_VER)
+#define JOB_THREAD_LOCAL __declspec(thread)
+#else
+#define JOB_THREAD_LOCAL __thread
+#endif
+
+
+JobSystem g_jobs;
+
+
+struct Job
+{
+    JobFunction       fn;
+    void*             pData;
+    unsigned          begin;
+    unsigned          end;
+    JobCounter*       pCounter;
+    std::atomic<bool> pending;      // allocated and not yet started
+};
+
+
+namespace
+{
+    // Index of the calling thread in the running job system, -1 for threads
+    // that do not belong to one.
+    JOB_THREAD_LOCAL int s_thread = -1;
+
+    const int IDLE_SPINS = 64;
+
+    double NowMs()
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+    }
+
+    void CallFunction(void* pData, unsigned begin, unsigned end)
+    {
+        (*static_cast<const std::function<void(unsigned, unsigned)>*>(pData))(begin, end);
+    }
+}
+
+
+//===============================================================
+// Chase-Lev deque (Le, Pop, Cohen, Zappa Nardelli: "Correct and
+// Efficient Work-Stealing for Weak Memory Models", 2013)
+
+bool JobSystem::Deque::Push(Job* pJob)
+{
+    long long b = m_bottom.load(std::memory_order_relaxed);
+    long long t = m_top.load(std::memory_order_acquire);
+    if (b - t > MASK)
+        return false;
+
+    m_jobs[b & MASK].store(pJob, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_bottom.store(b + 1, std::memory_order_relaxed);
+    return true;
+}
+
+Job* JobSystem::Deque::Pop()
+{
+    long long b = m_bottom.load(std::memory_order_relaxed) - 1;
+    m_bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long long t = m_top.load(std::memory_order_relaxed);
+
+    if (t > b)
+    {
+        // Empty.
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+        return NULL;
+    }
+
+    Job* pJob = m_jobs[b & MASK].load(std::memory_order_relaxed);
+    if (t == b)
+    {
+        // Last job: race the thieves for it.
+        if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            pJob = NULL;
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return pJob;
+}
+
+Job* JobSystem::Deque::Steal()
+{
+    long long t = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long long b = m_bottom.load(std::memory_order_acquire);
+    if (t >= b)
+        return NULL;
+
+    Job* pJob = m_jobs[t & MASK].load(std::memory_order_relaxed);
+    if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return NULL;
+    return pJob;
+}
+
+
+//===============================================================
+// JobSystem
+
+JobSystem::JobSystem()
+    : m_numThreads(0),
+      m_queued(0),
+      m_sleeping(0),
+      m_quit(false),
+      m_statsStart(0.0)
+{
+}
+
+JobSystem::~JobSystem()
+{
+    Stop();
+}
+
+void JobSystem::Start(unsigned numThreads)
+{
+    Stop();
+
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    numThreads = std::min(numThreads, MAX_THREADS);
+
+    m_numThreads = numThreads;
+    m_queued     = 0;
+    m_sleeping   = 0;
+    m_quit       = false;
+    for (unsigned i = 0; i < numThreads; ++i)
+    {
+        ThreadData* t = new ThreadData;
+        t->pJobs   = new Job[MAX_JOBS_PER_THREAD];
+        t->nextJob = 0;
+        for (unsigned j = 0; j < MAX_JOBS_PER_THREAD; ++j)
+            t->pJobs[j].pending.store(false, std::memory_order_relaxed);
+        m_threads.push_back(t);
+    }
+    ResetStats();
+
+    s_thread = 0;
+    for (unsigned i = 1; i < numThreads; ++i)
+        m_workers.push_back(std::thread(&JobSystem::WorkerMain, this, i));
+}
+
+void JobSystem::Stop()
+{
+    if (m_numThreads == 0)
+        return;
+
+    m_quit = true;
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_wake.notify_all();
+    }
+    for (size_t i = 0; i < m_workers.size(); ++i)
+        m_workers[i].join();
+    m_workers.clear();
+
+    for (size_t i = 0; i < m_threads.size(); ++i)
+    {
+        delete[] m_threads[i]->pJobs;
+        delete m_threads[i];
+    }
+    m_threads.clear();
+    m_numThreads = 0;
+    s_thread = -1;
+}
+
+int JobSystem::CurrentThread()
+{
+    return s_thread;
+}
+
+Job* JobSystem::AllocateJob(int thread)
+{
+    ThreadData& t    = *m_threads[thread];
+    Job*        pJob = &t.pJobs[t.nextJob & (MAX_JOBS_PER_THREAD - 1)];
+
+    // The ring has wrapped onto a job that is still queued or parked on a
+    // dependency; overwriting it would lose that job.
+    if (pJob->pending.load(std::memory_order_acquire))
+        return NULL;
+
+    ++t.nextJob;
+    pJob->pending.store(true, std::memory_order_relaxed);
+    return pJob;
+}
+
+void JobSystem::Run(JobFunction fn, void* pData, unsigned begin, unsigned end,
+                    JobCounter* pCounter, JobCounter* pDependency)
+{
+    int thread = CurrentThread();
+    if (thread < 0 || m_numThreads == 0)
+    {
+        // Not started, or called from a foreign thread: run it here.
+        while (pDependency && !pDependency->Done())
+            std::this_thread::yield();
+        fn(pData, begin, end);
+        return;
+    }
+
+    if (pCounter)
+        pCounter->m_pending.fetch_add(1);
+
+    Job* pJob = AllocateJob(thread);
+    if (pJob == NULL)
+    {
+        // Too many jobs in flight on this thread: run this one here, after
+        // its dependency, the way a full deque does.
+        if (pDependency)
+            Wait(pDependency);
+
+        Job job;
+        job.fn       = fn;
+        job.pData    = pData;
+        job.begin    = begin;
+        job.end      = end;
+        job.pCounter = pCounter;
+        job.pending.store(true, std::memory_order_relaxed);
+        Execute(thread, &job);
+        return;
+    }
+
+    pJob->fn       = fn;
+    pJob->pData    = pData;
+    pJob->begin    = begin;
+    pJob->end      = end;
+    pJob->pCounter = pCounter;
+
+    if (pDependency)
+    {
+        std::lock_guard<std::mutex> lock(pDependency->m_mutex);
+        if (pDependency->m_pending.load() != 0)
+        {
+            // Queued by the Finish() that brings the dependency to zero.
+            pDependency->m_waiting.push_back(pJob);
+            return;
+        }
+    }
+
+    Submit(thread, pJob);
+}
+
+void JobSystem::ParallelFor(unsigned count, unsigned grain, JobFunction fn, void* pData,
+                            JobCounter* pCounter, JobCounter* pDependency)
+{
+    if (grain == 0)
+        grain = std::max(1u, count / (std::max(1u, m_numThreads) * 4));
+
+    for (unsigned begin = 0; begin < count; begin += grain)
+        Run(fn, pData, begin, std::min(count, begin + grain), pCounter, pDependency);
+}
+
+void JobSystem::ParallelFor(unsigned count, unsigned grain, const std::function<void(unsigned, unsigned)>& fn)
+{
+    JobCounter counter;
+    ParallelFor(count, grain, CallFunction, const_cast<std::function<void(unsigned, unsigned)>*>(&fn), &counter);
+    Wait(&counter);
+}
+
+void JobSystem::Submit(int thread, Job* pJob)
+{
+    m_queued.fetch_add(1);
+    if (!m_threads[thread]->deque.Push(pJob))
+    {
+        // Deque full: nothing is gained by queueing more anyway.
+        m_queued.fetch_sub(1);
+        Execute(thread, pJob);
+        return;
+    }
+
+    if (m_sleeping.load() > 0)
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_wake.notify_one();
+    }
+}
+
+Job* JobSystem::FindJob(int thread)
+{
+    ThreadData& self = *m_threads[thread];
+
+    Job* pJob = self.deque.Pop();
+    if (pJob == NULL)
+    {
+        for (unsigned i = 1; i < m_numThreads && pJob == NULL; ++i)
+            pJob = m_threads[(thread + i) % m_numThreads]->deque.Steal();
+        if (pJob)
+            ++self.stats.steals;
+    }
+
+    if (pJob)
+        m_queued.fetch_sub(1);
+    return pJob;
+}
+
+void JobSystem::Execute(int thread, Job* pJob)
+{
+    // Copy first and hand the slot back to its ring.
+    JobFunction fn       = pJob->fn;
+    void*       pData    = pJob->pData;
+    unsigned    begin    = pJob->begin;
+    unsigned    end      = pJob->end;
+    JobCounter* pCounter = pJob->pCounter;
+    pJob->pending.store(false, std::memory_order_release);
+
+    double start = NowMs();
+    fn(pData, begin, end);
+
+    JobWorkerStats& stats = m_threads[thread]->stats;
+    stats.busyMs += NowMs() - start;
+    ++stats.jobs;
+
+    if (pCounter)
+        Finish(thread, pCounter);
+}
+
+void JobSystem::Finish(int thread, JobCounter* pCounter)
+{
+    std::vector<Job*> ready;
+    {
+        std::lock_guard<std::mutex> lock(pCounter->m_mutex);
+        if (pCounter->m_pending.fetch_sub(1) == 1)
+            ready.swap(pCounter->m_waiting);
+    }
+
+    for (size_t i = 0; i < ready.size(); ++i)
+        Submit(thread, ready[i]);
+}
+
+void JobSystem::Wait(JobCounter* pCounter)
+{
+    int thread = CurrentThread();
+    while (pCounter->m_pending.load() != 0)
+    {
+        Job* pJob = thread >= 0 && m_numThreads != 0 ? FindJob(thread) : NULL;
+        if (pJob)
+            Execute(thread, pJob);
+        else
+            std::this_thread::yield();
+    }
+
+    // The Finish() that brought the counter to zero may still be inside its
+    // lock; the caller is about to be free to destroy the counter.
+    std::lock_guard<std::mutex> lock(pCounter->m_mutex);
+}
+
+void JobSystem::WorkerMain(unsigned thread)
+{
+    s_thread = (int)thread;
+
+    while (!m_quit.load())
+    {
+        if (Job* pJob = FindJob(thread))
+        {
+            Execute(thread, pJob);
+            continue;
+        }
+
+        bool found = false;
+        for (int spin = 0; spin < IDLE_SPINS && !found; ++spin)
+        {
+            std::this_thread::yield();
+            found = m_queued.load() > 0;
+        }
+        if (found)
+            continue;
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_sleeping.fetch_add(1);
+        while (!m_quit.load() && m_queued.load() <= 0)
+            m_wake.wait(lock);
+        m_sleeping.fetch_sub(1);
+    }
+}
+
+
+//===============================================================
+// Statistics
+
+double JobSystem::StatsWindowMs() const
+{
+    return NowMs() - m_statsStart;
+}
+
+void JobSystem::ResetStats()
+{
+    for (size_t i = 0; i < m_threads.size(); ++i)
+    {
+        m_threads[i]->stats.jobs   = 0;
+        m_threads[i]->stats.steals = 0;
+        m_threads[i]->stats.busyMs = 0.0;
+    }
+    m_statsStart = NowMs();
+}
+
+void JobSystem::ReportStats(const char* name) const
+{
+    double window = StatsWindowMs();
+
+    char msg[256];
+    snprintf(msg, sizeof(msg), "[Jobs] %s: %u threads over %.0f ms\n", name, m_numThreads, window);
+#ifdef _WIN32
+    OutputDebugStringA(msg);
+#endif
+    fputs(msg, stderr);
+
+    for (unsigned i = 0; i < m_numThreads; ++i)
+    {
+        const JobWorkerStats& s = m_threads[i]->stats;
+        snprintf(msg, sizeof(msg), "[Jobs]   thread %u: %u jobs (%u stolen), busy %.1f ms (%.1f%%)\n",
+                 i, s.jobs, s.steals, s.busyMs, window > 0.0 ? 100.0 * s.busyMs / window : 0.0);
+#ifdef _WIN32
+        OutputDebugStringA(msg);
+#endif
+        fputs(msg, stderr);
+    }
+}
@@ -0,0 +1,168 @@
+//=============================================================================
+// JobSystem.h
+//
+// Work-stealing job system for the per-frame update work (transforms,
+// culling, light constants) that would otherwise run inline in Render().
+//
+// Every thread owns a Chase-Lev deque: it pushes and pops its own jobs at
+// the bottom without locking, and idle threads steal from the top of the
+// others'.  The thread that called Start() is thread 0 and takes part in
+// the work whenever it waits.  Workers with nothing to steal spin briefly
+// and then sleep until a job is queued.
+//
+// A job is a function, a data pointer and an item range.  Completion is
+// tracked with JobCounters: Run() raises a counter that the job lowers when
+// it has finished, Wait() works on queued jobs until a counter is zero, and
+// a job can be made to depend on a counter, in which case it is queued only
+// once that counter reaches zero:
+//
+//     JobCounter transforms, culling;
+//     g_jobs.ParallelFor(numObjects, 256, UpdateTransforms, &scene, &transforms);
+//     g_jobs.ParallelFor(numObjects, 1024, CullObjects, &scene, &culling, &transforms);
+//     g_jobs.Wait(&culling);
+//
+// Jobs may queue further jobs.  Only worker threads and thread 0 may call
+// Run() or Wait().  Each thread allocates its jobs from a ring of
+// MAX_JOBS_PER_THREAD entries; when the next entry still holds a job that
+// has not started (queued, or waiting on a dependency), Run() executes the
+// new job on the calling thread instead.  A counter must not be destroyed
+// before Wait() on it has returned.
+//=============================================================================
+
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Processes items [begin, end) of whatever pData describes.
+typedef void (*JobFunction)(void* pData, unsigned begin, unsigned end);
+
+struct Job;
+
+class JobCounter
+{
+public:
+    JobCounter() : m_pending(0) {}
+
+    bool Done() const { return m_pending.load() == 0; }
+
+private:
+    friend class JobSystem;
+
+    JobCounter(const JobCounter&);
+    JobCounter& operator=(const JobCounter&);
+
+    std::atomic<int>  m_pending;
+    std::mutex        m_mutex;      // guards m_waiting and the transition to zero
+    std::vector<Job*> m_waiting;    // jobs that depend on this counter
+};
+
+struct JobWorkerStats
+{
+    unsigned jobs;                  // executed by this thread
+    unsigned steals;                // of those, taken from another thread
+    double   busyMs;                // spent inside job functions
+};
+
+
+class JobSystem
+{
+public:
+    static const unsigned MAX_THREADS         = 64;
+    static const unsigned MAX_JOBS_PER_THREAD = 4096;    // power of two
+
+    JobSystem();
+    ~JobSystem();
+
+    // numThreads counts the calling thread; 0 uses every hardware thread
+    // and 1 runs every job on the calling thread inside Wait().
+    void Start(unsigned numThreads = 0);
+    void Stop();
+    unsigned NumThreads() const { return m_numThreads; }
+
+    // Queues fn(pData, begin, end).  pCounter may be NULL.
+    void Run(JobFunction fn, void* pData, unsigned begin, unsigned end,
+             JobCounter* pCounter, JobCounter* pDependency = NULL);
+
+    // Queues one job per grain items of [0, count); grain 0 picks about
+    // four jobs per thread.
+    void ParallelFor(unsigned count, unsigned grain, JobFunction fn, void* pData,
+                     JobCounter* pCounter, JobCounter* pDependency = NULL);
+
+    // Blocking form for lambdas.
+    void ParallelFor(unsigned count, unsigned grain, const std::function<void(unsigned, unsigned)>& fn);
+
+    // Executes queued jobs on the calling thread until pCounter is zero.
+    void Wait(JobCounter* pCounter);
+
+    // Per-thread statistics since the last ResetStats(); read them only
+    // while no jobs are running.
+    const JobWorkerStats& WorkerStats(unsigned thread) const { return m_threads[thread]->stats; }
+    double StatsWindowMs() const;
+    void ResetStats();
+    void ReportStats(const char* name) const;
+
+private:
+    // Chase-Lev work-stealing deque with a fixed capacity.
+    class Deque
+    {
+    public:
+        Deque() : m_top(0), m_bottom(0) {}
+
+        bool Push(Job* pJob);       // owner only; false if full
+        Job* Pop();                 // owner only
+        Job* Steal();               // any thread
+
+    private:
+        static const long long MASK = MAX_JOBS_PER_THREAD - 1;
+
+        std::atomic<long long> m_top;
+        char                   m_pad[64];      // keep thieves' and owner's indices on separate lines
+        std::atomic<long long> m_bottom;
+        std::atomic<Job*>      m_jobs[MAX_JOBS_PER_THREAD];
+    };
+
+    struct ThreadData
+    {
+        Deque          deque;
+        Job*           pJobs;       // ring of MAX_JOBS_PER_THREAD
+        unsigned       nextJob;
+        JobWorkerStats stats;
+    };
+
+    JobSystem(const JobSystem&);
+    JobSystem& operator=(const JobSystem&);
+
+    static int CurrentThread();
+
+    Job* AllocateJob(int thread);   // NULL if the ring is full
+    void Submit(int thread, Job* pJob);
+    Job* FindJob(int thread);
+    void Execute(int thread, Job* pJob);
+    void Finish(int thread, JobCounter* pCounter);
+    void WorkerMain(unsigned thread);
+
+    unsigned                   m_numThreads;
+    std::vector<ThreadData*>   m_threads;
+    std::vector<std::thread>   m_workers;
+
+    std::atomic<int>           m_queued;       // jobs sitting in deques
+    std::atomic<int>           m_sleeping;
+    std::atomic<bool>          m_quit;
+    std::mutex                 m_sleepMutex;
+    std::condition_variable    m_wake;
+
+    double                     m_statsStart;
+};
+
+
+// One job system shared by the whole program (defined in JobSystem.cpp).
+extern JobSystem g_jobs;
+
+#endif // JOB_SYSTEM_H
@@ -0,0 +1,102 @@
+//=============================================================================
+// LinearAllocator.cpp
+//=============================================================================
+
+#include "LinearAllocator.h"
+#include <cstdlib>
+#include <algorithm>
+
+
+LinearAllocator::LinearAllocator(size_t pageBytes)
+    : m_current(0),
+      m_pageBytes(pageBytes)
+{
+}
+
+LinearAllocator::~LinearAllocator()
+{
+    Release();
+}
+
+void* LinearAllocator::Allocate(size_t bytes, size_t alignment)
+{
+    if (m_current < m_pages.size())
+    {
+        Page& page = m_pages[m_current];
+        size_t offset = (((size_t)(page.data + page.used) + alignment - 1) & ~(alignment - 1)) - (size_t)page.data;
+        if (offset + bytes <= page.size)
+        {
+            page.used = offset + bytes;
+            return page.data + offset;
+        }
+    }
+
+    if (!NextPage(bytes + alignment - 1))
+        return NULL;
+
+    Page& page = m_pages[m_current];
+    size_t offset = (((size_t)page.data + alignment - 1) & ~(alignment - 1)) - (size_t)page.data;
+    page.used = offset + bytes;
+    return page.data + offset;
+}
+
+bool LinearAllocator::NextPage(size_t minBytes)
+{
+    // Reuse the next kept page if it is large enough; a too small one is
+    // swapped to the end so it still serves later requests.
+    size_t next = m_current < m_pages.size() ? m_current + 1 : 0;
+    for (size_t i = next; i < m_pages.size(); ++i)
+    {
+        if (m_pages[i].size >= minBytes)
+        {
+            std::swap(m_pages[next], m_pages[i]);
+            m_current = next;
+            m_pages[m_current].used = 0;
+            return true;
+        }
+    }
+
+    Page page;
+    page.size = minBytes > m_pageBytes ? minBytes : m_pageBytes;
+    page.used = 0;
+    page.data = static_cast<char*>(malloc(page.size));
+    if (page.data == NULL)
+        return false;
+
+    m_pages.insert(m_pages.begin() + next, page);
+    m_current = next;
+    return true;
+}
+
+void LinearAllocator::Reset()
+{
+    if (m_pages.empty())
+        return;
+
+    m_current = 0;
+    m_pages[0].used = 0;
+}
+
+void LinearAllocator::Release()
+{
+    for (size_t i = 0; i < m_pages.size(); ++i)
+        free(m_pages[i].data);
+    m_pages.clear();
+    m_current = 0;
+}
+
+size_t LinearAllocator::BytesUsed() const
+{
+    size_t used = 0;
+    for (unsigned i = 0; i < NumPages(); ++i)
+        used += m_pages[i].used;
+    return used;
+}
+
+size_t LinearAllocator::BytesReserved() const
+{
+    size_t reserved = 0;
+    for (size_t i = 0; i < m_pages.size(); ++i)
+        reserved += m_pages[i].size;
+    return reserved;
+}
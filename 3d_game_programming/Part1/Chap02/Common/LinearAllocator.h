@@ -0,0 +1,68 @@
+//=============================================================================
+// LinearAllocator.h
+//
+// Bump allocator over a list of pages.  Allocate() hands out the next
+// aligned bytes of the current page and moves to a new page when it does
+// not fit; nothing is freed individually.  Reset() rewinds to the first
+// page and keeps every page for reuse, so a buffer that is refilled every
+// frame stops touching the heap after the first few frames.
+//
+// Not thread safe: give each thread its own allocator.
+//=============================================================================
+
+#ifndef LINEAR_ALLOCATOR_H
+#define LINEAR_ALLOCATOR_H
+
+#include <cstddef>
+#include <vector>
+
+
+class LinearAllocator
+{
+public:
+    static const size_t DEFAULT_PAGE_BYTES = 64 * 1024;
+
+    explicit LinearAllocator(size_t pageBytes = DEFAULT_PAGE_BYTES);
+    ~LinearAllocator();
+
+    // alignment must be a power of two.  Requests larger than a page get a
+    // page of their own.  Returns NULL only if the heap is exhausted.
+    void* Allocate(size_t bytes, size_t alignment = 16);
+
+    template<typename T>
+    T* Allocate(size_t count = 1) { return static_cast<T*>(Allocate(count * sizeof(T), __alignof(T))); }
+
+    // Rewinds to the first page; every earlier allocation becomes invalid.
+    void Reset();
+
+    // Frees every page.
+    void Release();
+
+    size_t BytesUsed() const;                   // handed out, including alignment padding
+    size_t BytesReserved() const;               // held in pages
+
+    // Pages in allocation order, for walking what was allocated: page i
+    // holds PageUsed(i) bytes starting at PageData(i).
+    unsigned    NumPages() const                { return m_current < m_pages.size() ? m_current + 1 : 0; }
+    const char* PageData(unsigned i) const      { return m_pages[i].data; }
+    size_t      PageUsed(unsigned i) const      { return m_pages[i].used; }
+
+private:
+    struct Page
+    {
+        char*  data;
+        size_t size;
+        size_t used;
+    };
+
+    LinearAllocator(const LinearAllocator&);
+    LinearAllocator& operator=(const LinearAllocator&);
+
+    bool NextPage(size_t minBytes);
+
+    std::vector<Page> m_pages;
+    size_t            m_current;        // page being filled; m_pages.size() before the first allocation
+    size_t            m_pageBytes;
+};
+
+#endif // LINEAR_ALLOCATOR_H
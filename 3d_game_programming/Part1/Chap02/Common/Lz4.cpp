@@ -0,0 +1,239 @@
+//=============================================================================
+// Lz4.cpp
+//
+// Block layout: a sequence is
+//     token (literal length << 4 | match length - 4)
+//     [literal length extension bytes] literals
+//     match offset (2 bytes, little endian)
+//     [match length extension bytes]
+// A length nibble of 15 is followed by bytes that are added until one is
+// less than 255.  The last sequence has literals only; the final 5 bytes of
+// a block are always literals and no match starts in the last 12 bytes.
+//=============================================================================
+
+#include "Lz4.h"
+#include <cstring>
+#include <vector>
+
+
+namespace
+{
+    typedef unsigned char  u8;
+    typedef unsigned int   u32;
+
+    const size_t MIN_MATCH     = 4;
+    const size_t LAST_LITERALS = 5;
+    const size_t MF_LIMIT      = 12;
+    const size_t MAX_OFFSET    = 65535;
+    const unsigned HASH_BITS   = 12;
+
+    inline u32 Read32(const u8* p)
+    {
+        u32 v;
+        memcpy(&v, p, 4);
+        return v;
+    }
+
+    inline u32 Hash(u32 v)
+    {
+        return (v * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    inline u8* WriteLength(u8* op, size_t len)
+    {
+        while (len >= 255)
+        {
+            *op++ = 255;
+            len -= 255;
+        }
+        *op++ = (u8)len;
+        return op;
+    }
+
+    u8* WriteSequence(u8* op, const u8* literals, size_t numLiterals,
+                      size_t offset, size_t matchLength)
+    {
+        u8* token = op++;
+        u8  t = 0;
+
+        if (numLiterals >= 15)
+        {
+            t = 15 << 4;
+            op = WriteLength(op, numLiterals - 15);
+        }
+        else
+        {
+            t = (u8)(numLiterals << 4);
+        }
+        memcpy(op, literals, numLiterals);
+        op += numLiterals;
+
+        if (matchLength)
+        {
+            *op++ = (u8)(offset & 0xff);
+            *op++ = (u8)(offset >> 8);
+
+            size_t ml = matchLength - MIN_MATCH;
+            if (ml >= 15)
+            {
+                t |= 15;
+                op = WriteLength(op, ml - 15);
+            }
+            else
+            {
+                t |= (u8)ml;
+            }
+        }
+        *token = t;
+        return op;
+    }
+}
+
+
+size_t Lz4CompressBound(size_t srcSize)
+{
+    return srcSize + srcSize / 255 + 16;
+}
+
+size_t Lz4Compress(const void* src, size_t srcSize, void* dst, size_t dstCapacity)
+{
+    if (dstCapacity < Lz4CompressBound(srcSize))
+        return 0;
+
+    const u8* const base = (const u8*)src;
+    const u8* const end  = base + srcSize;
+    u8*             op   = (u8*)dst;
+
+    const u8* ip     = base;
+    const u8* anchor = base;
+
+    if (srcSize > MF_LIMIT)
+    {
+        // Positions are stored +1 so zero means "empty".
+        std::vector<u32> table(1u << HASH_BITS, 0);
+        const u8* const matchLimit = end - LAST_LITERALS;
+        const u8* const lastStart  = end - MF_LIMIT;
+
+        while (ip < lastStart)
+        {
+            u32 seq = Read32(ip);
+            u32 h   = Hash(seq);
+            u32 candPos = table[h];
+            table[h] = (u32)(ip - base) + 1;
+
+            if (candPos == 0)
+            {
+                ++ip;
+                continue;
+            }
+
+            const u8* ref = base + (candPos - 1);
+            if ((size_t)(ip - ref) > MAX_OFFSET || Read32(ref) != seq)
+            {
+                ++ip;
+                continue;
+            }
+
+            // Extend backwards over pending literals, then forwards.
+            while (ip > anchor && ref > base && ip[-1] == ref[-1])
+            {
+                --ip;
+                --ref;
+            }
+
+            const u8* mp = ip + MIN_MATCH;
+            const u8* rp = ref + MIN_MATCH;
+            while (mp < matchLimit && *mp == *rp)
+            {
+                ++mp;
+                ++rp;
+            }
+
+            op = WriteSequence(op, anchor, (size_t)(ip - anchor),
+                               (size_t)(ip - ref), (size_t)(mp - ip));
+            ip = anchor = mp;
+
+            if (ip - 2 >= base && ip < lastStart)
+                table[Hash(Read32(ip - 2))] = (u32)(ip - 2 - base) + 1;
+        }
+    }
+
+    op = WriteSequence(op, anchor, (size_t)(end - anchor), 0, 0);
+    return (size_t)(op - (u8*)dst);
+}
+
+size_t Lz4Decompress(const void* src, size_t srcSize, void* dst, size_t dstSize)
+{
+    const u8*       ip   = (const u8*)src;
+    const u8* const iend = ip + srcSize;
+    u8*             op   = (u8*)dst;
+    u8* const       oend = op + dstSize;
+
+    while (ip < iend)
+    {
+        u8 token = *ip++;
+
+        size_t numLiterals = token >> 4;
+        if (numLiterals == 15)
+        {
+            u8 b;
+            do
+            {
+                if (ip >= iend)
+                    return 0;
+                b = *ip++;
+                numLiterals += b;
+            } while (b == 255);
+        }
+
+        if (numLiterals > (size_t)(iend - ip) || numLiterals > (size_t)(oend - op))
+            return 0;
+        memcpy(op, ip, numLiterals);
+        ip += numLiterals;
+        op += numLiterals;
+
+        // The last sequence stops after its literals.
+        if (ip == iend)
+            break;
+
+        if (iend - ip < 2)
+            return 0;
+        size_t offset = ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - (u8*)dst))
+            return 0;
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15)
+        {
+            u8 b;
+            do
+            {
+                if (ip >= iend)
+                    return 0;
+                b = *ip++;
+                matchLength += b;
+            } while (b == 255);
+        }
+        matchLength += MIN_MATCH;
+
+        if (matchLength > (size_t)(oend - op))
+            return 0;
+
+        // Matches may overlap their own output (offset < length), so copy
+        // forwards byte by byte unless the ranges are disjoint.
+        const u8* ref = op - offset;
+        if (offset >= matchLength)
+        {
+            memcpy(op, ref, matchLength);
+            op += matchLength;
+        }
+        else
+        {
+            for (size_t i = 0; i < matchLength; ++i)
+                *op++ = *ref++;
+        }
+    }
+
+    return (size_t)(op - (u8*)dst);
+}
@@ -0,0 +1,31 @@
+//=============================================================================
+// Lz4.h
+//
+// LZ4 block format (no frame header) compressor and decompressor, used by
+// the asset pack.  Compatible with the reference LZ4_compress_default /
+// LZ4_decompress_safe block streams, so packs can also be inspected with
+// the standard tools.
+//
+// The compressor is the simple single-probe hash variant: fast, with a
+// ratio close to the reference "fast" level.  The decompressor checks every
+// read and write against the buffer bounds and never trusts the input.
+//=============================================================================
+
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <cstddef>
+
+
+// Worst case compressed size for srcSize bytes of input.
+size_t Lz4CompressBound(size_t srcSize);
+
+// Compresses src into dst (dstCapacity should be Lz4CompressBound(srcSize)).
+// Returns the compressed size, or 0 if dst is too small.
+size_t Lz4Compress(const void* src, size_t srcSize, void* dst, size_t dstCapacity);
+
+// Decompresses a block whose original size is known.  Returns the number
+// of bytes written, or 0 if the input is corrupt or dst is too small.
+size_t Lz4Decompress(const void* src, size_t srcSize, void* dst, size_t dstSize);
+
+#endif // LZ4_H
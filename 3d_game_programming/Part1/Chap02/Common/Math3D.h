@@ -0,0 +1,580 @@
+//=============================================================================
+// Math3D.h
+//
+// Header-only vector, matrix and quaternion math with the same conventions
+// as D3DX: left-handed coordinates, row vectors (v' = v * M), row-major
+// storage, and matrices composed left to right (world * view * proj).
+// Mat4 has the memory layout of D3DXMATRIX, so it can be handed to D3D
+// and D3DX as is; the functions match their D3DX namesakes.
+//
+// Vec4, Quat and Mat4 are 16-byte aligned.  Heap arrays of them are not
+// guaranteed to be on 32-bit MSVC, so the SIMD paths use unaligned
+// loads, which cost nothing extra on aligned data.  SSE2 is used on x86
+// and x64, NEON on ARM, and plain C++ elsewhere (or with MATH3D_SCALAR).
+//
+// The batched matrix products (Mat4MultiplyArray, Mat4MultiplyGather) are
+// what hot loops should call: they keep the constant matrix in registers
+// across the whole array.  The batched point transforms (Vec3TransformArray,
+// ...) are for their strided input; they are no faster than a plain loop,
+// which compilers vectorize about as well.
+//=============================================================================
+
+#ifndef MATH3D_H
+#define MATH3D_H
+
+#include <cmath>
+#include <cstddef>
+
+#if !defined(MATH3D_SCALAR)
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MATH3D_SSE
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM) || defined(_M_ARM64)
+#define MATH3D_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
+#if defined(_MSC_VER)
+#define MATH3D_ALIGN16 __declspec(align(16))
+#else
+#define MATH3D_ALIGN16 __attribute__((aligned(16)))
+#endif
+
+
+const float MATH_PI = 3.141592654f;
+
+
+//===============================================================
+// Types
+
+struct Vec3
+{
+    float x, y, z;
+
+    Vec3() {}
+    Vec3(float x_, float y_, float z_) : x(x_), y(y_), z(z_) {}
+};
+
+struct MATH3D_ALIGN16 Vec4
+{
+    float x, y, z, w;
+
+    Vec4() {}
+    Vec4(float x_, float y_, float z_, float w_) : x(x_), y(y_), z(z_), w(w_) {}
+    Vec4(const Vec3& v, float w_) : x(v.x), y(v.y), z(v.z), w(w_) {}
+};
+
+struct MATH3D_ALIGN16 Quat
+{
+    float x, y, z, w;
+
+    Quat() {}
+    Quat(float x_, float y_, float z_, float w_) : x(x_), y(y_), z(z_), w(w_) {}
+};
+
+struct MATH3D_ALIGN16 Mat4
+{
+    float m[4][4];
+
+    float&       operator()(int row, int col)       { return m[row][col]; }
+    float        operator()(int row, int col) const { return m[row][col]; }
+    const float* Data() const                       { return &m[0][0]; }
+};
+
+static_assert(sizeof(Vec3) == 12 && sizeof(Vec4) == 16 && sizeof(Mat4) == 64,
+              "Math3D types must match the D3DX layouts");
+
+
+//===============================================================
+// Vec3
+
+inline Vec3 operator+(const Vec3& a, const Vec3& b) { return Vec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+inline Vec3 operator-(const Vec3& a, const Vec3& b) { return Vec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+inline Vec3 operator-(const Vec3& a)                { return Vec3(-a.x, -a.y, -a.z); }
+inline Vec3 operator*(const Vec3& a, float s)       { return Vec3(a.x * s, a.y * s, a.z * s); }
+inline Vec3 operator*(float s, const Vec3& a)       { return a * s; }
+
+inline float Vec3Dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+inline Vec3 Vec3Cross(const Vec3& a, const Vec3& b)
+{
+    return Vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+inline float Vec3Length(const Vec3& a) { return sqrtf(Vec3Dot(a, a)); }
+
+// Zero length stays zero, like D3DXVec3Normalize.
+inline Vec3 Vec3Normalize(const Vec3& a)
+{
+    float len = Vec3Length(a);
+    return len > 0.0f ? a * (1.0f / len) : Vec3(0.0f, 0.0f, 0.0f);
+}
+
+inline Vec3 Vec3Lerp(const Vec3& a, const Vec3& b, float t) { return a + (b - a) * t; }
+
+inline Vec3 Vec3Min(const Vec3& a, const Vec3& b)
+{
+    return Vec3(a.x < b.x ? a.x : b.x, a.y < b.y ? a.y : b.y, a.z < b.z ? a.z : b.z);
+}
+
+inline Vec3 Vec3Max(const Vec3& a, const Vec3& b)
+{
+    return Vec3(a.x > b.x ? a.x : b.x, a.y > b.y ? a.y : b.y, a.z > b.z ? a.z : b.z);
+}
+
+
+//===============================================================
+// Vec4
+
+inline Vec4 operator+(const Vec4& a, const Vec4& b) { return Vec4(a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w); }
+inline Vec4 operator-(const Vec4& a, const Vec4& b) { return Vec4(a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w); }
+inline Vec4 operator*(const Vec4& a, float s)       { return Vec4(a.x * s, a.y * s, a.z * s, a.w * s); }
+
+inline float Vec4Dot(const Vec4& a, const Vec4& b) { return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w; }
+
+
+//===============================================================
+// Row kernels.  Everything below reduces to "row vector times
+// matrix", so that is the only thing with per-ISA code.
+
+namespace math3d_detail
+{
+#if defined(MATH3D_SSE)
+    struct Rows { __m128 r0, r1, r2, r3; };
+
+    inline Rows LoadRows(const Mat4& b)
+    {
+        Rows r = { _mm_loadu_ps(b.m[0]), _mm_loadu_ps(b.m[1]), _mm_loadu_ps(b.m[2]), _mm_loadu_ps(b.m[3]) };
+        return r;
+    }
+
+    // out = (x, y, z, w) * B
+    inline void RowTimes(const float* v, const Rows& b, float* out)
+    {
+        __m128 r = _mm_mul_ps(_mm_set1_ps(v[0]), b.r0);
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(v[1]), b.r1));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(v[2]), b.r2));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(v[3]), b.r3));
+        _mm_storeu_ps(out, r);
+    }
+
+    // out = (x, y, z, 1) * B
+    inline void PointTimes(const float* v, const Rows& b, float* out)
+    {
+        __m128 r = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(v[0]), b.r0), b.r3);
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(v[1]), b.r1));
+        r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(v[2]), b.r2));
+        _mm_storeu_ps(out, r);
+    }
+#elif defined(MATH3D_NEON)
+    struct Rows { float32x4_t r0, r1, r2, r3; };
+
+    inline Rows LoadRows(const Mat4& b)
+    {
+        Rows r = { vld1q_f32(b.m[0]), vld1q_f32(b.m[1]), vld1q_f32(b.m[2]), vld1q_f32(b.m[3]) };
+        return r;
+    }
+
+    inline void RowTimes(const float* v, const Rows& b, float* out)
+    {
+        float32x4_t r = vmulq_n_f32(b.r0, v[0]);
+        r = vmlaq_n_f32(r, b.r1, v[1]);
+        r = vmlaq_n_f32(r, b.r2, v[2]);
+        r = vmlaq_n_f32(r, b.r3, v[3]);
+        vst1q_f32(out, r);
+    }
+
+    inline void PointTimes(const float* v, const Rows& b, float* out)
+    {
+        float32x4_t r = vmlaq_n_f32(b.r3, b.r0, v[0]);
+        r = vmlaq_n_f32(r, b.r1, v[1]);
+        r = vmlaq_n_f32(r, b.r2, v[2]);
+        vst1q_f32(out, r);
+    }
+#else
+    struct Rows { const Mat4* p; };
+
+    inline Rows LoadRows(const Mat4& b)
+    {
+        Rows r = { &b };
+        return r;
+    }
+
+    inline void RowTimes(const float* v, const Rows& b, float* out)
+    {
+        const float (*m)[4] = b.p->m;
+        float x = v[0], y = v[1], z = v[2], w = v[3];
+        for (int j = 0; j < 4; ++j)
+            out[j] = x * m[0][j] + y * m[1][j] + z * m[2][j] + w * m[3][j];
+    }
+
+    inline void PointTimes(const float* v, const Rows& b, float* out)
+    {
+        const float (*m)[4] = b.p->m;
+        float x = v[0], y = v[1], z = v[2];
+        for (int j = 0; j < 4; ++j)
+            out[j] = x * m[0][j] + y * m[1][j] + z * m[2][j] + m[3][j];
+    }
+#endif
+}
+
+
+//===============================================================
+// Mat4
+
+inline Mat4 Mat4Identity()
+{
+    Mat4 r = {{ { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } }};
+    return r;
+}
+
+// a * b: apply a, then b.  out may alias a or b.
+inline void Mat4Multiply(Mat4* out, const Mat4& a, const Mat4& b)
+{
+    math3d_detail::Rows rows = math3d_detail::LoadRows(b);
+    float tmp[4][4];
+    for (int i = 0; i < 4; ++i)
+        math3d_detail::RowTimes(a.m[i], rows, tmp[i]);
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 4; ++j)
+            out->m[i][j] = tmp[i][j];
+}
+
+inline Mat4 operator*(const Mat4& a, const Mat4& b)
+{
+    Mat4 r;
+    Mat4Multiply(&r, a, b);
+    return r;
+}
+
+inline Mat4 Mat4Transpose(const Mat4& a)
+{
+    Mat4 r;
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 4; ++j)
+            r.m[i][j] = a.m[j][i];
+    return r;
+}
+
+inline Mat4 Mat4Translation(float x, float y, float z)
+{
+    Mat4 r = Mat4Identity();
+    r.m[3][0] = x;
+    r.m[3][1] = y;
+    r.m[3][2] = z;
+    return r;
+}
+
+inline Mat4 Mat4Scaling(float x, float y, float z)
+{
+    Mat4 r = {{ { x, 0, 0, 0 }, { 0, y, 0, 0 }, { 0, 0, z, 0 }, { 0, 0, 0, 1 } }};
+    return r;
+}
+
+// Rotations are clockwise when looking along the axis towards the
+// origin, as in D3DX.
+inline Mat4 Mat4RotationX(float angle)
+{
+    float c = cosf(angle), s = sinf(angle);
+    Mat4 r = {{ { 1, 0, 0, 0 }, { 0, c, s, 0 }, { 0, -s, c, 0 }, { 0, 0, 0, 1 } }};
+    return r;
+}
+
+inline Mat4 Mat4RotationY(float angle)
+{
+    float c = cosf(angle), s = sinf(angle);
+    Mat4 r = {{ { c, 0, -s, 0 }, { 0, 1, 0, 0 }, { s, 0, c, 0 }, { 0, 0, 0, 1 } }};
+    return r;
+}
+
+inline Mat4 Mat4RotationZ(float angle)
+{
+    float c = cosf(angle), s = sinf(angle);
+    Mat4 r = {{ { c, s, 0, 0 }, { -s, c, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } }};
+    return r;
+}
+
+inline Mat4 Mat4RotationAxis(const Vec3& axis, float angle)
+{
+    Vec3  n = Vec3Normalize(axis);
+    float c = cosf(angle), s = sinf(angle), t = 1.0f - c;
+    Mat4 r = {{
+        { t * n.x * n.x + c,       t * n.x * n.y + s * n.z, t * n.x * n.z - s * n.y, 0 },
+        { t * n.x * n.y - s * n.z, t * n.y * n.y + c,       t * n.y * n.z + s * n.x, 0 },
+        { t * n.x * n.z + s * n.y, t * n.y * n.z - s * n.x, t * n.z * n.z + c,       0 },
+        { 0, 0, 0, 1 } }};
+    return r;
+}
+
+inline Mat4 Mat4LookAtLH(const Vec3& eye, const Vec3& at, const Vec3& up)
+{
+    Vec3 z = Vec3Normalize(at - eye);
+    Vec3 x = Vec3Normalize(Vec3Cross(up, z));
+    Vec3 y = Vec3Cross(z, x);
+    Mat4 r = {{
+        { x.x, y.x, z.x, 0 },
+        { x.y, y.y, z.y, 0 },
+        { x.z, y.z, z.z, 0 },
+        { -Vec3Dot(x, eye), -Vec3Dot(y, eye), -Vec3Dot(z, eye), 1 } }};
+    return r;
+}
+
+inline Mat4 Mat4PerspectiveFovLH(float fovY, float aspect, float zn, float zf)
+{
+    float ys = 1.0f / tanf(fovY * 0.5f), xs = ys / aspect, q = zf / (zf - zn);
+    Mat4 r = {{ { xs, 0, 0, 0 }, { 0, ys, 0, 0 }, { 0, 0, q, 1 }, { 0, 0, -zn * q, 0 } }};
+    return r;
+}
+
+inline Mat4 Mat4OrthoLH(float w, float h, float zn, float zf)
+{
+    float q = 1.0f / (zf - zn);
+    Mat4 r = {{ { 2 / w, 0, 0, 0 }, { 0, 2 / h, 0, 0 }, { 0, 0, q, 0 }, { 0, 0, -zn * q, 1 } }};
+    return r;
+}
+
+// General inverse.  Returns false (and leaves out alone) if singular.
+inline bool Mat4Inverse(Mat4* out, const Mat4& a)
+{
+    const float* m = a.Data();
+    float inv[16];
+
+    inv[0]  =  m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+    inv[4]  = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+    inv[8]  =  m[4] * m[9]  * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+    inv[12] = -m[4] * m[9]  * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+    inv[1]  = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+    inv[5]  =  m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+    inv[9]  = -m[0] * m[9]  * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+    inv[13] =  m[0] * m[9]  * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+    inv[2]  =  m[1] * m[6]  * m[15] - m[1] * m[7]  * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7]  - m[13] * m[3] * m[6];
+    inv[6]  = -m[0] * m[6]  * m[15] + m[0] * m[7]  * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7]  + m[12] * m[3] * m[6];
+    inv[10] =  m[0] * m[5]  * m[15] - m[0] * m[7]  * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7]  - m[12] * m[3] * m[5];
+    inv[14] = -m[0] * m[5]  * m[14] + m[0] * m[6]  * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6]  + m[12] * m[2] * m[5];
+    inv[3]  = -m[1] * m[6]  * m[11] + m[1] * m[7]  * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9]  * m[2] * m[7]  + m[9]  * m[3] * m[6];
+    inv[7]  =  m[0] * m[6]  * m[11] - m[0] * m[7]  * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8]  * m[2] * m[7]  - m[8]  * m[3] * m[6];
+    inv[11] = -m[0] * m[5]  * m[11] + m[0] * m[7]  * m[9]  + m[4] * m[1] * m[11] - m[4] * m[3] * m[9]  - m[8]  * m[1] * m[7]  + m[8]  * m[3] * m[5];
+    inv[15] =  m[0] * m[5]  * m[10] - m[0] * m[6]  * m[9]  - m[4] * m[1] * m[10] + m[4] * m[2] * m[9]  + m[8]  * m[1] * m[6]  - m[8]  * m[2] * m[5];
+
+    float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+    if (det == 0.0f)
+        return false;
+
+    det = 1.0f / det;
+    for (int i = 0; i < 16; ++i)
+        out->m[i / 4][i % 4] = inv[i] * det;
+    return true;
+}
+
+
+//===============================================================
+// Transforms
+
+inline Vec4 Vec4Transform(const Vec4& v, const Mat4& m)
+{
+    Vec4 r;
+    math3d_detail::RowTimes(&v.x, math3d_detail::LoadRows(m), &r.x);
+    return r;
+}
+
+// (v, 1) * m, divided by w.
+inline Vec3 Vec3TransformCoord(const Vec3& v, const Mat4& m)
+{
+    float in[4] = { v.x, v.y, v.z, 1.0f }, r[4];
+    math3d_detail::PointTimes(in, math3d_detail::LoadRows(m), r);
+    float invW = r[3] != 0.0f ? 1.0f / r[3] : 0.0f;
+    return Vec3(r[0] * invW, r[1] * invW, r[2] * invW);
+}
+
+// (v, 0) * m: directions and normals (use the inverse transpose for
+// normals under non-uniform scale).
+inline Vec3 Vec3TransformNormal(const Vec3& v, const Mat4& m)
+{
+    return Vec3(v.x * m.m[0][0] + v.y * m.m[1][0] + v.z * m.m[2][0],
+                v.x * m.m[0][1] + v.y * m.m[1][1] + v.z * m.m[2][1],
+                v.x * m.m[0][2] + v.y * m.m[1][2] + v.z * m.m[2][2]);
+}
+
+
+//===============================================================
+// Batched versions.  out may alias the input array.
+
+// out[i] = a[i] * b   (e.g. world matrices times view-projection)
+inline void Mat4MultiplyArray(Mat4* out, const Mat4* a, const Mat4& b, size_t count)
+{
+    math3d_detail::Rows rows = math3d_detail::LoadRows(b);
+    for (size_t n = 0; n < count; ++n)
+    {
+        float tmp[4][4];
+        for (int i = 0; i < 4; ++i)
+            math3d_detail::RowTimes(a[n].m[i], rows, tmp[i]);
+        for (int i = 0; i < 4; ++i)
+            for (int j = 0; j < 4; ++j)
+                out[n].m[i][j] = tmp[i][j];
+    }
+}
+
+// out[i] = a[indices[i]] * b: the same, for a sparse subset of a
+// (e.g. the visible objects' world matrices).  out must not alias a.
+inline void Mat4MultiplyGather(Mat4* out, const Mat4* a, const unsigned* indices, const Mat4& b, size_t count)
+{
+    math3d_detail::Rows rows = math3d_detail::LoadRows(b);
+    for (size_t n = 0; n < count; ++n)
+    {
+        const Mat4& src = a[indices[n]];
+        for (int i = 0; i < 4; ++i)
+            math3d_detail::RowTimes(src.m[i], rows, out[n].m[i]);
+    }
+}
+
+// out[i] = a * b[i]   (e.g. a local offset applied before each parent)
+inline void Mat4MultiplyArrayLeft(Mat4* out, const Mat4& a, const Mat4* b, size_t count)
+{
+    for (size_t n = 0; n < count; ++n)
+        Mat4Multiply(&out[n], a, b[n]);
+}
+
+// out[i] = v[i] * m
+inline void Vec4TransformArray(Vec4* out, const Vec4* v, const Mat4& m, size_t count)
+{
+    math3d_detail::Rows rows = math3d_detail::LoadRows(m);
+    for (size_t i = 0; i < count; ++i)
+        math3d_detail::RowTimes(&v[i].x, rows, &out[i].x);
+}
+
+// out[i] = (p[i], 1) * m, without the divide: clip-space positions.
+// Strides are in bytes, so positions can be read straight from vertices.
+inline void Vec3TransformArray(Vec4* out, const Vec3* p, size_t stride, const Mat4& m, size_t count)
+{
+    math3d_detail::Rows rows = math3d_detail::LoadRows(m);
+    const char* src = (const char*)p;
+    for (size_t i = 0; i < count; ++i, src += stride)
+    {
+        const Vec3* v = (const Vec3*)src;
+        float in[4] = { v->x, v->y, v->z, 1.0f };
+        math3d_detail::PointTimes(in, rows, &out[i].x);
+    }
+}
+
+// out[i] = TransformCoord(p[i], m)
+inline void Vec3TransformCoordArray(Vec3* out, const Vec3* p, size_t stride, const Mat4& m, size_t count)
+{
+    math3d_detail::Rows rows = math3d_detail::LoadRows(m);
+    const char* src = (const char*)p;
+    for (size_t i = 0; i < count; ++i, src += stride)
+    {
+        const Vec3* v = (const Vec3*)src;
+        float in[4] = { v->x, v->y, v->z, 1.0f }, r[4];
+        math3d_detail::PointTimes(in, rows, r);
+        float invW = r[3] != 0.0f ? 1.0f / r[3] : 0.0f;
+        out[i] = Vec3(r[0] * invW, r[1] * invW, r[2] * invW);
+    }
+}
+
+
+//===============================================================
+// Quaternions.  QuatMultiply(a, b) is "rotate by a, then by b",
+// matching D3DXQuaternionMultiply and the matrix order.
+
+inline Quat QuatIdentity() { return Quat(0.0f, 0.0f, 0.0f, 1.0f); }
+
+inline Quat QuatRotationAxis(const Vec3& axis, float angle)
+{
+    Vec3  n = Vec3Normalize(axis);
+    float s = sinf(angle * 0.5f);
+    return Quat(n.x * s, n.y * s, n.z * s, cosf(angle * 0.5f));
+}
+
+inline Quat QuatMultiply(const Quat& a, const Quat& b)
+{
+    // Hamilton product b * a.
+    return Quat(b.w * a.x + b.x * a.w + b.y * a.z - b.z * a.y,
+                b.w * a.y - b.x * a.z + b.y * a.w + b.z * a.x,
+                b.w * a.z + b.x * a.y - b.y * a.x + b.z * a.w,
+                b.w * a.w - b.x * a.x - b.y * a.y - b.z * a.z);
+}
+
+// Roll about z, then pitch about x, then yaw about y (D3DX order).
+inline Quat QuatRotationYawPitchRoll(float yaw, float pitch, float roll)
+{
+    return QuatMultiply(QuatMultiply(QuatRotationAxis(Vec3(0, 0, 1), roll),
+                                     QuatRotationAxis(Vec3(1, 0, 0), pitch)),
+                        QuatRotationAxis(Vec3(0, 1, 0), yaw));
+}
+
+inline Quat QuatConjugate(const Quat& q) { return Quat(-q.x, -q.y, -q.z, q.w); }
+
+inline float QuatDot(const Quat& a, const Quat& b) { return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w; }
+
+inline Quat QuatNormalize(const Quat& q)
+{
+    float len = sqrtf(QuatDot(q, q));
+    float s   = len > 0.0f ? 1.0f / len : 0.0f;
+    return Quat(q.x * s, q.y * s, q.z * s, q.w * s);
+}
+
+// Shortest-path spherical interpolation.
+inline Quat QuatSlerp(const Quat& a, const Quat& b, float t)
+{
+    float cosTheta = QuatDot(a, b);
+    float sign     = cosTheta < 0.0f ? -1.0f : 1.0f;
+    cosTheta *= sign;
+
+    float wa, wb;
+    if (cosTheta > 0.9995f)
+    {
+        // Nearly parallel: lerp and renormalise.
+        wa = 1.0f - t;
+        wb = t;
+    }
+    else
+    {
+        float theta = acosf(cosTheta), invSin = 1.0f / sinf(theta);
+        wa = sinf((1.0f - t) * theta) * invSin;
+        wb = sinf(t * theta) * invSin;
+    }
+    wb *= sign;
+    return QuatNormalize(Quat(a.x * wa + b.x * wb, a.y * wa + b.y * wb,
+                              a.z * wa + b.z * wb, a.w * wa + b.w * wb));
+}
+
+inline Vec3 QuatRotate(const Vec3& v, const Quat& q)
+{
+    // v + 2w(u x v) + 2u x (u x v), u = q.xyz
+    Vec3 u(q.x, q.y, q.z);
+    Vec3 t = Vec3Cross(u, v) * 2.0f;
+    return v + t * q.w + Vec3Cross(u, t);
+}
+
+inline Mat4 Mat4RotationQuat(const Quat& q)
+{
+    float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+    Mat4 r = {{
+        { 1 - 2 * (yy + zz), 2 * (xy + wz),     2 * (xz - wy),     0 },
+        { 2 * (xy - wz),     1 - 2 * (xx + zz), 2 * (yz + wx),     0 },
+        { 2 * (xz + wy),     2 * (yz - wx),     1 - 2 * (xx + yy), 0 },
+        { 0, 0, 0, 1 } }};
+    return r;
+}
+
+// Scale, then rotate, then translate (D3DXMatrixTransformation's usual
+// case without pivots).
+inline Mat4 Mat4AffineTransformation(const Vec3& scale, const Quat& rotation, const Vec3& translation)
+{
+    Mat4 r = Mat4RotationQuat(rotation);
+    for (int j = 0; j < 3; ++j)
+    {
+        r.m[0][j] *= scale.x;
+        r.m[1][j] *= scale.y;
+        r.m[2][j] *= scale.z;
+    }
+    r.m[3][0] = translation.x;
+    r.m[3][1] = translation.y;
+    r.m[3][2] = translation.z;
+    return r;
+}
+
+#endif // MATH3D_H
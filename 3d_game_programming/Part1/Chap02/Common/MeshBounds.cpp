@@ -0,0 +1,90 @@
+//=============================================================================
+// MeshBounds.cpp
+//=============================================================================
+
+#include "MeshBounds.h"
+
+
+HRESULT ComputeMeshBounds(ID3DXMesh* pMesh, DWORD numSubsets, MeshBounds* pBounds)
+{
+    if (pMesh == NULL || pBounds == NULL)
+        return E_INVALIDARG;
+
+    DWORD numVertices = pMesh->GetNumVertices();
+    DWORD stride      = pMesh->GetNumBytesPerVertex();
+
+    void* pVertices = NULL;
+    HRESULT hr = pMesh->LockVertexBuffer(D3DLOCK_READONLY, &pVertices);
+    if (FAILED(hr))
+        return hr;
+
+    ComputeBounds(pVertices, stride, numVertices, &pBounds->box, &pBounds->sphere);
+    pBounds->subsets.assign(numSubsets, Aabb::Empty());
+
+    if (numSubsets > 0)
+    {
+        void*  pIndices    = NULL;
+        DWORD* pAttributes = NULL;
+        if (SUCCEEDED(hr = pMesh->LockIndexBuffer(D3DLOCK_READONLY, &pIndices)))
+        {
+            if (SUCCEEDED(hr = pMesh->LockAttributeBuffer(D3DLOCK_READONLY, &pAttributes)))
+            {
+                bool        is32   = (pMesh->GetOptions() & D3DXMESH_32BIT) != 0;
+                const char* pBytes = (const char*)pVertices;
+                DWORD       faces  = pMesh->GetNumFaces();
+
+                for (DWORD f = 0; f < faces; ++f)
+                {
+                    if (pAttributes[f] >= numSubsets)
+                        continue;
+
+                    Aabb& box = pBounds->subsets[pAttributes[f]];
+                    for (DWORD k = 0; k < 3; ++k)
+                    {
+                        DWORD v = is32 ? ((const DWORD*)pIndices)[f * 3 + k]
+                                       : ((const WORD*)pIndices)[f * 3 + k];
+                        if (v < numVertices)
+                            box.Grow(*(const Vec3*)(pBytes + v * stride));
+                    }
+                }
+                pMesh->UnlockAttributeBuffer();
+            }
+            pMesh->UnlockIndexBuffer();
+        }
+    }
+
+    pMesh->UnlockVertexBuffer();
+    return hr;
+}
+
+HRESULT ReadMeshTriangles(ID3DXMesh* pMesh, std::vector<Vec3>& positions, std::vector<unsigned>& indices)
+{
+    if (pMesh == NULL)
+        return E_INVALIDARG;
+
+    DWORD numVertices = pMesh->GetNumVertices();
+    DWORD stride      = pMesh->GetNumBytesPerVertex();
+    DWORD numIndices  = pMesh->GetNumFaces() * 3;
+
+    void* pVertices = NULL;
+    HRESULT hr = pMesh->LockVertexBuffer(D3DLOCK_READONLY, &pVertices);
+    if (FAILED(hr))
+        return hr;
+
+    positions.resize(numVertices);
+    for (DWORD i = 0; i < numVertices; ++i)
+        positions[i] = *(const Vec3*)((const char*)pVertices + i * stride);
+    pMesh->UnlockVertexBuffer();
+
+    void* pIndices = NULL;
+    if (FAILED(hr = pMesh->LockIndexBuffer(D3DLOCK_READONLY, &pIndices)))
+        return hr;
+
+    indices.resize(numIndices);
+    bool is32 = (pMesh->GetOptions() & D3DXMESH_32BIT) != 0;
+    for (DWORD i = 0; i < numIndices; ++i)
+        indices[i] = is32 ? ((const DWORD*)pIndices)[i] : ((const WORD*)pIndices)[i];
+    pMesh->UnlockIndexBuffer();
+
+    return S_OK;
+}
@@ -0,0 +1,32 @@
+//=============================================================================
+// MeshBounds.h
+//
+// Bounding volumes of an ID3DXMesh, computed once when the mesh is loaded
+// (and again when it is hot-reloaded) so culling never touches vertex data,
+// and a CPU copy of its triangles for occlusion culling.
+//=============================================================================
+
+#ifndef MESH_BOUNDS_H
+#define MESH_BOUNDS_H
+
+#include <d3dx9.h>
+#include <vector>
+#include "Culling.h"
+
+
+struct MeshBounds
+{
+    Aabb                box;        // whole mesh, object space
+    BoundingSphere      sphere;
+    std::vector<Aabb>   subsets;    // one per attribute id < numSubsets; empty boxes for unused ids
+};
+
+// Reads the positions (the first element of every vertex) and, when
+// numSubsets > 0, the attribute and index buffers for per-subset boxes.
+HRESULT ComputeMeshBounds(ID3DXMesh* pMesh, DWORD numSubsets, MeshBounds* pBounds);
+
+// Copies positions and a 32-bit triangle list out of the mesh, e.g. for use
+// as a CPU occluder (OcclusionBuffer.h).
+HRESULT ReadMeshTriangles(ID3DXMesh* pMesh, std::vector<Vec3>& positions, std::vector<unsigned>& indices);
+
+#endif // MESH_BOUNDS_H
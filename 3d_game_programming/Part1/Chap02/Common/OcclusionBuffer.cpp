@@ -0,0 +1,308 @@
+//=============================================================================
+// OcclusionBuffer.cpp
+//=============================================================================
+
+#include "OcclusionBuffer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+
+namespace
+{
+    const unsigned FULL_MASK = 0xffffffffu;
+    const float    MIN_W     = 1e-4f;
+
+    double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    struct EdgeSetup
+    {
+        float a[3], b[3], c[3];     // E_i(x, y) = a*x + b*y + c, >= 0 inside
+        float za, zb, zc;           // depth plane
+    };
+}
+
+
+OcclusionBuffer::OcclusionBuffer()
+    : m_width(0), m_height(0), m_tilesX(0), m_tilesY(0)
+{
+    Resize(256, 128);
+}
+
+void OcclusionBuffer::Resize(unsigned width, unsigned height)
+{
+    m_tilesX = (width + TILE_WIDTH - 1) / TILE_WIDTH;
+    m_tilesY = (height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+    m_width  = m_tilesX * TILE_WIDTH;
+    m_height = m_tilesY * TILE_HEIGHT;
+    m_zMax0.resize(m_tilesX * m_tilesY);
+    m_zMax1.resize(m_tilesX * m_tilesY);
+    m_mask.resize(m_tilesX * m_tilesY);
+    Clear();
+}
+
+void OcclusionBuffer::Clear()
+{
+    std::fill(m_zMax0.begin(), m_zMax0.end(), 1.0f);
+    std::fill(m_zMax1.begin(), m_zMax1.end(), 0.0f);
+    std::fill(m_mask.begin(), m_mask.end(), 0u);
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+
+//===============================================================
+// Occluders
+
+void OcclusionBuffer::RenderOccluder(const Vec3* pPositions, unsigned numVertices,
+                                     const unsigned* pIndices, unsigned numTriangles,
+                                     const Mat4& worldViewProj)
+{
+    // Nothing to transform, and no vertex the indices could refer to.
+    if (numVertices == 0 || numTriangles == 0)
+        return;
+
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+
+    if (m_clip.size() < numVertices)
+        m_clip.resize(numVertices);
+    Vec3TransformArray(&m_clip[0], pPositions, sizeof(Vec3), worldViewProj, numVertices);
+
+    unsigned rasterized = 0;
+    for (unsigned t = 0; t < numTriangles; ++t)
+    {
+        float v[3][3];
+        bool  skip = false;
+        for (int k = 0; k < 3 && !skip; ++k)
+        {
+            unsigned    index = pIndices[t * 3 + k];
+            const Vec4& c     = m_clip[index < numVertices ? index : 0];
+            if (c.w < MIN_W || c.z < 0.0f)
+            {
+                skip = true;
+                break;
+            }
+            float invW = 1.0f / c.w;
+            v[k][0] = (c.x * invW * 0.5f + 0.5f) * m_width;
+            v[k][1] = (0.5f - c.y * invW * 0.5f) * m_height;
+            v[k][2] = std::min(c.z * invW, 1.0f);
+        }
+        if (skip)
+            continue;
+
+        RasterizeTriangle(v[0], v[1], v[2]);
+        ++rasterized;
+    }
+
+    ++m_stats.occluders;
+    m_stats.triangles += rasterized;
+    m_stats.rasterMs  += MillisecondsSince(start);
+}
+
+void OcclusionBuffer::MergeTile(unsigned tile, unsigned mask, float zMax)
+{
+    // A layer behind the reference can never improve it.
+    if (zMax >= m_zMax0[tile])
+        return;
+
+    m_zMax1[tile] = m_mask[tile] ? std::max(m_zMax1[tile], zMax) : zMax;
+    m_mask[tile] |= mask;
+
+    if (m_mask[tile] == FULL_MASK)
+    {
+        // Every pixel now has an occluder no farther than zMax1.
+        m_zMax0[tile] = std::min(m_zMax0[tile], m_zMax1[tile]);
+        m_zMax1[tile] = 0.0f;
+        m_mask[tile]  = 0;
+    }
+}
+
+void OcclusionBuffer::RasterizeTriangle(const float* v0, const float* v1, const float* v2)
+{
+    float area = (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v2[0] - v0[0]) * (v1[1] - v0[1]);
+    if (fabsf(area) < 1e-8f)
+        return;
+    if (area < 0.0f)
+    {
+        std::swap(v1, v2);
+        area = -area;
+    }
+
+    float minX = std::min(v0[0], std::min(v1[0], v2[0])), maxX = std::max(v0[0], std::max(v1[0], v2[0]));
+    float minY = std::min(v0[1], std::min(v1[1], v2[1])), maxY = std::max(v0[1], std::max(v1[1], v2[1]));
+    if (maxX < 0.0f || maxY < 0.0f || minX >= (float)m_width || minY >= (float)m_height)
+        return;
+
+    // Clamp before converting: a float beyond the integer range (a vertex
+    // close to w = 0) has no defined conversion.  NaNs end up at the edges.
+    minX = std::max(0.0f, minX);
+    minY = std::max(0.0f, minY);
+    maxX = std::min((float)(m_width - 1), maxX);
+    maxY = std::min((float)(m_height - 1), maxY);
+
+    unsigned tx0 = (unsigned)minX / TILE_WIDTH;
+    unsigned ty0 = (unsigned)minY / TILE_HEIGHT;
+    unsigned tx1 = std::min((unsigned)maxX / TILE_WIDTH, m_tilesX - 1);
+    unsigned ty1 = std::min((unsigned)maxY / TILE_HEIGHT, m_tilesY - 1);
+
+    // Edge i is opposite vertex i, so E_i / area is vertex i's weight.
+    const float* v[3] = { v0, v1, v2 };
+    EdgeSetup e;
+    for (int i = 0; i < 3; ++i)
+    {
+        const float* p = v[(i + 1) % 3];
+        const float* q = v[(i + 2) % 3];
+        e.a[i] = -(q[1] - p[1]);
+        e.b[i] = q[0] - p[0];
+        e.c[i] = -(e.a[i] * p[0] + e.b[i] * p[1]);
+    }
+    float invArea = 1.0f / area;
+    e.za = (e.a[0] * v0[2] + e.a[1] * v1[2] + e.a[2] * v2[2]) * invArea;
+    e.zb = (e.b[0] * v0[2] + e.b[1] * v1[2] + e.b[2] * v2[2]) * invArea;
+    e.zc = (e.c[0] * v0[2] + e.c[1] * v1[2] + e.c[2] * v2[2]) * invArea;
+
+    for (unsigned ty = ty0; ty <= ty1; ++ty)
+    {
+        for (unsigned tx = tx0; tx <= tx1; ++tx)
+        {
+            unsigned tile = ty * m_tilesX + tx;
+            unsigned mask = 0;
+            float    zMax = 0.0f;
+
+#if defined(MATH3D_SSE)
+            __m128 zMaxV = _mm_setzero_ps();
+            __m128 zero  = _mm_setzero_ps();
+            for (unsigned row = 0; row < TILE_HEIGHT; ++row)
+            {
+                float  py = (float)(ty * TILE_HEIGHT + row) + 0.5f;
+                for (unsigned half = 0; half < TILE_WIDTH; half += 4)
+                {
+                    float  x  = (float)(tx * TILE_WIDTH + half) + 0.5f;
+                    __m128 px = _mm_add_ps(_mm_set1_ps(x), _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f));
+                    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                    for (int i = 0; i < 3; ++i)
+                    {
+                        __m128 ei = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(e.a[i])),
+                                               _mm_set1_ps(e.b[i] * py + e.c[i]));
+                        inside = _mm_and_ps(inside, _mm_cmpge_ps(ei, zero));
+                    }
+                    unsigned bits = (unsigned)_mm_movemask_ps(inside);
+                    if (bits == 0)
+                        continue;
+
+                    __m128 z = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(e.za)), _mm_set1_ps(e.zb * py + e.zc));
+                    zMaxV = _mm_max_ps(zMaxV, _mm_and_ps(z, inside));
+                    mask |= bits << (row * TILE_WIDTH + half);
+                }
+            }
+            if (mask == 0)
+                continue;
+
+            float lanes[4];
+            _mm_storeu_ps(lanes, zMaxV);
+            zMax = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+#else
+            for (unsigned row = 0; row < TILE_HEIGHT; ++row)
+            {
+                float py = (float)(ty * TILE_HEIGHT + row) + 0.5f;
+                for (unsigned col = 0; col < TILE_WIDTH; ++col)
+                {
+                    float px = (float)(tx * TILE_WIDTH + col) + 0.5f;
+                    if (e.a[0] * px + e.b[0] * py + e.c[0] < 0.0f ||
+                        e.a[1] * px + e.b[1] * py + e.c[1] < 0.0f ||
+                        e.a[2] * px + e.b[2] * py + e.c[2] < 0.0f)
+                        continue;
+
+                    zMax = std::max(zMax, e.za * px + e.zb * py + e.zc);
+                    mask |= 1u << (row * TILE_WIDTH + col);
+                }
+            }
+            if (mask == 0)
+                continue;
+#endif
+            MergeTile(tile, mask, std::min(zMax, 1.0f));
+        }
+    }
+}
+
+
+//===============================================================
+// Tests
+
+bool OcclusionBuffer::TestAabb(const Aabb& worldBox, const Mat4& viewProj)
+{
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    ++m_stats.tested;
+
+    Vec3 corners[8];
+    for (int i = 0; i < 8; ++i)
+    {
+        corners[i] = Vec3((i & 1) ? worldBox.max.x : worldBox.min.x,
+                          (i & 2) ? worldBox.max.y : worldBox.min.y,
+                          (i & 4) ? worldBox.max.z : worldBox.min.z);
+    }
+    Vec4 clip[8];
+    Vec3TransformArray(clip, corners, sizeof(Vec3), viewProj, 8);
+
+    float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, minZ = 1.0f;
+    bool  visible = false;
+    for (int i = 0; i < 8 && !visible; ++i)
+    {
+        if (clip[i].w < MIN_W || clip[i].z < 0.0f)
+        {
+            visible = true;     // crosses the near plane
+            break;
+        }
+        float invW = 1.0f / clip[i].w;
+        float x = (clip[i].x * invW * 0.5f + 0.5f) * m_width;
+        float y = (0.5f - clip[i].y * invW * 0.5f) * m_height;
+        minX = std::min(minX, x); maxX = std::max(maxX, x);
+        minY = std::min(minY, y); maxY = std::max(maxY, y);
+        minZ = std::min(minZ, clip[i].z * invW);
+    }
+
+    if (!visible)
+    {
+        // A box wholly off-screen is left to the frustum test.  Otherwise
+        // clamp to the buffer in float first, since x and y grow without
+        // bound as w approaches MIN_W.
+        if (maxX < 0.0f || maxY < 0.0f || minX >= (float)m_width || minY >= (float)m_height)
+            visible = true;
+        minX = std::max(0.0f, minX);
+        minY = std::max(0.0f, minY);
+        maxX = std::min((float)(m_width - 1), maxX);
+        maxY = std::min((float)(m_height - 1), maxY);
+
+        int tx0 = (int)minX / (int)TILE_WIDTH;
+        int ty0 = (int)minY / (int)TILE_HEIGHT;
+        int tx1 = std::min((int)m_tilesX - 1, (int)maxX / (int)TILE_WIDTH);
+        int ty1 = std::min((int)m_tilesY - 1, (int)maxY / (int)TILE_HEIGHT);
+
+        for (int ty = ty0; ty <= ty1 && !visible; ++ty)
+        {
+            const float* row = &m_zMax0[ty * m_tilesX];
+            int tx = tx0;
+#if defined(MATH3D_SSE)
+            __m128 z = _mm_set1_ps(minZ);
+            for (; tx + 3 <= tx1; tx += 4)
+            {
+                if (_mm_movemask_ps(_mm_cmple_ps(z, _mm_loadu_ps(row + tx))) != 0)
+                {
+                    visible = true;
+                    break;
+                }
+            }
+#endif
+            for (; tx <= tx1 && !visible; ++tx)
+                visible = minZ <= row[tx];
+        }
+    }
+
+    if (!visible)
+        ++m_stats.occluded;
+    m_stats.testMs += MillisecondsSince(start);
+    return visible;
+}
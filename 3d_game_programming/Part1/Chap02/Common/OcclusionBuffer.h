@@ -0,0 +1,91 @@
+//=============================================================================
+// OcclusionBuffer.h
+//
+// Coarse CPU depth buffer for occlusion culling.
+//
+// A few large, nearby objects are rasterized as occluders with the same
+// clip-space conventions as D3D (z/w in [0, 1], smaller is nearer).  Every
+// other object's bounding box is then projected to a screen rectangle and
+// its nearest depth; if that depth is behind the occluders everywhere in
+// the rectangle, the object is hidden and need not be drawn.
+//
+// The buffer is masked, not per-pixel: the screen (256x128 by default) is
+// split into 8x4-pixel tiles, and each tile keeps
+//
+//     reference depth  farthest depth of an occluder layer that covers the
+//                      whole tile (1 until one does)
+//     working mask     which of its 32 pixels the current layer covers
+//     working depth    farthest depth of that layer
+//
+// When the working mask fills up, the working layer is folded into the
+// reference depth and starts again.  An object is hidden in a tile when it
+// is behind the reference depth, so tests only ever look at one float per
+// tile.  Coverage is computed 4 pixels at a time with SSE2.
+//
+// Occluder triangles that cross the near plane are skipped rather than
+// clipped, which only loses occlusion.  A pixel counts as covered when its
+// centre is inside the triangle, so an object that peeks through a gap
+// narrower than a buffer pixel can be culled; keep occluders to solid
+// meshes.
+//=============================================================================
+
+#ifndef OCCLUSION_BUFFER_H
+#define OCCLUSION_BUFFER_H
+
+#include "Culling.h"
+#include <vector>
+
+
+struct OcclusionStats
+{
+    unsigned occluders;
+    unsigned triangles;         // occluder triangles rasterized
+    unsigned tested;
+    unsigned occluded;
+    double   rasterMs;
+    double   testMs;
+};
+
+class OcclusionBuffer
+{
+public:
+    static const unsigned TILE_WIDTH  = 8;
+    static const unsigned TILE_HEIGHT = 4;
+
+    OcclusionBuffer();
+
+    // Sizes are rounded up to whole tiles.
+    void Resize(unsigned width, unsigned height);
+    unsigned Width() const  { return m_width; }
+    unsigned Height() const { return m_height; }
+
+    // Clears every tile to depth 1 and the statistics; call once per frame.
+    void Clear();
+
+    // Rasterizes an indexed triangle list, both windings.
+    void RenderOccluder(const Vec3* pPositions, unsigned numVertices,
+                        const unsigned* pIndices, unsigned numTriangles, const Mat4& worldViewProj);
+
+    // True if any part of the box may be visible.  Boxes crossing the
+    // near plane are always visible.
+    bool TestAabb(const Aabb& worldBox, const Mat4& viewProj);
+
+    // Reference depth of a tile, for debugging.
+    float TileDepth(unsigned tx, unsigned ty) const { return m_zMax0[ty * m_tilesX + tx]; }
+
+    const OcclusionStats& Stats() const { return m_stats; }
+
+private:
+    void RasterizeTriangle(const float* v0, const float* v1, const float* v2);
+    void MergeTile(unsigned tile, unsigned mask, float zMax);
+
+    unsigned              m_width, m_height;
+    unsigned              m_tilesX, m_tilesY;
+    std::vector<float>    m_zMax0;      // per tile: reference layer
+    std::vector<float>    m_zMax1;      // per tile: working layer
+    std::vector<unsigned> m_mask;       // per tile: working layer coverage, bit y*8+x
+    std::vector<Vec4>     m_clip;       // scratch: occluder vertices in clip space
+    OcclusionStats        m_stats;
+};
+
+#endif // OCCLUSION_BUFFER_H
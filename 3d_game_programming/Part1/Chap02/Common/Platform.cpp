@@ -0,0 +1,110 @@
+//=============================================================================
+// Platform.cpp
+//
+// The parts of the platform layer both backends share.
+//=============================================================================
+
+#include "Platform.h"
+#include "GameClock.h"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define snprintf _snprintf
+#endif
+
+
+namespace
+{
+    std::string s_commandLine;
+
+    // option in cmdLine as a word of its own, or NULL.
+    const char* FindOption(const char* cmdLine, const char* option)
+    {
+        size_t n = strlen(option);
+        for (const char* p = strstr(cmdLine, option); p; p = strstr(p + 1, option))
+        {
+            if ((p == cmdLine || p[-1] == ' ') && (p[n] == ' ' || p[n] == '\0'))
+                return p;
+        }
+        return NULL;
+    }
+
+    void Send(const PlatformApp& app, PlatformEventType type, unsigned key)
+    {
+        if (app.OnEvent == NULL)
+            return;
+        PlatformEvent e = { type, key, 0, 0 };
+        app.OnEvent(e);
+    }
+}
+
+
+int PlatformStart(const char* cmdLine)
+{
+    s_commandLine = cmdLine ? cmdLine : "";
+    return PlatformMain(s_commandLine.c_str());
+}
+
+const char* PlatformCommandLine()
+{
+    return s_commandLine.c_str();
+}
+
+void PlatformParseOptions(const char* cmdLine, PlatformOptions& options)
+{
+    options.headless = false;
+    options.frames   = 0;
+    options.press.clear();
+    if (cmdLine == NULL)
+        return;
+
+    options.headless = FindOption(cmdLine, "-headless") != NULL;
+
+    const char* p = FindOption(cmdLine, "-frames");
+    if (p)
+    {
+        int frames = atoi(p + strlen("-frames"));
+        options.frames = frames > 0 ? (unsigned)frames : 0;
+    }
+
+    // The keys run to the next space.
+    p = FindOption(cmdLine, "-press");
+    if (p)
+    {
+        p += strlen("-press");
+        while (*p == ' ')
+            ++p;
+        while (*p && *p != ' ')
+            options.press += (char)toupper((unsigned char)*p++);
+    }
+}
+
+void PlatformRunFrames(const PlatformApp& app, const PlatformOptions& options)
+{
+    for (size_t i = 0; i < options.press.size(); ++i)
+    {
+        Send(app, PLATFORM_KEY_DOWN, (unsigned char)options.press[i]);
+        Send(app, PLATFORM_KEY_UP, (unsigned char)options.press[i]);
+    }
+
+    unsigned frames = options.frames ? options.frames : PLATFORM_HEADLESS_FRAMES;
+    unsigned long long start = ClockNanoseconds();
+    for (unsigned f = 0; f < frames; ++f)
+        app.Render();
+    double ms = (ClockNanoseconds() - start) * 1e-6;
+
+    char msg[256];
+    snprintf(msg, sizeof(msg), "[Platform] %s: %u frames in %.1f ms, %.3f ms per frame\n",
+             app.title, frames, ms, ms / frames);
+#ifdef _WIN32
+    OutputDebugStringA(msg);
+#endif
+    fputs(msg, stderr);
+}
@@ -0,0 +1,111 @@
+//=============================================================================
+// Platform.h
+//
+// What a sample needs from the operating system besides Direct3D: a window,
+// its input events and the program's entry point.  A sample no longer
+// writes WinMain, RegisterClassEx, CreateWindow and MsgProc itself; it
+// describes itself and hands over its entry points:
+//
+//     INT PlatformMain( const char* cmdLine )
+//     {
+//         g_profiler.ParseCommandLine( cmdLine );
+//         PlatformApp app = { "D3D Tutorial 04: Lights", 300, 300,
+//                             InitApp, Render, Cleanup, OnEvent, false };
+//         return PlatformRun( app );
+//     }
+//
+// Two backends implement PlatformRun():
+//
+//   PlatformWin32.cpp     WinMain, a window and its message loop.  Render()
+//                         runs whenever the queue is empty, Cleanup() when
+//                         the window is destroyed.
+//   PlatformHeadless.cpp  main() for builds without Win32 (Linux render
+//                         servers): no window at all, Init() gets NULL.
+//
+// Both accept "-frames N" (quit after N frames), and on Windows "-headless"
+// runs like the headless backend with a window that is never shown, since
+// Direct3D 9 still needs one.  Headless runs draw -frames frames (default
+// PLATFORM_HEADLESS_FRAMES) as fast as they can, after feeding the keys of
+// "-press KEYS" to OnEvent(), and print the time they took.
+//
+// Timers and files are already portable: ClockNanoseconds() and GameClock
+// (GameClock.h), and the helpers in FileUtil.h.
+//=============================================================================
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <string>
+
+
+// HWND on Windows; NULL when there is no window.
+typedef void* PlatformWindow;
+
+const unsigned PLATFORM_HEADLESS_FRAMES = 600;
+
+
+enum PlatformEventType
+{
+    PLATFORM_KEY_DOWN,
+    PLATFORM_KEY_UP,
+    PLATFORM_RESIZE
+};
+
+struct PlatformEvent
+{
+    PlatformEventType type;
+    unsigned          key;              // virtual key; letters and digits are their upper-case character
+    unsigned          width, height;    // client size, PLATFORM_RESIZE
+};
+
+struct PlatformApp
+{
+    const char* title;
+    unsigned    width, height;          // window size
+
+    // Init() returns false to quit without rendering.  Cleanup() is called
+    // once, and only if Init() succeeded.  OnEvent may be NULL.
+    bool (*Init)(PlatformWindow window);
+    void (*Render)();
+    void (*Cleanup)();
+    void (*OnEvent)(const PlatformEvent& event);
+
+    // Render only when the window needs repainting (WM_PAINT) instead of
+    // continuously.  Headless runs render every frame regardless.
+    bool        renderOnDemand;
+};
+
+struct PlatformOptions
+{
+    bool        headless;
+    unsigned    frames;                 // 0: until the window is closed
+    std::string press;                  // keys to press before the first frame
+};
+
+
+// Defined by the sample; the backend's entry point calls it.
+int PlatformMain(const char* cmdLine);
+
+// Runs app until it quits and returns the exit code (non-zero if Init()
+// failed).  Implemented by the backend.
+int PlatformRun(const PlatformApp& app);
+
+// Sets the title of the window, if there is one.  Implemented by the backend.
+void PlatformSetWindowTitle(const char* title);
+
+
+// Shared by the backends (Platform.cpp):
+
+// Keeps cmdLine for PlatformCommandLine() and calls PlatformMain().
+int PlatformStart(const char* cmdLine);
+const char* PlatformCommandLine();
+
+// Reads "-headless", "-frames N" and "-press KEYS" from cmdLine.
+void PlatformParseOptions(const char* cmdLine, PlatformOptions& options);
+
+// The headless loop: presses options' keys, renders options.frames frames
+// (PLATFORM_HEADLESS_FRAMES if 0) and reports the time.  Does not call
+// Cleanup().
+void PlatformRunFrames(const PlatformApp& app, const PlatformOptions& options);
+
+#endif // PLATFORM_H
@@ -0,0 +1,54 @@
+//=============================================================================
+// PlatformHeadless.cpp
+//
+// Platform layer without a window system (Linux render servers): main(),
+// no window, and a fixed number of frames.
+//=============================================================================
+
+#ifndef _WIN32
+
+#include "Platform.h"
+#include <cstdio>
+#include <cstring>
+
+
+int PlatformRun(const PlatformApp& app)
+{
+    PlatformOptions options;
+    PlatformParseOptions(PlatformCommandLine(), options);
+
+    if (!app.Init(NULL))
+    {
+        fprintf(stderr, "[Platform] %s: initialisation failed\n", app.title);
+        return 1;
+    }
+    PlatformRunFrames(app, options);
+    app.Cleanup();
+    return 0;
+}
+
+void PlatformSetWindowTitle(const char*)
+{
+}
+
+
+int main(int argc, char* argv[])
+{
+    // One string, as GetCommandLineA() returns it, so the samples' option
+    // parsing is the same everywhere.  Arguments with spaces are quoted.
+    std::string cmdLine;
+    for (int i = 0; i < argc; ++i)
+    {
+        if (i)
+            cmdLine += ' ';
+        bool quote = strchr(argv[i], ' ') != NULL;
+        if (quote)
+            cmdLine += '"';
+        cmdLine += argv[i];
+        if (quote)
+            cmdLine += '"';
+    }
+    return PlatformStart(cmdLine.c_str());
+}
+
+#endif // !_WIN32
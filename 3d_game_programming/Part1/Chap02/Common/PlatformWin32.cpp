@@ -0,0 +1,160 @@
+//=============================================================================
+// PlatformWin32.cpp
+//
+// Platform layer on Win32: WinMain, one window and its message loop.
+//=============================================================================
+
+#ifdef _WIN32
+
+#include "Platform.h"
+#include <Windows.h>
+
+
+namespace
+{
+    const char* const  CLASS_NAME = "D3D Tutorial";
+
+    const PlatformApp* s_pApp     = NULL;
+    PlatformOptions    s_options;
+    HWND               s_hWnd     = NULL;
+    unsigned           s_frames   = 0;
+    bool               s_running  = false;      // Init() succeeded, Cleanup() not called yet
+
+    void Send(PlatformEventType type, unsigned key, unsigned width, unsigned height)
+    {
+        if (!s_running || s_pApp->OnEvent == NULL)
+            return;
+        PlatformEvent e = { type, key, width, height };
+        s_pApp->OnEvent(e);
+    }
+
+    void Shutdown()
+    {
+        if (!s_running)
+            return;
+        s_running = false;
+        s_pApp->Cleanup();
+    }
+
+    // One frame; closes the window after -frames frames.
+    void RenderFrame()
+    {
+        s_pApp->Render();
+        if (s_options.frames && ++s_frames >= s_options.frames)
+            DestroyWindow(s_hWnd);
+    }
+
+    LRESULT WINAPI MsgProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
+    {
+        switch (msg)
+        {
+        case WM_DESTROY:
+            Shutdown();
+            PostQuitMessage(0);
+            return 0;
+
+        case WM_KEYDOWN:
+            Send(PLATFORM_KEY_DOWN, (unsigned)wParam, 0, 0);
+            return 0;
+
+        case WM_KEYUP:
+            Send(PLATFORM_KEY_UP, (unsigned)wParam, 0, 0);
+            return 0;
+
+        case WM_SIZE:
+            Send(PLATFORM_RESIZE, 0, LOWORD(lParam), HIWORD(lParam));
+            break;
+
+        case WM_PAINT:
+            if (s_pApp->renderOnDemand && s_running)
+            {
+                RenderFrame();
+                ValidateRect(hWnd, NULL);
+                return 0;
+            }
+            break;
+        }
+
+        return DefWindowProc(hWnd, msg, wParam, lParam);
+    }
+}
+
+
+int PlatformRun(const PlatformApp& app)
+{
+    s_pApp   = &app;
+    s_frames = 0;
+    PlatformParseOptions(PlatformCommandLine(), s_options);
+
+    WNDCLASSEX wc = { sizeof(WNDCLASSEX), CS_CLASSDC, MsgProc, 0L, 0L,
+                      GetModuleHandle(NULL), NULL, NULL, NULL, NULL,
+                      CLASS_NAME, NULL };
+    RegisterClassEx(&wc);
+
+    s_hWnd = CreateWindow(CLASS_NAME, app.title, WS_OVERLAPPEDWINDOW, 100, 100, app.width, app.height,
+                          GetDesktopWindow(), NULL, wc.hInstance, NULL);
+
+    int status = 1;
+    if (s_hWnd != NULL && app.Init(s_hWnd))
+    {
+        s_running = true;
+        status = 0;
+        if (s_options.headless)
+        {
+            // Direct3D renders into the window, which is never shown.
+            PlatformRunFrames(app, s_options);
+            Shutdown();
+            DestroyWindow(s_hWnd);
+        }
+        else
+        {
+            ShowWindow(s_hWnd, SW_SHOWDEFAULT);
+            UpdateWindow(s_hWnd);
+
+            MSG msg;
+            ZeroMemory(&msg, sizeof(msg));
+            if (app.renderOnDemand)
+            {
+                while (GetMessage(&msg, NULL, 0, 0))
+                {
+                    TranslateMessage(&msg);
+                    DispatchMessage(&msg);
+                }
+            }
+            else
+            {
+                // Render whenever there is no message to handle.
+                while (msg.message != WM_QUIT)
+                {
+                    if (PeekMessage(&msg, NULL, 0U, 0U, PM_REMOVE))
+                    {
+                        TranslateMessage(&msg);
+                        DispatchMessage(&msg);
+                    }
+                    else
+                        RenderFrame();
+                }
+            }
+        }
+    }
+    else if (s_hWnd != NULL)
+        DestroyWindow(s_hWnd);
+
+    s_hWnd = NULL;
+    UnregisterClass(CLASS_NAME, wc.hInstance);
+    return status;
+}
+
+void PlatformSetWindowTitle(const char* title)
+{
+    if (s_hWnd != NULL)
+        SetWindowText(s_hWnd, title);
+}
+
+
+INT WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, INT)
+{
+    return PlatformStart(GetCommandLineA());
+}
+
+#endif // _WIN32
@@ -0,0 +1,265 @@
+//=============================================================================
+// Profiler.cpp
+//=============================================================================
+
+#include "Profiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <thread>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define snprintf _snprintf
+#endif
+
+// VS2013 has no thread_local; both compilers support a POD in TLS.
+#if defined(_MSC_VER)
+#define PROFILE_THREAD_LOCAL __declspec(thread)
+#else
+#define PROFILE_THREAD_LOCAL __thread
+#endif
+
+
+Profiler g_profiler;
+
+
+namespace
+{
+    // The calling thread's Profiler::ThreadBuffer, once it has recorded.
+    PROFILE_THREAD_LOCAL void* s_pThread = NULL;
+
+    double NowUs()
+    {
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void DebugPrint(const char* msg)
+    {
+#ifdef _WIN32
+        OutputDebugStringA(msg);
+#endif
+        fputs(msg, stderr);
+    }
+
+    // Writes s as a JSON string, quotes included.
+    void WriteJsonString(FILE* pFile, const char* s)
+    {
+        fputc('"', pFile);
+        for (; *s; ++s)
+        {
+            unsigned char c = (unsigned char)*s;
+            if (c == '"' || c == '\\')
+                fprintf(pFile, "\\%c", c);
+            else if (c < 0x20)
+                fprintf(pFile, "\\u%04x", c);
+            else
+                fputc(c, pFile);
+        }
+        fputc('"', pFile);
+    }
+}
+
+
+Profiler::Profiler()
+    : m_startTicks(ProfileTimestamp())
+    , m_startUs(NowUs())
+{
+}
+
+Profiler::~Profiler()
+{
+    for (size_t i = 0; i < m_threads.size(); ++i)
+        delete m_threads[i];
+}
+
+Profiler::ThreadBuffer* Profiler::CurrentThread()
+{
+    ThreadBuffer* pThread = static_cast<ThreadBuffer*>(s_pThread);
+    if (pThread)
+        return pThread;
+
+    // First event on this thread.  The buffer stays with the profiler when
+    // the thread exits, so its events are still reported.
+    pThread = new ThreadBuffer;
+    pThread->dropped = 0;
+    pThread->events.reserve(4096);
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        pThread->id = (unsigned)m_threads.size();
+        m_threads.push_back(pThread);
+    }
+    char name[32];
+    snprintf(name, sizeof(name), "thread %u", pThread->id);
+    pThread->name = name;
+
+    s_pThread = pThread;
+    return pThread;
+}
+
+void Profiler::Record(const char* name, unsigned long long begin, unsigned long long end)
+{
+    ThreadBuffer* pThread = CurrentThread();
+    if (pThread->events.size() >= MAX_EVENTS_PER_THREAD)
+    {
+        ++pThread->dropped;
+        return;
+    }
+    ProfileEvent e = { name, begin, end };
+    pThread->events.push_back(e);
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+    CurrentThread()->name = name;
+}
+
+bool Profiler::ParseCommandLine(const char* cmdLine)
+{
+    const char* p = cmdLine ? strstr(cmdLine, "-profile ") : NULL;
+    if (p == NULL)
+        return false;
+
+    // The file name runs to the next space, or to the closing quote.
+    p += strlen("-profile ");
+    while (*p == ' ')
+        ++p;
+    if (*p == '"')
+    {
+        const char* end = strchr(p + 1, '"');
+        m_tracePath.assign(p + 1, end ? end : p + strlen(p));
+    }
+    else
+    {
+        const char* end = strchr(p, ' ');
+        m_tracePath.assign(p, end ? end : p + strlen(p));
+    }
+    return !m_tracePath.empty();
+}
+
+double Profiler::MicrosecondsPerTick()
+{
+#ifdef PROFILE_TSC
+    // The TSC runs at a constant rate on every CPU this code targets; time
+    // it against the steady clock over at least 50 ms.
+    double us = NowUs() - m_startUs;
+    if (us < 50000.0)
+    {
+        std::this_thread::sleep_for(std::chrono::microseconds((long long)(50000.0 - us)));
+        us = NowUs() - m_startUs;
+    }
+    unsigned long long ticks = ProfileTimestamp() - m_startTicks;
+    return ticks ? us / (double)ticks : 0.0;
+#else
+    return 0.001;
+#endif
+}
+
+void Profiler::Report(const char* title)
+{
+    // Durations of every scope, by name; the same name may come from
+    // different literals, so compare the strings.
+    double usPerTick = MicrosecondsPerTick();
+    std::map<std::string, std::vector<double> > scopes;
+    unsigned long long dropped = 0;
+    for (size_t t = 0; t < m_threads.size(); ++t)
+    {
+        const ThreadBuffer& thread = *m_threads[t];
+        const char*          pLastName = NULL;
+        std::vector<double>* pLast = NULL;
+        for (size_t i = 0; i < thread.events.size(); ++i)
+        {
+            const ProfileEvent& e = thread.events[i];
+            if (e.name != pLastName)
+            {
+                pLastName = e.name;
+                pLast = &scopes[e.name];
+            }
+            pLast->push_back((e.end - e.begin) * usPerTick * 0.001);
+        }
+        dropped += thread.dropped;
+    }
+
+    char msg[256];
+    if (!scopes.empty())
+    {
+        snprintf(msg, sizeof(msg), "[Profiler] %s\n[Profiler]   %-24s %8s %10s %10s %10s %10s\n",
+                 title ? title : "scopes", "scope", "count", "min ms", "avg ms", "p99 ms", "max ms");
+        DebugPrint(msg);
+    }
+    for (std::map<std::string, std::vector<double> >::iterator it = scopes.begin(); it != scopes.end(); ++it)
+    {
+        std::vector<double>& ms = it->second;
+        std::sort(ms.begin(), ms.end());
+        double total = 0.0;
+        for (size_t i = 0; i < ms.size(); ++i)
+            total += ms[i];
+        snprintf(msg, sizeof(msg), "[Profiler]   %-24s %8u %10.3f %10.3f %10.3f %10.3f\n",
+                 it->first.c_str(), (unsigned)ms.size(), ms.front(), total / ms.size(),
+                 ms[std::min(ms.size() - 1, ms.size() * 99 / 100)], ms.back());
+        DebugPrint(msg);
+    }
+    if (dropped)
+    {
+        snprintf(msg, sizeof(msg), "[Profiler] %llu events dropped (more than %u on a thread)\n",
+                 dropped, (unsigned)MAX_EVENTS_PER_THREAD);
+        DebugPrint(msg);
+    }
+
+    if (!m_tracePath.empty())
+    {
+        if (WriteChromeTrace(m_tracePath.c_str()))
+            snprintf(msg, sizeof(msg), "[Profiler] trace written to %s\n", m_tracePath.c_str());
+        else
+            snprintf(msg, sizeof(msg), "[Profiler] cannot write %s\n", m_tracePath.c_str());
+        DebugPrint(msg);
+    }
+}
+
+bool Profiler::WriteChromeTrace(const char* path)
+{
+    FILE* pFile = fopen(path, "w");
+    if (pFile == NULL)
+        return false;
+
+    // Complete ("X") events in microseconds since the profiler started,
+    // plus one metadata event per thread for its name.
+    double usPerTick = MicrosecondsPerTick();
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", pFile);
+    bool first = true;
+    for (size_t t = 0; t < m_threads.size(); ++t)
+    {
+        const ThreadBuffer& thread = *m_threads[t];
+        fprintf(pFile, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                first ? "" : ",\n", thread.id);
+        WriteJsonString(pFile, thread.name.c_str());
+        fputs("}}", pFile);
+        first = false;
+
+        for (size_t i = 0; i < thread.events.size(); ++i)
+        {
+            const ProfileEvent& e = thread.events[i];
+            fputs(",\n{\"name\":", pFile);
+            WriteJsonString(pFile, e.name);
+            fprintf(pFile, ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    thread.id, (double)(long long)(e.begin - m_startTicks) * usPerTick,
+                    (e.end - e.begin) * usPerTick);
+        }
+    }
+    fputs("\n]}\n", pFile);
+    return fclose(pFile) == 0;
+}
+
+void Profiler::Clear()
+{
+    for (size_t i = 0; i < m_threads.size(); ++i)
+    {
+        m_threads[i]->events.clear();
+        m_threads[i]->dropped = 0;
+    }
+}
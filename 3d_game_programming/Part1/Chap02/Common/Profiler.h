@@ -0,0 +1,158 @@
+//=============================================================================
+// Profiler.h
+//
+// Scoped CPU timing markers.  A scope records its begin and end timestamp
+// into a buffer owned by the calling thread, so markers on worker threads
+// cost the same as on the main thread and never take a lock:
+//
+//     VOID Render()
+//     {
+//         PROFILE_FUNCTION();             // or PROFILE_SCOPE( "Render" )
+//         ...
+//     }
+//
+// Timestamps are the CPU's time stamp counter where there is one (x86/x64)
+// and std::chrono elsewhere; they are converted to microseconds only when
+// the events are read.  Names must be string literals (or otherwise live
+// until the program ends); only the pointer is stored.
+//
+// At exit, g_profiler.Report() prints count, min, avg, p99 and max of every
+// scope and, when the program was started with "-profile trace.json",
+// writes the events in the Chrome trace-event format (chrome://tracing,
+// https://ui.perfetto.dev).
+//
+// Build with PROFILE_ENABLED=0 to compile every marker out; Report() then
+// has nothing to print.
+//=============================================================================
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(_M_IX86) || defined(_M_X64)
+#include <intrin.h>
+#define PROFILE_TSC 1
+#elif defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#define PROFILE_TSC 1
+#endif
+
+#ifndef PROFILE_ENABLED
+#define PROFILE_ENABLED 1
+#endif
+
+
+// Raw timestamp in profiler ticks.
+inline unsigned long long ProfileTimestamp()
+{
+#ifdef PROFILE_TSC
+    return __rdtsc();
+#else
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+
+struct ProfileEvent
+{
+    const char*        name;
+    unsigned long long begin;
+    unsigned long long end;
+};
+
+
+class Profiler
+{
+public:
+    Profiler();
+    ~Profiler();
+
+    // Events per thread; later ones are counted as dropped.
+    static const size_t MAX_EVENTS_PER_THREAD = 1 << 20;
+
+    // Appends a scope to the calling thread's buffer.
+    void Record(const char* name, unsigned long long begin, unsigned long long end);
+
+    // Name shown for the calling thread in the trace ("thread N" otherwise).
+    void SetThreadName(const char* name);
+
+    // Sets the trace path from "-profile path" in cmdLine; false if absent.
+    bool ParseCommandLine(const char* cmdLine);
+    void SetTracePath(const char* path) { m_tracePath = path ? path : ""; }
+
+    // The functions below read every thread's buffer: call them only when
+    // no other thread is recording (after the job system has stopped).
+
+    // Prints the per-scope summary and writes the trace if a path was set.
+    void Report(const char* title = NULL);
+
+    bool WriteChromeTrace(const char* path);
+
+    // Forgets all events, keeping the threads' buffers.
+    void Clear();
+
+private:
+    Profiler(const Profiler&);
+    Profiler& operator=(const Profiler&);
+
+    struct ThreadBuffer
+    {
+        std::vector<ProfileEvent> events;
+        std::string               name;
+        unsigned                  id;
+        unsigned long long        dropped;
+    };
+
+    ThreadBuffer* CurrentThread();
+
+    // Microseconds per tick, measured against std::chrono since construction.
+    double MicrosecondsPerTick();
+
+    std::mutex                 m_lock;         // m_threads
+    std::vector<ThreadBuffer*> m_threads;
+    std::string                m_tracePath;
+    unsigned long long         m_startTicks;
+    double                     m_startUs;
+};
+
+
+// Records the time between its construction and destruction.
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char* name);
+    ~ProfileScope();
+
+private:
+    ProfileScope(const ProfileScope&);
+    ProfileScope& operator=(const ProfileScope&);
+
+    const char*        m_name;
+    unsigned long long m_begin;
+};
+
+
+// One profiler shared by the whole program (defined in Profiler.cpp).
+extern Profiler g_profiler;
+
+
+inline ProfileScope::ProfileScope(const char* name) : m_name(name), m_begin(ProfileTimestamp()) {}
+inline ProfileScope::~ProfileScope() { g_profiler.Record(m_name, m_begin, ProfileTimestamp()); }
+
+
+#if PROFILE_ENABLED
+#define PROFILE_CONCAT_(a, b)   a##b
+#define PROFILE_CONCAT(a, b)    PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name)     ProfileScope PROFILE_CONCAT(profileScope_, __LINE__)(name)
+#define PROFILE_FUNCTION()      PROFILE_SCOPE(__FUNCTION__)
+#else
+#define PROFILE_SCOPE(name)     ((void)0)
+#define PROFILE_FUNCTION()      ((void)0)
+#endif
+
+#endif // PROFILER_H
@@ -0,0 +1,280 @@
+//=============================================================================
+// ResourcePool.h
+//
+// Generational handle pool for COM resources.  Objects live in contiguous
+// arrays and are referred to by a 32-bit handle (slot index + generation).
+// A handle whose slot has been recycled is detected as stale instead of
+// dangling, so handles can be copied freely between systems and threads.
+//
+// Release() does not destroy the object immediately: the slot is retired
+// and the COM object is released only after the last frame that used it
+// has completed (see ResourceManager in Resources.h).
+//=============================================================================
+
+#ifndef RESOURCE_POOL_H
+#define RESOURCE_POOL_H
+
+#include <vector>
+#include <string>
+#include <mutex>
+#include <cstdio>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define snprintf _snprintf
+#endif
+
+
+//===============================================================
+// Handle layout: low 20 bits slot index, high 12 bits generation.
+// Generation 0 is never handed out, so a zero handle is always null.
+
+const unsigned HANDLE_INDEX_BITS      = 20;
+const unsigned HANDLE_GENERATION_BITS = 12;
+const unsigned HANDLE_INDEX_MASK      = (1u << HANDLE_INDEX_BITS) - 1;
+const unsigned HANDLE_GENERATION_MASK = (1u << HANDLE_GENERATION_BITS) - 1;
+
+
+template<typename T>
+class Handle
+{
+public:
+    Handle() : m_id(0) {}
+    Handle(unsigned index, unsigned generation)
+        : m_id((index & HANDLE_INDEX_MASK) |
+               ((generation & HANDLE_GENERATION_MASK) << HANDLE_INDEX_BITS)) {}
+
+    unsigned Index() const      { return m_id & HANDLE_INDEX_MASK; }
+    unsigned Generation() const { return m_id >> HANDLE_INDEX_BITS; }
+    unsigned Id() const         { return m_id; }
+    bool     IsNull() const     { return m_id == 0; }
+
+    bool operator==(const Handle& rhs) const { return m_id == rhs.m_id; }
+    bool operator!=(const Handle& rhs) const { return m_id != rhs.m_id; }
+
+private:
+    unsigned m_id;
+};
+
+
+//===============================================================
+// Pool of T* (T is a COM interface).  All public members are
+// thread safe; the device-touching part (Collect) must still be
+// called from the thread that owns the device.
+
+template<typename T>
+class ResourcePool
+{
+public:
+    explicit ResourcePool(const char* typeName)
+        : m_typeName(typeName), m_numLive(0) {}
+
+    ~ResourcePool() {}
+
+    // Takes ownership of one reference of pObj, which is released if the
+    // pool is full.
+    Handle<T> Add(T* pObj, const char* debugName, unsigned frame)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        unsigned index;
+        if (!m_freeList.empty())
+        {
+            index = m_freeList.back();
+            m_freeList.pop_back();
+        }
+        else
+        {
+            index = (unsigned)m_objects.size();
+            if (index > HANDLE_INDEX_MASK)
+            {
+                pObj->Release();
+                return Handle<T>();
+            }
+
+            m_objects.push_back(nullptr);
+            m_generations.push_back(1);
+            m_lastUsed.push_back(0);
+            m_names.push_back(std::string());
+        }
+
+        m_objects[index]  = pObj;
+        m_lastUsed[index] = frame;
+        m_names[index]    = debugName ? debugName : "";
+        ++m_numLive;
+
+        return Handle<T>(index, m_generations[index]);
+    }
+
+    // Returns nullptr for null or stale handles.  Records the frame so the
+    // object is kept alive until that frame has been retired.
+    T* Get(Handle<T> h, unsigned frame)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!IsValidLocked(h))
+            return nullptr;
+
+        if (m_lastUsed[h.Index()] < frame)
+            m_lastUsed[h.Index()] = frame;
+        return m_objects[h.Index()];
+    }
+
+    bool IsValid(Handle<T> h)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return IsValidLocked(h);
+    }
+
+    // Swaps the object behind a live handle (hot reload).  The previous
+    // object is retired like a released one, so in-flight frames keep it.
+    bool Replace(Handle<T> h, T* pObj, unsigned frame)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!IsValidLocked(h))
+            return false;
+
+        unsigned index = h.Index();
+        Retired r = { m_objects[index], m_lastUsed[index] > frame ? m_lastUsed[index] : frame };
+        m_retired.push_back(r);
+        m_objects[index] = pObj;
+        return true;
+    }
+
+    // Invalidates the handle now; the object itself is released by
+    // Collect() once the last frame that used it has completed.
+    void Release(Handle<T> h, unsigned frame)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!IsValidLocked(h))
+            return;
+
+        unsigned index = h.Index();
+        Retired r = { m_objects[index], m_lastUsed[index] > frame ? m_lastUsed[index] : frame };
+        m_retired.push_back(r);
+
+        m_objects[index] = nullptr;
+        m_names[index].clear();
+        BumpGeneration(index);
+        m_freeList.push_back(index);
+        --m_numLive;
+    }
+
+    // Releases every retired object whose last use is <= completedFrame.
+    void Collect(unsigned completedFrame)
+    {
+        std::vector<T*> dead;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            size_t keep = 0;
+            for (size_t i = 0; i < m_retired.size(); ++i)
+            {
+                if (m_retired[i].frame <= completedFrame)
+                    dead.push_back(m_retired[i].pObj);
+                else
+                    m_retired[keep++] = m_retired[i];
+            }
+            m_retired.resize(keep);
+        }
+
+        // Release outside the lock; a COM destructor may be slow.
+        for (size_t i = 0; i < dead.size(); ++i)
+        {
+            if (dead[i])
+                dead[i]->Release();
+        }
+    }
+
+    // Prints every live slot, then releases its object and frees the slot
+    // (outstanding handles go stale).  Returns how many there were.  Only
+    // for shutdown, when nothing is in flight.
+    unsigned ReleaseLeaks()
+    {
+        std::vector<T*> leaked;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            for (size_t i = 0; i < m_objects.size(); ++i)
+            {
+                if (m_objects[i] == nullptr)
+                    continue;
+
+                char msg[256];
+                snprintf(msg, sizeof(msg), "[ResourcePool] leaked %s #%u \"%s\" (last used frame %u)\n",
+                         m_typeName, (unsigned)i, m_names[i].c_str(), m_lastUsed[i]);
+                DebugPrint(msg);
+
+                leaked.push_back(m_objects[i]);
+                m_objects[i] = nullptr;
+                m_names[i].clear();
+                BumpGeneration((unsigned)i);
+                m_freeList.push_back((unsigned)i);
+                --m_numLive;
+            }
+        }
+
+        for (size_t i = 0; i < leaked.size(); ++i)
+            leaked[i]->Release();
+        return (unsigned)leaked.size();
+    }
+
+    unsigned NumLive()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_numLive;
+    }
+
+    unsigned Capacity()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return (unsigned)m_objects.size();
+    }
+
+    const char* TypeName() const { return m_typeName; }
+
+private:
+    struct Retired
+    {
+        T*       pObj;
+        unsigned frame;
+    };
+
+    bool IsValidLocked(Handle<T> h) const
+    {
+        return !h.IsNull() &&
+               h.Index() < m_objects.size() &&
+               m_generations[h.Index()] == h.Generation() &&
+               m_objects[h.Index()] != nullptr;
+    }
+
+    void BumpGeneration(unsigned index)
+    {
+        unsigned g = (m_generations[index] + 1) & HANDLE_GENERATION_MASK;
+        m_generations[index] = g ? g : 1;
+    }
+
+    static void DebugPrint(const char* msg)
+    {
+#ifdef _WIN32
+        OutputDebugStringA(msg);
+#endif
+        fputs(msg, stderr);
+    }
+
+    const char*              m_typeName;
+    std::mutex               m_mutex;
+    std::vector<T*>          m_objects;
+    std::vector<unsigned>    m_generations;
+    std::vector<unsigned>    m_lastUsed;
+    std::vector<std::string> m_names;
+    std::vector<unsigned>    m_freeList;
+    std::vector<Retired>     m_retired;
+    unsigned                 m_numLive;
+};
+
+#endif // RESOURCE_POOL_H
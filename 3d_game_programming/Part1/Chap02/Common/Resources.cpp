@@ -0,0 +1,78 @@
+//=============================================================================
+// Resources.cpp
+//=============================================================================
+
+#include "Resources.h"
+
+
+ResourceManager g_resources;
+
+
+ResourceManager::ResourceManager()
+    : m_frame(FRAMES_IN_FLIGHT + 1),
+      m_vertexBuffers("VertexBuffer"),
+      m_indexBuffers("IndexBuffer"),
+      m_textures("Texture"),
+      m_meshes("Mesh"),
+      m_effects("Effect")
+{
+}
+
+void ResourceManager::BeginFrame()
+{
+    ++m_frame;
+}
+
+void ResourceManager::EndFrame()
+{
+    // Everything last used FRAMES_IN_FLIGHT frames ago has left the GPU.
+    CollectAll(m_frame - FRAMES_IN_FLIGHT);
+}
+
+VertexBufferHandle ResourceManager::RegisterVertexBuffer(IDirect3DVertexBuffer9* pVB, const char* name)
+{
+    return m_vertexBuffers.Add(pVB, name, m_frame);
+}
+
+IndexBufferHandle ResourceManager::RegisterIndexBuffer(IDirect3DIndexBuffer9* pIB, const char* name)
+{
+    return m_indexBuffers.Add(pIB, name, m_frame);
+}
+
+TextureHandle ResourceManager::RegisterTexture(IDirect3DTexture9* pTex, const char* name)
+{
+    return m_textures.Add(pTex, name, m_frame);
+}
+
+MeshHandle ResourceManager::RegisterMesh(ID3DXMesh* pMesh, const char* name)
+{
+    return m_meshes.Add(pMesh, name, m_frame);
+}
+
+EffectHandle ResourceManager::RegisterEffect(ID3DXEffect* pFx, const char* name)
+{
+    return m_effects.Add(pFx, name, m_frame);
+}
+
+unsigned ResourceManager::Shutdown()
+{
+    // Nothing is in flight any more once the samples call this from Cleanup().
+    CollectAll(~0u);
+
+    unsigned leaks = 0;
+    leaks += m_vertexBuffers.ReleaseLeaks();
+    leaks += m_indexBuffers.ReleaseLeaks();
+    leaks += m_textures.ReleaseLeaks();
+    leaks += m_meshes.ReleaseLeaks();
+    leaks += m_effects.ReleaseLeaks();
+    return leaks;
+}
+
+void ResourceManager::CollectAll(unsigned completedFrame)
+{
+    m_vertexBuffers.Collect(completedFrame);
+    m_indexBuffers.Collect(completedFrame);
+    m_textures.Collect(completedFrame);
+    m_meshes.Collect(completedFrame);
+    m_effects.Collect(completedFrame);
+}
@@ -0,0 +1,87 @@
+//=============================================================================
+// Resources.h
+//
+// Typed handle pools for the D3D objects the samples create: vertex and
+// index buffers, textures, meshes and effects.  Samples keep handles in
+// their globals instead of raw COM pointers and resolve them with Get*()
+// when they bind a resource for drawing.
+//
+// Call BeginFrame()/EndFrame() around every rendered frame.  A released
+// resource is destroyed only after FRAMES_IN_FLIGHT frames have passed
+// since it was last resolved, so a Release() issued while the GPU may still
+// be reading the object is safe.  Shutdown() flushes everything, reports
+// handles that were never released and releases their objects.
+//=============================================================================
+
+#ifndef RESOURCES_H
+#define RESOURCES_H
+
+#include <d3dx9.h>
+#include "ResourcePool.h"
+
+
+typedef Handle<IDirect3DVertexBuffer9> VertexBufferHandle;
+typedef Handle<IDirect3DIndexBuffer9>  IndexBufferHandle;
+typedef Handle<IDirect3DTexture9>      TextureHandle;
+typedef Handle<ID3DXMesh>              MeshHandle;
+typedef Handle<ID3DXEffect>            EffectHandle;
+
+
+class ResourceManager
+{
+public:
+    // Number of frames the device may queue ahead of the CPU.
+    static const unsigned FRAMES_IN_FLIGHT = 2;
+
+    ResourceManager();
+
+    void BeginFrame();
+    void EndFrame();
+    unsigned CurrentFrame() const { return m_frame; }
+
+    // Register* take ownership of the caller's reference.
+    VertexBufferHandle RegisterVertexBuffer(IDirect3DVertexBuffer9* pVB, const char* name);
+    IndexBufferHandle  RegisterIndexBuffer(IDirect3DIndexBuffer9* pIB, const char* name);
+    TextureHandle      RegisterTexture(IDirect3DTexture9* pTex, const char* name);
+    MeshHandle         RegisterMesh(ID3DXMesh* pMesh, const char* name);
+    EffectHandle       RegisterEffect(ID3DXEffect* pFx, const char* name);
+
+    // Return nullptr for null or stale handles.
+    IDirect3DVertexBuffer9* GetVertexBuffer(VertexBufferHandle h) { return m_vertexBuffers.Get(h, m_frame); }
+    IDirect3DIndexBuffer9*  GetIndexBuffer(IndexBufferHandle h)   { return m_indexBuffers.Get(h, m_frame); }
+    IDirect3DTexture9*      GetTexture(TextureHandle h)           { return m_textures.Get(h, m_frame); }
+    ID3DXMesh*              GetMesh(MeshHandle h)                 { return m_meshes.Get(h, m_frame); }
+    ID3DXEffect*            GetEffect(EffectHandle h)             { return m_effects.Get(h, m_frame); }
+
+    void Release(VertexBufferHandle& h) { m_vertexBuffers.Release(h, m_frame); h = VertexBufferHandle(); }
+    void Release(IndexBufferHandle& h)  { m_indexBuffers.Release(h, m_frame);  h = IndexBufferHandle(); }
+    void Release(TextureHandle& h)      { m_textures.Release(h, m_frame);      h = TextureHandle(); }
+    void Release(MeshHandle& h)         { m_meshes.Release(h, m_frame);        h = MeshHandle(); }
+    void Release(EffectHandle& h)       { m_effects.Release(h, m_frame);       h = EffectHandle(); }
+
+    // Swap in a reloaded object behind an existing handle.  Returns false
+    // (and the caller keeps ownership of pNew) if the handle is stale.
+    bool ReplaceTexture(TextureHandle h, IDirect3DTexture9* pNew) { return m_textures.Replace(h, pNew, m_frame); }
+    bool ReplaceMesh(MeshHandle h, ID3DXMesh* pNew)               { return m_meshes.Replace(h, pNew, m_frame); }
+    bool ReplaceEffect(EffectHandle h, ID3DXEffect* pNew)         { return m_effects.Replace(h, pNew, m_frame); }
+
+    // Destroys all retired objects, then reports live handles as leaks and
+    // destroys their objects too.  Returns the number of leaked handles.
+    unsigned Shutdown();
+
+private:
+    void CollectAll(unsigned completedFrame);
+
+    unsigned                              m_frame;
+    ResourcePool<IDirect3DVertexBuffer9>  m_vertexBuffers;
+    ResourcePool<IDirect3DIndexBuffer9>   m_indexBuffers;
+    ResourcePool<IDirect3DTexture9>       m_textures;
+    ResourcePool<ID3DXMesh>               m_meshes;
+    ResourcePool<ID3DXEffect>             m_effects;
+};
+
+
+// One manager shared by the whole program (defined in Resources.cpp).
+extern ResourceManager g_resources;
+
+#endif // RESOURCES_H
@@ -0,0 +1,106 @@
+//=============================================================================
+// ShaderPermutations.cpp
+//=============================================================================
+
+#include "ShaderPermutations.h"
+#include "EffectCache.h"
+#include "AssetPack.h"
+#include "HotReload.h"
+#include <cstdio>
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define snprintf _snprintf
+#endif
+
+
+ShaderPermutations::ShaderPermutations()
+    : m_flags(0), m_pHotReload(NULL)
+{
+    for (unsigned i = 0; i < SHADER_PERMUTATION_COUNT; ++i)
+        m_failed[i] = false;
+}
+
+void ShaderPermutations::Init(const char* source, DWORD flags, HotReloader* pHotReload)
+{
+    Release();
+    m_source     = source;
+    m_flags      = flags;
+    m_pHotReload = pHotReload;
+}
+
+ID3DXEffect* ShaderPermutations::Get(IDirect3DDevice9* pDevice, unsigned features)
+{
+    features &= SHADER_PERMUTATION_COUNT - 1;
+
+    if (!m_effects[features].IsNull())
+        return g_resources.GetEffect(m_effects[features]);
+    if (m_failed[features])
+        return NULL;
+
+    D3DXMACRO macros[SHADER_FEATURE_COUNT + 1];
+    BuildFeatureMacros(features, macros);
+
+    ID3DXEffect* pFx     = NULL;
+    ID3DXBuffer* pErrors = NULL;
+    HRESULT hr = g_effectCache.CreateEffect(pDevice, m_source.c_str(), macros, m_flags,
+                                            NULL, &pFx, &pErrors);
+    if (FAILED(hr) || pFx == NULL)
+    {
+        char msg[512];
+        snprintf(msg, sizeof(msg), "[ShaderPermutations] %s variant 0x%x failed: %s\n",
+                 m_source.c_str(), features,
+                 pErrors ? (const char*)pErrors->GetBufferPointer() : "cannot create effect");
+#ifdef _WIN32
+        OutputDebugStringA(msg);
+#endif
+        fputs(msg, stderr);
+        if (pErrors)
+            pErrors->Release();
+        m_failed[features] = true;
+        return NULL;
+    }
+    if (pErrors)
+        pErrors->Release();
+
+    char name[128];
+    snprintf(name, sizeof(name), "%s#%x", m_source.c_str(), features);
+    m_effects[features] = g_resources.RegisterEffect(pFx, name);
+
+    std::string path;
+    if (m_pHotReload && g_assets.ResolveLoose(m_source.c_str(), path))
+        m_pHotReload->WatchEffect(m_effects[features], path.c_str(), m_flags, NULL, macros);
+
+    return pFx;
+}
+
+unsigned ShaderPermutations::Warm(IDirect3DDevice9* pDevice, const unsigned* pFeatures, unsigned count)
+{
+    unsigned available = 0;
+    for (unsigned i = 0; i < count; ++i)
+    {
+        if (Get(pDevice, pFeatures[i]))
+            ++available;
+    }
+    return available;
+}
+
+void ShaderPermutations::Release()
+{
+    for (unsigned i = 0; i < SHADER_PERMUTATION_COUNT; ++i)
+    {
+        if (!m_effects[i].IsNull())
+            g_resources.Release(m_effects[i]);
+        m_failed[i] = false;
+    }
+}
+
+unsigned ShaderPermutations::NumCompiled() const
+{
+    unsigned n = 0;
+    for (unsigned i = 0; i < SHADER_PERMUTATION_COUNT; ++i)
+    {
+        if (!m_effects[i].IsNull())
+            ++n;
+    }
+    return n;
+}
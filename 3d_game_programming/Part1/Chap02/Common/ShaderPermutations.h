@@ -0,0 +1,86 @@
+//=============================================================================
+// ShaderPermutations.h
+//
+// Compiles one effect source into a variant per combination of features,
+// so each draw runs a shader with exactly the work it needs instead of an
+// uber-shader that branches on constants.
+//
+// A feature is a preprocessor key of the effect (VERTEX_COLOR, DIRLIGHT,
+// TEXTURE, FOG); every variant is compiled with all of them defined to 0
+// or 1.  Variants are looked up by feature bitmask and compiled on first
+// use through g_effectCache, so after the first run (or after running
+// "ShaderCook -permutations") a lookup only reads a cached binary.
+//=============================================================================
+
+#ifndef SHADER_PERMUTATIONS_H
+#define SHADER_PERMUTATIONS_H
+
+#include <d3dx9.h>
+#include <string>
+#include "Resources.h"
+
+
+enum ShaderFeature
+{
+    SHADER_VERTEX_COLOR = 1 << 0,   // per-vertex COLOR0
+    SHADER_DIRLIGHT     = 1 << 1,   // one directional light, NORMAL0
+    SHADER_TEXTURE      = 1 << 2,   // TEXCOORD0 modulated by gTex
+    SHADER_FOG          = 1 << 3,   // linear distance fog
+};
+
+const unsigned SHADER_FEATURE_COUNT     = 4;
+const unsigned SHADER_PERMUTATION_COUNT = 1 << SHADER_FEATURE_COUNT;
+
+// Preprocessor key of feature bit i.
+inline const char* ShaderFeatureName(unsigned bit)
+{
+    static const char* const names[SHADER_FEATURE_COUNT] = { "VERTEX_COLOR", "DIRLIGHT", "TEXTURE", "FOG" };
+    return bit < SHADER_FEATURE_COUNT ? names[bit] : "";
+}
+
+// Fills a NULL-terminated macro list for a feature mask.
+inline void BuildFeatureMacros(unsigned features, D3DXMACRO macros[SHADER_FEATURE_COUNT + 1])
+{
+    for (unsigned i = 0; i < SHADER_FEATURE_COUNT; ++i)
+    {
+        macros[i].Name       = ShaderFeatureName(i);
+        macros[i].Definition = (features & (1u << i)) ? "1" : "0";
+    }
+    macros[SHADER_FEATURE_COUNT].Name       = NULL;
+    macros[SHADER_FEATURE_COUNT].Definition = NULL;
+}
+
+
+class HotReloader;
+
+class ShaderPermutations
+{
+public:
+    ShaderPermutations();
+
+    // source is an asset name (g_assets).  With a hot reloader, every
+    // variant compiled from a loose file is recompiled when it changes.
+    void Init(const char* source, DWORD flags, HotReloader* pHotReload = NULL);
+
+    // The variant for a feature mask, compiled on first use.  Returns
+    // NULL if it does not compile; that is reported once, not per frame.
+    ID3DXEffect* Get(IDirect3DDevice9* pDevice, unsigned features);
+
+    // Compiles the given variants now (at load time) rather than on the
+    // frame that first needs them.  Returns how many are available.
+    unsigned Warm(IDirect3DDevice9* pDevice, const unsigned* pFeatures, unsigned count);
+
+    // Releases every variant through g_resources.
+    void Release();
+
+    unsigned NumCompiled() const;
+
+private:
+    std::string  m_source;
+    DWORD        m_flags;
+    HotReloader* m_pHotReload;
+    EffectHandle m_effects[SHADER_PERMUTATION_COUNT];
+    bool         m_failed[SHADER_PERMUTATION_COUNT];
+};
+
+#endif // SHADER_PERMUTATIONS_H
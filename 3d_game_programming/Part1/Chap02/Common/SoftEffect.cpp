@@ -0,0 +1,76 @@
+//=============================================================================
+// SoftEffect.cpp
+//=============================================================================
+
+#include "SoftEffect.h"
+#include "AssetPack.h"
+#include "AssetLoaders.h"
+
+
+static bool LoadFunction(const DWORD* pFunction, ShaderProgram& program, const char* what,
+                         std::string* pError)
+{
+    program.Clear();
+    if (pFunction == NULL)
+        return true;
+
+    std::string error;
+    if (!program.Load(pFunction, D3DXGetShaderSize(pFunction), &error))
+    {
+        if (pError)
+            *pError = std::string(what) + ": " + error;
+        return false;
+    }
+    return true;
+}
+
+bool LoadEffectPass(ID3DXEffect* pEffect, D3DXHANDLE hTechnique, UINT pass,
+                    ShaderProgram& vs, ShaderProgram& ps, std::string* pError)
+{
+    D3DXHANDLE hPass = pEffect->GetPass(hTechnique, pass);
+    D3DXPASS_DESC desc;
+    if (hPass == NULL || FAILED(pEffect->GetPassDesc(hPass, &desc)))
+    {
+        if (pError)
+            *pError = "no such pass";
+        return false;
+    }
+
+    return LoadFunction(desc.pVertexShaderFunction, vs, "vertex shader", pError) &&
+           LoadFunction(desc.pPixelShaderFunction, ps, "pixel shader", pError);
+}
+
+bool CompileShaderFromAsset(const char* name, const char* entry, const char* target,
+                            DWORD flags, ShaderProgram& program, std::string* pError)
+{
+    AssetData source;
+    if (!g_assets.Load(name, source))
+    {
+        if (pError)
+            *pError = std::string("cannot load ") + name;
+        return false;
+    }
+
+    AssetInclude   include;
+    LPD3DXBUFFER   pCode   = NULL;
+    LPD3DXBUFFER   pErrors = NULL;
+    HRESULT hr = D3DXCompileShader((LPCSTR)source.Data(), (UINT)source.Size(), NULL, &include,
+                                   entry, target, flags, &pCode, &pErrors, NULL);
+    if (FAILED(hr))
+    {
+        if (pError)
+            *pError = pErrors ? (const char*)pErrors->GetBufferPointer() : "D3DXCompileShader failed";
+        if (pErrors)
+            pErrors->Release();
+        return false;
+    }
+    if (pErrors)
+        pErrors->Release();
+
+    std::string error;
+    bool ok = program.Load(pCode->GetBufferPointer(), pCode->GetBufferSize(), &error);
+    pCode->Release();
+    if (!ok && pError)
+        *pError = std::string(entry) + ": " + error;
+    return ok;
+}
@@ -0,0 +1,27 @@
+//=============================================================================
+// SoftEffect.h
+//
+// Gets shader bytecode for the software engine (SoftShader.h) from D3DX:
+// either from a pass of an effect that has already been created, or by
+// compiling one function of an .fx read through g_assets.  Windows only;
+// elsewhere load the output of "fxc /Fo" with ShaderProgram::Load.
+//=============================================================================
+
+#ifndef SOFT_EFFECT_H
+#define SOFT_EFFECT_H
+
+#include <d3dx9.h>
+#include <string>
+#include "SoftShader.h"
+
+
+// Decodes the vertex and pixel shader of one pass.  A pass without a
+// shader for a stage leaves that program empty.
+bool LoadEffectPass(ID3DXEffect* pEffect, D3DXHANDLE hTechnique, UINT pass,
+                    ShaderProgram& vs, ShaderProgram& ps, std::string* pError = NULL);
+
+// D3DXCompileShader on an asset, e.g. ("vertex.fx", "ColorVS", "vs_2_0").
+bool CompileShaderFromAsset(const char* name, const char* entry, const char* target,
+                            DWORD flags, ShaderProgram& program, std::string* pError = NULL);
+
+#endif // SOFT_EFFECT_H
@@ -0,0 +1,169 @@
+//=============================================================================
+// SoftLanes.h
+//
+// Four-wide float lanes for the software shader engine.  One LaneF holds
+// the same register component of four vertices (or of the four pixels of
+// a 2x2 quad), so a shader instruction is executed for all four at once.
+//
+// SSE2 is used on x86/x64; other targets get a plain float[4] version with
+// identical results.
+//=============================================================================
+
+#ifndef SOFT_LANES_H
+#define SOFT_LANES_H
+
+#include <cmath>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE2__)
+#define SOFT_LANES_SSE 1
+#include <emmintrin.h>
+#endif
+
+
+const unsigned LANE_COUNT = 4;
+
+
+#ifdef SOFT_LANES_SSE
+
+struct LaneF
+{
+    __m128 v;
+
+    LaneF() {}
+    LaneF(__m128 x) : v(x) {}
+    explicit LaneF(float s) : v(_mm_set1_ps(s)) {}
+
+    static LaneF Load(const float* p)        { return LaneF(_mm_loadu_ps(p)); }
+    void         Store(float* p) const       { _mm_storeu_ps(p, v); }
+    static LaneF Set(float a, float b, float c, float d) { return LaneF(_mm_setr_ps(a, b, c, d)); }
+};
+
+inline LaneF operator+(LaneF a, LaneF b) { return LaneF(_mm_add_ps(a.v, b.v)); }
+inline LaneF operator-(LaneF a, LaneF b) { return LaneF(_mm_sub_ps(a.v, b.v)); }
+inline LaneF operator*(LaneF a, LaneF b) { return LaneF(_mm_mul_ps(a.v, b.v)); }
+inline LaneF operator/(LaneF a, LaneF b) { return LaneF(_mm_div_ps(a.v, b.v)); }
+inline LaneF operator-(LaneF a)          { return LaneF(_mm_xor_ps(a.v, _mm_set1_ps(-0.0f))); }
+
+inline LaneF Min(LaneF a, LaneF b)  { return LaneF(_mm_min_ps(a.v, b.v)); }
+inline LaneF Max(LaneF a, LaneF b)  { return LaneF(_mm_max_ps(a.v, b.v)); }
+inline LaneF Abs(LaneF a)           { return LaneF(_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)); }
+inline LaneF Sqrt(LaneF a)          { return LaneF(_mm_sqrt_ps(a.v)); }
+
+// Comparisons return 1.0f or 0.0f per lane, like slt/sge.
+inline LaneF CmpLt(LaneF a, LaneF b) { return LaneF(_mm_and_ps(_mm_cmplt_ps(a.v, b.v), _mm_set1_ps(1.0f))); }
+inline LaneF CmpGe(LaneF a, LaneF b) { return LaneF(_mm_and_ps(_mm_cmpge_ps(a.v, b.v), _mm_set1_ps(1.0f))); }
+
+// Per lane: cond >= 0 ? a : b  (cmp)
+inline LaneF SelectGe0(LaneF cond, LaneF a, LaneF b)
+{
+    __m128 m = _mm_cmpge_ps(cond.v, _mm_setzero_ps());
+    return LaneF(_mm_or_ps(_mm_and_ps(m, a.v), _mm_andnot_ps(m, b.v)));
+}
+
+// Per lane: mask lane != 0 ? a : b, mask being a LaneMask bit set.
+inline LaneF SelectMask(unsigned mask, LaneF a, LaneF b)
+{
+    __m128 m = _mm_castsi128_ps(_mm_setr_epi32(mask & 1 ? -1 : 0, mask & 2 ? -1 : 0,
+                                               mask & 4 ? -1 : 0, mask & 8 ? -1 : 0));
+    return LaneF(_mm_or_ps(_mm_and_ps(m, a.v), _mm_andnot_ps(m, b.v)));
+}
+
+inline LaneF Floor(LaneF a)
+{
+    // Truncate, then step down for negative non-integers.  Values too
+    // large to have a fraction are passed through unchanged.
+    __m128 t   = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+    __m128 adj = _mm_and_ps(_mm_cmpgt_ps(t, a.v), _mm_set1_ps(1.0f));
+    __m128 f   = _mm_sub_ps(t, adj);
+    __m128 big = _mm_cmpge_ps(Abs(a).v, _mm_set1_ps(8388608.0f));
+    return LaneF(_mm_or_ps(_mm_and_ps(big, a.v), _mm_andnot_ps(big, f)));
+}
+
+// Bit i set if lane i of a < b.
+inline unsigned MaskLt(LaneF a, LaneF b) { return (unsigned)_mm_movemask_ps(_mm_cmplt_ps(a.v, b.v)); }
+inline unsigned MaskGe(LaneF a, LaneF b) { return (unsigned)_mm_movemask_ps(_mm_cmpge_ps(a.v, b.v)); }
+
+#else // !SOFT_LANES_SSE
+
+struct LaneF
+{
+    float f[4];
+
+    LaneF() {}
+    explicit LaneF(float s) { f[0] = f[1] = f[2] = f[3] = s; }
+
+    static LaneF Load(const float* p)        { LaneF r; for (int i = 0; i < 4; ++i) r.f[i] = p[i]; return r; }
+    void         Store(float* p) const       { for (int i = 0; i < 4; ++i) p[i] = f[i]; }
+    static LaneF Set(float a, float b, float c, float d) { LaneF r; r.f[0] = a; r.f[1] = b; r.f[2] = c; r.f[3] = d; return r; }
+};
+
+#define SOFT_LANES_OP2(name, expr) \
+    inline LaneF name(LaneF a, LaneF b) { LaneF r; for (int i = 0; i < 4; ++i) r.f[i] = (expr); return r; }
+
+SOFT_LANES_OP2(operator+, a.f[i] + b.f[i])
+SOFT_LANES_OP2(operator-, a.f[i] - b.f[i])
+SOFT_LANES_OP2(operator*, a.f[i] * b.f[i])
+SOFT_LANES_OP2(operator/, a.f[i] / b.f[i])
+SOFT_LANES_OP2(Min, b.f[i] < a.f[i] ? b.f[i] : a.f[i])
+SOFT_LANES_OP2(Max, b.f[i] > a.f[i] ? b.f[i] : a.f[i])
+SOFT_LANES_OP2(CmpLt, a.f[i] < b.f[i] ? 1.0f : 0.0f)
+SOFT_LANES_OP2(CmpGe, a.f[i] >= b.f[i] ? 1.0f : 0.0f)
+
+#undef SOFT_LANES_OP2
+
+inline LaneF operator-(LaneF a) { LaneF r; for (int i = 0; i < 4; ++i) r.f[i] = -a.f[i]; return r; }
+inline LaneF Abs(LaneF a)       { LaneF r; for (int i = 0; i < 4; ++i) r.f[i] = fabsf(a.f[i]); return r; }
+inline LaneF Sqrt(LaneF a)      { LaneF r; for (int i = 0; i < 4; ++i) r.f[i] = sqrtf(a.f[i]); return r; }
+inline LaneF Floor(LaneF a)     { LaneF r; for (int i = 0; i < 4; ++i) r.f[i] = floorf(a.f[i]); return r; }
+
+inline LaneF SelectGe0(LaneF cond, LaneF a, LaneF b)
+{
+    LaneF r;
+    for (int i = 0; i < 4; ++i)
+        r.f[i] = cond.f[i] >= 0.0f ? a.f[i] : b.f[i];
+    return r;
+}
+
+inline LaneF SelectMask(unsigned mask, LaneF a, LaneF b)
+{
+    LaneF r;
+    for (int i = 0; i < 4; ++i)
+        r.f[i] = (mask >> i) & 1 ? a.f[i] : b.f[i];
+    return r;
+}
+
+inline unsigned MaskLt(LaneF a, LaneF b)
+{
+    unsigned m = 0;
+    for (int i = 0; i < 4; ++i)
+        m |= (a.f[i] < b.f[i] ? 1u : 0u) << i;
+    return m;
+}
+
+inline unsigned MaskGe(LaneF a, LaneF b)
+{
+    unsigned m = 0;
+    for (int i = 0; i < 4; ++i)
+        m |= (a.f[i] >= b.f[i] ? 1u : 0u) << i;
+    return m;
+}
+
+#endif // SOFT_LANES_SSE
+
+
+inline LaneF MulAdd(LaneF a, LaneF b, LaneF c) { return a * b + c; }
+
+inline LaneF Saturate(LaneF a) { return Min(Max(a, LaneF(0.0f)), LaneF(1.0f)); }
+
+// Applies a scalar function lane by lane (exp, log, sin, cos).
+template<typename F>
+inline LaneF PerLane(LaneF a, F fn)
+{
+    float t[4];
+    a.Store(t);
+    for (int i = 0; i < 4; ++i)
+        t[i] = fn(t[i]);
+    return LaneF::Load(t);
+}
+
+#endif // SOFT_LANES_H
@@ -0,0 +1,565 @@
+//=============================================================================
+// SoftRasterizer.cpp
+//=============================================================================
+
+#include "SoftRasterizer.h"
+#include <cstdio>
+#include <cstring>
+#include <cmath>
+
+
+namespace
+{
+    const int   SUBPIXEL_BITS  = 4;
+    const int   SUBPIXEL_ONE   = 1 << SUBPIXEL_BITS;
+    const float GUARD_BAND     = 16.0f;     // in viewport widths
+    const float MIN_W          = 1e-6f;
+    const unsigned MAX_CLIPPED = 12;
+
+    void FetchElement(const unsigned char* p, unsigned type, float out[4])
+    {
+        out[0] = out[1] = out[2] = 0.0f;
+        out[3] = 1.0f;
+
+        switch (type)
+        {
+        case SOFT_DECL_FLOAT1: case SOFT_DECL_FLOAT2:
+        case SOFT_DECL_FLOAT3: case SOFT_DECL_FLOAT4:
+            memcpy(out, p, (type + 1) * sizeof(float));
+            break;
+        case SOFT_DECL_D3DCOLOR:
+            {
+                unsigned c;
+                memcpy(&c, p, 4);
+                out[0] = ((c >> 16) & 0xFF) * (1.0f / 255.0f);
+                out[1] = ((c >> 8) & 0xFF) * (1.0f / 255.0f);
+                out[2] = (c & 0xFF) * (1.0f / 255.0f);
+                out[3] = (c >> 24) * (1.0f / 255.0f);
+            }
+            break;
+        case SOFT_DECL_UBYTE4:
+            for (unsigned k = 0; k < 4; ++k)
+                out[k] = (float)p[k];
+            break;
+        }
+    }
+
+    unsigned ToArgb(float r, float g, float b, float a)
+    {
+        #define SOFT_TO_BYTE(x) ((unsigned)((x) <= 0.0f ? 0.0f : (x) >= 1.0f ? 255.0f : (x) * 255.0f + 0.5f))
+        unsigned c = (SOFT_TO_BYTE(a) << 24) | (SOFT_TO_BYTE(r) << 16) | (SOFT_TO_BYTE(g) << 8) | SOFT_TO_BYTE(b);
+        #undef SOFT_TO_BYTE
+        return c;
+    }
+}
+
+
+SoftRasterizer::SoftRasterizer()
+    : m_width(0), m_height(0), m_cull(SOFT_CULL_CCW), m_depthTest(true), m_depthWrite(true),
+      m_pVS(NULL), m_pVSConstants(NULL), m_pPS(NULL), m_pPSConstants(NULL), m_varyings(0)
+{
+    ResetStats();
+}
+
+void SoftRasterizer::ResetStats()
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+bool SoftRasterizer::SetRenderTarget(unsigned width, unsigned height)
+{
+    if (width == 0 || height == 0 || width > 16384 || height > 16384)
+        return false;
+
+    m_width  = width;
+    m_height = height;
+    m_color.assign((size_t)width * height, 0);
+    m_depth.assign((size_t)width * height, 1.0f);
+    return true;
+}
+
+void SoftRasterizer::Clear(unsigned argb, float depth)
+{
+    std::fill(m_color.begin(), m_color.end(), argb);
+    std::fill(m_depth.begin(), m_depth.end(), depth);
+}
+
+void SoftRasterizer::SetVertexShader(const ShaderProgram* pProgram, const ShaderConstants* pConstants)
+{
+    m_pVS          = pProgram;
+    m_pVSConstants = pConstants;
+}
+
+void SoftRasterizer::SetPixelShader(const ShaderProgram* pProgram, const ShaderConstants* pConstants)
+{
+    m_pPS          = pProgram;
+    m_pPSConstants = pConstants;
+}
+
+//===============================================================
+// Draw calls
+
+void SoftRasterizer::DrawPrimitive(const SoftVertexStream& stream, unsigned startVertex,
+                                   unsigned numTriangles)
+{
+    if (m_pVS == NULL || m_pPS == NULL || m_color.empty())
+        return;
+
+    m_vsVM.Bind(m_pVS, m_pVSConstants);
+    m_psVM.Bind(m_pPS, m_pPSConstants);
+    m_varyings = m_pPS->VaryingMask();
+
+    ShadeVertices(stream, startVertex, numTriangles * 3);
+    for (unsigned t = 0; t < numTriangles; ++t)
+        DrawTriangle(m_shaded[3 * t], m_shaded[3 * t + 1], m_shaded[3 * t + 2]);
+}
+
+void SoftRasterizer::DrawIndexedPrimitive(const SoftVertexStream& stream, int baseVertex,
+                                          unsigned minIndex, unsigned numVertices,
+                                          const unsigned short* pIndices, unsigned startIndex,
+                                          unsigned numTriangles)
+{
+    if (m_pVS == NULL || m_pPS == NULL || m_color.empty() || baseVertex + (int)minIndex < 0)
+        return;
+
+    m_vsVM.Bind(m_pVS, m_pVSConstants);
+    m_psVM.Bind(m_pPS, m_pPSConstants);
+    m_varyings = m_pPS->VaryingMask();
+
+    // Every vertex in [minIndex, minIndex + numVertices) is shaded once,
+    // which is what the D3D9 range hint is for.
+    ShadeVertices(stream, (unsigned)(baseVertex + (int)minIndex), numVertices);
+
+    const unsigned short* idx = pIndices + startIndex;
+    for (unsigned t = 0; t < numTriangles; ++t, idx += 3)
+    {
+        unsigned i0 = idx[0] - minIndex, i1 = idx[1] - minIndex, i2 = idx[2] - minIndex;
+        if (i0 >= numVertices || i1 >= numVertices || i2 >= numVertices)
+            continue;
+        DrawTriangle(m_shaded[i0], m_shaded[i1], m_shaded[i2]);
+    }
+}
+
+//===============================================================
+// Vertex stage: AoS vertices in, SoA batches through the VM,
+// AoS clip-space vertices out.
+
+void SoftRasterizer::ShadeVertices(const SoftVertexStream& stream, unsigned first, unsigned count)
+{
+    m_shaded.resize(count);
+
+    // Bind declared inputs to stream elements by usage.
+    InputBinding bindings[16];
+    unsigned     numBindings = 0;
+    const std::vector<ShaderDeclaration>& decls = m_pVS->Declarations();
+    for (size_t d = 0; d < decls.size() && numBindings < 16; ++d)
+    {
+        if (decls[d].type != SREG_INPUT)
+            continue;
+        bindings[numBindings].reg      = decls[d].index & 15;
+        bindings[numBindings].pElement = NULL;
+        for (unsigned e = 0; e < stream.numElements; ++e)
+        {
+            if (stream.pElements[e].usage == decls[d].usage &&
+                stream.pElements[e].usageIndex == decls[d].usageIndex)
+                bindings[numBindings].pElement = &stream.pElements[e];
+        }
+        ++numBindings;
+    }
+
+    const unsigned char* base = (const unsigned char*)stream.pData;
+    VertexLanes lanes;
+    unsigned long long before = m_vsVM.Stats().instructions;
+
+    for (unsigned v = 0; v < count; v += LANE_COUNT)
+    {
+        unsigned n = count - v < LANE_COUNT ? count - v : LANE_COUNT;
+
+        for (unsigned b = 0; b < numBindings; ++b)
+        {
+            float soa[4][4];
+            for (unsigned l = 0; l < LANE_COUNT; ++l)
+            {
+                float value[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+                const SoftVertexElement* e = bindings[b].pElement;
+                if (e)      // a short last batch repeats its last vertex
+                    FetchElement(base + (size_t)(first + v + (l < n ? l : n - 1)) * stream.stride + e->offset,
+                                 e->type, value);
+                for (unsigned k = 0; k < 4; ++k)
+                    soa[k][l] = value[k];
+            }
+            for (unsigned k = 0; k < 4; ++k)
+                lanes.inputs[bindings[b].reg].c[k] = LaneF::Load(soa[k]);
+        }
+
+        m_vsVM.RunVertices(lanes);
+
+        float pos[4][4];
+        for (unsigned k = 0; k < 4; ++k)
+            lanes.position.c[k].Store(pos[k]);
+        for (unsigned l = 0; l < n; ++l)
+        {
+            ClipVertex& out = m_shaded[v + l];
+            for (unsigned k = 0; k < 4; ++k)
+                out.pos[k] = pos[k][l];
+        }
+
+        for (unsigned r = 0; r < VARYING_COUNT; ++r)
+        {
+            if (!(m_varyings & (1u << r)))
+                continue;
+            float var[4][4];
+            for (unsigned k = 0; k < 4; ++k)
+                lanes.varyings[r].c[k].Store(var[k]);
+            for (unsigned l = 0; l < n; ++l)
+            {
+                for (unsigned k = 0; k < 4; ++k)
+                    m_shaded[v + l].var[r][k] = var[k][l];
+            }
+        }
+    }
+
+    m_stats.vertices       += count;
+    m_stats.vsInstructions += m_vsVM.Stats().instructions - before;
+}
+
+//===============================================================
+// Clipping.  Planes are dot(plane, pos) >= 0 in clip space; the
+// guard band keeps screen coordinates inside the fixed-point range.
+
+void SoftRasterizer::DrawTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c)
+{
+    static const float planes[6][4] =
+    {
+        { 0.0f, 0.0f,  1.0f, 0.0f },            // z >= 0
+        { 0.0f, 0.0f, -1.0f, 1.0f },            // z <= w
+        {  1.0f, 0.0f, 0.0f, GUARD_BAND },      // x >= -g w
+        { -1.0f, 0.0f, 0.0f, GUARD_BAND },
+        { 0.0f,  1.0f, 0.0f, GUARD_BAND },
+        { 0.0f, -1.0f, 0.0f, GUARD_BAND },
+    };
+
+    ++m_stats.triangles;
+
+    const ClipVertex* in[3] = { &a, &b, &c };
+    unsigned outside[3] = { 0, 0, 0 };
+    for (unsigned v = 0; v < 3; ++v)
+    {
+        const float* p = in[v]->pos;
+        for (unsigned k = 0; k < 6; ++k)
+        {
+            if (planes[k][0] * p[0] + planes[k][1] * p[1] + planes[k][2] * p[2] + planes[k][3] * p[3] < 0.0f)
+                outside[v] |= 1u << k;
+        }
+        if (p[3] < MIN_W)
+            outside[v] |= 1u << 6;
+    }
+
+    if (outside[0] & outside[1] & outside[2])
+    {
+        ++m_stats.culled;
+        return;
+    }
+    if ((outside[0] | outside[1] | outside[2]) == 0)
+    {
+        Rasterize(a, b, c);
+        return;
+    }
+
+    ++m_stats.clipped;
+
+    ClipVertex buf[2][MAX_CLIPPED];
+    unsigned   n = 3;
+    buf[0][0] = a;
+    buf[0][1] = b;
+    buf[0][2] = c;
+
+    unsigned cur = 0;
+    for (unsigned k = 0; k < 7 && n >= 3; ++k)
+    {
+        if (!((outside[0] | outside[1] | outside[2]) & (1u << k)))
+            continue;
+
+        const ClipVertex* src = buf[cur];
+        ClipVertex*       dst = buf[cur ^ 1];
+        unsigned          m   = 0;
+
+        for (unsigned i = 0; i < n; ++i)
+        {
+            const ClipVertex& p = src[i];
+            const ClipVertex& q = src[(i + 1) % n];
+            float dp, dq;
+            if (k < 6)
+            {
+                dp = planes[k][0] * p.pos[0] + planes[k][1] * p.pos[1] + planes[k][2] * p.pos[2] + planes[k][3] * p.pos[3];
+                dq = planes[k][0] * q.pos[0] + planes[k][1] * q.pos[1] + planes[k][2] * q.pos[2] + planes[k][3] * q.pos[3];
+            }
+            else
+            {
+                dp = p.pos[3] - MIN_W;
+                dq = q.pos[3] - MIN_W;
+            }
+
+            if (dp >= 0.0f && m < MAX_CLIPPED)
+                dst[m++] = p;
+            if ((dp >= 0.0f) != (dq >= 0.0f) && m < MAX_CLIPPED)
+            {
+                float t = dp / (dp - dq);
+                ClipVertex& r = dst[m++];
+                for (unsigned j = 0; j < 4; ++j)
+                    r.pos[j] = p.pos[j] + (q.pos[j] - p.pos[j]) * t;
+                for (unsigned v = 0; v < VARYING_COUNT; ++v)
+                {
+                    if (!(m_varyings & (1u << v)))
+                        continue;
+                    for (unsigned j = 0; j < 4; ++j)
+                        r.var[v][j] = p.var[v][j] + (q.var[v][j] - p.var[v][j]) * t;
+                }
+            }
+        }
+        n = m;
+        cur ^= 1;
+    }
+
+    for (unsigned i = 1; i + 1 < n; ++i)
+        Rasterize(buf[cur][0], buf[cur][i], buf[cur][i + 1]);
+}
+
+//===============================================================
+// Setup and traversal.  Edge functions are evaluated exactly in
+// 64-bit fixed point; coverage follows the top-left rule.
+
+void SoftRasterizer::Rasterize(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c)
+{
+    const ClipVertex* v[3] = { &a, &b, &c };
+
+    float     invW[3], z[3];
+    long long fx[3], fy[3];
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        invW[i] = 1.0f / v[i]->pos[3];
+        // D3D9 maps pixel centres to integer coordinates.
+        float sx = (v[i]->pos[0] * invW[i] + 1.0f) * 0.5f * m_width;
+        float sy = (1.0f - v[i]->pos[1] * invW[i]) * 0.5f * m_height;
+        z[i]  = v[i]->pos[2] * invW[i];
+        fx[i] = (long long)floor(sx * SUBPIXEL_ONE + 0.5f);
+        fy[i] = (long long)floor(sy * SUBPIXEL_ONE + 0.5f);
+    }
+
+    long long area = (fx[1] - fx[0]) * (fy[2] - fy[0]) - (fy[1] - fy[0]) * (fx[2] - fx[0]);
+    if (area == 0)
+    {
+        ++m_stats.culled;
+        return;
+    }
+
+    // Positive area is clockwise on screen (y down).
+    if ((m_cull == SOFT_CULL_CW && area > 0) || (m_cull == SOFT_CULL_CCW && area < 0))
+    {
+        ++m_stats.culled;
+        return;
+    }
+
+    // Make the winding clockwise so "inside" is edge >= 0.
+    unsigned order[3] = { 0, 1, 2 };
+    if (area < 0)
+    {
+        order[1] = 2;
+        order[2] = 1;
+        area = -area;
+    }
+
+    const ClipVertex* ov[3];
+    float oInvW[3], oz[3];
+    long long ox[3], oy[3];
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        ov[i]    = v[order[i]];
+        oInvW[i] = invW[order[i]];
+        oz[i]    = z[order[i]];
+        ox[i]    = fx[order[i]];
+        oy[i]    = fy[order[i]];
+    }
+
+    // Edge i is opposite vertex i: e(p) = A*px + B*py + C.
+    long long A[3], B[3], C[3], bias[3];
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        unsigned s = (i + 1) % 3, t = (i + 2) % 3;
+        long long dx = ox[t] - ox[s], dy = oy[t] - oy[s];
+        A[i] = -dy;
+        B[i] = dx;
+        C[i] = dy * ox[s] - dx * oy[s];
+        bool top  = dy == 0 && dx > 0;
+        bool left = dy < 0;
+        bias[i] = top || left ? 0 : -1;
+    }
+
+    long long minX = ox[0], maxX = ox[0], minY = oy[0], maxY = oy[0];
+    for (unsigned i = 1; i < 3; ++i)
+    {
+        if (ox[i] < minX) minX = ox[i];
+        if (ox[i] > maxX) maxX = ox[i];
+        if (oy[i] < minY) minY = oy[i];
+        if (oy[i] > maxY) maxY = oy[i];
+    }
+
+    int x0 = (int)((minX + SUBPIXEL_ONE - 1) >> SUBPIXEL_BITS);
+    int x1 = (int)(maxX >> SUBPIXEL_BITS);
+    int y0 = (int)((minY + SUBPIXEL_ONE - 1) >> SUBPIXEL_BITS);
+    int y1 = (int)(maxY >> SUBPIXEL_BITS);
+    if (x0 < 0) x0 = 0;
+    if (y0 < 0) y0 = 0;
+    if (x1 > (int)m_width - 1)  x1 = (int)m_width - 1;
+    if (y1 > (int)m_height - 1) y1 = (int)m_height - 1;
+    if (x0 > x1 || y0 > y1)
+        return;
+
+    x0 &= ~1;
+    y0 &= ~1;
+
+    const float invArea = 1.0f / (float)area;
+    static const int laneX[4] = { 0, 1, 0, 1 };
+    static const int laneY[4] = { 0, 0, 1, 1 };
+
+    for (int qy = y0; qy <= y1; qy += 2)
+    {
+        for (int qx = x0; qx <= x1; qx += 2)
+        {
+            long long e[3][4];
+            unsigned coverage = 0;
+            for (unsigned l = 0; l < 4; ++l)
+            {
+                long long px = (long long)(qx + laneX[l]) << SUBPIXEL_BITS;
+                long long py = (long long)(qy + laneY[l]) << SUBPIXEL_BITS;
+                bool in = true;
+                for (unsigned i = 0; i < 3; ++i)
+                {
+                    e[i][l] = A[i] * px + B[i] * py + C[i];
+                    in = in && e[i][l] + bias[i] >= 0;
+                }
+                if (in && qx + laneX[l] <= x1 && qy + laneY[l] <= y1)
+                    coverage |= 1u << l;
+            }
+            if (coverage == 0)
+                continue;
+
+            float lambda[3][4];
+            for (unsigned i = 0; i < 3; ++i)
+                for (unsigned l = 0; l < 4; ++l)
+                    lambda[i][l] = (float)e[i][l] * invArea;
+
+            ShadeQuad(qx, qy, coverage, lambda, ov, oInvW, oz);
+        }
+    }
+}
+
+void SoftRasterizer::ShadeQuad(int x, int y, unsigned coverage, const float lambda[3][4],
+                               const ClipVertex* v[3], const float invW[3], const float z[3])
+{
+    // Perspective-correct weights; depth is interpolated linearly.
+    float w[3][4], depth[4];
+    for (unsigned l = 0; l < 4; ++l)
+    {
+        float q0 = lambda[0][l] * invW[0];
+        float q1 = lambda[1][l] * invW[1];
+        float q2 = lambda[2][l] * invW[2];
+        float inv = 1.0f / (q0 + q1 + q2);
+        w[0][l] = q0 * inv;
+        w[1][l] = q1 * inv;
+        w[2][l] = q2 * inv;
+        depth[l] = lambda[0][l] * z[0] + lambda[1][l] * z[1] + lambda[2][l] * z[2];
+    }
+
+    QuadLanes quad;
+    LaneF w0 = LaneF::Load(w[0]), w1 = LaneF::Load(w[1]), w2 = LaneF::Load(w[2]);
+    for (unsigned r = 0; r < VARYING_COUNT; ++r)
+    {
+        if (!(m_varyings & (1u << r)))
+            continue;
+        for (unsigned k = 0; k < 4; ++k)
+            quad.varyings[r].c[k] = w0 * LaneF(v[0]->var[r][k]) + w1 * LaneF(v[1]->var[r][k]) +
+                                    w2 * LaneF(v[2]->var[r][k]);
+    }
+
+    unsigned long long before = m_psVM.Stats().instructions;
+    m_psVM.RunQuad(quad);
+    m_stats.psInstructions += m_psVM.Stats().instructions - before;
+    ++m_stats.quads;
+
+    if (m_pPS->WritesDepth())
+        quad.depth.Store(depth);
+
+    float rgba[4][4];
+    for (unsigned k = 0; k < 4; ++k)
+        quad.colors[0].c[k].Store(rgba[k]);
+
+    static const int laneX[4] = { 0, 1, 0, 1 };
+    static const int laneY[4] = { 0, 0, 1, 1 };
+    unsigned live = coverage & ~quad.killMask;
+    for (unsigned l = 0; l < 4; ++l)
+    {
+        if (!(live & (1u << l)))
+            continue;
+
+        size_t at = (size_t)(y + laneY[l]) * m_width + (x + laneX[l]);
+        float  d  = depth[l] < 0.0f ? 0.0f : (depth[l] > 1.0f ? 1.0f : depth[l]);
+        if (m_depthTest && d > m_depth[at])
+            continue;
+        if (m_depthWrite)
+            m_depth[at] = d;
+
+        m_color[at] = ToArgb(rgba[0][l], rgba[1][l], rgba[2][l], rgba[3][l]);
+        ++m_stats.pixels;
+    }
+}
+
+//===============================================================
+// 24-bit bottom-up BMP.
+
+bool SoftRasterizer::SaveBmp(const char* path) const
+{
+    if (m_color.empty())
+        return false;
+
+    FILE* fp = fopen(path, "wb");
+    if (fp == NULL)
+        return false;
+
+    unsigned pitch = (m_width * 3 + 3) & ~3u;
+    unsigned imageSize = pitch * m_height;
+
+    unsigned char header[54];
+    memset(header, 0, sizeof(header));
+    unsigned values[][2] =
+    {
+        { 2, 54 + imageSize }, { 10, 54 }, { 14, 40 }, { 18, m_width }, { 22, m_height },
+        { 34, imageSize }
+    };
+    header[0] = 'B';
+    header[1] = 'M';
+    for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i)
+    {
+        for (unsigned k = 0; k < 4; ++k)
+            header[values[i][0] + k] = (unsigned char)(values[i][1] >> (8 * k));
+    }
+    header[26] = 1;     // planes
+    header[28] = 24;    // bpp
+
+    bool ok = fwrite(header, sizeof(header), 1, fp) == 1;
+
+    std::vector<unsigned char> row(pitch, 0);
+    for (unsigned y = 0; ok && y < m_height; ++y)
+    {
+        const unsigned* src = &m_color[(size_t)(m_height - 1 - y) * m_width];
+        for (unsigned x = 0; x < m_width; ++x)
+        {
+            row[3 * x + 0] = (unsigned char)(src[x]);
+            row[3 * x + 1] = (unsigned char)(src[x] >> 8);
+            row[3 * x + 2] = (unsigned char)(src[x] >> 16);
+        }
+        ok = fwrite(&row[0], 1, pitch, fp) == pitch;
+    }
+
+    return fclose(fp) == 0 && ok;
+}
@@ -0,0 +1,137 @@
+//=============================================================================
+// SoftRasterizer.h
+//
+// Headless triangle renderer on top of the software shader engine.  It
+// follows the D3D9 pipeline closely enough that an effect pass renders the
+// same image it would on a device:
+//
+//   vertex fetch   single stream, D3DVERTEXELEMENT9-style declaration,
+//                  converted to SoA batches of LANE_COUNT vertices
+//   vertex shader  ShaderVM::RunVertices
+//   clipping       homogeneous, against near/far and a guard band
+//   setup          4 bit sub-pixel fixed point, top-left fill rule, D3D9
+//                  pixel centres on integer coordinates
+//   pixel shader   ShaderVM::RunQuad on 2x2 quads, perspective-correct
+//                  varyings, helper lanes kept for derivatives
+//   output         LESSEQUAL depth test, oC0 written as A8R8G8B8
+//
+// Blending, stencil and multiple render targets are not implemented.
+//=============================================================================
+
+#ifndef SOFT_RASTERIZER_H
+#define SOFT_RASTERIZER_H
+
+#include <vector>
+#include "SoftShader.h"
+
+
+// D3DDECLTYPE values
+enum SoftDeclType
+{
+    SOFT_DECL_FLOAT1 = 0, SOFT_DECL_FLOAT2, SOFT_DECL_FLOAT3, SOFT_DECL_FLOAT4,
+    SOFT_DECL_D3DCOLOR, SOFT_DECL_UBYTE4
+};
+
+struct SoftVertexElement
+{
+    unsigned offset;
+    unsigned type;          // SoftDeclType
+    unsigned usage;         // ShaderUsage
+    unsigned usageIndex;
+};
+
+struct SoftVertexStream
+{
+    const void*              pData;
+    unsigned                 stride;
+    const SoftVertexElement* pElements;
+    unsigned                 numElements;
+};
+
+// D3DCULL: CCW culls counter-clockwise triangles (the D3D default).
+enum SoftCull { SOFT_CULL_NONE = 1, SOFT_CULL_CW = 2, SOFT_CULL_CCW = 3 };
+
+struct SoftRasterStats
+{
+    unsigned long long vertices;
+    unsigned long long triangles;
+    unsigned long long culled;          // back-facing or outside the frustum
+    unsigned long long clipped;         // needed clipping
+    unsigned long long quads;
+    unsigned long long pixels;          // written
+    unsigned long long vsInstructions;
+    unsigned long long psInstructions;
+};
+
+class SoftRasterizer
+{
+public:
+    SoftRasterizer();
+
+    bool SetRenderTarget(unsigned width, unsigned height);
+    void Clear(unsigned argb, float depth);
+
+    void SetCullMode(SoftCull cull)              { m_cull = cull; }
+    void SetDepthState(bool test, bool write)    { m_depthTest = test; m_depthWrite = write; }
+
+    // Programs and constants are read at draw time; constants may change
+    // between draws.
+    void SetVertexShader(const ShaderProgram* pProgram, const ShaderConstants* pConstants);
+    void SetPixelShader(const ShaderProgram* pProgram, const ShaderConstants* pConstants);
+
+    // Triangle lists, with the meaning of the IDirect3DDevice9 calls.
+    void DrawPrimitive(const SoftVertexStream& stream, unsigned startVertex, unsigned numTriangles);
+    void DrawIndexedPrimitive(const SoftVertexStream& stream, int baseVertex, unsigned minIndex,
+                              unsigned numVertices, const unsigned short* pIndices,
+                              unsigned startIndex, unsigned numTriangles);
+
+    unsigned        Width() const  { return m_width; }
+    unsigned        Height() const { return m_height; }
+    const unsigned* Pixels() const { return m_color.empty() ? NULL : &m_color[0]; }
+
+    bool SaveBmp(const char* path) const;
+
+    const SoftRasterStats& Stats() const { return m_stats; }
+    void ResetStats();
+
+private:
+    struct ClipVertex
+    {
+        float pos[4];
+        float var[VARYING_COUNT][4];
+    };
+
+    struct InputBinding
+    {
+        unsigned                 reg;
+        const SoftVertexElement* pElement;
+    };
+
+    void ShadeVertices(const SoftVertexStream& stream, unsigned first, unsigned count);
+    void DrawTriangle(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c);
+    void Rasterize(const ClipVertex& a, const ClipVertex& b, const ClipVertex& c);
+    void ShadeQuad(int x, int y, unsigned coverage, const float lambda[3][4],
+                   const ClipVertex* v[3], const float invW[3], const float z[3]);
+
+    unsigned              m_width;
+    unsigned              m_height;
+    std::vector<unsigned> m_color;
+    std::vector<float>    m_depth;
+
+    SoftCull              m_cull;
+    bool                  m_depthTest;
+    bool                  m_depthWrite;
+
+    const ShaderProgram*   m_pVS;
+    const ShaderConstants* m_pVSConstants;
+    const ShaderProgram*   m_pPS;
+    const ShaderConstants* m_pPSConstants;
+    unsigned               m_varyings;      // mask used by the current pair
+
+    ShaderVM                m_vsVM;
+    ShaderVM                m_psVM;
+    std::vector<ClipVertex> m_shaded;
+    SoftRasterStats         m_stats;
+};
+
+#endif // SOFT_RASTERIZER_H
@@ -0,0 +1,531 @@
+//=============================================================================
+// SoftReplay.cpp
+//=============================================================================
+
+#include "SoftReplay.h"
+#include <cstring>
+
+
+namespace
+{
+    // Larger buffers in a capture are treated as corrupt.
+    const unsigned MAX_BUFFER_BYTES = 256u << 20;
+
+    // The fixed-function stand-ins, assembled by hand:
+    //
+    //     vs_2_0                       ps_2_0
+    //     dcl_position v0              dcl v0
+    //     dcl_color v1                 mov oC0, v0
+    //     dp4 oPos.x, v0, c0
+    //     dp4 oPos.y, v0, c1
+    //     dp4 oPos.z, v0, c2
+    //     dp4 oPos.w, v0, c3
+    //     add oD0, v1, c4
+    //
+    // c0..c3 hold the columns of world * view * projection, c4 the colour
+    // added to the vertex colour (which reads (0,0,0,1) when there is none).
+    const unsigned s_fixedVS[] =
+    {
+        0xFFFE0200,
+        0x0200001F, 0x80000000, 0x900F0000,
+        0x0200001F, 0x8000000A, 0x900F0001,
+        0x03000009, 0xC0010000, 0x90E40000, 0xA0E40000,
+        0x03000009, 0xC0020000, 0x90E40000, 0xA0E40001,
+        0x03000009, 0xC0040000, 0x90E40000, 0xA0E40002,
+        0x03000009, 0xC0080000, 0x90E40000, 0xA0E40003,
+        0x03000002, 0xD00F0000, 0x90E40001, 0xA0E40004,
+        0x0000FFFF
+    };
+
+    const unsigned s_fixedPS[] =
+    {
+        0xFFFF0200,
+        0x0200001F, 0x80000000, 0x900F0000,
+        0x02000001, 0x800F0800, 0x90E40000,
+        0x0000FFFF
+    };
+
+    // Bytes of each SoftDeclType.
+    const unsigned s_declTypeBytes[] = { 4, 8, 12, 16, 4, 4 };
+
+    void Identity(float m[16])
+    {
+        memset(m, 0, 16 * sizeof(float));
+        m[0] = m[5] = m[10] = m[15] = 1.0f;
+    }
+
+    // Row-major, row vectors: out = a * b.
+    void Multiply(const float a[16], const float b[16], float out[16])
+    {
+        for (int r = 0; r < 4; ++r)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                out[r * 4 + c] = a[r * 4 + 0] * b[0 * 4 + c] + a[r * 4 + 1] * b[1 * 4 + c] +
+                                 a[r * 4 + 2] * b[2 * 4 + c] + a[r * 4 + 3] * b[3 * 4 + c];
+            }
+        }
+    }
+
+    unsigned IndexCount(unsigned type, unsigned primCount)
+    {
+        return type == CAPTURE_PT_TRIANGLELIST ? primCount * 3 : primCount + 2;
+    }
+
+    void AddElement(std::vector<SoftVertexElement>& elements, unsigned& offset, unsigned type,
+                    unsigned usage, unsigned usageIndex)
+    {
+        SoftVertexElement e = { offset, type, usage, usageIndex };
+        elements.push_back(e);
+        offset += s_declTypeBytes[type];
+    }
+}
+
+
+SoftReplay::SoftReplay()
+    : m_hashFrames(true)
+{
+    m_fixedVS.Load(s_fixedVS, sizeof(s_fixedVS));
+    m_fixedPS.Load(s_fixedPS, sizeof(s_fixedPS));
+
+    const unsigned white = 0xffffffff;
+    m_white.Create(1, 1, &white, false);
+
+    Reset();
+}
+
+bool SoftReplay::SetRenderTarget(unsigned width, unsigned height)
+{
+    return m_raster.SetRenderTarget(width, height);
+}
+
+void SoftReplay::Reset()
+{
+    m_buffers.clear();
+    m_shaders.clear();
+    m_decls.clear();
+    m_meshes.clear();
+
+    // D3D9 defaults
+    m_streamBuffer = m_streamOffset = m_streamStride = 0;
+    m_indices = m_fvf = m_decl = m_vs = m_ps = 0;
+    m_cull     = SOFT_CULL_CCW;
+    m_ambient  = 0;
+    m_zEnable  = false;
+    m_zWrite   = true;
+    m_lighting = true;
+    Identity(m_world);
+    Identity(m_view);
+    Identity(m_proj);
+    memset(&m_material, 0, sizeof(m_material));
+    m_lights.clear();
+    memset(m_textures, 0, sizeof(m_textures));
+    m_vsConstants = ShaderConstants();
+    m_psConstants = ShaderConstants();
+
+    m_raster.Clear(0, 1.0f);
+    m_raster.ResetStats();
+    memset(&m_stats, 0, sizeof(m_stats));
+    m_frameHashes.clear();
+}
+
+
+//===============================================================
+// Objects
+
+void SoftReplay::CreateVertexBuffer(unsigned id, unsigned bytes, unsigned)
+{
+    Buffer& b = m_buffers[id];
+    b.data.assign(bytes <= MAX_BUFFER_BYTES ? bytes : 0, 0);
+    b.indexSize = 0;
+}
+
+void SoftReplay::CreateIndexBuffer(unsigned id, unsigned bytes, unsigned indexSize)
+{
+    Buffer& b = m_buffers[id];
+    b.data.assign(bytes <= MAX_BUFFER_BYTES ? bytes : 0, 0);
+    b.indexSize = indexSize == 4 ? 4 : 2;
+}
+
+void SoftReplay::BufferData(unsigned id, unsigned offset, const void* pData, unsigned bytes, unsigned)
+{
+    std::map<unsigned, Buffer>::iterator it = m_buffers.find(id);
+    if (it == m_buffers.end() || offset > it->second.data.size() || bytes > it->second.data.size() - offset)
+        return;
+    if (bytes != 0)
+        memcpy(&it->second.data[offset], pData, bytes);
+    m_stats.bufferBytes += bytes;
+}
+
+void SoftReplay::CreateShader(unsigned id, bool pixelShader, const unsigned* pTokens, unsigned bytes)
+{
+    ShaderProgram& program = m_shaders[id];
+    if (!program.Load(pTokens, bytes) || program.IsPixelShader() != pixelShader)
+    {
+        program.Clear();
+        ++m_stats.shaderErrors;
+    }
+}
+
+void SoftReplay::CreateDeclaration(unsigned id, const CaptureVertexElement* pElements, unsigned count)
+{
+    m_decls[id].assign(pElements, pElements + count);
+}
+
+void SoftReplay::CreateMesh(const CaptureMesh& mesh, const CaptureAttributeRange* pRanges)
+{
+    Mesh& m = m_meshes[mesh.id];
+    m.desc = mesh;
+    m.ranges.assign(pRanges, pRanges + mesh.numRanges);
+}
+
+
+//===============================================================
+// State
+
+void SoftReplay::Clear(unsigned flags, unsigned color, float z, unsigned)
+{
+    // The rasterizer clears colour and depth together; a depth-only clear
+    // is left out so that it cannot wipe the colour.
+    if (flags & CAPTURE_CLEAR_TARGET)
+        m_raster.Clear(color, z);
+}
+
+void SoftReplay::SetRenderState(unsigned state, unsigned value)
+{
+    switch (state)
+    {
+    case CAPTURE_RS_ZENABLE:      m_zEnable  = value != 0; break;
+    case CAPTURE_RS_ZWRITEENABLE: m_zWrite   = value != 0; break;
+    case CAPTURE_RS_CULLMODE:     m_cull     = value;      break;
+    case CAPTURE_RS_LIGHTING:     m_lighting = value != 0; break;
+    case CAPTURE_RS_AMBIENT:      m_ambient  = value;      break;
+    }
+}
+
+void SoftReplay::SetTexture(unsigned sampler, unsigned texture)
+{
+    if (sampler < SOFT_MAX_SAMPLERS)
+        m_textures[sampler] = texture;
+}
+
+void SoftReplay::SetStreamSource(unsigned stream, unsigned buffer, unsigned offset, unsigned stride)
+{
+    // The rasterizer reads a single stream.
+    if (stream != 0)
+        return;
+    m_streamBuffer = buffer;
+    m_streamOffset = offset;
+    m_streamStride = stride;
+}
+
+void SoftReplay::SetVertexShaderConstantF(unsigned first, const float* pData, unsigned count)
+{
+    m_vsConstants.SetFloat4(first, pData, count);
+}
+
+void SoftReplay::SetPixelShaderConstantF(unsigned first, const float* pData, unsigned count)
+{
+    m_psConstants.SetFloat4(first, pData, count);
+}
+
+void SoftReplay::SetTransform(unsigned state, const float* pMatrix)
+{
+    switch (state)
+    {
+    case CAPTURE_TS_WORLD:      memcpy(m_world, pMatrix, sizeof(m_world)); break;
+    case CAPTURE_TS_VIEW:       memcpy(m_view, pMatrix, sizeof(m_view));   break;
+    case CAPTURE_TS_PROJECTION: memcpy(m_proj, pMatrix, sizeof(m_proj));   break;
+    }
+}
+
+void SoftReplay::SetLight(unsigned index, const CaptureLight& light)
+{
+    if (index >= 64)
+        return;
+    if (index >= m_lights.size())
+    {
+        Light off = { { 0.0f, 0.0f, 0.0f }, false };
+        m_lights.resize(index + 1, off);
+    }
+    memcpy(m_lights[index].diffuse, light.diffuse, sizeof(m_lights[index].diffuse));
+}
+
+void SoftReplay::LightEnable(unsigned index, bool enable)
+{
+    if (index >= 64)
+        return;
+    if (index >= m_lights.size())
+    {
+        // Enabling a light that was never set gives the default white one.
+        Light white = { { 1.0f, 1.0f, 1.0f }, false };
+        m_lights.resize(index + 1, white);
+    }
+    m_lights[index].enabled = enable;
+}
+
+
+//===============================================================
+// Draws
+
+bool SoftReplay::BuildElements()
+{
+    m_elements.clear();
+    unsigned bytes = 0;
+
+    if (m_decl != 0)
+    {
+        std::map<unsigned, std::vector<CaptureVertexElement> >::const_iterator it = m_decls.find(m_decl);
+        if (it == m_decls.end())
+            return false;
+        for (size_t i = 0; i < it->second.size(); ++i)
+        {
+            const CaptureVertexElement& e = it->second[i];
+            if (e.stream == 0xFF || e.type == CAPTURE_DECL_UNUSED)
+                break;
+            if (e.usage == CAPTURE_DECL_USAGE_POSITIONT)
+                return false;
+            if (e.stream != 0 || e.type > SOFT_DECL_UBYTE4)
+                continue;           // left at its default in the shader
+            SoftVertexElement s = { e.offset, e.type, e.usage, e.usageIndex };
+            m_elements.push_back(s);
+            if (e.offset + s_declTypeBytes[e.type] > bytes)
+                bytes = e.offset + s_declTypeBytes[e.type];
+        }
+    }
+    else
+    {
+        if ((m_fvf & CAPTURE_FVF_POSITION_MASK) != CAPTURE_FVF_XYZ)
+            return false;       // XYZRHW, or blend weights the stand-in cannot apply
+
+        AddElement(m_elements, bytes, SOFT_DECL_FLOAT3, SUSAGE_POSITION, 0);
+        if (m_fvf & CAPTURE_FVF_NORMAL)
+            AddElement(m_elements, bytes, SOFT_DECL_FLOAT3, SUSAGE_NORMAL, 0);
+        if (m_fvf & CAPTURE_FVF_PSIZE)
+            AddElement(m_elements, bytes, SOFT_DECL_FLOAT1, SUSAGE_PSIZE, 0);
+        if (m_fvf & CAPTURE_FVF_DIFFUSE)
+            AddElement(m_elements, bytes, SOFT_DECL_D3DCOLOR, SUSAGE_COLOR, 0);
+        if (m_fvf & CAPTURE_FVF_SPECULAR)
+            AddElement(m_elements, bytes, SOFT_DECL_D3DCOLOR, SUSAGE_COLOR, 1);
+
+        // D3DFVF_TEXCOORDSIZEn: 0 two floats, 1 three, 2 four, 3 one.
+        static const unsigned sizeToType[4] = { SOFT_DECL_FLOAT2, SOFT_DECL_FLOAT3, SOFT_DECL_FLOAT4, SOFT_DECL_FLOAT1 };
+        unsigned numTexCoords = (m_fvf & CAPTURE_FVF_TEXCOUNT_MASK) >> CAPTURE_FVF_TEXCOUNT_SHIFT;
+        for (unsigned t = 0; t < numTexCoords && t < 8; ++t)
+            AddElement(m_elements, bytes, sizeToType[(m_fvf >> (16 + 2 * t)) & 3], SUSAGE_TEXCOORD, t);
+    }
+
+    return bytes <= m_streamStride;
+}
+
+bool SoftReplay::BindPipeline()
+{
+    const ShaderProgram*   pVS = &m_fixedVS;
+    const ShaderConstants* pVSConstants = &m_fixedConstants;
+    if (m_vs != 0)
+    {
+        std::map<unsigned, ShaderProgram>::const_iterator it = m_shaders.find(m_vs);
+        if (it == m_shaders.end() || !it->second.IsLoaded())
+            return false;
+        pVS = &it->second;
+        pVSConstants = &m_vsConstants;
+    }
+    else
+    {
+        float wv[16], wvp[16];
+        Multiply(m_world, m_view, wv);
+        Multiply(wv, m_proj, wvp);
+        for (unsigned c = 0; c < 4; ++c)
+        {
+            float column[4] = { wvp[c], wvp[4 + c], wvp[8 + c], wvp[12 + c] };
+            m_fixedConstants.SetFloat4(c, column);
+        }
+
+        bool hasColor = false;
+        for (size_t e = 0; e < m_elements.size(); ++e)
+            hasColor |= m_elements[e].usage == SUSAGE_COLOR && m_elements[e].usageIndex == 0;
+
+        float color[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        if (!hasColor && !m_lighting)
+            color[0] = color[1] = color[2] = 1.0f;
+        else if (!hasColor)
+        {
+            float lights[3] = { 0.0f, 0.0f, 0.0f };
+            for (size_t l = 0; l < m_lights.size(); ++l)
+            {
+                if (!m_lights[l].enabled)
+                    continue;
+                for (int k = 0; k < 3; ++k)
+                    lights[k] += m_lights[l].diffuse[k];
+            }
+            float ambient[3] = { ((m_ambient >> 16) & 0xFF) / 255.0f, ((m_ambient >> 8) & 0xFF) / 255.0f,
+                                 (m_ambient & 0xFF) / 255.0f };
+            for (int k = 0; k < 3; ++k)
+                color[k] = m_material.emissive[k] + m_material.ambient[k] * ambient[k] +
+                           m_material.diffuse[k] * lights[k];
+        }
+        m_fixedConstants.SetFloat4(4, color);
+    }
+
+    const ShaderProgram*   pPS = &m_fixedPS;
+    const ShaderConstants* pPSConstants = &m_fixedConstants;
+    if (m_ps != 0)
+    {
+        std::map<unsigned, ShaderProgram>::const_iterator it = m_shaders.find(m_ps);
+        if (it == m_shaders.end() || !it->second.IsLoaded())
+            return false;
+        pPS = &it->second;
+        pPSConstants = &m_psConstants;
+        for (unsigned s = 0; s < SOFT_MAX_SAMPLERS; ++s)
+            m_psConstants.samplers[s] = m_textures[s] != 0 ? &m_white : NULL;
+    }
+
+    m_raster.SetVertexShader(pVS, pVSConstants);
+    m_raster.SetPixelShader(pPS, pPSConstants);
+    m_raster.SetCullMode(m_cull == SOFT_CULL_NONE || m_cull == SOFT_CULL_CW ? (SoftCull)m_cull : SOFT_CULL_CCW);
+    m_raster.SetDepthState(m_zEnable, m_zEnable && m_zWrite);
+    return true;
+}
+
+void SoftReplay::Draw(unsigned type, const Buffer* pIB, int baseVertex, unsigned minIndex, unsigned numVertices,
+                      unsigned startIndex, unsigned primCount)
+{
+    std::map<unsigned, Buffer>::const_iterator vb = m_buffers.find(m_streamBuffer);
+    if (type < CAPTURE_PT_TRIANGLELIST || type > CAPTURE_PT_TRIANGLEFAN || primCount == 0 ||
+        vb == m_buffers.end() || vb->second.indexSize != 0 || m_streamStride == 0 ||
+        numVertices == 0 || numVertices > 0xFFFF || baseVertex + (long long)minIndex < 0 ||
+        !BuildElements())
+    {
+        ++m_stats.skipped;
+        return;
+    }
+
+    // Every vertex the draw may read has to be in the buffer.
+    const std::vector<unsigned char>& vertices = vb->second.data;
+    unsigned long long first = (unsigned long long)(baseVertex + (long long)minIndex);
+    if (m_streamOffset > vertices.size() ||
+        (first + numVertices) * m_streamStride > vertices.size() - m_streamOffset)
+    {
+        ++m_stats.skipped;
+        return;
+    }
+
+    unsigned numIndices = IndexCount(type, primCount);
+    if (pIB && (unsigned long long)(startIndex + (unsigned long long)numIndices) * pIB->indexSize > pIB->data.size())
+    {
+        ++m_stats.skipped;
+        return;
+    }
+
+    if (!BindPipeline())
+    {
+        ++m_stats.skipped;
+        return;
+    }
+
+    SoftVertexStream stream = { &vertices[m_streamOffset], m_streamStride,
+                                m_elements.empty() ? NULL : &m_elements[0], (unsigned)m_elements.size() };
+
+    if (type == CAPTURE_PT_TRIANGLELIST && pIB == NULL)
+        m_raster.DrawPrimitive(stream, (unsigned)first, primCount);
+    else if (type == CAPTURE_PT_TRIANGLELIST && pIB->indexSize == 2)
+        m_raster.DrawIndexedPrimitive(stream, baseVertex, minIndex, numVertices,
+                                      reinterpret_cast<const unsigned short*>(&pIB->data[0]), startIndex, primCount);
+    else
+    {
+        // Strips, fans and 32-bit indices become a 16-bit list relative to
+        // the first vertex; indices outside the range are dropped by the
+        // rasterizer.
+        std::vector<unsigned> source(numIndices);
+        for (unsigned i = 0; i < numIndices; ++i)
+        {
+            unsigned index = i;
+            if (pIB && pIB->indexSize == 2)
+                index = reinterpret_cast<const unsigned short*>(&pIB->data[0])[startIndex + i];
+            else if (pIB)
+                index = reinterpret_cast<const unsigned*>(&pIB->data[0])[startIndex + i];
+            if (pIB)
+                index -= minIndex;
+            source[i] = index < numVertices ? index : 0xFFFF;
+        }
+
+        m_listIndices.resize(primCount * 3);
+        unsigned short* pOut = &m_listIndices[0];
+        for (unsigned t = 0; t < primCount; ++t, pOut += 3)
+        {
+            unsigned a, b, c;
+            if (type == CAPTURE_PT_TRIANGLELIST)
+                a = 3 * t, b = 3 * t + 1, c = 3 * t + 2;
+            else if (type == CAPTURE_PT_TRIANGLESTRIP)
+                a = (t & 1) ? t + 1 : t, b = (t & 1) ? t : t + 1, c = t + 2;   // odd ones keep the winding
+            else
+                a = 0, b = t + 1, c = t + 2;
+            pOut[0] = (unsigned short)source[a];
+            pOut[1] = (unsigned short)source[b];
+            pOut[2] = (unsigned short)source[c];
+        }
+        m_raster.DrawIndexedPrimitive(stream, (int)first, 0, numVertices, &m_listIndices[0], 0, primCount);
+    }
+
+    ++m_stats.draws;
+    m_stats.triangles += primCount;
+}
+
+void SoftReplay::DrawPrimitive(unsigned type, unsigned startVertex, unsigned primCount)
+{
+    Draw(type, NULL, (int)startVertex, 0, IndexCount(type, primCount), 0, primCount);
+}
+
+void SoftReplay::DrawIndexedPrimitive(unsigned type, int baseVertex, unsigned minIndex, unsigned numVertices,
+                                      unsigned startIndex, unsigned primCount)
+{
+    std::map<unsigned, Buffer>::const_iterator ib = m_buffers.find(m_indices);
+    if (ib == m_buffers.end() || ib->second.indexSize == 0)
+    {
+        ++m_stats.skipped;
+        return;
+    }
+    Draw(type, &ib->second, baseVertex, minIndex, numVertices, startIndex, primCount);
+}
+
+void SoftReplay::DrawSubset(unsigned mesh, unsigned attribute)
+{
+    std::map<unsigned, Mesh>::const_iterator it = m_meshes.find(mesh);
+    if (it == m_meshes.end())
+    {
+        ++m_stats.skipped;
+        return;
+    }
+
+    // Like ID3DXMesh::DrawSubset, leaves the mesh's buffers and FVF bound.
+    const Mesh& m = it->second;
+    SetStreamSource(0, m.desc.vertexBuffer, 0, m.desc.stride);
+    SetIndices(m.desc.indexBuffer);
+    SetFVF(m.desc.fvf);
+
+    for (size_t r = 0; r < m.ranges.size(); ++r)
+    {
+        const CaptureAttributeRange& range = m.ranges[r];
+        if (range.attribute == attribute && range.faceCount != 0)
+            DrawIndexedPrimitive(CAPTURE_PT_TRIANGLELIST, 0, range.vertexStart, range.vertexCount,
+                                 range.faceStart * 3, range.faceCount);
+    }
+}
+
+unsigned long long SoftReplay::HashRenderTarget() const
+{
+    // FNV-1a, 64 bit
+    unsigned long long hash = 14695981039346656037ull;
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(m_raster.Pixels());
+    size_t bytes = (size_t)m_raster.Width() * m_raster.Height() * 4;
+    for (size_t i = 0; p && i < bytes; ++i)
+        hash = (hash ^ p[i]) * 1099511628211ull;
+    return hash;
+}
+
+void SoftReplay::EndFrame(unsigned)
+{
+    if (m_hashFrames)
+        m_frameHashes.push_back(HashRenderTarget());
+    ++m_stats.frames;
+}
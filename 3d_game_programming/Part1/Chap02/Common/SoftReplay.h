@@ -0,0 +1,172 @@
+//=============================================================================
+// SoftReplay.h
+//
+// CaptureFile::Replay target that draws a device capture with the software
+// rasterizer, so captures can be replayed, timed and compared on any
+// machine without a GPU or the DirectX SDK:
+//
+//     SoftReplay replay;
+//     replay.SetRenderTarget( 300, 300 );
+//     capture.Replay( replay );
+//     replay.FrameHashes();        // one per frame, for regression checks
+//
+// Shaders captured from effects run as they are, with the constants the
+// capture recorded.  The fixed-function pipeline is emulated with a
+// built-in shader pair that transforms by world * view * projection and
+// outputs one colour per draw plus the vertex colour:
+//
+//   - lighting off: the vertex colour, or white without one
+//   - lighting on:  emissive + ambient * D3DRS_AMBIENT + diffuse * the
+//                   enabled lights' diffuse, as if every surface faced
+//                   every light
+//
+// Textures are captured by id only; every bound texture samples as white,
+// so sampler and texture stage states have nothing to act on and are
+// ignored, as are clip planes.  The viewport and scissor rect are ignored
+// too: every draw covers the whole render target.  Stream frequencies are
+// ignored, so an instanced draw is drawn once.
+// Points, lines and pre-transformed (XYZRHW) vertices are not drawn, nor
+// are draws whose vertex or index range falls outside the captured
+// buffers; they are counted as skipped.
+//=============================================================================
+
+#ifndef SOFT_REPLAY_H
+#define SOFT_REPLAY_H
+
+#include "CaptureFormat.h"
+#include "SoftRasterizer.h"
+#include "SoftTexture.h"
+#include <map>
+#include <vector>
+
+
+struct SoftReplayStats
+{
+    unsigned           frames;
+    unsigned long long draws;           // drawn
+    unsigned long long skipped;         // not drawn, see above
+    unsigned long long triangles;       // submitted by drawn calls
+    unsigned long long bufferBytes;     // BufferData copied
+    unsigned           shaderErrors;    // captured shaders the engine could not load
+};
+
+
+class SoftReplay
+{
+public:
+    SoftReplay();
+
+    bool SetRenderTarget(unsigned width, unsigned height);
+
+    // Forgets every object and all state, to replay a capture again.
+    void Reset();
+
+    const SoftRasterizer&   Rasterizer() const { return m_raster; }
+    const SoftReplayStats&  Stats() const      { return m_stats; }
+
+    // FNV-1a of the render target at the end of every frame.
+    const std::vector<unsigned long long>& FrameHashes() const { return m_frameHashes; }
+
+    // Hashing reads the whole render target.  With it off, EndFrame() only
+    // counts the frame and FrameHashes() does not grow; a benchmark times
+    // its frames that way and hashes the last one with HashRenderTarget().
+    void SetFrameHashing(bool enable) { m_hashFrames = enable; }
+    unsigned long long HashRenderTarget() const;
+
+    // CaptureFile::Replay target
+    void EndFrame(unsigned frame);
+    void CreateVertexBuffer(unsigned id, unsigned bytes, unsigned fvf);
+    void CreateIndexBuffer(unsigned id, unsigned bytes, unsigned indexSize);
+    void BufferData(unsigned id, unsigned offset, const void* pData, unsigned bytes, unsigned lockFlags);
+    void CreateShader(unsigned id, bool pixelShader, const unsigned* pTokens, unsigned bytes);
+    void CreateDeclaration(unsigned id, const CaptureVertexElement* pElements, unsigned count);
+    void CreateMesh(const CaptureMesh& mesh, const CaptureAttributeRange* pRanges);
+    void Clear(unsigned flags, unsigned color, float z, unsigned stencil);
+    void SetRenderState(unsigned state, unsigned value);
+    void SetTexture(unsigned sampler, unsigned texture);
+    void SetSamplerState(unsigned, unsigned, unsigned) {}
+    void SetTextureStageState(unsigned, unsigned, unsigned) {}
+    void SetStreamSource(unsigned stream, unsigned buffer, unsigned offset, unsigned stride);
+    void SetStreamSourceFreq(unsigned, unsigned) {}
+    void SetIndices(unsigned buffer)                { m_indices = buffer; }
+    void SetFVF(unsigned fvf)                       { m_fvf = fvf; m_decl = 0; }
+    void SetVertexDeclaration(unsigned declaration) { m_decl = declaration; m_fvf = 0; }
+    void SetVertexShader(unsigned shader)           { m_vs = shader; }
+    void SetPixelShader(unsigned shader)            { m_ps = shader; }
+    void SetVertexShaderConstantF(unsigned first, const float* pData, unsigned count);
+    void SetPixelShaderConstantF(unsigned first, const float* pData, unsigned count);
+    void SetTransform(unsigned state, const float* pMatrix);
+    void SetMaterial(const CaptureMaterial& material) { m_material = material; }
+    void SetLight(unsigned index, const CaptureLight& light);
+    void LightEnable(unsigned index, bool enable);
+    void SetViewport(const CaptureViewport&) {}
+    void SetScissorRect(const CaptureRect&) {}
+    void SetClipPlane(unsigned, const float*) {}
+    void SetMatrix(unsigned, const char*, const float*, unsigned) {}   // reaches the device as constants
+    void DrawPrimitive(unsigned type, unsigned startVertex, unsigned primCount);
+    void DrawIndexedPrimitive(unsigned type, int baseVertex, unsigned minIndex, unsigned numVertices,
+                              unsigned startIndex, unsigned primCount);
+    void DrawSubset(unsigned mesh, unsigned attribute);
+
+private:
+    struct Buffer
+    {
+        std::vector<unsigned char> data;
+        unsigned                   indexSize;   // 0 for vertex buffers
+    };
+
+    struct Mesh
+    {
+        CaptureMesh                        desc;
+        std::vector<CaptureAttributeRange> ranges;
+    };
+
+    struct Light
+    {
+        float diffuse[3];
+        bool  enabled;
+    };
+
+    // Vertex layout of the current FVF or declaration; false if it cannot
+    // be drawn.
+    bool BuildElements();
+
+    // Shaders, constants and raster state for the next draw.
+    bool BindPipeline();
+
+    void Draw(unsigned type, const Buffer* pIB, int baseVertex, unsigned minIndex, unsigned numVertices,
+              unsigned startIndex, unsigned primCount);
+
+    SoftRasterizer   m_raster;
+    ShaderProgram    m_fixedVS;
+    ShaderProgram    m_fixedPS;
+    ShaderConstants  m_fixedConstants;
+    ShaderConstants  m_vsConstants;
+    ShaderConstants  m_psConstants;
+    SoftTexture      m_white;
+
+    std::map<unsigned, Buffer>                          m_buffers;
+    std::map<unsigned, ShaderProgram>                   m_shaders;
+    std::map<unsigned, std::vector<CaptureVertexElement> > m_decls;
+    std::map<unsigned, Mesh>                            m_meshes;
+
+    // Device state
+    unsigned        m_streamBuffer, m_streamOffset, m_streamStride;
+    unsigned        m_indices, m_fvf, m_decl, m_vs, m_ps;
+    unsigned        m_cull, m_ambient;
+    bool            m_zEnable, m_zWrite, m_lighting;
+    float           m_world[16], m_view[16], m_proj[16];
+    CaptureMaterial m_material;
+    std::vector<Light> m_lights;
+    unsigned        m_textures[SOFT_MAX_SAMPLERS];
+
+    // Scratch
+    std::vector<SoftVertexElement> m_elements;
+    std::vector<unsigned short>    m_listIndices;
+
+    SoftReplayStats                 m_stats;
+    std::vector<unsigned long long> m_frameHashes;
+    bool                            m_hashFrames;
+};
+
+#endif // SOFT_REPLAY_H
@@ -0,0 +1,1244 @@
+//=============================================================================
+// SoftShader.cpp
+//=============================================================================
+
+#include "SoftShader.h"
+#include "SoftTexture.h"
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define snprintf _snprintf
+#endif
+
+
+namespace
+{
+    const unsigned VERSION_VS  = 0xFFFE0000;
+    const unsigned VERSION_PS  = 0xFFFF0000;
+    const unsigned CTAB_FOURCC = 0x42415443;   // "CTAB"
+
+    // Source modifiers (D3DSPSM_*)
+    enum
+    {
+        SRCMOD_NONE, SRCMOD_NEG, SRCMOD_BIAS, SRCMOD_BIASNEG, SRCMOD_SIGN, SRCMOD_SIGNNEG,
+        SRCMOD_COMP, SRCMOD_X2, SRCMOD_X2NEG, SRCMOD_DZ, SRCMOD_DW, SRCMOD_ABS, SRCMOD_ABSNEG,
+        SRCMOD_NOT
+    };
+
+    // texld control bits
+    const unsigned TEXLD_PROJECT = 1;
+    const unsigned TEXLD_BIAS    = 2;
+
+    // Output slots in ShaderVM::m_outputs
+    enum
+    {
+        OUT_POSITION = 0, OUT_FOG = 1, OUT_POINTSIZE = 2, OUT_COLOR0 = 3, OUT_TEX0 = 5,
+        OUT_PS_COLOR0 = 0, OUT_PS_DEPTH = 4
+    };
+
+    unsigned RegisterType(unsigned token)
+    {
+        return ((token >> 28) & 7) | ((token >> 8) & 0x18);
+    }
+
+    void DecodeDest(unsigned token, ShaderOperand& op, bool& saturate)
+    {
+        memset(&op, 0, sizeof(op));
+        op.type      = RegisterType(token);
+        op.index     = token & 0x7FF;
+        op.writeMask = (token >> 16) & 0xF;
+        saturate     = ((token >> 20) & 1) != 0;
+        for (unsigned c = 0; c < 4; ++c)
+            op.swizzle[c] = (unsigned char)c;
+    }
+
+    void DecodeSource(unsigned token, ShaderOperand& op)
+    {
+        memset(&op, 0, sizeof(op));
+        op.type     = RegisterType(token);
+        op.index    = token & 0x7FF;
+        op.modifier = (token >> 24) & 0xF;
+        op.relative = ((token >> 13) & 1) != 0;
+        for (unsigned c = 0; c < 4; ++c)
+            op.swizzle[c] = (unsigned char)((token >> (16 + 2 * c)) & 3);
+    }
+
+    bool HasDest(unsigned opcode)
+    {
+        switch (opcode)
+        {
+        case SOP_NOP: case SOP_CALL: case SOP_CALLNZ: case SOP_LOOP: case SOP_RET:
+        case SOP_ENDLOOP: case SOP_LABEL: case SOP_REP: case SOP_ENDREP: case SOP_IF:
+        case SOP_IFC: case SOP_ELSE: case SOP_ENDIF: case SOP_BREAK: case SOP_BREAKC:
+            return false;
+        default:
+            return true;
+        }
+    }
+
+    bool IsSupported(unsigned opcode)
+    {
+        if (opcode <= SOP_MOVA)
+            return opcode != SOP_IFC && opcode != SOP_BREAKC;
+        switch (opcode)
+        {
+        case SOP_TEXKILL: case SOP_TEX: case SOP_EXPP: case SOP_LOGP: case SOP_CND:
+        case SOP_CMP: case SOP_DP2ADD: case SOP_DSX: case SOP_DSY: case SOP_TEXLDL:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    unsigned ReadU16(const unsigned char* p) { return p[0] | (p[1] << 8); }
+    unsigned ReadU32(const unsigned char* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned)p[3] << 24); }
+
+    inline LaneF Dot3(const LaneVec& a, const LaneVec& b)
+    {
+        return a.c[0] * b.c[0] + a.c[1] * b.c[1] + a.c[2] * b.c[2];
+    }
+
+    inline LaneF Dot4(const LaneVec& a, const LaneVec& b)
+    {
+        return a.c[0] * b.c[0] + a.c[1] * b.c[1] + a.c[2] * b.c[2] + a.c[3] * b.c[3];
+    }
+
+    inline LaneVec Splat(LaneF s)
+    {
+        LaneVec r;
+        r.c[0] = r.c[1] = r.c[2] = r.c[3] = s;
+        return r;
+    }
+
+    float Exp2(float x)   { return powf(2.0f, x); }
+    float Log2Abs(float x)
+    {
+        x = fabsf(x);
+        return x == 0.0f ? -HUGE_VALF : logf(x) * 1.44269504f;
+    }
+    float SinF(float x)   { return sinf(x); }
+    float CosF(float x)   { return cosf(x); }
+    float RoundF(float x) { return floorf(x + 0.5f); }
+}
+
+
+//===============================================================
+// ShaderProgram
+
+ShaderProgram::ShaderProgram()
+{
+    Clear();
+}
+
+void ShaderProgram::Clear()
+{
+    m_pixelShader = false;
+    m_version     = 0;
+    m_varyingMask = 0;
+    m_numTemps    = 0;
+    m_writesDepth = false;
+    m_code.clear();
+    m_decls.clear();
+    m_floatDefs.clear();
+    m_intDefs.clear();
+    m_boolDefs.clear();
+    m_constants.clear();
+}
+
+bool ShaderProgram::Load(const void* pFunction, size_t maxBytes, std::string* pError)
+{
+    Clear();
+
+    std::string error;
+    const unsigned* p   = (const unsigned*)pFunction;
+    const unsigned* end = p + maxBytes / 4;
+
+    if (p == NULL || p >= end)
+        error = "empty shader";
+    else if ((*p & 0xFFFF0000) != VERSION_VS && (*p & 0xFFFF0000) != VERSION_PS)
+        error = "not a vs/ps token stream";
+    else if ((*p & 0xFFFF) < 0x0200 || (*p & 0xFFFF) >= 0x0300)
+        error = "only shader model 2 is supported";
+    else
+    {
+        m_pixelShader = (*p & 0xFFFF0000) == VERSION_PS;
+        m_version     = *p & 0xFFFF;
+        ++p;
+
+        bool ended = false;
+        while (error.empty() && p < end)
+        {
+            if ((*p & 0xFFFF) == SOP_END)
+            {
+                ended = true;
+                break;
+            }
+            DecodeInstruction(p, end, error);
+        }
+        if (error.empty() && !ended)
+            error = "missing END token";
+    }
+
+    if (error.empty())
+    {
+        Finish();
+        if (m_code.empty())
+            error = "no instructions";
+    }
+
+    if (!error.empty())
+    {
+        Clear();
+        if (pError)
+            *pError = error;
+        return false;
+    }
+    return true;
+}
+
+bool ShaderProgram::DecodeInstruction(const unsigned*& p, const unsigned* end, std::string& error)
+{
+    unsigned token  = *p++;
+    unsigned opcode = token & 0xFFFF;
+
+    if (opcode == SOP_COMMENT)
+    {
+        unsigned length = (token >> 16) & 0x7FFF;
+        if (length > (unsigned)(end - p))
+        {
+            error = "truncated comment";
+            return false;
+        }
+        DecodeComment(p, length);
+        p += length;
+        return true;
+    }
+
+    unsigned length = (token >> 24) & 0xF;
+    if (length > (unsigned)(end - p))
+    {
+        error = "truncated instruction";
+        return false;
+    }
+    const unsigned* args    = p;
+    const unsigned* argsEnd = p + length;
+    p = argsEnd;
+
+    char msg[64];
+    if (token & (1u << 28))
+    {
+        error = "predicated instructions are not supported";
+        return false;
+    }
+
+    switch (opcode)
+    {
+    case SOP_DCL:
+        {
+            if (length < 2)
+            {
+                error = "bad dcl";
+                return false;
+            }
+            ShaderOperand dst;
+            bool sat;
+            DecodeDest(args[1], dst, sat);
+
+            ShaderDeclaration d;
+            d.type        = dst.type;
+            d.index       = dst.index;
+            d.usage       = args[0] & 0x1F;
+            d.usageIndex  = (args[0] >> 16) & 0xF;
+            d.textureType = (args[0] >> 27) & 0xF;
+            m_decls.push_back(d);
+            return true;
+        }
+    case SOP_DEF:
+        {
+            if (length < 5)
+            {
+                error = "bad def";
+                return false;
+            }
+            FloatDef d;
+            d.index = args[0] & 0x7FF;
+            memcpy(d.value, &args[1], sizeof(d.value));
+            m_floatDefs.push_back(d);
+            return true;
+        }
+    case SOP_DEFI:
+        {
+            if (length < 5)
+            {
+                error = "bad defi";
+                return false;
+            }
+            IntDef d;
+            d.index = args[0] & 0x7FF;
+            memcpy(d.value, &args[1], sizeof(d.value));
+            m_intDefs.push_back(d);
+            return true;
+        }
+    case SOP_DEFB:
+        {
+            if (length < 2)
+            {
+                error = "bad defb";
+                return false;
+            }
+            BoolDef d;
+            d.index = args[0] & 0x7FF;
+            d.value = args[1] != 0;
+            m_boolDefs.push_back(d);
+            return true;
+        }
+    case SOP_PHASE:
+        error = "ps_1_4 phase is not supported";
+        return false;
+    }
+
+    if (!IsSupported(opcode))
+    {
+        snprintf(msg, sizeof(msg), "unsupported opcode %u", opcode);
+        error = msg;
+        return false;
+    }
+
+    ShaderInstruction ins;
+    memset(&ins, 0, sizeof(ins));
+    ins.opcode  = opcode;
+    ins.control = (token >> 16) & 0xFF;
+
+    if (HasDest(opcode))
+    {
+        if (args >= argsEnd)
+        {
+            error = "missing destination";
+            return false;
+        }
+        DecodeDest(*args++, ins.dst, ins.saturate);
+        if (ins.dst.type == SREG_TEMP && ins.dst.index + 1 > m_numTemps)
+            m_numTemps = ins.dst.index + 1;
+    }
+
+    while (args < argsEnd)
+    {
+        if (ins.numSources == 4)
+        {
+            error = "too many sources";
+            return false;
+        }
+        ShaderOperand& src = ins.src[ins.numSources++];
+        DecodeSource(*args++, src);
+
+        if (src.relative)
+        {
+            if (args >= argsEnd)
+            {
+                error = "missing relative address token";
+                return false;
+            }
+            src.relType      = RegisterType(*args);
+            src.relComponent = (*args >> 16) & 3;
+            ++args;
+        }
+    }
+
+    m_code.push_back(ins);
+    return true;
+}
+
+//===============================================================
+// CTAB: the constant table fxc stores in a comment block.
+
+bool ShaderProgram::DecodeComment(const unsigned* p, unsigned numTokens)
+{
+    if (numTokens < 8 || p[0] != CTAB_FOURCC)
+        return false;
+
+    const unsigned char* table = (const unsigned char*)(p + 1);
+    size_t size = (numTokens - 1) * 4;
+
+    unsigned numConstants = ReadU32(table + 12);
+    unsigned infoOffset   = ReadU32(table + 16);
+    if (infoOffset > size || numConstants > (size - infoOffset) / 20)
+        return false;
+
+    for (unsigned i = 0; i < numConstants; ++i)
+    {
+        const unsigned char* info = table + infoOffset + i * 20;
+        unsigned nameOffset = ReadU32(info);
+        unsigned typeOffset = ReadU32(info + 12);
+        if (nameOffset >= size || typeOffset + 8 > size)
+            continue;
+
+        ShaderConstantInfo c;
+        const char* name = (const char*)table + nameOffset;
+        c.name.assign(name, strnlen(name, size - nameOffset));
+        c.registerSet    = ReadU16(info + 4);
+        c.registerIndex  = ReadU16(info + 6);
+        c.registerCount  = ReadU16(info + 8);
+        c.parameterClass = ReadU16(table + typeOffset);
+        c.rows           = ReadU16(table + typeOffset + 4);
+        c.columns        = ReadU16(table + typeOffset + 6);
+        m_constants.push_back(c);
+    }
+    return true;
+}
+
+//===============================================================
+// Matches flow control (jump targets are stored in the otherwise
+// unused dst.index of IF/ELSE/REP/LOOP/BREAK/CALL) and collects the
+// varyings the program reads or writes.
+
+void ShaderProgram::Finish()
+{
+    std::vector<unsigned> blocks;       // open if/else/rep/loop
+    std::vector<unsigned> loops;
+    std::vector<unsigned> labels(2048, (unsigned)-1);
+
+    for (unsigned pc = 0; pc < m_code.size(); ++pc)
+    {
+        ShaderInstruction& ins = m_code[pc];
+        switch (ins.opcode)
+        {
+        case SOP_IF:
+        case SOP_REP:
+        case SOP_LOOP:
+            blocks.push_back(pc);
+            if (ins.opcode != SOP_IF)
+                loops.push_back(pc);
+            ins.dst.index = pc;
+            break;
+        case SOP_ELSE:
+            if (!blocks.empty())
+            {
+                m_code[blocks.back()].dst.index = pc;
+                blocks.back() = pc;
+            }
+            break;
+        case SOP_ENDIF:
+        case SOP_ENDREP:
+        case SOP_ENDLOOP:
+            if (!blocks.empty())
+            {
+                m_code[blocks.back()].dst.index = pc;
+                if (ins.opcode != SOP_ENDIF && !loops.empty())
+                {
+                    ins.dst.index = loops.back();
+                    loops.pop_back();
+                }
+                blocks.pop_back();
+            }
+            break;
+        case SOP_BREAK:
+            ins.dst.index = loops.empty() ? (unsigned)-1 : loops.back();
+            break;
+        case SOP_LABEL:
+            if (ins.src[0].index < labels.size())
+                labels[ins.src[0].index] = pc;
+            break;
+        }
+    }
+
+    // A break jumps to the end of its loop, which is now known.
+    for (unsigned pc = 0; pc < m_code.size(); ++pc)
+    {
+        ShaderInstruction& ins = m_code[pc];
+        if (ins.opcode == SOP_BREAK && ins.dst.index != (unsigned)-1)
+            ins.dst.index = m_code[ins.dst.index].dst.index;
+        else if ((ins.opcode == SOP_CALL || ins.opcode == SOP_CALLNZ) && ins.src[0].index < labels.size())
+            ins.dst.index = labels[ins.src[0].index];
+    }
+
+    // Varyings: vs outputs written, ps inputs declared.
+    for (unsigned pc = 0; pc < m_code.size(); ++pc)
+    {
+        const ShaderOperand& d = m_code[pc].dst;
+        if (!HasDest(m_code[pc].opcode))
+            continue;
+        if (d.type == SREG_DEPTHOUT)
+            m_writesDepth = true;
+        if (m_pixelShader)
+            continue;
+        if (d.type == SREG_ATTROUT && d.index < 2)
+            m_varyingMask |= 1u << (VARYING_COLOR0 + d.index);
+        else if (d.type == SREG_TEXCRDOUT && d.index < 8)
+            m_varyingMask |= 1u << (VARYING_TEX0 + d.index);
+        else if (d.type == SREG_RASTOUT && d.index == 1)
+            m_varyingMask |= 1u << VARYING_FOG;
+    }
+    for (size_t i = 0; m_pixelShader && i < m_decls.size(); ++i)
+    {
+        const ShaderDeclaration& d = m_decls[i];
+        if (d.type == SREG_INPUT && d.index < 2)
+            m_varyingMask |= 1u << (VARYING_COLOR0 + d.index);
+        else if (d.type == SREG_ADDR && d.index < 8)
+            m_varyingMask |= 1u << (VARYING_TEX0 + d.index);
+    }
+}
+
+const ShaderConstantInfo* ShaderProgram::FindConstant(const char* name) const
+{
+    for (size_t i = 0; i < m_constants.size(); ++i)
+    {
+        if (m_constants[i].name == name)
+            return &m_constants[i];
+    }
+    return NULL;
+}
+
+int ShaderProgram::FindInput(unsigned usage, unsigned usageIndex) const
+{
+    for (size_t i = 0; i < m_decls.size(); ++i)
+    {
+        const ShaderDeclaration& d = m_decls[i];
+        if (d.type == SREG_INPUT && d.usage == usage && d.usageIndex == usageIndex)
+            return (int)d.index;
+    }
+    return -1;
+}
+
+
+//===============================================================
+// ShaderConstants
+
+ShaderConstants::ShaderConstants()
+{
+    memset(f, 0, sizeof(f));
+    memset(i, 0, sizeof(i));
+    memset(b, 0, sizeof(b));
+    memset(samplers, 0, sizeof(samplers));
+}
+
+void ShaderConstants::SetFloat4(unsigned reg, const float* v, unsigned count)
+{
+    for (unsigned r = 0; r < count && reg + r < SOFT_MAX_FLOAT_CONSTANTS; ++r)
+        memcpy(f[reg + r], v + 4 * r, 4 * sizeof(float));
+}
+
+bool ShaderConstants::SetMatrix(const ShaderProgram& program, const char* name, const float* m)
+{
+    const ShaderConstantInfo* c = program.FindConstant(name);
+    if (c == NULL || c->registerSet != 2)
+        return false;
+
+    bool byColumns = c->parameterClass == 3;
+    for (unsigned r = 0; r < c->registerCount && r < 4; ++r)
+    {
+        unsigned reg = c->registerIndex + r;
+        if (reg >= SOFT_MAX_FLOAT_CONSTANTS)
+            break;
+        for (unsigned k = 0; k < 4; ++k)
+            f[reg][k] = byColumns ? m[k * 4 + r] : m[r * 4 + k];
+    }
+    return true;
+}
+
+bool ShaderConstants::SetVector(const ShaderProgram& program, const char* name, const float* v)
+{
+    return SetFloatArray(program, name, v, 1);
+}
+
+bool ShaderConstants::SetFloatArray(const ShaderProgram& program, const char* name,
+                                    const float* v, unsigned count)
+{
+    const ShaderConstantInfo* c = program.FindConstant(name);
+    if (c == NULL || c->registerSet != 2)
+        return false;
+
+    SetFloat4(c->registerIndex, v, count < c->registerCount ? count : c->registerCount);
+    return true;
+}
+
+bool ShaderConstants::SetTexture(const ShaderProgram& program, const char* name, SoftTexture* pTexture)
+{
+    const ShaderConstantInfo* c = program.FindConstant(name);
+    if (c == NULL || c->registerSet != 3 || c->registerIndex >= SOFT_MAX_SAMPLERS)
+        return false;
+
+    samplers[c->registerIndex] = pTexture;
+    return true;
+}
+
+
+//===============================================================
+// ShaderVM
+
+ShaderVM::ShaderVM()
+    : m_pProgram(NULL), m_pSource(NULL), m_pInputs(NULL), m_pTexCoords(NULL),
+      m_loop(0), m_killMask(0), m_pixel(false)
+{
+    memset(m_f, 0, sizeof(m_f));
+    memset(m_i, 0, sizeof(m_i));
+    memset(m_b, 0, sizeof(m_b));
+    memset(m_addr, 0, sizeof(m_addr));
+    ResetStats();
+}
+
+void ShaderVM::ResetStats()
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void ShaderVM::Bind(const ShaderProgram* pProgram, const ShaderConstants* pConstants)
+{
+    m_pProgram = pProgram;
+    m_pSource  = pConstants;
+    m_pixel    = pProgram && pProgram->IsPixelShader();
+
+    if (pConstants)
+    {
+        memcpy(m_f, pConstants->f, sizeof(m_f));
+        memcpy(m_i, pConstants->i, sizeof(m_i));
+        memcpy(m_b, pConstants->b, sizeof(m_b));
+    }
+
+    if (pProgram == NULL)
+        return;
+
+    const std::vector<ShaderProgram::FloatDef>& fd = pProgram->FloatDefs();
+    for (size_t k = 0; k < fd.size(); ++k)
+    {
+        if (fd[k].index < SOFT_MAX_FLOAT_CONSTANTS)
+            memcpy(m_f[fd[k].index], fd[k].value, sizeof(fd[k].value));
+    }
+    const std::vector<ShaderProgram::IntDef>& id = pProgram->IntDefs();
+    for (size_t k = 0; k < id.size(); ++k)
+    {
+        if (id[k].index < SOFT_MAX_INT_CONSTANTS)
+            memcpy(m_i[id[k].index], id[k].value, sizeof(id[k].value));
+    }
+    const std::vector<ShaderProgram::BoolDef>& bd = pProgram->BoolDefs();
+    for (size_t k = 0; k < bd.size(); ++k)
+    {
+        if (bd[k].index < SOFT_MAX_BOOL_CONSTANTS)
+            m_b[bd[k].index] = bd[k].value;
+    }
+}
+
+void ShaderVM::RunVertices(VertexLanes& lanes)
+{
+    for (unsigned r = 0; r < 16; ++r)
+        m_outputs[r] = Splat(LaneF(0.0f));
+
+    m_pInputs    = lanes.inputs;
+    m_pTexCoords = NULL;
+    Execute();
+
+    lanes.position  = m_outputs[OUT_POSITION];
+    lanes.pointSize = m_outputs[OUT_POINTSIZE].c[0];
+    for (unsigned v = 0; v < 2; ++v)
+        lanes.varyings[VARYING_COLOR0 + v] = m_outputs[OUT_COLOR0 + v];
+    for (unsigned t = 0; t < 8; ++t)
+        lanes.varyings[VARYING_TEX0 + t] = m_outputs[OUT_TEX0 + t];
+    lanes.varyings[VARYING_FOG] = m_outputs[OUT_FOG];
+}
+
+void ShaderVM::RunQuad(QuadLanes& quad)
+{
+    for (unsigned r = 0; r < 5; ++r)
+        m_outputs[r] = Splat(LaneF(0.0f));
+
+    m_pInputs    = &quad.varyings[VARYING_COLOR0];
+    m_pTexCoords = &quad.varyings[VARYING_TEX0];
+    m_killMask   = 0;
+    Execute();
+
+    for (unsigned c = 0; c < 4; ++c)
+        quad.colors[c] = m_outputs[OUT_PS_COLOR0 + c];
+    quad.depth    = m_outputs[OUT_PS_DEPTH].c[0];
+    quad.killMask = m_killMask;
+}
+
+//===============================================================
+// Operands.  Registers are SoA, so a swizzle just picks which
+// component array each channel comes from.
+
+ShaderVM::Reg ShaderVM::ReadSource(const ShaderOperand& op, unsigned offset) const
+{
+    Reg raw;
+    unsigned index = op.index + offset;
+
+    switch (op.type)
+    {
+    case SREG_TEMP:
+        raw = m_temps[index & 31];
+        break;
+
+    case SREG_INPUT:
+        raw = m_pInputs[index & 15];
+        break;
+
+    case SREG_ADDR:
+        if (m_pixel)
+        {
+            raw = m_pTexCoords[index & 7];
+        }
+        else
+        {
+            for (unsigned c = 0; c < 4; ++c)
+                raw.c[c] = LaneF::Set((float)m_addr[c][0], (float)m_addr[c][1],
+                                      (float)m_addr[c][2], (float)m_addr[c][3]);
+        }
+        break;
+
+    case SREG_CONST:
+        if (!op.relative)
+        {
+            const float* v = index < SOFT_MAX_FLOAT_CONSTANTS ? m_f[index] : m_f[0];
+            for (unsigned c = 0; c < 4; ++c)
+                raw.c[c] = LaneF(v[c]);
+        }
+        else
+        {
+            // c[a0.x + n] can differ per lane: gather.
+            float lanes[4][4];
+            for (unsigned l = 0; l < LANE_COUNT; ++l)
+            {
+                int r = (int)index + (op.relType == SREG_LOOP ? m_loop : m_addr[op.relComponent][l]);
+                bool in = r >= 0 && r < (int)SOFT_MAX_FLOAT_CONSTANTS;
+                for (unsigned c = 0; c < 4; ++c)
+                    lanes[c][l] = in ? m_f[r][c] : 0.0f;
+            }
+            for (unsigned c = 0; c < 4; ++c)
+                raw.c[c] = LaneF::Load(lanes[c]);
+        }
+        break;
+
+    case SREG_CONSTINT:
+        for (unsigned c = 0; c < 4; ++c)
+            raw.c[c] = LaneF((float)m_i[index & 15][c]);
+        break;
+
+    case SREG_CONSTBOOL:
+        raw = Splat(LaneF(m_b[index & 15] ? 1.0f : 0.0f));
+        break;
+
+    case SREG_LOOP:
+        raw = Splat(LaneF((float)m_loop));
+        break;
+
+    default:
+        raw = Splat(LaneF(0.0f));
+        break;
+    }
+
+    Reg r;
+    for (unsigned c = 0; c < 4; ++c)
+        r.c[c] = raw.c[op.swizzle[c]];
+
+    LaneF one(1.0f), half(0.5f), two(2.0f);
+    for (unsigned c = 0; c < 4; ++c)
+    {
+        LaneF& x = r.c[c];
+        switch (op.modifier)
+        {
+        case SRCMOD_NEG:     x = -x; break;
+        case SRCMOD_BIAS:    x = x - half; break;
+        case SRCMOD_BIASNEG: x = -(x - half); break;
+        case SRCMOD_SIGN:    x = (x - half) * two; break;
+        case SRCMOD_SIGNNEG: x = -((x - half) * two); break;
+        case SRCMOD_COMP:    x = one - x; break;
+        case SRCMOD_X2:      x = x * two; break;
+        case SRCMOD_X2NEG:   x = -(x * two); break;
+        case SRCMOD_ABS:     x = Abs(x); break;
+        case SRCMOD_ABSNEG:  x = -Abs(x); break;
+        default: break;
+        }
+    }
+    if (op.modifier == SRCMOD_DZ || op.modifier == SRCMOD_DW)
+    {
+        LaneF d = r.c[op.modifier == SRCMOD_DZ ? 2 : 3];
+        r.c[0] = r.c[0] / d;
+        r.c[1] = r.c[1] / d;
+    }
+    return r;
+}
+
+// Scalar instructions read one component; with the required
+// replicate swizzle every channel holds it, otherwise .w is used.
+LaneF ShaderVM::ReadScalar(const ShaderOperand& op) const
+{
+    return ReadSource(op).c[3];
+}
+
+void ShaderVM::WriteDest(const ShaderInstruction& ins, const Reg& value, unsigned offset)
+{
+    const ShaderOperand& d = ins.dst;
+    unsigned index = d.index + offset;
+
+    Reg* pReg;
+    switch (d.type)
+    {
+    case SREG_TEMP:
+        pReg = &m_temps[index & 31];
+        break;
+    case SREG_RASTOUT:
+        pReg = &m_outputs[OUT_POSITION + (index < 3 ? index : 0)];
+        break;
+    case SREG_ATTROUT:
+        pReg = &m_outputs[OUT_COLOR0 + (index & 1)];
+        break;
+    case SREG_TEXCRDOUT:
+        pReg = &m_outputs[OUT_TEX0 + (index & 7)];
+        break;
+    case SREG_COLOROUT:
+        pReg = &m_outputs[OUT_PS_COLOR0 + (index & 3)];
+        break;
+    case SREG_DEPTHOUT:
+        pReg = &m_outputs[OUT_PS_DEPTH];
+        break;
+    default:
+        return;
+    }
+
+    for (unsigned c = 0; c < 4; ++c)
+    {
+        if (d.writeMask & (1u << c))
+            pReg->c[c] = ins.saturate ? Saturate(value.c[c]) : value.c[c];
+    }
+}
+
+//===============================================================
+// Texture sampling.  In a pixel shader the LOD comes from the
+// quad's texture coordinate differences, like on hardware.
+
+ShaderVM::Reg ShaderVM::SampleTexture(unsigned sampler, const Reg& coord, unsigned control,
+                                      const LaneF* pLod)
+{
+    Reg r;
+    SoftTexture* pTex = m_pSource && sampler < SOFT_MAX_SAMPLERS ? m_pSource->samplers[sampler] : NULL;
+    if (pTex == NULL)
+    {
+        r.c[0] = r.c[1] = r.c[2] = LaneF(0.0f);
+        r.c[3] = LaneF(1.0f);
+        return r;
+    }
+
+    LaneF u = coord.c[0], v = coord.c[1];
+    if (control & TEXLD_PROJECT)
+    {
+        u = u / coord.c[3];
+        v = v / coord.c[3];
+    }
+
+    float lod[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    if (pLod)
+    {
+        pLod->Store(lod);
+    }
+    else if (m_pixel)
+    {
+        float fu[4], fv[4];
+        u.Store(fu);
+        v.Store(fv);
+        float w = (float)pTex->Width(), h = (float)pTex->Height();
+        float dudx = (fu[1] - fu[0]) * w, dvdx = (fv[1] - fv[0]) * h;
+        float dudy = (fu[2] - fu[0]) * w, dvdy = (fv[2] - fv[0]) * h;
+        float rho2 = dudx * dudx + dvdx * dvdx;
+        float rhoY = dudy * dudy + dvdy * dvdy;
+        if (rhoY > rho2)
+            rho2 = rhoY;
+        float l = rho2 > 0.0f ? 0.5f * Log2Abs(rho2) : 0.0f;
+        if (control & TEXLD_BIAS)
+        {
+            float bias[4];
+            coord.c[3].Store(bias);
+            for (unsigned k = 0; k < 4; ++k)
+                lod[k] = l + bias[k];
+        }
+        else
+        {
+            lod[0] = lod[1] = lod[2] = lod[3] = l;
+        }
+    }
+
+    pTex->Sample(u, v, lod, r.c);
+    return r;
+}
+
+//===============================================================
+// The interpreter loop.  Flow control is static in shader model
+// 2.0 (it depends on constants only), so all lanes take the same
+// path and a single program counter is enough.
+
+void ShaderVM::Execute()
+{
+    struct LoopFrame { unsigned start; int remaining; int step; int savedLoop; };
+
+    const std::vector<ShaderInstruction>& code = m_pProgram->Code();
+    const unsigned numInstructions = (unsigned)code.size();
+
+    LoopFrame loops[8];
+    unsigned  numLoops = 0;
+    unsigned  calls[8];
+    unsigned  numCalls = 0;
+
+    for (unsigned r = 0; r < m_pProgram->NumTemps() && r < 32; ++r)
+        m_temps[r] = Splat(LaneF(0.0f));
+    m_loop = 0;
+
+    unsigned long long executed = 0;
+    unsigned pc = 0;
+    while (pc < numInstructions)
+    {
+        const ShaderInstruction& ins = code[pc];
+        ++executed;
+
+        Reg a, b, c, d;
+        switch (ins.opcode)
+        {
+        case SOP_NOP:
+            break;
+
+        case SOP_MOV:
+            WriteDest(ins, ReadSource(ins.src[0]));
+            break;
+
+        case SOP_MOVA:
+            a = ReadSource(ins.src[0]);
+            for (unsigned k = 0; k < 4; ++k)
+            {
+                if (!(ins.dst.writeMask & (1u << k)))
+                    continue;
+                float t[4];
+                PerLane(a.c[k], RoundF).Store(t);
+                for (unsigned l = 0; l < LANE_COUNT; ++l)
+                    m_addr[k][l] = (int)t[l];
+            }
+            break;
+
+        case SOP_ADD:
+        case SOP_SUB:
+        case SOP_MUL:
+        case SOP_MIN:
+        case SOP_MAX:
+        case SOP_SLT:
+        case SOP_SGE:
+            a = ReadSource(ins.src[0]);
+            b = ReadSource(ins.src[1]);
+            for (unsigned k = 0; k < 4; ++k)
+            {
+                switch (ins.opcode)
+                {
+                case SOP_ADD: d.c[k] = a.c[k] + b.c[k]; break;
+                case SOP_SUB: d.c[k] = a.c[k] - b.c[k]; break;
+                case SOP_MUL: d.c[k] = a.c[k] * b.c[k]; break;
+                case SOP_MIN: d.c[k] = Min(a.c[k], b.c[k]); break;
+                case SOP_MAX: d.c[k] = Max(a.c[k], b.c[k]); break;
+                case SOP_SLT: d.c[k] = CmpLt(a.c[k], b.c[k]); break;
+                default:      d.c[k] = CmpGe(a.c[k], b.c[k]); break;
+                }
+            }
+            WriteDest(ins, d);
+            break;
+
+        case SOP_MAD:
+            a = ReadSource(ins.src[0]);
+            b = ReadSource(ins.src[1]);
+            c = ReadSource(ins.src[2]);
+            for (unsigned k = 0; k < 4; ++k)
+                d.c[k] = MulAdd(a.c[k], b.c[k], c.c[k]);
+            WriteDest(ins, d);
+            break;
+
+        case SOP_LRP:
+            a = ReadSource(ins.src[0]);
+            b = ReadSource(ins.src[1]);
+            c = ReadSource(ins.src[2]);
+            for (unsigned k = 0; k < 4; ++k)
+                d.c[k] = MulAdd(a.c[k], b.c[k] - c.c[k], c.c[k]);
+            WriteDest(ins, d);
+            break;
+
+        case SOP_CMP:
+        case SOP_CND:
+            a = ReadSource(ins.src[0]);
+            b = ReadSource(ins.src[1]);
+            c = ReadSource(ins.src[2]);
+            for (unsigned k = 0; k < 4; ++k)
+            {
+                if (ins.opcode == SOP_CMP)
+                    d.c[k] = SelectGe0(a.c[k], b.c[k], c.c[k]);
+                else    // cnd: a > 0.5 ? b : c
+                    d.c[k] = SelectGe0(LaneF(0.5f) - a.c[k], c.c[k], b.c[k]);
+            }
+            WriteDest(ins, d);
+            break;
+
+        case SOP_RCP:
+            WriteDest(ins, Splat(LaneF(1.0f) / ReadScalar(ins.src[0])));
+            break;
+
+        case SOP_RSQ:
+            WriteDest(ins, Splat(LaneF(1.0f) / Sqrt(Abs(ReadScalar(ins.src[0])))));
+            break;
+
+        case SOP_EXP:
+        case SOP_EXPP:
+            WriteDest(ins, Splat(PerLane(ReadScalar(ins.src[0]), Exp2)));
+            break;
+
+        case SOP_LOG:
+        case SOP_LOGP:
+            WriteDest(ins, Splat(PerLane(ReadScalar(ins.src[0]), Log2Abs)));
+            break;
+
+        case SOP_POW:
+            {
+                LaneF base = PerLane(ReadScalar(ins.src[0]), Log2Abs);
+                WriteDest(ins, Splat(PerLane(base * ReadScalar(ins.src[1]), Exp2)));
+            }
+            break;
+
+        case SOP_FRC:
+            a = ReadSource(ins.src[0]);
+            for (unsigned k = 0; k < 4; ++k)
+                d.c[k] = a.c[k] - Floor(a.c[k]);
+            WriteDest(ins, d);
+            break;
+
+        case SOP_ABS:
+            a = ReadSource(ins.src[0]);
+            for (unsigned k = 0; k < 4; ++k)
+                d.c[k] = Abs(a.c[k]);
+            WriteDest(ins, d);
+            break;
+
+        case SOP_SGN:
+            a = ReadSource(ins.src[0]);
+            for (unsigned k = 0; k < 4; ++k)
+                d.c[k] = CmpLt(LaneF(0.0f), a.c[k]) - CmpLt(a.c[k], LaneF(0.0f));
+            WriteDest(ins, d);
+            break;
+
+        case SOP_DP3:
+            WriteDest(ins, Splat(Dot3(ReadSource(ins.src[0]), ReadSource(ins.src[1]))));
+            break;
+
+        case SOP_DP4:
+            WriteDest(ins, Splat(Dot4(ReadSource(ins.src[0]), ReadSource(ins.src[1]))));
+            break;
+
+        case SOP_DP2ADD:
+            a = ReadSource(ins.src[0]);
+            b = ReadSource(ins.src[1]);
+            WriteDest(ins, Splat(a.c[0] * b.c[0] + a.c[1] * b.c[1] + ReadScalar(ins.src[2])));
+            break;
+
+        case SOP_M4x4:
+        case SOP_M4x3:
+        case SOP_M3x4:
+        case SOP_M3x3:
+        case SOP_M3x2:
+            {
+                unsigned rows = ins.opcode == SOP_M4x4 || ins.opcode == SOP_M3x4 ? 4 :
+                                ins.opcode == SOP_M3x2 ? 2 : 3;
+                bool four = ins.opcode == SOP_M4x4 || ins.opcode == SOP_M4x3;
+                a = ReadSource(ins.src[0]);
+                d = Splat(LaneF(0.0f));
+                for (unsigned k = 0; k < rows; ++k)
+                {
+                    b = ReadSource(ins.src[1], k);
+                    d.c[k] = four ? Dot4(a, b) : Dot3(a, b);
+                }
+                WriteDest(ins, d);
+            }
+            break;
+
+        case SOP_CRS:
+            a = ReadSource(ins.src[0]);
+            b = ReadSource(ins.src[1]);
+            d.c[0] = a.c[1] * b.c[2] - a.c[2] * b.c[1];
+            d.c[1] = a.c[2] * b.c[0] - a.c[0] * b.c[2];
+            d.c[2] = a.c[0] * b.c[1] - a.c[1] * b.c[0];
+            d.c[3] = LaneF(0.0f);
+            WriteDest(ins, d);
+            break;
+
+        case SOP_NRM:
+            a = ReadSource(ins.src[0]);
+            {
+                LaneF inv = LaneF(1.0f) / Sqrt(Dot3(a, a));
+                for (unsigned k = 0; k < 4; ++k)
+                    d.c[k] = a.c[k] * inv;
+            }
+            WriteDest(ins, d);
+            break;
+
+        case SOP_SINCOS:
+            a = ReadSource(ins.src[0]);
+            {
+                LaneF x = a.c[3];
+                d.c[0] = PerLane(x, CosF);
+                d.c[1] = PerLane(x, SinF);
+                d.c[2] = d.c[3] = LaneF(0.0f);
+            }
+            WriteDest(ins, d);
+            break;
+
+        case SOP_LIT:
+            a = ReadSource(ins.src[0]);
+            {
+                LaneF zero(0.0f);
+                LaneF power = Min(Max(a.c[3], LaneF(-128.0f)), LaneF(128.0f));
+                LaneF spec  = PerLane(PerLane(Max(a.c[1], zero), Log2Abs) * power, Exp2);
+                d.c[0] = LaneF(1.0f);
+                d.c[1] = Max(a.c[0], zero);
+                d.c[2] = SelectGe0(-a.c[0], zero, spec);
+                d.c[3] = LaneF(1.0f);
+            }
+            WriteDest(ins, d);
+            break;
+
+        case SOP_DST:
+            a = ReadSource(ins.src[0]);
+            b = ReadSource(ins.src[1]);
+            d.c[0] = LaneF(1.0f);
+            d.c[1] = a.c[1] * b.c[1];
+            d.c[2] = a.c[2];
+            d.c[3] = b.c[3];
+            WriteDest(ins, d);
+            break;
+
+        case SOP_DSX:
+        case SOP_DSY:
+            a = ReadSource(ins.src[0]);
+            for (unsigned k = 0; k < 4; ++k)
+            {
+                float t[4];
+                a.c[k].Store(t);
+                if (ins.opcode == SOP_DSX)
+                {
+                    float d0 = t[1] - t[0], d1 = t[3] - t[2];
+                    d.c[k] = LaneF::Set(d0, d0, d1, d1);
+                }
+                else
+                {
+                    float d0 = t[2] - t[0], d1 = t[3] - t[1];
+                    d.c[k] = LaneF::Set(d0, d1, d0, d1);
+                }
+            }
+            WriteDest(ins, d);
+            break;
+
+        case SOP_TEX:
+            WriteDest(ins, SampleTexture(ins.src[1].index, ReadSource(ins.src[0]), ins.control, NULL));
+            break;
+
+        case SOP_TEXLDL:
+            a = ReadSource(ins.src[0]);
+            WriteDest(ins, SampleTexture(ins.src[1].index, a, 0, &a.c[3]));
+            break;
+
+        case SOP_TEXKILL:
+            {
+                ShaderOperand src = ins.dst;
+                src.modifier = 0;
+                src.relative = false;
+                a = ReadSource(src);
+                for (unsigned k = 0; k < 4; ++k)
+                {
+                    if (ins.dst.writeMask & (1u << k))
+                        m_killMask |= MaskLt(a.c[k], LaneF(0.0f));
+                }
+            }
+            break;
+
+        // Static flow control
+        case SOP_IF:
+            if (!m_b[ins.src[0].index & 15])
+            {
+                pc = ins.dst.index + 1;     // past else / endif
+                continue;
+            }
+            break;
+
+        case SOP_ELSE:
+            pc = ins.dst.index + 1;         // if-branch done: skip to endif
+            continue;
+
+        case SOP_ENDIF:
+            break;
+
+        case SOP_REP:
+        case SOP_LOOP:
+            {
+                const int* counter = m_i[(ins.opcode == SOP_REP ? ins.src[0] : ins.src[1]).index & 15];
+                if (counter[0] <= 0 || numLoops == 8)
+                {
+                    pc = ins.dst.index + 1;
+                    continue;
+                }
+                LoopFrame& f = loops[numLoops++];
+                f.start     = pc + 1;
+                f.remaining = counter[0];
+                f.step      = ins.opcode == SOP_LOOP ? counter[2] : 0;
+                f.savedLoop = m_loop;
+                if (ins.opcode == SOP_LOOP)
+                    m_loop = counter[1];
+            }
+            break;
+
+        case SOP_ENDREP:
+        case SOP_ENDLOOP:
+            if (numLoops)
+            {
+                LoopFrame& f = loops[numLoops - 1];
+                if (--f.remaining > 0)
+                {
+                    m_loop += f.step;
+                    pc = f.start;
+                    continue;
+                }
+                m_loop = f.savedLoop;
+                --numLoops;
+            }
+            break;
+
+        case SOP_BREAK:
+            if (numLoops)
+            {
+                m_loop = loops[numLoops - 1].savedLoop;
+                --numLoops;
+                pc = ins.dst.index + 1;
+                continue;
+            }
+            break;
+
+        case SOP_CALL:
+        case SOP_CALLNZ:
+            if (ins.opcode == SOP_CALLNZ && !m_b[ins.src[1].index & 15])
+                break;
+            if (numCalls < 8 && ins.dst.index < numInstructions)
+            {
+                calls[numCalls++] = pc + 1;
+                pc = ins.dst.index + 1;
+                continue;
+            }
+            break;
+
+        case SOP_RET:
+            if (numCalls == 0)
+            {
+                pc = numInstructions;
+                continue;
+            }
+            pc = calls[--numCalls];
+            continue;
+
+        case SOP_LABEL:
+            // Subroutines follow the main program.
+            pc = numInstructions;
+            continue;
+        }
+
+        ++pc;
+    }
+
+    ++m_stats.invocations;
+    m_stats.instructions += executed;
+}
@@ -0,0 +1,294 @@
+//=============================================================================
+// SoftShader.h
+//
+// CPU execution of D3D9 shader model 2.0 bytecode (vs_2_0 / ps_2_0, plus
+// the static flow control and the few vs_2_x/ps_2_x instructions fxc emits
+// for them).  The input is the compiled token stream, exactly as D3DX hands
+// it out in D3DXPASS_DESC::pVertexShaderFunction / pPixelShaderFunction or
+// as fxc writes it with /Fo, so effects can be run without a device.
+//
+// ShaderProgram decodes and validates the tokens once.  ShaderVM then runs
+// it on LANE_COUNT invocations at a time in structure-of-arrays form: one
+// register component holds that component for four vertices, or for the
+// four pixels of a 2x2 quad (which also gives dsx/dsy and texture LOD).
+//
+// Constant names come from the CTAB comment block that fxc embeds, so
+// SetMatrix(program, "gWVP", ...) works like ID3DXConstantTable.
+//=============================================================================
+
+#ifndef SOFT_SHADER_H
+#define SOFT_SHADER_H
+
+#include <string>
+#include <vector>
+#include "SoftLanes.h"
+
+
+//===============================================================
+// Token stream encoding (d3d9types.h D3DSIO_* / D3DSPR_*, renamed so
+// this header does not depend on the DirectX SDK).
+
+enum ShaderOpcode
+{
+    SOP_NOP = 0,  SOP_MOV,  SOP_ADD,  SOP_SUB,  SOP_MAD,  SOP_MUL,  SOP_RCP,  SOP_RSQ,
+    SOP_DP3,      SOP_DP4,  SOP_MIN,  SOP_MAX,  SOP_SLT,  SOP_SGE,  SOP_EXP,  SOP_LOG,
+    SOP_LIT,      SOP_DST,  SOP_LRP,  SOP_FRC,  SOP_M4x4, SOP_M4x3, SOP_M3x4, SOP_M3x3,
+    SOP_M3x2,     SOP_CALL, SOP_CALLNZ, SOP_LOOP, SOP_RET, SOP_ENDLOOP, SOP_LABEL, SOP_DCL,
+    SOP_POW,      SOP_CRS,  SOP_SGN,  SOP_ABS,  SOP_NRM,  SOP_SINCOS, SOP_REP, SOP_ENDREP,
+    SOP_IF,       SOP_IFC,  SOP_ELSE, SOP_ENDIF, SOP_BREAK, SOP_BREAKC, SOP_MOVA, SOP_DEFB,
+    SOP_DEFI,
+
+    SOP_TEXKILL = 65, SOP_TEX = 66,
+    SOP_EXPP    = 78, SOP_LOGP = 79, SOP_CND = 80, SOP_DEF = 81,
+    SOP_CMP     = 88, SOP_DP2ADD = 90, SOP_DSX = 91, SOP_DSY = 92,
+    SOP_TEXLDL  = 95,
+
+    SOP_PHASE   = 0xFFFD, SOP_COMMENT = 0xFFFE, SOP_END = 0xFFFF
+};
+
+enum ShaderRegisterType
+{
+    SREG_TEMP = 0, SREG_INPUT = 1, SREG_CONST = 2, SREG_ADDR = 3,    // ADDR = TEXTURE in ps
+    SREG_RASTOUT = 4, SREG_ATTROUT = 5, SREG_TEXCRDOUT = 6, SREG_CONSTINT = 7,
+    SREG_COLOROUT = 8, SREG_DEPTHOUT = 9, SREG_SAMPLER = 10, SREG_CONSTBOOL = 14,
+    SREG_LOOP = 15, SREG_MISCTYPE = 17, SREG_LABEL = 18, SREG_PREDICATE = 19
+};
+
+// Declaration usages (D3DDECLUSAGE)
+enum ShaderUsage
+{
+    SUSAGE_POSITION = 0, SUSAGE_BLENDWEIGHT, SUSAGE_BLENDINDICES, SUSAGE_NORMAL,
+    SUSAGE_PSIZE, SUSAGE_TEXCOORD, SUSAGE_TANGENT, SUSAGE_BINORMAL, SUSAGE_TESSFACTOR,
+    SUSAGE_POSITIONT, SUSAGE_COLOR, SUSAGE_FOG, SUSAGE_DEPTH, SUSAGE_SAMPLE
+};
+
+
+//===============================================================
+// Decoded program
+
+struct ShaderOperand
+{
+    unsigned      type;         // ShaderRegisterType
+    unsigned      index;
+    unsigned      writeMask;    // destination: bit per component
+    unsigned char swizzle[4];   // source: component per channel
+    unsigned      modifier;     // source modifier
+    bool          relative;     // source indexed by a0 / aL
+    unsigned      relType;
+    unsigned      relComponent;
+};
+
+struct ShaderInstruction
+{
+    unsigned      opcode;
+    unsigned      control;      // comparison for ifc/breakc, texld flavour
+    bool          saturate;
+    unsigned      numSources;
+    ShaderOperand dst;
+    ShaderOperand src[4];
+};
+
+struct ShaderDeclaration
+{
+    unsigned type;              // register type
+    unsigned index;
+    unsigned usage;             // ShaderUsage (vs inputs)
+    unsigned usageIndex;
+    unsigned textureType;       // sampler declarations
+};
+
+struct ShaderConstantInfo
+{
+    std::string name;
+    unsigned    registerSet;    // 0 bool, 1 int4, 2 float4, 3 sampler
+    unsigned    registerIndex;
+    unsigned    registerCount;
+    unsigned    parameterClass; // 2 matrix rows, 3 matrix columns
+    unsigned    rows;
+    unsigned    columns;
+};
+
+class ShaderProgram
+{
+public:
+    ShaderProgram();
+
+    // Decodes a token stream.  maxBytes bounds the reads (the stream ends
+    // at its END token).  Unsupported instructions fail the load.
+    bool Load(const void* pFunction, size_t maxBytes, std::string* pError = NULL);
+    void Clear();
+
+    bool     IsLoaded() const      { return !m_code.empty(); }
+    bool     IsPixelShader() const { return m_pixelShader; }
+    unsigned Version() const       { return m_version; }    // 0x0200 for x_2_0
+
+    const std::vector<ShaderInstruction>& Code() const { return m_code; }
+    const std::vector<ShaderDeclaration>& Declarations() const { return m_decls; }
+
+    // Constants defined in the program (def/defi/defb) override the
+    // values set by the application, like on a device.
+    struct FloatDef { unsigned index; float value[4]; };
+    struct IntDef   { unsigned index; int value[4]; };
+    struct BoolDef  { unsigned index; bool value; };
+    const std::vector<FloatDef>& FloatDefs() const { return m_floatDefs; }
+    const std::vector<IntDef>&   IntDefs() const   { return m_intDefs; }
+    const std::vector<BoolDef>&  BoolDefs() const  { return m_boolDefs; }
+
+    const ShaderConstantInfo* FindConstant(const char* name) const;
+    const std::vector<ShaderConstantInfo>& Constants() const { return m_constants; }
+
+    // Input register declared with usage/index, or -1.
+    int FindInput(unsigned usage, unsigned usageIndex) const;
+
+    // Bit per output or input register class actually used (see
+    // ShaderVaryings).  Lets the rasterizer skip unused interpolants.
+    unsigned VaryingMask() const { return m_varyingMask; }
+
+    unsigned NumTemps() const { return m_numTemps; }
+    bool     WritesDepth() const { return m_writesDepth; }
+
+private:
+    bool DecodeInstruction(const unsigned*& p, const unsigned* end, std::string& error);
+    bool DecodeComment(const unsigned* p, unsigned numTokens);
+    void Finish();
+
+    bool                            m_pixelShader;
+    unsigned                        m_version;
+    unsigned                        m_varyingMask;
+    unsigned                        m_numTemps;
+    bool                            m_writesDepth;
+    std::vector<ShaderInstruction>  m_code;
+    std::vector<ShaderDeclaration>  m_decls;
+    std::vector<FloatDef>           m_floatDefs;
+    std::vector<IntDef>             m_intDefs;
+    std::vector<BoolDef>            m_boolDefs;
+    std::vector<ShaderConstantInfo> m_constants;
+};
+
+
+//===============================================================
+// Application-set constants for one shader stage.
+
+const unsigned SOFT_MAX_FLOAT_CONSTANTS = 256;
+const unsigned SOFT_MAX_INT_CONSTANTS   = 16;
+const unsigned SOFT_MAX_BOOL_CONSTANTS  = 16;
+const unsigned SOFT_MAX_SAMPLERS        = 16;
+
+class SoftTexture;
+
+struct ShaderConstants
+{
+    float        f[SOFT_MAX_FLOAT_CONSTANTS][4];
+    int          i[SOFT_MAX_INT_CONSTANTS][4];
+    bool         b[SOFT_MAX_BOOL_CONSTANTS];
+    SoftTexture* samplers[SOFT_MAX_SAMPLERS];
+
+    ShaderConstants();
+
+    void SetFloat4(unsigned reg, const float* v, unsigned count = 1);
+
+    // Sets a named constant.  Matrices are given row-major (as D3DXMATRIX)
+    // and transposed if the program packs them by columns, as fxc does by
+    // default.  Return false if the program has no such constant.
+    bool SetMatrix(const ShaderProgram& program, const char* name, const float* m);
+    bool SetVector(const ShaderProgram& program, const char* name, const float* v);
+    bool SetFloatArray(const ShaderProgram& program, const char* name, const float* v, unsigned count);
+    bool SetTexture(const ShaderProgram& program, const char* name, SoftTexture* pTexture);
+};
+
+
+//===============================================================
+// Varyings passed from vertex to pixel shader, by register class.
+
+enum ShaderVaryings
+{
+    VARYING_COLOR0 = 0,         // oD0 -> v0
+    VARYING_COLOR1,             // oD1 -> v1
+    VARYING_TEX0,               // oTn -> tn
+    VARYING_FOG = VARYING_TEX0 + 8,
+    VARYING_COUNT
+};
+
+
+//===============================================================
+// One register component across the lanes.
+
+struct LaneVec
+{
+    LaneF c[4];
+};
+
+// Vertex shader inputs/outputs for one batch of LANE_COUNT vertices.
+struct VertexLanes
+{
+    LaneVec  inputs[16];            // v0..v15
+    LaneVec  position;              // oPos
+    LaneF    pointSize;             // oPts
+    LaneVec  varyings[VARYING_COUNT];
+};
+
+// Pixel shader inputs/outputs for one 2x2 quad.  Lane order is
+// (x,y) (x+1,y) (x,y+1) (x+1,y+1).
+struct QuadLanes
+{
+    LaneVec  varyings[VARYING_COUNT];
+    LaneVec  colors[4];             // oC0..oC3
+    LaneF    depth;                 // oDepth, if the program writes it
+    unsigned killMask;              // lanes removed by texkill
+};
+
+
+//===============================================================
+// Interpreter.  One VM per thread; it keeps the register file and
+// the merged constants of the program it was last bound to.
+
+struct ShaderStats
+{
+    unsigned long long invocations;     // batches / quads
+    unsigned long long instructions;    // executed per batch or quad
+};
+
+class ShaderVM
+{
+public:
+    ShaderVM();
+
+    // Binds a program and the constants to run it with.  Must be called
+    // again when either changes.
+    void Bind(const ShaderProgram* pProgram, const ShaderConstants* pConstants);
+
+    void RunVertices(VertexLanes& lanes);
+    void RunQuad(QuadLanes& quad);
+
+    const ShaderStats& Stats() const { return m_stats; }
+    void ResetStats();
+
+private:
+    typedef LaneVec Reg;
+
+    void Execute();
+    Reg  ReadSource(const ShaderOperand& op, unsigned offset = 0) const;
+    void WriteDest(const ShaderInstruction& ins, const Reg& value, unsigned offset = 0);
+    LaneF ReadScalar(const ShaderOperand& op) const;
+    Reg  SampleTexture(unsigned sampler, const Reg& coord, unsigned control, const LaneF* pLodBias);
+
+    const ShaderProgram*   m_pProgram;
+    const ShaderConstants* m_pSource;
+
+    float    m_f[SOFT_MAX_FLOAT_CONSTANTS][4];
+    int      m_i[SOFT_MAX_INT_CONSTANTS][4];
+    bool     m_b[SOFT_MAX_BOOL_CONSTANTS];
+
+    Reg      m_temps[32];
+    Reg      m_outputs[16];         // OUT_* slots, see SoftShader.cpp
+    const LaneVec* m_pInputs;
+    const LaneVec* m_pTexCoords;
+    int      m_addr[4][4];          // a0 per component, per lane
+    int      m_loop;                // aL (uniform)
+    unsigned m_killMask;
+    bool     m_pixel;
+
+    ShaderStats m_stats;
+};
+
+#endif // SOFT_SHADER_H
@@ -0,0 +1,260 @@
+//=============================================================================
+// SoftTexture.cpp
+//=============================================================================
+
+#include "SoftTexture.h"
+#include <cstring>
+#include <cmath>
+
+
+namespace
+{
+    unsigned ReadU16(const unsigned char* p) { return p[0] | (p[1] << 8); }
+    unsigned ReadU32(const unsigned char* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned)p[3] << 24); }
+
+    unsigned Average4(unsigned a, unsigned b, unsigned c, unsigned d)
+    {
+        unsigned r = 0;
+        for (unsigned shift = 0; shift < 32; shift += 8)
+        {
+            unsigned s = ((a >> shift) & 0xFF) + ((b >> shift) & 0xFF) +
+                         ((c >> shift) & 0xFF) + ((d >> shift) & 0xFF);
+            r |= ((s + 2) / 4) << shift;
+        }
+        return r;
+    }
+}
+
+
+SoftTexture::SoftTexture()
+    : m_filter(SOFT_FILTER_LINEAR), m_mipFilter(SOFT_FILTER_POINT), m_address(SOFT_ADDRESS_WRAP)
+{
+}
+
+bool SoftTexture::Create(unsigned width, unsigned height, const unsigned* texels, bool generateMips)
+{
+    m_levels.clear();
+    if (width == 0 || height == 0 || texels == NULL)
+        return false;
+
+    Level top;
+    top.width  = width;
+    top.height = height;
+    top.texels.assign(texels, texels + width * height);
+    m_levels.push_back(top);
+
+    if (generateMips)
+        BuildMips();
+    return true;
+}
+
+//===============================================================
+// BITMAPFILEHEADER (14 bytes) + BITMAPINFOHEADER; BI_RGB only.
+
+bool SoftTexture::LoadBmp(const void* pData, size_t size, bool generateMips)
+{
+    const unsigned char* p = (const unsigned char*)pData;
+    if (size < 54 || p[0] != 'B' || p[1] != 'M')
+        return false;
+
+    unsigned bitsOffset  = ReadU32(p + 10);
+    unsigned headerSize  = ReadU32(p + 14);
+    int      width       = (int)ReadU32(p + 18);
+    int      height      = (int)ReadU32(p + 22);
+    unsigned bpp         = ReadU16(p + 28);
+    unsigned compression = ReadU32(p + 30);
+    unsigned numColors   = ReadU32(p + 46);
+
+    bool topDown = height < 0;
+    if (topDown)
+        height = -height;
+
+    if (width <= 0 || height <= 0 || compression != 0 || (bpp != 8 && bpp != 24 && bpp != 32))
+        return false;
+
+    size_t pitch = ((size_t)width * bpp / 8 + 3) & ~(size_t)3;
+    if (bitsOffset > size || pitch * height > size - bitsOffset)
+        return false;
+
+    const unsigned char* palette = p + 14 + headerSize;
+    if (bpp == 8)
+    {
+        if (numColors == 0)
+            numColors = 256;
+        if (palette + numColors * 4 > p + size)
+            return false;
+    }
+
+    std::vector<unsigned> texels((size_t)width * height);
+    for (int y = 0; y < height; ++y)
+    {
+        const unsigned char* row = p + bitsOffset + pitch * (topDown ? y : height - 1 - y);
+        unsigned* out = &texels[(size_t)y * width];
+        for (int x = 0; x < width; ++x)
+        {
+            switch (bpp)
+            {
+            case 8:
+                {
+                    unsigned i = row[x] < numColors ? row[x] : 0;
+                    const unsigned char* c = palette + i * 4;
+                    out[x] = 0xFF000000 | (c[2] << 16) | (c[1] << 8) | c[0];
+                }
+                break;
+            case 24:
+                out[x] = 0xFF000000 | (row[3 * x + 2] << 16) | (row[3 * x + 1] << 8) | row[3 * x];
+                break;
+            default:
+                out[x] = ReadU32(row + 4 * x) | 0xFF000000;
+                break;
+            }
+        }
+    }
+
+    return Create((unsigned)width, (unsigned)height, &texels[0], generateMips);
+}
+
+void SoftTexture::SetSampler(SoftFilter filter, SoftFilter mipFilter, SoftAddress address)
+{
+    m_filter    = filter;
+    m_mipFilter = mipFilter;
+    m_address   = address;
+}
+
+// Box filter, like D3DX_FILTER_BOX for power-of-two sizes.
+void SoftTexture::BuildMips()
+{
+    while (m_levels.back().width > 1 || m_levels.back().height > 1)
+    {
+        const Level& src = m_levels.back();
+        Level dst;
+        dst.width  = src.width > 1 ? src.width / 2 : 1;
+        dst.height = src.height > 1 ? src.height / 2 : 1;
+        dst.texels.resize(dst.width * dst.height);
+
+        for (unsigned y = 0; y < dst.height; ++y)
+        {
+            unsigned y0 = y * 2 < src.height ? y * 2 : src.height - 1;
+            unsigned y1 = y0 + 1 < src.height ? y0 + 1 : y0;
+            for (unsigned x = 0; x < dst.width; ++x)
+            {
+                unsigned x0 = x * 2 < src.width ? x * 2 : src.width - 1;
+                unsigned x1 = x0 + 1 < src.width ? x0 + 1 : x0;
+                dst.texels[y * dst.width + x] =
+                    Average4(src.texels[y0 * src.width + x0], src.texels[y0 * src.width + x1],
+                             src.texels[y1 * src.width + x0], src.texels[y1 * src.width + x1]);
+            }
+        }
+        m_levels.push_back(dst);
+    }
+}
+
+int SoftTexture::Address(int i, int size) const
+{
+    switch (m_address)
+    {
+    case SOFT_ADDRESS_CLAMP:
+        return i < 0 ? 0 : (i >= size ? size - 1 : i);
+    case SOFT_ADDRESS_MIRROR:
+        {
+            int period = 2 * size;
+            int m = i % period;
+            if (m < 0)
+                m += period;
+            return m < size ? m : period - 1 - m;
+        }
+    default:
+        {
+            int m = i % size;
+            return m < 0 ? m + size : m;
+        }
+    }
+}
+
+void SoftTexture::Fetch(const Level& l, int x, int y, float out[4]) const
+{
+    unsigned t = l.texels[Address(y, (int)l.height) * l.width + Address(x, (int)l.width)];
+    out[0] = ((t >> 16) & 0xFF) * (1.0f / 255.0f);
+    out[1] = ((t >> 8) & 0xFF) * (1.0f / 255.0f);
+    out[2] = (t & 0xFF) * (1.0f / 255.0f);
+    out[3] = (t >> 24) * (1.0f / 255.0f);
+}
+
+void SoftTexture::SampleLevel(unsigned level, float u, float v, bool linear, float out[4]) const
+{
+    const Level& l = m_levels[level];
+    float x = u * l.width;
+    float y = v * l.height;
+
+    if (!linear)
+    {
+        Fetch(l, (int)floorf(x), (int)floorf(y), out);
+        return;
+    }
+
+    x -= 0.5f;
+    y -= 0.5f;
+    float fx0 = floorf(x), fy0 = floorf(y);
+    float ax = x - fx0, ay = y - fy0;
+    int   x0 = (int)fx0, y0 = (int)fy0;
+
+    float t00[4], t10[4], t01[4], t11[4];
+    Fetch(l, x0, y0, t00);
+    Fetch(l, x0 + 1, y0, t10);
+    Fetch(l, x0, y0 + 1, t01);
+    Fetch(l, x0 + 1, y0 + 1, t11);
+    for (unsigned c = 0; c < 4; ++c)
+    {
+        float top    = t00[c] + (t10[c] - t00[c]) * ax;
+        float bottom = t01[c] + (t11[c] - t01[c]) * ax;
+        out[c] = top + (bottom - top) * ay;
+    }
+}
+
+void SoftTexture::Sample(LaneF u, LaneF v, const float lod[4], LaneF rgba[4]) const
+{
+    if (m_levels.empty())
+    {
+        rgba[0] = rgba[1] = rgba[2] = LaneF(0.0f);
+        rgba[3] = LaneF(1.0f);
+        return;
+    }
+
+    float fu[4], fv[4], out[4][4];
+    u.Store(fu);
+    v.Store(fv);
+
+    const float maxLevel = (float)(m_levels.size() - 1);
+    for (unsigned l = 0; l < LANE_COUNT; ++l)
+    {
+        // D3D picks the magnification filter for lod <= 0; the
+        // samples use the same filter for both.
+        bool  linear = m_filter == SOFT_FILTER_LINEAR;
+        float level  = lod[l] > 0.0f ? lod[l] : 0.0f;     // NaN -> 0
+        if (level > maxLevel)
+            level = maxLevel;
+
+        if (m_mipFilter == SOFT_FILTER_NONE)
+        {
+            SampleLevel(0, fu[l], fv[l], linear, out[l]);
+        }
+        else if (m_mipFilter == SOFT_FILTER_POINT)
+        {
+            SampleLevel((unsigned)(level + 0.5f), fu[l], fv[l], linear, out[l]);
+        }
+        else
+        {
+            unsigned l0 = (unsigned)level;
+            unsigned l1 = l0 + 1 <= (unsigned)maxLevel ? l0 + 1 : l0;
+            float    a  = level - (float)l0;
+            float    s0[4], s1[4];
+            SampleLevel(l0, fu[l], fv[l], linear, s0);
+            SampleLevel(l1, fu[l], fv[l], linear, s1);
+            for (unsigned c = 0; c < 4; ++c)
+                out[l][c] = s0[c] + (s1[c] - s0[c]) * a;
+        }
+    }
+
+    for (unsigned c = 0; c < 4; ++c)
+        rgba[c] = LaneF::Set(out[0][c], out[1][c], out[2][c], out[3][c]);
+}
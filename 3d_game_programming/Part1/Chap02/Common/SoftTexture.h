@@ -0,0 +1,62 @@
+//=============================================================================
+// SoftTexture.h
+//
+// 2D texture for the software shader engine: an A8R8G8B8 mip chain with
+// point or bilinear filtering, nearest or linear mip selection and wrap,
+// clamp or mirror addressing (the D3DSAMP_* states the samples use).
+//
+// LoadBmp() reads the uncompressed 8/24/32-bit BMPs the samples ship, so
+// textured scenes can be rendered without D3DX.
+//=============================================================================
+
+#ifndef SOFT_TEXTURE_H
+#define SOFT_TEXTURE_H
+
+#include <vector>
+#include <cstddef>
+#include "SoftLanes.h"
+
+
+enum SoftFilter  { SOFT_FILTER_NONE, SOFT_FILTER_POINT, SOFT_FILTER_LINEAR };
+enum SoftAddress { SOFT_ADDRESS_WRAP, SOFT_ADDRESS_MIRROR, SOFT_ADDRESS_CLAMP };
+
+class SoftTexture
+{
+public:
+    SoftTexture();
+
+    // texels are width*height A8R8G8B8 values, top row first.
+    bool Create(unsigned width, unsigned height, const unsigned* texels, bool generateMips);
+    bool LoadBmp(const void* pData, size_t size, bool generateMips);
+
+    // mipFilter NONE uses the top level only.
+    void SetSampler(SoftFilter filter, SoftFilter mipFilter, SoftAddress address);
+
+    unsigned Width() const  { return m_levels.empty() ? 0 : m_levels[0].width; }
+    unsigned Height() const { return m_levels.empty() ? 0 : m_levels[0].height; }
+    unsigned Levels() const { return (unsigned)m_levels.size(); }
+    const unsigned* Texels(unsigned level) const { return &m_levels[level].texels[0]; }
+
+    // Samples four coordinates; rgba receives r, g, b, a in [0, 1].
+    void Sample(LaneF u, LaneF v, const float lod[4], LaneF rgba[4]) const;
+
+private:
+    struct Level
+    {
+        unsigned              width;
+        unsigned              height;
+        std::vector<unsigned> texels;
+    };
+
+    void  BuildMips();
+    int   Address(int i, int size) const;
+    void  SampleLevel(unsigned level, float u, float v, bool linear, float out[4]) const;
+    void  Fetch(const Level& l, int x, int y, float out[4]) const;
+
+    std::vector<Level> m_levels;
+    SoftFilter         m_filter;
+    SoftFilter         m_mipFilter;
+    SoftAddress        m_address;
+};
+
+#endif // SOFT_TEXTURE_H
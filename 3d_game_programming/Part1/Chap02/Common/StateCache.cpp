@@ -0,0 +1,705 @@
+//=============================================================================
+// StateCache.cpp
+//=============================================================================
+
+#include "StateCache.h"
+#include "DeviceCapture.h"
+#include "FrameStats.h"
+#include <cstdio>
+#include <cstring>
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define snprintf _snprintf
+#endif
+
+
+StateCache g_stateCache;
+
+
+//===============================================================
+// Shader constant ranges
+
+// Forgets the shadow of registers [first, first + count).
+template<typename T>
+static void ForgetConstants(unsigned char* valid, UINT capacity, UINT first, UINT count)
+{
+    for (UINT r = first; r < capacity && r - first < count; ++r)
+        valid[r] = 0;
+}
+
+// Compares count registers of width elements starting at first with the
+// shadow, stores the new values and trims [first, first + count) to the
+// registers that actually changed.  Returns false if none did.
+template<typename T>
+static bool UpdateConstants(T* shadow, unsigned char* valid, UINT capacity, UINT width,
+                            UINT& first, const T*& pData, UINT& count)
+{
+    if (first >= capacity || count > capacity - first)
+    {
+        // Not shadowed: forget whatever part overlaps and forward as is.
+        ForgetConstants<T>(valid, capacity, first, count);
+        return true;
+    }
+
+    const size_t bytes = width * sizeof(T);
+
+    UINT begin = 0;
+    while (begin < count && valid[first + begin] &&
+           memcmp(shadow + (first + begin) * width, pData + begin * width, bytes) == 0)
+        ++begin;
+    if (begin == count)
+        return false;
+
+    UINT end = count;
+    while (end > begin + 1 && valid[first + end - 1] &&
+           memcmp(shadow + (first + end - 1) * width, pData + (end - 1) * width, bytes) == 0)
+        --end;
+
+    memcpy(shadow + (first + begin) * width, pData + begin * width, (end - begin) * bytes);
+    memset(valid + first + begin, 1, end - begin);
+
+    first += begin;
+    pData += begin * width;
+    count  = end - begin;
+    return true;
+}
+
+
+//===============================================================
+// StateCache
+
+StateCache::StateCache()
+    : m_pDevice(NULL)
+{
+    Invalidate();
+    ResetStats();
+}
+
+void StateCache::Attach(IDirect3DDevice9* pDevice)
+{
+    m_pDevice = pDevice;
+    Invalidate();
+}
+
+void StateCache::Detach()
+{
+    m_pDevice = NULL;
+    Invalidate();
+}
+
+void StateCache::Invalidate()
+{
+    memset(m_renderValid, 0, sizeof(m_renderValid));
+    memset(m_samplerValid, 0, sizeof(m_samplerValid));
+    memset(m_stageValid, 0, sizeof(m_stageValid));
+    memset(m_textureValid, 0, sizeof(m_textureValid));
+    memset(m_streamValid, 0, sizeof(m_streamValid));
+    memset(m_streamFreqValid, 0, sizeof(m_streamFreqValid));
+    memset(m_transformValid, 0, sizeof(m_transformValid));
+    memset(m_clipPlaneValid, 0, sizeof(m_clipPlaneValid));
+    memset(m_vsConstants.fValid, 0, sizeof(m_vsConstants.fValid));
+    memset(m_vsConstants.iValid, 0, sizeof(m_vsConstants.iValid));
+    memset(m_vsConstants.bValid, 0, sizeof(m_vsConstants.bValid));
+    memset(m_psConstants.fValid, 0, sizeof(m_psConstants.fValid));
+    memset(m_psConstants.iValid, 0, sizeof(m_psConstants.iValid));
+    memset(m_psConstants.bValid, 0, sizeof(m_psConstants.bValid));
+
+    m_indicesValid  = false;
+    m_fvfValid      = false;
+    m_declValid     = false;
+    m_vsValid       = false;
+    m_psValid       = false;
+    m_materialValid = false;
+    m_viewportValid = false;
+    m_scissorValid  = false;
+    m_nPatchValid   = false;
+
+    m_lights.clear();
+    m_lightValid.clear();
+    m_lightEnabled.clear();
+}
+
+void StateCache::InvalidateVertexInput()
+{
+    memset(m_streamValid, 0, sizeof(m_streamValid));
+    m_indicesValid = false;
+    m_fvfValid     = false;
+    m_declValid    = false;
+}
+
+int StateCache::SamplerSlot(DWORD sampler)
+{
+    if (sampler < 16)
+        return (int)sampler;
+    // D3DDMAPSAMPLER and D3DVERTEXTEXTURESAMPLER0..3
+    if (sampler >= 256 && sampler <= 260)
+        return (int)(16 + sampler - 256);
+    return -1;
+}
+
+int StateCache::TransformSlot(D3DTRANSFORMSTATETYPE state)
+{
+    // D3DTS_VIEW .. D3DTS_TEXTURE7
+    if ((unsigned)state < 24)
+        return (int)state;
+    // D3DTS_WORLDMATRIX(0) .. D3DTS_WORLDMATRIX(3); higher world matrices
+    // (indexed vertex blending) are not shadowed.
+    if ((unsigned)state >= 256 && (unsigned)state < 260)
+        return (int)(24 + state - 256);
+    return -1;
+}
+
+
+//===============================================================
+// Render, sampler and texture stage states
+
+HRESULT StateCache::SetRenderState(D3DRENDERSTATETYPE state, DWORD value)
+{
+    unsigned i = (unsigned)state;
+    if (i >= MAX_RENDER_STATES)
+    {
+        Forward(STATE_RENDER, true);
+        if (g_capture.IsRecording())
+            g_capture.SetRenderState(state, value);
+        return m_pDevice->SetRenderState(state, value);
+    }
+
+    if (!Forward(STATE_RENDER, !m_renderValid[i] || m_renderStates[i] != value))
+        return D3D_OK;
+
+    if (g_capture.IsRecording())
+        g_capture.SetRenderState(state, value);
+    HRESULT hr = m_pDevice->SetRenderState(state, value);
+    m_renderStates[i] = value;
+    m_renderValid[i]  = SUCCEEDED(hr);
+    return hr;
+}
+
+HRESULT StateCache::SetSamplerState(DWORD sampler, D3DSAMPLERSTATETYPE type, DWORD value)
+{
+    int s = SamplerSlot(sampler);
+    unsigned t = (unsigned)type;
+    if (s < 0 || t >= MAX_SAMPLER_STATES)
+    {
+        Forward(STATE_SAMPLER, true);
+        if (g_capture.IsRecording())
+            g_capture.SetSamplerState(sampler, type, value);
+        return m_pDevice->SetSamplerState(sampler, type, value);
+    }
+
+    if (!Forward(STATE_SAMPLER, !m_samplerValid[s][t] || m_samplerStates[s][t] != value))
+        return D3D_OK;
+
+    if (g_capture.IsRecording())
+        g_capture.SetSamplerState(sampler, type, value);
+    HRESULT hr = m_pDevice->SetSamplerState(sampler, type, value);
+    m_samplerStates[s][t] = value;
+    m_samplerValid[s][t]  = SUCCEEDED(hr);
+    return hr;
+}
+
+HRESULT StateCache::SetTextureStageState(DWORD stage, D3DTEXTURESTAGESTATETYPE type, DWORD value)
+{
+    unsigned t = (unsigned)type;
+    if (stage >= MAX_TEXTURE_STAGES || t >= MAX_TEXTURE_STAGE_STATES)
+    {
+        Forward(STATE_TEXTURE_STAGE, true);
+        if (g_capture.IsRecording())
+            g_capture.SetTextureStageState(stage, type, value);
+        return m_pDevice->SetTextureStageState(stage, type, value);
+    }
+
+    if (!Forward(STATE_TEXTURE_STAGE, !m_stageValid[stage][t] || m_stageStates[stage][t] != value))
+        return D3D_OK;
+
+    if (g_capture.IsRecording())
+        g_capture.SetTextureStageState(stage, type, value);
+    HRESULT hr = m_pDevice->SetTextureStageState(stage, type, value);
+    m_stageStates[stage][t] = value;
+    m_stageValid[stage][t]  = SUCCEEDED(hr);
+    return hr;
+}
+
+unsigned StateCache::ApplyRenderStates(const RenderStateValue* pStates, unsigned count)
+{
+    unsigned before = m_stats.forwarded[STATE_RENDER];
+    for (unsigned i = 0; i < count; ++i)
+        SetRenderState(pStates[i].state, pStates[i].value);
+    return m_stats.forwarded[STATE_RENDER] - before;
+}
+
+unsigned StateCache::ApplySamplerStates(DWORD sampler, const SamplerStateValue* pStates, unsigned count)
+{
+    unsigned before = m_stats.forwarded[STATE_SAMPLER];
+    for (unsigned i = 0; i < count; ++i)
+        SetSamplerState(sampler, pStates[i].state, pStates[i].value);
+    return m_stats.forwarded[STATE_SAMPLER] - before;
+}
+
+unsigned StateCache::ApplyTextureStageStates(DWORD stage, const TextureStageStateValue* pStates,
+                                             unsigned count)
+{
+    unsigned before = m_stats.forwarded[STATE_TEXTURE_STAGE];
+    for (unsigned i = 0; i < count; ++i)
+        SetTextureStageState(stage, pStates[i].state, pStates[i].value);
+    return m_stats.forwarded[STATE_TEXTURE_STAGE] - before;
+}
+
+bool StateCache::GetRenderState(D3DRENDERSTATETYPE state, DWORD* pValue) const
+{
+    unsigned i = (unsigned)state;
+    if (i >= MAX_RENDER_STATES || !m_renderValid[i])
+        return false;
+    *pValue = m_renderStates[i];
+    return true;
+}
+
+
+//===============================================================
+// Resources bound for drawing
+
+HRESULT StateCache::SetTexture(DWORD sampler, IDirect3DBaseTexture9* pTexture)
+{
+    int s = SamplerSlot(sampler);
+    if (s < 0)
+    {
+        Forward(STATE_TEXTURE, true);
+        if (g_capture.IsRecording())
+            g_capture.SetTexture(sampler, pTexture);
+        return m_pDevice->SetTexture(sampler, pTexture);
+    }
+
+    if (!Forward(STATE_TEXTURE, !m_textureValid[s] || m_textures[s] != pTexture))
+        return D3D_OK;
+
+    if (g_capture.IsRecording())
+        g_capture.SetTexture(sampler, pTexture);
+    HRESULT hr = m_pDevice->SetTexture(sampler, pTexture);
+    m_textures[s]     = pTexture;
+    m_textureValid[s] = SUCCEEDED(hr);
+    return hr;
+}
+
+bool StateCache::GetTexture(DWORD sampler, IDirect3DBaseTexture9** ppTexture) const
+{
+    int s = SamplerSlot(sampler);
+    if (s < 0 || !m_textureValid[s])
+        return false;
+    *ppTexture = m_textures[s];
+    return true;
+}
+
+HRESULT StateCache::SetStreamSource(UINT stream, IDirect3DVertexBuffer9* pVB, UINT offset, UINT stride)
+{
+    if (stream >= MAX_STREAMS)
+    {
+        Forward(STATE_STREAM, true);
+        if (g_capture.IsRecording())
+            g_capture.SetStreamSource(stream, pVB, offset, stride);
+        return m_pDevice->SetStreamSource(stream, pVB, offset, stride);
+    }
+
+    Stream& s = m_streams[stream];
+    bool changed = !m_streamValid[stream] || s.pVB != pVB || s.offset != offset || s.stride != stride;
+    if (!Forward(STATE_STREAM, changed))
+        return D3D_OK;
+
+    if (g_capture.IsRecording())
+        g_capture.SetStreamSource(stream, pVB, offset, stride);
+    HRESULT hr = m_pDevice->SetStreamSource(stream, pVB, offset, stride);
+    s.pVB    = pVB;
+    s.offset = offset;
+    s.stride = stride;
+    m_streamValid[stream] = SUCCEEDED(hr);
+    return hr;
+}
+
+HRESULT StateCache::SetStreamSourceFreq(UINT stream, UINT setting)
+{
+    if (stream >= MAX_STREAMS)
+    {
+        Forward(STATE_STREAM, true);
+        if (g_capture.IsRecording())
+            g_capture.SetStreamSourceFreq(stream, setting);
+        return m_pDevice->SetStreamSourceFreq(stream, setting);
+    }
+
+    if (!Forward(STATE_STREAM, !m_streamFreqValid[stream] || m_streamFreq[stream] != setting))
+        return D3D_OK;
+
+    if (g_capture.IsRecording())
+        g_capture.SetStreamSourceFreq(stream, setting);
+    HRESULT hr = m_pDevice->SetStreamSourceFreq(stream, setting);
+    m_streamFreq[stream]      = setting;
+    m_streamFreqValid[stream] = SUCCEEDED(hr);
+    return hr;
+}
+
+HRESULT StateCache::SetIndices(IDirect3DIndexBuffer9* pIB)
+{
+    if (!Forward(STATE_INDICES, !m_indicesValid || m_pIndices != pIB))
+        return D3D_OK;
+
+    if (g_capture.IsRecording())
+        g_capture.SetIndices(pIB);
+    HRESULT hr = m_pDevice->SetIndices(pIB);
+    m_pIndices     = pIB;
+    m_indicesValid = SUCCEEDED(hr);
+    return hr;
+}
+
+HRESULT StateCache::SetFVF(DWORD fvf)
+{
+    if (!Forward(STATE_VERTEX_FORMAT, !m_fvfValid || m_fvf != fvf))
+        return D3D_OK;
+
+    if (g_capture.IsRecording())
+        g_capture.SetFVF(fvf);
+    HRESULT hr = m_pDevice->SetFVF(fvf);
+
+    // SetFVF replaces the vertex declaration with one the runtime builds.
+    m_fvf       = fvf;
+    m_fvfValid  = SUCCEEDED(hr);
+    m_declValid = false;
+    return hr;
+}
+
+HRESULT StateCache::SetVertexDeclaration(IDirect3DVertexDeclaration9* pDecl)
+{
+    if (!Forward(STATE_VERTEX_FORMAT, !m_declValid || m_pDecl != pDecl))
+        return D3D_OK;
+
+    if (g_capture.IsRecording())
+        g_capture.SetVertexDeclaration(pDecl);
+    HRESULT hr = m_pDevice->SetVertexDeclaration(pDecl);
+
+    // ...and a declaration leaves the FVF undefined.
+    m_pDecl     = pDecl;
+    m_declValid = SUCCEEDED(hr);
+    m_fvfValid  = false;
+    return hr;
+}
+
+
+//===============================================================
+// Shaders and constants
+
+HRESULT StateCache::SetVertexShader(IDirect3DVertexShader9* pShader)
+{
+    if (!Forward(STATE_SHADER, !m_vsValid || m_pVS != pShader))
+        return D3D_OK;
+
+    if (g_capture.IsRecording())
+        g_capture.SetVertexShader(pShader);
+    HRESULT hr = m_pDevice->SetVertexShader(pShader);
+    m_pVS     = pShader;
+    m_vsValid = SUCCEEDED(hr);
+    return hr;
+}
+
+HRESULT StateCache::SetPixelShader(IDirect3DPixelShader9* pShader)
+{
+    if (!Forward(STATE_SHADER, !m_psValid || m_pPS != pShader))
+        return D3D_OK;
+
+    if (g_capture.IsRecording())
+        g_capture.SetPixelShader(pShader);
+    HRESULT hr = m_pDevice->SetPixelShader(pShader);
+    m_pPS     = pShader;
+    m_psValid = SUCCEEDED(hr);
+    return hr;
+}
+
+// The twelve constant setters differ only in the shadow they use, the
+// device method they end up in and what a capture records (int and bool
+// constants are not captured).  UpdateConstants() has already stored the
+// new values; a failed call forgets them again.
+#define STATE_CACHE_CONSTANTS(Method, T, shadow, valid, capacity, width, record)       \
+    HRESULT StateCache::Method(UINT first, const T* pData, UINT count)                 \
+    {                                                                                  \
+        UINT requested = count;                                                        \
+        if (!Forward(STATE_SHADER_CONSTANT,                                            \
+                     UpdateConstants(shadow, valid, capacity, width, first, pData, count))) \
+        {                                                                              \
+            m_stats.constantsSkipped += requested;                                     \
+            return D3D_OK;                                                             \
+        }                                                                              \
+        m_stats.constantsSkipped += requested - count;                                 \
+        if (g_capture.IsRecording())                                                   \
+            record;                                                                    \
+        HRESULT hr = m_pDevice->Method(first, pData, count);                           \
+        if (FAILED(hr))                                                                \
+            ForgetConstants<T>(valid, capacity, first, count);                         \
+        return hr;                                                                     \
+    }
+
+STATE_CACHE_CONSTANTS(SetVertexShaderConstantF, FLOAT, m_vsConstants.f, m_vsConstants.fValid, MAX_FLOAT_CONSTANTS, 4, g_capture.SetVertexShaderConstantF(first, pData, count))
+STATE_CACHE_CONSTANTS(SetVertexShaderConstantI, INT,   m_vsConstants.i, m_vsConstants.iValid, MAX_INT_CONSTANTS,   4, (void)0)
+STATE_CACHE_CONSTANTS(SetVertexShaderConstantB, BOOL,  m_vsConstants.b, m_vsConstants.bValid, MAX_BOOL_CONSTANTS,  1, (void)0)
+STATE_CACHE_CONSTANTS(SetPixelShaderConstantF,  FLOAT, m_psConstants.f, m_psConstants.fValid, MAX_FLOAT_CONSTANTS, 4, g_capture.SetPixelShaderConstantF(first, pData, count))
+STATE_CACHE_CONSTANTS(SetPixelShaderConstantI,  INT,   m_psConstants.i, m_psConstants.iValid, MAX_INT_CONSTANTS,   4, (void)0)
+STATE_CACHE_CONSTANTS(SetPixelShaderConstantB,  BOOL,  m_psConstants.b, m_psConstants.bValid, MAX_BOOL_CONSTANTS,  1, (void)0)
+
+#undef STATE_CACHE_CONSTANTS
+
+
+//===============================================================
+// Fixed-function transform and lighting
+
+HRESULT StateCache::SetTransform(D3DTRANSFORMSTATETYPE state, const D3DMATRIX* pMatrix)
+{
+    int t = TransformSlot(state);
+    if (t < 0)
+    {
+        Forward(STATE_TRANSFORM, true);
+        if (g_capture.IsRecording())
+            g_capture.SetTransform(state, pMatrix);
+        return m_pDevice->SetTransform(state, pMatrix);
+    }
+
+    bool changed = !m_transformValid[t] || memcmp(&m_transforms[t], pMatrix, sizeof(D3DMATRIX)) != 0;
+    if (!Forward(STATE_TRANSFORM, changed))
+        return D3D_OK;
+
+    if (g_capture.IsRecording())
+        g_capture.SetTransform(state, pMatrix);
+    HRESULT hr = m_pDevice->SetTransform(state, pMatrix);
+    m_transforms[t]     = *pMatrix;
+    m_transformValid[t] = SUCCEEDED(hr);
+    return hr;
+}
+
+HRESULT StateCache::SetMaterial(const D3DMATERIAL9* pMaterial)
+{
+    bool changed = !m_materialValid || memcmp(&m_material, pMaterial, sizeof(D3DMATERIAL9)) != 0;
+    if (!Forward(STATE_MATERIAL, changed))
+        return D3D_OK;
+
+    if (g_capture.IsRecording())
+        g_capture.SetMaterial(pMaterial);
+    HRESULT hr = m_pDevice->SetMaterial(pMaterial);
+    m_material      = *pMaterial;
+    m_materialValid = SUCCEEDED(hr);
+    return hr;
+}
+
+HRESULT StateCache::SetLight(DWORD index, const D3DLIGHT9* pLight)
+{
+    if (index >= m_lights.size())
+    {
+        m_lights.resize(index + 1);
+        m_lightValid.resize(index + 1, 0);
+        m_lightEnabled.resize(index + 1, -1);
+    }
+
+    bool changed = !m_lightValid[index] || memcmp(&m_lights[index], pLight, sizeof(D3DLIGHT9)) != 0;
+    if (!Forward(STATE_LIGHT, changed))
+        return D3D_OK;
+
+    if (g_capture.IsRecording())
+        g_capture.SetLight(index, pLight);
+    HRESULT hr = m_pDevice->SetLight(index, pLight);
+    m_lights[index]     = *pLight;
+    m_lightValid[index] = SUCCEEDED(hr);
+    return hr;
+}
+
+HRESULT StateCache::LightEnable(DWORD index, BOOL enable)
+{
+    if (index >= m_lights.size())
+    {
+        m_lights.resize(index + 1);
+        m_lightValid.resize(index + 1, 0);
+        m_lightEnabled.resize(index + 1, -1);
+    }
+
+    signed char value = enable ? 1 : 0;
+    if (!Forward(STATE_LIGHT, m_lightEnabled[index] != value))
+        return D3D_OK;
+
+    if (g_capture.IsRecording())
+        g_capture.LightEnable(index, enable);
+    HRESULT hr = m_pDevice->LightEnable(index, enable);
+
+    // Enabling a light that was never set makes the runtime create a
+    // default one; m_lightValid stays clear, so the next SetLight goes out.
+    m_lightEnabled[index] = SUCCEEDED(hr) ? value : -1;
+    return hr;
+}
+
+
+//===============================================================
+// Viewport and clipping
+
+HRESULT StateCache::SetViewport(const D3DVIEWPORT9* pViewport)
+{
+    bool changed = !m_viewportValid || memcmp(&m_viewport, pViewport, sizeof(D3DVIEWPORT9)) != 0;
+    if (!Forward(STATE_VIEWPORT, changed))
+        return D3D_OK;
+
+    if (g_capture.IsRecording())
+        g_capture.SetViewport(pViewport);
+    HRESULT hr = m_pDevice->SetViewport(pViewport);
+    m_viewport      = *pViewport;
+    m_viewportValid = SUCCEEDED(hr);
+    return hr;
+}
+
+HRESULT StateCache::SetScissorRect(const RECT* pRect)
+{
+    bool changed = !m_scissorValid || memcmp(&m_scissor, pRect, sizeof(RECT)) != 0;
+    if (!Forward(STATE_VIEWPORT, changed))
+        return D3D_OK;
+
+    if (g_capture.IsRecording())
+        g_capture.SetScissorRect(pRect);
+    HRESULT hr = m_pDevice->SetScissorRect(pRect);
+    m_scissor      = *pRect;
+    m_scissorValid = SUCCEEDED(hr);
+    return hr;
+}
+
+HRESULT StateCache::SetClipPlane(DWORD index, const float* pPlane)
+{
+    if (index >= MAX_CLIP_PLANES)
+    {
+        Forward(STATE_VIEWPORT, true);
+        if (g_capture.IsRecording())
+            g_capture.SetClipPlane(index, pPlane);
+        return m_pDevice->SetClipPlane(index, pPlane);
+    }
+
+    bool changed = !m_clipPlaneValid[index] || memcmp(m_clipPlanes[index], pPlane, 4 * sizeof(float)) != 0;
+    if (!Forward(STATE_VIEWPORT, changed))
+        return D3D_OK;
+
+    if (g_capture.IsRecording())
+        g_capture.SetClipPlane(index, pPlane);
+    HRESULT hr = m_pDevice->SetClipPlane(index, pPlane);
+    memcpy(m_clipPlanes[index], pPlane, 4 * sizeof(float));
+    m_clipPlaneValid[index] = SUCCEEDED(hr);
+    return hr;
+}
+
+HRESULT StateCache::SetNPatchMode(FLOAT segments)
+{
+    if (!Forward(STATE_VIEWPORT, !m_nPatchValid || m_nPatchSegments != segments))
+        return D3D_OK;
+
+    HRESULT hr = m_pDevice->SetNPatchMode(segments);
+    m_nPatchSegments = segments;
+    m_nPatchValid    = SUCCEEDED(hr);
+    return hr;
+}
+
+
+//===============================================================
+// Clear and draws
+//
+// Not state, but they go through here so that a capture sees them in order
+// with the state they use.
+
+HRESULT StateCache::Clear(DWORD count, const D3DRECT* pRects, DWORD flags, D3DCOLOR color, float z, DWORD stencil)
+{
+    if (g_capture.IsRecording())
+        g_capture.Clear(flags, color, z, stencil);
+    g_frameStats.Clear();
+    return m_pDevice->Clear(count, pRects, flags, color, z, stencil);
+}
+
+HRESULT StateCache::DrawPrimitive(D3DPRIMITIVETYPE type, UINT startVertex, UINT primCount)
+{
+    if (g_capture.IsRecording())
+        g_capture.DrawPrimitive(type, startVertex, primCount);
+    g_frameStats.Draw(type, primCount);
+    return m_pDevice->DrawPrimitive(type, startVertex, primCount);
+}
+
+HRESULT StateCache::DrawIndexedPrimitive(D3DPRIMITIVETYPE type, INT baseVertex, UINT minIndex,
+                                         UINT numVertices, UINT startIndex, UINT primCount)
+{
+    if (g_capture.IsRecording())
+        g_capture.DrawIndexedPrimitive(type, baseVertex, minIndex, numVertices, startIndex, primCount);
+    g_frameStats.Draw(type, primCount);
+    return m_pDevice->DrawIndexedPrimitive(type, baseVertex, minIndex, numVertices, startIndex, primCount);
+}
+
+HRESULT StateCache::DrawSubset(ID3DXMesh* pMesh, DWORD attribute)
+{
+    if (g_capture.IsRecording())
+        g_capture.DrawSubset(pMesh, attribute);
+    g_frameStats.DrawSubset(pMesh, attribute);
+    HRESULT hr = pMesh->DrawSubset(attribute);
+    InvalidateVertexInput();
+    return hr;
+}
+
+
+//===============================================================
+// IUnknown
+
+HRESULT StateCache::QueryInterface(REFIID iid, LPVOID* ppv)
+{
+    if (ppv == NULL)
+        return E_POINTER;
+
+    if (IsEqualGUID(iid, IID_IUnknown) || IsEqualGUID(iid, IID_ID3DXEffectStateManager))
+    {
+        *ppv = static_cast<ID3DXEffectStateManager*>(this);
+        return S_OK;
+    }
+
+    *ppv = NULL;
+    return E_NOINTERFACE;
+}
+
+ULONG StateCache::AddRef()
+{
+    return 1;
+}
+
+ULONG StateCache::Release()
+{
+    return 1;
+}
+
+
+//===============================================================
+// Statistics
+
+void StateCache::ResetStats()
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void StateCache::ReportStats(const char* name) const
+{
+    unsigned forwarded = 0, filtered = 0;
+    for (int k = 0; k < NUM_STATE_KINDS; ++k)
+    {
+        forwarded += m_stats.forwarded[k];
+        filtered  += m_stats.filtered[k];
+    }
+
+    char msg[1024];
+    int n = snprintf(msg, sizeof(msg), "[StateCache] %s: %u calls forwarded, %u filtered (%.1f%%)",
+                     name, forwarded, filtered,
+                     forwarded + filtered ? 100.0 * filtered / (forwarded + filtered) : 0.0);
+
+    const char* separator = ";";
+    for (int k = 0; k < NUM_STATE_KINDS && n > 0 && n < (int)sizeof(msg); ++k)
+    {
+        if (m_stats.forwarded[k] + m_stats.filtered[k] == 0)
+            continue;
+        n += snprintf(msg + n, sizeof(msg) - n, "%s %s %u/%u", separator,
+                      StateKindName(k), m_stats.forwarded[k], m_stats.filtered[k]);
+        separator = ",";
+    }
+    if (n > 0 && n < (int)sizeof(msg))
+        snprintf(msg + n, sizeof(msg) - n, "; %llu constant registers skipped\n", m_stats.constantsSkipped);
+
+#ifdef _WIN32
+    OutputDebugStringA(msg);
+#endif
+    fputs(msg, stderr);
+}
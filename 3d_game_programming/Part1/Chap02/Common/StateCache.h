@@ -0,0 +1,276 @@
+//=============================================================================
+// StateCache.h
+//
+// Redundant state filter in front of an IDirect3DDevice9.  Every Set* call
+// is compared with a shadow copy of what the device already has and only
+// reaches the driver when the value actually changes, so the samples can
+// keep re-issuing their complete state every frame for clarity without
+// paying for it.
+//
+// The shadow covers the fixed-function and shader pipeline state: render,
+// sampler and texture stage states, textures, vertex streams and their
+// frequencies, indices, FVF/vertex declaration, shaders and their float,
+// int and bool constants, transforms, material, lights, viewport, scissor
+// rect, clip planes and N-patch mode.  Render targets and depth surfaces
+// go to the device directly.  Clear() and the draw calls are plain
+// passthroughs, there so that a device capture (DeviceCapture.h) sees
+// them in order with the state they use and the frame statistics
+// (FrameStats.h) count them; DrawSubset() also does the
+// InvalidateVertexInput() a mesh draw needs.
+//
+// StateCache also implements ID3DXEffectStateManager, so effects route the
+// state of their passes through the same shadow:
+//
+//     pFx->SetStateManager( &g_stateCache );
+//     pFx->Begin( &passes, D3DXFX_DONOTSAVESTATE );
+//
+// Saving state in Begin() would restore it through a state block behind the
+// cache's back; an effect that must do so has to be followed by
+// Invalidate().  Invalidate() is also needed after IDirect3DDevice9::Reset()
+// and after any Set* that bypasses the cache.
+//
+// Unknown state (after Attach() or Invalidate()) is always forwarded, and a
+// call the device fails leaves its state unknown.  State outside the shadow
+// arrays (render states past 255, samplers other than the 16 pixel, the
+// displacement map and 4 vertex samplers, stages past 7, world matrices
+// past 3, clip planes past 5) is forwarded every time without filtering.
+// Everything forwarded is also recorded by a running capture, except the
+// N-patch mode.  The cache does not AddRef the objects it shadows; the
+// device keeps a reference to everything bound to it, so a bound pointer
+// cannot be recycled while the shadow still holds it.
+//=============================================================================
+
+#ifndef STATE_CACHE_H
+#define STATE_CACHE_H
+
+#include <d3dx9.h>
+#include <vector>
+
+
+enum StateKind
+{
+    STATE_RENDER,
+    STATE_SAMPLER,
+    STATE_TEXTURE_STAGE,
+    STATE_TEXTURE,
+    STATE_STREAM,           // SetStreamSource, SetStreamSourceFreq
+    STATE_INDICES,
+    STATE_VERTEX_FORMAT,    // SetFVF, SetVertexDeclaration
+    STATE_SHADER,
+    STATE_SHADER_CONSTANT,
+    STATE_TRANSFORM,
+    STATE_MATERIAL,
+    STATE_LIGHT,            // SetLight, LightEnable
+    STATE_VIEWPORT,         // SetViewport, SetScissorRect, SetClipPlane, SetNPatchMode
+    NUM_STATE_KINDS
+};
+
+// Short name of a StateKind, for reports and logs.
+inline const char* StateKindName(int kind)
+{
+    static const char* const s_names[NUM_STATE_KINDS] =
+    {
+        "render", "sampler", "stage", "texture", "stream", "indices", "format",
+        "shader", "constant", "transform", "material", "light", "viewport"
+    };
+    return kind >= 0 && kind < NUM_STATE_KINDS ? s_names[kind] : "?";
+}
+
+struct StateCacheStats
+{
+    unsigned forwarded[NUM_STATE_KINDS];    // reached the device
+    unsigned filtered[NUM_STATE_KINDS];     // dropped as redundant
+    unsigned long long constantsSkipped;    // registers trimmed off forwarded constant ranges
+};
+
+// Bulk application: one entry per state.
+struct RenderStateValue
+{
+    D3DRENDERSTATETYPE state;
+    DWORD              value;
+};
+
+struct SamplerStateValue
+{
+    D3DSAMPLERSTATETYPE state;
+    DWORD               value;
+};
+
+struct TextureStageStateValue
+{
+    D3DTEXTURESTAGESTATETYPE state;
+    DWORD                    value;
+};
+
+
+class StateCache : public ID3DXEffectStateManager
+{
+public:
+    static const unsigned MAX_RENDER_STATES        = 256;
+    static const unsigned MAX_SAMPLERS             = 21;    // 16 pixel, displacement map, 4 vertex
+    static const unsigned MAX_SAMPLER_STATES       = 14;
+    static const unsigned MAX_TEXTURE_STAGES       = 8;
+    static const unsigned MAX_TEXTURE_STAGE_STATES = 33;
+    static const unsigned MAX_STREAMS              = 16;
+    static const unsigned MAX_TRANSFORMS           = 28;    // view .. texture7, world0 .. world3
+    static const unsigned MAX_CLIP_PLANES          = 6;
+    static const unsigned MAX_FLOAT_CONSTANTS      = 256;
+    static const unsigned MAX_INT_CONSTANTS        = 16;
+    static const unsigned MAX_BOOL_CONSTANTS       = 16;
+
+    StateCache();
+
+    // Starts shadowing pDevice with every state unknown.  The cache does not
+    // keep a reference; Detach() before releasing the device.
+    void Attach(IDirect3DDevice9* pDevice);
+    void Detach();
+    IDirect3DDevice9* Device() const { return m_pDevice; }
+
+    // Forgets the shadow; the next Set* of every state is forwarded.
+    void Invalidate();
+
+    // Forgets streams, indices and vertex format only, after a call that
+    // sets them on the device itself (ID3DXMesh::DrawSubset).
+    void InvalidateVertexInput();
+
+    // Device state without an ID3DXEffectStateManager counterpart.
+    HRESULT SetStreamSource(UINT stream, IDirect3DVertexBuffer9* pVB, UINT offset, UINT stride);
+    HRESULT SetStreamSourceFreq(UINT stream, UINT setting);
+    HRESULT SetIndices(IDirect3DIndexBuffer9* pIB);
+    HRESULT SetVertexDeclaration(IDirect3DVertexDeclaration9* pDecl);
+    HRESULT SetViewport(const D3DVIEWPORT9* pViewport);
+    HRESULT SetScissorRect(const RECT* pRect);
+    HRESULT SetClipPlane(DWORD index, const float* pPlane);
+
+    // Passthroughs to the device (and a running capture).
+    HRESULT Clear(DWORD count, const D3DRECT* pRects, DWORD flags, D3DCOLOR color, float z, DWORD stencil);
+    HRESULT DrawPrimitive(D3DPRIMITIVETYPE type, UINT startVertex, UINT primCount);
+    HRESULT DrawIndexedPrimitive(D3DPRIMITIVETYPE type, INT baseVertex, UINT minIndex,
+                                 UINT numVertices, UINT startIndex, UINT primCount);
+    HRESULT DrawSubset(ID3DXMesh* pMesh, DWORD attribute);
+
+    // Bulk application.  Each entry is filtered on its own; returns the
+    // number of entries that reached the device.
+    unsigned ApplyRenderStates(const RenderStateValue* pStates, unsigned count);
+    unsigned ApplySamplerStates(DWORD sampler, const SamplerStateValue* pStates, unsigned count);
+    unsigned ApplyTextureStageStates(DWORD stage, const TextureStageStateValue* pStates, unsigned count);
+
+    // Shadowed values; false if the state is unknown.
+    bool GetRenderState(D3DRENDERSTATETYPE state, DWORD* pValue) const;
+    bool GetTexture(DWORD sampler, IDirect3DBaseTexture9** ppTexture) const;
+
+    const StateCacheStats& Stats() const { return m_stats; }
+    void ResetStats();
+    void ReportStats(const char* name) const;
+
+    // IUnknown.  The cache is not reference counted; it lives as long as the
+    // object that owns it (g_stateCache lives for the whole program).
+    STDMETHOD(QueryInterface)(REFIID iid, LPVOID* ppv);
+    STDMETHOD_(ULONG, AddRef)();
+    STDMETHOD_(ULONG, Release)();
+
+    // ID3DXEffectStateManager
+    STDMETHOD(SetTransform)(D3DTRANSFORMSTATETYPE state, const D3DMATRIX* pMatrix);
+    STDMETHOD(SetMaterial)(const D3DMATERIAL9* pMaterial);
+    STDMETHOD(SetLight)(DWORD index, const D3DLIGHT9* pLight);
+    STDMETHOD(LightEnable)(DWORD index, BOOL enable);
+    STDMETHOD(SetRenderState)(D3DRENDERSTATETYPE state, DWORD value);
+    STDMETHOD(SetTexture)(DWORD sampler, IDirect3DBaseTexture9* pTexture);
+    STDMETHOD(SetTextureStageState)(DWORD stage, D3DTEXTURESTAGESTATETYPE type, DWORD value);
+    STDMETHOD(SetSamplerState)(DWORD sampler, D3DSAMPLERSTATETYPE type, DWORD value);
+    STDMETHOD(SetNPatchMode)(FLOAT segments);
+    STDMETHOD(SetFVF)(DWORD fvf);
+    STDMETHOD(SetVertexShader)(IDirect3DVertexShader9* pShader);
+    STDMETHOD(SetVertexShaderConstantF)(UINT first, const FLOAT* pData, UINT count);
+    STDMETHOD(SetVertexShaderConstantI)(UINT first, const INT* pData, UINT count);
+    STDMETHOD(SetVertexShaderConstantB)(UINT first, const BOOL* pData, UINT count);
+    STDMETHOD(SetPixelShader)(IDirect3DPixelShader9* pShader);
+    STDMETHOD(SetPixelShaderConstantF)(UINT first, const FLOAT* pData, UINT count);
+    STDMETHOD(SetPixelShaderConstantI)(UINT first, const INT* pData, UINT count);
+    STDMETHOD(SetPixelShaderConstantB)(UINT first, const BOOL* pData, UINT count);
+
+private:
+    struct Stream
+    {
+        IDirect3DVertexBuffer9* pVB;
+        UINT                    offset;
+        UINT                    stride;
+    };
+
+    struct ShaderConstants
+    {
+        float         f[MAX_FLOAT_CONSTANTS * 4];
+        int           i[MAX_INT_CONSTANTS * 4];
+        BOOL          b[MAX_BOOL_CONSTANTS];
+        unsigned char fValid[MAX_FLOAT_CONSTANTS];
+        unsigned char iValid[MAX_INT_CONSTANTS];
+        unsigned char bValid[MAX_BOOL_CONSTANTS];
+    };
+
+    // Index into the shadow arrays, or -1 for states that are not shadowed
+    // (they are forwarded every time).
+    static int SamplerSlot(DWORD sampler);
+    static int TransformSlot(D3DTRANSFORMSTATETYPE state);
+
+    // Counts the call and returns true if it has to be forwarded.
+    bool Forward(StateKind kind, bool changed)
+    {
+        if (changed)
+            ++m_stats.forwarded[kind];
+        else
+            ++m_stats.filtered[kind];
+        return changed;
+    }
+
+    IDirect3DDevice9* m_pDevice;
+
+    DWORD         m_renderStates[MAX_RENDER_STATES];
+    unsigned char m_renderValid[MAX_RENDER_STATES];
+    DWORD         m_samplerStates[MAX_SAMPLERS][MAX_SAMPLER_STATES];
+    unsigned char m_samplerValid[MAX_SAMPLERS][MAX_SAMPLER_STATES];
+    DWORD         m_stageStates[MAX_TEXTURE_STAGES][MAX_TEXTURE_STAGE_STATES];
+    unsigned char m_stageValid[MAX_TEXTURE_STAGES][MAX_TEXTURE_STAGE_STATES];
+
+    IDirect3DBaseTexture9* m_textures[MAX_SAMPLERS];
+    unsigned char          m_textureValid[MAX_SAMPLERS];
+
+    Stream        m_streams[MAX_STREAMS];
+    unsigned char m_streamValid[MAX_STREAMS];
+    UINT          m_streamFreq[MAX_STREAMS];
+    unsigned char m_streamFreqValid[MAX_STREAMS];
+
+    IDirect3DIndexBuffer9*       m_pIndices;
+    DWORD                        m_fvf;
+    IDirect3DVertexDeclaration9* m_pDecl;
+    IDirect3DVertexShader9*      m_pVS;
+    IDirect3DPixelShader9*       m_pPS;
+    bool m_indicesValid, m_fvfValid, m_declValid, m_vsValid, m_psValid;
+
+    ShaderConstants m_vsConstants;
+    ShaderConstants m_psConstants;
+
+    D3DMATRIX     m_transforms[MAX_TRANSFORMS];
+    unsigned char m_transformValid[MAX_TRANSFORMS];
+
+    D3DMATERIAL9  m_material;
+    bool          m_materialValid;
+
+    std::vector<D3DLIGHT9>     m_lights;
+    std::vector<unsigned char> m_lightValid;
+    std::vector<signed char>   m_lightEnabled;      // -1 unknown
+
+    D3DVIEWPORT9  m_viewport;
+    RECT          m_scissor;
+    float         m_clipPlanes[MAX_CLIP_PLANES][4];
+    unsigned char m_clipPlaneValid[MAX_CLIP_PLANES];
+    float         m_nPatchSegments;
+    bool          m_viewportValid, m_scissorValid, m_nPatchValid;
+
+    StateCacheStats m_stats;
+};
+
+
+// One cache shared by the whole program (defined in StateCache.cpp).
+extern StateCache g_stateCache;
+
+#endif // STATE_CACHE_H
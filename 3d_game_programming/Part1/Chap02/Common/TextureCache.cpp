@@ -0,0 +1,279 @@
+//=============================================================================
+// TextureCache.cpp
+//=============================================================================
+
+#include "TextureCache.h"
+#include "FileUtil.h"
+#include "AssetPack.h"
+#include <cstdio>
+#include <cstring>
+
+
+TextureCache g_textureCache;
+
+
+TextureLoadOptions TextureLoadOptions::Default()
+{
+    TextureLoadOptions o;
+    o.width     = D3DX_DEFAULT;
+    o.height    = D3DX_DEFAULT;
+    o.mipLevels = D3DX_DEFAULT;
+    o.usage     = 0;
+    o.format    = D3DFMT_UNKNOWN;
+    o.pool      = D3DPOOL_MANAGED;
+    o.filter    = D3DX_DEFAULT;
+    o.mipFilter = D3DX_DEFAULT;
+    o.colorKey  = 0;
+    return o;
+}
+
+
+TextureCache::TextureCache()
+    : m_onLoaded(NULL)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+
+    m_searchPaths.push_back("");
+#ifdef _WIN32
+    m_searchPaths.push_back("..\\");
+#else
+    m_searchPaths.push_back("../");
+#endif
+}
+
+void TextureCache::AddSearchPath(const char* prefix)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_searchPaths.push_back(prefix);
+}
+
+TextureHandle TextureCache::Acquire(IDirect3DDevice9* pDevice, const char* fileName)
+{
+    return Acquire(pDevice, fileName, TextureLoadOptions::Default());
+}
+
+TextureHandle TextureCache::Acquire(IDirect3DDevice9* pDevice, const char* fileName,
+                                    const TextureLoadOptions& o)
+{
+    if (fileName == NULL || fileName[0] == '\0')
+        return TextureHandle();
+
+    std::string canonical, key;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (!ResolvePath(fileName, canonical))
+        {
+            ++m_stats.misses;
+            ++m_stats.failures;
+            return TextureHandle();
+        }
+
+        key = MakeKey(canonical, o);
+        std::unordered_map<std::string, Entry>::iterator it = m_entries.find(key);
+        if (it != m_entries.end())
+        {
+            ++m_stats.hits;
+            ++it->second.refCount;
+            m_stats.bytesSaved += it->second.bytes;
+            return it->second.handle;
+        }
+
+        ++m_stats.misses;
+    }
+
+    // Decode without the lock, so other threads' hits are not held up.
+    IDirect3DTexture9* pTex = NULL;
+    if (FAILED(CreateTexture(pDevice, fileName, canonical, o, &pTex)))
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_stats.failures;
+        return TextureHandle();
+    }
+    UINT64 bytes = EstimateBytes(pTex);
+
+    Entry e;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // Another thread may have loaded the same texture meanwhile; keep
+        // its copy and count this Acquire() as a hit.
+        std::unordered_map<std::string, Entry>::iterator it = m_entries.find(key);
+        if (it != m_entries.end())
+        {
+            --m_stats.misses;
+            ++m_stats.hits;
+            ++it->second.refCount;
+            m_stats.bytesSaved += it->second.bytes;
+            e = it->second;
+        }
+        else
+        {
+            e.handle   = g_resources.RegisterTexture(pTex, canonical.c_str());
+            e.refCount = 1;
+            e.bytes    = bytes;
+
+            m_entries[key] = e;
+            m_keyByHandle[e.handle.Id()] = key;
+            ++m_stats.numTextures;
+            m_stats.bytes += e.bytes;
+            pTex = NULL;
+        }
+    }
+
+    if (pTex)
+    {
+        pTex->Release();
+        return e.handle;
+    }
+
+    if (m_onLoaded)
+        m_onLoaded(e.handle, canonical.c_str(), o);
+
+    return e.handle;
+}
+
+void TextureCache::Release(TextureHandle& h)
+{
+    if (h.IsNull())
+        return;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::unordered_map<unsigned, std::string>::iterator k = m_keyByHandle.find(h.Id());
+    if (k == m_keyByHandle.end())
+    {
+        h = TextureHandle();
+        return;
+    }
+
+    Entry& e = m_entries[k->second];
+    if (--e.refCount == 0)
+    {
+        m_stats.bytes -= e.bytes;
+        --m_stats.numTextures;
+        g_resources.Release(e.handle);
+        m_entries.erase(k->second);
+        m_keyByHandle.erase(k);
+    }
+    h = TextureHandle();
+}
+
+TextureCacheStats TextureCache::GetStats()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void TextureCache::ReportStats()
+{
+    TextureCacheStats s = GetStats();
+
+    char msg[256];
+    snprintf(msg, sizeof(msg),
+             "[TextureCache] hits %u, misses %u (failed %u), resident %u textures / %u KB, saved %u KB\n",
+             s.hits, s.misses, s.failures, s.numTextures,
+             (unsigned)(s.bytes / 1024), (unsigned)(s.bytesSaved / 1024));
+#ifdef _WIN32
+    OutputDebugStringA(msg);
+#endif
+    fputs(msg, stderr);
+}
+
+//===============================================================
+// Turns a relative file name into an absolute, normalised path so
+// "tiger.bmp" and "..\Meshes\tiger.bmp" end up as the same key.
+// Names found in a mounted asset pack become "pack:<entry name>".
+// The path keeps its case for loading; MakeKey() folds it.
+
+bool TextureCache::ResolvePath(const char* fileName, std::string& canonical)
+{
+    if (g_assets.InPack(fileName))
+    {
+        canonical = "pack:" + NormaliseAssetName(fileName);
+        return true;
+    }
+
+    for (size_t i = 0; i < m_searchPaths.size(); ++i)
+    {
+        std::string candidate = m_searchPaths[i] + fileName;
+        if (FileExists(candidate.c_str()) && CanonicalPath(candidate.c_str(), canonical))
+            return true;
+    }
+    return false;
+}
+
+HRESULT TextureCache::CreateTexture(IDirect3DDevice9* pDevice, const char* fileName,
+                                    const std::string& canonical, const TextureLoadOptions& o,
+                                    IDirect3DTexture9** ppTex)
+{
+    if (canonical.compare(0, 5, "pack:") != 0)
+    {
+        return D3DXCreateTextureFromFileEx(pDevice, canonical.c_str(),
+                                           o.width, o.height, o.mipLevels, o.usage,
+                                           o.format, o.pool, o.filter, o.mipFilter,
+                                           o.colorKey, NULL, NULL, ppTex);
+    }
+
+    AssetData data;
+    if (!g_assets.Load(fileName, data))
+        return D3DXERR_INVALIDDATA;
+
+    return D3DXCreateTextureFromFileInMemoryEx(pDevice, data.Data(), (UINT)data.Size(),
+                                               o.width, o.height, o.mipLevels, o.usage,
+                                               o.format, o.pool, o.filter, o.mipFilter,
+                                               o.colorKey, NULL, NULL, ppTex);
+}
+
+std::string TextureCache::MakeKey(const std::string& canonical, const TextureLoadOptions& o)
+{
+    char opts[128];
+    snprintf(opts, sizeof(opts), "|%u,%u,%u,%lx,%d,%d,%lx,%lx,%lx",
+             o.width, o.height, o.mipLevels, (unsigned long)o.usage, (int)o.format,
+             (int)o.pool, (unsigned long)o.filter, (unsigned long)o.mipFilter,
+             (unsigned long)o.colorKey);
+    return PathKey(canonical) + opts;
+}
+
+//===============================================================
+// Size of every mip level; compressed formats use 4x4 blocks.
+
+UINT64 TextureCache::EstimateBytes(IDirect3DTexture9* pTex)
+{
+    UINT64 total = 0;
+    DWORD levels = pTex->GetLevelCount();
+    for (DWORD i = 0; i < levels; ++i)
+    {
+        D3DSURFACE_DESC desc;
+        if (FAILED(pTex->GetLevelDesc(i, &desc)))
+            break;
+
+        UINT w = desc.Width, h = desc.Height;
+        switch (desc.Format)
+        {
+        case D3DFMT_DXT1:
+            total += (UINT64)((w + 3) / 4) * ((h + 3) / 4) * 8;
+            break;
+        case D3DFMT_DXT2: case D3DFMT_DXT3: case D3DFMT_DXT4: case D3DFMT_DXT5:
+            total += (UINT64)((w + 3) / 4) * ((h + 3) / 4) * 16;
+            break;
+        case D3DFMT_R5G6B5: case D3DFMT_X1R5G5B5: case D3DFMT_A1R5G5B5:
+        case D3DFMT_A4R4G4B4: case D3DFMT_L16: case D3DFMT_A8L8:
+            total += (UINT64)w * h * 2;
+            break;
+        case D3DFMT_L8: case D3DFMT_A8: case D3DFMT_P8:
+            total += (UINT64)w * h;
+            break;
+        case D3DFMT_A16B16G16R16F: case D3DFMT_A16B16G16R16:
+            total += (UINT64)w * h * 8;
+            break;
+        case D3DFMT_A32B32G32R32F:
+            total += (UINT64)w * h * 16;
+            break;
+        default:
+            total += (UINT64)w * h * 4;
+            break;
+        }
+    }
+    return total;
+}
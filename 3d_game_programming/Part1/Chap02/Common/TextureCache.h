@@ -0,0 +1,121 @@
+//=============================================================================
+// TextureCache.h
+//
+// Reference counted texture cache shared by every mesh and sample.  Textures
+// are keyed by their resolved, canonical file path plus the load options, so
+// fifty materials that name the same atlas (or the same file through
+// different relative paths) share one IDirect3DTexture9.
+//
+// The cache hands out TextureHandles from g_resources; the last Release()
+// of a texture returns its handle to the resource manager, which destroys
+// it once no in-flight frame uses it any more.
+//
+// Names found in a mounted asset pack (g_assets) are loaded from the pack
+// in preference to loose files.
+//
+// Acquire(), Release() and the statistics are thread safe; set the
+// callback and search paths before loading.  A texture is decoded, and
+// the loaded callback run, without the cache's lock held; two threads
+// that miss on the same texture both decode it, and the later one drops
+// its copy for the one already published.
+//=============================================================================
+
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include "Resources.h"
+
+
+//===============================================================
+// Mirrors the D3DXCreateTextureFromFileEx parameters that change the
+// resulting texture.  Default() matches D3DXCreateTextureFromFile.
+
+struct TextureLoadOptions
+{
+    UINT      width;
+    UINT      height;
+    UINT      mipLevels;
+    DWORD     usage;
+    D3DFORMAT format;
+    D3DPOOL   pool;
+    DWORD     filter;
+    DWORD     mipFilter;
+    D3DCOLOR  colorKey;
+
+    static TextureLoadOptions Default();
+};
+
+
+struct TextureCacheStats
+{
+    unsigned hits;          // Acquire() satisfied by a cached texture
+    unsigned misses;        // Acquire() that had to load from disk
+    unsigned failures;      // misses whose load failed
+    unsigned numTextures;   // textures currently resident
+    UINT64   bytes;         // estimated memory of resident textures
+    UINT64   bytesSaved;    // memory that duplicate loads would have cost
+};
+
+
+// Called after a texture has been loaded from disk for the first time.
+typedef void (*TextureLoadedCallback)(TextureHandle h, const char* canonicalPath,
+                                      const TextureLoadOptions& options);
+
+
+class TextureCache
+{
+public:
+    TextureCache();
+
+    // Lets the hot reloader learn about every texture the cache loads.
+    void SetLoadedCallback(TextureLoadedCallback fn) { m_onLoaded = fn; }
+
+    // Relative names are tried against each search path in order.  The
+    // defaults ("" and "..\") match the lookup the samples used to do.
+    void AddSearchPath(const char* prefix);
+
+    // Returns a null handle if the file can't be found or decoded.
+    TextureHandle Acquire(IDirect3DDevice9* pDevice, const char* fileName);
+    TextureHandle Acquire(IDirect3DDevice9* pDevice, const char* fileName,
+                          const TextureLoadOptions& options);
+
+    // Drops one reference; the texture is released with the last one.
+    void Release(TextureHandle& h);
+
+    TextureCacheStats GetStats();
+
+    // Prints hit/miss counters and memory totals to the debug output.
+    void ReportStats();
+
+private:
+    struct Entry
+    {
+        TextureHandle handle;
+        unsigned      refCount;
+        UINT64        bytes;
+    };
+
+    bool ResolvePath(const char* fileName, std::string& canonical);
+    static HRESULT CreateTexture(IDirect3DDevice9* pDevice, const char* fileName,
+                                 const std::string& canonical, const TextureLoadOptions& o,
+                                 IDirect3DTexture9** ppTex);
+    static std::string MakeKey(const std::string& canonical, const TextureLoadOptions& o);
+    static UINT64 EstimateBytes(IDirect3DTexture9* pTex);
+
+    std::mutex                             m_mutex;
+    std::vector<std::string>               m_searchPaths;
+    std::unordered_map<std::string, Entry> m_entries;
+    std::unordered_map<unsigned, std::string> m_keyByHandle;
+    TextureCacheStats                      m_stats;
+    TextureLoadedCallback                  m_onLoaded;
+};
+
+
+// Shared by all meshes in the program (defined in TextureCache.cpp).
+extern TextureCache g_textureCache;
+
+#endif // TEXTURE_CACHE_H
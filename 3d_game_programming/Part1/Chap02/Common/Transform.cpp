@@ -0,0 +1,159 @@
+//=============================================================================
+// Transform.cpp
+//=============================================================================
+
+#include "Transform.h"
+
+
+//===============================================================
+// Camera
+
+Camera::Camera()
+    : m_eye(0.0f, 0.0f, -1.0f), m_at(0.0f, 0.0f, 0.0f), m_up(0.0f, 1.0f, 0.0f),
+      m_fovY(MATH_PI / 4), m_aspect(1.0f), m_zn(1.0f), m_zf(100.0f), m_version(0),
+      m_viewDirty(true), m_projDirty(true), m_viewProjDirty(true)
+{
+}
+
+static bool SameVec3(const Vec3& a, const Vec3& b)
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+void Camera::SetLookAt(const Vec3& eye, const Vec3& at, const Vec3& up)
+{
+    if (SameVec3(eye, m_eye) && SameVec3(at, m_at) && SameVec3(up, m_up) && m_version != 0)
+        return;
+
+    m_eye = eye;
+    m_at  = at;
+    m_up  = up;
+    m_viewDirty = m_viewProjDirty = true;
+    ++m_version;
+}
+
+void Camera::SetPerspective(float fovY, float aspect, float zn, float zf)
+{
+    if (fovY == m_fovY && aspect == m_aspect && zn == m_zn && zf == m_zf && m_version != 0)
+        return;
+
+    m_fovY   = fovY;
+    m_aspect = aspect;
+    m_zn     = zn;
+    m_zf     = zf;
+    m_projDirty = m_viewProjDirty = true;
+    ++m_version;
+}
+
+const Mat4& Camera::View() const
+{
+    if (m_viewDirty)
+    {
+        m_view = Mat4LookAtLH(m_eye, m_at, m_up);
+        m_viewDirty = false;
+    }
+    return m_view;
+}
+
+const Mat4& Camera::Proj() const
+{
+    if (m_projDirty)
+    {
+        m_proj = Mat4PerspectiveFovLH(m_fovY, m_aspect, m_zn, m_zf);
+        m_projDirty = false;
+    }
+    return m_proj;
+}
+
+const Mat4& Camera::ViewProj() const
+{
+    if (m_viewProjDirty)
+    {
+        Mat4Multiply(&m_viewProj, View(), Proj());
+        m_viewProjDirty = false;
+    }
+    return m_viewProj;
+}
+
+
+//===============================================================
+// TransformHierarchy
+
+TransformHierarchy::TransformHierarchy()
+{
+    m_stats.nodes        = 0;
+    m_stats.worldUpdates = 0;
+    m_stats.wvpComputed  = 0;
+}
+
+int TransformHierarchy::CreateNode(int parent)
+{
+    if (parent < NO_PARENT || parent >= NumNodes())
+        return -1;
+
+    m_scales.push_back(Vec3(1.0f, 1.0f, 1.0f));
+    m_rotations.push_back(QuatIdentity());
+    m_translations.push_back(Vec3(0.0f, 0.0f, 0.0f));
+    m_parents.push_back(parent);
+    m_dirty.push_back(1);
+    m_changed.push_back(0);
+    m_worlds.push_back(Mat4Identity());
+    m_stats.nodes = (unsigned)m_parents.size();
+    return NumNodes() - 1;
+}
+
+void TransformHierarchy::Clear()
+{
+    m_scales.clear();
+    m_rotations.clear();
+    m_translations.clear();
+    m_parents.clear();
+    m_dirty.clear();
+    m_changed.clear();
+    m_worlds.clear();
+    m_stats.nodes = 0;
+}
+
+void TransformHierarchy::SetLocal(int node, const Vec3& scale, const Quat& rotation, const Vec3& translation)
+{
+    m_scales[node]       = scale;
+    m_rotations[node]    = rotation;
+    m_translations[node] = translation;
+    m_dirty[node]        = 1;
+}
+
+void TransformHierarchy::Update()
+{
+    unsigned updates = 0;
+    int      count   = NumNodes();
+
+    for (int i = 0; i < count; ++i)
+    {
+        int parent = m_parents[i];
+        if (!m_dirty[i] && (parent == NO_PARENT || !m_changed[parent]))
+        {
+            m_changed[i] = 0;
+            continue;
+        }
+
+        Mat4 local = Mat4AffineTransformation(m_scales[i], m_rotations[i], m_translations[i]);
+        if (parent == NO_PARENT)
+            m_worlds[i] = local;
+        else
+            Mat4Multiply(&m_worlds[i], local, m_worlds[parent]);
+
+        m_dirty[i]   = 0;
+        m_changed[i] = 1;
+        ++updates;
+    }
+    m_stats.worldUpdates = updates;
+}
+
+void TransformHierarchy::ComputeWorldViewProj(const Camera& camera, const unsigned* nodes, size_t count, Mat4* out)
+{
+    if (count == 0)
+        return;
+
+    Mat4MultiplyGather(out, &m_worlds[0], nodes, camera.ViewProj(), count);
+    m_stats.wvpComputed += (unsigned)count;
+}
@@ -0,0 +1,122 @@
+//=============================================================================
+// Transform.h
+//
+// Transform hierarchy and camera.
+//
+// TransformHierarchy keeps every node's local scale/rotation/translation
+// and its world matrix in flat arrays.  Nodes are created after their
+// parent, so the arrays are already in parent-before-child order and
+// Update() is a single forward pass: a node's world matrix is rebuilt only
+// if its own local transform was set since the last Update() or its parent's
+// world matrix was rebuilt in this pass.  A static scene costs one flag test
+// per node per frame.
+//
+// Camera holds the view and projection parameters and rebuilds the
+// matrices only when a setter actually changes them, so calling SetLookAt()
+// every frame with the same values is free.
+//
+// ComputeWorldViewProj() produces world * view * proj for a list of nodes
+// (normally the visible ones) in one batched multiply.
+//=============================================================================
+
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include "Math3D.h"
+#include <vector>
+
+
+struct TransformStats
+{
+    unsigned nodes;
+    unsigned worldUpdates;      // world matrices rebuilt by the last Update()
+    unsigned wvpComputed;       // products made by ComputeWorldViewProj since ResetStats()
+};
+
+
+//===============================================================
+// Camera
+
+class Camera
+{
+public:
+    Camera();
+
+    void SetLookAt(const Vec3& eye, const Vec3& at, const Vec3& up);
+    void SetPerspective(float fovY, float aspect, float zn, float zf);
+
+    const Vec3& Eye() const { return m_eye; }
+    const Vec3& At() const  { return m_at; }
+    float NearZ() const     { return m_zn; }
+    float FarZ() const      { return m_zf; }
+
+    const Mat4& View() const;
+    const Mat4& Proj() const;
+    const Mat4& ViewProj() const;
+
+    // Bumped whenever the view or projection changes; lets callers keep
+    // anything derived from ViewProj() (frustum planes, cached products).
+    unsigned Version() const { return m_version; }
+
+private:
+    Vec3     m_eye, m_at, m_up;
+    float    m_fovY, m_aspect, m_zn, m_zf;
+    unsigned m_version;
+
+    mutable Mat4 m_view, m_proj, m_viewProj;
+    mutable bool m_viewDirty, m_projDirty, m_viewProjDirty;
+};
+
+
+//===============================================================
+// Hierarchy
+
+class TransformHierarchy
+{
+public:
+    static const int NO_PARENT = -1;
+
+    TransformHierarchy();
+
+    // Returns the new node's index.  parent must be NO_PARENT or an
+    // existing node.  The node starts at the identity.
+    int  CreateNode(int parent = NO_PARENT);
+    void Clear();
+    int  NumNodes() const { return (int)m_parents.size(); }
+    int  Parent(int node) const { return m_parents[node]; }
+
+    void SetLocal(int node, const Vec3& scale, const Quat& rotation, const Vec3& translation);
+    void SetScale(int node, const Vec3& scale)              { m_scales[node] = scale;         m_dirty[node] = 1; }
+    void SetRotation(int node, const Quat& rotation)        { m_rotations[node] = rotation;   m_dirty[node] = 1; }
+    void SetTranslation(int node, const Vec3& translation)  { m_translations[node] = translation; m_dirty[node] = 1; }
+
+    const Vec3& Scale(int node) const       { return m_scales[node]; }
+    const Quat& Rotation(int node) const    { return m_rotations[node]; }
+    const Vec3& Translation(int node) const { return m_translations[node]; }
+
+    // Rebuilds the world matrices of changed nodes and their descendants.
+    void Update();
+
+    // Valid after Update().  WorldChanged() is true if Update() rebuilt it.
+    const Mat4& World(int node) const     { return m_worlds[node]; }
+    const Mat4* Worlds() const            { return m_worlds.empty() ? NULL : &m_worlds[0]; }
+    bool        WorldChanged(int node) const { return m_changed[node] != 0; }
+
+    // out[i] = World(nodes[i]) * camera.ViewProj()
+    void ComputeWorldViewProj(const Camera& camera, const unsigned* nodes, size_t count, Mat4* out);
+
+    const TransformStats& Stats() const { return m_stats; }
+    void ResetStats() { m_stats.worldUpdates = 0; m_stats.wvpComputed = 0; }
+
+private:
+    std::vector<Vec3>          m_scales;
+    std::vector<Quat>          m_rotations;
+    std::vector<Vec3>          m_translations;
+    std::vector<int>           m_parents;
+    std::vector<unsigned char> m_dirty;     // local transform set since last Update()
+    std::vector<unsigned char> m_changed;   // world rebuilt by last Update()
+    std::vector<Mat4>          m_worlds;
+    TransformStats             m_stats;
+};
+
+#endif // TRANSFORM_H
@@ -0,0 +1,308 @@
+//=============================================================================
+// AssetPacker.cpp
+//
+// Builds an asset pack (see Common/AssetPack.h) from loose files.
+//
+//     AssetPacker [-align N] [-lz4] out.pak <file or directory>...
+//     AssetPacker -list in.pak
+//
+// A file is stored under its own name; the files of a directory are stored
+// under their path relative to that directory, so
+//
+//     AssetPacker -lz4 assets.pak ..\..\03.Matrices\vertex.fx ..\..\06.Meshes
+//
+// gives "vertex.fx", "tiger.x" and "tiger.bmp" (plus the sample's sources,
+// which do no harm).  -lz4 compresses every entry that shrinks by at least
+// 1/8; the rest are stored and can be used straight from the mapping.
+//=============================================================================
+
+#include "AssetPack.h"
+#include "FileUtil.h"
+#include "Lz4.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+
+struct InputFile
+{
+    std::string name;       // normalised entry name
+    std::string path;       // on disk
+};
+
+struct PackedFile
+{
+    std::string       name;
+    unsigned          flags;
+    unsigned long long size;
+    std::vector<char> stored;
+};
+
+
+static bool IsDirectory(const std::string& path)
+{
+#ifdef _WIN32
+    DWORD attr = GetFileAttributesA(path.c_str());
+    return attr != INVALID_FILE_ATTRIBUTES && (attr & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+}
+
+static void ListDirectory(const std::string& dir, const std::string& prefix,
+                          std::vector<InputFile>& files)
+{
+#ifdef _WIN32
+    WIN32_FIND_DATAA fd;
+    HANDLE hFind = FindFirstFileA((dir + "\\*").c_str(), &fd);
+    if (hFind == INVALID_HANDLE_VALUE)
+        return;
+
+    do
+    {
+        std::string name = fd.cFileName;
+#else
+    DIR* d = opendir(dir.c_str());
+    if (d == NULL)
+        return;
+
+    while (dirent* de = readdir(d))
+    {
+        std::string name = de->d_name;
+#endif
+        if (name == "." || name == "..")
+            continue;
+
+        std::string path = dir + PATH_SEPARATOR + name;
+        if (IsDirectory(path))
+        {
+            ListDirectory(path, prefix + name + "/", files);
+        }
+        else
+        {
+            InputFile f;
+            f.name = NormaliseAssetName((prefix + name).c_str());
+            f.path = path;
+            files.push_back(f);
+        }
+#ifdef _WIN32
+    } while (FindNextFileA(hFind, &fd));
+    FindClose(hFind);
+#else
+    }
+    closedir(d);
+#endif
+}
+
+static bool NameLess(const PackedFile& a, const PackedFile& b)
+{
+    return strcmp(a.name.c_str(), b.name.c_str()) < 0;
+}
+
+static unsigned long long AlignUp(unsigned long long v, unsigned alignment)
+{
+    return (v + alignment - 1) / alignment * alignment;
+}
+
+static bool WritePack(const char* outPath, std::vector<PackedFile>& files, unsigned alignment)
+{
+    std::sort(files.begin(), files.end(), NameLess);
+
+    for (size_t i = 1; i < files.size(); ++i)
+    {
+        if (files[i - 1].name == files[i].name)
+        {
+            fprintf(stderr, "duplicate entry \"%s\"\n", files[i].name.c_str());
+            return false;
+        }
+    }
+
+    PackHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic      = PACK_MAGIC;
+    header.version    = PACK_VERSION;
+    header.numEntries = (unsigned)files.size();
+    header.alignment  = alignment;
+
+    std::string names;
+    std::vector<PackEntry> entries(files.size());
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        entries[i].nameOffset = (unsigned)names.size();
+        names += files[i].name;
+        names += '\0';
+    }
+
+    header.namesOffset = (unsigned)(sizeof(PackHeader) + entries.size() * sizeof(PackEntry));
+    header.namesSize   = (unsigned)names.size();
+    header.dataOffset  = AlignUp(header.namesOffset + header.namesSize, alignment);
+
+    unsigned long long offset = header.dataOffset;
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        entries[i].flags      = files[i].flags;
+        entries[i].offset     = offset;
+        entries[i].size       = files[i].size;
+        entries[i].storedSize = files[i].stored.size();
+        offset = AlignUp(offset + entries[i].storedSize, alignment);
+    }
+    header.fileSize = files.empty() ? header.dataOffset
+                                    : entries.back().offset + entries.back().storedSize;
+
+    FILE* fp = fopen(outPath, "wb");
+    if (fp == NULL)
+    {
+        fprintf(stderr, "cannot create %s\n", outPath);
+        return false;
+    }
+
+    static const char zeros[4096] = { 0 };
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+    if (!entries.empty())
+        ok = ok && fwrite(&entries[0], sizeof(PackEntry), entries.size(), fp) == entries.size();
+    ok = ok && fwrite(names.data(), 1, names.size(), fp) == names.size();
+
+    unsigned long long pos = header.namesOffset + header.namesSize;
+    for (size_t i = 0; ok && i < files.size(); ++i)
+    {
+        while (ok && pos < entries[i].offset)
+        {
+            size_t pad = (size_t)std::min<unsigned long long>(entries[i].offset - pos, sizeof(zeros));
+            ok = fwrite(zeros, 1, pad, fp) == pad;
+            pos += pad;
+        }
+        if (!files[i].stored.empty())
+            ok = ok && fwrite(&files[i].stored[0], 1, files[i].stored.size(), fp) == files[i].stored.size();
+        pos += files[i].stored.size();
+    }
+
+    ok = fclose(fp) == 0 && ok;
+    if (!ok)
+        fprintf(stderr, "error writing %s\n", outPath);
+    return ok;
+}
+
+static int ListPack(const char* path)
+{
+    AssetPack pack;
+    if (!pack.Open(path))
+    {
+        fprintf(stderr, "%s is not a valid pack\n", path);
+        return 1;
+    }
+
+    for (unsigned i = 0; i < pack.NumEntries(); ++i)
+    {
+        const PackEntry* e = pack.Entry(i);
+        printf("%10llu %10llu %s %s\n", e->size, e->storedSize,
+               (e->flags & PACK_ENTRY_LZ4) ? "lz4   " : "stored", pack.EntryName(e));
+    }
+    return 0;
+}
+
+static void Usage()
+{
+    fprintf(stderr,
+            "usage: AssetPacker [-align N] [-lz4] out.pak <file or directory>...\n"
+            "       AssetPacker -list in.pak\n");
+}
+
+
+int main(int argc, char* argv[])
+{
+    unsigned alignment = PACK_DEFAULT_ALIGNMENT;
+    bool     compress  = false;
+    int      arg       = 1;
+
+    for (; arg < argc && argv[arg][0] == '-'; ++arg)
+    {
+        if (strcmp(argv[arg], "-list") == 0 && arg + 1 < argc)
+            return ListPack(argv[arg + 1]);
+        else if (strcmp(argv[arg], "-lz4") == 0)
+            compress = true;
+        else if (strcmp(argv[arg], "-align") == 0 && arg + 1 < argc)
+            alignment = (unsigned)atoi(argv[++arg]);
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    if (argc - arg < 2 || alignment == 0 || (alignment & (alignment - 1)) != 0)
+    {
+        Usage();
+        return 1;
+    }
+
+    const char* outPath = argv[arg++];
+
+    std::vector<InputFile> inputs;
+    for (; arg < argc; ++arg)
+    {
+        std::string path = argv[arg];
+        if (IsDirectory(path))
+        {
+            ListDirectory(path, "", inputs);
+        }
+        else
+        {
+            InputFile f;
+            f.name = NormaliseAssetName(FileNameOf(path).c_str());
+            f.path = path;
+            inputs.push_back(f);
+        }
+    }
+
+    std::vector<PackedFile> files(inputs.size());
+    unsigned long long totalSize = 0, totalStored = 0;
+    for (size_t i = 0; i < inputs.size(); ++i)
+    {
+        std::vector<char> bytes;
+        if (!ReadFileBytes(inputs[i].path.c_str(), bytes))
+        {
+            fprintf(stderr, "cannot read %s\n", inputs[i].path.c_str());
+            return 1;
+        }
+
+        PackedFile& f = files[i];
+        f.name  = inputs[i].name;
+        f.size  = bytes.size();
+        f.flags = 0;
+
+        if (compress && !bytes.empty())
+        {
+            std::vector<char> packed(Lz4CompressBound(bytes.size()));
+            size_t n = Lz4Compress(&bytes[0], bytes.size(), &packed[0], packed.size());
+            if (n != 0 && n <= bytes.size() - bytes.size() / 8)
+            {
+                packed.resize(n);
+                f.stored.swap(packed);
+                f.flags = PACK_ENTRY_LZ4;
+            }
+        }
+        if (f.flags == 0)
+            f.stored.swap(bytes);
+
+        totalSize   += f.size;
+        totalStored += f.stored.size();
+    }
+
+    if (!WritePack(outPath, files, alignment))
+        return 1;
+
+    printf("%s: %u entries, %llu bytes -> %llu bytes\n", outPath,
+           (unsigned)files.size(), totalSize, totalStored);
+    return 0;
+}
@@ -0,0 +1,308 @@
+//=============================================================================
+// BvhBench.cpp
+//
+// Builds a BVH (Common/Bvh.h) over a large scene and times it against the
+// linear SIMD culling pass.
+//
+//     BvhBench [-count N] [-threads N] [-queries N] [-tiger path]
+//
+// The scene is N instances (default 100000; try 1000000) alternating
+// between tiger.x from 06.Meshes and the 2x2x2 cube from 07.IndexBuffer,
+// each randomly turned about y and scattered with constant density.  The
+// tiger's positions are read straight from the text .x file so the tool
+// needs no D3DX.  Every BVH result is checked against brute force and
+// any difference makes the exit code 1.
+//=============================================================================
+
+#include "Bvh.h"
+#include "Culling.h"
+#include "FileUtil.h"
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+static unsigned s_errors = 0;
+
+static double Now()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+static float Random01()
+{
+    return (float)rand() / RAND_MAX;
+}
+
+
+//===============================================================
+// Meshes
+
+// Positions of the first Mesh in a text .x file:  Mesh name { N; x;y;z;, ... }
+static bool LoadXPositions(const char* path, std::vector<Vec3>& positions)
+{
+    std::vector<char> bytes;
+    if (!ReadFileBytes(path, bytes))
+        return false;
+    bytes.push_back('\0');
+
+    // Skip the "template Mesh" declaration.
+    const char* p = &bytes[0];
+    while ((p = strstr(p, "Mesh ")) != NULL)
+    {
+        if (p == &bytes[0] || (p[-1] != 'e' && p[-1] != 'M' && strncmp(p - 9, "template ", 9) != 0))
+            break;
+        p += 5;
+    }
+    if (p == NULL || (p = strchr(p, '{')) == NULL)
+        return false;
+
+    char* end = NULL;
+    long  count = strtol(p + 1, &end, 10);
+    if (end == p + 1 || count <= 0)
+        return false;
+
+    p = end;
+    positions.resize(count);
+    for (long i = 0; i < count; ++i)
+    {
+        float* v = &positions[i].x;
+        for (int k = 0; k < 3; ++k)
+        {
+            while (*p && (*p == ';' || *p == ',' || isspace((unsigned char)*p)))
+                ++p;
+            v[k] = (float)strtod(p, &end);
+            if (end == p)
+                return false;
+            p = end;
+        }
+    }
+    return true;
+}
+
+
+//===============================================================
+// Checks
+
+static void ExpectSameSet(const char* what, std::vector<unsigned> a, std::vector<unsigned> b)
+{
+    std::sort(a.begin(), a.end());
+    std::sort(b.begin(), b.end());
+    if (a != b)
+    {
+        fprintf(stderr, "mismatch: %s returned %u objects, brute force %u\n",
+                what, (unsigned)a.size(), (unsigned)b.size());
+        ++s_errors;
+    }
+}
+
+static Frustum QueryFrustum(unsigned q, unsigned numQueries, float worldSize)
+{
+    // A camera at the centre of the scene turning a full circle.
+    float angle = q * 2.0f * MATH_PI / numQueries;
+    Vec3  eye(0.0f, 2.0f, 0.0f), at(sinf(angle), 1.5f, cosf(angle));
+    Mat4  view = Mat4LookAtLH(eye, at, Vec3(0, 1, 0));
+    return Frustum(view * Mat4PerspectiveFovLH(MATH_PI / 4, 4.0f / 3.0f, 1.0f, worldSize * 0.25f));
+}
+
+static void Usage()
+{
+    fprintf(stderr, "usage: BvhBench [-count N] [-threads N] [-queries N] [-tiger path]\n");
+}
+
+
+int main(int argc, char* argv[])
+{
+    unsigned    count      = 100000;
+    unsigned    threads    = 0;
+    unsigned    numQueries = 64;
+    const char* tigerPath  = "../../06.Meshes/tiger.x";
+
+    for (int arg = 1; arg < argc; ++arg)
+    {
+        if (strcmp(argv[arg], "-count") == 0 && arg + 1 < argc)
+            count = (unsigned)atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-threads") == 0 && arg + 1 < argc)
+            threads = (unsigned)atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-queries") == 0 && arg + 1 < argc)
+            numQueries = (unsigned)atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-tiger") == 0 && arg + 1 < argc)
+            tigerPath = argv[++arg];
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+    if (count == 0 || numQueries == 0)
+    {
+        Usage();
+        return 1;
+    }
+
+    //--- Scene
+    std::vector<Vec3> tiger;
+    Aabb meshBoxes[2];
+    if (!LoadXPositions(tigerPath, tiger))
+    {
+        fprintf(stderr, "cannot read %s\n", tigerPath);
+        return 1;
+    }
+    ComputeBounds(&tiger[0], sizeof(Vec3), tiger.size(), &meshBoxes[0], NULL);
+    meshBoxes[1] = Aabb(Vec3(-1, -1, -1), Vec3(1, 1, 1));
+
+    float worldSize = 4.0f * powf((float)count, 1.0f / 3.0f);
+    srand(1);
+    std::vector<Mat4> worlds(count);
+    std::vector<Aabb> boxes(count);
+    for (unsigned i = 0; i < count; ++i)
+    {
+        Vec3 pos((Random01() - 0.5f) * worldSize, (Random01() - 0.5f) * worldSize, (Random01() - 0.5f) * worldSize);
+        worlds[i] = Mat4RotationY(Random01() * 2.0f * MATH_PI) * Mat4Translation(pos.x, pos.y, pos.z);
+        boxes[i]  = TransformAabb(meshBoxes[i & 1], worlds[i]);
+    }
+    printf("%u objects (tiger.x: %u vertices, cube), world %.0f units across\n",
+           count, (unsigned)tiger.size(), worldSize);
+
+    //--- Build
+    Bvh serial, bvh;
+    serial.Build(&boxes[0], count, 1);
+    bvh.Build(&boxes[0], count, threads);
+    const BvhStats& st = bvh.Stats();
+    unsigned usedThreads = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+    printf("build: %.2f ms serial, %.2f ms on %u threads (%.2fx)\n",
+           serial.Stats().buildMs, st.buildMs, usedThreads, serial.Stats().buildMs / st.buildMs);
+    printf("tree:  %u nodes, %u leaves, depth %u, SAH cost %.2f\n", st.nodes, st.leaves, st.depth, bvh.SahCost());
+
+    //--- Frustum queries: BVH vs linear SIMD pass
+    CullBounds linear;
+    linear.Resize(count);
+    for (unsigned i = 0; i < count; ++i)
+        linear.Set(i, boxes[i]);
+
+    std::vector<unsigned> bvhVisible, linearVisible;
+    double bvhMs = 0.0, linearMs = 0.0;
+    unsigned long long visible = 0, visited = 0;
+    for (unsigned q = 0; q < numQueries; ++q)
+    {
+        Frustum f = QueryFrustum(q, numQueries, worldSize);
+
+        double t0 = Now();
+        bvhVisible.clear();
+        bvh.QueryFrustum(f, bvhVisible);
+        double t1 = Now();
+        linear.CullBoxes(f, linearVisible);
+        double t2 = Now();
+
+        bvhMs    += t1 - t0;
+        linearMs += t2 - t1;
+        visible  += bvhVisible.size();
+        visited  += bvh.Stats().visitedNodes;
+        ExpectSameSet("QueryFrustum", bvhVisible, linearVisible);
+    }
+    printf("frustum: %.3f ms BVH, %.3f ms linear (%.1fx); %.0f visible, %.0f nodes visited per query\n",
+           bvhMs / numQueries, linearMs / numQueries, linearMs / bvhMs,
+           (double)visible / numQueries, (double)visited / numQueries);
+
+    //--- Refit: move 10% of the objects a little, as in an animated frame
+    double refitMs = 0.0;
+    unsigned refitNodes = 0;
+    const unsigned REFIT_FRAMES = 8;
+    for (unsigned frame = 0; frame < REFIT_FRAMES; ++frame)
+    {
+        for (unsigned i = frame % 10; i < count; i += 10)
+        {
+            Vec3 d((Random01() - 0.5f) * 0.5f, (Random01() - 0.5f) * 0.5f, (Random01() - 0.5f) * 0.5f);
+            boxes[i] = Aabb(boxes[i].min + d, boxes[i].max + d);
+            bvh.SetBox(i, boxes[i]);
+            linear.Set(i, boxes[i]);
+        }
+        bvh.Refit();
+        refitMs    += bvh.Stats().refitMs;
+        refitNodes += bvh.Stats().refitNodes;
+    }
+    Frustum f = QueryFrustum(0, numQueries, worldSize);
+    bvhVisible.clear();
+    bvh.QueryFrustum(f, bvhVisible);
+    linear.CullBoxes(f, linearVisible);
+    ExpectSameSet("QueryFrustum after Refit", bvhVisible, linearVisible);
+
+    serial.Build(&boxes[0], count, threads);
+    printf("refit: %.3f ms for %u moved objects (%u nodes); SAH cost %.2f, %.2f rebuilt\n",
+           refitMs / REFIT_FRAMES, (count + 9) / 10, refitNodes / REFIT_FRAMES, bvh.SahCost(), serial.SahCost());
+
+    //--- Rays: nearest hit and all hits, brute force for a sample
+    const unsigned NUM_RAYS = 10000, CHECKED_RAYS = 50;
+    double rayMs = 0.0;
+    unsigned hits = 0;
+    std::vector<unsigned> rayObjects, bruteObjects;
+    for (unsigned r = 0; r < NUM_RAYS; ++r)
+    {
+        Vec3 origin((Random01() - 0.5f) * worldSize, (Random01() - 0.5f) * worldSize, (Random01() - 0.5f) * worldSize);
+        Vec3 dir = Vec3Normalize(Vec3(Random01() - 0.5f, Random01() - 0.5f, Random01() - 0.5f));
+        float maxT = worldSize;
+
+        double t0 = Now();
+        RayHit hit;
+        bool found = bvh.Raycast(origin, dir, maxT, &hit);
+        rayMs += Now() - t0;
+        hits  += found;
+
+        if (r >= CHECKED_RAYS)
+            continue;
+
+        rayObjects.clear();
+        bvh.QueryRay(origin, dir, maxT, rayObjects);
+
+        // Brute force through a one-object tree per box would be slow;
+        // use the slab test directly.
+        bruteObjects.clear();
+        float bestT = maxT;
+        bool  bruteFound = false;
+        for (unsigned i = 0; i < count; ++i)
+        {
+            float tmin = 0.0f, tmax = maxT;
+            for (int k = 0; k < 3; ++k)
+            {
+                float o = (&origin.x)[k], dk = (&dir.x)[k];
+                float lo = (&boxes[i].min.x)[k], hi = (&boxes[i].max.x)[k];
+                float inv = dk != 0.0f ? 1.0f / dk : 1e30f;
+                float t0k = (lo - o) * inv, t1k = (hi - o) * inv;
+                tmin = std::max(tmin, std::min(t0k, t1k));
+                tmax = std::min(tmax, std::max(t0k, t1k));
+            }
+            if (tmin <= tmax)
+            {
+                bruteObjects.push_back(i);
+                if (tmin < bestT || !bruteFound)
+                {
+                    bestT = tmin;
+                    bruteFound = true;
+                }
+            }
+        }
+        ExpectSameSet("QueryRay", rayObjects, bruteObjects);
+        if (found != bruteFound || (found && fabsf(hit.t - bestT) > 1e-4f * (1.0f + bestT)))
+        {
+            fprintf(stderr, "mismatch: Raycast %d t=%g, brute force %d t=%g\n",
+                    found, found ? hit.t : 0.0f, bruteFound, bestT);
+            ++s_errors;
+        }
+    }
+    printf("rays: %.2f us per nearest-hit query, %u of %u hit\n", rayMs * 1000.0 / NUM_RAYS, hits, NUM_RAYS);
+
+    if (s_errors)
+    {
+        printf("%u mismatches\n", s_errors);
+        return 1;
+    }
+    printf("all results match\n");
+    return 0;
+}
@@ -0,0 +1,644 @@
+//=============================================================================
+// CaptureReplay.cpp
+//
+// Plays back a device capture written by a sample started with
+// "-capture file.d9c" (DeviceCapture.h), as fast as it can, and reports
+// the frame times.
+//
+//     CaptureReplay file.d9c [-loops N] [-size WxH] [-out last.bmp]
+//                            [-hashes out.txt] [-check hashes.txt]
+//                            [-device] [-dump]
+//
+// By default the capture is drawn by the software rasterizer (SoftReplay.h),
+// which works on any platform and gives the same pixels on every run:
+//
+//   -hashes   writes the hash of every frame, one per line
+//   -check    compares against such a file and returns non-zero on a
+//             difference, for regression tests
+//   -out      saves the last frame
+//
+// Every loop is checked against the first, so a replay that is not
+// deterministic fails too.  -device (Windows only) replays on a D3D9 device
+// instead, with vsync off.  -dump prints every call instead of drawing.
+//=============================================================================
+
+#include "CaptureFile.h"
+#include "SoftReplay.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <d3d9.h>
+#endif
+
+
+static void Usage()
+{
+    fprintf(stderr,
+            "usage: CaptureReplay file.d9c [-loops N] [-size WxH] [-out last.bmp]\n"
+            "                              [-hashes out.txt] [-check hashes.txt] [-device] [-dump]\n");
+}
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double MillisecondsSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+
+//===============================================================
+// Frame times, taken at every CAPTURE_FRAME record
+
+class FrameTimes
+{
+public:
+    FrameTimes() : m_last(Clock::now()) {}
+
+    void Restart()  { m_last = Clock::now(); }
+    void Frame()
+    {
+        Clock::time_point now = Clock::now();
+        m_ms.push_back(std::chrono::duration<double, std::milli>(now - m_last).count());
+        m_last = now;
+    }
+
+    void Report(const char* name)
+    {
+        if (m_ms.empty())
+            return;
+        std::vector<double> sorted(m_ms);
+        std::sort(sorted.begin(), sorted.end());
+        double total = 0.0;
+        for (size_t i = 0; i < sorted.size(); ++i)
+            total += sorted[i];
+        printf("%s: %u frames in %.1f ms, %.3f ms/frame (p50 %.3f, p99 %.3f, max %.3f), %.0f frames/s\n",
+               name, (unsigned)sorted.size(), total, total / sorted.size(), sorted[sorted.size() / 2],
+               sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)], sorted.back(),
+               total > 0.0 ? 1000.0 * sorted.size() / total : 0.0);
+    }
+
+private:
+    Clock::time_point   m_last;
+    std::vector<double> m_ms;
+};
+
+
+// SoftReplay that also times its frames.  CaptureFile::Replay is a template,
+// so this EndFrame() is the one it calls.
+class TimedSoftReplay : public SoftReplay
+{
+public:
+    FrameTimes times;
+
+    void EndFrame(unsigned frame)
+    {
+        SoftReplay::EndFrame(frame);
+        times.Frame();
+    }
+};
+
+
+//===============================================================
+// -dump
+
+class DumpTarget
+{
+public:
+    void EndFrame(unsigned frame)                                  { printf("--- end of frame %u\n", frame); }
+    void CreateVertexBuffer(unsigned id, unsigned bytes, unsigned fvf) { printf("vertex buffer #%u: %u bytes, fvf 0x%x\n", id, bytes, fvf); }
+    void CreateIndexBuffer(unsigned id, unsigned bytes, unsigned size) { printf("index buffer #%u: %u bytes, %u-byte indices\n", id, bytes, size); }
+    void BufferData(unsigned id, unsigned offset, const void*, unsigned bytes, unsigned flags)
+                                                                   { printf("  data #%u [%u, %u) flags 0x%x\n", id, offset, offset + bytes, flags); }
+    void CreateShader(unsigned id, bool pixel, const unsigned* p, unsigned bytes)
+                                                                   { printf("%s shader #%u: %u bytes, version 0x%08x\n", pixel ? "pixel" : "vertex", id, bytes, bytes >= 4 ? p[0] : 0); }
+    void CreateDeclaration(unsigned id, const CaptureVertexElement* pElements, unsigned count)
+    {
+        printf("declaration #%u:", id);
+        for (unsigned i = 0; i < count && pElements[i].stream != 0xFF; ++i)
+            printf(" [%u+%u type %u usage %u/%u]", pElements[i].stream, pElements[i].offset, pElements[i].type,
+                   pElements[i].usage, pElements[i].usageIndex);
+        printf("\n");
+    }
+    void CreateMesh(const CaptureMesh& m, const CaptureAttributeRange*)
+                                                                   { printf("mesh #%u: vb #%u, ib #%u, fvf 0x%x, %u ranges\n", m.id, m.vertexBuffer, m.indexBuffer, m.fvf, m.numRanges); }
+    void Clear(unsigned flags, unsigned color, float z, unsigned)  { printf("  Clear 0x%x 0x%08x %g\n", flags, color, z); }
+    void SetRenderState(unsigned state, unsigned value)            { printf("  SetRenderState %u = 0x%x\n", state, value); }
+    void SetTexture(unsigned sampler, unsigned texture)            { printf("  SetTexture %u #%u\n", sampler, texture); }
+    void SetSamplerState(unsigned s, unsigned state, unsigned v)   { printf("  SetSamplerState %u %u = 0x%x\n", s, state, v); }
+    void SetTextureStageState(unsigned s, unsigned state, unsigned v) { printf("  SetTextureStageState %u %u = 0x%x\n", s, state, v); }
+    void SetStreamSource(unsigned s, unsigned b, unsigned o, unsigned stride) { printf("  SetStreamSource %u #%u +%u stride %u\n", s, b, o, stride); }
+    void SetStreamSourceFreq(unsigned s, unsigned setting)         { printf("  SetStreamSourceFreq %u 0x%x\n", s, setting); }
+    void SetIndices(unsigned b)                                    { printf("  SetIndices #%u\n", b); }
+    void SetFVF(unsigned fvf)                                      { printf("  SetFVF 0x%x\n", fvf); }
+    void SetVertexDeclaration(unsigned d)                          { printf("  SetVertexDeclaration #%u\n", d); }
+    void SetVertexShader(unsigned s)                               { printf("  SetVertexShader #%u\n", s); }
+    void SetPixelShader(unsigned s)                                { printf("  SetPixelShader #%u\n", s); }
+    void SetVertexShaderConstantF(unsigned first, const float*, unsigned count) { printf("  SetVertexShaderConstantF c%u..c%u\n", first, first + count - 1); }
+    void SetPixelShaderConstantF(unsigned first, const float*, unsigned count)  { printf("  SetPixelShaderConstantF c%u..c%u\n", first, first + count - 1); }
+    void SetTransform(unsigned state, const float* m)              { printf("  SetTransform %u [%g %g %g ...]\n", state, m[0], m[1], m[2]); }
+    void SetMaterial(const CaptureMaterial& m)                     { printf("  SetMaterial diffuse %g %g %g %g\n", m.diffuse[0], m.diffuse[1], m.diffuse[2], m.diffuse[3]); }
+    void SetLight(unsigned index, const CaptureLight& l)           { printf("  SetLight %u type %u diffuse %g %g %g\n", index, l.type, l.diffuse[0], l.diffuse[1], l.diffuse[2]); }
+    void LightEnable(unsigned index, bool enable)                  { printf("  LightEnable %u %d\n", index, enable ? 1 : 0); }
+    void SetViewport(const CaptureViewport& v)                     { printf("  SetViewport %u %u %ux%u z %g..%g\n", v.x, v.y, v.width, v.height, v.minZ, v.maxZ); }
+    void SetScissorRect(const CaptureRect& r)                      { printf("  SetScissorRect %d %d %d %d\n", r.left, r.top, r.right, r.bottom); }
+    void SetClipPlane(unsigned index, const float* p)              { printf("  SetClipPlane %u [%g %g %g %g]\n", index, p[0], p[1], p[2], p[3]); }
+    void SetMatrix(unsigned effect, const char* name, const float*, unsigned count) { printf("  SetMatrix effect #%u %s x%u\n", effect, name, count); }
+    void DrawPrimitive(unsigned type, unsigned start, unsigned count) { printf("  DrawPrimitive type %u start %u, %u primitives\n", type, start, count); }
+    void DrawIndexedPrimitive(unsigned type, int base, unsigned minIndex, unsigned numVertices, unsigned startIndex, unsigned count)
+                                                                   { printf("  DrawIndexedPrimitive type %u base %d vertices [%u, %u) start %u, %u primitives\n", type, base, minIndex, minIndex + numVertices, startIndex, count); }
+    void DrawSubset(unsigned mesh, unsigned attribute)             { printf("  DrawSubset #%u attribute %u\n", mesh, attribute); }
+};
+
+
+//===============================================================
+// -device
+
+#ifdef _WIN32
+
+static_assert(sizeof(D3DLIGHT9) == sizeof(CaptureLight), "D3DLIGHT9 layout");
+static_assert(sizeof(D3DMATERIAL9) == sizeof(CaptureMaterial), "D3DMATERIAL9 layout");
+static_assert(sizeof(D3DVERTEXELEMENT9) == sizeof(CaptureVertexElement), "D3DVERTEXELEMENT9 layout");
+
+// Recreates the captured objects on a device and sends it the calls.
+// Textures are bound as one white texel, like the software replay.
+class DeviceReplay
+{
+public:
+    FrameTimes times;
+
+    DeviceReplay() : m_pDevice(NULL), m_pWhite(NULL), m_inScene(false), m_failed(0) {}
+    ~DeviceReplay() { Release(); }
+
+    bool Create(IDirect3D9* pD3D, HWND hWnd, unsigned width, unsigned height)
+    {
+        D3DPRESENT_PARAMETERS d3dpp;
+        ZeroMemory(&d3dpp, sizeof(d3dpp));
+        d3dpp.Windowed               = TRUE;
+        d3dpp.SwapEffect             = D3DSWAPEFFECT_DISCARD;
+        d3dpp.BackBufferFormat       = D3DFMT_UNKNOWN;
+        d3dpp.BackBufferWidth        = width;
+        d3dpp.BackBufferHeight       = height;
+        d3dpp.EnableAutoDepthStencil = TRUE;
+        d3dpp.AutoDepthStencilFormat = D3DFMT_D16;
+        d3dpp.PresentationInterval   = D3DPRESENT_INTERVAL_IMMEDIATE;
+        if (FAILED(pD3D->CreateDevice(D3DADAPTER_DEFAULT, D3DDEVTYPE_HAL, hWnd,
+                                      D3DCREATE_HARDWARE_VERTEXPROCESSING, &d3dpp, &m_pDevice)))
+            return false;
+
+        if (SUCCEEDED(m_pDevice->CreateTexture(1, 1, 1, 0, D3DFMT_A8R8G8B8, D3DPOOL_MANAGED, &m_pWhite, NULL)))
+        {
+            D3DLOCKED_RECT r;
+            if (SUCCEEDED(m_pWhite->LockRect(0, &r, NULL, 0)))
+            {
+                *(DWORD*)r.pBits = 0xffffffff;
+                m_pWhite->UnlockRect(0);
+            }
+        }
+        return true;
+    }
+
+    // Drops the captured objects, to replay again.
+    void Reset()
+    {
+        for (size_t i = 0; i < m_objects.size(); ++i)
+        {
+            if (m_objects[i])
+                m_objects[i]->Release();
+        }
+        m_objects.clear();
+        m_meshes.clear();
+    }
+
+    void Release()
+    {
+        Reset();
+        if (m_pWhite)
+            m_pWhite->Release();
+        if (m_pDevice)
+            m_pDevice->Release();
+        m_pWhite  = NULL;
+        m_pDevice = NULL;
+    }
+
+    unsigned Failed() const { return m_failed; }
+
+    void EndFrame(unsigned)
+    {
+        Scene();
+        m_pDevice->EndScene();
+        m_pDevice->Present(NULL, NULL, NULL, NULL);
+        m_inScene = false;
+        times.Frame();
+    }
+
+    void CreateVertexBuffer(unsigned id, unsigned bytes, unsigned fvf)
+    {
+        IDirect3DVertexBuffer9* pVB = NULL;
+        Check(m_pDevice->CreateVertexBuffer(bytes, D3DUSAGE_WRITEONLY, fvf, D3DPOOL_MANAGED, &pVB, NULL));
+        Set(id, pVB);
+    }
+
+    void CreateIndexBuffer(unsigned id, unsigned bytes, unsigned indexSize)
+    {
+        IDirect3DIndexBuffer9* pIB = NULL;
+        Check(m_pDevice->CreateIndexBuffer(bytes, D3DUSAGE_WRITEONLY, indexSize == 4 ? D3DFMT_INDEX32 : D3DFMT_INDEX16,
+                                           D3DPOOL_MANAGED, &pIB, NULL));
+        Set(id, pIB);
+    }
+
+    void BufferData(unsigned id, unsigned offset, const void* pData, unsigned bytes, unsigned)
+    {
+        IUnknown* p = Get(id);
+        if (p == NULL || bytes == 0)
+            return;
+
+        // The capture does not say which kind of buffer an id is; ask.
+        void* pDest = NULL;
+        IDirect3DVertexBuffer9* pVB = NULL;
+        IDirect3DIndexBuffer9*  pIB = NULL;
+        if (SUCCEEDED(p->QueryInterface(IID_IDirect3DVertexBuffer9, (void**)&pVB)))
+        {
+            if (SUCCEEDED(pVB->Lock(offset, bytes, &pDest, 0)))
+            {
+                memcpy(pDest, pData, bytes);
+                pVB->Unlock();
+            }
+            pVB->Release();
+        }
+        else if (SUCCEEDED(p->QueryInterface(IID_IDirect3DIndexBuffer9, (void**)&pIB)))
+        {
+            if (SUCCEEDED(pIB->Lock(offset, bytes, &pDest, 0)))
+            {
+                memcpy(pDest, pData, bytes);
+                pIB->Unlock();
+            }
+            pIB->Release();
+        }
+    }
+
+    void CreateShader(unsigned id, bool pixelShader, const unsigned* pTokens, unsigned)
+    {
+        if (pixelShader)
+        {
+            IDirect3DPixelShader9* pPS = NULL;
+            Check(m_pDevice->CreatePixelShader((const DWORD*)pTokens, &pPS));
+            Set(id, pPS);
+        }
+        else
+        {
+            IDirect3DVertexShader9* pVS = NULL;
+            Check(m_pDevice->CreateVertexShader((const DWORD*)pTokens, &pVS));
+            Set(id, pVS);
+        }
+    }
+
+    void CreateDeclaration(unsigned id, const CaptureVertexElement* pElements, unsigned count)
+    {
+        // The captured elements end with D3DDECL_END, as GetDeclaration() returns them.
+        std::vector<D3DVERTEXELEMENT9> elements(count);
+        if (count != 0)
+            memcpy(&elements[0], pElements, count * sizeof(D3DVERTEXELEMENT9));
+        D3DVERTEXELEMENT9 end = D3DDECL_END();
+        if (count == 0 || elements.back().Stream != 0xFF)
+            elements.push_back(end);
+
+        IDirect3DVertexDeclaration9* pDecl = NULL;
+        Check(m_pDevice->CreateVertexDeclaration(&elements[0], &pDecl));
+        Set(id, pDecl);
+    }
+
+    void CreateMesh(const CaptureMesh& mesh, const CaptureAttributeRange* pRanges)
+    {
+        Mesh& m = m_meshes[mesh.id];
+        m.desc = mesh;
+        m.ranges.assign(pRanges, pRanges + mesh.numRanges);
+    }
+
+    void Clear(unsigned flags, unsigned color, float z, unsigned stencil)
+    {
+        Scene();
+        m_pDevice->Clear(0, NULL, flags, color, z, stencil);
+    }
+
+    void SetRenderState(unsigned state, unsigned value)     { m_pDevice->SetRenderState((D3DRENDERSTATETYPE)state, value); }
+    void SetTexture(unsigned sampler, unsigned texture)     { m_pDevice->SetTexture(sampler, texture ? m_pWhite : NULL); }
+    void SetSamplerState(unsigned s, unsigned state, unsigned v)      { m_pDevice->SetSamplerState(s, (D3DSAMPLERSTATETYPE)state, v); }
+    void SetTextureStageState(unsigned s, unsigned state, unsigned v) { m_pDevice->SetTextureStageState(s, (D3DTEXTURESTAGESTATETYPE)state, v); }
+    void SetStreamSource(unsigned stream, unsigned buffer, unsigned offset, unsigned stride)
+                                                            { m_pDevice->SetStreamSource(stream, (IDirect3DVertexBuffer9*)Get(buffer), offset, stride); }
+    void SetStreamSourceFreq(unsigned stream, unsigned setting) { m_pDevice->SetStreamSourceFreq(stream, setting); }
+    void SetIndices(unsigned buffer)                        { m_pDevice->SetIndices((IDirect3DIndexBuffer9*)Get(buffer)); }
+    void SetFVF(unsigned fvf)                               { m_pDevice->SetFVF(fvf); }
+    void SetVertexDeclaration(unsigned d)                   { m_pDevice->SetVertexDeclaration((IDirect3DVertexDeclaration9*)Get(d)); }
+    void SetVertexShader(unsigned s)                        { m_pDevice->SetVertexShader((IDirect3DVertexShader9*)Get(s)); }
+    void SetPixelShader(unsigned s)                         { m_pDevice->SetPixelShader((IDirect3DPixelShader9*)Get(s)); }
+    void SetVertexShaderConstantF(unsigned first, const float* p, unsigned count) { m_pDevice->SetVertexShaderConstantF(first, p, count); }
+    void SetPixelShaderConstantF(unsigned first, const float* p, unsigned count)  { m_pDevice->SetPixelShaderConstantF(first, p, count); }
+    void SetTransform(unsigned state, const float* m)       { m_pDevice->SetTransform((D3DTRANSFORMSTATETYPE)state, (const D3DMATRIX*)m); }
+    void SetMaterial(const CaptureMaterial& m)              { m_pDevice->SetMaterial((const D3DMATERIAL9*)&m); }
+    void SetLight(unsigned index, const CaptureLight& l)    { m_pDevice->SetLight(index, (const D3DLIGHT9*)&l); }
+    void LightEnable(unsigned index, bool enable)           { m_pDevice->LightEnable(index, enable); }
+    void SetViewport(const CaptureViewport& v)
+    {
+        D3DVIEWPORT9 viewport = { v.x, v.y, v.width, v.height, v.minZ, v.maxZ };
+        m_pDevice->SetViewport(&viewport);
+    }
+    void SetScissorRect(const CaptureRect& r)
+    {
+        RECT rect = { r.left, r.top, r.right, r.bottom };
+        m_pDevice->SetScissorRect(&rect);
+    }
+    void SetClipPlane(unsigned index, const float* p)       { m_pDevice->SetClipPlane(index, p); }
+    void SetMatrix(unsigned, const char*, const float*, unsigned) {}    // reaches the device as constants
+
+    void DrawPrimitive(unsigned type, unsigned start, unsigned count)
+    {
+        Scene();
+        m_pDevice->DrawPrimitive((D3DPRIMITIVETYPE)type, start, count);
+    }
+
+    void DrawIndexedPrimitive(unsigned type, int base, unsigned minIndex, unsigned numVertices,
+                              unsigned startIndex, unsigned count)
+    {
+        Scene();
+        m_pDevice->DrawIndexedPrimitive((D3DPRIMITIVETYPE)type, base, minIndex, numVertices, startIndex, count);
+    }
+
+    void DrawSubset(unsigned mesh, unsigned attribute)
+    {
+        std::map<unsigned, Mesh>::const_iterator it = m_meshes.find(mesh);
+        if (it == m_meshes.end())
+            return;
+
+        const Mesh& m = it->second;
+        SetStreamSource(0, m.desc.vertexBuffer, 0, m.desc.stride);
+        SetIndices(m.desc.indexBuffer);
+        SetFVF(m.desc.fvf);
+        for (size_t r = 0; r < m.ranges.size(); ++r)
+        {
+            const CaptureAttributeRange& range = m.ranges[r];
+            if (range.attribute == attribute && range.faceCount != 0)
+                DrawIndexedPrimitive(D3DPT_TRIANGLELIST, 0, range.vertexStart, range.vertexCount,
+                                     range.faceStart * 3, range.faceCount);
+        }
+    }
+
+private:
+    struct Mesh
+    {
+        CaptureMesh                        desc;
+        std::vector<CaptureAttributeRange> ranges;
+    };
+
+    void Scene()
+    {
+        if (!m_inScene)
+            m_inScene = SUCCEEDED(m_pDevice->BeginScene());
+    }
+
+    void Check(HRESULT hr)
+    {
+        if (FAILED(hr))
+            ++m_failed;
+    }
+
+    void Set(unsigned id, IUnknown* p)
+    {
+        if (id >= m_objects.size())
+            m_objects.resize(id + 1, NULL);
+        if (m_objects[id])
+            m_objects[id]->Release();
+        m_objects[id] = p;
+    }
+
+    IUnknown* Get(unsigned id) const { return id < m_objects.size() ? m_objects[id] : NULL; }
+
+    IDirect3DDevice9*        m_pDevice;
+    IDirect3DTexture9*       m_pWhite;
+    std::vector<IUnknown*>   m_objects;     // by capture id
+    std::map<unsigned, Mesh> m_meshes;
+    bool                     m_inScene;
+    unsigned                 m_failed;
+};
+
+static int ReplayOnDevice(const CaptureFile& capture, unsigned loops, unsigned width, unsigned height)
+{
+    WNDCLASSEX wc = { sizeof(WNDCLASSEX), CS_CLASSDC, DefWindowProc, 0L, 0L,
+                      GetModuleHandle(NULL), NULL, NULL, NULL, NULL, "CaptureReplay", NULL };
+    RegisterClassEx(&wc);
+    HWND hWnd = CreateWindow("CaptureReplay", "CaptureReplay", WS_OVERLAPPEDWINDOW, 100, 100,
+                             width, height, GetDesktopWindow(), NULL, wc.hInstance, NULL);
+
+    IDirect3D9*  pD3D = Direct3DCreate9(D3D_SDK_VERSION);
+    DeviceReplay replay;
+    if (pD3D == NULL || !replay.Create(pD3D, hWnd, width, height))
+    {
+        fprintf(stderr, "cannot create a Direct3D 9 device\n");
+        if (pD3D)
+            pD3D->Release();
+        return 1;
+    }
+    ShowWindow(hWnd, SW_SHOWDEFAULT);
+
+    for (unsigned loop = 0; loop < loops; ++loop)
+    {
+        replay.Reset();
+        replay.times.Restart();
+        capture.Replay(replay);
+    }
+    replay.times.Report("device");
+    if (replay.Failed())
+        printf("%u objects could not be created\n", replay.Failed());
+
+    replay.Release();
+    pD3D->Release();
+    DestroyWindow(hWnd);
+    UnregisterClass("CaptureReplay", wc.hInstance);
+    return 0;
+}
+
+#endif // _WIN32
+
+
+//===============================================================
+// Frame hashes
+
+static bool WriteHashes(const char* path, const std::vector<unsigned long long>& hashes)
+{
+    FILE* pFile = fopen(path, "w");
+    if (pFile == NULL)
+        return false;
+    for (size_t i = 0; i < hashes.size(); ++i)
+        fprintf(pFile, "%016llx\n", hashes[i]);
+    return fclose(pFile) == 0;
+}
+
+static bool ReadHashes(const char* path, std::vector<unsigned long long>& hashes)
+{
+    FILE* pFile = fopen(path, "r");
+    if (pFile == NULL)
+        return false;
+    unsigned long long h;
+    while (fscanf(pFile, "%llx", &h) == 1)
+        hashes.push_back(h);
+    fclose(pFile);
+    return true;
+}
+
+// Number of frames that differ, counting missing and extra frames.
+static unsigned CompareHashes(const std::vector<unsigned long long>& a, const std::vector<unsigned long long>& b,
+                              const char* what)
+{
+    unsigned differ = 0;
+    for (size_t i = 0; i < std::max(a.size(), b.size()); ++i)
+    {
+        if (i < a.size() && i < b.size() && a[i] == b[i])
+            continue;
+        if (differ++ < 8)
+            printf("frame %u differs from %s\n", (unsigned)i, what);
+    }
+    return differ;
+}
+
+
+//===============================================================
+
+int main(int argc, char* argv[])
+{
+    const char* capturePath = NULL;
+    const char* outPath = NULL;
+    const char* hashesPath = NULL;
+    const char* checkPath = NULL;
+    unsigned    loops = 1, width = 300, height = 300;
+    bool        device = false, dump = false;
+
+    for (int arg = 1; arg < argc; ++arg)
+    {
+        if (strcmp(argv[arg], "-loops") == 0 && arg + 1 < argc)
+            loops = (unsigned)atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-size") == 0 && arg + 1 < argc)
+        {
+            if (sscanf(argv[++arg], "%ux%u", &width, &height) != 2)
+            {
+                Usage();
+                return 1;
+            }
+        }
+        else if (strcmp(argv[arg], "-out") == 0 && arg + 1 < argc)
+            outPath = argv[++arg];
+        else if (strcmp(argv[arg], "-hashes") == 0 && arg + 1 < argc)
+            hashesPath = argv[++arg];
+        else if (strcmp(argv[arg], "-check") == 0 && arg + 1 < argc)
+            checkPath = argv[++arg];
+        else if (strcmp(argv[arg], "-device") == 0)
+            device = true;
+        else if (strcmp(argv[arg], "-dump") == 0)
+            dump = true;
+        else if (argv[arg][0] != '-' && capturePath == NULL)
+            capturePath = argv[arg];
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+    if (capturePath == NULL)
+    {
+        Usage();
+        return 1;
+    }
+    if (loops == 0)
+        loops = 1;
+
+    CaptureFile capture;
+    std::string error;
+    Clock::time_point start = Clock::now();
+    if (!capture.Load(capturePath, &error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    printf("%s: %u frames, %u records, %u draws, %.1f KB (%.1f KB unpacked), loaded in %.1f ms\n",
+           capturePath, capture.NumFrames(), capture.NumRecords(),
+           capture.NumRecords(CAPTURE_DRAW_PRIMITIVE) + capture.NumRecords(CAPTURE_DRAW_INDEXED_PRIMITIVE) +
+               capture.NumRecords(CAPTURE_DRAW_SUBSET),
+           capture.FileBytes() / 1024.0, capture.RawBytes() * sizeof(unsigned) / 1024.0, MillisecondsSince(start));
+
+    if (dump)
+    {
+        DumpTarget target;
+        capture.Replay(target);
+        return 0;
+    }
+
+    if (device)
+    {
+#ifdef _WIN32
+        return ReplayOnDevice(capture, loops, width, height);
+#else
+        fprintf(stderr, "-device needs Direct3D 9\n");
+        return 1;
+#endif
+    }
+
+    TimedSoftReplay replay;
+    if (!replay.SetRenderTarget(width, height))
+    {
+        Usage();
+        return 1;
+    }
+
+    std::vector<unsigned long long> firstLoop;
+    unsigned nondeterministic = 0;
+    for (unsigned loop = 0; loop < loops; ++loop)
+    {
+        replay.Reset();
+        replay.times.Restart();
+        capture.Replay(replay);
+
+        if (loop == 0)
+            firstLoop = replay.FrameHashes();
+        else
+            nondeterministic += CompareHashes(replay.FrameHashes(), firstLoop, "the first loop");
+    }
+    replay.times.Report("soft");
+
+    const SoftReplayStats& s = replay.Stats();
+    const SoftRasterStats& r = replay.Rasterizer().Stats();
+    printf("last loop: %llu draws (%llu skipped), %llu triangles, %llu pixels, %u shaders not loaded\n",
+           s.draws, s.skipped, s.triangles, r.pixels, s.shaderErrors);
+
+    int result = nondeterministic ? 1 : 0;
+    if (outPath && !replay.Rasterizer().SaveBmp(outPath))
+    {
+        fprintf(stderr, "cannot write %s\n", outPath);
+        result = 1;
+    }
+    if (hashesPath && !WriteHashes(hashesPath, replay.FrameHashes()))
+    {
+        fprintf(stderr, "cannot write %s\n", hashesPath);
+        result = 1;
+    }
+    if (checkPath)
+    {
+        std::vector<unsigned long long> expected;
+        if (!ReadHashes(checkPath, expected))
+        {
+            fprintf(stderr, "cannot read %s\n", checkPath);
+            return 1;
+        }
+        unsigned differ = CompareHashes(replay.FrameHashes(), expected, checkPath);
+        printf("check: %u of %u frames differ\n", differ, (unsigned)std::max(expected.size(), replay.FrameHashes().size()));
+        if (differ)
+            result = 1;
+    }
+    return result;
+}
@@ -0,0 +1,357 @@
+//=============================================================================
+// DynamicBufferBench.cpp
+//
+// Stress test for the dynamic geometry ring (Common/DynamicBuffer.h).
+//
+//     DynamicBufferBench [-mb N] [-quads N] [-ring MB] [-frames N] [-mode ring|discard|static|all]
+//
+// Every frame streams N MB (default 16) of freshly generated quads through
+// the device: each batch of -quads quads (default 2048, 16-byte vertices
+// and 16-bit indices) is written and drawn with DrawIndexedPrimitive
+// before the next one is written.  The same frames are run with
+//
+//     ring     DynamicVertexBuffer/DynamicIndexBuffer of -ring MB
+//              (default 4): NOOVERWRITE appends, DISCARD on wrap
+//     discard  the same buffers with every batch discarding
+//     static   one batch-sized D3DPOOL_DEFAULT buffer refilled with
+//              Lock(0, ...), the way the samples fill their buffers
+//
+// and the time per frame, throughput and time spent inside Lock() are
+// printed for each.  The device renders into a hidden window with vsync
+// off, so the numbers include the driver's waits for the GPU.
+//=============================================================================
+
+#include "DynamicBuffer.h"
+#include <Windows.h>
+#include <d3d9.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+
+static double Now()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+
+struct Vertex
+{
+    float x, y, z;
+    DWORD color;
+};
+
+static const DWORD VERTEX_FVF = D3DFVF_XYZ | D3DFVF_DIFFUSE;
+
+
+//===============================================================
+// Geometry
+
+// Quads [first, first + count) of a frame, scattered over the screen and
+// moving with time, so every batch's data really changes.
+static void WriteQuads(Vertex* pV, WORD* pI, unsigned first, unsigned count, float time)
+{
+    for (unsigned q = 0; q < count; ++q)
+    {
+        unsigned n = first + q;
+        float cx = sinf(n * 0.37f + time) * 0.9f;
+        float cy = cosf(n * 0.53f + time * 1.3f) * 0.9f;
+        float s  = 0.01f;
+        DWORD c  = 0xff000000 | ((n * 2654435761u) & 0x00ffffff);
+
+        Vertex* v = pV + q * 4;
+        v[0].x = cx - s; v[0].y = cy - s;
+        v[1].x = cx - s; v[1].y = cy + s;
+        v[2].x = cx + s; v[2].y = cy + s;
+        v[3].x = cx + s; v[3].y = cy - s;
+        for (int k = 0; k < 4; ++k)
+        {
+            v[k].z     = 0.5f;
+            v[k].color = c;
+        }
+
+        WORD  b = (WORD)(q * 4);
+        WORD* i = pI + q * 6;
+        i[0] = b; i[1] = (WORD)(b + 1); i[2] = (WORD)(b + 2);
+        i[3] = b; i[4] = (WORD)(b + 2); i[5] = (WORD)(b + 3);
+    }
+}
+
+
+//===============================================================
+// Modes
+
+enum Mode { MODE_RING, MODE_DISCARD, MODE_STATIC, NUM_MODES };
+
+static const char* s_modeNames[NUM_MODES] = { "ring", "discard", "static" };
+
+struct Options
+{
+    unsigned bytesPerFrame;
+    unsigned quadsPerBatch;
+    unsigned ringBytes;
+    unsigned frames;
+};
+
+static const unsigned QUAD_VERTEX_BYTES = 4 * sizeof(Vertex);
+static const unsigned QUAD_INDEX_BYTES  = 6 * sizeof(WORD);
+static const unsigned QUAD_BYTES        = QUAD_VERTEX_BYTES + QUAD_INDEX_BYTES;
+
+static unsigned BatchesPerFrame(const Options& opt)
+{
+    return std::max(1u, opt.bytesPerFrame / (opt.quadsPerBatch * QUAD_BYTES));
+}
+
+struct Result
+{
+    double   frameMs;
+    double   lockMs;
+    unsigned locks;
+    unsigned discards;
+    unsigned failed;
+};
+
+static bool RunMode(IDirect3DDevice9* pDevice, Mode mode, const Options& opt, Result* pResult)
+{
+    const unsigned batches       = BatchesPerFrame(opt);
+    const unsigned batchVertices = opt.quadsPerBatch * 4;
+    const unsigned batchIndices  = opt.quadsPerBatch * 6;
+
+    DynamicVertexBuffer     dynamicVB;
+    DynamicIndexBuffer      dynamicIB;
+    IDirect3DVertexBuffer9* pStaticVB = NULL;
+    IDirect3DIndexBuffer9*  pStaticIB = NULL;
+
+    if (mode == MODE_STATIC)
+    {
+        if (FAILED(pDevice->CreateVertexBuffer(batchVertices * sizeof(Vertex), D3DUSAGE_WRITEONLY, VERTEX_FVF,
+                                               D3DPOOL_DEFAULT, &pStaticVB, NULL)) ||
+            FAILED(pDevice->CreateIndexBuffer(batchIndices * sizeof(WORD), D3DUSAGE_WRITEONLY, D3DFMT_INDEX16,
+                                              D3DPOOL_DEFAULT, &pStaticIB, NULL)))
+        {
+            if (pStaticVB != NULL)
+                pStaticVB->Release();
+            return false;
+        }
+    }
+    else
+    {
+        // Split the ring in the proportion a quad needs.
+        unsigned vbBytes = (unsigned)((unsigned long long)opt.ringBytes * QUAD_VERTEX_BYTES / QUAD_BYTES);
+        if (FAILED(dynamicVB.Create(pDevice, vbBytes)) ||
+            FAILED(dynamicIB.Create(pDevice, opt.ringBytes - vbBytes)))
+            return false;
+    }
+
+    pDevice->SetFVF(VERTEX_FVF);
+    pDevice->SetRenderState(D3DRS_LIGHTING, FALSE);
+    pDevice->SetRenderState(D3DRS_CULLMODE, D3DCULL_NONE);
+    pDevice->SetRenderState(D3DRS_ZENABLE, FALSE);
+
+    Result r;
+    memset(&r, 0, sizeof(r));
+
+    // Frame 0 warms up and is not counted.
+    for (unsigned f = 0; f <= opt.frames; ++f)
+    {
+        if (f == 1)
+        {
+            r.frameMs = Now();
+            r.lockMs  = 0.0;
+            dynamicVB.ResetStats();
+            dynamicIB.ResetStats();
+        }
+
+        float time = f * 0.01f;
+        pDevice->Clear(0, NULL, D3DCLEAR_TARGET, D3DCOLOR_XRGB(0, 0, 64), 1.0f, 0);
+        if (FAILED(pDevice->BeginScene()))
+            continue;
+
+        for (unsigned b = 0; b < batches; ++b)
+        {
+            UINT    firstVertex = 0, firstIndex = 0;
+            Vertex* pV = NULL;
+            WORD*   pI = NULL;
+
+            if (mode == MODE_STATIC)
+            {
+                double start = Now();
+                pStaticVB->Lock(0, 0, (void**)&pV, 0);
+                pStaticIB->Lock(0, 0, (void**)&pI, 0);
+                r.lockMs += Now() - start;
+                r.locks  += 2;
+            }
+            else
+            {
+                if (mode == MODE_DISCARD)
+                {
+                    dynamicVB.Discard();
+                    dynamicIB.Discard();
+                }
+                pV = (Vertex*)dynamicVB.Lock(batchVertices, sizeof(Vertex), &firstVertex);
+                pI = (WORD*)dynamicIB.Lock(batchIndices, &firstIndex);
+            }
+            if (pV == NULL || pI == NULL)
+            {
+                // The dynamic buffers count their own failures.
+                if (pV != NULL)
+                    mode == MODE_STATIC ? pStaticVB->Unlock() : dynamicVB.Unlock();
+                if (pI != NULL)
+                    mode == MODE_STATIC ? pStaticIB->Unlock() : dynamicIB.Unlock();
+                if (mode == MODE_STATIC)
+                    ++r.failed;
+                continue;
+            }
+
+            WriteQuads(pV, pI, b * opt.quadsPerBatch, opt.quadsPerBatch, time);
+
+            if (mode == MODE_STATIC)
+            {
+                pStaticVB->Unlock();
+                pStaticIB->Unlock();
+                pDevice->SetStreamSource(0, pStaticVB, 0, sizeof(Vertex));
+                pDevice->SetIndices(pStaticIB);
+            }
+            else
+            {
+                dynamicVB.Unlock();
+                dynamicIB.Unlock();
+                pDevice->SetStreamSource(0, dynamicVB.Buffer(), 0, sizeof(Vertex));
+                pDevice->SetIndices(dynamicIB.Buffer());
+            }
+            pDevice->DrawIndexedPrimitive(D3DPT_TRIANGLELIST, firstVertex, 0, batchVertices,
+                                          firstIndex, opt.quadsPerBatch * 2);
+        }
+
+        pDevice->EndScene();
+        pDevice->Present(NULL, NULL, NULL, NULL);
+    }
+    r.frameMs = (Now() - r.frameMs) / opt.frames;
+
+    if (mode != MODE_STATIC)
+    {
+        r.lockMs   = dynamicVB.Stats().lockMs + dynamicIB.Stats().lockMs;
+        r.locks    = dynamicVB.Stats().locks + dynamicIB.Stats().locks;
+        r.discards = dynamicVB.Stats().discards + dynamicIB.Stats().discards;
+        r.failed  += dynamicVB.Stats().failed + dynamicIB.Stats().failed;
+    }
+    r.lockMs /= opt.frames;
+
+    pDevice->SetStreamSource(0, NULL, 0, 0);
+    pDevice->SetIndices(NULL);
+    if (pStaticVB != NULL)
+        pStaticVB->Release();
+    if (pStaticIB != NULL)
+        pStaticIB->Release();
+
+    *pResult = r;
+    return true;
+}
+
+
+static void Usage()
+{
+    fprintf(stderr, "usage: DynamicBufferBench [-mb N] [-quads N] [-ring MB] [-frames N] [-mode ring|discard|static|all]\n");
+}
+
+
+int main(int argc, char* argv[])
+{
+    Options opt;
+    opt.bytesPerFrame = 16u << 20;
+    opt.quadsPerBatch = 2048;
+    opt.ringBytes     = 4u << 20;
+    opt.frames        = 200;
+    std::string modeName = "all";
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-mb") == 0 && i + 1 < argc)
+            opt.bytesPerFrame = (unsigned)std::max(1, atoi(argv[++i])) << 20;
+        else if (strcmp(argv[i], "-quads") == 0 && i + 1 < argc)
+            opt.quadsPerBatch = (unsigned)std::min(16384, std::max(1, atoi(argv[++i])));
+        else if (strcmp(argv[i], "-ring") == 0 && i + 1 < argc)
+            opt.ringBytes = (unsigned)std::max(1, atoi(argv[++i])) << 20;
+        else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc)
+            opt.frames = (unsigned)std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "-mode") == 0 && i + 1 < argc)
+            modeName = argv[++i];
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    // A hidden window and a windowed device without vsync.
+    WNDCLASSEX wc = { sizeof(WNDCLASSEX), CS_CLASSDC, DefWindowProc, 0L, 0L,
+                      GetModuleHandle(NULL), NULL, NULL, NULL, NULL,
+                      "DynamicBufferBench", NULL };
+    RegisterClassEx(&wc);
+    HWND hWnd = CreateWindow("DynamicBufferBench", "DynamicBufferBench", WS_OVERLAPPEDWINDOW,
+                             0, 0, 512, 512, NULL, NULL, wc.hInstance, NULL);
+
+    IDirect3D9*       pD3D    = Direct3DCreate9(D3D_SDK_VERSION);
+    IDirect3DDevice9* pDevice = NULL;
+    if (pD3D != NULL)
+    {
+        D3DPRESENT_PARAMETERS d3dpp;
+        ZeroMemory(&d3dpp, sizeof(d3dpp));
+        d3dpp.Windowed             = TRUE;
+        d3dpp.SwapEffect           = D3DSWAPEFFECT_DISCARD;
+        d3dpp.BackBufferFormat     = D3DFMT_UNKNOWN;
+        d3dpp.PresentationInterval = D3DPRESENT_INTERVAL_IMMEDIATE;
+        if (FAILED(pD3D->CreateDevice(D3DADAPTER_DEFAULT, D3DDEVTYPE_HAL, hWnd,
+                                      D3DCREATE_HARDWARE_VERTEXPROCESSING, &d3dpp, &pDevice)))
+        {
+            pD3D->CreateDevice(D3DADAPTER_DEFAULT, D3DDEVTYPE_HAL, hWnd,
+                               D3DCREATE_SOFTWARE_VERTEXPROCESSING, &d3dpp, &pDevice);
+        }
+    }
+    if (pDevice == NULL)
+    {
+        fprintf(stderr, "cannot create a Direct3D 9 device\n");
+        if (pD3D != NULL)
+            pD3D->Release();
+        DestroyWindow(hWnd);
+        UnregisterClass("DynamicBufferBench", wc.hInstance);
+        return 1;
+    }
+
+    printf("%.1f MB per frame in batches of %u quads (%u KB), %.1f MB ring, %u frames\n",
+           opt.bytesPerFrame / (1024.0 * 1024.0), opt.quadsPerBatch, opt.quadsPerBatch * QUAD_BYTES / 1024,
+           opt.ringBytes / (1024.0 * 1024.0), opt.frames);
+    printf("mode      frame ms    MB/s   locks/frame   discards/frame   lock ms/frame   failed\n");
+
+    int status = 0;
+    for (int m = 0; m < NUM_MODES; ++m)
+    {
+        if (modeName != "all" && modeName != s_modeNames[m])
+            continue;
+
+        Result r;
+        if (!RunMode(pDevice, (Mode)m, opt, &r))
+        {
+            printf("%-8s  cannot create the buffers\n", s_modeNames[m]);
+            status = 1;
+            continue;
+        }
+
+        double mb = (double)BatchesPerFrame(opt) * opt.quadsPerBatch * QUAD_BYTES / (1024.0 * 1024.0);
+        printf("%-8s  %8.3f  %6.0f   %11.1f   %14.1f   %13.3f   %6u\n",
+               s_modeNames[m], r.frameMs, mb / (r.frameMs / 1000.0),
+               (double)r.locks / opt.frames, (double)r.discards / opt.frames, r.lockMs, r.failed);
+        if (r.failed != 0)
+            status = 1;
+    }
+
+    pDevice->Release();
+    pD3D->Release();
+    DestroyWindow(hWnd);
+    UnregisterClass("DynamicBufferBench", wc.hInstance);
+    return status;
+}
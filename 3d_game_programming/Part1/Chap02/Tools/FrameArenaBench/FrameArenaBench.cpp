@@ -0,0 +1,297 @@
+//=============================================================================
+// FrameArenaBench.cpp
+//
+// Compares building transient per-frame data on the heap with building it
+// in the frame arena (Common/FrameArena.h).
+//
+//     FrameArenaBench [-count N] [-materials N] [-frames N]
+//
+// Every frame a scene of N objects (default 20000) over M materials
+// (default 64) produces what a renderer typically rebuilds each frame:
+//
+//     a visible list, a world matrix per visible object, per-object light
+//     constants, per-material texture path strings, the resolved texture
+//     pointer array and a draw list sorted by material
+//
+// once with new[]/std::vector/std::string and once with the arena and
+// FrameAllocator containers.  Global operator new/delete are counted, so
+// the tool prints heap calls per frame next to the time per frame.  Both
+// versions must produce the same checksum.
+//=============================================================================
+
+#include "FrameArena.h"
+#include "Math3D.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+
+//===============================================================
+// Heap call counting
+
+static unsigned long long s_heapAllocs = 0;
+static unsigned long long s_heapFrees  = 0;
+
+void* operator new(size_t bytes)
+{
+    ++s_heapAllocs;
+    void* p = malloc(bytes ? bytes : 1);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t bytes)
+{
+    ++s_heapAllocs;
+    void* p = malloc(bytes ? bytes : 1);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void* p)
+{
+    if (p != NULL)
+        ++s_heapFrees;
+    free(p);
+}
+
+void operator delete[](void* p)
+{
+    if (p != NULL)
+        ++s_heapFrees;
+    free(p);
+}
+
+// C++14 compilers call these instead when they know the size; without them
+// the library's versions would free our malloc() blocks uncounted.
+void operator delete(void* p, size_t)
+{
+    operator delete(p);
+}
+
+void operator delete[](void* p, size_t)
+{
+    operator delete[](p);
+}
+
+
+static double Now()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+
+//===============================================================
+// Scene
+
+struct DrawItem
+{
+    unsigned material;
+    unsigned object;
+    const Mat4* pWorld;
+    const float* pLight;
+};
+
+static bool ByMaterial(const DrawItem& a, const DrawItem& b)
+{
+    return a.material != b.material ? a.material < b.material : a.object < b.object;
+}
+
+static unsigned s_count     = 20000;
+static unsigned s_materials = 64;
+
+static bool IsVisible(unsigned i, unsigned frame) { return (i * 7 + frame) % 5 != 0; }
+static unsigned MaterialOf(unsigned i)           { return (i * 2654435761u >> 8) % s_materials; }
+static void* FakeTexture(const char* path)       { return (void*)(size_t)(0x10000 + strlen(path) * 16 + (unsigned char)path[9]); }
+
+static Mat4 WorldOf(unsigned i, unsigned frame)
+{
+    return Mat4RotationY(frame * 0.01f + i * 0.1f) * Mat4Translation((float)(i % 128), 0.0f, (float)(i / 128));
+}
+
+static void LightOf(unsigned i, float* c)
+{
+    for (int k = 0; k < 8; ++k)
+        c[k] = (float)((i + k) % 17) / 16.0f;
+}
+
+// FNV-1a over the draw list, the way a renderer would consume it.
+static unsigned Checksum(const DrawItem* items, size_t count, void* const* textures)
+{
+    unsigned h = 2166136261u;
+    for (size_t i = 0; i < count; ++i)
+    {
+        const unsigned char* b = reinterpret_cast<const unsigned char*>(items[i].pWorld);
+        for (size_t k = 0; k < sizeof(Mat4); ++k)
+            h = (h ^ b[k]) * 16777619u;
+        h = (h ^ items[i].object) * 16777619u;
+        h = (h ^ (unsigned)(size_t)textures[items[i].material]) * 16777619u;
+        h = (h ^ (unsigned)(items[i].pLight[3] * 16.0f)) * 16777619u;
+    }
+    return h;
+}
+
+
+//===============================================================
+// Heap version
+
+static unsigned BuildFrameHeap(unsigned frame)
+{
+    std::vector<unsigned> visible;
+    for (unsigned i = 0; i < s_count; ++i)
+    {
+        if (IsVisible(i, frame))
+            visible.push_back(i);
+    }
+
+    Mat4* worlds = new Mat4[visible.size()];
+    std::vector< std::vector<float> > lights(visible.size());
+    for (size_t v = 0; v < visible.size(); ++v)
+    {
+        worlds[v] = WorldOf(visible[v], frame);
+        lights[v].resize(8);
+        LightOf(visible[v], &lights[v][0]);
+    }
+
+    std::vector<std::string> paths;
+    void** textures = new void*[s_materials];
+    for (unsigned m = 0; m < s_materials; ++m)
+    {
+        char name[32];
+        sprintf(name, "%u.dds", m);
+        paths.push_back(std::string("textures/material_") + name);
+        textures[m] = FakeTexture(paths.back().c_str());
+    }
+
+    std::vector<DrawItem> items;
+    for (size_t v = 0; v < visible.size(); ++v)
+    {
+        DrawItem item = { MaterialOf(visible[v]), visible[v], &worlds[v], &lights[v][0] };
+        items.push_back(item);
+    }
+    std::sort(items.begin(), items.end(), ByMaterial);
+
+    unsigned h = items.empty() ? 0 : Checksum(&items[0], items.size(), textures);
+    delete[] worlds;
+    delete[] textures;
+    return h;
+}
+
+
+//===============================================================
+// Arena version
+
+static unsigned BuildFrameArena(FrameArena& arena, unsigned frame)
+{
+    arena.BeginFrame();
+
+    FrameVector<unsigned>::Type visible(arena);
+    visible.reserve(s_count);
+    for (unsigned i = 0; i < s_count; ++i)
+    {
+        if (IsVisible(i, frame))
+            visible.push_back(i);
+    }
+
+    Mat4*  worlds = arena.Allocate<Mat4>(visible.size());
+    float* lights = arena.Allocate<float>(visible.size() * 8);
+    for (size_t v = 0; v < visible.size(); ++v)
+    {
+        worlds[v] = WorldOf(visible[v], frame);
+        LightOf(visible[v], lights + v * 8);
+    }
+
+    void** textures = arena.Allocate<void*>(s_materials);
+    for (unsigned m = 0; m < s_materials; ++m)
+    {
+        char name[64];
+        sprintf(name, "textures/material_%u.dds", m);
+        textures[m] = FakeTexture(arena.CopyString(name));
+    }
+
+    FrameVector<DrawItem>::Type items(arena);
+    items.reserve(visible.size());
+    for (size_t v = 0; v < visible.size(); ++v)
+    {
+        DrawItem item = { MaterialOf(visible[v]), visible[v], &worlds[v], lights + v * 8 };
+        items.push_back(item);
+    }
+    std::sort(items.begin(), items.end(), ByMaterial);
+
+    return items.empty() ? 0 : Checksum(&items[0], items.size(), textures);
+}
+
+
+static void Usage()
+{
+    fprintf(stderr, "usage: FrameArenaBench [-count N] [-materials N] [-frames N]\n");
+}
+
+
+int main(int argc, char* argv[])
+{
+    unsigned numFrames = 100;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-count") == 0 && i + 1 < argc)
+            s_count = (unsigned)std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "-materials") == 0 && i + 1 < argc)
+            s_materials = (unsigned)std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc)
+            numFrames = (unsigned)std::max(1, atoi(argv[++i]));
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    printf("%u objects, %u materials, %u frames\n", s_count, s_materials, numFrames);
+    printf("version   ms/frame   heap allocs/frame   heap frees/frame   checksum\n");
+
+    // Heap.
+    BuildFrameHeap(0);
+    unsigned long long allocs = s_heapAllocs, frees = s_heapFrees;
+    unsigned heapHash = 0;
+    double start = Now();
+    for (unsigned f = 1; f <= numFrames; ++f)
+        heapHash ^= BuildFrameHeap(f) + f;
+    double heapMs = (Now() - start) / numFrames;
+    printf("heap      %8.3f   %17.1f   %16.1f   %08x\n", heapMs,
+           (double)(s_heapAllocs - allocs) / numFrames, (double)(s_heapFrees - frees) / numFrames, heapHash);
+
+    // Arena; the first NumFrames() frames grow the pages.
+    FrameArena arena;
+    for (unsigned f = 0; f < arena.NumFrames(); ++f)
+        BuildFrameArena(arena, 0);
+    allocs = s_heapAllocs;
+    frees  = s_heapFrees;
+    unsigned arenaHash = 0;
+    start = Now();
+    for (unsigned f = 1; f <= numFrames; ++f)
+        arenaHash ^= BuildFrameArena(arena, f) + f;
+    double arenaMs = (Now() - start) / numFrames;
+    printf("arena     %8.3f   %17.1f   %16.1f   %08x\n", arenaMs,
+           (double)(s_heapAllocs - allocs) / numFrames, (double)(s_heapFrees - frees) / numFrames, arenaHash);
+
+    const FrameArenaStats& s = arena.Stats();
+    printf("\narena: %.1f allocations per frame, peak %u KB per frame, %u KB reserved over %u buffers; %.2fx faster\n",
+           (double)s.totalAllocations / s.frames, (unsigned)(s.peakBytes / 1024), (unsigned)(s.reservedBytes / 1024),
+           arena.NumFrames(), heapMs / arenaMs);
+
+    if (heapHash != arenaHash)
+    {
+        printf("checksums differ\n");
+        return 1;
+    }
+    printf("checksums match\n");
+    return 0;
+}
@@ -0,0 +1,312 @@
+//=============================================================================
+// JobBench.cpp
+//
+// Measures how the per-frame update work of 06.Meshes scales on the job
+// system (Common/JobSystem.h).
+//
+//     JobBench [-count N] [-threads N] [-frames N]
+//
+// Every frame updates N objects (default 100000) in three job sets:
+//
+//     transforms  world matrix and world-space box of every object
+//     culling     frustum test of the boxes, in chunks of CULL_CHUNK,
+//                 queued once every transform has finished
+//     lights      per-object light constants (the two strongest of
+//                 NUM_LIGHTS point lights), also after the transforms and
+//                 concurrently with culling
+//
+// The frame is timed with 1, 2, 4, ... threads up to -threads (default:
+// every hardware thread), together with each thread's share of the jobs,
+// steals and busy time.  Every run is compared with a serial update and
+// any difference makes the exit code 1.
+//=============================================================================
+
+#include "Culling.h"
+#include "JobSystem.h"
+#include "Math3D.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+
+static double Now()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+
+//===============================================================
+// Scene
+
+static const unsigned NUM_LIGHTS       = 16;
+static const unsigned TRANSFORM_GRAIN  = 512;
+static const unsigned LIGHT_GRAIN      = 512;
+static const unsigned CULL_CHUNK       = 2048;     // multiple of 8 (CullBounds::CullBoxes)
+
+struct PointLight
+{
+    Vec3  position;
+    Vec3  color;
+    float range;
+};
+
+// Constants one object hands to its shader: two lights as position/range
+// and colour*attenuation.
+struct LightConstants
+{
+    float c[4][4];
+};
+
+struct Scene
+{
+    unsigned                    count;
+    float                       time;
+    Aabb                        localBox;
+    Frustum                     frustum;
+    PointLight                  lights[NUM_LIGHTS];
+
+    std::vector<Mat4>           worlds;
+    CullBounds                  bounds;
+    std::vector<LightConstants> lightConstants;
+
+    unsigned                    numChunks;
+    std::vector< std::vector<unsigned> > chunkVisible;
+    std::vector<unsigned>       visible;
+};
+
+static void InitScene(Scene& scene, unsigned count)
+{
+    scene.count    = count;
+    scene.time     = 0.0f;
+    scene.localBox = Aabb(Vec3(-1.0f, 0.0f, -1.5f), Vec3(1.0f, 1.5f, 1.5f));
+
+    srand(1);
+    for (unsigned l = 0; l < NUM_LIGHTS; ++l)
+    {
+        PointLight& light = scene.lights[l];
+        light.position = Vec3((float)(rand() % 800) - 400.0f, 10.0f, (float)(rand() % 800) - 400.0f);
+        light.color    = Vec3((float)(rand() % 256) / 255.0f, (float)(rand() % 256) / 255.0f, (float)(rand() % 256) / 255.0f);
+        light.range    = 100.0f + (float)(rand() % 200);
+    }
+
+    scene.worlds.resize(count);
+    scene.bounds.Resize(count);
+    scene.lightConstants.resize(count);
+
+    scene.numChunks = (count + CULL_CHUNK - 1) / CULL_CHUNK;
+    scene.chunkVisible.resize(scene.numChunks);
+    for (unsigned c = 0; c < scene.numChunks; ++c)
+        scene.chunkVisible[c].reserve(CULL_CHUNK);
+    scene.visible.reserve(count);
+}
+
+static void BeginFrame(Scene& scene, float time)
+{
+    scene.time = time;
+
+    Vec3 eye(sinf(time * 0.3f) * 200.0f, 60.0f, cosf(time * 0.3f) * 200.0f);
+    Mat4 view = Mat4LookAtLH(eye, Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f));
+    scene.frustum.Extract(view * Mat4PerspectiveFovLH(MATH_PI / 4, 1.0f, 1.0f, 500.0f));
+
+    for (unsigned c = 0; c < scene.numChunks; ++c)
+        scene.chunkVisible[c].clear();
+    scene.visible.clear();
+}
+
+static void UpdateTransforms(void* pData, unsigned begin, unsigned end)
+{
+    Scene& scene = *static_cast<Scene*>(pData);
+    unsigned side = (unsigned)sqrtf((float)scene.count) + 1;
+    for (unsigned i = begin; i < end; ++i)
+    {
+        float x = (float)(i % side) * 4.0f - side * 2.0f;
+        float z = (float)(i / side) * 4.0f - side * 2.0f;
+        scene.worlds[i] = Mat4RotationY(scene.time + i * 0.01f) * Mat4Translation(x, 0.0f, z);
+        scene.bounds.Set(i, TransformAabb(scene.localBox, scene.worlds[i]));
+    }
+}
+
+static void CullChunks(void* pData, unsigned begin, unsigned end)
+{
+    Scene& scene = *static_cast<Scene*>(pData);
+    for (unsigned c = begin; c < end; ++c)
+        scene.bounds.CullBoxes(scene.frustum, c * CULL_CHUNK, (c + 1) * CULL_CHUNK, scene.chunkVisible[c]);
+}
+
+static void UpdateLightConstants(void* pData, unsigned begin, unsigned end)
+{
+    Scene& scene = *static_cast<Scene*>(pData);
+    for (unsigned i = begin; i < end; ++i)
+    {
+        const Mat4& world = scene.worlds[i];
+        Vec3 p(world.m[3][0], world.m[3][1], world.m[3][2]);
+
+        // The two lights with the largest attenuation at the object.
+        unsigned best[2]   = { 0, 0 };
+        float    weight[2] = { 0.0f, 0.0f };
+        for (unsigned l = 0; l < NUM_LIGHTS; ++l)
+        {
+            const PointLight& light = scene.lights[l];
+            float d = Vec3Length(light.position - p) / light.range;
+            float w = std::max(0.0f, 1.0f - d * d);
+            if (w > weight[0])
+            {
+                best[1] = best[0]; weight[1] = weight[0];
+                best[0] = l;       weight[0] = w;
+            }
+            else if (w > weight[1])
+            {
+                best[1] = l; weight[1] = w;
+            }
+        }
+
+        LightConstants& lc = scene.lightConstants[i];
+        for (unsigned k = 0; k < 2; ++k)
+        {
+            const PointLight& light = scene.lights[best[k]];
+            float* pos = lc.c[k * 2];
+            float* col = lc.c[k * 2 + 1];
+            pos[0] = light.position.x; pos[1] = light.position.y; pos[2] = light.position.z; pos[3] = light.range;
+            col[0] = light.color.x * weight[k];
+            col[1] = light.color.y * weight[k];
+            col[2] = light.color.z * weight[k];
+            col[3] = weight[k];
+        }
+    }
+}
+
+static void GatherVisible(Scene& scene)
+{
+    for (unsigned c = 0; c < scene.numChunks; ++c)
+        scene.visible.insert(scene.visible.end(), scene.chunkVisible[c].begin(), scene.chunkVisible[c].end());
+}
+
+static void UpdateSerial(Scene& scene)
+{
+    UpdateTransforms(&scene, 0, scene.count);
+    CullChunks(&scene, 0, scene.numChunks);
+    UpdateLightConstants(&scene, 0, scene.count);
+    GatherVisible(scene);
+}
+
+static void UpdateJobs(Scene& scene)
+{
+    JobCounter transforms, culling, lights;
+    g_jobs.ParallelFor(scene.count, TRANSFORM_GRAIN, UpdateTransforms, &scene, &transforms);
+    g_jobs.ParallelFor(scene.numChunks, 1, CullChunks, &scene, &culling, &transforms);
+    g_jobs.ParallelFor(scene.count, LIGHT_GRAIN, UpdateLightConstants, &scene, &lights, &transforms);
+    g_jobs.Wait(&culling);
+    g_jobs.Wait(&lights);
+    GatherVisible(scene);
+}
+
+static bool SameResults(const Scene& a, const Scene& b)
+{
+    return a.visible == b.visible &&
+           memcmp(&a.worlds[0], &b.worlds[0], a.count * sizeof(Mat4)) == 0 &&
+           memcmp(&a.lightConstants[0], &b.lightConstants[0], a.count * sizeof(LightConstants)) == 0;
+}
+
+
+static void Usage()
+{
+    fprintf(stderr, "usage: JobBench [-count N] [-threads N] [-frames N]\n");
+}
+
+
+int main(int argc, char* argv[])
+{
+    unsigned count      = 100000;
+    unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned numFrames  = 50;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-count") == 0 && i + 1 < argc)
+            count = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+            maxThreads = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc)
+            numFrames = std::max(1, atoi(argv[++i]));
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+    maxThreads = std::min(maxThreads, JobSystem::MAX_THREADS);
+
+    Scene reference, scene;
+    InitScene(reference, count);
+    InitScene(scene, count);
+
+    double serialMs = 0.0;
+    for (unsigned f = 0; f < numFrames; ++f)
+    {
+        BeginFrame(reference, f * 0.02f);
+        double start = Now();
+        UpdateSerial(reference);
+        serialMs += Now() - start;
+    }
+    serialMs /= numFrames;
+
+    printf("%u objects, %u cull chunks, %u of them visible; %u hardware threads\n",
+           count, reference.numChunks, (unsigned)reference.visible.size(), std::thread::hardware_concurrency());
+    printf("serial update: %.3f ms per frame\n\n", serialMs);
+    printf("threads   frame ms   speedup   result\n");
+
+    std::vector<unsigned> threadCounts;
+    for (unsigned t = 1; t < maxThreads; t *= 2)
+        threadCounts.push_back(t);
+    threadCounts.push_back(maxThreads);
+
+    unsigned errors = 0;
+    for (size_t r = 0; r < threadCounts.size(); ++r)
+    {
+        g_jobs.Start(threadCounts[r]);
+
+        // Warm up: wake the workers and fault in the chunk lists.
+        BeginFrame(scene, 0.0f);
+        UpdateJobs(scene);
+        g_jobs.ResetStats();
+
+        double frameMs = 0.0;
+        for (unsigned f = 0; f < numFrames; ++f)
+        {
+            BeginFrame(scene, f * 0.02f);
+            double start = Now();
+            UpdateJobs(scene);
+            frameMs += Now() - start;
+        }
+        frameMs /= numFrames;
+
+        // The last frame of both runs used the same time.
+        bool ok = SameResults(scene, reference);
+        if (!ok)
+            ++errors;
+
+        printf("%7u   %8.3f   %6.2fx   %s\n", threadCounts[r], frameMs, serialMs / frameMs, ok ? "ok" : "MISMATCH");
+
+        double window = g_jobs.StatsWindowMs();
+        for (unsigned t = 0; t < threadCounts[r]; ++t)
+        {
+            const JobWorkerStats& s = g_jobs.WorkerStats(t);
+            printf("            thread %2u: %6u jobs, %5u stolen, %5.1f%% busy\n",
+                   t, s.jobs, s.steals, window > 0.0 ? 100.0 * s.busyMs / window : 0.0);
+        }
+        g_jobs.Stop();
+    }
+
+    if (errors != 0)
+    {
+        printf("%u thread counts produced different results\n", errors);
+        return 1;
+    }
+    printf("all runs match the serial update\n");
+    return 0;
+}
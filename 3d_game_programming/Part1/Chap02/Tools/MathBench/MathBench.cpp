@@ -0,0 +1,258 @@
+//=============================================================================
+// MathBench.cpp
+//
+// Checks Common/Math3D.h against plain scalar reference code and times the
+// batched paths against the same loops written the obvious way.
+//
+//     MathBench [-count N] [-repeat N]
+//
+// Every timed pair is also compared element by element; any difference
+// beyond float rounding is printed and the exit code is 1.  Build with
+// MATH3D_SCALAR defined to time the library's own fallback.
+//
+// Vec3TransformArray is checked but not timed: the reference loop is
+// vectorized by the compiler and runs at the same speed.
+//=============================================================================
+
+#include "Math3D.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <vector>
+
+
+//===============================================================
+// Scalar reference
+
+static void RefMultiply(Mat4* out, const Mat4& a, const Mat4& b)
+{
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 4; ++j)
+            out->m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] +
+                           a.m[i][2] * b.m[2][j] + a.m[i][3] * b.m[3][j];
+}
+
+static void RefTransform(Vec4* out, const Vec3& p, const Mat4& m)
+{
+    float v[4] = { p.x, p.y, p.z, 1.0f }, r[4];
+    for (int j = 0; j < 4; ++j)
+        r[j] = v[0] * m.m[0][j] + v[1] * m.m[1][j] + v[2] * m.m[2][j] + v[3] * m.m[3][j];
+    *out = Vec4(r[0], r[1], r[2], r[3]);
+}
+
+
+//===============================================================
+// Helpers
+
+static unsigned s_errors = 0;
+
+static float Random()
+{
+    return (float)rand() / RAND_MAX * 2.0f - 1.0f;
+}
+
+static Mat4 RandomMatrix()
+{
+    Mat4 m;
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 4; ++j)
+            m.m[i][j] = Random();
+    return m;
+}
+
+static void Expect(const char* what, const float* got, const float* want, int n, float tolerance = 1e-4f)
+{
+    for (int i = 0; i < n; ++i)
+    {
+        if (fabsf(got[i] - want[i]) > tolerance * (1.0f + fabsf(want[i])))
+        {
+            fprintf(stderr, "mismatch: %s [%d] = %g, expected %g\n", what, i, got[i], want[i]);
+            ++s_errors;
+            return;
+        }
+    }
+}
+
+static double Now()
+{
+    return std::chrono::duration<double>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+static void Report(const char* name, size_t ops, double refSeconds, double libSeconds)
+{
+    printf("%-28s %8.2f ns  %8.2f ns  %5.2fx\n", name,
+           refSeconds * 1e9 / ops, libSeconds * 1e9 / ops, refSeconds / libSeconds);
+}
+
+
+//===============================================================
+// Conformance: the builders against hand-computed D3DX results.
+
+static void CheckBuilders()
+{
+    // RotationY(90 deg) maps +x to -z (clockwise looking down +y).
+    Vec3 p = Vec3TransformCoord(Vec3(1, 0, 0), Mat4RotationY(MATH_PI / 2));
+    float want[3] = { 0, 0, -1 };
+    Expect("RotationY", &p.x, want, 3);
+
+    // LookAtLH from the samples' eye: the target lands on the +z axis.
+    Mat4 view = Mat4LookAtLH(Vec3(0, 3, -5), Vec3(0, 0, 0), Vec3(0, 1, 0));
+    Vec3 at = Vec3TransformCoord(Vec3(0, 0, 0), view);
+    float wantAt[3] = { 0, 0, sqrtf(34.0f) };
+    Expect("LookAtLH", &at.x, wantAt, 3);
+
+    // PerspectiveFovLH: near plane to z=0, far plane to z=1.
+    Mat4 proj = Mat4PerspectiveFovLH(MATH_PI / 4, 1.0f, 1.0f, 100.0f);
+    Vec3 n = Vec3TransformCoord(Vec3(0, 0, 1), proj), f = Vec3TransformCoord(Vec3(0, 0, 100), proj);
+    float depths[2] = { n.z, f.z }, wantDepths[2] = { 0, 1 };
+    Expect("PerspectiveFovLH", depths, wantDepths, 2);
+
+    // Inverse round trip.
+    Mat4 a = view * proj, inv, id = Mat4Identity();
+    if (!Mat4Inverse(&inv, a))
+    {
+        fprintf(stderr, "mismatch: Inverse reported a singular matrix\n");
+        ++s_errors;
+    }
+    Expect("Inverse", (a * inv).Data(), id.Data(), 16);
+
+    // Quaternions agree with the matrix builders and compose in the same order.
+    Quat qy = QuatRotationAxis(Vec3(0, 1, 0), 0.7f), qx = QuatRotationAxis(Vec3(1, 0, 0), -0.3f);
+    Expect("RotationQuat", Mat4RotationQuat(qy).Data(), Mat4RotationY(0.7f).Data(), 16);
+    Expect("QuatMultiply", Mat4RotationQuat(QuatMultiply(qy, qx)).Data(),
+           (Mat4RotationY(0.7f) * Mat4RotationX(-0.3f)).Data(), 16);
+
+    Vec3 v(0.2f, -1.5f, 3.0f), r1 = QuatRotate(v, qy), r2 = Vec3TransformNormal(v, Mat4RotationY(0.7f));
+    Expect("QuatRotate", &r1.x, &r2.x, 3);
+
+    Quat ypr = QuatRotationYawPitchRoll(0.4f, 0.5f, 0.6f);
+    Expect("YawPitchRoll", Mat4RotationQuat(ypr).Data(),
+           (Mat4RotationZ(0.6f) * Mat4RotationX(0.5f) * Mat4RotationY(0.4f)).Data(), 16);
+
+    Quat half = QuatSlerp(QuatIdentity(), qy, 0.5f), wantHalf = QuatRotationAxis(Vec3(0, 1, 0), 0.35f);
+    Expect("Slerp", &half.x, &wantHalf.x, 4);
+
+    Mat4 trs = Mat4AffineTransformation(Vec3(2, 3, 4), qy, Vec3(5, 6, 7));
+    Mat4 wantTrs = Mat4Scaling(2, 3, 4) * Mat4RotationY(0.7f) * Mat4Translation(5, 6, 7);
+    Expect("AffineTransformation", trs.Data(), wantTrs.Data(), 16);
+}
+
+static void CheckTransform(size_t count)
+{
+    // Positions inside a larger vertex, as the occlusion buffer reads them.
+    struct Vertex { Vec3 position; float u, v; };
+    std::vector<Vertex> vertices(count);
+    std::vector<Vec4>   ref(count), lib(count);
+    for (size_t i = 0; i < count; ++i)
+        vertices[i].position = Vec3(Random() * 10, Random() * 10, Random() * 10);
+    Mat4 m = RandomMatrix();
+
+    for (size_t i = 0; i < count; ++i)
+        RefTransform(&ref[i], vertices[i].position, m);
+    Vec3TransformArray(&lib[0], &vertices[0].position, sizeof(Vertex), m, count);
+    Expect("Vec3TransformArray", &lib[0].x, &ref[0].x, 4 * (int)count);
+}
+
+
+//===============================================================
+// Timed batches
+
+static void BenchMultiply(size_t count, unsigned repeat)
+{
+    std::vector<Mat4> worlds(count), ref(count), lib(count);
+    for (size_t i = 0; i < count; ++i)
+        worlds[i] = RandomMatrix();
+    Mat4 viewProj = RandomMatrix();
+
+    double t0 = Now();
+    for (unsigned r = 0; r < repeat; ++r)
+        for (size_t i = 0; i < count; ++i)
+            RefMultiply(&ref[i], worlds[i], viewProj);
+    double t1 = Now();
+    for (unsigned r = 0; r < repeat; ++r)
+        Mat4MultiplyArray(&lib[0], &worlds[0], viewProj, count);
+    double t2 = Now();
+
+    Expect("Mat4MultiplyArray", lib[0].Data(), ref[0].Data(), 16 * (int)count);
+    Report("Mat4MultiplyArray", count * repeat, t1 - t0, t2 - t1);
+}
+
+static void BenchSingleMultiply(size_t count, unsigned repeat)
+{
+    // The one-at-a-time form a scene graph would use.
+    std::vector<Mat4> a(count), b(count), ref(count), lib(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        a[i] = RandomMatrix();
+        b[i] = RandomMatrix();
+    }
+
+    double t0 = Now();
+    for (unsigned r = 0; r < repeat; ++r)
+        for (size_t i = 0; i < count; ++i)
+            RefMultiply(&ref[i], a[i], b[i]);
+    double t1 = Now();
+    for (unsigned r = 0; r < repeat; ++r)
+        for (size_t i = 0; i < count; ++i)
+            Mat4Multiply(&lib[i], a[i], b[i]);
+    double t2 = Now();
+
+    Expect("Mat4Multiply", lib[0].Data(), ref[0].Data(), 16 * (int)count);
+    Report("Mat4Multiply", count * repeat, t1 - t0, t2 - t1);
+}
+
+static void Usage()
+{
+    fprintf(stderr, "usage: MathBench [-count N] [-repeat N]\n");
+}
+
+
+int main(int argc, char* argv[])
+{
+    size_t   count  = 4096;
+    unsigned repeat = 200;
+
+    for (int arg = 1; arg < argc; ++arg)
+    {
+        if (strcmp(argv[arg], "-count") == 0 && arg + 1 < argc)
+            count = (size_t)atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-repeat") == 0 && arg + 1 < argc)
+            repeat = (unsigned)atoi(argv[++arg]);
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+    if (count == 0 || repeat == 0)
+    {
+        Usage();
+        return 1;
+    }
+
+#if defined(MATH3D_SSE)
+    const char* path = "SSE2";
+#elif defined(MATH3D_NEON)
+    const char* path = "NEON";
+#else
+    const char* path = "scalar";
+#endif
+    printf("Math3D (%s), %u x %u elements\n", path, (unsigned)count, repeat);
+    printf("%-28s %11s  %11s  %6s\n", "", "reference", "Math3D", "speedup");
+
+    srand(1);
+    CheckBuilders();
+    CheckTransform(count);
+    BenchMultiply(count, repeat);
+    BenchSingleMultiply(count, repeat);
+
+    if (s_errors)
+    {
+        printf("%u mismatches\n", s_errors);
+        return 1;
+    }
+    printf("all results match\n");
+    return 0;
+}
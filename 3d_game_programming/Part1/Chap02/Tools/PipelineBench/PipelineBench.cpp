@@ -0,0 +1,188 @@
+//=============================================================================
+// PipelineBench.cpp
+//
+// Measures what pipelining simulation and submission (Common/FramePipeline.h)
+// gains in frame time and costs in latency.
+//
+//     PipelineBench [-count N] [-submit N] [-threads N] [-frames N]
+//
+// A frame simulates N objects (default 20000): world matrix, world-space
+// box and a light/material colour each, split across the job system.  The
+// render thread then "submits" the snapshot: for every object it builds
+// world*view*projection and feeds it to a checksum, -submit times over
+// (default 2) to stand in for driver work.  The same frames are run with
+// pipeline depth 0 (serial), 1, 2 and 3; for each the time per frame, the
+// time the render thread waited for simulation and the latency from
+// simulation start to the end of submission are printed.  Every depth must
+// draw the same frames, so the checksums have to agree.
+//=============================================================================
+
+#include "Culling.h"
+#include "FramePipeline.h"
+#include "JobSystem.h"
+#include "Math3D.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+
+static double Now()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+
+//===============================================================
+// Scene
+
+struct Snapshot
+{
+    unsigned          frame;
+    Mat4              viewProj;
+    std::vector<Mat4> worlds;
+    std::vector<Aabb> boxes;
+    std::vector<Vec3> colors;
+};
+
+struct Scene
+{
+    unsigned count;
+    Aabb     localBox;
+};
+
+static void Simulate(Snapshot& s, unsigned frame, double seconds, void* pUser)
+{
+    const Scene& scene = *static_cast<const Scene*>(pUser);
+    float time = (float)seconds;
+
+    s.frame = frame;
+    s.worlds.resize(scene.count);
+    s.boxes.resize(scene.count);
+    s.colors.resize(scene.count);
+
+    Vec3 eye(sinf(time * 0.2f) * 300.0f, 80.0f, cosf(time * 0.2f) * 300.0f);
+    s.viewProj = Mat4LookAtLH(eye, Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f)) *
+                 Mat4PerspectiveFovLH(MATH_PI / 4, 1.0f, 1.0f, 1000.0f);
+
+    g_jobs.ParallelFor(scene.count, 512, [&](unsigned begin, unsigned end)
+    {
+        for (unsigned i = begin; i < end; ++i)
+        {
+            float x = (float)(i % 256) * 3.0f - 384.0f;
+            float z = (float)(i / 256) * 3.0f - 384.0f;
+            s.worlds[i] = Mat4RotationY(time + i * 0.01f) * Mat4Translation(x, 0.0f, z);
+            s.boxes[i]  = TransformAabb(scene.localBox, s.worlds[i]);
+
+            float d = Vec3Length(Vec3(x, 0.0f, z) - eye) / 600.0f;
+            s.colors[i] = Vec3(1.0f - d, 0.5f, d);
+        }
+    });
+}
+
+static unsigned Submit(const Snapshot& s, unsigned passes)
+{
+    unsigned h = 2166136261u ^ s.frame;
+    for (unsigned p = 0; p < passes; ++p)
+    {
+        for (size_t i = 0; i < s.worlds.size(); ++i)
+        {
+            Mat4 wvp = s.worlds[i] * s.viewProj;
+            const unsigned char* b = reinterpret_cast<const unsigned char*>(wvp.Data());
+            for (size_t k = 0; k < sizeof(Mat4); k += 4)
+                h = (h ^ b[k]) * 16777619u;
+            h = (h ^ (unsigned)(s.colors[i].x * 255.0f)) * 16777619u;
+        }
+    }
+    return h;
+}
+
+
+static void Usage()
+{
+    fprintf(stderr, "usage: PipelineBench [-count N] [-submit N] [-threads N] [-frames N]\n");
+}
+
+
+int main(int argc, char* argv[])
+{
+    Scene scene;
+    scene.count    = 20000;
+    scene.localBox = Aabb(Vec3(-1.0f, 0.0f, -1.5f), Vec3(1.0f, 1.5f, 1.5f));
+    unsigned passes     = 2;
+    unsigned numThreads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned numFrames  = 100;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-count") == 0 && i + 1 < argc)
+            scene.count = (unsigned)std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "-submit") == 0 && i + 1 < argc)
+            passes = (unsigned)std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+            numThreads = (unsigned)std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc)
+            numFrames = (unsigned)std::max(1, atoi(argv[++i]));
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    g_jobs.Start(numThreads);
+    g_clock.SetFixedStep(60.0);     // frame N at N/60 s, at every depth
+    printf("%u objects, %u submit passes, %u threads, %u frames\n", scene.count, passes, g_jobs.NumThreads(), numFrames);
+    printf("depth   frame ms   fps      wait ms   simulate ms   latency ms   max latency   checksum\n");
+
+    FramePipeline<Snapshot> pipeline;
+    unsigned reference = 0;
+    int      status    = 0;
+    for (unsigned depth = 0; depth <= FramePipeline<Snapshot>::MAX_DEPTH; ++depth)
+    {
+        pipeline.Start(Simulate, &scene, depth);
+        g_clock.Reset();
+
+        // Fill the pipeline before timing; the same number of frames at
+        // every depth, so all of them time the same frames.
+        for (unsigned f = 0; f < FramePipeline<Snapshot>::MAX_DEPTH + 1; ++f)
+        {
+            pipeline.BeginFrame();
+            pipeline.EndFrame();
+        }
+        pipeline.ResetStats();
+
+        unsigned hash  = 0;
+        double   start = Now();
+        for (unsigned f = 0; f < numFrames; ++f)
+        {
+            const Snapshot& s = pipeline.BeginFrame();
+            hash ^= Submit(s, passes);
+            pipeline.EndFrame();
+        }
+        double frameMs = (Now() - start) / numFrames;
+        pipeline.Stop();
+
+        const FramePipelineStats& st = pipeline.Stats();
+        printf("%5u   %8.3f   %6.1f   %7.3f   %11.3f   %10.3f   %11.3f   %08x\n", depth, frameMs, 1000.0 / frameMs,
+               st.waitMs / st.frames, st.simulateMs / st.frames, st.latencyMs / st.frames, st.maxLatencyMs, hash);
+
+        if (depth == 0)
+            reference = hash;
+        else if (hash != reference)
+            status = 1;
+    }
+
+    g_jobs.Stop();
+
+    if (status != 0)
+    {
+        printf("depths drew different frames\n");
+        return 1;
+    }
+    printf("all depths drew the same frames\n");
+    return 0;
+}
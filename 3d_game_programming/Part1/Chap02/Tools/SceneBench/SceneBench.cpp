@@ -0,0 +1,689 @@
+//=============================================================================
+// SceneBench.cpp
+//
+// Draws every Chap02 scene, and scaled-up grids of them, with the software
+// rasterizer (SoftReplay.h) for a fixed number of frames on a fixed clock,
+// and reports frame-time percentiles and throughput.  No window, no device:
+// it runs the same on a build machine as on a desktop.
+//
+//     SceneBench [-frames N] [-size WxH] [-scene name] [-tiger tiger.x]
+//                [-baseline file|none [-threshold pct]] [-save file]
+//
+// Scene                 Sample            Grid variants
+// triangle              02.Vertices
+// rotating-triangle     03.Matrices       16x16
+// lit-cylinder          04.Lights         8x8
+// textured-cylinder     05.Textures       8x8
+// tiger                 06.Meshes         16x16
+// indexed-cube          07.IndexBuffer    32x32
+//
+// Animation time advances 1/60 s per frame whatever the frame took, so
+// every run draws the same frames; the hash of the last one is reported
+// with the timings.  It is taken after the timed frames, so hashing the
+// render target is not part of the frame times.  -scene runs only the
+// scenes whose name contains the argument.
+//
+// -save writes the results to a baseline file.  By default the run is
+// checked against baseline.txt next to this file (run from this
+// directory; a missing default is skipped, -baseline none skips it too),
+// but only for what is deterministic: a scene whose last frame differs is
+// a regression and the exit code is 1.  Last frames are compared only
+// when the baseline ran the same number of frames at the same size.
+//
+// Timings only hold on the machine and build that saved them, so they are
+// checked only against a baseline named with -baseline: a scene whose
+// median frame time is more than -threshold percent (default 10) slower
+// is then a regression too.  Keep such baselines per machine, outside the
+// tree.
+//
+// tiger.x is read from ../../06.Meshes (the directory of this project) or
+// -tiger; only the text .x format the sample ships is understood.
+//=============================================================================
+
+#include "SoftReplay.h"
+#include "Math3D.h"
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+static void Usage()
+{
+    fprintf(stderr,
+            "usage: SceneBench [-frames N] [-size WxH] [-scene name] [-tiger tiger.x]\n"
+            "                  [-baseline file|none [-threshold pct]] [-save file]\n");
+}
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static const unsigned WARMUP_FRAMES = 10;
+static const float    FRAME_TIME    = 1.0f / 60.0f;
+
+// Compared against unless -baseline names another file or none.
+static const char* const DEFAULT_BASELINE = "baseline.txt";
+
+
+//===============================================================
+// Geometry
+
+struct VertexPosColor       { float pos[3]; unsigned color; };
+struct VertexPosNormal      { float pos[3]; float normal[3]; };
+struct VertexPosColorTex    { float pos[3]; unsigned color; float uv[2]; };
+struct VertexPosTex         { float pos[3]; float uv[2]; };
+
+const unsigned FVF_POS_COLOR     = CAPTURE_FVF_XYZ | CAPTURE_FVF_DIFFUSE;
+const unsigned FVF_POS_NORMAL    = CAPTURE_FVF_XYZ | CAPTURE_FVF_NORMAL;
+const unsigned FVF_POS_COLOR_TEX = CAPTURE_FVF_XYZ | CAPTURE_FVF_DIFFUSE | (1 << CAPTURE_FVF_TEXCOUNT_SHIFT);
+const unsigned FVF_POS_TEX       = CAPTURE_FVF_XYZ | (1 << CAPTURE_FVF_TEXCOUNT_SHIFT);
+
+// Ids of the objects a scene creates.
+enum { VB = 1, IB = 2, MESH = 3, TEXTURE = 4 };
+
+const unsigned CYLINDER_SEGMENTS = 50;
+
+struct TigerMesh
+{
+    std::vector<VertexPosTex>   vertices;
+    std::vector<unsigned short> indices;
+    float                       material[4];
+};
+
+// Reads the first Mesh of a text .x file: positions, faces (fanned into
+// triangles) and MeshTextureCoords.
+static bool LoadTextX(const char* path, TigerMesh& mesh)
+{
+    FILE* pFile = fopen(path, "rb");
+    if (pFile == NULL)
+        return false;
+    std::string text;
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), pFile)) > 0)
+        text.append(buf, n);
+    fclose(pFile);
+
+    // Numbers after a keyword, skipping the ; and , separators.
+    struct Reader
+    {
+        const char* p;
+        bool Seek(const std::string& text, const char* keyword)
+        {
+            size_t at = text.find(keyword, p - text.c_str());
+            if (at == std::string::npos)
+                return false;
+            p = strchr(text.c_str() + at, '{');
+            if (p)
+                ++p;
+            return p != NULL;
+        }
+        double Next()
+        {
+            while (*p && !(isdigit((unsigned char)*p) || *p == '-' || *p == '.'))
+                ++p;
+            char* end;
+            double v = strtod(p, &end);
+            p = end;
+            return v;
+        }
+    } r = { text.c_str() };
+
+    if (!r.Seek(text, "\nMesh "))
+        return false;
+    unsigned numVertices = (unsigned)r.Next();
+    if (numVertices == 0 || numVertices > 65535)
+        return false;
+    mesh.vertices.resize(numVertices);
+    for (unsigned i = 0; i < numVertices; ++i)
+    {
+        for (int c = 0; c < 3; ++c)
+            mesh.vertices[i].pos[c] = (float)r.Next();
+        mesh.vertices[i].uv[0] = mesh.vertices[i].uv[1] = 0.0f;
+    }
+    unsigned numFaces = (unsigned)r.Next();
+    for (unsigned f = 0; f < numFaces; ++f)
+    {
+        unsigned count = (unsigned)r.Next();
+        unsigned first = (unsigned)r.Next(), prev = (unsigned)r.Next();
+        for (unsigned k = 2; k < count; ++k)
+        {
+            unsigned next = (unsigned)r.Next();
+            if (first >= numVertices || prev >= numVertices || next >= numVertices)
+                return false;
+            mesh.indices.push_back((unsigned short)first);
+            mesh.indices.push_back((unsigned short)prev);
+            mesh.indices.push_back((unsigned short)next);
+            prev = next;
+        }
+    }
+
+    mesh.material[0] = mesh.material[1] = mesh.material[2] = mesh.material[3] = 1.0f;
+    Reader m = r;
+    if (m.Seek(text, "Material "))
+    {
+        for (int c = 0; c < 4; ++c)
+            mesh.material[c] = (float)m.Next();
+    }
+    if (r.Seek(text, "MeshTextureCoords ") && (unsigned)r.Next() == numVertices)
+    {
+        for (unsigned i = 0; i < numVertices; ++i)
+        {
+            mesh.vertices[i].uv[0] = (float)r.Next();
+            mesh.vertices[i].uv[1] = (float)r.Next();
+        }
+    }
+    return !mesh.indices.empty();
+}
+
+
+//===============================================================
+// Scenes
+
+struct Scene
+{
+    const char* name;
+    unsigned    grid;               // grid x grid copies
+    void (*Create)(SoftReplay& r, const TigerMesh& tiger);
+    void (*Draw)(SoftReplay& r, const Scene& scene, float time);
+};
+
+static void SetMatrix(SoftReplay& r, unsigned state, const Mat4& m)
+{
+    r.SetTransform(state, m.Data());
+}
+
+// The samples' camera, pulled back to see a whole grid.
+static void SetCamera(SoftReplay& r, unsigned grid, float spacing)
+{
+    float span = (grid - 1) * spacing;
+    SetMatrix(r, CAPTURE_TS_VIEW, Mat4LookAtLH(Vec3(0.0f, 3.0f + span * 0.6f, -5.0f - span * 0.6f),
+                                               Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f)));
+    SetMatrix(r, CAPTURE_TS_PROJECTION, Mat4PerspectiveFovLH(MATH_PI / 4, 1.0f, 1.0f, 100.0f + span * 2.0f));
+}
+
+// World matrix of copy i of a grid, around rotation.
+static Mat4 GridWorld(const Mat4& rotation, unsigned i, unsigned grid, float spacing)
+{
+    float x = ((int)(i % grid) - (int)(grid - 1) * 0.5f) * spacing;
+    float z = ((int)(i / grid) - (int)(grid - 1) * 0.5f) * spacing;
+    return rotation * Mat4Translation(x, 0.0f, z);
+}
+
+static void CreateBuffer(SoftReplay& r, unsigned id, const void* pData, unsigned bytes, unsigned fvf)
+{
+    r.CreateVertexBuffer(id, bytes, fvf);
+    r.BufferData(id, 0, pData, bytes, 0);
+}
+
+static void CreateIndices(SoftReplay& r, unsigned id, const unsigned short* pData, unsigned count)
+{
+    r.CreateIndexBuffer(id, count * 2, 2);
+    r.BufferData(id, 0, pData, count * 2, 0);
+}
+
+static void BeginFrame(SoftReplay& r, unsigned color, bool lighting)
+{
+    r.Clear(CAPTURE_CLEAR_TARGET | CAPTURE_CLEAR_ZBUFFER, color, 1.0f, 0);
+    r.SetRenderState(CAPTURE_RS_CULLMODE, 1);            // D3DCULL_NONE, as the samples
+    r.SetRenderState(CAPTURE_RS_LIGHTING, lighting ? 1 : 0);
+    r.SetRenderState(CAPTURE_RS_ZENABLE, 1);
+}
+
+// 02.Vertices and 03.Matrices
+static void CreateTriangle(SoftReplay& r, const TigerMesh&)
+{
+    const VertexPosColor vertices[] =
+    {
+        { { -1.0f,  1.0f, 0.0f }, 0xffff0000 },
+        { {  1.0f,  1.0f, 0.0f }, 0xff00ff00 },
+        { {  1.0f, -1.0f, 0.0f }, 0xff00ffff },
+    };
+    CreateBuffer(r, VB, vertices, sizeof(vertices), FVF_POS_COLOR);
+}
+
+static void DrawTriangle(SoftReplay& r, const Scene& scene, float time)
+{
+    BeginFrame(r, 0xff0000ff, false);
+    if (scene.grid == 0)
+    {
+        // 02.Vertices: already in clip space.
+        Mat4 identity = Mat4Identity();
+        SetMatrix(r, CAPTURE_TS_VIEW, identity);
+        SetMatrix(r, CAPTURE_TS_PROJECTION, identity);
+        SetMatrix(r, CAPTURE_TS_WORLD, identity);
+    }
+    else
+        SetCamera(r, scene.grid, 2.5f);
+
+    r.SetStreamSource(0, VB, 0, sizeof(VertexPosColor));
+    r.SetFVF(FVF_POS_COLOR);
+    Mat4 rotation = Mat4RotationY(fmodf(time, 1.0f) * 2.0f * MATH_PI);
+    unsigned copies = scene.grid ? scene.grid * scene.grid : 1;
+    for (unsigned i = 0; i < copies; ++i)
+    {
+        if (scene.grid)
+            SetMatrix(r, CAPTURE_TS_WORLD, GridWorld(rotation, i, scene.grid, 2.5f));
+        r.DrawPrimitive(CAPTURE_PT_TRIANGLELIST, 0, 1);
+    }
+}
+
+// 04.Lights
+static void CreateLitCylinder(SoftReplay& r, const TigerMesh&)
+{
+    VertexPosNormal vertices[CYLINDER_SEGMENTS * 2];
+    for (unsigned i = 0; i < CYLINDER_SEGMENTS; ++i)
+    {
+        float theta = (2 * MATH_PI * i) / (CYLINDER_SEGMENTS - 1);
+        VertexPosNormal bottom = { { sinf(theta), -1.0f, cosf(theta) }, { sinf(theta), 0.0f, cosf(theta) } };
+        VertexPosNormal top    = { { sinf(theta),  1.0f, cosf(theta) }, { sinf(theta), 0.0f, cosf(theta) } };
+        vertices[2 * i + 0] = bottom;
+        vertices[2 * i + 1] = top;
+    }
+    CreateBuffer(r, VB, vertices, sizeof(vertices), FVF_POS_NORMAL);
+}
+
+static void DrawLitCylinder(SoftReplay& r, const Scene& scene, float time)
+{
+    BeginFrame(r, 0xff0000ff, true);
+    SetCamera(r, scene.grid, 3.0f);
+
+    CaptureMaterial material;
+    memset(&material, 0, sizeof(material));
+    material.diffuse[0] = material.ambient[0] = 1.0f;
+    material.diffuse[1] = material.ambient[1] = 1.0f;
+    material.diffuse[3] = material.ambient[3] = 1.0f;
+    r.SetMaterial(material);
+
+    CaptureLight light;
+    memset(&light, 0, sizeof(light));
+    light.type = 3;                                         // D3DLIGHT_DIRECTIONAL
+    light.diffuse[0] = light.diffuse[1] = light.diffuse[2] = 1.0f;
+    Vec3 dir = Vec3Normalize(Vec3(cosf(time * 1000.0f / 350.0f), 1.0f, sinf(time * 1000.0f / 350.0f)));
+    light.direction[0] = dir.x;
+    light.direction[1] = dir.y;
+    light.direction[2] = dir.z;
+    light.range = 1000.0f;
+    r.SetLight(0, light);
+    r.LightEnable(0, true);
+    r.SetRenderState(CAPTURE_RS_AMBIENT, 0x00202020);
+
+    r.SetStreamSource(0, VB, 0, sizeof(VertexPosNormal));
+    r.SetFVF(FVF_POS_NORMAL);
+    Mat4 rotation = Mat4RotationX(time * 1000.0f / 500.0f);
+    for (unsigned i = 0; i < scene.grid * scene.grid; ++i)
+    {
+        SetMatrix(r, CAPTURE_TS_WORLD, GridWorld(rotation, i, scene.grid, 3.0f));
+        r.DrawPrimitive(CAPTURE_PT_TRIANGLESTRIP, 0, 2 * CYLINDER_SEGMENTS - 2);
+    }
+}
+
+// 05.Textures
+static void CreateTexturedCylinder(SoftReplay& r, const TigerMesh&)
+{
+    VertexPosColorTex vertices[CYLINDER_SEGMENTS * 2];
+    for (unsigned i = 0; i < CYLINDER_SEGMENTS; ++i)
+    {
+        float theta = (2 * MATH_PI * i) / (CYLINDER_SEGMENTS - 1);
+        float u = (float)i / (CYLINDER_SEGMENTS - 1);
+        VertexPosColorTex bottom = { { sinf(theta), -1.0f, cosf(theta) }, 0xffffffff, { u, 1.0f } };
+        VertexPosColorTex top    = { { sinf(theta),  1.0f, cosf(theta) }, 0xff808080, { u, 0.0f } };
+        vertices[2 * i + 0] = bottom;
+        vertices[2 * i + 1] = top;
+    }
+    CreateBuffer(r, VB, vertices, sizeof(vertices), FVF_POS_COLOR_TEX);
+}
+
+static void DrawTexturedCylinder(SoftReplay& r, const Scene& scene, float time)
+{
+    BeginFrame(r, 0xff0000ff, false);
+    SetCamera(r, scene.grid, 3.0f);
+    r.SetTexture(0, TEXTURE);
+    r.SetStreamSource(0, VB, 0, sizeof(VertexPosColorTex));
+    r.SetFVF(FVF_POS_COLOR_TEX);
+    Mat4 rotation = Mat4RotationX(time);
+    for (unsigned i = 0; i < scene.grid * scene.grid; ++i)
+    {
+        SetMatrix(r, CAPTURE_TS_WORLD, GridWorld(rotation, i, scene.grid, 3.0f));
+        r.DrawPrimitive(CAPTURE_PT_TRIANGLESTRIP, 0, 2 * CYLINDER_SEGMENTS - 2);
+    }
+}
+
+// 06.Meshes
+static void CreateTiger(SoftReplay& r, const TigerMesh& tiger)
+{
+    CreateBuffer(r, VB, &tiger.vertices[0], (unsigned)(tiger.vertices.size() * sizeof(VertexPosTex)), FVF_POS_TEX);
+    CreateIndices(r, IB, &tiger.indices[0], (unsigned)tiger.indices.size());
+
+    CaptureMesh mesh = { MESH, VB, IB, FVF_POS_TEX, sizeof(VertexPosTex), 1 };
+    CaptureAttributeRange range = { 0, 0, (unsigned)tiger.indices.size() / 3, 0, (unsigned)tiger.vertices.size() };
+    r.CreateMesh(mesh, &range);
+
+    CaptureMaterial material;
+    memset(&material, 0, sizeof(material));
+    memcpy(material.diffuse, tiger.material, sizeof(material.diffuse));
+    memcpy(material.ambient, tiger.material, sizeof(material.ambient));
+    r.SetMaterial(material);
+}
+
+static void DrawTiger(SoftReplay& r, const Scene& scene, float time)
+{
+    BeginFrame(r, 0xff0000ff, true);
+    r.SetRenderState(CAPTURE_RS_AMBIENT, 0xffffffff);
+    SetCamera(r, scene.grid, 3.0f);
+    r.SetTexture(0, TEXTURE);
+    Mat4 rotation = Mat4RotationY(time);
+    for (unsigned i = 0; i < scene.grid * scene.grid; ++i)
+    {
+        SetMatrix(r, CAPTURE_TS_WORLD, GridWorld(rotation, i, scene.grid, 3.0f));
+        r.DrawSubset(MESH, 0);
+    }
+}
+
+// 07.IndexBuffer
+static void CreateCube(SoftReplay& r, const TigerMesh&)
+{
+    const VertexPosColor vertices[] =
+    {
+        { { -1,  1,  1 }, 0xffff0000 }, { {  1,  1,  1 }, 0xff00ff00 },
+        { {  1,  1, -1 }, 0xff0000ff }, { { -1,  1, -1 }, 0xffffff00 },
+        { { -1, -1,  1 }, 0xff00ffff }, { {  1, -1,  1 }, 0xffff00ff },
+        { {  1, -1, -1 }, 0xff000000 }, { { -1, -1, -1 }, 0xffffffff },
+    };
+    const unsigned short indices[] =
+    {
+        0, 1, 2,  0, 2, 3,      4, 6, 5,  4, 7, 6,
+        0, 3, 7,  0, 7, 4,      1, 5, 6,  1, 6, 2,
+        3, 2, 6,  3, 6, 7,      0, 4, 5,  0, 5, 1,
+    };
+    CreateBuffer(r, VB, vertices, sizeof(vertices), FVF_POS_COLOR);
+    CreateIndices(r, IB, indices, 36);
+}
+
+static void DrawCube(SoftReplay& r, const Scene& scene, float time)
+{
+    BeginFrame(r, 0xff0000ff, false);
+    SetCamera(r, scene.grid, 3.0f);
+    r.SetStreamSource(0, VB, 0, sizeof(VertexPosColor));
+    r.SetIndices(IB);
+    r.SetFVF(FVF_POS_COLOR);
+    Mat4 rotation = Mat4RotationY(time * 1000.0f / 500.0f);
+    for (unsigned i = 0; i < scene.grid * scene.grid; ++i)
+    {
+        SetMatrix(r, CAPTURE_TS_WORLD, GridWorld(rotation, i, scene.grid, 3.0f));
+        r.DrawIndexedPrimitive(CAPTURE_PT_TRIANGLELIST, 0, 0, 8, 0, 12);
+    }
+}
+
+static const Scene s_scenes[] =
+{
+    { "triangle",                 0,  CreateTriangle,         DrawTriangle },
+    { "rotating-triangle",        1,  CreateTriangle,         DrawTriangle },
+    { "rotating-triangle/16x16",  16, CreateTriangle,         DrawTriangle },
+    { "lit-cylinder",             1,  CreateLitCylinder,      DrawLitCylinder },
+    { "lit-cylinder/8x8",         8,  CreateLitCylinder,      DrawLitCylinder },
+    { "textured-cylinder",        1,  CreateTexturedCylinder, DrawTexturedCylinder },
+    { "textured-cylinder/8x8",    8,  CreateTexturedCylinder, DrawTexturedCylinder },
+    { "tiger",                    1,  CreateTiger,            DrawTiger },
+    { "tiger/16x16",              16, CreateTiger,            DrawTiger },
+    { "indexed-cube",             1,  CreateCube,             DrawCube },
+    { "indexed-cube/32x32",       32, CreateCube,             DrawCube },
+};
+
+
+//===============================================================
+// Results and baselines
+
+struct Result
+{
+    std::string        scene;
+    double             p50, p90, p99, max, avg;     // ms per frame
+    double             trianglesPerSecond;
+    double             pixelsPerSecond;
+    unsigned long long hash;                        // last frame
+};
+
+static double Percentile(const std::vector<double>& sorted, double p)
+{
+    size_t i = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(i, sorted.size() - 1)];
+}
+
+static Result RunScene(SoftReplay& replay, const Scene& scene, const TigerMesh& tiger, unsigned frames)
+{
+    replay.Reset();
+    scene.Create(replay, tiger);
+
+    // Warm caches and buffers on frames that are not timed, then draw the
+    // timed ones from the same clock.  Only the last frame is hashed, after
+    // the timing.
+    replay.SetFrameHashing(false);
+    for (unsigned f = 0; f < WARMUP_FRAMES; ++f)
+    {
+        scene.Draw(replay, scene, f * FRAME_TIME);
+        replay.EndFrame(f);
+    }
+
+    SoftReplayStats before      = replay.Stats();
+    SoftRasterStats rasterBefore = replay.Rasterizer().Stats();
+    std::vector<double> ms(frames);
+    for (unsigned f = 0; f < frames; ++f)
+    {
+        Clock::time_point start = Clock::now();
+        scene.Draw(replay, scene, (WARMUP_FRAMES + f) * FRAME_TIME);
+        replay.EndFrame(WARMUP_FRAMES + f);
+        ms[f] = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+    replay.SetFrameHashing(true);
+
+    Result r;
+    r.scene = scene.name;
+    double total = 0.0;
+    for (unsigned f = 0; f < frames; ++f)
+        total += ms[f];
+    std::sort(ms.begin(), ms.end());
+    r.p50 = Percentile(ms, 0.50);
+    r.p90 = Percentile(ms, 0.90);
+    r.p99 = Percentile(ms, 0.99);
+    r.max = ms.back();
+    r.avg = total / frames;
+    double seconds = total * 0.001;
+    r.trianglesPerSecond = seconds > 0.0 ? (replay.Stats().triangles - before.triangles) / seconds : 0.0;
+    r.pixelsPerSecond    = seconds > 0.0 ? (replay.Rasterizer().Stats().pixels - rasterBefore.pixels) / seconds : 0.0;
+    r.hash = replay.HashRenderTarget();
+    return r;
+}
+
+static bool SaveBaseline(const char* path, const std::vector<Result>& results, unsigned frames,
+                         unsigned width, unsigned height)
+{
+    FILE* pFile = fopen(path, "w");
+    if (pFile == NULL)
+        return false;
+    fprintf(pFile, "# SceneBench baseline: %u frames at %ux%u\n", frames, width, height);
+    fprintf(pFile, "# timings are only comparable on the machine and build that wrote this file\n");
+    fprintf(pFile, "# scene p50_ms p99_ms last_frame_hash\n");
+    for (size_t i = 0; i < results.size(); ++i)
+        fprintf(pFile, "%s %.4f %.4f %016llx\n", results[i].scene.c_str(), results[i].p50, results[i].p99, results[i].hash);
+    return fclose(pFile) == 0;
+}
+
+struct BaselineEntry
+{
+    std::string        scene;
+    double             p50, p99;
+    unsigned long long hash;
+};
+
+// frames, width and height are those the baseline was run with, or 0.
+static bool LoadBaseline(const char* path, std::vector<BaselineEntry>& entries, unsigned& frames,
+                         unsigned& width, unsigned& height)
+{
+    FILE* pFile = fopen(path, "r");
+    if (pFile == NULL)
+        return false;
+    frames = width = height = 0;
+    char line[512];
+    while (fgets(line, sizeof(line), pFile))
+    {
+        if (sscanf(line, "# SceneBench baseline: %u frames at %ux%u", &frames, &width, &height) == 3)
+            continue;
+        char name[256];
+        BaselineEntry e;
+        if (line[0] == '#' || sscanf(line, "%255s %lf %lf %llx", name, &e.p50, &e.p99, &e.hash) != 4)
+            continue;
+        e.scene = name;
+        entries.push_back(e);
+    }
+    fclose(pFile);
+    return true;
+}
+
+
+//===============================================================
+
+int main(int argc, char* argv[])
+{
+    unsigned    frames = 300, width = 300, height = 300;
+    const char* filter = NULL;
+    const char* tigerPath = "../../06.Meshes/tiger.x";
+    const char* baselinePath = DEFAULT_BASELINE;
+    const char* savePath = NULL;
+    double      threshold = 10.0;
+    bool        checkTimes = false;         // only against a baseline named with -baseline
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc)
+            frames = (unsigned)std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "-size") == 0 && i + 1 < argc)
+        {
+            if (sscanf(argv[++i], "%ux%u", &width, &height) != 2)
+            {
+                Usage();
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "-scene") == 0 && i + 1 < argc)
+            filter = argv[++i];
+        else if (strcmp(argv[i], "-tiger") == 0 && i + 1 < argc)
+            tigerPath = argv[++i];
+        else if (strcmp(argv[i], "-baseline") == 0 && i + 1 < argc)
+        {
+            baselinePath = argv[++i];
+            checkTimes   = true;
+            if (strcmp(baselinePath, "none") == 0)
+                baselinePath = NULL;
+        }
+        else if (strcmp(argv[i], "-threshold") == 0 && i + 1 < argc)
+            threshold = atof(argv[++i]);
+        else if (strcmp(argv[i], "-save") == 0 && i + 1 < argc)
+            savePath = argv[++i];
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    SoftReplay replay;
+    if (!replay.SetRenderTarget(width, height))
+    {
+        Usage();
+        return 1;
+    }
+
+    TigerMesh tiger;
+    bool haveTiger = LoadTextX(tigerPath, tiger);
+    if (!haveTiger)
+        fprintf(stderr, "cannot read %s; skipping the tiger scenes\n", tigerPath);
+
+    printf("%u frames at %ux%u, %u warm-up frames, fixed %.4f s clock step\n",
+           frames, width, height, WARMUP_FRAMES, FRAME_TIME);
+    printf("%-26s %8s %8s %8s %8s %10s %10s  %s\n",
+           "scene", "p50 ms", "p90 ms", "p99 ms", "max ms", "Mtri/s", "Mpix/s", "last frame");
+
+    std::vector<Result> results;
+    for (size_t s = 0; s < sizeof(s_scenes) / sizeof(s_scenes[0]); ++s)
+    {
+        const Scene& scene = s_scenes[s];
+        if (filter && strstr(scene.name, filter) == NULL)
+            continue;
+        if (scene.Create == CreateTiger && !haveTiger)
+            continue;
+
+        Result r = RunScene(replay, scene, tiger, frames);
+        printf("%-26s %8.3f %8.3f %8.3f %8.3f %10.2f %10.2f  %016llx\n", r.scene.c_str(), r.p50, r.p90, r.p99,
+               r.max, r.trianglesPerSecond * 1e-6, r.pixelsPerSecond * 1e-6, r.hash);
+        results.push_back(r);
+    }
+
+    int status = 0;
+    std::vector<BaselineEntry> baseline;
+    unsigned baseFrames = 0, baseWidth = 0, baseHeight = 0;
+    if (baselinePath && !LoadBaseline(baselinePath, baseline, baseFrames, baseWidth, baseHeight))
+    {
+        // Only a baseline asked for by name has to exist.
+        if (baselinePath != DEFAULT_BASELINE)
+        {
+            fprintf(stderr, "cannot read %s\n", baselinePath);
+            return 1;
+        }
+        printf("\nno %s here; nothing to compare against\n", baselinePath);
+        baselinePath = NULL;
+    }
+    if (baselinePath)
+    {
+        // The last frames are only the same picture for the same run.
+        bool compareFrames = baseFrames == frames && baseWidth == width && baseHeight == height;
+        unsigned regressions = 0;
+        if (checkTimes)
+            printf("\nagainst %s (threshold %.1f%%):\n", baselinePath, threshold);
+        else
+            printf("\nagainst %s (last frames only; timings are checked with -baseline):\n", baselinePath);
+        if (!compareFrames)
+            printf("baseline ran %u frames at %ux%u; last frames not compared\n", baseFrames, baseWidth, baseHeight);
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const Result& r = results[i];
+            const BaselineEntry* pBase = NULL;
+            for (size_t b = 0; b < baseline.size() && pBase == NULL; ++b)
+            {
+                if (baseline[b].scene == r.scene)
+                    pBase = &baseline[b];
+            }
+            if (pBase == NULL)
+            {
+                printf("%-26s not in the baseline\n", r.scene.c_str());
+                continue;
+            }
+
+            double change = pBase->p50 > 0.0 ? 100.0 * (r.p50 - pBase->p50) / pBase->p50 : 0.0;
+            bool slower = checkTimes && change > threshold;
+            bool differs = compareFrames && r.hash != pBase->hash;
+            printf("%-26s p50 %8.3f -> %8.3f ms (%+6.1f%%)%s%s\n", r.scene.c_str(), pBase->p50, r.p50, change,
+                   slower ? "  REGRESSION" : "", differs ? "  LAST FRAME DIFFERS" : "");
+            if (slower || differs)
+                ++regressions;
+        }
+        printf("%u of %u scenes regressed\n", regressions, (unsigned)results.size());
+        if (regressions)
+            status = 1;
+    }
+
+    if (savePath)
+    {
+        if (SaveBaseline(savePath, results, frames, width, height))
+            printf("baseline written to %s\n", savePath);
+        else
+        {
+            fprintf(stderr, "cannot write %s\n", savePath);
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,196 @@
+//=============================================================================
+// ShaderCook.cpp
+//
+// Fills the effect cache (see Common/EffectCache.h) ahead of time, so the
+// first launch of a sample does not compile anything either.
+//
+//     ShaderCook [-dir shadercache] [-debug] [-permutations] [-D NAME[=VALUE]]... file.fx...
+//     ShaderCook -compare N [-debug] [-D ...] file.fx...
+//
+// Run it from the sample's directory (or point -dir at the sample's
+// shadercache) with the same flags and macros the sample uses; the samples
+// pass D3DXSHADER_DEBUG, hence -debug.  -permutations cooks every feature
+// combination of Common/ShaderPermutations.h (the -D macros are added to
+// each), which is what 03.Matrices compiles vertex.fx with.
+//
+// -compare times N cold starts (compiling from source, as the samples did
+// before the cache) against N warm starts (reading and validating the
+// cached binary).  Creating the effect on the device costs the same in
+// both cases and is left out, so no device is needed.
+//=============================================================================
+
+#include "EffectCache.h"
+#include "AssetLoaders.h"
+#include "AssetPack.h"
+#include "ShaderPermutations.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define snprintf _snprintf
+#endif
+
+
+static double MillisecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// What CreateEffectFromAsset does before the device gets involved.
+static bool CompileFromSource(const char* name, const D3DXMACRO* pDefines, DWORD flags)
+{
+    AssetData source;
+    if (!g_assets.Load(name, source))
+        return false;
+
+    AssetInclude         include;
+    ID3DXEffectCompiler* pCompiler = NULL;
+    ID3DXBuffer*         pCompiled = NULL;
+    ID3DXBuffer*         pErrors   = NULL;
+    HRESULT hr = D3DXCreateEffectCompiler((LPCSTR)source.Data(), (UINT)source.Size(), pDefines,
+                                          &include, flags, &pCompiler, &pErrors);
+    if (SUCCEEDED(hr))
+    {
+        hr = pCompiler->CompileEffect(flags, &pCompiled, NULL);
+        pCompiler->Release();
+    }
+    if (pErrors)
+        pErrors->Release();
+    if (pCompiled)
+        pCompiled->Release();
+    return SUCCEEDED(hr);
+}
+
+static void Compare(const char* name, const D3DXMACRO* pDefines, DWORD flags, unsigned runs)
+{
+    double coldMin = 1e30, coldSum = 0.0, warmMin = 1e30, warmSum = 0.0;
+    for (unsigned i = 0; i < runs; ++i)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (!CompileFromSource(name, pDefines, flags))
+        {
+            fprintf(stderr, "%s: compile failed\n", name);
+            return;
+        }
+        double cold = MillisecondsSince(start);
+
+        start = std::chrono::steady_clock::now();
+        g_effectCache.Cook(name, pDefines, flags);
+        double warm = MillisecondsSince(start);
+
+        coldSum += cold;
+        warmSum += warm;
+        if (cold < coldMin) coldMin = cold;
+        if (warm < warmMin) warmMin = warm;
+    }
+
+    printf("%s: cold %.2f ms (min %.2f), warm %.2f ms (min %.2f), %.1fx\n", name,
+           coldSum / runs, coldMin, warmSum / runs, warmMin,
+           warmSum > 0.0 ? coldSum / warmSum : 0.0);
+}
+
+static void Usage()
+{
+    fprintf(stderr,
+            "usage: ShaderCook [-dir shadercache] [-debug] [-permutations] [-D NAME[=VALUE]]... file.fx...\n"
+            "       ShaderCook -compare N [-debug] [-D NAME[=VALUE]]... file.fx...\n");
+}
+
+
+int main(int argc, char* argv[])
+{
+    DWORD    flags        = 0;
+    unsigned compare      = 0;
+    bool     permutations = false;
+    int      arg          = 1;
+
+    // D3DXMACRO points into these.
+    std::vector<std::string> names, values;
+
+    for (; arg < argc && argv[arg][0] == '-'; ++arg)
+    {
+        if (strcmp(argv[arg], "-dir") == 0 && arg + 1 < argc)
+            g_effectCache.SetDirectory(argv[++arg]);
+        else if (strcmp(argv[arg], "-debug") == 0)
+            flags |= D3DXSHADER_DEBUG;
+        else if (strcmp(argv[arg], "-permutations") == 0)
+            permutations = true;
+        else if (strcmp(argv[arg], "-compare") == 0 && arg + 1 < argc)
+            compare = (unsigned)atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-D") == 0 && arg + 1 < argc)
+        {
+            std::string def = argv[++arg];
+            size_t eq = def.find('=');
+            names.push_back(def.substr(0, eq));
+            values.push_back(eq == std::string::npos ? "1" : def.substr(eq + 1));
+        }
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    if (arg == argc)
+    {
+        Usage();
+        return 1;
+    }
+
+    std::vector<D3DXMACRO> defines;
+    for (size_t i = 0; i < names.size(); ++i)
+    {
+        D3DXMACRO m = { names[i].c_str(), values[i].c_str() };
+        defines.push_back(m);
+    }
+
+    // One macro set per variant: the feature keys, then the -D macros.
+    unsigned numVariants = permutations ? SHADER_PERMUTATION_COUNT : 1;
+    std::vector<std::vector<D3DXMACRO> > variants(numVariants);
+    for (unsigned v = 0; v < numVariants; ++v)
+    {
+        if (permutations)
+        {
+            D3DXMACRO features[SHADER_FEATURE_COUNT + 1];
+            BuildFeatureMacros(v, features);
+            variants[v].assign(features, features + SHADER_FEATURE_COUNT);
+        }
+        variants[v].insert(variants[v].end(), defines.begin(), defines.end());
+        D3DXMACRO end = { NULL, NULL };
+        variants[v].push_back(end);
+    }
+
+    g_assets.Mount("assets.pak");
+
+    int failed = 0;
+    for (; arg < argc; ++arg)
+    {
+        for (unsigned v = 0; v < numVariants; ++v)
+        {
+            const D3DXMACRO* pDefines = &variants[v][0];
+            char variant[16] = "";
+            if (permutations)
+                snprintf(variant, sizeof(variant), "#%x", v);
+
+            std::string errors;
+            unsigned hits = g_effectCache.Stats().hits;
+            if (!g_effectCache.Cook(argv[arg], pDefines, flags, &errors))
+            {
+                fprintf(stderr, "%s%s: %s\n", argv[arg], variant, errors.empty() ? "cannot load" : errors.c_str());
+                ++failed;
+                continue;
+            }
+            printf("%s%s -> %s (%s)\n", argv[arg], variant, g_effectCache.BlobPath(argv[arg], pDefines, flags).c_str(),
+                   g_effectCache.Stats().hits != hits ? "up to date" : "compiled");
+
+            if (compare)
+                Compare(argv[arg], pDefines, flags, compare);
+        }
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,413 @@
+//=============================================================================
+// SoftRender.cpp
+//
+// Runs the 03.Matrices scene (vertex.fx, one rotating triangle) through the
+// software shader engine with no device, and reports shader and raster
+// statistics.
+//
+//     SoftRender [-frames N] [-size WxH] [-out frame.bmp]
+//                [-fx vertex.fx | -vs color.vso -ps color.pso] [-check]
+//
+// -fx compiles ColorVS/ColorPS with D3DX, in builds with SOFTRENDER_D3DX
+// defined ("msbuild /p:SoftRenderD3DX=true"; the default build needs no
+// DirectX SDK).  -vs/-ps load the output of "fxc /T vs_2_0 /E ColorVS
+// /Fo color.vso vertex.fx" and the ps_2_0 counterpart, which works
+// everywhere.  Without either, built-in hand-assembled equivalents of
+// ColorVS/ColorPS are used.
+//
+// -check compares the engine against reference values computed here: the
+// clip-space positions and colours out of the vertex shader, and every
+// pixel of the rendered frame that is not within a pixel of an edge.
+// It returns non-zero on a mismatch.
+//=============================================================================
+
+#include "SoftRasterizer.h"
+#include "FileUtil.h"
+#include "Math3D.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#ifdef SOFTRENDER_D3DX
+#include "SoftEffect.h"
+#endif
+
+
+//===============================================================
+// ColorVS / ColorPS from 03.Matrices/vertex.fx, assembled by hand:
+//
+//     vs_2_0                       ps_2_0
+//     dcl_position v0              dcl v0
+//     dcl_color v1                 mov oC0, v0
+//     dp4 oPos.x, v0, c0
+//     dp4 oPos.y, v0, c1
+//     dp4 oPos.z, v0, c2
+//     dp4 oPos.w, v0, c3
+//     mov oD0, v1
+//
+// c0..c3 hold the columns of gWVP, as fxc packs it by default.
+
+static const unsigned s_colorVS[] =
+{
+    0xFFFE0200,
+    0x0200001F, 0x80000000, 0x900F0000,
+    0x0200001F, 0x8000000A, 0x900F0001,
+    0x03000009, 0xC0010000, 0x90E40000, 0xA0E40000,
+    0x03000009, 0xC0020000, 0x90E40000, 0xA0E40001,
+    0x03000009, 0xC0040000, 0x90E40000, 0xA0E40002,
+    0x03000009, 0xC0080000, 0x90E40000, 0xA0E40003,
+    0x02000001, 0xD00F0000, 0x90E40001,
+    0x0000FFFF
+};
+
+static const unsigned s_colorPS[] =
+{
+    0xFFFF0200,
+    0x0200001F, 0x80000000, 0x900F0000,
+    0x02000001, 0x800F0800, 0x90E40000,
+    0x0000FFFF
+};
+
+
+//===============================================================
+// Scene
+
+struct VertexPosColor
+{
+    float    pos[3];
+    unsigned color;
+};
+
+static const VertexPosColor s_vertices[] =
+{
+    { { -1.0f,  1.0f, 0.0f }, 0xffff0000 },
+    { {  1.0f,  1.0f, 0.0f }, 0xff00ff00 },
+    { {  1.0f, -1.0f, 0.0f }, 0xff00ffff },
+};
+
+static const unsigned short s_indices[] = { 0, 1, 2 };
+
+static const SoftVertexElement s_elements[] =
+{
+    { 0,  SOFT_DECL_FLOAT3,   SUSAGE_POSITION, 0 },
+    { 12, SOFT_DECL_D3DCOLOR, SUSAGE_COLOR,    0 },
+};
+
+static const unsigned CLEAR_COLOR = 0xff000000;
+
+static Mat4 SceneWVP(unsigned frame, unsigned width, unsigned height)
+{
+    // One turn every 60 frames, instead of every second as in the sample,
+    // so runs are repeatable.
+    Mat4 world = Mat4RotationY((frame % 60) * (2.0f * MATH_PI) / 60.0f);
+    return world * Mat4LookAtLH(Vec3(0.0f, 3.0f, -5.0f), Vec3(0, 0, 0), Vec3(0, 1, 0)) *
+           Mat4PerspectiveFovLH(MATH_PI / 4, (float)width / height, 1.0f, 100.0f);
+}
+
+static void SetWVP(const ShaderProgram& vs, ShaderConstants& constants, const Mat4& wvp)
+{
+    if (constants.SetMatrix(vs, "gWVP", &wvp.m[0][0]))
+        return;
+
+    // No constant table (built-in program): columns into c0..c3.
+    for (unsigned c = 0; c < 4; ++c)
+    {
+        float column[4] = { wvp.m[0][c], wvp.m[1][c], wvp.m[2][c], wvp.m[3][c] };
+        constants.SetFloat4(c, column);
+    }
+}
+
+
+//===============================================================
+// Conformance check
+
+static bool Near(float a, float b, float tolerance)
+{
+    return fabsf(a - b) <= tolerance * (1.0f + fabsf(b));
+}
+
+static unsigned CheckVertexShader(const ShaderProgram& vs, const ShaderConstants& constants,
+                                  const Mat4& wvp)
+{
+    ShaderVM vm;
+    vm.Bind(&vs, &constants);
+
+    int posReg = vs.FindInput(SUSAGE_POSITION, 0), colorReg = vs.FindInput(SUSAGE_COLOR, 0);
+    if (posReg < 0 || colorReg < 0)
+    {
+        fprintf(stderr, "check: vertex shader has no position/color input\n");
+        return 1;
+    }
+
+    float in[2][4][LANE_COUNT];
+    for (unsigned l = 0; l < LANE_COUNT; ++l)
+    {
+        // Varied inputs, including ones outside the sample's triangle.
+        float x = -2.0f + 1.25f * l, y = 0.5f * l - 1.0f, z = 0.25f * l;
+        in[0][0][l] = x; in[0][1][l] = y; in[0][2][l] = z; in[0][3][l] = 1.0f;
+        in[1][0][l] = 0.1f * l; in[1][1][l] = 0.2f; in[1][2][l] = 1.0f - 0.1f * l; in[1][3][l] = 1.0f;
+    }
+
+    VertexLanes lanes;
+    for (unsigned k = 0; k < 4; ++k)
+    {
+        lanes.inputs[posReg].c[k]   = LaneF::Load(in[0][k]);
+        lanes.inputs[colorReg].c[k] = LaneF::Load(in[1][k]);
+    }
+    vm.RunVertices(lanes);
+
+    unsigned errors = 0;
+    float out[4][LANE_COUNT], color[4][LANE_COUNT];
+    for (unsigned k = 0; k < 4; ++k)
+    {
+        lanes.position.c[k].Store(out[k]);
+        lanes.varyings[VARYING_COLOR0].c[k].Store(color[k]);
+    }
+    for (unsigned l = 0; l < LANE_COUNT; ++l)
+    {
+        for (unsigned j = 0; j < 4; ++j)
+        {
+            float expect = in[0][0][l] * wvp.m[0][j] + in[0][1][l] * wvp.m[1][j] +
+                           in[0][2][l] * wvp.m[2][j] + wvp.m[3][j];
+            if (!Near(out[j][l], expect, 1e-5f))
+            {
+                fprintf(stderr, "check: vertex %u oPos[%u] = %g, expected %g\n", l, j, out[j][l], expect);
+                ++errors;
+            }
+            if (!Near(color[j][l], in[1][j][l], 1e-6f))
+            {
+                fprintf(stderr, "check: vertex %u oD0[%u] = %g, expected %g\n", l, j, color[j][l], in[1][j][l]);
+                ++errors;
+            }
+        }
+    }
+    return errors;
+}
+
+static unsigned CheckFrame(const SoftRasterizer& raster, const Mat4& wvp)
+{
+    unsigned w = raster.Width(), h = raster.Height();
+
+    float sx[3], sy[3], invW[3], rgb[3][3];
+    for (unsigned i = 0; i < 3; ++i)
+    {
+        const float* p = s_vertices[i].pos;
+        float c[4];
+        for (unsigned j = 0; j < 4; ++j)
+            c[j] = p[0] * wvp.m[0][j] + p[1] * wvp.m[1][j] + p[2] * wvp.m[2][j] + wvp.m[3][j];
+        invW[i] = 1.0f / c[3];
+        sx[i] = (c[0] * invW[i] + 1.0f) * 0.5f * w;
+        sy[i] = (1.0f - c[1] * invW[i]) * 0.5f * h;
+        for (unsigned k = 0; k < 3; ++k)
+            rgb[i][k] = ((s_vertices[i].color >> (16 - 8 * k)) & 0xFF) / 255.0f;
+    }
+
+    float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sy[1] - sy[0]) * (sx[2] - sx[0]);
+    unsigned errors = 0, compared = 0;
+    for (unsigned y = 0; y < h; ++y)
+    {
+        for (unsigned x = 0; x < w; ++x)
+        {
+            float lambda[3];
+            bool  nearEdge = false, inside = true;
+            for (unsigned i = 0; i < 3; ++i)
+            {
+                unsigned s = (i + 1) % 3, t = (i + 2) % 3;
+                float dx = sx[t] - sx[s], dy = sy[t] - sy[s];
+                float e = (dx * (y - sy[s]) - dy * (x - sx[s])) / area;
+                float dist = fabsf(e * area) / sqrtf(dx * dx + dy * dy);
+                lambda[i] = e;
+                nearEdge = nearEdge || dist < 1.0f;
+                inside = inside && e >= 0.0f;
+            }
+            if (nearEdge)
+                continue;
+
+            unsigned expect = CLEAR_COLOR;
+            if (inside)
+            {
+                float q[3], sum = 0.0f;
+                for (unsigned i = 0; i < 3; ++i)
+                    sum += q[i] = lambda[i] * invW[i];
+                expect = 0xff000000;
+                for (unsigned k = 0; k < 3; ++k)
+                {
+                    float v = (q[0] * rgb[0][k] + q[1] * rgb[1][k] + q[2] * rgb[2][k]) / sum;
+                    expect |= (unsigned)(v * 255.0f + 0.5f) << (16 - 8 * k);
+                }
+            }
+
+            unsigned got = raster.Pixels()[(size_t)y * w + x];
+            bool ok = true;
+            for (unsigned k = 0; k < 32; k += 8)
+            {
+                int d = (int)((got >> k) & 0xFF) - (int)((expect >> k) & 0xFF);
+                ok = ok && d >= -1 && d <= 1;
+            }
+            ++compared;
+            if (!ok && errors++ < 10)
+                fprintf(stderr, "check: pixel (%u,%u) = %08x, expected %08x\n", x, y, got, expect);
+        }
+    }
+
+    printf("check: %u pixels compared, %u mismatches\n", compared, errors);
+    return errors;
+}
+
+
+//===============================================================
+
+static bool LoadProgramFile(const char* path, ShaderProgram& program)
+{
+    std::vector<char> bytes;
+    std::string error;
+    if (!ReadFileBytes(path, bytes) || bytes.empty())
+    {
+        fprintf(stderr, "cannot read %s\n", path);
+        return false;
+    }
+    if (!program.Load(&bytes[0], bytes.size(), &error))
+    {
+        fprintf(stderr, "%s: %s\n", path, error.c_str());
+        return false;
+    }
+    return true;
+}
+
+static void Usage()
+{
+    fprintf(stderr,
+            "usage: SoftRender [-frames N] [-size WxH] [-out frame.bmp]\n"
+            "                  [-fx vertex.fx | -vs color.vso -ps color.pso] [-check]\n");
+}
+
+
+int main(int argc, char* argv[])
+{
+    unsigned    frames = 600, width = 256, height = 256;
+    const char* outPath = NULL;
+    const char* fxPath = NULL;
+    const char* vsPath = NULL;
+    const char* psPath = NULL;
+    bool        check = false;
+
+    for (int arg = 1; arg < argc; ++arg)
+    {
+        if (strcmp(argv[arg], "-frames") == 0 && arg + 1 < argc)
+            frames = (unsigned)atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "-size") == 0 && arg + 1 < argc)
+        {
+            if (sscanf(argv[++arg], "%ux%u", &width, &height) != 2)
+            {
+                Usage();
+                return 1;
+            }
+        }
+        else if (strcmp(argv[arg], "-out") == 0 && arg + 1 < argc)
+            outPath = argv[++arg];
+        else if (strcmp(argv[arg], "-fx") == 0 && arg + 1 < argc)
+            fxPath = argv[++arg];
+        else if (strcmp(argv[arg], "-vs") == 0 && arg + 1 < argc)
+            vsPath = argv[++arg];
+        else if (strcmp(argv[arg], "-ps") == 0 && arg + 1 < argc)
+            psPath = argv[++arg];
+        else if (strcmp(argv[arg], "-check") == 0)
+            check = true;
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    ShaderProgram vs, ps;
+    std::string   error;
+    if (fxPath)
+    {
+#ifdef SOFTRENDER_D3DX
+        if (!CompileShaderFromAsset(fxPath, "ColorVS", "vs_2_0", 0, vs, &error) ||
+            !CompileShaderFromAsset(fxPath, "ColorPS", "ps_2_0", 0, ps, &error))
+        {
+            fprintf(stderr, "%s: %s\n", fxPath, error.c_str());
+            return 1;
+        }
+#else
+        fprintf(stderr, "-fx needs a build with SOFTRENDER_D3DX; use -vs/-ps with fxc output\n");
+        return 1;
+#endif
+    }
+    else
+    {
+        if (vsPath ? !LoadProgramFile(vsPath, vs)
+                   : !vs.Load(s_colorVS, sizeof(s_colorVS), &error))
+            return 1;
+        if (psPath ? !LoadProgramFile(psPath, ps)
+                   : !ps.Load(s_colorPS, sizeof(s_colorPS), &error))
+            return 1;
+    }
+    if (!error.empty())
+    {
+        fprintf(stderr, "built-in program: %s\n", error.c_str());
+        return 1;
+    }
+
+    SoftRasterizer raster;
+    if (!raster.SetRenderTarget(width, height))
+    {
+        Usage();
+        return 1;
+    }
+
+    ShaderConstants vsConstants, psConstants;
+    raster.SetVertexShader(&vs, &vsConstants);
+    raster.SetPixelShader(&ps, &psConstants);
+    raster.SetCullMode(SOFT_CULL_NONE);
+
+    SoftVertexStream stream;
+    stream.pData       = s_vertices;
+    stream.stride      = sizeof(VertexPosColor);
+    stream.pElements   = s_elements;
+    stream.numElements = sizeof(s_elements) / sizeof(s_elements[0]);
+
+    if (frames == 0)
+        frames = 1;
+
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    for (unsigned frame = 0; frame < frames; ++frame)
+    {
+        SetWVP(vs, vsConstants, SceneWVP(frame, width, height));
+        raster.Clear(CLEAR_COLOR, 1.0f);
+        raster.DrawIndexedPrimitive(stream, 0, 0, 3, s_indices, 0, 1);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+    const SoftRasterStats& s = raster.Stats();
+    printf("%u frames at %ux%u: %.3f ms/frame\n", frames, width, height, seconds * 1000.0 / frames);
+    printf("vertices %llu  triangles %llu (culled %llu, clipped %llu)\n",
+           s.vertices, s.triangles, s.culled, s.clipped);
+    printf("quads %llu  pixels %llu  vs instructions %llu  ps instructions %llu\n",
+           s.quads, s.pixels, s.vsInstructions, s.psInstructions);
+
+    if (outPath && !raster.SaveBmp(outPath))
+    {
+        fprintf(stderr, "cannot write %s\n", outPath);
+        return 1;
+    }
+
+    if (check)
+    {
+        Mat4 wvp = SceneWVP(frames - 1, width, height);
+        unsigned errors = CheckVertexShader(vs, vsConstants, wvp) + CheckFrame(raster, wvp);
+        if (errors)
+        {
+            printf("check: FAILED\n");
+            return 2;
+        }
+        printf("check: passed\n");
+    }
+    return 0;
+}